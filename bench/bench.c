@@ -0,0 +1,548 @@
+/**
+ * @file bench.c
+ * @brief Бенчмарки конвеєра: верстка → розміщення → планування → кодування превʼю.
+ * @details
+ * Окремий виконуваний файл (`make bench`), що лінкується з обʼєктами застосунку без
+ * `main.o`. Корпуси фіксовані й генеруються детерміновано в памʼяті: довгий
+ * український текст, Markdown із великою кількістю таблиць і зразок із кількома
+ * родинами шрифтів. Кожен етап виконується `--warmup` разів без вимірювання, далі
+ * `--reps` разів із вимірюванням; у звіт потрапляють мінімум, медіана та похідні
+ * метрики (нс/гліф, блоків/с, байтів/с). Звіт — один JSON‑обʼєкт у stdout.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "canvas.h"
+#include "drawing.h"
+#include "geom.h"
+#include "jsw.h"
+#include "log.h"
+#include "markdown.h"
+#include "planner.h"
+#include "png.h"
+#include "proginfo.h"
+#include "svg.h"
+#include "text.h"
+
+/** \brief Типова кількість вимірюваних повторів. */
+#define BENCH_DEFAULT_REPS 5
+/** \brief Типова кількість прогрівних повторів. */
+#define BENCH_DEFAULT_WARMUP 1
+/** \brief Найбільша кількість повторів. */
+#define BENCH_MAX_REPS 1000
+/** \brief Ширина рамки верстки корпусів, мм. */
+#define BENCH_FRAME_W_MM 180.0
+/** \brief Кегль корпусів, пт. */
+#define BENCH_SIZE_PT 12.0
+
+/**
+ * @brief Обсяг роботи одного виконання етапу (нуль — метрика не застосовна).
+ */
+typedef struct {
+    size_t glyphs; /**< Гліфи корпусу (кодові точки без пробільних). */
+    size_t blocks; /**< Блоки руху планувальника. */
+    size_t bytes;  /**< Байти входу або виходу етапу. */
+} bench_work_t;
+
+/**
+ * @brief Спільні дані етапів: корпуси та підготовлені проміжні результати.
+ */
+typedef struct {
+    char *uk_text;                /**< Довгий український текст. */
+    char *md_tables;              /**< Markdown із таблицями. */
+    char *multi_font;             /**< Абзац для зразка з кількома родинами. */
+    geom_paths_t text_paths;      /**< Контури `uk_text` до розміщення, мм. */
+    planner_segment_t *segments;  /**< Сегменти планувальника з розміщеного `uk_text`. */
+    size_t segment_count;         /**< Кількість сегментів. */
+    double start_mm[2];           /**< Початкова позиція плану, мм. */
+    planner_limits_t limits;      /**< Ліміти планувальника. */
+    drawing_layout_t preview;     /**< Розкладка для кодувальників превʼю. */
+    bool have_preview;            /**< Чи побудовано `preview`. */
+    canvas_options_t canvas_opts; /**< Параметри сторінки. */
+} bench_ctx_t;
+
+/** \brief Функція одного виконання етапу. */
+typedef int (*bench_fn_t) (bench_ctx_t *ctx, bench_work_t *work);
+
+/**
+ * @brief Опис етапу бенчмарку.
+ */
+typedef struct {
+    const char *name;   /**< Імʼя етапу. */
+    const char *corpus; /**< Корпус. */
+    bench_fn_t run;     /**< Виконання. */
+} bench_case_t;
+
+/** \brief Абзац українського корпусу (повторюється до потрібного обсягу). */
+static const char k_uk_paragraph[]
+    = "Плотер повільно веде перо вздовж рядка, і кожна літера з'являється штрих за штрихом: "
+      "спершу основа, потім засічки, наприкінці крапки над «і» та «ї». Ґудзики, їжаки, "
+      "щедрість і зірковий пил — жодна буква абетки не лишається поза увагою. Швидкість "
+      "обмежена прискоренням двигунів, тож коротші переходи між гліфами заощаджують "
+      "хвилини на кожній сторінці.\n";
+
+/** \brief Рядки таблиці Markdown‑корпусу. */
+static const char *const k_md_rows[] = {
+    "| Київ | 2 952 301 | 839 км² | столиця |",
+    "| Харків | 1 421 125 | 350 км² | обласний центр |",
+    "| Одеса | 1 010 537 | 236 км² | порт |",
+    "| Дніпро | 968 502 | 405 км² | промисловість |",
+    "| Львів | 717 273 | 182 км² | історичний центр |",
+    "| Запоріжжя | 710 052 | 334 км² | енергетика |",
+};
+
+/** \brief Родини шрифтів зразка з кількома шрифтами. */
+static const char *const k_multi_families[] = {
+    "EMS Nixish",        "EMS Readability",  "EMS Tech",
+    "Hershey Sans 1",    "Hershey Serif Med", "Hershey Script 1",
+    "Hershey Goth English",
+};
+
+/** \brief Абзац зразка з кількома шрифтами. */
+static const char k_multi_paragraph[]
+    = "Sphinx of black quartz, judge my vow. Фабрикуймо гідність, лящім їжею, ґав хапаймо, "
+      "з'єднавці чаш! 0123456789 — (дужки), [квадратні] та {фігурні}.\n";
+
+/** \brief Поточний час монотонного годинника, нс. */
+static uint64_t bench_now_ns (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/** \brief Кількість гліфів: кодові точки UTF‑8 без пробільних символів. */
+static size_t bench_count_glyphs (const char *s) {
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        if ((*p & 0xC0u) == 0x80u || *p == ' ' || *p == '\n' || *p == '\t' || *p == '|')
+            continue;
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * @brief Повторює шаблон до обсягу не менше `min_bytes`.
+ * @return Рядок (malloc) або NULL.
+ */
+static char *bench_repeat (const char *unit, size_t min_bytes) {
+    size_t unit_len = strlen (unit);
+    size_t count = (min_bytes + unit_len - 1) / unit_len;
+    char *s = (char *)malloc (count * unit_len + 1);
+    if (!s)
+        return NULL;
+    for (size_t i = 0; i < count; ++i)
+        memcpy (s + i * unit_len, unit, unit_len);
+    s[count * unit_len] = '\0';
+    return s;
+}
+
+/**
+ * @brief Будує Markdown‑корпус: заголовки, короткі абзаци та таблиці.
+ * @return Рядок (malloc) або NULL.
+ */
+static char *bench_build_md_tables (size_t tables) {
+    size_t cap = 4096;
+    size_t len = 0;
+    char *s = (char *)malloc (cap);
+    if (!s)
+        return NULL;
+    for (size_t t = 0; t < tables; ++t) {
+        char head[256];
+        int n = snprintf (
+            head, sizeof (head),
+            "## Таблиця %zu\n\nНаселення та площа міст, вибірка %zu.\n\n"
+            "| Місто | Населення | Площа | Роль |\n|---|---:|---:|---|\n",
+            t + 1, t + 1);
+        size_t need = len + (size_t)n + 1;
+        for (size_t r = 0; r < sizeof (k_md_rows) / sizeof (k_md_rows[0]); ++r)
+            need += strlen (k_md_rows[r]) + 1;
+        need += 1;
+        if (need > cap) {
+            while (cap < need)
+                cap *= 2;
+            char *grown = (char *)realloc (s, cap);
+            if (!grown) {
+                free (s);
+                return NULL;
+            }
+            s = grown;
+        }
+        memcpy (s + len, head, (size_t)n);
+        len += (size_t)n;
+        for (size_t r = 0; r < sizeof (k_md_rows) / sizeof (k_md_rows[0]); ++r) {
+            size_t row_len = strlen (k_md_rows[r]);
+            memcpy (s + len, k_md_rows[r], row_len);
+            len += row_len;
+            s[len++] = '\n';
+        }
+        s[len++] = '\n';
+    }
+    s[len] = '\0';
+    return s;
+}
+
+/** \brief Опції верстки корпусів. */
+static text_layout_opts_t bench_text_opts (const char *family) {
+    text_layout_opts_t opts;
+    memset (&opts, 0, sizeof (opts));
+    opts.family = family;
+    opts.size_pt = BENCH_SIZE_PT;
+    opts.units = GEOM_UNITS_MM;
+    opts.frame_width = BENCH_FRAME_W_MM;
+    opts.align = TEXT_ALIGN_LEFT;
+    opts.hyphenate = 1;
+    opts.line_spacing = 1.0;
+    opts.break_long_words = 1;
+    opts.break_mode = TEXT_BREAK_GREEDY;
+    return opts;
+}
+
+/** \brief Верстка довгого українського тексту. */
+static int bench_text_layout (bench_ctx_t *ctx, bench_work_t *work) {
+    text_layout_opts_t opts = bench_text_opts (NULL);
+    geom_paths_t paths;
+    if (text_layout_render (ctx->uk_text, &opts, &paths, NULL, NULL, NULL) != 0)
+        return -1;
+    geom_paths_free (&paths);
+    work->glyphs = bench_count_glyphs (ctx->uk_text);
+    work->bytes = strlen (ctx->uk_text);
+    return 0;
+}
+
+/** \brief Верстка того самого тексту оптимальним розбиттям на рядки. */
+static int bench_text_layout_optimal (bench_ctx_t *ctx, bench_work_t *work) {
+    text_layout_opts_t opts = bench_text_opts (NULL);
+    opts.break_mode = TEXT_BREAK_OPTIMAL;
+    geom_paths_t paths;
+    if (text_layout_render (ctx->uk_text, &opts, &paths, NULL, NULL, NULL) != 0)
+        return -1;
+    geom_paths_free (&paths);
+    work->glyphs = bench_count_glyphs (ctx->uk_text);
+    work->bytes = strlen (ctx->uk_text);
+    return 0;
+}
+
+/** \brief Рендеринг Markdown із таблицями в одному потоці. */
+static int bench_markdown (bench_ctx_t *ctx, bench_work_t *work) {
+    markdown_opts_t opts;
+    memset (&opts, 0, sizeof (opts));
+    opts.base_size_pt = BENCH_SIZE_PT;
+    opts.frame_width_mm = BENCH_FRAME_W_MM;
+    opts.threads = 1;
+    opts.break_mode = TEXT_BREAK_GREEDY;
+    geom_paths_t paths;
+    if (markdown_render_paths (ctx->md_tables, &opts, &paths, NULL) != 0)
+        return -1;
+    geom_paths_free (&paths);
+    work->glyphs = bench_count_glyphs (ctx->md_tables);
+    work->bytes = strlen (ctx->md_tables);
+    return 0;
+}
+
+/** \brief Верстка абзацу кожною родиною шрифтів зразка. */
+static int bench_multi_font (bench_ctx_t *ctx, bench_work_t *work) {
+    size_t families = sizeof (k_multi_families) / sizeof (k_multi_families[0]);
+    for (size_t i = 0; i < families; ++i) {
+        text_layout_opts_t opts = bench_text_opts (k_multi_families[i]);
+        geom_paths_t paths;
+        if (text_layout_render (ctx->multi_font, &opts, &paths, NULL, NULL, NULL) != 0)
+            return -1;
+        geom_paths_free (&paths);
+    }
+    work->glyphs = bench_count_glyphs (ctx->multi_font) * families;
+    work->bytes = strlen (ctx->multi_font) * families;
+    return 0;
+}
+
+/** \brief Розміщення контурів тексту на сторінці. */
+static int bench_canvas (bench_ctx_t *ctx, bench_work_t *work) {
+    canvas_layout_t layout;
+    if (canvas_layout_document (&ctx->canvas_opts, &ctx->text_paths, &layout) != CANVAS_STATUS_OK)
+        return -1;
+    canvas_layout_dispose (&layout);
+    work->glyphs = bench_count_glyphs (ctx->uk_text);
+    return 0;
+}
+
+/** \brief Планування руху для розміщеного тексту. */
+static int bench_planner (bench_ctx_t *ctx, bench_work_t *work) {
+    plan_block_t *blocks = NULL;
+    size_t count = 0;
+    if (!planner_plan (
+            &ctx->limits, ctx->start_mm, ctx->segments, ctx->segment_count, &blocks, &count))
+        return -1;
+    free (blocks);
+    work->blocks = count;
+    work->glyphs = bench_count_glyphs (ctx->uk_text);
+    return 0;
+}
+
+/** \brief Кодування SVG‑превʼю. */
+static int bench_svg (bench_ctx_t *ctx, bench_work_t *work) {
+    bytes_t out = { 0 };
+    if (svg_render_layout (&ctx->preview, &out) != 0)
+        return -1;
+    work->bytes = out.len;
+    free (out.bytes);
+    return 0;
+}
+
+/** \brief Растеризація та кодування PNG‑превʼю. */
+static int bench_png (bench_ctx_t *ctx, bench_work_t *work) {
+    bytes_t out = { 0 };
+    if (png_render_layout (&ctx->preview, &out) != 0)
+        return -1;
+    work->bytes = out.len;
+    free (out.bytes);
+    return 0;
+}
+
+/** \brief Етапи бенчмарку в порядку конвеєра. */
+static const bench_case_t k_cases[] = {
+    { "text_layout", "uk_text", bench_text_layout },
+    { "text_layout_optimal", "uk_text", bench_text_layout_optimal },
+    { "markdown_render", "md_tables", bench_markdown },
+    { "text_layout_fonts", "multi_font", bench_multi_font },
+    { "canvas_layout", "uk_text", bench_canvas },
+    { "planner_plan", "uk_text", bench_planner },
+    { "svg_encode", "uk_text", bench_svg },
+    { "png_encode", "uk_text", bench_png },
+};
+
+/**
+ * @brief Готує корпуси та проміжні результати для окремих етапів.
+ * @return 0 — успіх; -1 — помилка.
+ */
+static int bench_ctx_init (bench_ctx_t *ctx) {
+    memset (ctx, 0, sizeof (*ctx));
+    ctx->uk_text = bench_repeat (k_uk_paragraph, 24 * 1024);
+    ctx->md_tables = bench_build_md_tables (24);
+    ctx->multi_font = bench_repeat (k_multi_paragraph, 2 * 1024);
+    if (!ctx->uk_text || !ctx->md_tables || !ctx->multi_font)
+        return -1;
+
+    text_layout_opts_t opts = bench_text_opts (NULL);
+    if (text_layout_render (ctx->uk_text, &opts, &ctx->text_paths, NULL, NULL, NULL) != 0)
+        return -1;
+
+    ctx->canvas_opts.paper_w_mm = 210.0;
+    ctx->canvas_opts.paper_h_mm = 297.0;
+    ctx->canvas_opts.margin_top_mm = 10.0;
+    ctx->canvas_opts.margin_right_mm = 10.0;
+    ctx->canvas_opts.margin_bottom_mm = 10.0;
+    ctx->canvas_opts.margin_left_mm = 10.0;
+    ctx->canvas_opts.orientation = ORIENT_PORTRAIT;
+    ctx->canvas_opts.fit_to_frame = false;
+
+    drawing_page_t page;
+    memset (&page, 0, sizeof (page));
+    page.paper_w_mm = ctx->canvas_opts.paper_w_mm;
+    page.paper_h_mm = ctx->canvas_opts.paper_h_mm;
+    page.margin_top_mm = ctx->canvas_opts.margin_top_mm;
+    page.margin_right_mm = ctx->canvas_opts.margin_right_mm;
+    page.margin_bottom_mm = ctx->canvas_opts.margin_bottom_mm;
+    page.margin_left_mm = ctx->canvas_opts.margin_left_mm;
+    page.orientation = ctx->canvas_opts.orientation;
+    page.fit_to_frame = 0;
+    if (drawing_build_layout_from_paths (&page, &ctx->text_paths, &ctx->preview) != 0)
+        return -1;
+    ctx->have_preview = true;
+
+    double feed_mm_s = 0.0;
+    if (canvas_default_motion_limits (&ctx->limits, &feed_mm_s) != 0)
+        return -1;
+    canvas_segment_iter_t it;
+    if (canvas_segment_iter_init (&it, &ctx->preview.layout, feed_mm_s) != 0)
+        return -1;
+    ctx->start_mm[0] = it.start_mm[0];
+    ctx->start_mm[1] = it.start_mm[1];
+    size_t cap = 0;
+    planner_segment_t segment;
+    while (canvas_segment_iter_next (&it, &segment) == 0) {
+        if (ctx->segment_count == cap) {
+            size_t new_cap = cap ? cap * 2 : 4096;
+            planner_segment_t *grown
+                = (planner_segment_t *)realloc (ctx->segments, new_cap * sizeof (*grown));
+            if (!grown)
+                return -1;
+            ctx->segments = grown;
+            cap = new_cap;
+        }
+        ctx->segments[ctx->segment_count++] = segment;
+    }
+    return 0;
+}
+
+/** \brief Звільняє дані етапів. */
+static void bench_ctx_dispose (bench_ctx_t *ctx) {
+    free (ctx->uk_text);
+    free (ctx->md_tables);
+    free (ctx->multi_font);
+    geom_paths_free (&ctx->text_paths);
+    free (ctx->segments);
+    if (ctx->have_preview)
+        drawing_layout_dispose (&ctx->preview);
+    memset (ctx, 0, sizeof (*ctx));
+}
+
+/** \brief Порівняння для qsort за зростанням. */
+static int bench_cmp_u64 (const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Виконує етап із прогрівом і повторами та друкує його результат у JSON.
+ * @return 0 — успіх; -1 — етап завершився помилкою.
+ */
+static int bench_run_case (
+    const bench_case_t *bc, bench_ctx_t *ctx, int warmup, int reps, json_writer_t *w) {
+    bench_work_t work;
+    for (int i = 0; i < warmup; ++i) {
+        memset (&work, 0, sizeof (work));
+        if (bc->run (ctx, &work) != 0)
+            return -1;
+    }
+    uint64_t samples[BENCH_MAX_REPS];
+    for (int i = 0; i < reps; ++i) {
+        memset (&work, 0, sizeof (work));
+        uint64_t t0 = bench_now_ns ();
+        int rc = bc->run (ctx, &work);
+        samples[i] = bench_now_ns () - t0;
+        if (rc != 0)
+            return -1;
+    }
+    qsort (samples, (size_t)reps, sizeof (samples[0]), bench_cmp_u64);
+    uint64_t min_ns = samples[0];
+    uint64_t median_ns = (reps % 2) ? samples[reps / 2]
+                                    : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+    double median_s = (double)median_ns / 1e9;
+
+    jsw_jsonw_begin_object (w);
+    jsw_jsonw_key (w, "name");
+    jsw_jsonw_string_cstr (w, bc->name);
+    jsw_jsonw_key (w, "corpus");
+    jsw_jsonw_string_cstr (w, bc->corpus);
+    jsw_jsonw_key (w, "min_ns");
+    jsw_jsonw_int (w, (long long)min_ns);
+    jsw_jsonw_key (w, "median_ns");
+    jsw_jsonw_int (w, (long long)median_ns);
+    if (work.glyphs > 0) {
+        jsw_jsonw_key (w, "glyphs");
+        jsw_jsonw_int (w, (long long)work.glyphs);
+        jsw_jsonw_key (w, "ns_per_glyph");
+        jsw_jsonw_double (w, (double)median_ns / (double)work.glyphs);
+    }
+    if (work.blocks > 0) {
+        jsw_jsonw_key (w, "blocks");
+        jsw_jsonw_int (w, (long long)work.blocks);
+        jsw_jsonw_key (w, "blocks_per_s");
+        jsw_jsonw_double (w, median_s > 0.0 ? (double)work.blocks / median_s : 0.0);
+    }
+    if (work.bytes > 0) {
+        jsw_jsonw_key (w, "bytes");
+        jsw_jsonw_int (w, (long long)work.bytes);
+        jsw_jsonw_key (w, "bytes_per_s");
+        jsw_jsonw_double (w, median_s > 0.0 ? (double)work.bytes / median_s : 0.0);
+    }
+    jsw_jsonw_end_object (w);
+    fprintf (
+        stderr, "  %-20s %-10s медіана %10.3f мс\n", bc->name, bc->corpus,
+        (double)median_ns / 1e6);
+    return 0;
+}
+
+/** \brief Друкує довідку. */
+static void bench_usage (FILE *out) {
+    fprintf (
+        out,
+        "Використання: cplot_bench [--reps N] [--warmup N] [--filter ПІДРЯДОК]\n"
+        "  --reps N       вимірювані повтори кожного етапу (типово %d, до %d)\n"
+        "  --warmup N     прогрівні повтори без вимірювання (типово %d)\n"
+        "  --filter S     лише етапи, імʼя яких містить S\n"
+        "Звіт JSON друкується у stdout, перебіг — у stderr.\n",
+        BENCH_DEFAULT_REPS, BENCH_MAX_REPS, BENCH_DEFAULT_WARMUP);
+}
+
+/** \brief Розбирає невідʼємне ціле значення опції. */
+static bool bench_parse_count (const char *s, int max, int *out) {
+    char *end = NULL;
+    long v = s ? strtol (s, &end, 10) : -1;
+    if (!s || *s == '\0' || *end != '\0' || v < 0 || v > max)
+        return false;
+    *out = (int)v;
+    return true;
+}
+
+int main (int argc, char **argv) {
+    int reps = BENCH_DEFAULT_REPS;
+    int warmup = BENCH_DEFAULT_WARMUP;
+    const char *filter = NULL;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp (arg, "--reps") == 0 && bench_parse_count (val, BENCH_MAX_REPS, &reps)
+            && reps > 0) {
+            ++i;
+        } else if (strcmp (arg, "--warmup") == 0 && bench_parse_count (val, 100, &warmup)) {
+            ++i;
+        } else if (strcmp (arg, "--filter") == 0 && val) {
+            filter = val;
+            ++i;
+        } else if (strcmp (arg, "--help") == 0 || strcmp (arg, "-h") == 0) {
+            bench_usage (stdout);
+            return 0;
+        } else {
+            bench_usage (stderr);
+            return 2;
+        }
+    }
+
+    log_set_level (LOG_WARN);
+    bench_ctx_t ctx;
+    if (bench_ctx_init (&ctx) != 0) {
+        fprintf (stderr, "Не вдалося підготувати корпуси бенчмарку\n");
+        bench_ctx_dispose (&ctx);
+        return 1;
+    }
+
+#ifdef NDEBUG
+    const char *build = "release";
+#else
+    const char *build = "debug";
+#endif
+    json_writer_t w;
+    jsw_jsonw_init (&w, stdout);
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "version");
+    jsw_jsonw_string_cstr (&w, __PROGRAM_VERSION__);
+    jsw_jsonw_key (&w, "build");
+    jsw_jsonw_string_cstr (&w, build);
+    jsw_jsonw_key (&w, "reps");
+    jsw_jsonw_int (&w, reps);
+    jsw_jsonw_key (&w, "warmup");
+    jsw_jsonw_int (&w, warmup);
+    jsw_jsonw_key (&w, "results");
+    jsw_jsonw_begin_array (&w);
+    int status = 0;
+    for (size_t i = 0; i < sizeof (k_cases) / sizeof (k_cases[0]); ++i) {
+        if (filter && !strstr (k_cases[i].name, filter))
+            continue;
+        if (bench_run_case (&k_cases[i], &ctx, warmup, reps, &w) != 0) {
+            fprintf (stderr, "Етап %s завершився помилкою\n", k_cases[i].name);
+            status = 1;
+        }
+    }
+    jsw_jsonw_end_array (&w);
+    jsw_jsonw_end_object (&w);
+    fputc ('\n', stdout);
+    bench_ctx_dispose (&ctx);
+    return status;
+}
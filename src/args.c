@@ -78,8 +78,10 @@ static cmd_t args_parse_command_name (const char *name) {
         const char *name;
         cmd_t cmd;
     } k_cmd_map[]
-        = { { "print", CMD_PRINT }, { "device", CMD_DEVICE }, { "fonts", CMD_FONTS },
-            { "font", CMD_FONTS },  { "config", CMD_CONFIG }, { "version", CMD_VERSION } };
+        = { { "print", CMD_PRINT },   { "plan", CMD_PLAN },     { "batch", CMD_BATCH },
+            { "serve", CMD_SERVE },   { "device", CMD_DEVICE }, { "fonts", CMD_FONTS },
+            { "font", CMD_FONTS },    { "config", CMD_CONFIG }, { "trace", CMD_TRACE },
+            { "version", CMD_VERSION } };
     for (size_t i = 0; i < sizeof (k_cmd_map) / sizeof (k_cmd_map[0]); ++i) {
         if (strcmp (name, k_cmd_map[i].name) == 0)
             return k_cmd_map[i].cmd;
@@ -233,12 +235,25 @@ static const struct option k_long_options[] = {
     { "height", required_argument, 0, ARG_HEIGHT },
     { "png", no_argument, 0, ARG_PNG },
     { "output", required_argument, 0, ARG_OUTPUT },
+    { "dpi", required_argument, 0, ARG_DPI },
+    { "max-width", required_argument, 0, ARG_MAX_WIDTH },
     { "format", required_argument, 0, ARG_FORMAT },
     { "motion-profile", required_argument, 0, 25 },
     { "preview", no_argument, 0, ARG_PREVIEW },
     { "fit-page", no_argument, 0, ARG_FIT_PAGE },
+    { "optimize-travel", no_argument, 0, ARG_OPTIMIZE_TRAVEL },
     { "dry-run", no_argument, 0, ARG_DRY_RUN },
+    { "estimate", no_argument, 0, ARG_ESTIMATE },
+    { "replay", required_argument, 0, ARG_REPLAY },
+    { "socket", required_argument, 0, ARG_SOCKET },
+    { "devices", required_argument, 0, ARG_DEVICES },
+    { "resume", no_argument, 0, ARG_RESUME },
+    { "paginate", no_argument, 0, ARG_PAGINATE },
+    { "page-hook", required_argument, 0, ARG_PAGE_HOOK },
     { "verbose", no_argument, 0, ARG_VERBOSE },
+    { "profile", no_argument, 0, ARG_PROFILE },
+    { "telemetry", required_argument, 0, ARG_TELEMETRY },
+    { "trace", required_argument, 0, ARG_TRACE },
     { "device-name", required_argument, 0, ARG_DEVICE_NAME },
     { "dx", required_argument, 0, ARG_DX },
     { "dy", required_argument, 0, ARG_DY },
@@ -263,6 +278,12 @@ static const cli_option_desc_t k_option_descs_global[] = {
     { "version", no_argument, 'v', 'v', NULL, "global", "Показати версію" },
     { "no-colors", no_argument, ARG_NO_COLORS, '\0', NULL, "global", "Вимкнути ANSI-кольори" },
     { "verbose", no_argument, ARG_VERBOSE, '\0', NULL, "global", "Розгорнутий вивід" },
+    { "profile", no_argument, ARG_PROFILE, '\0', NULL, "global",
+      "Час етапів і лічильники (JSON у stderr після виконання)" },
+    { "telemetry", required_argument, ARG_TELEMETRY, '\0', "PATH", "global",
+      "Телеметрія обміну з пристроєм: знімок JSON щосекунди у файл (- — stderr)" },
+    { "trace", required_argument, ARG_TRACE, '\0', "PATH", "global",
+      "Бінарне трасування гарячих шляхів у кільце; дамп у файл (cplot trace PATH)" },
     { "dry-run", no_argument, ARG_DRY_RUN, '\0', NULL, "global",
       "Не надсилати команди на пристрій" },
 };
@@ -280,13 +301,42 @@ static const cli_option_desc_t k_option_descs_print[] = {
       "Масштабувати вміст, щоб вмістився на одну сторінку (без розбиття)" },
     { "png", no_argument, ARG_PNG, '\0', NULL, "layout", "При --preview вивести PNG замість SVG" },
     { "output", required_argument, ARG_OUTPUT, '\0', "PATH", "layout",
-      "Тільки з --preview: зберегти у файл (без stdout)" },
-    { "format", required_argument, ARG_FORMAT, '\0', "markdown", "layout",
-      "Формат вхідного документа (доступно: markdown)" },
+      "З --preview: зберегти у файл (без stdout); у plan — файл плану" },
+    { "dpi", required_argument, ARG_DPI, '\0', "N", "layout",
+      "Роздільність превʼю (PNG; для SVG — точність координат)" },
+    { "max-width", required_argument, ARG_MAX_WIDTH, '\0', "пікселі", "layout",
+      "Найбільша ширина PNG‑превʼю (зменшує dpi)" },
+    { "format", required_argument, ARG_FORMAT, '\0', "markdown|svg", "layout",
+      "Формат вхідного документа (доступно: markdown, svg)" },
     { "family", required_argument, ARG_FONT_FAMILY_VALUE, '\0', "NAME|ID", "layout",
       "Родина або шрифт для поточного друку" },
     { "motion-profile", required_argument, 25, '\0', "precise|balanced|fast", "layout",
       "Профіль руху (швидкість/прискорення)" },
+    { "optimize-travel", no_argument, ARG_OPTIMIZE_TRAVEL, '\0', NULL, "layout",
+      "Впорядкувати контури для коротших переїздів без пера" },
+    { "estimate", no_argument, ARG_ESTIMATE, '\0', NULL, "layout",
+      "Не надсилати на пристрій; оцінити тривалість друку (JSON у stdout)" },
+    { "resume", no_argument, ARG_RESUME, '\0', NULL, "layout",
+      "Продовжити перерваний друк з останнього підтвердженого штриха" },
+    { "paginate", no_argument, ARG_PAGINATE, '\0', NULL, "layout",
+      "Розбити довгий документ на сторінки (превʼю: PATH-N.svg з --output)" },
+    { "page-hook", required_argument, ARG_PAGE_HOOK, '\0', "CMD", "layout",
+      "З --paginate: команда між сторінками (CPLOT_PAGE=N; ненуль — зупинка)" },
+};
+
+static const cli_option_desc_t k_option_descs_plan[] = {
+    { "replay", required_argument, ARG_REPLAY, '\0', "PATH", "plan",
+      "Виконати збережений план без верстки (з --dry-run/--estimate)" },
+};
+
+static const cli_option_desc_t k_option_descs_batch[] = {
+    { "devices", required_argument, ARG_DEVICES, '\0', "N|all", "batch",
+      "Розподілити документи між N (або всіма) підключеними плотерами" },
+};
+
+static const cli_option_desc_t k_option_descs_serve[] = {
+    { "socket", required_argument, ARG_SOCKET, '\0', "PATH", "serve",
+      "Unix-сокет сервера (типово $XDG_RUNTIME_DIR/cplot.sock)" },
 };
 
 static const cli_option_desc_t k_option_descs_device[] = {
@@ -315,8 +365,10 @@ static const cli_option_desc_t k_option_descs_config[] = {
 
 static cli_option_desc_t g_option_descs
     [ARRAY_COUNT (k_option_descs_global) + ARRAY_COUNT (k_option_descs_print)
-     + ARRAY_COUNT (k_option_descs_device) + ARRAY_COUNT (k_option_descs_fonts)
-     + ARRAY_COUNT (k_option_descs_config)]
+     + ARRAY_COUNT (k_option_descs_plan) + ARRAY_COUNT (k_option_descs_batch)
+     + ARRAY_COUNT (k_option_descs_serve)
+     + ARRAY_COUNT (k_option_descs_device)
+     + ARRAY_COUNT (k_option_descs_fonts) + ARRAY_COUNT (k_option_descs_config)]
     = { 0 };
 
 static size_t g_option_descs_count = 0;
@@ -333,6 +385,9 @@ static void args_option_descs_init (void) {
 
     COPY_DESC_BLOCK (k_option_descs_global);
     COPY_DESC_BLOCK (k_option_descs_print);
+    COPY_DESC_BLOCK (k_option_descs_plan);
+    COPY_DESC_BLOCK (k_option_descs_batch);
+    COPY_DESC_BLOCK (k_option_descs_serve);
     COPY_DESC_BLOCK (k_option_descs_device);
     COPY_DESC_BLOCK (k_option_descs_fonts);
     COPY_DESC_BLOCK (k_option_descs_config);
@@ -357,9 +412,15 @@ const cli_option_desc_t *args_argdefs_options (size_t *out_count) {
 static const cli_command_desc_t k_commands[] = {
     { "print",
       "Плотинг із параметрами розкладки (для прев’ю використовуйте --preview, SVG/PNG у stdout)" },
+    { "plan", "Зберегти план руху у файл (--output) або виконати збережений (--replay)" },
+    { "batch",
+      "Пакетний друк документів із маніфесту JSONL за один сеанс (параметри розкладки як у print)" },
+    { "serve",
+      "Сервер завдань на Unix-сокеті з утримуваним пристроєм (параметри розкладки як у print)" },
     { "device", "Утиліти пристрою (profile, jog, pen, list)" },
     { "font", "Керування шрифтами (--list, псевдонім: fonts)" },
     { "config", "Показати або змінити типові налаштування" },
+    { "trace", "Розшифрувати дамп трасування (--trace) у рядки журналу" },
     { "version", "Показати версію" },
 };
 
@@ -390,6 +451,10 @@ static const cli_config_desc_t k_cfg_keys[] = {
     { "speed", CFGK_DOUBLE, offsetof (config_t, speed_mm_s), "мм_с", NULL, "Швидкість", "%.1f" },
     { "accel", CFGK_DOUBLE, offsetof (config_t, accel_mm_s2), "мм_с2", NULL, "Прискорення",
       "%.1f" },
+    { "travel_speed", CFGK_DOUBLE, offsetof (config_t, travel_speed_mm_s), "мм_с", NULL,
+      "Швидкість переїздів з піднятим пером (0 — межа моделі)", "%.1f" },
+    { "travel_accel", CFGK_DOUBLE, offsetof (config_t, travel_accel_mm_s2), "мм_с2", NULL,
+      "Прискорення переїздів з піднятим пером (0 — межа моделі)", "%.1f" },
     { "pen_up_speed", CFGK_INT, offsetof (config_t, pen_up_speed), "%/с", NULL,
       "Швидкість підйому пера", "%d" },
     { "pen_down_speed", CFGK_INT, offsetof (config_t, pen_down_speed), "%/с", NULL,
@@ -398,8 +463,22 @@ static const cli_config_desc_t k_cfg_keys[] = {
       "Затримка після підйому", "%d" },
     { "pen_down_delay", CFGK_INT, offsetof (config_t, pen_down_delay_ms), "мс", NULL,
       "Затримка після опускання", "%d" },
+    { "pen_lead", CFGK_INT, offsetof (config_t, pen_lead_ms), "мс", NULL,
+      "Перекриття затримок пера з переїздом (0 — вимкнено)", "%d" },
     { "servo_timeout", CFGK_INT, offsetof (config_t, servo_timeout_s), "с", NULL,
       "Тайм-аут сервоприводу", "%d" },
+    { "pen_hop", CFGK_DOUBLE, offsetof (config_t, pen_hop_mm), "мм", NULL,
+      "Проміжок між контурами без підйому пера (0 — вимкнено)", "%.2f" },
+    { "merge_phases", CFGK_INT, offsetof (config_t, merge_phases), NULL, NULL,
+      "Обʼєднання фаз руху в спільні команди (0 — вимкнено)", "%d" },
+    { "jerk", CFGK_DOUBLE, offsetof (config_t, jerk_mm_s3), "мм_с3", NULL,
+      "Обмеження ривка, S‑подібні розгін і гальмування (0 — трапеція)", "%.0f" },
+    { "simplify_tol", CFGK_DOUBLE, offsetof (config_t, simplify_tol_mm), "мм", NULL,
+      "Допуск спрощення контурів (0 — вимкнено)", "%.3f" },
+    { "chord_tol", CFGK_DOUBLE, offsetof (config_t, chord_tol_mm), "мм", NULL,
+      "Допуск злиття штрихів у хорди (0 — вимкнено)", "%.3f" },
+    { "line_break", CFGK_INT, offsetof (config_t, line_break), NULL, NULL,
+      "Розбиття на рядки: 0 — жадібне, 1 — оптимальне (Кнут–Пласс)", "%d" },
 };
 
 /**
@@ -512,12 +591,20 @@ static bool args_handle_layout_option (int arg, const char *value, options_t *op
         return true;
     case ARG_FIT_PAGE:
         options->print.fit_page = true;
+        options->print.fit_page_set = true;
         LOGD ("масштаб: вміст у межах однієї сторінки");
         return true;
+    case ARG_OPTIMIZE_TRAVEL:
+        options->print.optimize_travel = true;
+        LOGD ("порядок контурів: оптимізація переїздів");
+        return true;
     case ARG_FORMAT:
         if (value && (strcmp (value, "markdown") == 0)) {
             options->print.input_format = INPUT_FORMAT_MARKDOWN;
             LOGD ("формат вводу: маркдаун");
+        } else if (value && (strcmp (value, "svg") == 0)) {
+            options->print.input_format = INPUT_FORMAT_SVG;
+            LOGD ("формат вводу: SVG");
         } else {
             LOGW ("Непідтримуваний параметр формату: %s (використовую текст)", value ? value : "");
             options->print.input_format = INPUT_FORMAT_TEXT;
@@ -552,6 +639,13 @@ static bool args_handle_layout_option (int arg, const char *value, options_t *op
     }
 }
 
+/** \brief Найбільша роздільність превʼю, dpi. */
+#define ARGS_PREVIEW_DPI_MAX 4800.0
+/** \brief Найбільша ширина PNG‑превʼю, пікселі. */
+#define ARGS_PREVIEW_WIDTH_MAX 65535L
+/** \brief Найбільша кількість плотерів для `batch --devices`. */
+#define ARGS_DEVICES_MAX 32L
+
 /**
  * @brief Обробляє опції виводу/превʼю.
  * @param arg Код опції.
@@ -572,6 +666,28 @@ static bool args_handle_output_option (int arg, options_t *options) {
             LOGD ("прев’ю: файл виводу %s", options->print.output_path);
         }
         return true;
+    case ARG_DPI: {
+        char *end = NULL;
+        double v = optarg ? strtod (optarg, &end) : 0.0;
+        if (end && end != optarg && *end == '\0' && v > 0.0 && v <= ARGS_PREVIEW_DPI_MAX) {
+            options->print.preview_dpi = v;
+            LOGD ("прев’ю: %.1f dpi", v);
+        } else {
+            LOGW ("ігнорую некоректну роздільність прев’ю: '%s'", optarg ? optarg : "");
+        }
+        return true;
+    }
+    case ARG_MAX_WIDTH: {
+        char *end = NULL;
+        long v = optarg ? strtol (optarg, &end, 10) : 0;
+        if (end && end != optarg && *end == '\0' && v > 0 && v <= ARGS_PREVIEW_WIDTH_MAX) {
+            options->print.preview_max_width = (unsigned)v;
+            LOGD ("прев’ю: ширина до %ld пікселів", v);
+        } else {
+            LOGW ("ігнорую некоректну ширину прев’ю: '%s'", optarg ? optarg : "");
+        }
+        return true;
+    }
     case ARG_PREVIEW:
         options->print.preview = true;
         LOGD ("увімкнено прев’ю");
@@ -580,10 +696,65 @@ static bool args_handle_output_option (int arg, options_t *options) {
         options->print.dry_run = true;
         LOGD ("сухий запуск: без надсилання на пристрій");
         return true;
+    case ARG_ESTIMATE:
+        options->print.estimate = true;
+        LOGD ("оцінка тривалості: без надсилання на пристрій");
+        return true;
+    case ARG_RESUME:
+        options->print.resume = true;
+        LOGD ("друк: відновлення з точки відновлення");
+        return true;
+    case ARG_PAGINATE:
+        options->print.paginate = true;
+        LOGD ("друк: посторінкова верстка");
+        return true;
+    case ARG_PAGE_HOOK:
+        str_string_copy (
+            options->print.page_hook, sizeof (options->print.page_hook), optarg ? optarg : "");
+        LOGD ("друк: команда між сторінками '%s'", options->print.page_hook);
+        return true;
+    case ARG_REPLAY:
+        str_string_copy (
+            options->print.replay_path, sizeof (options->print.replay_path),
+            optarg ? optarg : "");
+        LOGD ("план: повтор із файлу %s", options->print.replay_path);
+        return true;
+    case ARG_SOCKET:
+        str_string_copy (
+            options->print.socket_path, sizeof (options->print.socket_path),
+            optarg ? optarg : "");
+        LOGD ("сервер: сокет %s", options->print.socket_path);
+        return true;
+    case ARG_DEVICES: {
+        char *end = NULL;
+        long v = optarg ? strtol (optarg, &end, 10) : 0;
+        if (optarg && strcmp (optarg, "all") == 0) {
+            options->print.devices = -1;
+            LOGD ("пакет: усі знайдені плотери");
+        } else if (end && end != optarg && *end == '\0' && v > 0 && v <= ARGS_DEVICES_MAX) {
+            options->print.devices = (int)v;
+            LOGD ("пакет: плотерів %ld", v);
+        } else {
+            LOGW ("ігнорую некоректну кількість плотерів: '%s'", optarg ? optarg : "");
+        }
+        return true;
+    }
     case ARG_VERBOSE:
         options->verbose = true;
         LOGD ("детальний вивід");
         return true;
+    case ARG_PROFILE:
+        options->profile = true;
+        return true;
+    case ARG_TELEMETRY:
+        str_string_copy (
+            options->telemetry_path, sizeof (options->telemetry_path), optarg ? optarg : "");
+        LOGD ("телеметрія: %s", options->telemetry_path);
+        return true;
+    case ARG_TRACE:
+        str_string_copy (options->trace_path, sizeof (options->trace_path), optarg ? optarg : "");
+        LOGD ("трасування: %s", options->trace_path);
+        return true;
     default:
         return false;
     }
@@ -788,7 +959,8 @@ void args_options_parser (int argc, char *argv[], options_t *options) {
         }
     }
 
-    if (options->cmd == CMD_PRINT) {
+    if (options->cmd == CMD_PRINT || options->cmd == CMD_PLAN || options->cmd == CMD_BATCH
+        || options->cmd == CMD_TRACE) {
         args_get_file_name (argc, argv, options);
     }
 
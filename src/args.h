@@ -18,7 +18,18 @@
 /**
  * @brief Підтримувані верхньорівневі підкоманди.
  */
-typedef enum { CMD_NONE = 0, CMD_PRINT, CMD_DEVICE, CMD_FONTS, CMD_CONFIG, CMD_VERSION } cmd_t;
+typedef enum {
+    CMD_NONE = 0,
+    CMD_PRINT,
+    CMD_PLAN,
+    CMD_BATCH,
+    CMD_SERVE,
+    CMD_DEVICE,
+    CMD_FONTS,
+    CMD_CONFIG,
+    CMD_TRACE,
+    CMD_VERSION
+} cmd_t;
 
 /**
  * @brief Перелік дій для підкоманди `device`.
@@ -94,7 +105,20 @@ typedef enum arg_code {
     ARG_FORMAT = 21,
     ARG_FONT_FAMILIES = 22,
     ARG_FONT_FAMILY_VALUE = 23,
-    ARG_FIT_PAGE = 24
+    ARG_FIT_PAGE = 24,
+    ARG_OPTIMIZE_TRAVEL = 26,
+    ARG_DPI = 27,
+    ARG_MAX_WIDTH = 28,
+    ARG_ESTIMATE = 29,
+    ARG_REPLAY = 30,
+    ARG_RESUME = 31,
+    ARG_SOCKET = 32,
+    ARG_DEVICES = 33,
+    ARG_PROFILE = 34,
+    ARG_TELEMETRY = 35,
+    ARG_TRACE = 36,
+    ARG_PAGINATE = 37,
+    ARG_PAGE_HOOK = 38
 } arg_code_t;
 
 /**
@@ -142,6 +166,7 @@ typedef struct cli_config_desc {
 typedef enum {
     INPUT_FORMAT_TEXT = 0,
     INPUT_FORMAT_MARKDOWN = 1,
+    INPUT_FORMAT_SVG = 2,
 } input_format_t;
 
 /**
@@ -164,14 +189,25 @@ typedef struct args_print_options {
     double paper_h_mm;
     bool preview;
     bool preview_png;
+    double preview_dpi;
+    unsigned preview_max_width;
     char output_path[FILE_NAME_SIZE];
+    char replay_path[FILE_NAME_SIZE];
+    char socket_path[FILE_NAME_SIZE];
+    int devices;
     bool fit_page;
+    bool fit_page_set;
     bool dry_run;
+    bool estimate;
+    bool resume;
     char font_family[128];
     double font_size_pt;
     char device_model[32];
     input_format_t input_format;
     motion_profile_t motion_profile;
+    bool optimize_travel;
+    bool paginate;
+    char page_hook[FILE_NAME_SIZE];
 } args_print_options_t;
 
 typedef struct args_device_options {
@@ -200,6 +236,9 @@ struct options {
     bool version;
     bool no_colors;
     bool verbose;
+    bool profile;
+    char telemetry_path[FILE_NAME_SIZE];
+    char trace_path[FILE_NAME_SIZE];
     cmd_t cmd;
     args_print_options_t print;
     args_device_options_t device;
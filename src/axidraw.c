@@ -7,6 +7,7 @@
 #include "axidraw.h"
 #include "ebb.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -72,9 +73,17 @@ static int32_t axidraw_clamp_i32 (double value) {
 #define AXIDRAW_SERVO_MAX 28000
 #define AXIDRAW_SERVO_SPEED_SCALE 5
 #define AXIDRAW_MAX_DURATION_MS 16777215u
+/** Після скількох очікувань за прогнозом модель FIFO звіряється з `QM`. */
+#define AXIDRAW_FIFO_RESYNC_INTERVAL 64u
+/** Крок опитування `QM` в `axidraw_wait_for_idle`, мс. */
+#define AXIDRAW_IDLE_POLL_MS 20
+/** Запас після прогнозованого спорожнення FIFO перед підтвердженням через `QM`, мс. */
+#define AXIDRAW_IDLE_MARGIN_MS 2.0
 
 #include "log.h"
 #include "str.h"
+#include "telemetry.h"
+#include "trace.h"
 #include "ttime.h"
 
 #ifdef DEBUG
@@ -88,8 +97,8 @@ static int32_t axidraw_clamp_i32 (double value) {
 #endif
 
 static const axidraw_device_profile_t k_axidraw_device_profiles[] = {
-    { "minikit2", 160.0, 101.0, 254.0, 200.0, 80.0 },
-    { "axidraw_v3", 300.0, 218.0, 381.0, 250.0, 80.0 },
+    { "minikit2", 160.0, 101.0, 254.0, 200.0, 80.0, 60, 0.4, 254.0, 200.0 },
+    { "axidraw_v3", 300.0, 218.0, 381.0, 250.0, 80.0, 80, 0.5, 381.0, 250.0 },
 };
 
 /**
@@ -202,11 +211,16 @@ static void axidraw_reset_runtime (axidraw_device_t *dev) {
     dev->last_cmd.tv_sec = 0;
     dev->last_cmd.tv_nsec = 0;
     dev->pending_commands = 0;
+    memset (&dev->fifo, 0, sizeof (dev->fifo));
+    dev->fifo.valid = true;
+    ebb_pipeline_abandon (&dev->pipeline);
 }
 
 static void axidraw_sync_settings (axidraw_device_t *dev);
+static int axidraw_check_connection (axidraw_device_t *dev);
 static int axidraw_require_connection (axidraw_device_t *dev);
 static const char *axidraw_lock_path (void);
+static double axidraw_fifo_sleep_until_drained (axidraw_device_t *dev, double budget_ms);
 
 /**
  * @brief Обчислює шлях до lock-файлу у TMPDIR (кешується).
@@ -244,6 +258,7 @@ void axidraw_settings_reset (axidraw_settings_t *settings) {
     settings->fifo_limit = AXIDRAW_DEFAULT_FIFO_LIMIT;
     settings->pen_up_delay_ms = 0;
     settings->pen_down_delay_ms = 0;
+    settings->pen_lead_ms = 0;
     settings->pen_up_pos = -1;
     settings->pen_down_pos = -1;
     settings->pen_up_speed = -1;
@@ -447,8 +462,17 @@ int axidraw_move_lowlevel_phase_xy (
 int axidraw_wait_for_idle (axidraw_device_t *dev, int max_attempts) {
     if (!dev || max_attempts <= 0)
         return -1;
-    struct timespec pause = { .tv_sec = 0, .tv_nsec = 20 * 1000000L };
-    for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    if (axidraw_pipeline_sync (dev) != 0)
+        return -1;
+    /* Тривалість черги відома з моделі FIFO: спимо до її спорожнення, а QM лише
+     * підтверджує простій. Без дійсної моделі (HM) — звичайне опитування. */
+    double budget_ms = (double)max_attempts * AXIDRAW_IDLE_POLL_MS;
+    double slept_ms = axidraw_fifo_sleep_until_drained (dev, budget_ms);
+    int attempts = max_attempts - (int)(slept_ms / AXIDRAW_IDLE_POLL_MS);
+    if (attempts < 1)
+        attempts = 1;
+    struct timespec pause = { .tv_sec = 0, .tv_nsec = AXIDRAW_IDLE_POLL_MS * 1000000L };
+    for (int attempt = 0; attempt < attempts; ++attempt) {
         ebb_motion_status_t ms = { 0 };
         if (ebb_query_motion (dev->port, &ms, dev->timeout_ms) != 0)
             return -1;
@@ -568,7 +592,7 @@ void axidraw_device_config (
 }
 
 /**
- * @brief Евристичний пошук порту AxiDraw (переважно macOS).
+ * @brief Пошук порту AxiDraw без відкриття портів (`serial_guess_axidraw_port`).
  * @param dev Пристрій.
  * @param buf [out] Буфер для шляху.
  * @param len Розмір буфера.
@@ -579,7 +603,6 @@ static int axidraw_guess_port (axidraw_device_t *dev, char *buf, size_t len) {
         return -1;
     if (dev->port_path[0])
         return 0;
-#ifdef __APPLE__
     if (serial_guess_axidraw_port (buf, len) == 0) {
         strncpy (dev->port_path, buf, sizeof (dev->port_path) - 1);
         dev->port_path[sizeof (dev->port_path) - 1] = '\0';
@@ -587,12 +610,19 @@ static int axidraw_guess_port (axidraw_device_t *dev, char *buf, size_t len) {
         log_print (LOG_INFO, "пристрій: автоматично знайдено порт %s", dev->port_path);
         return 0;
     }
-#endif
     LOGW (AXIDRAW_LOG ("Не вдалося автоматично знайти порт"));
     log_print (LOG_WARN, "пристрій: автоматичний пошук порту не дав результату");
     return -1;
 }
 
+/**
+ * @copydoc axidraw_device_resolve_port
+ */
+int axidraw_device_resolve_port (axidraw_device_t *dev) {
+    char guess_buf[256] = { 0 };
+    return axidraw_guess_port (dev, guess_buf, sizeof (guess_buf));
+}
+
 /**
  * @brief Встановлює з'єднання з контролером EBB і перевіряє відповідь.
  * @param dev Пристрій.
@@ -653,6 +683,8 @@ void axidraw_device_disconnect (axidraw_device_t *dev) {
     if (!dev)
         return;
     if (dev->port) {
+        (void)axidraw_pipeline_sync (dev);
+        dev->pipelined = false;
         serial_close (dev->port);
         dev->port = NULL;
         LOGI (AXIDRAW_LOG ("Відключено від %s"), dev->port_path);
@@ -668,9 +700,53 @@ void axidraw_device_disconnect (axidraw_device_t *dev) {
  * @return 0 — успіх, -1 — помилка.
  */
 int axidraw_device_lock_acquire (int *out_fd) {
+    return axidraw_device_lock_acquire_port (NULL, out_fd);
+}
+
+/**
+ * @copydoc axidraw_device_lock_path
+ */
+int axidraw_device_lock_path (const char *port_path, char *buf, size_t len) {
+    if (!buf || len == 0)
+        return -1;
+    const char *global = axidraw_lock_path ();
+    if (!port_path || !port_path[0]) {
+        if (strlen (global) >= len)
+            return -1;
+        snprintf (buf, len, "%s", global);
+        return 0;
+    }
+    /* Ключ — імʼя вузла пристрою після розкриття символьних посилань: той самий
+     * плотер через /dev/serial/by-id/... і /dev/ttyACM0 отримує один lock. */
+    char real[PATH_MAX];
+    const char *key = realpath (port_path, real) ? real : port_path;
+    const char *slash = strrchr (key, '/');
+    if (slash && slash[1])
+        key = slash + 1;
+    char safe[128];
+    size_t n = 0;
+    for (; key[n] && n + 1 < sizeof (safe); ++n) {
+        unsigned char c = (unsigned char)key[n];
+        safe[n] = (isalnum (c) || c == '.' || c == '_' || c == '-') ? (char)c : '_';
+    }
+    safe[n] = '\0';
+    /* Глобальний шлях закінчується на ".lock": ключ вставляється перед суфіксом. */
+    size_t stem = strlen (global) - strlen (".lock");
+    int written = snprintf (buf, len, "%.*s-%s.lock", (int)stem, global, safe);
+    return (written < 0 || (size_t)written >= len) ? -1 : 0;
+}
+
+/**
+ * @copydoc axidraw_device_lock_acquire_port
+ */
+int axidraw_device_lock_acquire_port (const char *port_path, int *out_fd) {
     if (!out_fd)
         return -1;
-    const char *lock_path = axidraw_lock_path ();
+    char lock_path[PATH_MAX];
+    if (axidraw_device_lock_path (port_path, lock_path, sizeof (lock_path)) != 0) {
+        log_print (LOG_ERROR, "axidraw lock: задовгий шлях lock-файлу для %s", port_path);
+        return -1;
+    }
     int fd = open (lock_path, O_RDWR | O_CREAT, 0600);
     if (fd < 0) {
         log_print (LOG_ERROR, "axidraw lock: не вдалося відкрити %s", lock_path);
@@ -716,8 +792,14 @@ const char *axidraw_device_lock_file (void) { return axidraw_lock_path (); }
  * @return 0 — успіх, -1 — помилка.
  */
 int axidraw_emergency_stop (axidraw_device_t *dev) {
-    if (axidraw_require_connection (dev) != 0)
+    if (axidraw_check_connection (dev) != 0)
         return -1;
+    if (dev->pipelined && dev->pipeline.count > 0) {
+        /* Непідтверджені OK більше не потрібні: ES скасовує FIFO разом із ними. */
+        serial_discard_output (dev->port);
+        ebb_pipeline_abandon (&dev->pipeline);
+        (void)serial_flush_input (dev->port);
+    }
     int rc = ebb_emergency_stop (dev->port, dev->timeout_ms);
     if (rc == 0) {
         axidraw_reset_runtime (dev);
@@ -768,6 +850,52 @@ void axidraw_set_fifo_limit (axidraw_device_t *dev, size_t max_fifo_commands) {
     }
 }
 
+/** @copydoc axidraw_set_pipelined */
+void axidraw_set_pipelined (axidraw_device_t *dev, bool enable) {
+    if (!dev)
+        return;
+    if (!enable) {
+        (void)axidraw_pipeline_sync (dev);
+        dev->pipelined = false;
+        return;
+    }
+    if (axidraw_check_connection (dev) != 0)
+        return;
+    ebb_pipeline_init (&dev->pipeline, dev->port, dev->max_fifo_commands, dev->timeout_ms);
+    dev->pipelined = true;
+    LOGD (AXIDRAW_LOG ("Конвеєр команд: глибина %zu"), dev->pipeline.depth);
+    log_print (LOG_INFO, "конвеєр: увімкнено, глибина %zu", dev->pipeline.depth);
+}
+
+/** @copydoc axidraw_set_command_tag */
+void axidraw_set_command_tag (axidraw_device_t *dev, unsigned long tag) {
+    if (dev)
+        dev->command_tag = tag;
+}
+
+/** @copydoc axidraw_pipeline_acked_tag */
+bool axidraw_pipeline_acked_tag (const axidraw_device_t *dev, unsigned long *out_tag) {
+    if (!dev || !dev->pipelined || dev->pipeline.acked == 0)
+        return false;
+    if (out_tag)
+        *out_tag = dev->pipeline.acked_tag;
+    return true;
+}
+
+/** @copydoc axidraw_pipeline_sync */
+int axidraw_pipeline_sync (axidraw_device_t *dev) {
+    if (!dev || !dev->pipelined)
+        return 0;
+    if (ebb_pipeline_drain (&dev->pipeline) == 0)
+        return 0;
+    LOGE (
+        AXIDRAW_LOG ("Конвеєр команд зупинено на блоці №%lu"), dev->pipeline.failed_tag);
+    log_print (
+        LOG_ERROR, "конвеєр: помилка на блоці №%lu (надіслано %lu, підтверджено %lu)",
+        dev->pipeline.failed_tag, dev->pipeline.sent, dev->pipeline.acked);
+    return -1;
+}
+
 /**
  * @brief Перетворює відсоток (0–100) у імпульс серво (ticks).
  * @param percent Значення у відсотках.
@@ -806,7 +934,7 @@ static int axidraw_speed_to_rate (int speed_percent) {
  * @param dev Пристрій.
  * @return 0 — ок, -1 — немає зʼєднання.
  */
-static int axidraw_require_connection (axidraw_device_t *dev) {
+static int axidraw_check_connection (axidraw_device_t *dev) {
     if (!dev || !dev->connected || !dev->port) {
         LOGE (AXIDRAW_LOG ("Пристрій не підключено"));
         log_print (LOG_ERROR, "axidraw: пристрій не підключено");
@@ -815,6 +943,161 @@ static int axidraw_require_connection (axidraw_device_t *dev) {
     return 0;
 }
 
+/**
+ * @brief Перевіряє зʼєднання і дочікується відповідей конвеєра.
+ * @details Потрібно перед будь-якою командою з синхронною відповіддю, інакше
+ *          OK конвеєрних команд переплутаються з її відповіддю.
+ * @param dev Пристрій.
+ * @return 0 — ок, -1 — немає зʼєднання або конвеєр зламано.
+ */
+static int axidraw_require_connection (axidraw_device_t *dev) {
+    if (axidraw_check_connection (dev) != 0)
+        return -1;
+    return axidraw_pipeline_sync (dev);
+}
+
+/**
+ * @brief Поточний монотонний час у мілісекундах.
+ * @param out [out] Час.
+ * @return true — успіх, false — годинник недоступний.
+ */
+static bool axidraw_now_ms (double *out) {
+    struct timespec ts;
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+        return false;
+    *out = (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+    return true;
+}
+
+/**
+ * @brief Тривалість LM за параметрами осі (інтервали по 40 мкс).
+ * @details Позиція після n інтервалів: rate·n + accel·n²/2 (у 2^31 частках кроку).
+ * @return Кількість інтервалів (за гальмування до нуля раніше цілі — до зупинки) або -1.
+ */
+static double axidraw_lm_axis_intervals (uint32_t rate, int32_t steps, int32_t accel) {
+    if (steps == 0)
+        return 0.0;
+    double target = fabs ((double)steps) * 2147483648.0;
+    double r = (double)rate;
+    double a = (double)accel;
+    if (accel == 0)
+        return (rate > 0) ? target / r : -1.0;
+    double disc = r * r + 2.0 * a * target;
+    /* Гальмування до нуля: через округлення параметрів дискримінант буває трохи
+     * відʼємним — рух триває до зупинки осі. */
+    if (disc < 0.0)
+        return (a < 0.0 && rate > 0) ? -r / a : -1.0;
+    double n = (sqrt (disc) - r) / a;
+    return (n > 0.0 && isfinite (n)) ? n : -1.0;
+}
+
+/**
+ * @brief Прогнозована тривалість LM у мс.
+ * @return Тривалість (мс) або -1, якщо обчислити не вдалося.
+ */
+static double axidraw_lm_duration_ms (
+    uint32_t rate1, int32_t steps1, int32_t accel1, uint32_t rate2, int32_t steps2, int32_t accel2) {
+    double n1 = axidraw_lm_axis_intervals (rate1, steps1, accel1);
+    double n2 = axidraw_lm_axis_intervals (rate2, steps2, accel2);
+    if (n1 < 0.0 || n2 < 0.0)
+        return -1.0;
+    return fmax (n1, n2) * AXIDRAW_LL_INTERVAL_SEC * 1000.0;
+}
+
+/**
+ * @brief Прибирає з моделі FIFO команди, що за прогнозом уже завершились.
+ * @param dev Пристрій.
+ * @param now_ms Поточний час (мс).
+ */
+static void axidraw_fifo_expire (axidraw_device_t *dev, double now_ms) {
+    axidraw_fifo_model_t *m = &dev->fifo;
+    while (m->count > 0 && m->done_at_ms[m->head] <= now_ms) {
+        m->head = (m->head + 1) % AXIDRAW_FIFO_MODEL_MAX;
+        --m->count;
+    }
+    if (m->valid)
+        dev->pending_commands = m->count;
+}
+
+/**
+ * @brief Додає відправлену команду до моделі FIFO.
+ * @param dev Пристрій.
+ * @param duration_ms Тривалість виконання (мс); <0 — невідома (модель стає недійсною).
+ */
+static void axidraw_fifo_push (axidraw_device_t *dev, double duration_ms) {
+    axidraw_fifo_model_t *m = &dev->fifo;
+    double now_ms;
+    if (duration_ms < 0.0 || !axidraw_now_ms (&now_ms)) {
+        m->valid = false;
+        return;
+    }
+    /* У режимі конвеєра слот не очікується, тож завершені команди прибираються тут. */
+    axidraw_fifo_expire (dev, now_ms);
+    if (m->count == AXIDRAW_FIFO_MODEL_MAX) {
+        m->valid = false;
+        return;
+    }
+    if (m->valid && m->tail_ms > 0.0)
+        telemetry_idle (now_ms - m->tail_ms);
+    double start = fmax (now_ms, m->tail_ms);
+    m->tail_ms = start + duration_ms;
+    m->done_at_ms[(m->head + m->count) % AXIDRAW_FIFO_MODEL_MAX] = m->tail_ms;
+    ++m->count;
+}
+
+/**
+ * @brief Спить до прогнозованого спорожнення FIFO контролера (плюс невеликий запас).
+ * @param dev Пристрій.
+ * @param budget_ms Найдовше очікування (мс).
+ * @return Проспаний час (мс); 0 — модель недійсна або черга за прогнозом порожня.
+ */
+static double axidraw_fifo_sleep_until_drained (axidraw_device_t *dev, double budget_ms) {
+    axidraw_fifo_model_t *m = &dev->fifo;
+    double now_ms;
+    if (!m->valid || !axidraw_now_ms (&now_ms))
+        return 0.0;
+    axidraw_fifo_expire (dev, now_ms);
+    if (m->count == 0)
+        return 0.0;
+    double wait_ms = fmin (m->tail_ms - now_ms + AXIDRAW_IDLE_MARGIN_MS, budget_ms);
+    if (wait_ms <= 0.0)
+        return 0.0;
+    struct timespec ts = {
+        .tv_sec = (time_t)(wait_ms / 1000.0),
+        .tv_nsec = (long)(fmod (wait_ms, 1000.0) * 1e6),
+    };
+    TRACE_LOG (TRACE_QUEUE_PREDICT, wait_ms);
+    nanosleep (&ts, NULL);
+    if (axidraw_now_ms (&now_ms))
+        axidraw_fifo_expire (dev, now_ms);
+    return wait_ms;
+}
+
+/**
+ * @brief Звіряє модель FIFO з фактичною кількістю команд, повернутою `QM`.
+ * @details Залишаються найновіші `actual` прогнозів; якщо їх менше — модель недійсна
+ *          до моменту, коли контролер повністю спорожніє.
+ * @param dev Пристрій.
+ * @param actual Кількість активних і чергових команд за `QM`.
+ */
+static void axidraw_fifo_resync (axidraw_device_t *dev, size_t actual) {
+    axidraw_fifo_model_t *m = &dev->fifo;
+    double now_ms = 0.0;
+    (void)axidraw_now_ms (&now_ms);
+    while (m->count > actual) {
+        m->head = (m->head + 1) % AXIDRAW_FIFO_MODEL_MAX;
+        --m->count;
+    }
+    if (actual == 0) {
+        m->count = 0;
+        m->tail_ms = now_ms;
+        m->valid = true;
+    } else {
+        m->valid = m->valid && m->count == actual;
+    }
+    m->predicted_waits = 0;
+}
+
 /**
  * @brief Оновлює внутрішню оцінку зайнятості FIFO команд.
  * @param dev Пристрій.
@@ -835,12 +1118,45 @@ static int axidraw_refresh_queue (axidraw_device_t *dev) {
     size_t queued = status.fifo_pending > 0 ? (size_t)status.fifo_pending : 0u;
     size_t active = status.command_active ? 1u : 0u;
     dev->pending_commands = queued + active;
-    log_print (
-        LOG_DEBUG, "черга: активні=%zu у_черзі=%zu (разом %zu)", active, queued,
-        dev->pending_commands);
+    axidraw_fifo_resync (dev, dev->pending_commands);
+    TRACE_LOG (TRACE_QUEUE_STATUS, active, queued, dev->pending_commands);
     return 0;
 }
 
+/**
+ * @brief Очікує місця в FIFO за прогнозом моделі, без запиту `QM`.
+ * @details Спить до прогнозованого завершення команди, що звільнить слот. Раз на
+ *          `AXIDRAW_FIFO_RESYNC_INTERVAL` очікувань (або коли модель недійсна чи
+ *          прогноз виходить за тайм-аут) повертає 1, і викликальник звіряється з `QM`.
+ * @param dev Пристрій.
+ * @param now_ms Поточний час (мс).
+ * @return 0 — слот звільнився за прогнозом; 1 — потрібне опитування `QM`.
+ */
+static int axidraw_fifo_wait_predicted (axidraw_device_t *dev, double now_ms) {
+    axidraw_fifo_model_t *m = &dev->fifo;
+    if (!m->valid || m->count < dev->max_fifo_commands
+        || m->predicted_waits >= AXIDRAW_FIFO_RESYNC_INTERVAL)
+        return 1;
+    size_t idx = (m->head + m->count - dev->max_fifo_commands) % AXIDRAW_FIFO_MODEL_MAX;
+    double wait_ms = m->done_at_ms[idx] - now_ms;
+    if (wait_ms > (double)dev->timeout_ms)
+        return 1;
+    if (wait_ms > 0.0) {
+        struct timespec ts = {
+            .tv_sec = (time_t)(wait_ms / 1000.0),
+            .tv_nsec = (long)(fmod (wait_ms, 1000.0) * 1e6),
+        };
+        TRACE_LOG (TRACE_QUEUE_PREDICT, wait_ms);
+        nanosleep (&ts, NULL);
+    }
+    if (axidraw_now_ms (&now_ms))
+        axidraw_fifo_expire (dev, now_ms);
+    ++m->predicted_waits;
+    if (dev->pending_commands < dev->max_fifo_commands)
+        return 0;
+    return 1;
+}
+
 /**
  * @brief Очікує, доки зʼявиться місце у черзі команд.
  * @param dev Пристрій.
@@ -851,17 +1167,26 @@ static int axidraw_wait_queue_slot (axidraw_device_t *dev) {
         return -1;
     if (dev->max_fifo_commands == 0)
         return 0;
+    double now_ms = 0.0;
+    if (dev->fifo.valid && axidraw_now_ms (&now_ms))
+        axidraw_fifo_expire (dev, now_ms);
     if (dev->pending_commands < dev->max_fifo_commands)
         return 0;
 
-    log_print (
-        LOG_DEBUG, "черга: очікування місця (%zu/%zu)", dev->pending_commands,
-        dev->max_fifo_commands);
+    TRACE_LOG (TRACE_QUEUE_WAIT, dev->pending_commands, dev->max_fifo_commands);
+
+    uint64_t wait_start = telemetry_now ();
+    if (axidraw_fifo_wait_predicted (dev, now_ms) == 0) {
+        telemetry_wait (TELEMETRY_WAIT_FIFO, wait_start);
+        return 0;
+    }
 
     if (axidraw_refresh_queue (dev) != 0)
         return -1;
-    if (dev->pending_commands < dev->max_fifo_commands)
+    if (dev->pending_commands < dev->max_fifo_commands) {
+        telemetry_wait (TELEMETRY_WAIT_FIFO, wait_start);
         return 0;
+    }
 
     struct timespec start;
     bool have_clock = clock_gettime (CLOCK_MONOTONIC, &start) == 0;
@@ -870,13 +1195,8 @@ static int axidraw_wait_queue_slot (axidraw_device_t *dev) {
 
     while (dev->pending_commands >= dev->max_fifo_commands) {
         if (!logged) {
-            LOGD (
-                "axidraw: очікування FIFO (%zu/%zu)", dev->pending_commands,
-                dev->max_fifo_commands);
             logged = true;
-            log_print (
-                LOG_DEBUG, "черга: ще зайнято (%zu/%zu)", dev->pending_commands,
-                dev->max_fifo_commands);
+            TRACE_LOG (TRACE_QUEUE_BUSY, dev->pending_commands, dev->max_fifo_commands);
         }
         nanosleep (&sleep_ts, NULL);
         if (axidraw_refresh_queue (dev) != 0)
@@ -896,10 +1216,9 @@ static int axidraw_wait_queue_slot (axidraw_device_t *dev) {
         }
     }
 
-    log_print (
-        LOG_DEBUG, "черга: місце отримано (%zu/%zu)", dev->pending_commands,
-        dev->max_fifo_commands);
+    TRACE_LOG (TRACE_QUEUE_SLOT, dev->pending_commands, dev->max_fifo_commands);
 
+    telemetry_wait (TELEMETRY_WAIT_FIFO, wait_start);
     return 0;
 }
 
@@ -918,26 +1237,30 @@ static int axidraw_wait_interval (axidraw_device_t *dev) {
 
     struct timespec now;
     bool logged = false;
+    uint64_t wait_start = 0;
     while (1) {
         if (clock_gettime (CLOCK_MONOTONIC, &now) != 0)
-            return 0;
+            break;
         double elapsed = time_diff_ms (&now, &dev->last_cmd);
         if (elapsed >= dev->min_cmd_interval)
-            return 0;
+            break;
         double remaining = dev->min_cmd_interval - elapsed;
         if (remaining <= 0.0)
-            return 0;
+            break;
+        if (!wait_start)
+            wait_start = telemetry_now ();
         long ms_whole = (long)remaining;
         long ns_part = (long)((remaining - (double)ms_whole) * 1e6);
         struct timespec ts
             = { .tv_sec = ms_whole / 1000, .tv_nsec = (ms_whole % 1000) * 1000000L + ns_part };
         if (!logged) {
-            LOGD (AXIDRAW_LOG ("Затримка %.2f мс перед наступною командою"), remaining);
             logged = true;
-            log_print (LOG_DEBUG, "частота: очікування %.2f мс", remaining);
+            TRACE_LOG (TRACE_RATE_WAIT, remaining);
         }
         nanosleep (&ts, NULL);
     }
+    telemetry_wait (TELEMETRY_WAIT_RATE, wait_start);
+    return 0;
 }
 
 /**
@@ -950,23 +1273,25 @@ static int axidraw_wait_slot (axidraw_device_t *dev) {
         return -1;
     if (axidraw_wait_interval (dev) != 0)
         return -1;
-    log_print (LOG_DEBUG, "axidraw: слот доступний для наступної команди");
+    TRACE_LOG (TRACE_SLOT_READY);
     return 0;
 }
 
 /**
  * @brief Позначає, що команда відправлена (оновлює last_cmd/FIFO).
  * @param dev Пристрій.
+ * @param duration_ms Тривалість виконання команди (мс); <0 — невідома.
  */
-static void axidraw_mark_dispatched (axidraw_device_t *dev) {
+static void axidraw_mark_dispatched (axidraw_device_t *dev, double duration_ms) {
     if (!dev)
         return;
+    axidraw_fifo_push (dev, duration_ms);
     struct timespec now;
     if (clock_gettime (CLOCK_MONOTONIC, &now) == 0)
         dev->last_cmd = now;
     if (dev->pending_commands < SIZE_MAX)
         ++dev->pending_commands;
-    log_print (LOG_DEBUG, "черга: відправлено, у черзі %zu", dev->pending_commands);
+    TRACE_LOG (TRACE_QUEUE_DISPATCHED, dev->pending_commands);
 }
 
 /**
@@ -1054,21 +1379,27 @@ static void axidraw_sync_settings (axidraw_device_t *dev) {
  * @brief Виконує команду підняття/опускання пера з урахуванням затримки.
  * @param dev Пристрій.
  * @param pen_up true — підняти, false — опустити.
+ * @param delay_ms Затримка, мс (< 0 — з налаштувань).
  * @return 0 — успіх, -1 — помилка.
  */
-static int axidraw_exec_pen (axidraw_device_t *dev, bool pen_up) {
-    if (axidraw_require_connection (dev) != 0)
+static int axidraw_exec_pen (axidraw_device_t *dev, bool pen_up, int delay_ms) {
+    bool pipelined = dev && dev->pipelined;
+    if ((pipelined ? axidraw_check_connection (dev) : axidraw_require_connection (dev)) != 0)
         return -1;
-    if (axidraw_wait_slot (dev) != 0)
+    /* Конвеєр сам обмежує кількість непідтверджених команд — без опитування QM. */
+    if ((pipelined ? axidraw_wait_interval (dev) : axidraw_wait_slot (dev)) != 0)
         return -1;
-    int delay_ms = pen_up ? dev->settings.pen_up_delay_ms : dev->settings.pen_down_delay_ms;
+    if (delay_ms < 0)
+        delay_ms = pen_up ? dev->settings.pen_up_delay_ms : dev->settings.pen_down_delay_ms;
     if (delay_ms < 0)
         delay_ms = 0;
     LOGD (AXIDRAW_LOG ("Перо %s (затримка %d мс)"), pen_up ? "вгору" : "вниз", delay_ms);
     log_print (LOG_DEBUG, "axidraw pen: %s delay=%d", pen_up ? "up" : "down", delay_ms);
-    int rc = ebb_pen_set (dev->port, pen_up, delay_ms, -1, dev->timeout_ms);
+    int rc = pipelined
+                 ? ebb_pipeline_pen_set (&dev->pipeline, dev->command_tag, pen_up, delay_ms, -1)
+                 : ebb_pen_set (dev->port, pen_up, delay_ms, -1, dev->timeout_ms);
     if (rc == 0) {
-        axidraw_mark_dispatched (dev);
+        axidraw_mark_dispatched (dev, (double)delay_ms);
         log_print (LOG_DEBUG, "axidraw pen: команда успішна");
     } else {
         LOGE (AXIDRAW_LOG ("Команда пера повернула помилку (%d)"), rc);
@@ -1082,14 +1413,33 @@ static int axidraw_exec_pen (axidraw_device_t *dev, bool pen_up) {
  * @param dev Пристрій.
  * @return 0 — успіх, -1 — помилка.
  */
-int axidraw_pen_up (axidraw_device_t *dev) { return axidraw_exec_pen (dev, true); }
+int axidraw_pen_up (axidraw_device_t *dev) { return axidraw_exec_pen (dev, true, -1); }
 
 /**
  * @brief Опускає перо (викликає EBB через pen_set).
  * @param dev Пристрій.
  * @return 0 — успіх, -1 — помилка.
  */
-int axidraw_pen_down (axidraw_device_t *dev) { return axidraw_exec_pen (dev, false); }
+int axidraw_pen_down (axidraw_device_t *dev) { return axidraw_exec_pen (dev, false, -1); }
+
+/**
+ * @copydoc axidraw_pen_set
+ */
+int axidraw_pen_set (axidraw_device_t *dev, bool pen_up, int delay_ms) {
+    return axidraw_exec_pen (dev, pen_up, delay_ms);
+}
+
+/**
+ * @copydoc axidraw_pen_overlap_ms
+ */
+int axidraw_pen_overlap_ms (const axidraw_settings_t *settings, bool pen_up) {
+    if (!settings || settings->pen_lead_ms <= 0)
+        return 0;
+    int delay_ms = pen_up ? settings->pen_up_delay_ms : settings->pen_down_delay_ms;
+    if (delay_ms <= 0)
+        return 0;
+    return settings->pen_lead_ms < delay_ms ? settings->pen_lead_ms : delay_ms;
+}
 
 /**
  * @brief Увімкнути мотори з заданими режимами мікрокроку.
@@ -1249,7 +1599,7 @@ static int axidraw_exec_sm (
     log_print (LOG_DEBUG, "axidraw SM: duration=%u a=%d b=%d", duration, a, b);
     int rc = fn (dev->port, duration, a, b, dev->timeout_ms);
     if (rc == 0) {
-        axidraw_mark_dispatched (dev);
+        axidraw_mark_dispatched (dev, (double)duration);
         log_print (LOG_DEBUG, "axidraw SM: команда успішна");
     } else {
         LOGE (AXIDRAW_LOG ("Команда руху повернула помилку (%d)"), rc);
@@ -1288,7 +1638,7 @@ int axidraw_move_corexy (
     log_print (LOG_DEBUG, "axidraw XM: duration=%u a=%d b=%d", duration_ms, steps_a, steps_b);
     int rc = ebb_move_mixed (dev->port, duration_ms, steps_a, steps_b, dev->timeout_ms);
     if (rc == 0) {
-        axidraw_mark_dispatched (dev);
+        axidraw_mark_dispatched (dev, (double)duration_ms);
         log_print (LOG_DEBUG, "axidraw XM: команда успішна");
     } else {
         LOGE (AXIDRAW_LOG ("Команда XM повернула помилку (%d)"), rc);
@@ -1318,19 +1668,24 @@ int axidraw_move_lowlevel (
     int32_t steps2,
     int32_t accel2,
     int clear_flags) {
-    if (axidraw_require_connection (dev) != 0)
+    bool pipelined = dev && dev->pipelined;
+    if ((pipelined ? axidraw_check_connection (dev) : axidraw_require_connection (dev)) != 0)
         return -1;
-    if (axidraw_wait_slot (dev) != 0)
+    /* Конвеєр сам обмежує кількість непідтверджених команд — без опитування QM. */
+    if ((pipelined ? axidraw_wait_interval (dev) : axidraw_wait_slot (dev)) != 0)
         return -1;
-    LOGD (AXIDRAW_LOG ("LM rate1=%u steps1=%d rate2=%u steps2=%d"), rate1, steps1, rate2, steps2);
-    log_print (
-        LOG_DEBUG, "axidraw LM: rate1=%u steps1=%d accel1=%d rate2=%u steps2=%d accel2=%d flags=%d",
-        rate1, steps1, accel1, rate2, steps2, accel2, clear_flags);
-    int rc = ebb_move_lowlevel_steps (
-        dev->port, rate1, steps1, accel1, rate2, steps2, accel2, clear_flags, dev->timeout_ms);
+    TRACE_LOG (TRACE_AXI_LM, rate1, steps1, accel1, rate2, steps2, accel2, clear_flags);
+    int rc = pipelined
+                 ? ebb_pipeline_move_lowlevel_steps (
+                     &dev->pipeline, dev->command_tag, rate1, steps1, accel1, rate2, steps2,
+                     accel2, clear_flags)
+                 : ebb_move_lowlevel_steps (
+                     dev->port, rate1, steps1, accel1, rate2, steps2, accel2, clear_flags,
+                     dev->timeout_ms);
     if (rc == 0) {
-        axidraw_mark_dispatched (dev);
-        log_print (LOG_DEBUG, "axidraw LM: команда успішна");
+        axidraw_mark_dispatched (
+            dev, axidraw_lm_duration_ms (rate1, steps1, accel1, rate2, steps2, accel2));
+        TRACE_LOG (TRACE_AXI_LM_OK);
     } else {
         LOGE (AXIDRAW_LOG ("Команда LM повернула помилку (%d)"), rc);
         log_print (LOG_ERROR, "axidraw LM: помилка %d", rc);
@@ -1361,15 +1716,12 @@ int axidraw_move_lowlevel_time (
         return -1;
     if (axidraw_wait_slot (dev) != 0)
         return -1;
-    LOGD (AXIDRAW_LOG ("LT intervals=%u rate1=%d rate2=%d"), intervals, rate1, rate2);
-    log_print (
-        LOG_DEBUG, "axidraw LT: intervals=%u rate1=%d accel1=%d rate2=%d accel2=%d flags=%d",
-        intervals, rate1, accel1, rate2, accel2, clear_flags);
+    TRACE_LOG (TRACE_AXI_LT, intervals, rate1, accel1, rate2, accel2, clear_flags);
     int rc = ebb_move_lowlevel_time (
         dev->port, intervals, rate1, accel1, rate2, accel2, clear_flags, dev->timeout_ms);
     if (rc == 0) {
-        axidraw_mark_dispatched (dev);
-        log_print (LOG_DEBUG, "axidraw LT: команда успішна");
+        axidraw_mark_dispatched (dev, (double)intervals * AXIDRAW_LL_INTERVAL_SEC * 1000.0);
+        TRACE_LOG (TRACE_AXI_LT_OK);
     } else {
         LOGE (AXIDRAW_LOG ("Команда LT повернула помилку (%d)"), rc);
         log_print (LOG_ERROR, "axidraw LT: помилка %d", rc);
@@ -1399,7 +1751,7 @@ int axidraw_home (
         pos2 ? *pos2 : 0);
     int rc = ebb_home_move (dev->port, step_rate, pos1, pos2, dev->timeout_ms);
     if (rc == 0) {
-        axidraw_mark_dispatched (dev);
+        axidraw_mark_dispatched (dev, -1.0);
         log_print (LOG_DEBUG, "пристрій HM: команда успішна");
     } else {
         LOGE (AXIDRAW_LOG ("Команда HM повернула помилку (%d)"), rc);
@@ -17,6 +17,7 @@
 #include <time.h>
 
 #include "config.h"
+#include "ebb.h"
 #include "serial.h"
 
 /** Повідомлення про відсутній порт у конфігурації. */
@@ -36,6 +37,10 @@ typedef struct {
     double speed_mm_s;
     double accel_mm_s2;
     double steps_per_mm;
+    int pen_lead_max_ms;
+    double pen_hop_max_mm;
+    double travel_speed_mm_s;
+    double travel_accel_mm_s2;
 } axidraw_device_profile_t;
 
 /** Повертає типовий профіль пристрою. */
@@ -62,6 +67,7 @@ typedef struct {
     size_t fifo_limit;
     int pen_up_delay_ms;
     int pen_down_delay_ms;
+    int pen_lead_ms;
     int pen_up_pos;
     int pen_down_pos;
     int pen_up_speed;
@@ -72,6 +78,25 @@ typedef struct {
     double steps_per_mm;
 } axidraw_settings_t;
 
+/** Кількість команд, для яких модель FIFO відстежує прогнозований час завершення. */
+#define AXIDRAW_FIFO_MODEL_MAX 32
+
+/**
+ * @brief Модель FIFO контролера: прогноз завершення команд за їхньою тривалістю.
+ * @details Кожна відправлена команда руху/пера стає в чергу за попередньою; коли її
+ *          тривалість відома (SM/XM/LM/LT/SP), момент завершення передбачається без
+ *          запиту `QM`. Команди з невідомою тривалістю (HM) роблять модель недійсною
+ *          до наступної синхронізації через `QM`.
+ */
+typedef struct {
+    double done_at_ms[AXIDRAW_FIFO_MODEL_MAX]; /**< Прогноз завершення (CLOCK_MONOTONIC, мс). */
+    size_t head;                               /**< Індекс найстарішої команди. */
+    size_t count;                              /**< Кількість незавершених команд. */
+    double tail_ms;                            /**< Прогноз завершення останньої команди. */
+    bool valid;                                /**< false — потрібна синхронізація через QM. */
+    unsigned predicted_waits;                  /**< Очікувань за прогнозом від останнього QM. */
+} axidraw_fifo_model_t;
+
 /**
  * @brief Екземпляр підключеного пристрою AxiDraw.
  */
@@ -84,8 +109,12 @@ typedef struct {
     struct timespec last_cmd;
     size_t max_fifo_commands;
     size_t pending_commands;
+    axidraw_fifo_model_t fifo;
     axidraw_settings_t settings;
     bool connected;
+    ebb_pipeline_t pipeline;    /**< Конвеєр LM/SP без очікування OK на кожну команду. */
+    bool pipelined;             /**< true — LM/SP надсилаються через `pipeline`. */
+    unsigned long command_tag;  /**< Номер блоку для діагностики відповідей конвеєра. */
 } axidraw_device_t;
 
 /** Режими мікрокроку моторів AxiDraw. */
@@ -151,13 +180,40 @@ int axidraw_device_connect (axidraw_device_t *dev, char *errbuf, size_t errlen);
 /** Розриває зʼєднання з пристроєм. */
 void axidraw_device_disconnect (axidraw_device_t *dev);
 
-/** Захоплює lock-файл для ексклюзивного доступу. */
+/**
+ * @brief Доповнює порожній шлях порту автоматично знайденим (як `axidraw_device_connect`).
+ * @details Дає змогу захопити lock порту до підключення.
+ * @param dev Пристрій.
+ * @return 0 — порт відомий; -1 — не вказано і не знайдено.
+ */
+int axidraw_device_resolve_port (axidraw_device_t *dev);
+
+/** Захоплює загальний lock-файл (для пристрою з невідомим портом). */
 int axidraw_device_lock_acquire (int *out_fd);
 
+/**
+ * @brief Шлях до lock-файлу порту: `$TMPDIR/cplot-axidraw-<вузол>.lock`.
+ * @details Вузол — імʼя файлу пристрою після розкриття посилань, тож різні шляхи до
+ *          одного плотера дають один lock. Порожній порт — загальний lock-файл.
+ * @param port_path Шлях до порту (NULL або порожній — загальний).
+ * @param buf [out] Буфер.
+ * @param len Розмір буфера.
+ * @return 0 — успіх; -1 — замалий буфер.
+ */
+int axidraw_device_lock_path (const char *port_path, char *buf, size_t len);
+
+/**
+ * @brief Захоплює lock-файл порту: різні плотери працюють паралельно, один — ексклюзивно.
+ * @param port_path Шлях до порту (NULL або порожній — загальний lock).
+ * @param out_fd [out] Дескриптор lock-файлу.
+ * @return 0 — успіх, -1 — зайнято або помилка.
+ */
+int axidraw_device_lock_acquire_port (const char *port_path, int *out_fd);
+
 /** Звільняє lock-файл. */
 void axidraw_device_lock_release (int fd);
 
-/** Шлях до lock-файлу пристрою. */
+/** Шлях до загального lock-файлу пристрою. */
 const char *axidraw_device_lock_file (void);
 
 /** Негайна зупинка усіх рухів. */
@@ -172,12 +228,60 @@ void axidraw_set_rate_limit (axidraw_device_t *dev, double min_interval_ms);
 /** Обмежує максимальну кількість команд у FIFO. */
 void axidraw_set_fifo_limit (axidraw_device_t *dev, size_t max_fifo_commands);
 
+/**
+ * @brief Вмикає/вимикає конвеєрну відправку LM і SP.
+ * @details У конвеєрному режимі команди руху та пера пишуться в порт без очікування
+ *          OK на кожну; непідтверджених команд не більше за ліміт FIFO. Будь-яка інша
+ *          команда (запити, EM, HM тощо) спершу дочікується всіх відповідей.
+ * @param dev Підключений пристрій.
+ * @param enable true — увімкнути; false — дочекатися відповідей і вимкнути.
+ */
+void axidraw_set_pipelined (axidraw_device_t *dev, bool enable);
+
+/** Задає номер блоку, яким позначаються наступні команди конвеєра. */
+void axidraw_set_command_tag (axidraw_device_t *dev, unsigned long tag);
+
+/**
+ * @brief Дочікується підтвердження всіх команд конвеєра.
+ * @param dev Пристрій.
+ * @return 0 — усі команди підтверджено; -1 — помилка/тайм-аут (номер блоку в журналі).
+ */
+int axidraw_pipeline_sync (axidraw_device_t *dev);
+
+/**
+ * @brief Номер блоку останньої команди конвеєра, яку контролер підтвердив (OK).
+ * @param dev Пристрій.
+ * @param out_tag [out] Номер блоку.
+ * @return true — номер відомий; false — конвеєр вимкнено або ще нічого не підтверджено.
+ */
+bool axidraw_pipeline_acked_tag (const axidraw_device_t *dev, unsigned long *out_tag);
+
 /** Команда підняття пера. */
 int axidraw_pen_up (axidraw_device_t *dev);
 
 /** Команда опускання пера. */
 int axidraw_pen_down (axidraw_device_t *dev);
 
+/**
+ * @brief Команда пера з явною затримкою перед наступною командою FIFO.
+ * @param dev Пристрій.
+ * @param pen_up true — підняти, false — опустити.
+ * @param delay_ms Затримка, мс (< 0 — з налаштувань, як `axidraw_pen_up`/`axidraw_pen_down`).
+ * @return 0 — успіх, -1 — помилка.
+ */
+int axidraw_pen_set (axidraw_device_t *dev, bool pen_up, int delay_ms);
+
+/**
+ * @brief Частина затримки пера, яку можна перекрити переїздом.
+ * @details При підйомі переїзд починається на стільки раніше, ніж перо встигає
+ *          відстоятися; при опусканні на стільки ж раніше кінця переїзду подається
+ *          команда пера. Перекриття не перевищує саму затримку.
+ * @param settings Налаштування пристрою.
+ * @param pen_up true — підйом, false — опускання.
+ * @return Перекриття, мс (0 — без перекриття).
+ */
+int axidraw_pen_overlap_ms (const axidraw_settings_t *settings, bool pen_up);
+
 /** Встановлює режими мікрокроку моторів. */
 int axidraw_motors_set_mode (
     axidraw_device_t *dev, axidraw_motor_mode_t motor1, axidraw_motor_mode_t motor2);
@@ -325,8 +429,10 @@ int axidraw_move_lowlevel_phase_xy (
 
 /**
  * @brief Очікує, доки пристрій стане неактивним (без рухів/команд у FIFO).
+ * @details За дійсної моделі FIFO спить до прогнозованого завершення надісланих рухів і
+ *          підтверджує простій одним-двома запитами `QM`; інакше опитує `QM` кожні ~20 мс.
  * @param dev Підключений пристрій.
- * @param max_attempts Кількість ітерацій очікування (крок ~20 мс).
+ * @param max_attempts Ліміт очікування в кроках по ~20 мс (прогнозований сон теж входить).
  * @return 0 — пристрій простійний; -1 — тайм-аут або помилка запиту.
  */
 int axidraw_wait_for_idle (axidraw_device_t *dev, int max_attempts);
@@ -10,13 +10,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "axidraw.h"
 #include "config.h"
 #include "log.h"
+#include "spatial.h"
+#include "ttime.h"
 
 #ifndef M_PI_2
 #define M_PI_2 (M_PI / 2.0)
 #endif
 
+/** \brief Допуск виходу за рамку при обрізанні, мм. */
+#define CANVAS_CLIP_EPS_MM 1e-6
+
 /**
  * @brief Перевіряє коректність параметрів полотна.
  * @param opt Параметри сторінки та полів.
@@ -108,19 +114,13 @@ void canvas_frame_dimensions (const canvas_options_t *options, double *out_w, do
 }
 
 /**
- * @brief Формує розкладку полотна з урахуванням орієнтації та полів.
+ * @brief Заповнює поля сторінки та габарити рамки макета.
  * @param options Параметри сторінки.
- * @param source_paths Вхідні контури.
- * @param out_layout [out] Результуючий макет.
+ * @param layout [out] Макет (обнуляється).
  * @return Статус виконання.
  */
-canvas_status_t canvas_layout_document (
-    const canvas_options_t *options,
-    const geom_paths_t *source_paths,
-    canvas_layout_t *out_layout) {
-    if (!options || !source_paths || !out_layout)
-        return CANVAS_STATUS_INVALID_INPUT;
-
+static canvas_status_t
+canvas_layout_frame (const canvas_options_t *options, canvas_layout_t *layout) {
     LOGD (
         "canvas: fit_to_frame=%d, paper=%.2fx%.2f, margins tlbr=%.1f,%.1f,%.1f,%.1f, orient=%d",
         options->fit_to_frame ? 1 : 0, options->paper_w_mm, options->paper_h_mm,
@@ -131,26 +131,96 @@ canvas_status_t canvas_layout_document (
     if (opt_rc != CANVAS_STATUS_OK)
         return opt_rc;
 
-    canvas_layout_t layout;
-    memset (&layout, 0, sizeof (layout));
-    layout.orientation = options->orientation;
-    layout.paper_w_mm = options->paper_w_mm;
-    layout.paper_h_mm = options->paper_h_mm;
-    layout.margin_top_mm = options->margin_top_mm;
-    layout.margin_right_mm = options->margin_right_mm;
-    layout.margin_bottom_mm = options->margin_bottom_mm;
-    layout.margin_left_mm = options->margin_left_mm;
-    layout.frame_w_mm
+    memset (layout, 0, sizeof (*layout));
+    layout->orientation = options->orientation;
+    layout->paper_w_mm = options->paper_w_mm;
+    layout->paper_h_mm = options->paper_h_mm;
+    layout->margin_top_mm = options->margin_top_mm;
+    layout->margin_right_mm = options->margin_right_mm;
+    layout->margin_bottom_mm = options->margin_bottom_mm;
+    layout->margin_left_mm = options->margin_left_mm;
+    layout->frame_w_mm
         = (options->orientation == ORIENT_PORTRAIT)
               ? (options->paper_h_mm - options->margin_top_mm - options->margin_bottom_mm)
               : (options->paper_w_mm - options->margin_left_mm - options->margin_right_mm);
-    layout.frame_h_mm
+    layout->frame_h_mm
         = (options->orientation == ORIENT_PORTRAIT)
               ? (options->paper_w_mm - options->margin_left_mm - options->margin_right_mm)
               : (options->paper_h_mm - options->margin_top_mm - options->margin_bottom_mm);
-    if (!(layout.frame_w_mm > 0.0) || !(layout.frame_h_mm > 0.0))
+    if (!(layout->frame_w_mm > 0.0) || !(layout->frame_h_mm > 0.0))
+        return CANVAS_STATUS_INVALID_INPUT;
+    return CANVAS_STATUS_OK;
+}
+
+/**
+ * @brief Межі та початкова точка макета без контурів.
+ */
+static void canvas_layout_set_empty (const canvas_options_t *options, canvas_layout_t *layout) {
+    layout->bounds_mm.min_x = 0.0;
+    layout->bounds_mm.min_y = 0.0;
+    layout->bounds_mm.max_x = 0.0;
+    layout->bounds_mm.max_y = 0.0;
+    if (layout->orientation == ORIENT_PORTRAIT) {
+        layout->start_x_mm = options->paper_w_mm - options->margin_right_mm;
+        layout->start_y_mm = options->margin_top_mm;
+    } else {
+        layout->start_x_mm = options->margin_left_mm;
+        layout->start_y_mm = options->margin_top_mm;
+    }
+}
+
+/**
+ * @brief Останнє перетворення: масштаб під рамку (fit) і зсув до полів.
+ * @param options Параметри сторінки.
+ * @param layout Макет із габаритами рамки.
+ * @param bbox Межі вмісту після зсуву в нуль і повороту.
+ * @return Перетворення.
+ */
+static geom_affine_t canvas_place_affine (
+    const canvas_options_t *options, const canvas_layout_t *layout, const geom_bbox_t *bbox) {
+    bool portrait = layout->orientation == ORIENT_PORTRAIT;
+    /* Межі вже повернуті, а габарити рамки — у неповернутому порядку. */
+    double frame_w = portrait ? layout->frame_h_mm : layout->frame_w_mm;
+    double frame_h = portrait ? layout->frame_w_mm : layout->frame_h_mm;
+    double width = bbox->max_x - bbox->min_x;
+    double height = bbox->max_y - bbox->min_y;
+    double scale = 1.0;
+    if (options->fit_to_frame && ((width > frame_w) || (height > frame_h))) {
+        double sx = frame_w / (width > 0.0 ? width : frame_w);
+        double sy = frame_h / (height > 0.0 ? height : frame_h);
+        scale = sx < sy ? sx : sy;
+        if (!(scale > 0.0) || scale > 1.0)
+            scale = 1.0;
+        LOGD (
+            "canvas: fit %s scale=%.4f (w=%.2f h=%.2f frame=%.2f×%.2f)",
+            portrait ? "portrait" : "landscape", scale, width, height, frame_w, frame_h);
+    }
+
+    /* Масштаб > 0 монотонний, тож межі після нього — масштабовані межі до нього. */
+    double dx, dy;
+    if (portrait) {
+        dx = (options->paper_w_mm - options->margin_right_mm) - bbox->max_x * scale;
+        dy = options->margin_top_mm - bbox->min_y * scale;
+    } else {
+        dx = options->margin_left_mm;
+        dy = options->margin_top_mm;
+    }
+    return (geom_affine_t){ scale, 0.0, 0.0, scale, dx, dy };
+}
+
+/** \brief Тіло `canvas_layout_document` без профілю. */
+static canvas_status_t canvas_layout_document_run (
+    const canvas_options_t *options,
+    const geom_paths_t *source_paths,
+    canvas_layout_t *out_layout) {
+    if (!options || !source_paths || !out_layout)
         return CANVAS_STATUS_INVALID_INPUT;
 
+    canvas_layout_t layout;
+    canvas_status_t frame_rc = canvas_layout_frame (options, &layout);
+    if (frame_rc != CANVAS_STATUS_OK)
+        return frame_rc;
+
     geom_paths_t src_mm;
     canvas_status_t copy_rc = canvas_copy_paths_mm (source_paths, &src_mm);
     if (copy_rc != CANVAS_STATUS_OK)
@@ -160,151 +230,361 @@ canvas_status_t canvas_layout_document (
     geom_bbox_t src_bbox;
     if (has_points && geom_bbox_of_paths (&src_mm, &src_bbox) != 0)
         has_points = false;
+    if (has_points && options->anchored) {
+        /* Початок рамки — спільна точка відліку: сторінки документа не зсуваються. */
+        src_bbox.min_x = fmin (src_bbox.min_x, 0.0);
+        src_bbox.min_y = fmin (src_bbox.min_y, 0.0);
+    }
 
     if (!has_points) {
         if (geom_paths_init (&layout.paths_mm, GEOM_UNITS_MM) != 0) {
             geom_paths_free (&src_mm);
             return CANVAS_STATUS_INTERNAL_ERROR;
         }
-        layout.bounds_mm.min_x = 0.0;
-        layout.bounds_mm.min_y = 0.0;
-        layout.bounds_mm.max_x = 0.0;
-        layout.bounds_mm.max_y = 0.0;
-        if (layout.orientation == ORIENT_PORTRAIT) {
-            layout.start_x_mm = options->paper_w_mm - options->margin_right_mm;
-            layout.start_y_mm = options->margin_top_mm;
-        } else {
-            layout.start_x_mm = options->margin_left_mm;
-            layout.start_y_mm = options->margin_top_mm;
-        }
+        canvas_layout_set_empty (options, &layout);
         geom_paths_free (&src_mm);
         *out_layout = layout;
         return CANVAS_STATUS_OK;
     }
 
-    geom_paths_t normalized;
-    int rc = geom_paths_translate (&src_mm, -src_bbox.min_x, -src_bbox.min_y, &normalized);
-    geom_paths_free (&src_mm);
-    if (rc != 0)
+    /* Усі кроки — на місці над єдиною копією; межі рахуються в тому ж проході. */
+    geom_bbox_t bbox;
+    geom_affine_t m = geom_affine_translation (-src_bbox.min_x, -src_bbox.min_y);
+    int rc = geom_paths_transform (&src_mm, &m, &bbox);
+    if (rc == 0 && layout.orientation == ORIENT_PORTRAIT) {
+        m = geom_affine_rotation (M_PI_2, 0.0, 0.0);
+        rc = geom_paths_transform (&src_mm, &m, &bbox);
+    }
+    if (rc != 0) {
+        geom_paths_free (&src_mm);
         return CANVAS_STATUS_INTERNAL_ERROR;
+    }
 
-    if (layout.orientation == ORIENT_PORTRAIT) {
+    m = canvas_place_affine (options, &layout, &bbox);
+    if (geom_paths_transform (&src_mm, &m, &layout.bounds_mm) != 0) {
+        geom_paths_free (&src_mm);
+        return CANVAS_STATUS_INTERNAL_ERROR;
+    }
+    bool portrait = layout.orientation == ORIENT_PORTRAIT;
+    layout.start_x_mm = portrait ? layout.bounds_mm.max_x : layout.bounds_mm.min_x;
+    layout.start_y_mm = layout.bounds_mm.min_y;
+    layout.paths_mm = src_mm;
 
-        geom_paths_t rotated;
-        rc = geom_paths_rotate (&normalized, M_PI_2, 0.0, 0.0, &rotated);
-        geom_paths_free (&normalized);
-        if (rc != 0)
-            return CANVAS_STATUS_INTERNAL_ERROR;
+    *out_layout = layout;
+    return CANVAS_STATUS_OK;
+}
 
-        geom_bbox_t rotated_bbox;
-        if (geom_bbox_of_paths (&rotated, &rotated_bbox) != 0) {
-            geom_paths_free (&rotated);
-            if (geom_paths_init (&layout.paths_mm, GEOM_UNITS_MM) != 0)
-                return CANVAS_STATUS_INTERNAL_ERROR;
-            layout.bounds_mm.min_x = layout.bounds_mm.min_y = layout.bounds_mm.max_x
-                = layout.bounds_mm.max_y = 0.0;
-            layout.start_x_mm = options->paper_w_mm - options->margin_right_mm;
-            layout.start_y_mm = options->margin_top_mm;
-            *out_layout = layout;
-            return CANVAS_STATUS_OK;
-        }
-        double frame_w = layout.frame_w_mm;
-        double frame_h = layout.frame_h_mm;
-        double width = rotated_bbox.max_x - rotated_bbox.min_x;
-        double height = rotated_bbox.max_y - rotated_bbox.min_y;
-        double scale = 1.0;
-        if (options->fit_to_frame && ((width > frame_w) || (height > frame_h))) {
-            double sx = frame_w / (width > 0.0 ? width : frame_w);
-            double sy = frame_h / (height > 0.0 ? height : frame_h);
-            scale = sx < sy ? sx : sy;
-            if (!(scale > 0.0) || scale > 1.0)
-                scale = 1.0;
-            LOGD (
-                "canvas: fit portrait scale=%.4f (w=%.2f h=%.2f frame=%.2f×%.2f)", scale, width,
-                height, frame_w, frame_h);
-        }
-        geom_paths_t scaled = rotated;
-        bool have_scaled = false;
-        if (scale != 1.0) {
-            if (geom_paths_scale (&rotated, scale, scale, &scaled) != 0) {
-                geom_paths_free (&rotated);
+/**
+ * @brief Формує розкладку полотна з урахуванням орієнтації та полів.
+ * @param options Параметри сторінки.
+ * @param source_paths Вхідні контури.
+ * @param out_layout [out] Результуючий макет.
+ * @return Статус виконання.
+ */
+canvas_status_t canvas_layout_document (
+    const canvas_options_t *options,
+    const geom_paths_t *source_paths,
+    canvas_layout_t *out_layout) {
+    uint64_t t0 = ttime_stage_begin ();
+    canvas_status_t rc = canvas_layout_document_run (options, source_paths, out_layout);
+    ttime_stage_end (TTIME_STAGE_CANVAS, t0);
+    if (rc == CANVAS_STATUS_OK)
+        ttime_count (TTIME_COUNT_PATHS, out_layout->paths_mm.len);
+    return rc;
+}
+
+/** \brief Тіло `canvas_layout_glyphs` без профілю. */
+static canvas_status_t canvas_layout_glyphs_run (
+    const canvas_options_t *options, glyph_layout_t *glyphs, canvas_layout_t *out_layout) {
+    if (!options || !glyphs || !out_layout)
+        return CANVAS_STATUS_INVALID_INPUT;
+
+    canvas_layout_t layout;
+    canvas_status_t frame_rc = canvas_layout_frame (options, &layout);
+    if (frame_rc != CANVAS_STATUS_OK)
+        return frame_rc;
+    if (glyph_layout_convert (glyphs, GEOM_UNITS_MM) != 0)
+        return CANVAS_STATUS_INTERNAL_ERROR;
+
+    /* Ті самі кроки, що й у `canvas_layout_document`; межі екземплярів — з меж форм. */
+    geom_bbox_t bbox;
+    int rc = glyph_layout_bbox (glyphs, &bbox);
+    if (rc < 0)
+        return CANVAS_STATUS_INTERNAL_ERROR;
+    if (rc == 0) {
+        geom_affine_t m = geom_affine_translation (-bbox.min_x, -bbox.min_y);
+        if (glyph_layout_transform (glyphs, &m) != 0)
+            return CANVAS_STATUS_INTERNAL_ERROR;
+        if (layout.orientation == ORIENT_PORTRAIT) {
+            m = geom_affine_rotation (M_PI_2, 0.0, 0.0);
+            if (glyph_layout_transform (glyphs, &m) != 0)
                 return CANVAS_STATUS_INTERNAL_ERROR;
-            }
-            geom_paths_free (&rotated);
-            have_scaled = true;
-            geom_bbox_of_paths (&scaled, &rotated_bbox);
         }
-        double dx = (options->paper_w_mm - options->margin_right_mm) - rotated_bbox.max_x;
-        double dy = options->margin_top_mm - rotated_bbox.min_y;
-        geom_paths_t placed;
-        rc = geom_paths_translate (&scaled, dx, dy, &placed);
-        if (have_scaled)
-            geom_paths_free (&scaled);
-        if (rc != 0)
+        if (glyph_layout_bbox (glyphs, &bbox) != 0)
             return CANVAS_STATUS_INTERNAL_ERROR;
-
-        geom_bbox_of_paths (&placed, &layout.bounds_mm);
-        layout.start_x_mm = layout.bounds_mm.max_x;
+        m = canvas_place_affine (options, &layout, &bbox);
+        if (glyph_layout_transform (glyphs, &m) != 0
+            || glyph_layout_bbox (glyphs, &layout.bounds_mm) != 0)
+            return CANVAS_STATUS_INTERNAL_ERROR;
+        bool portrait = layout.orientation == ORIENT_PORTRAIT;
+        layout.start_x_mm = portrait ? layout.bounds_mm.max_x : layout.bounds_mm.min_x;
         layout.start_y_mm = layout.bounds_mm.min_y;
-        layout.paths_mm = placed;
     } else {
+        canvas_layout_set_empty (options, &layout);
+    }
 
-        geom_bbox_t norm_bbox;
-        if (geom_bbox_of_paths (&normalized, &norm_bbox) != 0) {
-            geom_paths_free (&normalized);
-            if (geom_paths_init (&layout.paths_mm, GEOM_UNITS_MM) != 0)
-                return CANVAS_STATUS_INTERNAL_ERROR;
-            layout.bounds_mm.min_x = layout.bounds_mm.min_y = layout.bounds_mm.max_x
-                = layout.bounds_mm.max_y = 0.0;
-            layout.start_x_mm = options->margin_left_mm;
-            layout.start_y_mm = options->margin_top_mm;
-            *out_layout = layout;
-            return CANVAS_STATUS_OK;
+    if (geom_paths_init (&layout.paths_mm, GEOM_UNITS_MM) != 0)
+        return CANVAS_STATUS_INTERNAL_ERROR;
+    layout.glyphs = (glyph_layout_t *)malloc (sizeof (*layout.glyphs));
+    if (!layout.glyphs) {
+        geom_paths_free (&layout.paths_mm);
+        return CANVAS_STATUS_INTERNAL_ERROR;
+    }
+    *layout.glyphs = *glyphs;
+    memset (glyphs, 0, sizeof (*glyphs));
+    *out_layout = layout;
+    return CANVAS_STATUS_OK;
+}
+
+/**
+ * @copydoc canvas_layout_glyphs
+ */
+canvas_status_t canvas_layout_glyphs (
+    const canvas_options_t *options, glyph_layout_t *glyphs, canvas_layout_t *out_layout) {
+    uint64_t t0 = ttime_stage_begin ();
+    canvas_status_t rc = canvas_layout_glyphs_run (options, glyphs, out_layout);
+    ttime_stage_end (TTIME_STAGE_CANVAS, t0);
+    if (rc == CANVAS_STATUS_OK)
+        ttime_count (TTIME_COUNT_PATHS, out_layout->glyphs->item_len);
+    return rc;
+}
+
+/**
+ * @copydoc canvas_layout_flatten
+ */
+int canvas_layout_flatten (canvas_layout_t *layout) {
+    if (!layout)
+        return -1;
+    if (!layout->glyphs)
+        return 0;
+    if (glyph_layout_flatten (layout->glyphs, &layout->paths_mm) != 0)
+        return -1;
+    glyph_layout_free (layout->glyphs);
+    free (layout->glyphs);
+    layout->glyphs = NULL;
+    return 0;
+}
+
+/**
+ * @copydoc canvas_layout_frame_rect
+ */
+void canvas_layout_frame_rect (const canvas_layout_t *layout, geom_bbox_t *out) {
+    out->min_x = layout->margin_left_mm;
+    out->min_y = layout->margin_top_mm;
+    out->max_x = layout->paper_w_mm - layout->margin_right_mm;
+    out->max_y = layout->paper_h_mm - layout->margin_bottom_mm;
+}
+
+/**
+ * @brief Позначки відрізків, що виходять за рамку.
+ */
+typedef struct {
+    const spatial_index_t *ix; /**< Індекс (нумерація відрізків). */
+    unsigned char *marks;      /**< Позначка на кожен відрізок. */
+    size_t marked;             /**< Кількість позначених. */
+} canvas_clip_marks_t;
+
+/** \brief Обробник запиту індексу: позначає відрізок. */
+static int canvas_clip_mark (void *ctx, const spatial_ref_t *ref) {
+    canvas_clip_marks_t *m = (canvas_clip_marks_t *)ctx;
+    size_t id = m->ix->seg_first[ref->path] + ref->seg;
+    if (!m->marks[id]) {
+        m->marks[id] = 1;
+        m->marked++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Обрізає відрізок прямокутником (Ліанґ—Барскі).
+ * @param r Прямокутник.
+ * @param a [in,out] Початок відрізка.
+ * @param b [in,out] Кінець відрізка.
+ * @param out_u0 [out] Параметр нового початку (0 — початок у прямокутнику).
+ * @param out_u1 [out] Параметр нового кінця (1 — кінець у прямокутнику).
+ * @return true — частина відрізка в прямокутнику; false — відрізок повністю поза ним.
+ */
+static bool canvas_clip_segment (
+    const geom_bbox_t *r, geom_point_t *a, geom_point_t *b, double *out_u0, double *out_u1) {
+    double dx = b->x - a->x, dy = b->y - a->y;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { a->x - r->min_x, r->max_x - a->x, a->y - r->min_y, r->max_y - a->y };
+    double u0 = 0.0, u1 = 1.0;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0)
+                return false;
+            continue;
         }
-        double width = norm_bbox.max_x - norm_bbox.min_x;
-        double height = norm_bbox.max_y - norm_bbox.min_y;
-        double frame_w = layout.frame_w_mm;
-        double frame_h = layout.frame_h_mm;
-        double scale = 1.0;
-        if (options->fit_to_frame && ((width > frame_w) || (height > frame_h))) {
-            double sx = frame_w / (width > 0.0 ? width : frame_w);
-            double sy = frame_h / (height > 0.0 ? height : frame_h);
-            scale = sx < sy ? sx : sy;
-            if (!(scale > 0.0) || scale > 1.0)
-                scale = 1.0;
-            LOGD (
-                "canvas: fit landscape scale=%.4f (w=%.2f h=%.2f frame=%.2f×%.2f)", scale, width,
-                height, frame_w, frame_h);
+        double t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            if (t > u1)
+                return false;
+            if (t > u0)
+                u0 = t;
+        } else {
+            if (t < u0)
+                return false;
+            if (t < u1)
+                u1 = t;
         }
-        geom_paths_t scaled = normalized;
-        bool have_scaled = false;
-        if (scale != 1.0) {
-            if (geom_paths_scale (&normalized, scale, scale, &scaled) != 0) {
-                geom_paths_free (&normalized);
-                return CANVAS_STATUS_INTERNAL_ERROR;
+    }
+    geom_point_t a0 = *a;
+    *a = (geom_point_t){ a0.x + u0 * dx, a0.y + u0 * dy };
+    *b = (geom_point_t){ a0.x + u1 * dx, a0.y + u1 * dy };
+    *out_u0 = u0;
+    *out_u1 = u1;
+    return true;
+}
+
+/**
+ * @brief Переносить частину контуру в результат (від двох точок) і починає нову.
+ */
+static int canvas_clip_flush (geom_paths_t *out, geom_path_t *piece) {
+    int rc = 0;
+    if (piece->len >= 2)
+        rc = geom_paths_push_path (out, piece->pts, piece->len);
+    piece->len = 0;
+    return rc;
+}
+
+/**
+ * @brief Розрізає контури за позначками: непозначені відрізки копіюються як є.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int canvas_clip_paths (
+    const spatial_index_t *ix,
+    const unsigned char *marks,
+    const geom_bbox_t *rect,
+    geom_paths_t *out) {
+    const geom_paths_t *src = ix->paths;
+    geom_path_t piece;
+    if (geom_path_init (&piece, 64) != 0)
+        return -1;
+    int rc = 0;
+    for (size_t i = 0; i < src->len && rc == 0; ++i) {
+        const geom_path_t *p = &src->items[i];
+        size_t first = ix->seg_first[i], n = ix->seg_first[i + 1] - first;
+        bool touched = false;
+        for (size_t s = 0; s < n && !touched; ++s)
+            touched = marks[first + s] != 0;
+        if (!touched) {
+            rc = geom_paths_push_path (out, p->pts, p->len);
+            continue;
+        }
+        for (size_t s = 0; s + 1 < p->len && rc == 0; ++s) {
+            geom_point_t a = p->pts[s], b = p->pts[s + 1];
+            if (!marks[first + s]) {
+                if (piece.len == 0)
+                    rc = geom_path_push (&piece, a.x, a.y);
+                if (rc == 0)
+                    rc = geom_path_push (&piece, b.x, b.y);
+                continue;
+            }
+            double u0, u1;
+            if (!canvas_clip_segment (rect, &a, &b, &u0, &u1)) {
+                rc = canvas_clip_flush (out, &piece);
+                continue;
             }
-            geom_paths_free (&normalized);
-            have_scaled = true;
+            /* Відрізок заходить у рамку ззовні — попередня частина вже завершилась. */
+            if (u0 > 0.0)
+                rc = canvas_clip_flush (out, &piece);
+            if (rc == 0 && piece.len == 0)
+                rc = geom_path_push (&piece, a.x, a.y);
+            if (rc == 0)
+                rc = geom_path_push (&piece, b.x, b.y);
+            if (rc == 0 && u1 < 1.0)
+                rc = canvas_clip_flush (out, &piece);
         }
-        double dx = options->margin_left_mm;
-        double dy = options->margin_top_mm;
-        geom_paths_t placed;
-        rc = geom_paths_translate (&scaled, dx, dy, &placed);
-        if (have_scaled)
-            geom_paths_free (&scaled);
-        else
-            geom_paths_free (&normalized);
-        if (rc != 0)
-            return CANVAS_STATUS_INTERNAL_ERROR;
-
-        geom_bbox_of_paths (&placed, &layout.bounds_mm);
-        layout.start_x_mm = layout.bounds_mm.min_x;
-        layout.start_y_mm = layout.bounds_mm.min_y;
-        layout.paths_mm = placed;
+        if (rc == 0)
+            rc = canvas_clip_flush (out, &piece);
     }
+    free (piece.pts);
+    return rc;
+}
 
-    *out_layout = layout;
-    return CANVAS_STATUS_OK;
+/**
+ * @copydoc canvas_layout_clip_to_frame
+ */
+int canvas_layout_clip_to_frame (canvas_layout_t *layout, size_t *out_clipped) {
+    if (out_clipped)
+        *out_clipped = 0;
+    if (!layout)
+        return -1;
+    geom_bbox_t rect;
+    canvas_layout_frame_rect (layout, &rect);
+    /* Допуск — похибка перетворень: точка на краї рамки лишається в ній. */
+    rect.min_x -= CANVAS_CLIP_EPS_MM;
+    rect.min_y -= CANVAS_CLIP_EPS_MM;
+    rect.max_x += CANVAS_CLIP_EPS_MM;
+    rect.max_y += CANVAS_CLIP_EPS_MM;
+    const geom_bbox_t *bb = &layout->bounds_mm;
+    bool empty = !layout->glyphs && layout->paths_mm.len == 0;
+    if (empty
+        || (bb->min_x >= rect.min_x && bb->min_y >= rect.min_y && bb->max_x <= rect.max_x
+            && bb->max_y <= rect.max_y))
+        return 0;
+    if (canvas_layout_flatten (layout) != 0)
+        return -1;
+
+    spatial_index_t ix;
+    if (spatial_index_build (&ix, &layout->paths_mm) != 0)
+        return -1;
+    canvas_clip_marks_t marks = { &ix, (unsigned char *)calloc (ix.segments + 1, 1), 0 };
+    if (!marks.marks) {
+        spatial_index_free (&ix);
+        return -1;
+    }
+    /* Смуги довкола рамки: у запит потрапляють лише клітинки біля країв і поза рамкою. */
+    const geom_bbox_t *all = &ix.bounds;
+    geom_bbox_t strips[4] = {
+        { all->min_x, all->min_y, nextafter (rect.min_x, -INFINITY), all->max_y },
+        { nextafter (rect.max_x, INFINITY), all->min_y, all->max_x, all->max_y },
+        { all->min_x, all->min_y, all->max_x, nextafter (rect.min_y, -INFINITY) },
+        { all->min_x, nextafter (rect.max_y, INFINITY), all->max_x, all->max_y },
+    };
+    for (int k = 0; k < 4; ++k)
+        if (strips[k].min_x <= strips[k].max_x && strips[k].min_y <= strips[k].max_y)
+            (void)spatial_index_query (&ix, &strips[k], canvas_clip_mark, &marks);
+
+    int rc = 0;
+    if (marks.marked > 0) {
+        geom_paths_t clipped;
+        rc = geom_paths_init (&clipped, GEOM_UNITS_MM);
+        if (rc == 0)
+            rc = canvas_clip_paths (&ix, marks.marks, &rect, &clipped);
+        if (rc == 0) {
+            geom_paths_free (&layout->paths_mm);
+            layout->paths_mm = clipped;
+            bool portrait = layout->orientation == ORIENT_PORTRAIT;
+            if (geom_bbox_of_paths (&layout->paths_mm, &layout->bounds_mm) == 0) {
+                layout->start_x_mm = portrait ? layout->bounds_mm.max_x : layout->bounds_mm.min_x;
+                layout->start_y_mm = layout->bounds_mm.min_y;
+            } else {
+                memset (&layout->bounds_mm, 0, sizeof (layout->bounds_mm));
+                layout->start_x_mm = portrait ? layout->paper_w_mm - layout->margin_right_mm
+                                              : layout->margin_left_mm;
+                layout->start_y_mm = layout->margin_top_mm;
+            }
+            if (out_clipped)
+                *out_clipped = marks.marked;
+        } else {
+            geom_paths_free (&clipped);
+        }
+    }
+    free (marks.marks);
+    spatial_index_free (&ix);
+    return rc == 0 ? 0 : -1;
 }
 
 /**
@@ -315,9 +595,111 @@ void canvas_layout_dispose (canvas_layout_t *layout) {
     if (!layout)
         return;
     geom_paths_free (&layout->paths_mm);
+    if (layout->glyphs) {
+        glyph_layout_free (layout->glyphs);
+        free (layout->glyphs);
+    }
     memset (layout, 0, sizeof (*layout));
 }
 
+int canvas_default_motion_limits (planner_limits_t *out_limits, double *out_feed_mm_s) {
+    config_t cfg;
+    if (config_factory_defaults (&cfg, CONFIG_DEFAULT_MODEL) != 0)
+        return 1;
+    if (!(cfg.speed_mm_s > 0.0) || !(cfg.accel_mm_s2 > 0.0))
+        return 1;
+    if (out_limits) {
+        out_limits->max_speed_mm_s = cfg.speed_mm_s;
+        out_limits->max_accel_mm_s2 = cfg.accel_mm_s2;
+        out_limits->cornering_distance_mm = 0.5;
+        out_limits->min_segment_mm = 0.1;
+        out_limits->chord_tolerance_mm = 0.0;
+        out_limits->max_jerk_mm_s3 = 0.0;
+        out_limits->max_motor_speed_mm_s = 0.0;
+        out_limits->max_motor_accel_mm_s2 = 0.0;
+        const axidraw_device_profile_t *profile
+            = axidraw_device_profile_for_model (CONFIG_DEFAULT_MODEL);
+        out_limits->travel_speed_mm_s = profile->travel_speed_mm_s;
+        out_limits->travel_accel_mm_s2 = profile->travel_accel_mm_s2;
+    }
+    if (out_feed_mm_s)
+        *out_feed_mm_s = cfg.speed_mm_s;
+    return 0;
+}
+
+int canvas_segment_iter_init (
+    canvas_segment_iter_t *it, const canvas_layout_t *layout, double feed_mm_s) {
+    if (!it || !layout)
+        return 1;
+    memset (it, 0, sizeof (*it));
+    it->paths = &layout->paths_mm;
+    it->feed_mm_s = feed_mm_s;
+    for (size_t i = 0; i < it->paths->len; ++i) {
+        const geom_path_t *path = &it->paths->items[i];
+        if (path->len == 0)
+            continue;
+        it->start_mm[0] = path->pts[0].x;
+        it->start_mm[1] = path->pts[0].y;
+        break;
+    }
+    return 0;
+}
+
+int canvas_segment_iter_next (canvas_segment_iter_t *it, planner_segment_t *out) {
+    if (!it || !it->paths || !out)
+        return 1;
+    const geom_paths_t *paths = it->paths;
+    while (it->path_index < paths->len) {
+        const geom_path_t *path = &paths->items[it->path_index];
+        if (it->point_index == 0) {
+            if (path->len == 0) {
+                ++it->path_index;
+                continue;
+            }
+            it->point_index = 1;
+            double path_start[2] = { path->pts[0].x, path->pts[0].y };
+            if (!it->have_current) {
+                it->current[0] = path_start[0];
+                it->current[1] = path_start[1];
+                it->have_current = true;
+            } else if (
+                fabs (it->current[0] - path_start[0]) > 1e-6
+                || fabs (it->current[1] - path_start[1]) > 1e-6) {
+                /* Короткий проміжок після штриха — без циклу підйому/опускання пера. */
+                bool hop = it->pen_down && it->hop_mm > 0.0
+                           && hypot (path_start[0] - it->current[0], path_start[1] - it->current[1])
+                                  <= it->hop_mm;
+                if (hop)
+                    ++it->hops;
+                out->target_mm[0] = path_start[0];
+                out->target_mm[1] = path_start[1];
+                out->feed_mm_s = hop ? it->feed_mm_s : it->travel_feed_mm_s;
+                out->pen_down = hop;
+                it->pen_down = hop;
+                it->current[0] = path_start[0];
+                it->current[1] = path_start[1];
+                return 0;
+            }
+        }
+        while (it->point_index < path->len) {
+            const geom_point_t *pt = &path->pts[it->point_index++];
+            if (fabs (it->current[0] - pt->x) <= 1e-9 && fabs (it->current[1] - pt->y) <= 1e-9)
+                continue;
+            out->target_mm[0] = pt->x;
+            out->target_mm[1] = pt->y;
+            out->feed_mm_s = it->feed_mm_s;
+            out->pen_down = true;
+            it->pen_down = true;
+            it->current[0] = pt->x;
+            it->current[1] = pt->y;
+            return 0;
+        }
+        ++it->path_index;
+        it->point_index = 0;
+    }
+    return 1;
+}
+
 int canvas_generate_motion_plan (
     const canvas_layout_t *layout,
     const planner_limits_t *limits,
@@ -326,86 +708,36 @@ int canvas_generate_motion_plan (
     if (!layout || !out_blocks || !out_count)
         return 1;
 
-    config_t cfg;
-    if (config_factory_defaults (&cfg, CONFIG_DEFAULT_MODEL) != 0)
-        return 1;
-
-    if (!(cfg.speed_mm_s > 0.0) || !(cfg.accel_mm_s2 > 0.0))
+    planner_limits_t local_limits;
+    double feed_mm_s = 0.0;
+    if (canvas_default_motion_limits (&local_limits, &feed_mm_s) != 0)
         return 1;
-
-    planner_limits_t local_limits = {
-        .max_speed_mm_s = cfg.speed_mm_s,
-        .max_accel_mm_s2 = cfg.accel_mm_s2,
-        .cornering_distance_mm = 0.5,
-        .min_segment_mm = 0.1,
-    };
     const planner_limits_t *use_limits = limits ? limits : &local_limits;
 
-    const geom_paths_t *paths = &layout->paths_mm;
-    if (paths->len == 0) {
-        *out_blocks = NULL;
-        *out_count = 0;
-        return 0;
-    }
+    *out_blocks = NULL;
+    *out_count = 0;
+    canvas_segment_iter_t it;
+    if (canvas_segment_iter_init (&it, layout, feed_mm_s) != 0)
+        return 1;
 
     planner_segment_t *segments = NULL;
     size_t seg_len = 0;
     size_t seg_cap = 0;
-
-    bool have_current = false;
-    double current[2] = { 0.0, 0.0 };
-    double start_pos[2] = { 0.0, 0.0 };
-
-    for (size_t i = 0; i < paths->len; ++i) {
-        const geom_path_t *path = &paths->items[i];
-        if (path->len == 0)
-            continue;
-        double path_start[2] = { path->pts[0].x, path->pts[0].y };
-        if (!have_current) {
-            start_pos[0] = path_start[0];
-            start_pos[1] = path_start[1];
-            current[0] = path_start[0];
-            current[1] = path_start[1];
-            have_current = true;
-        } else if (
-            fabs (current[0] - path_start[0]) > 1e-6 || fabs (current[1] - path_start[1]) > 1e-6) {
-            if (canvas_segments_reserve (&segments, &seg_len, &seg_cap, 1) != 0)
-                goto fail;
-            segments[seg_len].target_mm[0] = path_start[0];
-            segments[seg_len].target_mm[1] = path_start[1];
-            segments[seg_len].feed_mm_s = cfg.speed_mm_s;
-            segments[seg_len].pen_down = false;
-            ++seg_len;
-            current[0] = path_start[0];
-            current[1] = path_start[1];
-        }
-
-        for (size_t j = 1; j < path->len; ++j) {
-            double target[2] = { path->pts[j].x, path->pts[j].y };
-            if (fabs (current[0] - target[0]) <= 1e-9 && fabs (current[1] - target[1]) <= 1e-9)
-                continue;
-            if (canvas_segments_reserve (&segments, &seg_len, &seg_cap, 1) != 0)
-                goto fail;
-            segments[seg_len].target_mm[0] = target[0];
-            segments[seg_len].target_mm[1] = target[1];
-            segments[seg_len].feed_mm_s = cfg.speed_mm_s;
-            segments[seg_len].pen_down = true;
-            ++seg_len;
-            current[0] = target[0];
-            current[1] = target[1];
-        }
+    planner_segment_t segment;
+    while (canvas_segment_iter_next (&it, &segment) == 0) {
+        if (canvas_segments_reserve (&segments, &seg_len, &seg_cap, 1) != 0)
+            goto fail;
+        segments[seg_len++] = segment;
     }
 
-    if (!have_current || seg_len == 0) {
+    if (seg_len == 0) {
         free (segments);
-        *out_blocks = NULL;
-        *out_count = 0;
         return 0;
     }
 
     plan_block_t *blocks = NULL;
     size_t block_count = 0;
-    if (!planner_plan (use_limits, start_pos, segments, seg_len, &blocks, &block_count))
+    if (!planner_plan (use_limits, it.start_mm, segments, seg_len, &blocks, &block_count))
         goto fail;
 
     free (segments);
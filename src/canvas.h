@@ -12,6 +12,7 @@
 
 #include "config.h"
 #include "geom.h"
+#include "glyphlayout.h"
 #include "planner.h"
 
 #ifdef __cplusplus
@@ -28,6 +29,7 @@ typedef struct {
     orientation_t orientation;
     const char *font_family;
     bool fit_to_frame;
+    bool anchored; /**< Контури вже в координатах рамки від (0, 0): не зсувати до меж. */
 } canvas_options_t;
 
 typedef struct {
@@ -44,6 +46,7 @@ typedef struct {
     double start_y_mm;
     geom_bbox_t bounds_mm;
     geom_paths_t paths_mm;
+    glyph_layout_t *glyphs; /**< Екземпляри гліфів перед `paths_mm` (NULL — лише контури). */
 } canvas_layout_t;
 
 typedef enum {
@@ -70,12 +73,107 @@ void canvas_frame_dimensions (const canvas_options_t *options, double *out_w, do
 canvas_status_t canvas_layout_document (
     const canvas_options_t *options, const geom_paths_t *source_paths, canvas_layout_t *out_layout);
 
+/**
+ * @brief Формує розкладку полотна з екземплярів гліфів без розгортання контурів.
+ * @details Ті самі поворот, масштаб і поля, що й у `canvas_layout_document`, але
+ *          перетворення застосовується до розміщень і лінійно — до форм атласу.
+ *          `paths_mm` лишається порожнім; розгортання — `canvas_layout_flatten`.
+ * @param options Параметри сторінки.
+ * @param glyphs Розкладка гліфів (дюйми або мм); при успіху володіння переходить
+ *               до макета, а `*glyphs` обнуляється.
+ * @param out_layout [out] Результуючий макет.
+ * @return Статус виконання.
+ */
+canvas_status_t canvas_layout_glyphs (
+    const canvas_options_t *options, glyph_layout_t *glyphs, canvas_layout_t *out_layout);
+
+/**
+ * @brief Розгортає екземпляри гліфів макета у `paths_mm` (без гліфів — no-op).
+ * @param layout Макет.
+ * @return 0 — успіх; -1 — помилка.
+ */
+int canvas_layout_flatten (canvas_layout_t *layout);
+
+/**
+ * @brief Прямокутник рамки сторінки в координатах макета (мм).
+ * @details Однаковий для обох орієнтацій: поля відраховуються від країв аркуша.
+ * @param layout Макет.
+ * @param out [out] Рамка.
+ */
+void canvas_layout_frame_rect (const canvas_layout_t *layout, geom_bbox_t *out);
+
+/**
+ * @brief Обрізає контури макета рамкою сторінки з точністю до відрізка.
+ * @details Якщо межі вмісту в рамці, макет (зокрема екземпляри гліфів) не змінюється.
+ *          Інакше гліфи розгортаються, а відрізки, що виходять за рамку, знаходить
+ *          просторовий індекс (`spatial.h`) запитами смуг довкола рамки — решта
+ *          копіюється без перевірок. Відрізок, що перетинає край, коротшає до точки
+ *          перетину, а контур, що виходить за рамку й повертається, розпадається на
+ *          частини.
+ * @param layout [in,out] Макет.
+ * @param out_clipped [out] Кількість обрізаних або відкинутих відрізків (може бути NULL).
+ * @return 0 — успіх; -1 — помилка аргументів чи памʼяті.
+ */
+int canvas_layout_clip_to_frame (canvas_layout_t *layout, size_t *out_clipped);
+
 /**
  * @brief Звільняє ресурси, повʼязані з макетом полотна.
  * @param layout Макет, отриманий з canvas_layout_document().
  */
 void canvas_layout_dispose (canvas_layout_t *layout);
 
+/**
+ * @brief Інкрементальне джерело сегментів планувальника з фінальних шляхів полотна.
+ * @details Видає ті самі сегменти, що й `canvas_generate_motion_plan`, по одному,
+ *          без проміжного масиву (переходи з піднятим пером між контурами включно).
+ *          Якщо `hop_mm` > 0, проміжок між кінцем контуру та початком наступного, не
+ *          довший за `hop_mm`, долається з опущеним пером: повний цикл підйому й
+ *          опускання серво коштує значно довше за такий рух, а слід на папері не більший
+ *          за товщину пера. Поле встановлюють після `canvas_segment_iter_init`.
+ *          Переїзди з піднятим пером отримують `travel_feed_mm_s` (типово 0), тож їх
+ *          швидкість обмежують лише межі переїздів `planner_limits_t`.
+ */
+typedef struct {
+    const geom_paths_t *paths; /**< Шляхи макета (мм). */
+    size_t path_index;         /**< Поточний контур. */
+    size_t point_index;        /**< Наступна точка поточного контуру (0 — контур не почато). */
+    bool have_current;         /**< Чи відома поточна позиція. */
+    double current[2];         /**< Поточна позиція, мм. */
+    double start_mm[2];        /**< Початкова позиція плану (перша точка першого контуру). */
+    double feed_mm_s;          /**< Швидкість подачі для сегментів, мм/с. */
+    double travel_feed_mm_s;   /**< Подача переїздів з піднятим пером, мм/с (0 — межа
+                                  планувальника для переїздів). */
+    double hop_mm;             /**< Найбільший проміжок без підйому пера, мм (0 — вимк.). */
+    bool pen_down;             /**< Чи останній виданий сегмент малював. */
+    size_t hops;               /**< Кількість проміжків, подоланих без підйому пера. */
+} canvas_segment_iter_t;
+
+/**
+ * @brief Повертає типові ліміти планувальника та швидкість подачі з профілю.
+ * @param out_limits [out] Ліміти (може бути NULL).
+ * @param out_feed_mm_s [out] Швидкість подачі, мм/с (може бути NULL).
+ * @return 0 — успіх, 1 — некоректний профіль.
+ */
+int canvas_default_motion_limits (planner_limits_t *out_limits, double *out_feed_mm_s);
+
+/**
+ * @brief Готує джерело сегментів для макета.
+ * @param it [out] Стан ітератора.
+ * @param layout Макет полотна (має жити довше за ітератор).
+ * @param feed_mm_s Швидкість подачі для всіх сегментів, мм/с.
+ * @return 0 — успіх, 1 — помилка параметрів.
+ */
+int canvas_segment_iter_init (
+    canvas_segment_iter_t *it, const canvas_layout_t *layout, double feed_mm_s);
+
+/**
+ * @brief Видає наступний сегмент руху.
+ * @param it Стан ітератора.
+ * @param out [out] Сегмент.
+ * @return 0 — сегмент видано, 1 — сегменти скінчились.
+ */
+int canvas_segment_iter_next (canvas_segment_iter_t *it, planner_segment_t *out);
+
 /**
  * @brief Генерує план руху (послідовність блоків) із фінальних шляхів полотна.
  * @param layout Макет полотна з нормалізованими шляхами у мм.
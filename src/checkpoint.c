@@ -0,0 +1,128 @@
+/**
+ * @file checkpoint.c
+ * @brief Реалізація файлу точки відновлення друку.
+ * @ingroup checkpoint
+ */
+
+#include "checkpoint.h"
+
+#include "config.h"
+#include "log.h"
+#include "str.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Перший рядок файлу: сигнатура і версія формату. */
+#define CHECKPOINT_SIGNATURE "cplot-checkpoint 1"
+
+/**
+ * @brief Обчислює каталог стану cplot.
+ * @param buf [out] Буфер.
+ * @param buflen Розмір буфера.
+ * @return 0 — успіх; -1 — немає XDG_STATE_HOME/HOME або замалий буфер.
+ */
+static int checkpoint_dir (char *buf, size_t buflen) {
+    return config_xdg_dir ("XDG_STATE_HOME", ".local/state", NULL, buf, buflen);
+}
+
+/** @copydoc checkpoint_path */
+int checkpoint_path (char *buf, size_t buflen) {
+    char dir[PATH_MAX];
+    if (checkpoint_dir (dir, sizeof (dir)) != 0)
+        return -1;
+    int written = snprintf (buf, buflen, "%s/checkpoint", dir);
+    if (written < 0 || (size_t)written >= buflen)
+        return -1;
+    return 0;
+}
+
+/** @copydoc checkpoint_save */
+int checkpoint_save (const checkpoint_t *cp) {
+    if (!cp)
+        return -1;
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    char tmp[PATH_MAX + 8];
+    if (checkpoint_dir (dir, sizeof (dir)) != 0 || checkpoint_path (path, sizeof (path)) != 0) {
+        LOGW ("Точку відновлення не збережено: не визначено каталог стану");
+        return -1;
+    }
+    snprintf (tmp, sizeof (tmp), "%s.tmp", path);
+    if (config_mkdir_p (dir) != 0) {
+        LOGW ("Точку відновлення не збережено: не вдалося створити %s", dir);
+        return -1;
+    }
+    FILE *fp = fopen (tmp, "w");
+    if (!fp) {
+        LOGW ("Точку відновлення не збережено: не вдалося відкрити %s", tmp);
+        return -1;
+    }
+    fprintf (fp, "%s\n", CHECKPOINT_SIGNATURE);
+    fprintf (fp, "job %016" PRIx64 "\n", cp->job);
+    fprintf (fp, "model %s\n", cp->model[0] ? cp->model : "-");
+    fprintf (fp, "seq %lu\n", cp->seq);
+    fprintf (fp, "resume %lu\n", cp->resume_seq);
+    fprintf (fp, "pen %s\n", cp->pen_down ? "down" : "up");
+    bool ok = !ferror (fp);
+    if (fclose (fp) != 0)
+        ok = false;
+    if (!ok || rename (tmp, path) != 0) {
+        LOGW ("Точку відновлення не збережено: помилка запису %s", path);
+        remove (tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/** @copydoc checkpoint_load */
+int checkpoint_load (checkpoint_t *cp) {
+    if (!cp)
+        return -1;
+    memset (cp, 0, sizeof (*cp));
+    char path[PATH_MAX];
+    if (checkpoint_path (path, sizeof (path)) != 0)
+        return -1;
+    FILE *fp = fopen (path, "r");
+    if (!fp)
+        return errno == ENOENT ? 1 : -1;
+
+    char line[128];
+    unsigned found = 0;
+    bool valid = fgets (line, sizeof (line), fp)
+                 && strncmp (line, CHECKPOINT_SIGNATURE, strlen (CHECKPOINT_SIGNATURE)) == 0;
+    while (valid && fgets (line, sizeof (line), fp)) {
+        char pen[8];
+        if (sscanf (line, "job %" SCNx64, &cp->job) == 1)
+            found |= 1u;
+        else if (sscanf (line, "seq %lu", &cp->seq) == 1)
+            found |= 2u;
+        else if (sscanf (line, "resume %lu", &cp->resume_seq) == 1)
+            found |= 4u;
+        else if (sscanf (line, "pen %7s", pen) == 1) {
+            cp->pen_down = strcmp (pen, "down") == 0;
+            found |= 8u;
+        } else if (sscanf (line, "model %31s", cp->model) == 1) {
+            if (strcmp (cp->model, "-") == 0)
+                cp->model[0] = '\0';
+        }
+    }
+    fclose (fp);
+    if (!valid || found != 15u) {
+        LOGE ("Файл точки відновлення пошкоджений: %s", path);
+        return -1;
+    }
+    return 0;
+}
+
+/** @copydoc checkpoint_clear */
+void checkpoint_clear (void) {
+    char path[PATH_MAX];
+    if (checkpoint_path (path, sizeof (path)) == 0)
+        (void)unlink (path);
+}
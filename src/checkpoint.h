@@ -0,0 +1,67 @@
+/**
+ * @file checkpoint.h
+ * @brief Точка відновлення перерваного друку (`cplot print --resume`).
+ * @defgroup checkpoint Точка відновлення
+ * @details
+ * Під час друку на пристрій періодично і при помилці зберігається номер останнього
+ * підтвердженого контролером блоку плану (`plan_block_t.seq`), стан пера на ньому і
+ * номер блоку, з якого безпечно продовжити: початок штриха, що малювався (штрих
+ * починається зі стану спокою, тож його можна виконати з місця після переїзду).
+ * Відбиток завдання не дає відновити інший документ або ті самі контури з іншими
+ * лімітами руху (нумерація блоків тоді інша).
+ *
+ * Файл — кілька рядків `ключ значення` у `$XDG_STATE_HOME/cplot/checkpoint`
+ * (або `~/.local/state/cplot/checkpoint`); записується атомарно через перейменування.
+ */
+#ifndef CPLOT_CHECKPOINT_H
+#define CPLOT_CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Збережений стан перерваного друку.
+ */
+typedef struct {
+    uint64_t job;              /**< Відбиток завдання (контури, ліміти, модель). */
+    char model[32];            /**< Модель пристрою (для журналу; може бути порожньою). */
+    unsigned long seq;         /**< Останній підтверджений блок. */
+    unsigned long resume_seq;  /**< Блок, з якого продовжувати (початок штриха). */
+    bool pen_down;             /**< Стан пера на блоці `seq`. */
+} checkpoint_t;
+
+/**
+ * @brief Обчислює шлях до файлу точки відновлення.
+ * @param buf [out] Буфер.
+ * @param buflen Розмір буфера.
+ * @return 0 — успіх; -1 — немає XDG_STATE_HOME/HOME або замалий буфер.
+ */
+int checkpoint_path (char *buf, size_t buflen);
+
+/**
+ * @brief Атомарно записує точку відновлення.
+ * @param cp Стан друку.
+ * @return 0 — успіх; -1 — помилка (у журналі).
+ */
+int checkpoint_save (const checkpoint_t *cp);
+
+/**
+ * @brief Читає точку відновлення.
+ * @param cp [out] Стан друку.
+ * @return 0 — прочитано; 1 — файлу немає; -1 — файл пошкоджений або недоступний.
+ */
+int checkpoint_load (checkpoint_t *cp);
+
+/** Видаляє точку відновлення (відсутній файл — не помилка). */
+void checkpoint_clear (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -12,8 +12,152 @@
 #include "log.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+/**
+ * @brief Читає вхід підкоманди з файлу або, якщо імʼя не задано, зі stdin.
+ * @param file_name Шлях до файлу (порожній — stdin, якщо він не термінал).
+ * @param out_chars [out] Вміст із завершальним `\0` (malloc; звільняє викликач).
+ * @param out_len [out] Довжина вмісту, байт.
+ * @return 0 — успіх, 1 — помилка читання.
+ */
+static int cli_read_input (const char *file_name, char **out_chars, size_t *out_len) {
+    char *owned = NULL;
+    if (file_name[0]) {
+        FILE *fp = fopen (file_name, "rb");
+        if (!fp)
+            return 1;
+        if (fseek (fp, 0, SEEK_END) != 0) {
+            fclose (fp);
+            return 1;
+        }
+        long sz = ftell (fp);
+        if (sz < 0) {
+            fclose (fp);
+            return 1;
+        }
+        if (fseek (fp, 0, SEEK_SET) != 0) {
+            fclose (fp);
+            return 1;
+        }
+        owned = (char *)malloc ((size_t)sz + 1);
+        if (!owned) {
+            fclose (fp);
+            return 1;
+        }
+        size_t rd = (sz > 0) ? fread (owned, 1, (size_t)sz, fp) : 0;
+        fclose (fp);
+        if (rd != (size_t)sz) {
+            free (owned);
+            return 1;
+        }
+        owned[rd] = '\0';
+        *out_chars = owned;
+        *out_len = rd;
+    } else {
+        if (isatty (STDIN_FILENO))
+            return 1;
+        size_t cap = 8192;
+        size_t len = 0;
+        owned = (char *)malloc (cap);
+        if (!owned)
+            return 1;
+        while (!feof (stdin) && !ferror (stdin)) {
+            if (len + 4096 > cap) {
+                size_t nc = cap * 2;
+                char *nb = (char *)realloc (owned, nc);
+                if (!nb) {
+                    free (owned);
+                    return 1;
+                }
+                owned = nb;
+                cap = nc;
+            }
+            size_t chunk = cap - len;
+            size_t n = fread (owned + len, 1, chunk, stdin);
+            len += n;
+            if (n == 0)
+                break;
+        }
+        if (ferror (stdin)) {
+            free (owned);
+            return 1;
+        }
+        owned = (char *)realloc (owned, len + 1);
+        if (!owned)
+            return 1;
+        owned[len] = '\0';
+        *out_chars = owned;
+        *out_len = len;
+    }
+    return 0;
+}
+
+/**
+ * @brief Вхід підкоманди: власний буфер або відображений у памʼять файл.
+ */
+typedef struct {
+    char *owned;       /**< Буфер `cli_read_input` (NULL — немає). */
+    void *map;         /**< Відображення файла (NULL — немає). */
+    const char *chars; /**< Вміст. */
+    size_t len;        /**< Довжина вмісту, байт. */
+} cli_input_t;
+
+/**
+ * @brief Відкриває вхід; файли SVG відображаються у памʼять, а не копіюються.
+ * @details Імпорт SVG читає документ послідовно й лише через довжину, тож великі
+ *          експорти з CAD не займають копії в памʼяті; сторінки відображення
+ *          підтягуються й витісняються ядром по ходу розбору.
+ * @param file_name Шлях до файлу (порожній — stdin).
+ * @param format Формат входу.
+ * @param in [out] Вхід (закрити `cli_input_close`).
+ * @return 0 — успіх, 1 — помилка читання.
+ */
+static int cli_input_open (const char *file_name, input_format_t format, cli_input_t *in) {
+    memset (in, 0, sizeof (*in));
+    if (format == INPUT_FORMAT_SVG && file_name[0]) {
+        FILE *fp = fopen (file_name, "rb");
+        if (!fp)
+            return 1;
+        struct stat st;
+        if (fstat (fileno (fp), &st) != 0) {
+            fclose (fp);
+            return 1;
+        }
+        if (st.st_size == 0) {
+            fclose (fp);
+            in->chars = "";
+            return 0;
+        }
+        void *map = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno (fp), 0);
+        fclose (fp);
+        if (map == MAP_FAILED)
+            return 1;
+        (void)madvise (map, (size_t)st.st_size, MADV_SEQUENTIAL);
+        in->map = map;
+        in->chars = (const char *)map;
+        in->len = (size_t)st.st_size;
+        return 0;
+    }
+    if (cli_read_input (file_name, &in->owned, &in->len) != 0)
+        return 1;
+    in->chars = in->owned;
+    return 0;
+}
+
+/**
+ * @brief Звільняє вхід підкоманди.
+ */
+static void cli_input_close (cli_input_t *in) {
+    if (in->map)
+        munmap (in->map, in->len);
+    free (in->owned);
+    memset (in, 0, sizeof (*in));
+}
+
 /**
  * @brief Маршрутизує виконання підкоманд згідно з розібраними опціями.
  * @param options Розібрані параметри CLI.
@@ -36,117 +180,135 @@ int cli_run (const options_t *options, int argc, char *argv[]) {
     case CMD_PRINT: {
         const args_print_options_t *print = &options->print;
 
-        char *owned = NULL;
-        size_t in_len = 0;
-        const char *in_chars = NULL;
-        if (print->file_name[0]) {
-            FILE *fp = fopen (print->file_name, "rb");
-            if (!fp)
-                return 1;
-            if (fseek (fp, 0, SEEK_END) != 0) {
-                fclose (fp);
-                return 1;
-            }
-            long sz = ftell (fp);
-            if (sz < 0) {
-                fclose (fp);
-                return 1;
-            }
-            if (fseek (fp, 0, SEEK_SET) != 0) {
-                fclose (fp);
-                return 1;
-            }
-            owned = (char *)malloc ((size_t)sz + 1);
-            if (!owned) {
-                fclose (fp);
-                return 1;
-            }
-            size_t rd = (sz > 0) ? fread (owned, 1, (size_t)sz, fp) : 0;
-            fclose (fp);
-            if (rd != (size_t)sz) {
-                free (owned);
-                return 1;
-            }
-            owned[rd] = '\0';
-            in_chars = owned;
-            in_len = rd;
-        } else {
-            if (isatty (STDIN_FILENO))
-                return 1;
-            size_t cap = 8192;
-            size_t len = 0;
-            owned = (char *)malloc (cap);
-            if (!owned)
+        cli_input_t in;
+        if (cli_input_open (print->file_name, print->input_format, &in) != 0)
+            return 1;
+        const char *in_chars = in.chars;
+        size_t in_len = in.len;
+        const char *family = print->font_family;
+        const char *model
+            = print->device_model[0] ? print->device_model : options->device.device_model;
+        if (print->paginate) {
+            if (print->resume) {
+                LOGE ("--resume не поєднується з --paginate");
+                cli_input_close (&in);
                 return 1;
-            while (!feof (stdin) && !ferror (stdin)) {
-                if (len + 4096 > cap) {
-                    size_t nc = cap * 2;
-                    char *nb = (char *)realloc (owned, nc);
-                    if (!nb) {
-                        free (owned);
-                        return 1;
-                    }
-                    owned = nb;
-                    cap = nc;
-                }
-                size_t chunk = cap - len;
-                size_t n = fread (owned + len, 1, chunk, stdin);
-                len += n;
-                if (n == 0)
-                    break;
             }
-            if (ferror (stdin)) {
-                free (owned);
+            if (print->input_format == INPUT_FORMAT_SVG) {
+                LOGE ("--paginate верстає лише текст і Markdown, не SVG");
+                cli_input_close (&in);
                 return 1;
             }
-            owned = (char *)realloc (owned, len + 1);
-            if (!owned)
-                return 1;
-            owned[len] = '\0';
-            in_chars = owned;
-            in_len = len;
-        }
-        const char *family = print->font_family;
-        const char *model
-            = print->device_model[0] ? print->device_model : options->device.device_model;
-        if (print->preview) {
-            LOGD ("cli: fit_page option=%d", print->fit_page ? 1 : 0);
-            uint8_t *bytes = NULL;
-            size_t blen = 0;
-            int rc = cmd_print_preview (
+            if (print->fit_page_set)
+                LOGW ("--fit-page ігнорується з --paginate");
+            int rc = cmd_print_pages (
                 in_chars, in_len, print->input_format == INPUT_FORMAT_MARKDOWN, family,
                 print->font_size_pt, model, print->paper_w_mm, print->paper_h_mm,
                 print->margin_top_mm, print->margin_right_mm, print->margin_bottom_mm,
-                print->margin_left_mm, print->orientation, print->fit_page ? 1 : 0,
-                print->preview_png ? 1 : 0, options->verbose, &bytes, &blen);
-            if (rc == 0 && bytes) {
-                if (print->output_path[0]) {
-                    FILE *fp = fopen (print->output_path, "wb");
-                    if (!fp)
-                        rc = 1;
-                    else {
-                        fwrite (bytes, 1, blen, fp);
-                        fclose (fp);
-                    }
-                } else {
-                    fwrite (bytes, 1, blen, stdout);
+                print->margin_left_mm, print->orientation, print->motion_profile,
+                print->optimize_travel, print->preview, print->preview_png ? 1 : 0,
+                print->preview_dpi, print->preview_max_width, print->output_path,
+                print->dry_run, print->estimate, print->page_hook, options->verbose);
+            cli_input_close (&in);
+            return rc;
+        }
+        if (print->preview) {
+            LOGD ("cli: fit_page option=%d", print->fit_page ? 1 : 0);
+            FILE *fp = stdout;
+            if (print->output_path[0]) {
+                fp = fopen (print->output_path, "wb");
+                if (!fp) {
+                    LOGE ("Не вдалося відкрити файл для запису: %s", print->output_path);
+                    cli_input_close (&in);
+                    return 1;
                 }
-                free (bytes);
             }
-            free (owned);
+            sink_t out;
+            sink_init_file (&out, fp);
+            int rc = cmd_print_preview (
+                in_chars, in_len, print->input_format, family, print->font_size_pt, model,
+                print->paper_w_mm, print->paper_h_mm, print->margin_top_mm,
+                print->margin_right_mm, print->margin_bottom_mm, print->margin_left_mm,
+                print->orientation, print->fit_page ? 1 : 0, print->preview_png ? 1 : 0,
+                print->preview_dpi, print->preview_max_width, options->verbose, &out);
+            if (fp != stdout) {
+                if (fclose (fp) != 0)
+                    rc = 1;
+                if (rc != 0)
+                    remove (print->output_path);
+            } else if (fflush (fp) != 0) {
+                rc = 1;
+            }
+            cli_input_close (&in);
             return rc;
         } else {
             int rc = cmd_print_execute (
-                in_chars, in_len, print->input_format == INPUT_FORMAT_MARKDOWN, family,
-                print->font_size_pt, model, print->paper_w_mm, print->paper_h_mm,
-                print->margin_top_mm, print->margin_right_mm, print->margin_bottom_mm,
-                print->margin_left_mm, print->orientation, print->fit_page,
-                print->motion_profile, print->dry_run,
+                in_chars, in_len, print->input_format, family, print->font_size_pt, model,
+                print->paper_w_mm, print->paper_h_mm, print->margin_top_mm,
+                print->margin_right_mm, print->margin_bottom_mm, print->margin_left_mm,
+                print->orientation, print->fit_page, print->motion_profile,
+                print->optimize_travel, print->dry_run, print->estimate, print->resume,
                 options->verbose);
-            free (owned);
+            cli_input_close (&in);
             return rc;
         }
     }
+    case CMD_PLAN: {
+        const args_print_options_t *print = &options->print;
+        const char *model
+            = print->device_model[0] ? print->device_model : options->device.device_model;
+        if (print->replay_path[0])
+            return cmd_plan_replay (
+                print->replay_path, model, print->dry_run, print->estimate, options->verbose);
+        cli_input_t in;
+        if (cli_input_open (print->file_name, print->input_format, &in) != 0)
+            return 1;
+        int rc = cmd_plan_save (
+            in.chars, in.len, print->input_format, print->font_family, print->font_size_pt,
+            model, print->paper_w_mm, print->paper_h_mm, print->margin_top_mm,
+            print->margin_right_mm, print->margin_bottom_mm, print->margin_left_mm,
+            print->orientation, print->fit_page, print->motion_profile, print->optimize_travel,
+            print->output_path, options->verbose);
+        cli_input_close (&in);
+        return rc;
+    }
+    case CMD_BATCH: {
+        const args_print_options_t *print = &options->print;
+        if (print->input_format == INPUT_FORMAT_SVG) {
+            LOGE ("--format svg підтримують лише print і plan");
+            return 1;
+        }
+        char *manifest = NULL;
+        size_t manifest_len = 0;
+        if (cli_read_input (print->file_name, &manifest, &manifest_len) != 0)
+            return 1;
+        const char *model
+            = print->device_model[0] ? print->device_model : options->device.device_model;
+        int rc = cmd_batch_execute (
+            manifest, manifest_len, print->input_format == INPUT_FORMAT_MARKDOWN,
+            print->font_family, print->font_size_pt, model, print->paper_w_mm, print->paper_h_mm,
+            print->margin_top_mm, print->margin_right_mm, print->margin_bottom_mm,
+            print->margin_left_mm, print->orientation, print->fit_page, print->motion_profile,
+            print->optimize_travel, print->dry_run, print->estimate, print->devices,
+            options->verbose);
+        free (manifest);
+        return rc;
+    }
+    case CMD_SERVE: {
+        const args_print_options_t *print = &options->print;
+        if (print->input_format == INPUT_FORMAT_SVG) {
+            LOGE ("--format svg підтримують лише print і plan");
+            return 1;
+        }
+        const char *model
+            = print->device_model[0] ? print->device_model : options->device.device_model;
+        return cmd_serve_execute (
+            print->socket_path, print->input_format == INPUT_FORMAT_MARKDOWN, print->font_family,
+            print->font_size_pt, model, print->paper_w_mm, print->paper_h_mm,
+            print->margin_top_mm, print->margin_right_mm, print->margin_bottom_mm,
+            print->margin_left_mm, print->orientation, print->fit_page, print->motion_profile,
+            print->optimize_travel, print->dry_run, options->verbose);
+    }
     case CMD_DEVICE: {
         const args_device_options_t *device = &options->device;
         const char *alias = device->remote_device;
@@ -210,6 +372,8 @@ int cli_run (const options_t *options, int argc, char *argv[]) {
         }
     }
 
+    case CMD_TRACE:
+        return cmd_trace_execute (options->print.file_name, options->verbose);
     case CMD_VERSION:
         return cmd_version_execute (options->verbose);
     default:
@@ -2,7 +2,7 @@
 /**
  * @file cmd.c
  * @ingroup cmd
- * @brief Фасади CLI-підкоманд: `print`, `device`, `config`, `fonts`, `version`.
+ * @brief Фасади CLI-підкоманд: `print`, `batch`, `device`, `config`, `fonts`, `version`.
  *
  * @details
  * Цей модуль реалізує високорівневі обробники підкоманд CLI та координує роботу
@@ -30,21 +30,34 @@
 #include "drawing.h"
 #include "fontreg.h"
 #include "geom.h"
+#include "jobarena.h"
+#include "jsr.h"
+#include "layoutcache.h"
 #include "log.h"
 #include "markdown.h"
+#include "page.h"
+#include "parallel.h"
+#include "pathopt.h"
+#include "planfile.h"
 #include "png.h"
+#include "portcache.h"
 #include "proginfo.h"
 #include "svg.h"
+#include "svgread.h"
 
 #include "canvas.h"
 #include "plot.h"
 #include "serial.h"
+#include "serve.h"
 #include "stepper.h"
 #include "str.h"
+#include "trace.h"
+#include "ttime.h"
 #include <ctype.h>
 #include <glob.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -65,15 +78,15 @@ typedef enum {
     PREVIEW_FMT_PNG = 1, /**< Растровий PNG. */
 } preview_fmt_t;
 /**
- * @brief Серіалізація побудованої розкладки у SVG/PNG як байти.
+ * @brief Потоковий запис побудованої розкладки у SVG/PNG.
  * @param layout Готова розкладка.
  * @param fmt Формат виводу (SVG або PNG).
- * @param out_bytes [out] Буфер результату (mallocʼується всередині; викликальник звільняє).
- * @param out_len [out] Розмір буфера.
+ * @param opts Роздільність превʼю (NULL — типова).
+ * @param out Приймач байтів.
  * @return 0 — успіх, інакше код помилки.
  */
-static int cmd_layout_to_bytes (
-    const drawing_layout_t *layout, preview_fmt_t fmt, uint8_t **out_bytes, size_t *out_len);
+static int cmd_layout_write (
+    const drawing_layout_t *layout, preview_fmt_t fmt, const preview_opts_t *opts, sink_t *out);
 
 /**
  * @brief Рівень докладності для внутрішніх операцій команд.
@@ -111,6 +124,7 @@ static void cmd_axidraw_settings_from_config (axidraw_settings_t *out, const con
         return;
     out->pen_up_delay_ms = cfg->pen_up_delay_ms;
     out->pen_down_delay_ms = cfg->pen_down_delay_ms;
+    out->pen_lead_ms = cfg->pen_lead_ms;
     out->pen_up_pos = cfg->pen_up_pos;
     out->pen_down_pos = cfg->pen_down_pos;
     out->pen_up_speed = cfg->pen_up_speed;
@@ -162,11 +176,14 @@ static bool cmd_load_axidraw_settings (const char *model, axidraw_settings_t *se
 /** Максимальна тривалість сегмента руху у мілісекундах (обмеження EBB). */
 
 /**
- * @brief Попереджає про зайнятість пристрою, читаючи інформацію з lock-файлу.
+ * @brief Попереджає про зайнятість пристрою, читаючи інформацію з lock-файлу порту.
+ * @param port Шлях до порту (NULL або порожній — загальний lock).
  */
-static void cmd_warn_device_busy (void) {
+static void cmd_warn_device_busy (const char *port) {
     char holder[64] = "невідомий процес";
-    const char *lock_path = axidraw_device_lock_file ();
+    char lock_path[PATH_MAX];
+    if (axidraw_device_lock_path (port, lock_path, sizeof (lock_path)) != 0)
+        str_string_copy (lock_path, sizeof (lock_path), axidraw_device_lock_file ());
     FILE *lf = fopen (lock_path, "r");
     if (lf) {
         if (fgets (holder, sizeof (holder), lf)) {
@@ -245,16 +262,10 @@ static int cmd_with_axidraw_device (
     bool wait_idle) {
     int status = 0;
     int lock_fd = -1;
-    if (axidraw_device_lock_acquire (&lock_fd) != 0) {
-        cmd_warn_device_busy ();
-        return 1;
-    }
-
     axidraw_settings_t settings;
     if (!cmd_load_axidraw_settings (model, &settings)) {
         LOGE ("Не вдалося завантажити налаштування для моделі %s", model ? model : "(типова)");
-        status = 1;
-        goto cleanup;
+        return 1;
     }
 
     axidraw_device_t dev;
@@ -262,6 +273,13 @@ static int cmd_with_axidraw_device (
     axidraw_apply_settings (&dev, &settings);
     axidraw_device_config (&dev, port, 9600, 5000, settings.min_cmd_interval_ms);
 
+    /* Lock — на конкретний порт: інші плотери лишаються доступні іншим процесам. */
+    (void)axidraw_device_resolve_port (&dev);
+    if (axidraw_device_lock_acquire_port (dev.port_path, &lock_fd) != 0) {
+        cmd_warn_device_busy (dev.port_path);
+        return 1;
+    }
+
     char errbuf[256];
     if (axidraw_device_connect (&dev, errbuf, sizeof (errbuf)) != 0) {
         LOGE ("Не вдалося підключитися до пристрою: %s", errbuf);
@@ -736,7 +754,6 @@ static int cmd_collect_device_ports (device_port_info_t **ports, size_t *count,
         globfree (&g);
     }
 
-#ifdef __APPLE__
     char guessed[PATH_MAX];
     if (serial_guess_axidraw_port (guessed, sizeof (guessed)) == 0) {
         if (!cmd_device_port_add (ports, count, capacity, guessed)) {
@@ -744,40 +761,109 @@ static int cmd_collect_device_ports (device_port_info_t **ports, size_t *count,
             return -1;
         }
     }
-#endif
 
     return 0;
 }
 
+/** \brief Верхня межа одночасних опитувань портів. */
+#define CMD_PROBE_MAX_THREADS 16
+
+/**
+ * @brief Опитує один порт: відкриття і команда `V` з тайм‑аутом; зчитує версію.
+ * @param arg `device_port_info_t`.
+ * @return NULL.
+ */
+static void *cmd_probe_device_port (void *arg) {
+    device_port_info_t *port = (device_port_info_t *)arg;
+    char errbuf[128] = { 0 };
+    serial_port_t *sp = serial_open (port->path, 9600, 2000, errbuf, sizeof (errbuf));
+    if (!sp) {
+        str_string_copy (
+            port->detail, sizeof (port->detail), errbuf[0] ? errbuf : "не вдалося відкрити порт");
+        return NULL;
+    }
+    char version[sizeof (port->version)];
+    if (serial_probe_ebb (sp, version, sizeof (version)) == 0) {
+        port->responsive = true;
+        str_string_copy (port->version, sizeof (port->version), version);
+    } else {
+        str_string_copy (port->detail, sizeof (port->detail), "немає відповіді від контролера");
+    }
+    serial_close (sp);
+    return NULL;
+}
+
 /**
  * @brief Перевіряє відповіді від контролера для кожного порту та зчитує версію.
+ * @details Пристрій, що за кешем портів уже відповідав на тому самому порту, не
+ *          опитується. Решта портів опитуються одночасно (потік на порт), тож загальний
+ *          час — один тайм‑аут, а не сума. Порти, що відповіли, дописуються в кеш.
  */
 static void cmd_probe_device_ports (device_port_info_t *ports, size_t count) {
     if (!ports)
         return;
+    portcache_entry_t cache[PORTCACHE_MAX];
+    size_t cached = 0;
+    (void)portcache_load (cache, &cached);
+
+    char(*ids)[sizeof (cache[0].id)] = calloc (count ? count : 1, sizeof (*ids));
+    size_t hits = 0;
     for (size_t i = 0; i < count; ++i) {
-        char errbuf[128] = { 0 };
-        serial_port_t *sp = serial_open (ports[i].path, 9600, 2000, errbuf, sizeof (errbuf));
-        if (!sp) {
-            if (errbuf[0])
-                strncpy (ports[i].detail, errbuf, sizeof (ports[i].detail) - 1);
-            else
-                strncpy (ports[i].detail, "не вдалося відкрити порт", sizeof (ports[i].detail) - 1);
-            ports[i].detail[sizeof (ports[i].detail) - 1] = '\0';
+        if (!ids || serial_port_identity (ports[i].path, ids[i], sizeof (ids[i])) != 0)
             continue;
+        const portcache_entry_t *hit = portcache_find (cache, cached, ids[i]);
+        if (!hit || strcmp (hit->path, ports[i].path) != 0)
+            continue;
+        ports[i].responsive = true;
+        str_string_copy (ports[i].version, sizeof (ports[i].version), hit->version);
+        str_string_copy (ports[i].detail, sizeof (ports[i].detail), "з кешу");
+        ++hits;
+    }
+
+    size_t probed = 0;
+    for (size_t base = 0; base < count; base += CMD_PROBE_MAX_THREADS) {
+        pthread_t threads[CMD_PROBE_MAX_THREADS];
+        bool started[CMD_PROBE_MAX_THREADS] = { false };
+        size_t n = count - base < CMD_PROBE_MAX_THREADS ? count - base : CMD_PROBE_MAX_THREADS;
+        for (size_t k = 0; k < n; ++k) {
+            device_port_info_t *port = &ports[base + k];
+            if (port->responsive)
+                continue;
+            ++probed;
+            started[k] = pthread_create (&threads[k], NULL, cmd_probe_device_port, port) == 0;
+            if (!started[k])
+                cmd_probe_device_port (port);
         }
-        char version[sizeof (ports[i].version)];
-        if (serial_probe_ebb (sp, version, sizeof (version)) == 0) {
-            ports[i].responsive = true;
-            strncpy (ports[i].version, version, sizeof (ports[i].version) - 1);
-            ports[i].version[sizeof (ports[i].version) - 1] = '\0';
-        } else {
-            strncpy (
-                ports[i].detail, "немає відповіді від контролера", sizeof (ports[i].detail) - 1);
-            ports[i].detail[sizeof (ports[i].detail) - 1] = '\0';
-        }
-        serial_close (sp);
+        for (size_t k = 0; k < n; ++k)
+            if (started[k])
+                pthread_join (threads[k], NULL);
+    }
+    LOGD ("порти: з кешу %zu, опитано %zu", hits, probed);
+
+    if (!ids || probed == 0) {
+        free (ids);
+        return;
     }
+    /* Нові записи — першими; пристрої, яких зараз немає, лишаються до витіснення. */
+    portcache_entry_t next[PORTCACHE_MAX];
+    size_t next_len = 0;
+    for (size_t i = 0; i < count && next_len < PORTCACHE_MAX; ++i) {
+        if (!ports[i].responsive || !ids[i][0])
+            continue;
+        portcache_entry_t *e = &next[next_len++];
+        str_string_copy (e->id, sizeof (e->id), ids[i]);
+        str_string_copy (e->path, sizeof (e->path), ports[i].path);
+        str_string_copy (e->version, sizeof (e->version), ports[i].version);
+    }
+    for (size_t j = 0; j < cached && next_len < PORTCACHE_MAX; ++j) {
+        bool present = false;
+        for (size_t i = 0; i < count && !present; ++i)
+            present = strcmp (ids[i], cache[j].id) == 0;
+        if (!present)
+            next[next_len++] = cache[j];
+    }
+    (void)portcache_store (next, next_len);
+    free (ids);
 }
 
 /**
@@ -1364,6 +1450,19 @@ static int cmd_config_apply_pair (config_t *cfg, const char *key_raw, const char
         return 0;
     }
 
+    if (strcmp (key, "travel_speed_mm_s") == 0 || strcmp (key, "travel_speed") == 0) {
+        if (!cmd_parse_double_str (value_buf, &dbl))
+            return -1;
+        cfg->travel_speed_mm_s = dbl;
+        return 0;
+    }
+    if (strcmp (key, "travel_accel_mm_s2") == 0 || strcmp (key, "travel_accel") == 0) {
+        if (!cmd_parse_double_str (value_buf, &dbl))
+            return -1;
+        cfg->travel_accel_mm_s2 = dbl;
+        return 0;
+    }
+
     if (strcmp (key, "pen_up_pos") == 0 || strcmp (key, "pen_up") == 0)
         return -1;
     if (strcmp (key, "pen_down_pos") == 0 || strcmp (key, "pen_down") == 0)
@@ -1392,12 +1491,59 @@ static int cmd_config_apply_pair (config_t *cfg, const char *key_raw, const char
         cfg->pen_down_delay_ms = integer;
         return 0;
     }
+    if (strcmp (key, "pen_lead_ms") == 0 || strcmp (key, "pen_lead") == 0) {
+        if (!cmd_parse_int_str (value_buf, &integer))
+            return -1;
+        cfg->pen_lead_ms = integer;
+        return 0;
+    }
     if (strcmp (key, "servo_timeout_s") == 0 || strcmp (key, "servo_timeout") == 0) {
         if (!cmd_parse_int_str (value_buf, &integer))
             return -1;
         cfg->servo_timeout_s = integer;
         return 0;
     }
+    if (strcmp (key, "pen_hop_mm") == 0 || strcmp (key, "pen_hop") == 0) {
+        if (!cmd_parse_double_str (value_buf, &dbl))
+            return -1;
+        cfg->pen_hop_mm = dbl;
+        return 0;
+    }
+    if (strcmp (key, "jerk_mm_s3") == 0 || strcmp (key, "jerk") == 0) {
+        if (!cmd_parse_double_str (value_buf, &dbl))
+            return -1;
+        cfg->jerk_mm_s3 = dbl;
+        return 0;
+    }
+    if (strcmp (key, "merge_phases") == 0) {
+        if (!cmd_parse_int_str (value_buf, &integer))
+            return -1;
+        cfg->merge_phases = integer;
+        return 0;
+    }
+    if (strcmp (key, "simplify_tol_mm") == 0 || strcmp (key, "simplify_tol") == 0) {
+        if (!cmd_parse_double_str (value_buf, &dbl))
+            return -1;
+        cfg->simplify_tol_mm = dbl;
+        return 0;
+    }
+    if (strcmp (key, "chord_tol_mm") == 0 || strcmp (key, "chord_tol") == 0) {
+        if (!cmd_parse_double_str (value_buf, &dbl))
+            return -1;
+        cfg->chord_tol_mm = dbl;
+        return 0;
+    }
+    if (strcmp (key, "line_break") == 0) {
+        /* Назви — як у `config --show`; 0/1 лишаються синонімами. */
+        if (strcmp (value_buf, "greedy") == 0)
+            integer = 0;
+        else if (strcmp (value_buf, "optimal") == 0)
+            integer = 1;
+        else if (!cmd_parse_int_str (value_buf, &integer))
+            return -1;
+        cfg->line_break = integer;
+        return 0;
+    }
     if (strcmp (key, "orientation") == 0 || strcmp (key, "orient") == 0)
         return -1;
 
@@ -1500,6 +1646,7 @@ static int cmd_build_print_page (
     page->margin_bottom_mm = final_margin_bottom;
     page->margin_left_mm = final_margin_left;
     page->orientation = final_orientation;
+    page->arena = NULL;
 
     if (!(page->paper_w_mm > 0.0) || !(page->paper_h_mm > 0.0)) {
         LOGE ("Не задано розміри паперу — оберіть активний пристрій (`cplot device profile`)");
@@ -1518,33 +1665,116 @@ static int cmd_build_print_page (
     return 0;
 }
 
-static int cmd_layout_to_bytes (
-    const drawing_layout_t *layout, preview_fmt_t format, uint8_t **out_bytes, size_t *out_len) {
-    if (!out_bytes || !out_len)
+static int cmd_layout_write (
+    const drawing_layout_t *layout, preview_fmt_t format, const preview_opts_t *opts, sink_t *out) {
+    if (!out)
         return 1;
-    *out_bytes = NULL;
-    *out_len = 0;
-    bytes_t out = { 0 };
-    int rc = (format == PREVIEW_FMT_PNG) ? png_render_layout (layout, &out)
-                                         : svg_render_layout (layout, &out);
-    if (rc == 0 && out.bytes) {
-        *out_bytes = out.bytes;
-        *out_len = out.len;
-    }
+    uint64_t t0 = ttime_stage_begin ();
+    int rc = (format == PREVIEW_FMT_PNG) ? png_write_layout (layout, opts, out)
+                                         : svg_write_layout (layout, opts, out);
+    ttime_stage_end (TTIME_STAGE_PREVIEW, t0);
     return rc;
 }
 
 /**
- * @brief Виконує побудову розкладки та друк (або симуляцію) без генерації превʼю.
- * @return 0 — успіх, інакше код помилки.
+ * @brief Конфігурація завдання: файл користувача з межами моделі.
+ * @details Читається один раз у точці входу команди (`cmd_print_setup`, `cmd_plan_replay`)
+ *          і передається далі: верстці, спрощенню, лімітам планувальника і сеансу пристрою.
+ * @param model Модель пристрою (NULL — типова).
+ * @param out [out] Конфігурація.
  */
+static void cmd_job_config (const char *model, config_t *out) {
+    const char *model_id = (model && *model) ? model : CONFIG_DEFAULT_MODEL;
+    if (config_load (out) != 0)
+        config_factory_defaults (out, model_id);
+    axidraw_device_profile_apply (out, axidraw_device_profile_for_model (model_id));
+}
+
+/** \brief Допуск зшивання кінців контурів, мм. */
+#define CMD_JOIN_TOL_MM 0.002
+
 /**
- * @brief Виконує побудову розкладки та друк (або симуляцію) без генерації превʼю.
- * @param in_chars Вхідний текст.
- * @param in_len Довжина вхідного тексту (байти).
- * @param markdown true — інтерпретувати як Markdown.
- * @param family Родина шрифтів (NULL — брати з конфігурації).
- * @param font_size Кегль у пунктах (<=0 — з конфігурації).
+ * @brief Спрощує контури макета перед плануванням (зшивання, колінеарні точки, RDP).
+ * @details Допуск RDP береться з ключа конфігурації `simplify_tol`; 0 вимикає крок.
+ * @param layout Макет (контури в мм).
+ * @param job Конфігурація завдання (`cmd_job_config`).
+ * @param arena Арена завдання для робочих буферів (NULL — купа).
+ */
+static void
+cmd_simplify_layout (canvas_layout_t *layout, const config_t *job, jobarena_t *arena) {
+    if (!(job->simplify_tol_mm > 0.0))
+        return;
+    geom_paths_t simplified;
+    geom_simplify_stats_t st;
+    uint64_t t0 = ttime_stage_begin ();
+    int rc = geom_paths_simplify (
+        &layout->paths_mm, CMD_JOIN_TOL_MM, job->simplify_tol_mm, &simplified, &st, arena);
+    ttime_stage_end (TTIME_STAGE_PATHS, t0);
+    if (rc != 0) {
+        LOGW ("Не вдалося спростити контури — планування без спрощення");
+        return;
+    }
+    geom_paths_free (&layout->paths_mm);
+    layout->paths_mm = simplified;
+    LOGD (
+        "спрощення: контурів %zu → %zu, точок %zu → %zu (допуск %.3f мм)", st.paths_before,
+        st.paths_after, st.points_before, st.points_after, job->simplify_tol_mm);
+}
+
+/**
+ * @brief Звітує про арену завдання: лічильники профілю і рядок журналу.
+ * @param arena Арена (після верстки і спрощення).
+ * @param what Назва завдання для журналу.
+ */
+static void cmd_arena_report (const jobarena_t *arena, const char *what) {
+    ttime_count (TTIME_COUNT_ARENA_ALLOCS, arena->allocs);
+    if (ttime_profiling)
+        ttime_counter_max (TTIME_COUNT_ARENA_PEAK, arena->peak);
+    LOGD (
+        "%s: арена — виділень %llu, пік %zu КіБ", what, (unsigned long long)arena->allocs,
+        (arena->peak + 1023u) / 1024u);
+}
+
+/**
+ * @brief Межі переїздів з піднятим пером: конфігурація (`travel_speed`, `travel_accel`)
+ *        або механічні межі моделі, якщо ключ дорівнює 0.
+ * @param job Конфігурація завдання (`cmd_job_config`).
+ * @param model Модель пристрою (NULL — типова).
+ * @param out_speed [out] Швидкість переїздів, мм/с.
+ * @param out_accel [out] Прискорення переїздів, мм/с².
+ */
+static void cmd_travel_limits (
+    const config_t *job, const char *model, double *out_speed, double *out_accel) {
+    const axidraw_device_profile_t *profile = axidraw_device_profile_for_model (model);
+    *out_speed = job->travel_speed_mm_s > 0.0 ? job->travel_speed_mm_s : profile->travel_speed_mm_s;
+    *out_accel
+        = job->travel_accel_mm_s2 > 0.0 ? job->travel_accel_mm_s2 : profile->travel_accel_mm_s2;
+}
+
+/**
+ * @brief Переставляє контури макета для коротших переїздів без пера і звітує про виграш.
+ * @param layout Макет (контури в мм).
+ */
+static void cmd_optimize_travel (canvas_layout_t *layout) {
+    pathopt_stats_t st;
+    uint64_t t0 = ttime_stage_begin ();
+    int rc = pathopt_optimize_order (&layout->paths_mm, NULL, &st);
+    ttime_stage_end (TTIME_STAGE_PATHS, t0);
+    if (rc != 0) {
+        LOGW ("Не вдалося оптимізувати порядок контурів — друк у вихідному порядку");
+        return;
+    }
+    double gain
+        = (st.travel_before > 0.0) ? (1.0 - st.travel_after / st.travel_before) * 100.0 : 0.0;
+    LOGI (
+        "Переїзди без пера: %.1f мм → %.1f мм (−%.1f%%, розвернуто контурів: %zu)",
+        st.travel_before, st.travel_after, gain, st.reversed);
+}
+
+/**
+ * @brief Підставляє типові значення з конфігурації та будує сторінку друку.
+ * @param cfg [out] Типові налаштування моделі (зберігають рядок типової родини).
+ * @param job [out] Конфігурація завдання (`cmd_job_config`) — єдине читання файлу за запуск.
  * @param model Модель пристрою (NULL — типова).
  * @param paper_w Ширина паперу, мм (<=0 — з профілю).
  * @param paper_h Висота паперу, мм (<=0 — з профілю).
@@ -1554,16 +1784,14 @@ static int cmd_layout_to_bytes (
  * @param margin_left Ліве поле, мм (<0 — з конфіг.).
  * @param orientation Орієнтація (портрет/альбом).
  * @param fit_page true — масштабувати під рамку.
- * @param dry_run true — без надсилання на пристрій.
- * @param verbose true — докладні журнали.
+ * @param inout_family [in,out] Родина шрифтів (порожня — з конфігурації).
+ * @param inout_font_size [in,out] Кегль, пт (<=0 — з конфігурації).
+ * @param out_page [out] Параметри сторінки.
  * @return 0 — успіх, інакше код помилки.
  */
-cmd_result_t cmd_print_execute (
-    const char *in_chars,
-    size_t in_len,
-    bool markdown,
-    const char *family,
-    double font_size,
+static int cmd_print_setup (
+    config_t *cfg,
+    config_t *job,
     const char *model,
     double paper_w,
     double paper_h,
@@ -1573,205 +1801,297 @@ cmd_result_t cmd_print_execute (
     double margin_left,
     int orientation,
     bool fit_page,
-    motion_profile_t motion_profile,
-    bool dry_run,
-    bool verbose) {
-    (void)dry_run;
-    (void)verbose;
-    if (!in_chars && in_len > 0)
-        return 1;
-    config_t cfg;
+    const char **inout_family,
+    double *inout_font_size,
+    drawing_page_t *out_page) {
     const char *model_or_null = (model && *model) ? model : NULL;
-    config_factory_defaults (&cfg, model_or_null);
-    if (!family || (family && *family == '\0'))
-        family = (cfg.font_family[0] ? cfg.font_family : NULL);
-    if (!(font_size > 0.0))
-        font_size = cfg.font_size_pt;
+    config_factory_defaults (cfg, model_or_null);
+    cmd_job_config (model_or_null, job);
+    if (!*inout_family || **inout_family == '\0')
+        *inout_family = (cfg->font_family[0] ? cfg->font_family : NULL);
+    if (!(*inout_font_size > 0.0))
+        *inout_font_size = cfg->font_size_pt;
     if (!(paper_w > 0.0))
-        paper_w = cfg.paper_w_mm;
+        paper_w = cfg->paper_w_mm;
     if (!(paper_h > 0.0))
-        paper_h = cfg.paper_h_mm;
+        paper_h = cfg->paper_h_mm;
     if (margin_top < 0.0)
-        margin_top = cfg.margin_top_mm;
+        margin_top = cfg->margin_top_mm;
     if (margin_right < 0.0)
-        margin_right = cfg.margin_right_mm;
+        margin_right = cfg->margin_right_mm;
     if (margin_bottom < 0.0)
-        margin_bottom = cfg.margin_bottom_mm;
+        margin_bottom = cfg->margin_bottom_mm;
     if (margin_left < 0.0)
-        margin_left = cfg.margin_left_mm;
+        margin_left = cfg->margin_left_mm;
 
-    drawing_page_t page;
     int setup_rc = cmd_build_print_page (
-        &page, model, paper_w, paper_h, margin_top, margin_right, margin_bottom, margin_left,
+        out_page, model, paper_w, paper_h, margin_top, margin_right, margin_bottom, margin_left,
         orientation);
     if (setup_rc != 0)
         return setup_rc;
-    page.fit_to_frame = fit_page ? 1 : 0;
-    LOGD ("cmd: fit_page flag=%d", page.fit_to_frame);
-
-    canvas_options_t page_opts = {
-        .paper_w_mm = page.paper_w_mm,
-        .paper_h_mm = page.paper_h_mm,
-        .margin_top_mm = page.margin_top_mm,
-        .margin_right_mm = page.margin_right_mm,
-        .margin_bottom_mm = page.margin_bottom_mm,
-        .margin_left_mm = page.margin_left_mm,
-        .orientation = page.orientation,
-        .font_family = family,
-        .fit_to_frame = page.fit_to_frame ? true : false,
-    };
+    out_page->fit_to_frame = fit_page ? 1 : 0;
+    out_page->break_mode = job->line_break ? TEXT_BREAK_OPTIMAL : TEXT_BREAK_GREEDY;
+    out_page->instanced = 0;
+    out_page->anchored = 0;
+    LOGD ("cmd: fit_page flag=%d", out_page->fit_to_frame);
+    return 0;
+}
 
-    string_t input = { .chars = in_chars ? in_chars : "", .len = in_len, .enc = STR_ENC_UTF8 };
-    if (markdown) {
-        double frame_width_mm = 0.0;
-        canvas_frame_dimensions (&page_opts, &frame_width_mm, NULL);
-        if (!(frame_width_mm > 0.0)) {
-            LOGE ("Недостатня доступна ширина для тексту — перевірте поля та орієнтацію");
-            return 1;
-        }
-        markdown_opts_t mopts = { .family = family,
-                                  .base_size_pt = (font_size > 0.0 ? font_size : 14.0),
-                                  .frame_width_mm = frame_width_mm };
-        geom_paths_t md_paths;
-        if (markdown_render_paths (input.chars, &mopts, &md_paths, NULL) != 0)
-            return 1;
+/**
+ * @brief Обмеження планувальника для профілю руху в межах швидкостей моделі.
+ * @details З обмеженням ривка прискорення наростає плавно, тож профілі допускають
+ *          вище пікове прискорення (у межах моделі). Швидкість і прискорення моделі —
+ *          межі кожного мотора CoreXY: швидкий профіль працює на них без окремої межі
+ *          для пера, тож уздовж осей рух швидший, а діагоналі обмежує навантажений мотор.
+ *          Переїзди з піднятим пером не залежать від профілю: слід не лишається, тож вони
+ *          йдуть на межах переїздів моделі (або конфігурації) у тих самих межах моторів.
+ *          Усі межі — з однієї конфігурації завдання: швидкість і прискорення моделі,
+ *          ривок — ключ `jerk`, допуск хорд — ключ `chord_tol` (0 — режим хорд вимкнено).
+ * @param job Конфігурація завдання (`cmd_job_config`).
+ * @param model Модель пристрою (NULL — типова).
+ * @param motion_profile Профіль руху.
+ * @param out_limits [out] Ліміти планувальника.
+ */
+static void cmd_motion_limits (
+    const config_t *job,
+    const char *model,
+    motion_profile_t motion_profile,
+    planner_limits_t *out_limits) {
+    const char *model_or_null = (model && *model) ? model : NULL;
+    double base_speed = job->speed_mm_s;
+    double base_accel = job->accel_mm_s2;
+    planner_limits_t lim = { 0 };
+    lim.max_jerk_mm_s3 = job->jerk_mm_s3;
+    bool scurve = lim.max_jerk_mm_s3 > 0.0;
+    switch (motion_profile) {
+    case MOTION_PROFILE_PRECISE:
+        lim.max_speed_mm_s = fmin (base_speed, 80.0);
+        lim.max_accel_mm_s2 = fmin (base_accel, scurve ? 160.0 : 120.0);
+        lim.cornering_distance_mm = 0.2;
+        break;
+    case MOTION_PROFILE_FAST:
+        lim.max_speed_mm_s = base_speed;
+        lim.max_accel_mm_s2 = base_accel;
+        lim.cornering_distance_mm = 0.6;
+        break;
+    case MOTION_PROFILE_BALANCED:
+    default:
+        lim.max_speed_mm_s = fmin (base_speed, 120.0);
+        lim.max_accel_mm_s2 = fmin (base_accel, scurve ? 200.0 : 120.0);
+        lim.cornering_distance_mm = 0.4;
+        break;
+    }
+    lim.max_motor_speed_mm_s = base_speed;
+    lim.max_motor_accel_mm_s2 = base_accel;
+    cmd_travel_limits (job, model_or_null, &lim.travel_speed_mm_s, &lim.travel_accel_mm_s2);
+    lim.min_segment_mm = 0.1;
+    lim.chord_tolerance_mm = job->chord_tol_mm;
+    *out_limits = lim;
+}
 
-        if (page.fit_to_frame) {
-            double fw = 0.0, fh = 0.0;
-            canvas_frame_dimensions (&page_opts, &fw, &fh);
-            geom_bbox_t bb;
-            if (geom_bbox_of_paths (&md_paths, &bb) == 0) {
-                double cw = bb.max_x - bb.min_x;
-                double ch = bb.max_y - bb.min_y;
-                if ((cw > 0.0 && ch > 0.0) && ((cw > fw) || (ch > fh))) {
-                    geom_paths_free (&md_paths);
-                    double sx = fw / cw;
-                    double sy = fh / ch;
-                    double s = cmd_clamp_scale (sx < sy ? sx : sy);
-                    double new_pt = mopts.base_size_pt * s;
-                    if (new_pt < 3.0)
-                        new_pt = 3.0;
-                    mopts.base_size_pt = new_pt;
-
-                    if (markdown_render_paths (input.chars, &mopts, &md_paths, NULL) != 0)
-                        return 1;
-                }
-            }
-        }
-        drawing_layout_t layout_info;
-        if (drawing_build_layout_from_paths (&page, &md_paths, &layout_info) != 0) {
-            geom_paths_free (&md_paths);
-            return 1;
-        }
-        geom_paths_free (&md_paths);
+/**
+ * @brief Обрізає розкладку рамкою сторінки, якщо вміст за неї виходить.
+ * @details З `fit_to_frame` полотно вже вписало вміст у рамку, тож крок пропускається.
+ * @param page Параметри сторінки.
+ * @param layout [in,out] Розкладка; за помилки звільняється.
+ * @return 0 — успіх, 1 — помилка.
+ */
+static int cmd_clip_layout (const drawing_page_t *page, drawing_layout_t *layout) {
+    if (page->fit_to_frame)
+        return 0;
+    size_t clipped = 0;
+    if (canvas_layout_clip_to_frame (&layout->layout, &clipped) != 0) {
+        LOGE ("Не вдалося обрізати вміст рамкою сторінки");
+        drawing_layout_dispose (layout);
+        return 1;
+    }
+    if (clipped > 0)
+        LOGW (
+            "Вміст виходить за рамку сторінки — обрізано відрізків: %zu "
+            "(--fit-page вписує вміст, --paginate ділить на сторінки)",
+            clipped);
+    return 0;
+}
 
-        config_t cfg2;
-        const char *model_or_null2 = (model && *model) ? model : NULL;
-        config_factory_defaults (&cfg2, model_or_null2);
-        double base_speed = cfg2.speed_mm_s;
-        double base_accel = cfg2.accel_mm_s2;
-        planner_limits_t lim = { 0 };
-        switch (motion_profile) {
-        case MOTION_PROFILE_PRECISE:
-            lim.max_speed_mm_s = fmin (base_speed, 80.0);
-            lim.max_accel_mm_s2 = fmin (base_accel, 120.0);
-            lim.cornering_distance_mm = 0.2;
-            break;
-        case MOTION_PROFILE_FAST:
-            lim.max_speed_mm_s = fmin (base_speed, 160.0);
-            lim.max_accel_mm_s2 = fmin (base_accel, 160.0);
-            lim.cornering_distance_mm = 0.6;
-            break;
-        case MOTION_PROFILE_BALANCED:
-        default:
-            lim.max_speed_mm_s = fmin (base_speed, 120.0);
-            lim.max_accel_mm_s2 = fmin (base_accel, 120.0);
-            lim.cornering_distance_mm = 0.4;
-            break;
-        }
-        lim.min_segment_mm = 0.1;
+/**
+ * @brief Імпортує контури SVG і розміщує їх на сторінці.
+ * @details Масштаб документа зберігається; `fit_to_frame` вписує його в рамку.
+ * @param page Параметри сторінки.
+ * @param input Байти документа SVG.
+ * @param out_layout [out] Розкладка (звільнити `drawing_layout_dispose`).
+ * @return 0 — успіх, 1 — помилка.
+ */
+static int cmd_svg_build_layout (
+    const drawing_page_t *page, string_t input, drawing_layout_t *out_layout) {
+    geom_paths_t paths;
+    int rc = svgread_paths (input.chars, input.len, NULL, &paths);
+    if (rc != 0) {
+        LOGE (rc > 0 ? "Вхід не є документом SVG" : "Не вдалося імпортувати SVG");
+        return 1;
+    }
+    rc = drawing_build_layout_from_paths (page, &paths, out_layout) != 0 ? 1 : 0;
+    geom_paths_free (&paths);
+    return rc;
+}
 
-        plan_block_t *blocks = NULL;
-        size_t count = 0;
-        if (canvas_generate_motion_plan (&layout_info.layout, &lim, &blocks, &count) != 0) {
-            drawing_layout_dispose (&layout_info);
+/**
+ * @brief Верстає вхід (звичайний текст, Markdown або SVG) і розміщує його на сторінці.
+ * @details При `fit_to_frame` текст підбирає кегль за метриками рядків, а Markdown
+ *          перерендерюється один раз зі зменшеним кеглем, якщо не влазить у рамку.
+ * @param page Параметри сторінки.
+ * @param input Вхідний текст.
+ * @param format Формат входу.
+ * @param family Родина шрифтів (NULL — типова).
+ * @param font_size Кегль, пт.
+ * @param md_threads Потоки для блоків Markdown (0 — за кількістю CPU).
+ * @param out_layout [out] Розкладка (звільнити `drawing_layout_dispose`).
+ * @return 0 — успіх, 1 — помилка.
+ */
+static int cmd_print_build_layout (
+    const drawing_page_t *page,
+    string_t input,
+    input_format_t format,
+    const char *family,
+    double font_size,
+    unsigned md_threads,
+    drawing_layout_t *out_layout) {
+    if (format == INPUT_FORMAT_SVG) {
+        if (cmd_svg_build_layout (page, input, out_layout) != 0)
             return 1;
-        }
-        int rc = plot_execute_plan (blocks, count, model, dry_run, verbose);
-        free (blocks);
-        drawing_layout_dispose (&layout_info);
-        return rc;
-    } else {
-        drawing_layout_t layout_info = { 0 };
-        if (drawing_build_layout (&page, family, font_size, input, &layout_info) != 0)
+        return cmd_clip_layout (page, out_layout);
+    }
+    if (format != INPUT_FORMAT_MARKDOWN) {
+        double layout_pt = font_size;
+        if (page->fit_to_frame)
+            (void)drawing_fit_font_size (page, family, font_size, input, 3.0, &layout_pt);
+        if (drawing_build_layout (page, family, layout_pt, input, out_layout) != 0)
             return 1;
+        return cmd_clip_layout (page, out_layout);
+    }
+
+    canvas_options_t page_opts = {
+        .paper_w_mm = page->paper_w_mm,
+        .paper_h_mm = page->paper_h_mm,
+        .margin_top_mm = page->margin_top_mm,
+        .margin_right_mm = page->margin_right_mm,
+        .margin_bottom_mm = page->margin_bottom_mm,
+        .margin_left_mm = page->margin_left_mm,
+        .orientation = page->orientation,
+        .font_family = family,
+        .fit_to_frame = page->fit_to_frame ? true : false,
+    };
+    double frame_width_mm = 0.0;
+    canvas_frame_dimensions (&page_opts, &frame_width_mm, NULL);
+    if (!(frame_width_mm > 0.0)) {
+        LOGE ("Недостатня доступна ширина для тексту — перевірте поля та орієнтацію");
+        return 1;
+    }
+    markdown_opts_t mopts = { .family = family,
+                              .base_size_pt = (font_size > 0.0 ? font_size : 14.0),
+                              .frame_width_mm = frame_width_mm,
+                              .threads = md_threads,
+                              .break_mode = page->break_mode,
+                              .arena = page->arena };
+    geom_paths_t md_paths;
+    if (markdown_render_paths (input.chars, &mopts, &md_paths, NULL) != 0)
+        return 1;
 
-        if (page.fit_to_frame) {
-            double fw = 0.0, fh = 0.0;
-            canvas_frame_dimensions (&page_opts, &fw, &fh);
-            geom_bbox_t bb = layout_info.layout.bounds_mm;
+    if (page->fit_to_frame) {
+        double fw = 0.0, fh = 0.0;
+        canvas_frame_dimensions (&page_opts, &fw, &fh);
+        geom_bbox_t bb;
+        if (geom_bbox_of_paths (&md_paths, &bb) == 0) {
             double cw = bb.max_x - bb.min_x;
             double ch = bb.max_y - bb.min_y;
             if ((cw > 0.0 && ch > 0.0) && ((cw > fw) || (ch > fh))) {
-                drawing_layout_dispose (&layout_info);
+                geom_paths_free (&md_paths);
                 double sx = fw / cw;
                 double sy = fh / ch;
                 double s = cmd_clamp_scale (sx < sy ? sx : sy);
-                double new_pt = font_size * s;
+                double new_pt = mopts.base_size_pt * s;
                 if (new_pt < 3.0)
                     new_pt = 3.0;
-                if (drawing_build_layout (&page, family, new_pt, input, &layout_info) != 0)
+                mopts.base_size_pt = new_pt;
+
+                if (markdown_render_paths (input.chars, &mopts, &md_paths, NULL) != 0)
                     return 1;
             }
         }
-        config_t cfg2;
-        const char *model_or_null2 = (model && *model) ? model : NULL;
-        config_factory_defaults (&cfg2, model_or_null2);
-        double base_speed = cfg2.speed_mm_s;
-        double base_accel = cfg2.accel_mm_s2;
-        planner_limits_t lim = { 0 };
-        switch (motion_profile) {
-        case MOTION_PROFILE_PRECISE:
-            lim.max_speed_mm_s = fmin (base_speed, 80.0);
-            lim.max_accel_mm_s2 = fmin (base_accel, 120.0);
-            lim.cornering_distance_mm = 0.2;
-            break;
-        case MOTION_PROFILE_FAST:
-            lim.max_speed_mm_s = fmin (base_speed, 160.0);
-            lim.max_accel_mm_s2 = fmin (base_accel, 160.0);
-            lim.cornering_distance_mm = 0.6;
-            break;
-        case MOTION_PROFILE_BALANCED:
-        default:
-            lim.max_speed_mm_s = fmin (base_speed, 120.0);
-            lim.max_accel_mm_s2 = fmin (base_accel, 120.0);
-            lim.cornering_distance_mm = 0.4;
-            break;
-        }
-        lim.min_segment_mm = 0.1;
+    }
+    if (drawing_build_layout_from_paths (page, &md_paths, out_layout) != 0) {
+        geom_paths_free (&md_paths);
+        return 1;
+    }
+    geom_paths_free (&md_paths);
+    return cmd_clip_layout (page, out_layout);
+}
 
-        plan_block_t *blocks = NULL;
-        size_t count = 0;
-        if (canvas_generate_motion_plan (&layout_info.layout, &lim, &blocks, &count) != 0) {
-            drawing_layout_dispose (&layout_info);
-            return 1;
-        }
-        int rc = plot_execute_plan (blocks, count, model, dry_run, verbose);
-        free (blocks);
-        drawing_layout_dispose (&layout_info);
-        return rc;
+/**
+ * @brief Верстає вхід для плотера: сторінка, розкладка, спрощення, порядок контурів, ліміти.
+ * @details Спільна частина `print` і `plan`; параметри — як у `cmd_print_execute`.
+ * @param out_layout [out] Розкладка (звільнити `drawing_layout_dispose`).
+ * @param out_limits [out] Ліміти планувальника для профілю руху.
+ * @param out_job [out] Конфігурація завдання для виконання плану.
+ * @return 0 — успіх, інакше код помилки.
+ */
+static int cmd_print_prepare (
+    const char *in_chars,
+    size_t in_len,
+    input_format_t format,
+    const char *family,
+    double font_size,
+    const char *model,
+    double paper_w,
+    double paper_h,
+    double margin_top,
+    double margin_right,
+    double margin_bottom,
+    double margin_left,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    drawing_layout_t *out_layout,
+    planner_limits_t *out_limits,
+    config_t *out_job) {
+    if (!in_chars && in_len > 0)
+        return 1;
+    config_t cfg;
+    drawing_page_t page;
+    int setup_rc = cmd_print_setup (
+        &cfg, out_job, model, paper_w, paper_h, margin_top, margin_right, margin_bottom,
+        margin_left, orientation, fit_page, &family, &font_size, &page);
+    if (setup_rc != 0)
+        return setup_rc;
+
+    /* Проміжні дані верстки і спрощення — в арені завдання; макет лишається в купі. */
+    jobarena_t arena;
+    jobarena_init (&arena, 0);
+    page.arena = &arena;
+    string_t input = { .chars = in_chars ? in_chars : "", .len = in_len, .enc = STR_ENC_UTF8 };
+    if (cmd_print_build_layout (&page, input, format, family, font_size, 0, out_layout) != 0) {
+        jobarena_free (&arena);
+        return 1;
     }
+
+    cmd_motion_limits (out_job, model, motion_profile, out_limits);
+    cmd_simplify_layout (&out_layout->layout, out_job, &arena);
+    cmd_arena_report (&arena, "print");
+    jobarena_free (&arena);
+    if (optimize_travel)
+        cmd_optimize_travel (&out_layout->layout);
+    return 0;
 }
 
 /**
- * @brief Формує превʼю SVG/PNG для заданого вхідного тексту та параметрів сторінки.
+ * @brief Виконує побудову розкладки та друк (або симуляцію) без генерації превʼю.
  * @return 0 — успіх, інакше код помилки.
  */
 /**
- * @brief Формує превʼю SVG/PNG для заданого вхідного тексту та параметрів сторінки.
+ * @brief Виконує побудову розкладки та друк (або симуляцію) без генерації превʼю.
  * @param in_chars Вхідний текст.
  * @param in_len Довжина вхідного тексту (байти).
- * @param markdown true — інтерпретувати як Markdown.
+ * @param format Формат входу (текст, Markdown або SVG).
  * @param family Родина шрифтів (NULL — брати з конфігурації).
  * @param font_size Кегль у пунктах (<=0 — з конфігурації).
  * @param model Модель пристрою (NULL — типова).
@@ -1782,17 +2102,19 @@ cmd_result_t cmd_print_execute (
  * @param margin_bottom Нижнє поле, мм (<0 — з конфіг.).
  * @param margin_left Ліве поле, мм (<0 — з конфіг.).
  * @param orientation Орієнтація (портрет/альбом).
- * @param fit_page 1 — масштабувати під рамку.
- * @param preview_png 1 — PNG, 0 — SVG.
+ * @param fit_page true — масштабувати під рамку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel true — переставити контури для коротших переїздів без пера.
+ * @param dry_run true — без надсилання на пристрій.
+ * @param estimate true — лише оцінити тривалість (JSON у stdout), без пристрою.
+ * @param resume true — продовжити перерваний друк із точки відновлення.
  * @param verbose true — докладні журнали.
- * @param out_bytes [out] Байти результату (malloc).
- * @param out_len [out] Довжина буфера.
  * @return 0 — успіх, інакше код помилки.
  */
-cmd_result_t cmd_print_preview (
+cmd_result_t cmd_print_execute (
     const char *in_chars,
     size_t in_len,
-    bool markdown,
+    input_format_t format,
     const char *family,
     double font_size,
     const char *model,
@@ -1803,120 +2125,1147 @@ cmd_result_t cmd_print_preview (
     double margin_bottom,
     double margin_left,
     int orientation,
-    int fit_page,
-    int preview_png,
-    bool verbose,
-    uint8_t **out_bytes,
-    size_t *out_len) {
-    (void)verbose;
-    config_t cfg;
-    const char *model_or_null = (model && *model) ? model : NULL;
-    config_factory_defaults (&cfg, model_or_null);
-    if (!family || (family && *family == '\0'))
-        family = (cfg.font_family[0] ? cfg.font_family : NULL);
-    if (!(font_size > 0.0))
-        font_size = cfg.font_size_pt;
-    if (!(paper_w > 0.0))
-        paper_w = cfg.paper_w_mm;
-    if (!(paper_h > 0.0))
-        paper_h = cfg.paper_h_mm;
-    if (margin_top < 0.0)
-        margin_top = cfg.margin_top_mm;
-    if (margin_right < 0.0)
-        margin_right = cfg.margin_right_mm;
-    if (margin_bottom < 0.0)
-        margin_bottom = cfg.margin_bottom_mm;
-    if (margin_left < 0.0)
-        margin_left = cfg.margin_left_mm;
-
-    drawing_page_t page;
-    int setup_rc = cmd_build_print_page (
-        &page, model, paper_w, paper_h, margin_top, margin_right, margin_bottom, margin_left,
-        orientation);
-    if (setup_rc != 0)
-        return setup_rc;
-    page.fit_to_frame = fit_page ? 1 : 0;
-
-    canvas_options_t page_opts = {
-        .paper_w_mm = page.paper_w_mm,
-        .paper_h_mm = page.paper_h_mm,
-        .margin_top_mm = page.margin_top_mm,
-        .margin_right_mm = page.margin_right_mm,
-        .margin_bottom_mm = page.margin_bottom_mm,
-        .margin_left_mm = page.margin_left_mm,
-        .orientation = page.orientation,
-        .font_family = family,
-        .fit_to_frame = page.fit_to_frame ? true : false,
-    };
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool dry_run,
+    bool estimate,
+    bool resume,
+    bool verbose) {
+    drawing_layout_t layout_info = { 0 };
+    planner_limits_t lim;
+    config_t job;
+    int prep_rc = cmd_print_prepare (
+        in_chars, in_len, format, family, font_size, model, paper_w, paper_h, margin_top,
+        margin_right, margin_bottom, margin_left, orientation, fit_page, motion_profile,
+        optimize_travel, &layout_info, &lim, &job);
+    if (prep_rc != 0)
+        return prep_rc;
+    int rc = estimate ? plot_estimate_layout (&layout_info.layout, &lim, &job, model, CMD_OUT)
+                      : plot_stream_layout (
+                            &layout_info.layout, &lim, &job, model, dry_run, resume, verbose);
+    drawing_layout_dispose (&layout_info);
+    return rc;
+}
 
-    string_t input = { .chars = in_chars ? in_chars : "", .len = in_len, .enc = STR_ENC_UTF8 };
-    int rc = 0;
-    preview_fmt_t format = preview_png ? PREVIEW_FMT_PNG : PREVIEW_FMT_SVG;
-    if (markdown) {
-        double frame_width_mm = 0.0;
-        canvas_frame_dimensions (&page_opts, &frame_width_mm, NULL);
-        if (!(frame_width_mm > 0.0)) {
-            LOGE ("Недостатня доступна ширина для тексту — перевірте поля та орієнтацію");
-            return 1;
+/**
+ * @copydoc cmd_plan_save
+ */
+cmd_result_t cmd_plan_save (
+    const char *in_chars,
+    size_t in_len,
+    input_format_t format,
+    const char *family,
+    double font_size,
+    const char *model,
+    double paper_w,
+    double paper_h,
+    double margin_top,
+    double margin_right,
+    double margin_bottom,
+    double margin_left,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    const char *plan_path,
+    bool verbose) {
+    (void)verbose;
+    if (!plan_path || !*plan_path) {
+        LOGE ("Не вказано файл плану (--output)");
+        return 1;
+    }
+    drawing_layout_t layout_info = { 0 };
+    planner_limits_t lim;
+    config_t job;
+    int prep_rc = cmd_print_prepare (
+        in_chars, in_len, format, family, font_size, model, paper_w, paper_h, margin_top,
+        margin_right, margin_bottom, margin_left, orientation, fit_page, motion_profile,
+        optimize_travel, &layout_info, &lim, &job);
+    if (prep_rc != 0)
+        return prep_rc;
+    const char *model_id = (model && *model) ? model : CONFIG_DEFAULT_MODEL;
+    int rc = plot_save_layout (&layout_info.layout, &lim, &job, model_id, plan_path);
+    drawing_layout_dispose (&layout_info);
+    return rc;
+}
+
+/**
+ * @copydoc cmd_plan_replay
+ */
+cmd_result_t cmd_plan_replay (
+    const char *plan_path, const char *model, bool dry_run, bool estimate, bool verbose) {
+    planfile_reader_t plan;
+    int open_rc = planfile_reader_open (plan_path, &plan);
+    if (open_rc != 0) {
+        if (open_rc > 0)
+            LOGE ("Файл не є планом cplot або має несумісну версію: %s", plan_path);
+        else
+            LOGE ("Не вдалося відкрити файл плану: %s", plan_path);
+        return 1;
+    }
+    const char *model_id = (model && *model) ? model : plan.info.model;
+    if (model && *model && plan.info.model[0] && strcmp (model, plan.info.model) != 0)
+        LOGW ("План складено для моделі %s, виконується на %s", plan.info.model, model);
+    LOGD (
+        "план: %s, блоків=%lu, модель=%s", plan_path, (unsigned long)plan.info.block_count,
+        plan.info.model[0] ? plan.info.model : "—");
+    config_t job;
+    cmd_job_config (model_id, &job);
+    int rc = estimate ? plot_estimate_plan (&plan, &job, model_id, CMD_OUT)
+                      : plot_replay_plan (&plan, &job, model_id, dry_run, verbose);
+    planfile_reader_close (&plan);
+    return rc;
+}
+
+
+/**
+ * @brief Формує превʼю SVG/PNG для заданого вхідного тексту та параметрів сторінки.
+ * @return 0 — успіх, інакше код помилки.
+ */
+/**
+ * @brief Формує превʼю SVG/PNG для заданого вхідного тексту та параметрів сторінки.
+ * @param in_chars Вхідний текст.
+ * @param in_len Довжина вхідного тексту (байти).
+ * @param format Формат входу (текст, Markdown або SVG).
+ * @param family Родина шрифтів (NULL — брати з конфігурації).
+ * @param font_size Кегль у пунктах (<=0 — з конфігурації).
+ * @param model Модель пристрою (NULL — типова).
+ * @param paper_w Ширина паперу, мм (<=0 — з профілю).
+ * @param paper_h Висота паперу, мм (<=0 — з профілю).
+ * @param margin_top Верхнє поле, мм (<0 — з конфіг.).
+ * @param margin_right Праве поле, мм (<0 — з конфіг.).
+ * @param margin_bottom Нижнє поле, мм (<0 — з конфіг.).
+ * @param margin_left Ліве поле, мм (<0 — з конфіг.).
+ * @param orientation Орієнтація (портрет/альбом).
+ * @param fit_page 1 — масштабувати під рамку.
+ * @param preview_png 1 — PNG, 0 — SVG.
+ * @param preview_dpi Роздільність превʼю, dpi (<=0 — типова).
+ * @param preview_max_width Найбільша ширина PNG, пікселі (0 — без обмеження).
+ * @param verbose true — докладні журнали.
+ * @param out Приймач байтів превʼю.
+ * @return 0 — успіх, інакше код помилки.
+ */
+cmd_result_t cmd_print_preview (
+    const char *in_chars,
+    size_t in_len,
+    input_format_t format,
+    const char *family,
+    double font_size,
+    const char *model,
+    double paper_w,
+    double paper_h,
+    double margin_top,
+    double margin_right,
+    double margin_bottom,
+    double margin_left,
+    int orientation,
+    int fit_page,
+    int preview_png,
+    double preview_dpi,
+    unsigned preview_max_width,
+    bool verbose,
+    sink_t *out) {
+    (void)verbose;
+    config_t cfg;
+    config_t job;
+    drawing_page_t page;
+    int setup_rc = cmd_print_setup (
+        &cfg, &job, model, paper_w, paper_h, margin_top, margin_right, margin_bottom,
+        margin_left, orientation, fit_page ? true : false, &family, &font_size, &page);
+    if (setup_rc != 0)
+        return setup_rc;
+
+    string_t input = { .chars = in_chars ? in_chars : "", .len = in_len, .enc = STR_ENC_UTF8 };
+    preview_fmt_t out_format = preview_png ? PREVIEW_FMT_PNG : PREVIEW_FMT_SVG;
+    /* SVG посилається на одну форму гліфа з кожного символу; PNG растеризує контури. */
+    page.instanced = out_format == PREVIEW_FMT_SVG;
+    jobarena_t arena;
+    jobarena_init (&arena, 0);
+    page.arena = &arena;
+    drawing_layout_t layout_info = { 0 };
+    int build_rc
+        = cmd_print_build_layout (&page, input, format, family, font_size, 0, &layout_info);
+    if (build_rc == 0)
+        cmd_arena_report (&arena, "preview");
+    jobarena_free (&arena);
+    if (build_rc != 0)
+        return 1;
+    preview_opts_t opts = { .dpi = preview_dpi, .max_width_px = preview_max_width };
+    int rc = cmd_layout_write (&layout_info, out_format, &opts, out);
+    drawing_layout_dispose (&layout_info);
+    return rc;
+}
+
+/**
+ * @brief Стан посторінкового друку (`print --paginate`).
+ */
+typedef struct {
+    bool preview;                /**< Превʼю у файли `output`-N. */
+    preview_fmt_t format;        /**< Формат превʼю. */
+    preview_opts_t preview_opts; /**< Роздільність превʼю. */
+    const char *output_path;     /**< Шаблон імен файлів превʼю. */
+    bool estimate;               /**< Оцінка тривалості кожної сторінки. */
+    bool device;                 /**< Справжній пристрій (пауза між сторінками). */
+    bool optimize_travel;        /**< Переставити контури сторінки. */
+    const char *page_hook;       /**< Команда між сторінками (NULL — пауза на tty). */
+    const char *model;           /**< Модель пристрою. */
+    const config_t *job;         /**< Конфігурація завдання. */
+    planner_limits_t limits;     /**< Ліміти планувальника. */
+    plot_hold_t *hold;           /**< Утримуваний сеанс (друк і сухий запуск). */
+    bool have_anchor;            /**< `anchor` визначено першою сторінкою. */
+    geom_point_t anchor;         /**< Початок першого контуру першої сторінки, мм. */
+} cmd_pages_ctx_t;
+
+/**
+ * @brief Імʼя файлу превʼю сторінки: `stem-N.ext` (N від 1).
+ * @param path Шаблон (`--output`).
+ * @param index Номер сторінки (від 0).
+ * @param out [out] Буфер імені.
+ * @param out_len Розмір буфера.
+ * @return 0 — успіх; 1 — імʼя задовге.
+ */
+static int cmd_page_file_name (const char *path, size_t index, char *out, size_t out_len) {
+    const char *slash = strrchr (path, '/');
+    const char *dot = strrchr (path, '.');
+    if (dot && (dot == path || (slash && dot <= slash + 1)))
+        dot = NULL;
+    int stem = dot ? (int)(dot - path) : (int)strlen (path);
+    int n = snprintf (out, out_len, "%.*s-%zu%s", stem, path, index + 1, dot ? dot : "");
+    return (n < 0 || (size_t)n >= out_len) ? 1 : 0;
+}
+
+/**
+ * @brief Обрамлює контури сторінки точками `anchor` без пера на початку і в кінці.
+ * @details План рахує кроки від першої точки, де нібито стоїть каретка, тож без
+ *          обрамлення кожна наступна сторінка зсунулась би на місце, де закінчилась
+ *          попередня. Так кожна сторінка починається і повертає каретку в одну точку.
+ * @param layout Макет сторінки (контури в мм).
+ * @param anchor Спільна точка сторінок, мм.
+ * @return 0 — успіх; 1 — брак памʼяті.
+ */
+static int cmd_page_anchor (canvas_layout_t *layout, geom_point_t anchor) {
+    geom_paths_t framed;
+    if (geom_paths_init (&framed, layout->paths_mm.units) != 0)
+        return 1;
+    int rc = geom_paths_push_path (&framed, &anchor, 1);
+    for (size_t i = 0; rc == 0 && i < layout->paths_mm.len; ++i) {
+        const geom_path_t *p = &layout->paths_mm.items[i];
+        if (p->len > 0)
+            rc = geom_paths_push_path (&framed, p->pts, p->len);
+    }
+    if (rc == 0)
+        rc = geom_paths_push_path (&framed, &anchor, 1);
+    if (rc != 0) {
+        geom_paths_free (&framed);
+        return 1;
+    }
+    geom_paths_free (&layout->paths_mm);
+    layout->paths_mm = framed;
+    return 0;
+}
+
+/**
+ * @brief Чекає заміни аркуша перед наступною сторінкою.
+ * @details З `page_hook` запускає команду (`CPLOT_PAGE` — номер наступної сторінки від 1);
+ *          ненульовий код зупиняє друк. Без команди на пристрої чекає Enter на терміналі.
+ * @param ctx Стан друку.
+ * @param next_index Номер наступної сторінки (від 0).
+ * @return 0 — продовжити; 1 — зупинити.
+ */
+static int cmd_page_pause (const cmd_pages_ctx_t *ctx, size_t next_index) {
+    if (ctx->page_hook && *ctx->page_hook) {
+        char num[32];
+        snprintf (num, sizeof (num), "%zu", next_index + 1);
+        setenv ("CPLOT_PAGE", num, 1);
+        int status = system (ctx->page_hook);
+        if (status != 0) {
+            LOGE ("Команда між сторінками завершилась з кодом %d — друк зупинено", status);
+            return 1;
+        }
+        return 0;
+    }
+    if (!ctx->device)
+        return 0;
+    FILE *tty = fopen ("/dev/tty", "r+");
+    if (!tty) {
+        LOGE ("Немає термінала для паузи між сторінками — задайте --page-hook");
+        return 1;
+    }
+    fprintf (tty, "Замініть аркуш і натисніть Enter для сторінки %zu… ", next_index + 1);
+    fflush (tty);
+    int c;
+    while ((c = fgetc (tty)) != EOF && c != '\n')
+        ;
+    fclose (tty);
+    return c == EOF ? 1 : 0;
+}
+
+/** \brief Споживач сторінок `page_layout_stream`: превʼю, оцінка або друк сторінки. */
+static int cmd_print_page_cb (void *ctx_ptr, size_t index, drawing_layout_t *layout) {
+    cmd_pages_ctx_t *ctx = (cmd_pages_ctx_t *)ctx_ptr;
+    if (index > 0 && !ctx->preview && !ctx->estimate && cmd_page_pause (ctx, index) != 0)
+        return 1;
+    if (ctx->preview) {
+        char path[FILE_NAME_SIZE];
+        if (cmd_page_file_name (ctx->output_path, index, path, sizeof (path)) != 0) {
+            LOGE ("Задовгий шлях превʼю: %s", ctx->output_path);
+            return 1;
         }
-        markdown_opts_t mopts = { .family = family,
-                                  .base_size_pt = (font_size > 0.0 ? font_size : 14.0),
-                                  .frame_width_mm = frame_width_mm };
-        geom_paths_t md_paths;
-        if (markdown_render_paths (input.chars, &mopts, &md_paths, NULL) != 0)
+        FILE *fp = fopen (path, "wb");
+        if (!fp) {
+            LOGE ("Не вдалося відкрити файл для запису: %s", path);
             return 1;
-        if (page.fit_to_frame) {
-            double fw = 0.0, fh = 0.0;
-            canvas_frame_dimensions (&page_opts, &fw, &fh);
-            geom_bbox_t bb;
-            if (geom_bbox_of_paths (&md_paths, &bb) == 0) {
-                double cw = bb.max_x - bb.min_x;
-                double ch = bb.max_y - bb.min_y;
-                if ((cw > 0.0 && ch > 0.0) && ((cw > fw) || (ch > fh))) {
-                    geom_paths_free (&md_paths);
-                    double sx = fw / cw, sy = fh / ch;
-                    double s = cmd_clamp_scale (sx < sy ? sx : sy);
-                    double new_pt = mopts.base_size_pt * s;
-                    if (new_pt < 3.0)
-                        new_pt = 3.0;
-                    mopts.base_size_pt = new_pt;
-                    if (markdown_render_paths (input.chars, &mopts, &md_paths, NULL) != 0)
-                        return 1;
-                }
+        }
+        sink_t out;
+        sink_init_file (&out, fp);
+        int rc = cmd_layout_write (layout, ctx->format, &ctx->preview_opts, &out);
+        if (fclose (fp) != 0)
+            rc = 1;
+        if (rc != 0)
+            remove (path);
+        else
+            LOGI ("Превʼю сторінки %zu: %s", index + 1, path);
+        return rc;
+    }
+
+    canvas_layout_t *cl = &layout->layout;
+    cmd_simplify_layout (cl, ctx->job, NULL);
+    if (ctx->optimize_travel)
+        cmd_optimize_travel (cl);
+    if (!ctx->have_anchor) {
+        for (size_t i = 0; i < cl->paths_mm.len; ++i)
+            if (cl->paths_mm.items[i].len > 0) {
+                ctx->anchor = cl->paths_mm.items[i].pts[0];
+                ctx->have_anchor = true;
+                break;
             }
+        if (!ctx->have_anchor)
+            return 0;
+    }
+    if (cmd_page_anchor (cl, ctx->anchor) != 0)
+        return 1;
+    if (ctx->estimate)
+        return plot_estimate_layout (cl, &ctx->limits, ctx->job, ctx->model, CMD_OUT);
+    return plot_hold_stream (ctx->hold, cl, &ctx->limits);
+}
+
+/**
+ * @copydoc cmd_print_pages
+ */
+cmd_result_t cmd_print_pages (
+    const char *in_chars,
+    size_t in_len,
+    bool markdown,
+    const char *family,
+    double font_size,
+    const char *model,
+    double paper_w,
+    double paper_h,
+    double margin_top,
+    double margin_right,
+    double margin_bottom,
+    double margin_left,
+    int orientation,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool preview,
+    int preview_png,
+    double preview_dpi,
+    unsigned preview_max_width,
+    const char *output_path,
+    bool dry_run,
+    bool estimate,
+    const char *page_hook,
+    bool verbose) {
+    (void)verbose;
+    if (preview && (!output_path || !*output_path)) {
+        LOGE ("Посторінкове превʼю потребує --output (файли PATH-1, PATH-2, …)");
+        return 1;
+    }
+    config_t cfg;
+    config_t job;
+    drawing_page_t page;
+    int setup_rc = cmd_print_setup (
+        &cfg, &job, model, paper_w, paper_h, margin_top, margin_right, margin_bottom,
+        margin_left, orientation, false, &family, &font_size, &page);
+    if (setup_rc != 0)
+        return setup_rc;
+
+    cmd_pages_ctx_t ctx;
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.preview = preview;
+    ctx.format = preview_png ? PREVIEW_FMT_PNG : PREVIEW_FMT_SVG;
+    ctx.preview_opts = (preview_opts_t){ .dpi = preview_dpi, .max_width_px = preview_max_width };
+    ctx.output_path = output_path;
+    ctx.estimate = !preview && estimate;
+    ctx.device = !preview && !estimate && !dry_run;
+    ctx.optimize_travel = optimize_travel;
+    ctx.page_hook = page_hook;
+    ctx.model = model;
+    ctx.job = &job;
+    cmd_motion_limits (&job, model, motion_profile, &ctx.limits);
+    if (!preview && !estimate && plot_hold_open (&ctx.hold, &job, model, NULL, dry_run) != 0) {
+        LOGE ("Пристрій зайнятий або недоступний");
+        return 1;
+    }
+
+    string_t input = { .chars = in_chars ? in_chars : "", .len = in_len, .enc = STR_ENC_UTF8 };
+    size_t pages = 0;
+    int rc = page_layout_stream (
+        &page, family, font_size, input, markdown, 0, cmd_print_page_cb, &ctx, &pages);
+    plot_hold_close (ctx.hold);
+    if (rc == 0)
+        LOGI ("Сторінок: %zu", pages);
+    return rc;
+}
+
+/** \brief Верхня межа потоків пакетної верстки. */
+#define CMD_BATCH_MAX_THREADS 16
+/** \brief Верхня межа плотерів пакетного друку (`--devices`). */
+#define CMD_BATCH_MAX_DEVICES 32
+
+/**
+ * @brief Документ пакетного завдання: вхід із маніфесту та результат верстки.
+ */
+typedef struct {
+    size_t line;             /**< Номер рядка маніфесту (для повідомлень). */
+    char *text;              /**< Вміст документа (malloc). */
+    size_t text_len;         /**< Довжина вмісту, байт. */
+    bool markdown;           /**< true — Markdown. */
+    char *family;            /**< Родина шрифтів (malloc; NULL — спільна для пакета). */
+    double font_size_pt;     /**< Кегль, пт. */
+    double offset_x_mm;      /**< Зсув документа по X, мм. */
+    double offset_y_mm;      /**< Зсув документа по Y, мм. */
+    drawing_layout_t layout; /**< Результат верстки. */
+    int rc;                  /**< Код верстки: 0 — успіх. */
+} cmd_batch_job_t;
+
+/**
+ * @brief Спільні дані паралельної верстки документів пакета.
+ */
+typedef struct {
+    cmd_batch_job_t *jobs;      /**< Документи. */
+    const drawing_page_t *page; /**< Спільні параметри сторінки. */
+    const char *family;         /**< Спільна родина шрифтів (NULL — типова). */
+} cmd_batch_queue_t;
+
+/**
+ * @brief Читає файл повністю у памʼять (із завершальним `\0`).
+ * @param path Шлях до файлу.
+ * @param out_chars [out] Вміст (malloc).
+ * @param out_len [out] Довжина, байт.
+ * @return 0 — успіх, 1 — помилка.
+ */
+static int cmd_read_file (const char *path, char **out_chars, size_t *out_len) {
+    FILE *fp = fopen (path, "rb");
+    if (!fp)
+        return 1;
+    long sz = -1;
+    if (fseek (fp, 0, SEEK_END) == 0)
+        sz = ftell (fp);
+    if (sz < 0 || fseek (fp, 0, SEEK_SET) != 0) {
+        fclose (fp);
+        return 1;
+    }
+    char *buf = (char *)malloc ((size_t)sz + 1);
+    if (!buf) {
+        fclose (fp);
+        return 1;
+    }
+    size_t rd = (sz > 0) ? fread (buf, 1, (size_t)sz, fp) : 0;
+    fclose (fp);
+    if (rd != (size_t)sz) {
+        free (buf);
+        return 1;
+    }
+    buf[rd] = '\0';
+    *out_chars = buf;
+    *out_len = rd;
+    return 0;
+}
+
+/**
+ * @brief Звільняє документи пакета разом із їхніми розкладками.
+ * @param jobs Масив документів (може бути NULL).
+ * @param count Кількість документів.
+ */
+static void cmd_batch_jobs_free (cmd_batch_job_t *jobs, size_t count) {
+    for (size_t i = 0; jobs && i < count; ++i) {
+        free (jobs[i].text);
+        free (jobs[i].family);
+        drawing_layout_dispose (&jobs[i].layout);
+    }
+    free (jobs);
+}
+
+/**
+ * @brief Заповнює документ пакета з одного рядка маніфесту.
+ * @details Вміст береться з поля `text` або з файлу `file`. Формат — поле `format`
+ *          (`markdown`/`md`/`text`), інакше за розширенням `.md`, інакше з параметрів пакета.
+ * @param doc Розібраний рядок маніфесту.
+ * @param origin Початок повідомлень про помилки (`Пакет: рядок`, `Сервер: завдання`).
+ * @param markdown Формат за замовчуванням.
+ * @param font_size Кегль за замовчуванням, пт.
+ * @param job [out] Документ.
+ * @return 0 — успіх, 1 — помилка (повідомлення вже надруковано).
+ */
+static int cmd_batch_parse_job (
+    const jsr_doc_t *doc,
+    const char *origin,
+    bool markdown,
+    double font_size,
+    cmd_batch_job_t *job) {
+    if (doc->tokens[0].type != JSR_OBJECT) {
+        LOGE ("%s %zu — очікується JSON-обʼєкт", origin, job->line);
+        return 1;
+    }
+    job->markdown = markdown;
+    job->text = jsr_doc_string (doc, jsr_doc_member (doc, 0, "text"), &job->text_len);
+    if (!job->text) {
+        char *file = jsr_doc_string (doc, jsr_doc_member (doc, 0, "file"), NULL);
+        if (!file) {
+            LOGE ("%s %zu — немає поля \"text\" або \"file\"", origin, job->line);
+            return 1;
         }
-        drawing_layout_t layout_info;
-        if (drawing_build_layout_from_paths (&page, &md_paths, &layout_info) != 0) {
-            geom_paths_free (&md_paths);
+        if (cmd_read_file (file, &job->text, &job->text_len) != 0) {
+            LOGE ("%s %zu — не вдалося прочитати %s", origin, job->line, file);
+            free (file);
             return 1;
         }
-        geom_paths_free (&md_paths);
-        rc = cmd_layout_to_bytes (&layout_info, format, out_bytes, out_len);
-        drawing_layout_dispose (&layout_info);
-    } else {
-        drawing_layout_t layout_info = { 0 };
-        if (drawing_build_layout (&page, family, font_size, input, &layout_info) != 0)
+        size_t flen = strlen (file);
+        if (flen > 3 && strcasecmp (file + flen - 3, ".md") == 0)
+            job->markdown = true;
+        free (file);
+    }
+    char *format = jsr_doc_string (doc, jsr_doc_member (doc, 0, "format"), NULL);
+    if (format) {
+        if (strcmp (format, "markdown") == 0 || strcmp (format, "md") == 0) {
+            job->markdown = true;
+        } else if (strcmp (format, "text") == 0) {
+            job->markdown = false;
+        } else {
+            LOGE ("%s %zu — невідомий формат \"%s\"", origin, job->line, format);
+            free (format);
             return 1;
-        if (page.fit_to_frame) {
-            double fw = 0.0, fh = 0.0;
-            canvas_frame_dimensions (&page_opts, &fw, &fh);
-            geom_bbox_t bb = layout_info.layout.bounds_mm;
-            double cw = bb.max_x - bb.min_x;
-            double ch = bb.max_y - bb.min_y;
-            if ((cw > 0.0 && ch > 0.0) && ((cw > fw) || (ch > fh))) {
-                drawing_layout_dispose (&layout_info);
-                double sx = fw / cw, sy = fh / ch;
-                double s = cmd_clamp_scale (sx < sy ? sx : sy);
-                double new_pt = font_size * s;
-                if (new_pt < 3.0)
-                    new_pt = 3.0;
-                if (drawing_build_layout (&page, family, new_pt, input, &layout_info) != 0)
-                    return 1;
+        }
+        free (format);
+    }
+    job->family = jsr_doc_string (doc, jsr_doc_member (doc, 0, "font_family"), NULL);
+    if (job->family && !*job->family) {
+        free (job->family);
+        job->family = NULL;
+    }
+    job->font_size_pt = jsr_doc_double (doc, jsr_doc_member (doc, 0, "font_size"), font_size);
+    if (!(job->font_size_pt > 0.0))
+        job->font_size_pt = font_size;
+    job->offset_x_mm = jsr_doc_double (doc, jsr_doc_member (doc, 0, "offset_x"), 0.0);
+    job->offset_y_mm = jsr_doc_double (doc, jsr_doc_member (doc, 0, "offset_y"), 0.0);
+    return 0;
+}
+
+/**
+ * @brief Розбирає маніфест JSONL (один документ на рядок; порожні рядки пропускаються).
+ * @param manifest Вміст маніфесту.
+ * @param len Довжина, байт.
+ * @param markdown Формат документів за замовчуванням.
+ * @param font_size Кегль за замовчуванням, пт.
+ * @param out_jobs [out] Документи (звільнити `cmd_batch_jobs_free`).
+ * @param out_count [out] Кількість документів.
+ * @return 0 — успіх, 1 — помилка.
+ */
+static int cmd_batch_parse_manifest (
+    const char *manifest,
+    size_t len,
+    bool markdown,
+    double font_size,
+    cmd_batch_job_t **out_jobs,
+    size_t *out_count) {
+    cmd_batch_job_t *jobs = NULL;
+    size_t count = 0, cap = 0;
+    size_t line_no = 0;
+    size_t pos = 0;
+    /* Стрічка токенів одна на весь маніфест: рядки розбираються на місці без копій. */
+    jsr_doc_t doc;
+    jsr_doc_init (&doc);
+    while (pos < len) {
+        const char *line = manifest + pos;
+        const char *nl = memchr (line, '\n', len - pos);
+        size_t line_len = nl ? (size_t)(nl - line) : len - pos;
+        pos += line_len + (nl ? 1 : 0);
+        ++line_no;
+        size_t k = 0;
+        while (k < line_len && isspace ((unsigned char)line[k]))
+            ++k;
+        if (k == line_len)
+            continue;
+
+        if (count == cap) {
+            size_t nc = cap ? cap * 2 : 8;
+            cmd_batch_job_t *nj = (cmd_batch_job_t *)realloc (jobs, nc * sizeof (*jobs));
+            if (!nj)
+                goto fail;
+            jobs = nj;
+            cap = nc;
+        }
+        cmd_batch_job_t *job = &jobs[count++];
+        memset (job, 0, sizeof (*job));
+        job->line = line_no;
+        if (jsr_parse (&doc, line, line_len) != 0) {
+            LOGE ("Пакет: рядок %zu — некоректний JSON", line_no);
+            goto fail;
+        }
+        if (cmd_batch_parse_job (&doc, "Пакет: рядок", markdown, font_size, job) != 0)
+            goto fail;
+    }
+    if (count == 0) {
+        LOGE ("Пакет: маніфест не містить жодного документа");
+        goto fail;
+    }
+    jsr_doc_free (&doc);
+    *out_jobs = jobs;
+    *out_count = count;
+    return 0;
+
+fail:
+    jsr_doc_free (&doc);
+    cmd_batch_jobs_free (jobs, count);
+    return 1;
+}
+
+/**
+ * @brief Верстає один документ пакета (`parallel_work_fn`).
+ * @param items Черга `cmd_batch_queue_t`.
+ * @param index Номер документа.
+ * @param worker Номер виконавця (не використовується).
+ */
+static void cmd_batch_layout_job (void *items, size_t index, size_t worker) {
+    (void)worker;
+    cmd_batch_queue_t *q = (cmd_batch_queue_t *)items;
+    cmd_batch_job_t *job = &q->jobs[index];
+    string_t input = { .chars = job->text, .len = job->text_len, .enc = STR_ENC_UTF8 };
+    const char *family = job->family ? job->family : q->family;
+    job->rc = cmd_print_build_layout (
+        q->page, input, job->markdown ? INPUT_FORMAT_MARKDOWN : INPUT_FORMAT_TEXT, family,
+        job->font_size_pt, 1, &job->layout);
+}
+
+/**
+ * @brief Готує розверстаний документ до друку: спрощення, порядок контурів, зсув.
+ * @param job Документ.
+ * @param config Конфігурація завдання.
+ * @param optimize_travel true — переставити контури для коротших переїздів.
+ * @return 0 — успіх, 1 — помилка.
+ */
+static int cmd_batch_prepare (cmd_batch_job_t *job, const config_t *config, bool optimize_travel) {
+    canvas_layout_t *layout = &job->layout.layout;
+    cmd_simplify_layout (layout, config, NULL);
+    if (optimize_travel)
+        cmd_optimize_travel (layout);
+    if ((job->offset_x_mm != 0.0 || job->offset_y_mm != 0.0)
+        && geom_paths_translate_inplace (&layout->paths_mm, job->offset_x_mm, job->offset_y_mm)
+               != 0)
+        return 1;
+    return 0;
+}
+
+/**
+ * @brief Зшиває документи пакета в один макет у порядку маніфесту.
+ * @param jobs Підготовлені документи.
+ * @param count Кількість документів.
+ * @param owner Плотер кожного документа (NULL — усі документи).
+ * @param device Плотер, чиї документи зшиваються (ігнорується з `owner == NULL`).
+ * @param out [out] Макет: параметри сторінки — з першого документа, шляхи — власні
+ *            (звільнити `geom_paths_free (&out->paths_mm)`).
+ * @return 0 — успіх, 1 — брак памʼяті.
+ */
+static int cmd_batch_combine (
+    const cmd_batch_job_t *jobs,
+    size_t count,
+    const size_t *owner,
+    size_t device,
+    canvas_layout_t *out) {
+    geom_paths_t merged;
+    if (geom_paths_init (&merged, GEOM_UNITS_MM) != 0)
+        return 1;
+    const canvas_layout_t *first = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        if (owner && owner[i] != device)
+            continue;
+        const canvas_layout_t *layout = &jobs[i].layout.layout;
+        if (!first)
+            first = layout;
+        for (size_t j = 0; j < layout->paths_mm.len; ++j) {
+            const geom_path_t *path = &layout->paths_mm.items[j];
+            if (path->len > 0 && geom_paths_push_path (&merged, path->pts, path->len) != 0) {
+                geom_paths_free (&merged);
+                return 1;
             }
         }
-        rc = cmd_layout_to_bytes (&layout_info, format, out_bytes, out_len);
-        drawing_layout_dispose (&layout_info);
     }
+    *out = first ? *first : jobs[0].layout.layout;
+    out->paths_mm = merged;
+    if (geom_bbox_of_paths (&merged, &out->bounds_mm) != 0)
+        memset (&out->bounds_mm, 0, sizeof (out->bounds_mm));
+    return 0;
+}
+
+/**
+ * @brief Плотер пакетного друку: власний порт, частка документів і потік виконання.
+ */
+typedef struct {
+    char port[PATH_MAX];            /**< Порт (порожньо — імітація в dry‑run). */
+    canvas_layout_t layout;         /**< Документи плотера, зшиті в один макет. */
+    size_t docs;                    /**< Кількість документів. */
+    double load_mm;                 /**< Сумарна довжина контурів, мм. */
+    const planner_limits_t *limits; /**< Спільні ліміти планувальника. */
+    const config_t *config;         /**< Спільна конфігурація завдання. */
+    const char *model;              /**< Модель (NULL — типова). */
+    bool dry_run;                   /**< Без підключення. */
+    int rc;                         /**< Результат: 0 — успіх. */
+} cmd_batch_device_t;
+
+/**
+ * @brief Потік плотера: власний сеанс (lock порту, підключення), план і виконання.
+ * @param arg `cmd_batch_device_t`.
+ * @return NULL.
+ */
+static void *cmd_batch_device_main (void *arg) {
+    cmd_batch_device_t *d = (cmd_batch_device_t *)arg;
+    plot_hold_t *hold = NULL;
+    d->rc = plot_hold_open (&hold, d->config, d->model, d->port, d->dry_run);
+    if (d->rc == 0)
+        d->rc = plot_hold_stream (hold, &d->layout, d->limits);
+    plot_hold_close (hold);
+    return NULL;
+}
+
+/**
+ * @brief Знаходить плотери для пакета: порти, що відповідають, без дублікатів одного вузла.
+ * @details У dry‑run порти не відкриваються: `want` плотерів імітуються, а `all` — це
+ *          кількість знайдених портів (щонайменше один).
+ * @param want Бажана кількість (-1 — усі).
+ * @param dry_run Імітація.
+ * @param out [out] Плотери (порти заповнено).
+ * @param cap Ємність `out`.
+ * @return Кількість плотерів (0 — не знайдено або помилка).
+ */
+static size_t cmd_batch_find_devices (
+    int want, bool dry_run, cmd_batch_device_t *out, size_t cap) {
+    device_port_info_t *ports = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    if (cmd_collect_device_ports (&ports, &count, &capacity) != 0) {
+        free (ports);
+        return 0;
+    }
+    size_t limit = want > 0 ? (size_t)want : cap;
+    if (limit > cap)
+        limit = cap;
+    size_t found = 0;
+    if (dry_run) {
+        found = want > 0 ? limit : (count > 0 ? (count < limit ? count : limit) : 1);
+        free (ports);
+        return found;
+    }
+    cmd_probe_device_ports (ports, count);
+    char seen[CMD_BATCH_MAX_DEVICES][PATH_MAX];
+    for (size_t i = 0; i < count && found < limit; ++i) {
+        if (!ports[i].responsive)
+            continue;
+        /* /dev/serial/by-id/... і /dev/ttyACM0 можуть бути тим самим плотером. */
+        char key[PATH_MAX];
+        if (axidraw_device_lock_path (ports[i].path, key, sizeof (key)) != 0)
+            continue;
+        bool dup = false;
+        for (size_t k = 0; k < found && !dup; ++k)
+            dup = strcmp (seen[k], key) == 0;
+        if (dup)
+            continue;
+        str_string_copy (seen[found], sizeof (seen[found]), key);
+        str_string_copy (out[found].port, sizeof (out[found].port), ports[i].path);
+        LOGI ("Пакет: плотер %zu — %s (%s)", found + 1, ports[i].alias, ports[i].path);
+        ++found;
+    }
+    free (ports);
+    if (want > 0 && found < (size_t)want && found > 0)
+        LOGW ("Пакет: знайдено лише %zu плотер(ів) із %d", found, want);
+    return found;
+}
+
+/**
+ * @brief Друкує підготовлені документи паралельно на кількох плотерах.
+ * @details Документи розподіляються жадібно: найдовший (за довжиною контурів) — на
+ *          найменш завантажений плотер. На кожному плотері документи йдуть у порядку
+ *          маніфесту і зшиваються так само, як в однопотоковому пакеті; кожен плотер
+ *          має власний потік, сеанс і lock свого порту.
+ * @param jobs Підготовлені документи.
+ * @param count Кількість документів.
+ * @param want Кількість плотерів (-1 — усі знайдені).
+ * @param model Модель (NULL — типова).
+ * @param limits Ліміти планувальника.
+ * @param config Конфігурація завдання.
+ * @param dry_run Без підключення.
+ * @return 0 — усі плотери завершили успішно, 1 — інакше.
+ */
+static int cmd_batch_run_devices (
+    const cmd_batch_job_t *jobs,
+    size_t count,
+    int want,
+    const char *model,
+    const planner_limits_t *limits,
+    const config_t *config,
+    bool dry_run) {
+    cmd_batch_device_t *devs = (cmd_batch_device_t *)calloc (CMD_BATCH_MAX_DEVICES, sizeof (*devs));
+    size_t *owner = (size_t *)calloc (count ? count : 1, sizeof (*owner));
+    size_t *order = (size_t *)malloc ((count ? count : 1) * sizeof (*order));
+    double *cost = (double *)malloc ((count ? count : 1) * sizeof (*cost));
+    int rc = 1;
+    size_t ndev = 0;
+    size_t combined = 0;
+    if (!devs || !owner || !order || !cost)
+        goto out;
+    ndev = cmd_batch_find_devices (want, dry_run, devs, CMD_BATCH_MAX_DEVICES);
+    if (ndev == 0) {
+        LOGE ("Пакет: не знайдено жодного плотера, що відповідає");
+        goto out;
+    }
+    if (ndev > count)
+        ndev = count ? count : 1;
+
+    /* Сортування вставкою за спаданням довжини: документів у пакеті — десятки. */
+    for (size_t i = 0; i < count; ++i) {
+        cost[i] = geom_paths_length (&jobs[i].layout.layout.paths_mm);
+        size_t k = i;
+        for (; k > 0 && cost[order[k - 1]] < cost[i]; --k)
+            order[k] = order[k - 1];
+        order[k] = i;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        size_t best = 0;
+        for (size_t d = 1; d < ndev; ++d)
+            if (devs[d].load_mm < devs[best].load_mm)
+                best = d;
+        owner[order[i]] = best;
+        devs[best].load_mm += cost[order[i]];
+        devs[best].docs++;
+    }
+
+    (void)axidraw_device_lock_file (); /* шлях кешується до запуску потоків */
+    for (; combined < ndev; ++combined) {
+        cmd_batch_device_t *d = &devs[combined];
+        if (cmd_batch_combine (jobs, count, owner, combined, &d->layout) != 0)
+            goto out;
+        d->limits = limits;
+        d->config = config;
+        d->model = model;
+        d->dry_run = dry_run;
+        LOGI (
+            "Пакет: плотер %zu — документів %zu, контурів %.0f мм", combined + 1, d->docs,
+            d->load_mm);
+    }
+
+    pthread_t threads[CMD_BATCH_MAX_DEVICES];
+    bool started[CMD_BATCH_MAX_DEVICES] = { false };
+    for (size_t d = 0; d < ndev; ++d) {
+        started[d] = pthread_create (&threads[d], NULL, cmd_batch_device_main, &devs[d]) == 0;
+        if (!started[d]) {
+            LOGE ("Пакет: не вдалося запустити потік плотера %zu", d + 1);
+            devs[d].rc = 1;
+        }
+    }
+    rc = 0;
+    for (size_t d = 0; d < ndev; ++d) {
+        if (started[d])
+            pthread_join (threads[d], NULL);
+        if (devs[d].rc != 0) {
+            LOGE ("Пакет: плотер %zu завершився з помилкою", d + 1);
+            rc = 1;
+        }
+    }
+
+out:
+    for (size_t d = 0; d < combined; ++d)
+        geom_paths_free (&devs[d].layout.paths_mm);
+    free (cost);
+    free (order);
+    free (owner);
+    free (devs);
+    return rc;
+}
+
+/**
+ * @brief Друкує пакет документів із маніфесту JSONL за один сеанс пристрою.
+ * @details Документи верстаються паралельно зі спільними кешами шрифтів, далі
+ *          послідовно спрощуються, за потреби впорядковуються, зсуваються на
+ *          `offset_x`/`offset_y` і зшиваються в один макет. Між документами
+ *          виконується звичайний переїзд із піднятим пером.
+ * @param manifest Вміст маніфесту (JSONL).
+ * @param manifest_len Довжина маніфесту (байти).
+ * @param markdown Формат документів за замовчуванням.
+ * @param family Родина шрифтів (NULL — брати з конфігурації).
+ * @param font_size Кегль у пунктах (<=0 — з конфігурації).
+ * @param model Модель пристрою (NULL — типова).
+ * @param paper_w Ширина паперу, мм (<=0 — з профілю).
+ * @param paper_h Висота паперу, мм (<=0 — з профілю).
+ * @param margin_top Верхнє поле, мм (<0 — з конфіг.).
+ * @param margin_right Праве поле, мм (<0 — з конфіг.).
+ * @param margin_bottom Нижнє поле, мм (<0 — з конфіг.).
+ * @param margin_left Ліве поле, мм (<0 — з конфіг.).
+ * @param orientation Орієнтація (портрет/альбом).
+ * @param fit_page true — масштабувати кожен документ під рамку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel true — переставити контури кожного документа.
+ * @param dry_run true — без надсилання на пристрій.
+ * @param estimate true — лише оцінити тривалість (JSON у stdout), без пристрою.
+ * @param devices Кількість плотерів: 0 — один сеанс (типовий порт), -1 — усі знайдені.
+ * @param verbose true — докладні журнали.
+ * @return 0 — успіх, інакше код помилки.
+ */
+cmd_result_t cmd_batch_execute (
+    const char *manifest,
+    size_t manifest_len,
+    bool markdown,
+    const char *family,
+    double font_size,
+    const char *model,
+    double paper_w,
+    double paper_h,
+    double margin_top,
+    double margin_right,
+    double margin_bottom,
+    double margin_left,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool dry_run,
+    bool estimate,
+    int devices,
+    bool verbose) {
+    if (!manifest && manifest_len > 0)
+        return 1;
+    config_t cfg;
+    config_t job;
+    drawing_page_t page;
+    int setup_rc = cmd_print_setup (
+        &cfg, &job, model, paper_w, paper_h, margin_top, margin_right, margin_bottom,
+        margin_left, orientation, fit_page, &family, &font_size, &page);
+    if (setup_rc != 0)
+        return setup_rc;
+
+    cmd_batch_job_t *jobs = NULL;
+    size_t count = 0;
+    if (cmd_batch_parse_manifest (manifest, manifest_len, markdown, font_size, &jobs, &count)
+        != 0)
+        return 1;
+
+    cmd_batch_queue_t queue = { .jobs = jobs, .page = &page, .family = family };
+    size_t workers = parallel_for (
+        cmd_batch_layout_job, &queue, count, parallel_threads (0, CMD_BATCH_MAX_THREADS, count));
+    LOGI ("Пакет: документів %zu, потоків верстки %zu", count, workers);
+
+    int rc = 1;
+    for (size_t i = 0; i < count; ++i) {
+        if (jobs[i].rc != 0) {
+            LOGE ("Пакет: не вдалося розверстати документ (рядок %zu)", jobs[i].line);
+            goto done;
+        }
+        if (cmd_batch_prepare (&jobs[i], &job, optimize_travel) != 0)
+            goto done;
+        LOGD (
+            "пакет: документ %zu (рядок %zu) — контурів %zu", i + 1, jobs[i].line,
+            jobs[i].layout.layout.paths_mm.len);
+    }
+
+    planner_limits_t lim;
+    cmd_motion_limits (&job, model, motion_profile, &lim);
+    if (devices != 0 && !estimate) {
+        rc = cmd_batch_run_devices (jobs, count, devices, model, &lim, &job, dry_run);
+        goto done;
+    }
+    canvas_layout_t combined = { 0 };
+    if (cmd_batch_combine (jobs, count, NULL, 0, &combined) != 0)
+        goto done;
+    rc = estimate ? plot_estimate_layout (&combined, &lim, &job, model, CMD_OUT)
+                  : plot_stream_layout (&combined, &lim, &job, model, dry_run, false, verbose);
+    geom_paths_free (&combined.paths_mm);
+
+done:
+    cmd_batch_jobs_free (jobs, count);
+    return rc;
+}
+
+/**
+ * @brief Стан сервера завдань: спільні параметри сторінки і утримуваний пристрій.
+ */
+typedef struct {
+    drawing_page_t page;     /**< Параметри сторінки (спільні для всіх завдань). */
+    const char *family;      /**< Типова родина шрифтів (NULL — з конфігурації). */
+    double font_size;        /**< Типовий кегль, пт. */
+    bool markdown;           /**< Типовий формат завдань. */
+    bool optimize_travel;    /**< Переставляти контури для коротших переїздів. */
+    planner_limits_t limits; /**< Ліміти планувальника для профілю руху. */
+    config_t job;            /**< Конфігурація завдань (прочитана один раз). */
+    plot_hold_t *hold;       /**< Відкритий сеанс пристрою. */
+    jsr_doc_t doc;           /**< Стрічка токенів запиту (ємність між завданнями лишається). */
+    jobarena_t arena;        /**< Арена верстки (скидається після кожного завдання). */
+} cmd_serve_ctx_t;
+
+/** \brief Записує у відповідь сервера текст помилки. */
+static int cmd_serve_fail (json_writer_t *reply, const char *error) {
+    jsw_jsonw_key (reply, "error");
+    jsw_jsonw_string_cstr (reply, error);
+    return 1;
+}
+
+/**
+ * @brief Обробник завдання сервера: ті самі поля, що й у рядку маніфесту `batch`.
+ * @details Верстка, спрощення і зсув — як для документа пакета; далі план виконується
+ *          в утримуваному сеансі пристрою.
+ */
+static int cmd_serve_job (
+    void *arg, unsigned long id, const char *request, size_t len, json_writer_t *reply) {
+    cmd_serve_ctx_t *ctx = (cmd_serve_ctx_t *)arg;
+    struct timespec t0, t1, t2;
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    if (jsr_parse (&ctx->doc, request, len) != 0) {
+        LOGE ("Сервер: завдання %lu — некоректний JSON", id);
+        return cmd_serve_fail (reply, "некоректний JSON");
+    }
+    cmd_batch_job_t *job = (cmd_batch_job_t *)calloc (1, sizeof (*job));
+    if (!job)
+        return cmd_serve_fail (reply, "брак памʼяті");
+    job->line = id;
+    int rc = 1;
+    if (cmd_batch_parse_job (&ctx->doc, "Сервер: завдання", ctx->markdown, ctx->font_size, job)
+        != 0) {
+        cmd_serve_fail (reply, "некоректне завдання");
+        goto done;
+    }
+    string_t input = { .chars = job->text, .len = job->text_len, .enc = STR_ENC_UTF8 };
+    const char *family = job->family ? job->family : ctx->family;
+    if (cmd_print_build_layout (
+            &ctx->page, input, job->markdown ? INPUT_FORMAT_MARKDOWN : INPUT_FORMAT_TEXT, family,
+            job->font_size_pt, 0, &job->layout)
+        != 0) {
+        cmd_serve_fail (reply, "помилка верстки");
+        goto done;
+    }
+    canvas_layout_t *layout = &job->layout.layout;
+    cmd_simplify_layout (layout, &ctx->job, &ctx->arena);
+    cmd_arena_report (&ctx->arena, "Сервер");
+    if (ctx->optimize_travel)
+        cmd_optimize_travel (layout);
+    if ((job->offset_x_mm != 0.0 || job->offset_y_mm != 0.0)
+        && geom_paths_translate_inplace (&layout->paths_mm, job->offset_x_mm, job->offset_y_mm)
+               != 0) {
+        cmd_serve_fail (reply, "брак памʼяті");
+        goto done;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    rc = plot_hold_stream (ctx->hold, layout, &ctx->limits);
+    clock_gettime (CLOCK_MONOTONIC, &t2);
+    if (rc != 0)
+        cmd_serve_fail (reply, "помилка виконання на пристрої");
+    jsw_jsonw_key (reply, "paths");
+    jsw_jsonw_int (reply, (long long)layout->paths_mm.len);
+    jsw_jsonw_key (reply, "layout_ms");
+    jsw_jsonw_double (reply, time_diff_ms (&t1, &t0));
+    jsw_jsonw_key (reply, "plot_ms");
+    jsw_jsonw_double (reply, time_diff_ms (&t2, &t1));
+
+done:
+    /* Блоки арени лишаються серверу: наступне завдання починає з теплого запасу. */
+    jobarena_reset (&ctx->arena);
+    cmd_batch_jobs_free (job, 1);
+    return rc;
+}
+
+/**
+ * @brief Запускає сервер завдань із теплими кешами і утримуваним пристроєм.
+ * @details Конфігурація, каталог шрифтів і пробна верстка (завантажує гліфи типової
+ *          родини) готуються один раз; пристрій підключається і лишається захопленим до
+ *          зупинки. Параметри сторінки і профіль руху спільні для всіх завдань, як у `batch`.
+ * @param socket_path Шлях сокета (NULL або порожній — типовий).
+ * @param markdown Формат завдань за замовчуванням.
+ * @param family Родина шрифтів (NULL — брати з конфігурації).
+ * @param font_size Кегль у пунктах (<=0 — з конфігурації).
+ * @param model Модель пристрою (NULL — типова).
+ * @param paper_w Ширина паперу, мм (<=0 — з профілю).
+ * @param paper_h Висота паперу, мм (<=0 — з профілю).
+ * @param margin_top Верхнє поле, мм (<0 — з конфіг.).
+ * @param margin_right Праве поле, мм (<0 — з конфіг.).
+ * @param margin_bottom Нижнє поле, мм (<0 — з конфіг.).
+ * @param margin_left Ліве поле, мм (<0 — з конфіг.).
+ * @param orientation Орієнтація (портрет/альбом).
+ * @param fit_page true — масштабувати кожне завдання під рамку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel true — переставити контури кожного завдання.
+ * @param dry_run true — без підключення до пристрою.
+ * @param verbose true — докладні журнали.
+ * @return 0 — штатна зупинка, інакше код помилки.
+ */
+cmd_result_t cmd_serve_execute (
+    const char *socket_path,
+    bool markdown,
+    const char *family,
+    double font_size,
+    const char *model,
+    double paper_w,
+    double paper_h,
+    double margin_top,
+    double margin_right,
+    double margin_bottom,
+    double margin_left,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool dry_run,
+    bool verbose) {
+    if (verbose)
+        LOGI ("Докладний режим виводу");
+    cmd_serve_ctx_t ctx;
+    memset (&ctx, 0, sizeof (ctx));
+    config_t cfg;
+    int setup_rc = cmd_print_setup (
+        &cfg, &ctx.job, model, paper_w, paper_h, margin_top, margin_right, margin_bottom,
+        margin_left, orientation, fit_page, &family, &font_size, &ctx.page);
+    if (setup_rc != 0)
+        return setup_rc;
+    ctx.family = family;
+    ctx.font_size = font_size;
+    ctx.markdown = markdown;
+    ctx.optimize_travel = optimize_travel;
+    cmd_motion_limits (&ctx.job, model, motion_profile, &ctx.limits);
+
+    /* Блоки Markdown кешуються в памʼяті сервера між завданнями, без файлу. */
+    layoutcache_blocks_memory_only ();
+
+    /* Прогрів: каталог шрифтів і гліфи типової родини. */
+    drawing_layout_t warm = { 0 };
+    string_t sample = { .chars = "cplot", .len = 5, .enc = STR_ENC_UTF8 };
+    if (cmd_print_build_layout (
+            &ctx.page, sample, INPUT_FORMAT_TEXT, family, font_size, 1, &warm)
+        != 0) {
+        LOGE ("Сервер: не вдалося підготувати шрифти");
+        return 1;
+    }
+    drawing_layout_dispose (&warm);
+
+    if (plot_hold_open (&ctx.hold, &ctx.job, model, NULL, dry_run) != 0) {
+        LOGE ("Сервер: пристрій зайнятий або недоступний");
+        return 1;
+    }
+    jsr_doc_init (&ctx.doc);
+    jobarena_init (&ctx.arena, 0);
+    ctx.page.arena = &ctx.arena;
+    int rc = serve_run (socket_path, cmd_serve_job, &ctx);
+    ctx.page.arena = NULL;
+    jobarena_free (&ctx.arena);
+    jsr_doc_free (&ctx.doc);
+    plot_hold_close (ctx.hold);
     return rc;
 }
 
@@ -1932,6 +3281,17 @@ cmd_result_t cmd_version_execute (bool verbose) {
     return 0;
 }
 
+/** @copydoc cmd_trace_execute */
+cmd_result_t cmd_trace_execute (const char *path, bool verbose) {
+    if (!path || !path[0] || strcmp (path, "-") == 0) {
+        LOGE ("Вкажіть файл дампа трасування: cplot trace ФАЙЛ");
+        return 1;
+    }
+    if (verbose)
+        LOGI ("трасування: розшифровка %s", path);
+    return trace_decode_file (path, CMD_OUT) == 0 ? 0 : 1;
+}
+
 /**
  * @brief Друк переліку шрифтів (еквівалент `cmd_font_list_execute(false)`).
  * @param verbose true — друкувати додаткові журнали.
@@ -2040,13 +3400,24 @@ cmd_result_t cmd_config_show (const config_t *cfg, bool verbose) {
         CMD_OUT, "  font_family      : %s\n", cfg->font_family[0] ? cfg->font_family : "<типова>");
     fprintf (CMD_OUT, "  speed_mm_s       : %.2f\n", cfg->speed_mm_s);
     fprintf (CMD_OUT, "  accel_mm_s2      : %.2f\n", cfg->accel_mm_s2);
+    fprintf (CMD_OUT, "  travel_speed_mm_s: %.2f\n", cfg->travel_speed_mm_s);
+    fprintf (CMD_OUT, "  travel_accel_mm_s2: %.2f\n", cfg->travel_accel_mm_s2);
     fprintf (CMD_OUT, "  pen_up_pos       : %d\n", cfg->pen_up_pos);
     fprintf (CMD_OUT, "  pen_down_pos     : %d\n", cfg->pen_down_pos);
     fprintf (CMD_OUT, "  pen_up_speed     : %d\n", cfg->pen_up_speed);
     fprintf (CMD_OUT, "  pen_down_speed   : %d\n", cfg->pen_down_speed);
     fprintf (CMD_OUT, "  pen_up_delay_ms  : %d\n", cfg->pen_up_delay_ms);
     fprintf (CMD_OUT, "  pen_down_delay_ms: %d\n", cfg->pen_down_delay_ms);
+    fprintf (CMD_OUT, "  pen_lead_ms      : %d\n", cfg->pen_lead_ms);
     fprintf (CMD_OUT, "  servo_timeout_s  : %d\n", cfg->servo_timeout_s);
+    fprintf (CMD_OUT, "  pen_hop_mm       : %.3f\n", cfg->pen_hop_mm);
+    fprintf (CMD_OUT, "  merge_phases     : %d\n", cfg->merge_phases);
+    fprintf (CMD_OUT, "  jerk_mm_s3       : %.1f\n", cfg->jerk_mm_s3);
+    fprintf (CMD_OUT, "  simplify_tol_mm  : %.3f\n", cfg->simplify_tol_mm);
+    fprintf (CMD_OUT, "  chord_tol_mm     : %.3f\n", cfg->chord_tol_mm);
+    fprintf (
+        CMD_OUT, "  line_break       : %d (%s)\n", cfg->line_break,
+        cfg->line_break ? "optimal" : "greedy");
     fprintf (
         CMD_OUT, "  default_device   : %s\n",
         cfg->default_device[0] ? cfg->default_device : "<не задано>");
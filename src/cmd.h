@@ -1,6 +1,7 @@
 /**
  * @file cmd.h
- * @brief Фасади виконання підкоманд `print`, `device`, `config`, `fonts`, `version`.
+ * @brief Фасади підкоманд `print`, `plan`, `batch`, `serve`, `device`, `config`, `fonts`,
+ *        `version`.
  * @defgroup cmd Команди
  * @ingroup cli
  */
@@ -9,6 +10,7 @@
 
 #include "config.h"
 #include "args.h"
+#include "sink.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -33,7 +35,7 @@ void cmd_set_output (FILE *out);
  * @brief Виконання друку на пристрій AxiDraw.
  * @param in_chars Вхідний текст.
  * @param in_len Довжина вхідного тексту.
- * @param markdown Чи інтерпретувати вхід як Markdown.
+ * @param format Формат входу (текст, Markdown або SVG).
  * @param font_family Назва шрифтної родини Hershey.
  * @param font_size_pt Розмір шрифту у пунктах.
  * @param device_model Модель пристрою (профіль руху).
@@ -45,11 +47,55 @@ void cmd_set_output (FILE *out);
  * @param margin_left_mm Ліве поле у мм.
  * @param orientation Орієнтація сторінки.
  * @param fit_page Масштабувати вміст під сторінку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel Переставити контури для коротших переїздів без пера.
  * @param dry_run Режим без фізичних дій.
+ * @param estimate true — лише оцінити тривалість (JSON у stdout), без пристрою.
+ * @param resume Продовжити перерваний друк із точки відновлення (`checkpoint.h`).
  * @param verbose Детальні журнали.
  * @return 0 — успіх, інакше — код помилки.
  */
 cmd_result_t cmd_print_execute (
+    const char *in_chars,
+    size_t in_len,
+    input_format_t format,
+    const char *font_family,
+    double font_size_pt,
+    const char *device_model,
+    double paper_w_mm,
+    double paper_h_mm,
+    double margin_top_mm,
+    double margin_right_mm,
+    double margin_bottom_mm,
+    double margin_left_mm,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool dry_run,
+    bool estimate,
+    bool resume,
+    bool verbose);
+
+/**
+ * @brief Друкує довгий документ посторінково (`print --paginate`).
+ * @details Документ верстається потоком (`page_layout_stream`) і кожна сторінка одразу
+ *          виводиться: превʼю — у файли `PATH-N.ext`, оцінка — окремий JSON на сторінку,
+ *          друк і сухий запуск — в одному утримуваному сеансі пристрою. Кожна сторінка
+ *          починається і закінчується в одній точці (початок першого контуру першої
+ *          сторінки). Між сторінками виконується `page_hook` (`CPLOT_PAGE` — номер
+ *          наступної сторінки; ненуль зупиняє друк), а без нього на пристрої — пауза
+ *          до Enter на терміналі. Параметри розкладки — як у `cmd_print_execute`;
+ *          масштабування під сторінку не застосовується.
+ * @param preview true — превʼю замість друку.
+ * @param preview_png 1 — PNG, 0 — SVG.
+ * @param preview_dpi Роздільність превʼю, dpi (<=0 — типова).
+ * @param preview_max_width Найбільша ширина PNG, пікселі (0 — без обмеження).
+ * @param output_path Шаблон імен файлів превʼю (обовʼязковий для превʼю).
+ * @param page_hook Команда між сторінками (NULL або порожня — пауза на терміналі).
+ * @return 0 — успіх, інакше — код помилки.
+ */
+cmd_result_t cmd_print_pages (
     const char *in_chars,
     size_t in_len,
     bool markdown,
@@ -63,8 +109,166 @@ cmd_result_t cmd_print_execute (
     double margin_bottom_mm,
     double margin_left_mm,
     int orientation,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool preview,
+    int preview_png,
+    double preview_dpi,
+    unsigned preview_max_width,
+    const char *output_path,
+    bool dry_run,
+    bool estimate,
+    const char *page_hook,
+    bool verbose);
+
+/**
+ * @brief Верстає і планує документ, зберігаючи блоки у файл плану без друку.
+ * @details Параметри розкладки — як у `cmd_print_execute`. Файл виконується пізніше
+ *          `cmd_plan_replay` скільки завгодно разів без верстки і планування.
+ * @param in_chars Вхідний текст.
+ * @param in_len Довжина вхідного тексту.
+ * @param format Формат входу (текст, Markdown або SVG).
+ * @param font_family Назва шрифтної родини Hershey.
+ * @param font_size_pt Розмір шрифту у пунктах.
+ * @param device_model Модель пристрою (профіль руху; записується у план).
+ * @param paper_w_mm Ширина паперу у мм.
+ * @param paper_h_mm Висота паперу у мм.
+ * @param margin_top_mm Верхнє поле у мм.
+ * @param margin_right_mm Праве поле у мм.
+ * @param margin_bottom_mm Нижнє поле у мм.
+ * @param margin_left_mm Ліве поле у мм.
+ * @param orientation Орієнтація сторінки.
+ * @param fit_page Масштабувати вміст під сторінку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel Переставити контури для коротших переїздів без пера.
+ * @param plan_path Шлях до файлу плану.
+ * @param verbose Детальні журнали.
+ * @return 0 — успіх, інакше — код помилки.
+ */
+cmd_result_t cmd_plan_save (
+    const char *in_chars,
+    size_t in_len,
+    input_format_t format,
+    const char *font_family,
+    double font_size_pt,
+    const char *device_model,
+    double paper_w_mm,
+    double paper_h_mm,
+    double margin_top_mm,
+    double margin_right_mm,
+    double margin_bottom_mm,
+    double margin_left_mm,
+    int orientation,
     bool fit_page,
     motion_profile_t motion_profile,
+    bool optimize_travel,
+    const char *plan_path,
+    bool verbose);
+
+/**
+ * @brief Виконує збережений план на пристрої (або оцінює його тривалість).
+ * @param plan_path Шлях до файлу плану.
+ * @param device_model Модель пристрою (порожньо — модель із плану).
+ * @param dry_run Режим без фізичних дій.
+ * @param estimate true — лише оцінити тривалість (JSON у stdout), без пристрою.
+ * @param verbose Детальні журнали.
+ * @return 0 — успіх, інакше — код помилки.
+ */
+cmd_result_t cmd_plan_replay (
+    const char *plan_path, const char *device_model, bool dry_run, bool estimate, bool verbose);
+
+/**
+ * @brief Пакетний друк документів із маніфесту JSONL за один сеанс пристрою.
+ * @details Кожен рядок маніфесту — JSON-обʼєкт із полями `text` або `file`, а також
+ *          необовʼязковими `format` (`markdown`/`text`), `font_family`, `font_size`,
+ *          `offset_x`, `offset_y` (мм). Документи верстаються паралельно, а потім
+ *          виконуються послідовно з переїздами піднятого пера між ними. З `devices`
+ *          документи розподіляються між кількома плотерами, кожен друкує свою частку
+ *          у власному потоці.
+ * @param manifest Вміст маніфесту.
+ * @param manifest_len Довжина маніфесту.
+ * @param markdown Формат документів за замовчуванням.
+ * @param font_family Назва шрифтної родини за замовчуванням.
+ * @param font_size_pt Розмір шрифту за замовчуванням у пунктах.
+ * @param device_model Модель пристрою (профіль руху).
+ * @param paper_w_mm Ширина паперу у мм.
+ * @param paper_h_mm Висота паперу у мм.
+ * @param margin_top_mm Верхнє поле у мм.
+ * @param margin_right_mm Праве поле у мм.
+ * @param margin_bottom_mm Нижнє поле у мм.
+ * @param margin_left_mm Ліве поле у мм.
+ * @param orientation Орієнтація сторінки.
+ * @param fit_page Масштабувати кожен документ під сторінку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel Переставити контури документів для коротших переїздів без пера.
+ * @param dry_run Режим без фізичних дій.
+ * @param estimate true — лише оцінити тривалість (JSON у stdout), без пристрою.
+ * @param devices Кількість плотерів: 0 — один сеанс, -1 — усі знайдені.
+ * @param verbose Детальні журнали.
+ * @return 0 — успіх, інакше — код помилки.
+ */
+cmd_result_t cmd_batch_execute (
+    const char *manifest,
+    size_t manifest_len,
+    bool markdown,
+    const char *font_family,
+    double font_size_pt,
+    const char *device_model,
+    double paper_w_mm,
+    double paper_h_mm,
+    double margin_top_mm,
+    double margin_right_mm,
+    double margin_bottom_mm,
+    double margin_left_mm,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
+    bool dry_run,
+    bool estimate,
+    int devices,
+    bool verbose);
+
+/**
+ * @brief Запускає сервер завдань (`cplot serve`) на Unix-сокеті.
+ * @details Шрифти, конфігурація і підключення до пристрою готуються один раз; кожне
+ *          завдання (обʼєкт JSON з полями рядка маніфесту `batch`) оплачує лише свою
+ *          верстку і план. Параметри сторінки і профіль руху спільні для всіх завдань.
+ * @param socket_path Шлях сокета (NULL або порожній — типовий).
+ * @param markdown Формат завдань за замовчуванням.
+ * @param font_family Назва шрифтної родини за замовчуванням.
+ * @param font_size_pt Розмір шрифту за замовчуванням у пунктах.
+ * @param device_model Модель пристрою (профіль руху).
+ * @param paper_w_mm Ширина паперу у мм.
+ * @param paper_h_mm Висота паперу у мм.
+ * @param margin_top_mm Верхнє поле у мм.
+ * @param margin_right_mm Праве поле у мм.
+ * @param margin_bottom_mm Нижнє поле у мм.
+ * @param margin_left_mm Ліве поле у мм.
+ * @param orientation Орієнтація сторінки.
+ * @param fit_page Масштабувати кожне завдання під сторінку.
+ * @param motion_profile Профіль руху.
+ * @param optimize_travel Переставити контури завдань для коротших переїздів без пера.
+ * @param dry_run Режим без фізичних дій.
+ * @param verbose Детальні журнали.
+ * @return 0 — штатна зупинка (SIGINT/SIGTERM), інакше — код помилки.
+ */
+cmd_result_t cmd_serve_execute (
+    const char *socket_path,
+    bool markdown,
+    const char *font_family,
+    double font_size_pt,
+    const char *device_model,
+    double paper_w_mm,
+    double paper_h_mm,
+    double margin_top_mm,
+    double margin_right_mm,
+    double margin_bottom_mm,
+    double margin_left_mm,
+    int orientation,
+    bool fit_page,
+    motion_profile_t motion_profile,
+    bool optimize_travel,
     bool dry_run,
     bool verbose);
 
@@ -72,7 +276,7 @@ cmd_result_t cmd_print_execute (
  * @brief Генерує превʼю векторного/растрового зображення без друку на пристрій.
  * @param in_chars Вхідний текст.
  * @param in_len Довжина вхідного тексту.
- * @param markdown Чи інтерпретувати вхід як Markdown.
+ * @param format Формат входу (текст, Markdown або SVG).
  * @param font_family Назва шрифтної родини Hershey.
  * @param font_size_pt Розмір шрифту у пунктах.
  * @param device_model Модель пристрою (профіль руху).
@@ -85,15 +289,16 @@ cmd_result_t cmd_print_execute (
  * @param orientation Орієнтація сторінки.
  * @param fit_page Масштабувати вміст під сторінку (як булеве ціле).
  * @param preview_png Якщо 1 — вивід PNG, інакше SVG.
+ * @param preview_dpi Роздільність превʼю, dpi (<=0 — типова; для SVG — точність координат).
+ * @param preview_max_width Найбільша ширина PNG у пікселях (0 — без обмеження).
  * @param verbose Детальні журнали.
- * @param out_bytes [out] Буфер згенерованих байтів.
- * @param out_len [out] Довжина буфера в байтах.
+ * @param out Приймач згенерованих байтів (файл, дескриптор або памʼять).
  * @return 0 — успіх, інакше — код помилки.
  */
 cmd_result_t cmd_print_preview (
     const char *in_chars,
     size_t in_len,
-    bool markdown,
+    input_format_t format,
     const char *font_family,
     double font_size_pt,
     const char *device_model,
@@ -106,9 +311,10 @@ cmd_result_t cmd_print_preview (
     int orientation,
     int fit_page,
     int preview_png,
+    double preview_dpi,
+    unsigned preview_max_width,
     bool verbose,
-    uint8_t **out_bytes,
-    size_t *out_len);
+    sink_t *out);
 
 /**
  * @brief Друк версії застосунку.
@@ -117,6 +323,14 @@ cmd_result_t cmd_print_preview (
  */
 cmd_result_t cmd_version_execute (bool verbose);
 
+/**
+ * @brief Розшифровує дамп трасування (`--trace`) у рядки журналу в stdout.
+ * @param path Файл дампа.
+ * @param verbose Увімкнути докладні журнали.
+ * @return 0 — успіх, інакше код помилки.
+ */
+cmd_result_t cmd_trace_execute (const char *path, bool verbose);
+
 /**
  * @brief Друк інформації про доступні шрифти.
  * @param verbose Увімкнути докладні журнали.
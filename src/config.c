@@ -9,6 +9,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,21 +37,16 @@ static int config_dir_exists (const char *p) {
     return 0;
 }
 
-/**
- * @brief Рекурсивно створює усі проміжні каталоги (аналог `mkdir -p`).
- * @param path Повний шлях до каталогу/файлу.
- * @return 0 — успіх, -1 — помилка створення.
- */
-static int config_mkdir_p (const char *path) {
+/** @copydoc config_mkdir_p */
+int config_mkdir_p (const char *path) {
     if (!path || !path[0])
         return -1;
-    char tmp[512];
-    strncpy (tmp, path, sizeof (tmp) - 1);
-    tmp[sizeof (tmp) - 1] = '\0';
-    size_t len = strlen (tmp);
-    if (len == 0)
+    char tmp[PATH_MAX];
+    size_t len = strlen (path);
+    if (len >= sizeof (tmp))
         return -1;
-    if (tmp[len - 1] == PATH_SEP)
+    memcpy (tmp, path, len + 1);
+    if (len > 1 && tmp[len - 1] == PATH_SEP)
         tmp[len - 1] = '\0';
     for (char *p = tmp + 1; *p; p++) {
         if (*p == PATH_SEP) {
@@ -69,6 +65,25 @@ static int config_mkdir_p (const char *path) {
     return 0;
 }
 
+/** @copydoc config_xdg_dir */
+int config_xdg_dir (
+    const char *env, const char *home_rel, const char *sub, char *buf, size_t buflen) {
+    if (!buf || buflen == 0)
+        return -1;
+    const char *xdg = env ? getenv (env) : NULL;
+    const char *home = getenv ("HOME");
+    const char *tail = (sub && sub[0]) ? sub : "";
+    const char *sep = tail[0] ? "/" : "";
+    int written = -1;
+    if (xdg && xdg[0])
+        written = snprintf (buf, buflen, "%s/cplot%s%s", xdg, sep, tail);
+    else if (home && home[0])
+        written = snprintf (buf, buflen, "%s/%s/cplot%s%s", home, home_rel, sep, tail);
+    if (written < 0 || (size_t)written >= buflen)
+        return -1;
+    return 0;
+}
+
 /**
  * @brief Записує рядок у JSON зі екрануванням.
  * @param fp Файл.
@@ -151,7 +166,16 @@ int config_factory_defaults (config_t *c, const char *device_model) {
     c->pen_down_speed = 150;
     c->pen_up_delay_ms = 0;
     c->pen_down_delay_ms = 0;
+    c->pen_lead_ms = 0;
     c->servo_timeout_s = 60;
+    c->pen_hop_mm = 0.0;
+    c->merge_phases = 1;
+    c->jerk_mm_s3 = 0.0;
+    c->travel_speed_mm_s = 0.0;
+    c->travel_accel_mm_s2 = 0.0;
+    c->simplify_tol_mm = 0.005;
+    c->chord_tol_mm = 0.02;
+    c->line_break = 0;
     c->default_device[0] = '\0';
     const axidraw_device_profile_t *profile = axidraw_device_profile_for_model (requested_model);
     axidraw_device_profile_apply (c, profile);
@@ -228,6 +252,8 @@ static int config_parse_json (const char *s, config_t *c) {
         { "margin_left_mm", FIELD_DOUBLE, &c->margin_left_mm, 0 },
         { "speed_mm_s", FIELD_DOUBLE, &c->speed_mm_s, 0 },
         { "accel_mm_s2", FIELD_DOUBLE, &c->accel_mm_s2, 0 },
+        { "travel_speed_mm_s", FIELD_DOUBLE, &c->travel_speed_mm_s, 0 },
+        { "travel_accel_mm_s2", FIELD_DOUBLE, &c->travel_accel_mm_s2, 0 },
         { "font_size_pt", FIELD_DOUBLE, &c->font_size_pt, 0 },
         { "orientation", FIELD_ENUM, &c->orientation, 0 },
         { "pen_up_pos", FIELD_INT, &c->pen_up_pos, 0 },
@@ -236,7 +262,14 @@ static int config_parse_json (const char *s, config_t *c) {
         { "pen_down_speed", FIELD_INT, &c->pen_down_speed, 0 },
         { "pen_up_delay_ms", FIELD_INT, &c->pen_up_delay_ms, 0 },
         { "pen_down_delay_ms", FIELD_INT, &c->pen_down_delay_ms, 0 },
+        { "pen_lead_ms", FIELD_INT, &c->pen_lead_ms, 0 },
         { "servo_timeout_s", FIELD_INT, &c->servo_timeout_s, 0 },
+        { "pen_hop_mm", FIELD_DOUBLE, &c->pen_hop_mm, 0 },
+        { "merge_phases", FIELD_INT, &c->merge_phases, 0 },
+        { "jerk_mm_s3", FIELD_DOUBLE, &c->jerk_mm_s3, 0 },
+        { "simplify_tol_mm", FIELD_DOUBLE, &c->simplify_tol_mm, 0 },
+        { "chord_tol_mm", FIELD_DOUBLE, &c->chord_tol_mm, 0 },
+        { "line_break", FIELD_INT, &c->line_break, 0 },
         { "version", FIELD_INT, &c->version, 0 },
         { "font_family", FIELD_STRING, c->font_family, sizeof (c->font_family) },
         { "default_device", FIELD_STRING, c->default_device, sizeof (c->default_device) },
@@ -370,17 +403,28 @@ static int config_write_json (FILE *fp, const config_t *c) {
         "  \"font_size_pt\": %.2f,\n"
         "  \"speed_mm_s\": %.3f,\n"
         "  \"accel_mm_s2\": %.3f,\n"
+        "  \"travel_speed_mm_s\": %.3f,\n"
+        "  \"travel_accel_mm_s2\": %.3f,\n"
         "  \"pen_up_pos\": %d,\n"
         "  \"pen_down_pos\": %d,\n"
         "  \"pen_up_speed\": %d,\n"
         "  \"pen_down_speed\": %d,\n"
         "  \"pen_up_delay_ms\": %d,\n"
         "  \"pen_down_delay_ms\": %d,\n"
-        "  \"servo_timeout_s\": %d,\n",
+        "  \"pen_lead_ms\": %d,\n"
+        "  \"servo_timeout_s\": %d,\n"
+        "  \"pen_hop_mm\": %.3f,\n"
+        "  \"merge_phases\": %d,\n"
+        "  \"jerk_mm_s3\": %.1f,\n"
+        "  \"simplify_tol_mm\": %.4f,\n"
+        "  \"chord_tol_mm\": %.4f,\n"
+        "  \"line_break\": %d,\n",
         c->version, c->orientation, c->paper_w_mm, c->paper_h_mm, c->margin_top_mm,
         c->margin_right_mm, c->margin_bottom_mm, c->margin_left_mm, c->font_size_pt, c->speed_mm_s,
-        c->accel_mm_s2, c->pen_up_pos, c->pen_down_pos, c->pen_up_speed, c->pen_down_speed,
-        c->pen_up_delay_ms, c->pen_down_delay_ms, c->servo_timeout_s);
+        c->accel_mm_s2, c->travel_speed_mm_s, c->travel_accel_mm_s2, c->pen_up_pos,
+        c->pen_down_pos, c->pen_up_speed, c->pen_down_speed, c->pen_up_delay_ms,
+        c->pen_down_delay_ms, c->pen_lead_ms, c->servo_timeout_s, c->pen_hop_mm, c->merge_phases,
+        c->jerk_mm_s3, c->simplify_tol_mm, c->chord_tol_mm, c->line_break);
     if (n < 0)
         return -1;
     if (fprintf (fp, "  \"font_family\": ") < 0)
@@ -463,6 +507,47 @@ int config_validate (const config_t *c, char *err, size_t errlen) {
             snprintf (err, errlen, "Тайм-аут сервоприводу поза діапазоном (0..300)");
         return -12;
     }
+    if (!(c->simplify_tol_mm >= 0.0) || c->simplify_tol_mm > 0.5) {
+        if (err)
+            snprintf (err, errlen, "Допуск спрощення поза діапазоном (0..0.5 мм)");
+        return -13;
+    }
+    if (!(c->chord_tol_mm >= 0.0) || c->chord_tol_mm > 0.5) {
+        if (err)
+            snprintf (err, errlen, "Допуск хорд поза діапазоном (0..0.5 мм)");
+        return -14;
+    }
+    if (c->line_break != 0 && c->line_break != 1) {
+        if (err)
+            snprintf (err, errlen, "Режим розбиття рядків поза діапазоном (0..1)");
+        return -15;
+    }
+    if (c->pen_lead_ms < 0 || c->pen_lead_ms > 1000) {
+        if (err)
+            snprintf (err, errlen, "Перекриття руху пера поза діапазоном (0..1000 мс)");
+        return -16;
+    }
+    if (!(c->pen_hop_mm >= 0.0 && c->pen_hop_mm <= 2.0)) {
+        if (err)
+            snprintf (err, errlen, "Проміжок без підйому пера поза діапазоном (0..2 мм)");
+        return -17;
+    }
+    if (c->merge_phases < 0 || c->merge_phases > 1) {
+        if (err)
+            snprintf (err, errlen, "Обʼєднання фаз руху поза діапазоном (0..1)");
+        return -18;
+    }
+    if (!(c->jerk_mm_s3 >= 0.0 && c->jerk_mm_s3 <= 100000.0)) {
+        if (err)
+            snprintf (err, errlen, "Обмеження ривка поза діапазоном (0..100000 мм/с³)");
+        return -19;
+    }
+    if (!(c->travel_speed_mm_s >= 0.0 && c->travel_speed_mm_s <= 2000.0)
+        || !(c->travel_accel_mm_s2 >= 0.0 && c->travel_accel_mm_s2 <= 50000.0)) {
+        if (err)
+            snprintf (err, errlen, "Швидкість або прискорення переїздів поза діапазоном");
+        return -20;
+    }
     return 0;
 }
 
@@ -33,8 +33,10 @@ typedef struct {
     double font_size_pt;       /**< Розмір шрифту, пт. */
     char font_family[128];     /**< Типова шрифтна родина. */
 
-    double speed_mm_s;  /**< Швидкість руху, мм/с. */
-    double accel_mm_s2; /**< Прискорення, мм/с^2. */
+    double speed_mm_s;         /**< Швидкість руху, мм/с. */
+    double accel_mm_s2;        /**< Прискорення, мм/с^2. */
+    double travel_speed_mm_s;  /**< Швидкість переїздів без пера, мм/с (0 — межа моделі). */
+    double travel_accel_mm_s2; /**< Прискорення переїздів без пера, мм/с^2 (0 — межа моделі). */
 
     int pen_up_pos;        /**< Положення пера вгору (%, 0..100). */
     int pen_down_pos;      /**< Положення пера вниз (%, 0..100). */
@@ -42,7 +44,15 @@ typedef struct {
     int pen_down_speed;    /**< Швидкість опускання пера (умовн. од.). */
     int pen_up_delay_ms;   /**< Затримка після підняття пера, мс. */
     int pen_down_delay_ms; /**< Затримка після опускання пера, мс. */
+    int pen_lead_ms;       /**< Перекриття затримок пера з переїздом, мс (0 — вимк.). */
     int servo_timeout_s;   /**< Тайм-аут живлення серво, с. */
+    double pen_hop_mm;     /**< Найбільший проміжок між контурами без підйому пера, мм. */
+    int merge_phases;      /**< Обʼєднання фаз руху в спільні команди LM (0/1). */
+    double jerk_mm_s3;     /**< Обмеження ривка S‑подібних профілів, мм/с³ (0 — трапеція). */
+
+    double simplify_tol_mm; /**< Допуск спрощення контурів перед плануванням, мм (0 — вимк.). */
+    double chord_tol_mm;    /**< Допуск злиття штрихів у хорди планувальника, мм (0 — вимк.). */
+    int line_break;         /**< Розбиття тексту на рядки: 0 — жадібне, 1 — оптимальне. */
 
     char default_device[64]; /**< Типовий псевдонім пристрою. */
 } config_t;
@@ -98,4 +108,24 @@ int config_validate (const config_t *c, char *err, size_t errlen);
  */
 int config_get_path (char *buf, size_t buflen);
 
+/**
+ * @brief Обчислює каталог cplot у базовому XDG-каталозі.
+ * @details Якщо змінна `env` порожня, база — `$HOME/home_rel`.
+ * @param env Змінна середовища бази (`XDG_CACHE_HOME`, `XDG_STATE_HOME`).
+ * @param home_rel Типова база відносно `$HOME` (`.cache`, `.local/state`).
+ * @param sub Підкаталог усередині `cplot` (NULL або "" — сам `cplot`).
+ * @param buf [out] Буфер шляху.
+ * @param buflen Довжина буфера.
+ * @return 0 — успіх; -1 — немає ні `env`, ні `HOME`, або буфер замалий.
+ */
+int config_xdg_dir (
+    const char *env, const char *home_rel, const char *sub, char *buf, size_t buflen);
+
+/**
+ * @brief Створює каталог разом із проміжними (аналог `mkdir -p`, права 0700).
+ * @param path Шлях до каталогу.
+ * @return 0 — успіх; -1 — помилка або надто довгий шлях.
+ */
+int config_mkdir_p (const char *path);
+
 #endif
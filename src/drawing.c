@@ -7,6 +7,7 @@
 #include "drawing.h"
 
 #include "config.h"
+#include "layoutcache.h"
 #include "log.h"
 #include "png.h"
 #include "svg.h"
@@ -16,12 +17,50 @@
 #include <stdlib.h>
 #include <string.h>
 
+/** \brief Опції верстки простого тексту для розкладки сторінки (перенос і арена — з `page`). */
+static text_layout_opts_t drawing_text_opts (
+    const drawing_page_t *page, const char *font_family, double size_pt, double frame_width_mm) {
+    text_layout_opts_t opts = {
+        .family = font_family,
+        .size_pt = size_pt,
+        .style_flags = TEXT_STYLE_NONE,
+        .units = GEOM_UNITS_MM,
+        .frame_width = frame_width_mm,
+        .align = TEXT_ALIGN_LEFT,
+        .hyphenate = 1,
+        .line_spacing = 1.0,
+        .break_mode = page->break_mode,
+        .arena = page->arena,
+    };
+    return opts;
+}
+
+/** \brief Параметри полотна для сторінки та родини шрифту. */
+static canvas_options_t drawing_canvas_opts (const drawing_page_t *page, const char *font_family) {
+    canvas_options_t canvas_opts = {
+        .paper_w_mm = page->paper_w_mm,
+        .paper_h_mm = page->paper_h_mm,
+        .margin_top_mm = page->margin_top_mm,
+        .margin_right_mm = page->margin_right_mm,
+        .margin_bottom_mm = page->margin_bottom_mm,
+        .margin_left_mm = page->margin_left_mm,
+        .orientation = page->orientation,
+        .font_family = font_family,
+        .fit_to_frame = page->fit_to_frame ? true : false,
+        .anchored = page->anchored ? true : false,
+    };
+    return canvas_opts;
+}
+
 /**
  * @brief Рендерить текст у контури з урахуванням ширини рамки.
+ * @details Результат береться з кешу верстки (`layoutcache`), якщо текст, родина,
+ *          кегль і ширина рамки збігаються; інакше верстається і зберігається в кеш.
  * @param input Вхідний текст.
  * @param font_family Родина шрифтів (може бути NULL для типових).
  * @param font_size_pt Кегль, пт (<=0 — типове значення).
  * @param frame_width_mm Ширина рамки для верстки, мм.
+ * @param page Параметри сторінки (алгоритм переносу, арена).
  * @param out_paths [out] Контури (у мм).
  * @param info [out] Інформація про рендеринг (може бути NULL).
  * @return 0 — успіх, 1 — помилка.
@@ -31,10 +70,26 @@ static int drawing_build_text_paths (
     const char *font_family,
     double font_size_pt,
     double frame_width_mm,
+    const drawing_page_t *page,
     geom_paths_t *out_paths,
     text_render_info_t *info) {
     if (!out_paths)
         return 1;
+    double size_pt = (font_size_pt > 0.0) ? font_size_pt : 14.0;
+    text_render_info_t local_info;
+    text_render_info_t *info_ptr = info ? info : &local_info;
+    layoutcache_key_t cache_key = {
+        .text = input.chars,
+        .text_len = input.len,
+        .family = font_family,
+        .size_pt = size_pt,
+        .style_flags = TEXT_STYLE_NONE,
+        .frame_width_mm = frame_width_mm,
+        .break_mode = (unsigned)page->break_mode,
+    };
+    if (layoutcache_load (&cache_key, out_paths, info_ptr) == 0)
+        return 0;
+
     char *text_buf = NULL;
     if (input.len > 0) {
         text_buf = (char *)malloc (input.len + 1);
@@ -44,25 +99,70 @@ static int drawing_build_text_paths (
         text_buf[input.len] = '\0';
     }
 
+    text_layout_opts_t opts = drawing_text_opts (page, font_family, size_pt, frame_width_mm);
+    int rc = text_layout_render (text_buf ? text_buf : "", &opts, out_paths, NULL, NULL, info_ptr);
+    free (text_buf);
+    if (rc != 0) {
+        LOGE ("Не вдалося сформувати контури тексту");
+        return 1;
+    }
+    (void)layoutcache_store (&cache_key, out_paths, info_ptr);
+    return 0;
+}
+
+/**
+ * @brief Верстає текст як екземпляри гліфів і розміщує їх на сторінці.
+ * @details Кеш верстки зберігає розгорнуті контури, тож тут не використовується:
+ *          верстка без копій контурів дешевша за читання кешу великої сторінки.
+ * @param input Вхідний текст.
+ * @param font_family Родина шрифтів (може бути NULL для типових).
+ * @param font_size_pt Кегль, пт (<=0 — типове значення).
+ * @param frame_width_mm Ширина рамки для верстки, мм.
+ * @param page Параметри сторінки (алгоритм переносу, арена).
+ * @param canvas_opts Параметри полотна.
+ * @param out_layout [out] Макет з екземплярами гліфів.
+ * @param info [out] Інформація про рендеринг.
+ * @return 0 — успіх, 1 — помилка, 2 — некоректні параметри полотна.
+ */
+static int drawing_build_text_glyphs (
+    string_t input,
+    const char *font_family,
+    double font_size_pt,
+    double frame_width_mm,
+    const drawing_page_t *page,
+    const canvas_options_t *canvas_opts,
+    canvas_layout_t *out_layout,
+    text_render_info_t *info) {
     double size_pt = (font_size_pt > 0.0) ? font_size_pt : 14.0;
-    text_layout_opts_t opts = {
-        .family = font_family,
-        .size_pt = size_pt,
-        .style_flags = TEXT_STYLE_NONE,
-        .units = GEOM_UNITS_MM,
-        .frame_width = frame_width_mm,
-        .align = TEXT_ALIGN_LEFT,
-        .hyphenate = 1,
-        .line_spacing = 1.0,
-    };
+    char *text_buf = NULL;
+    if (input.len > 0) {
+        text_buf = (char *)malloc (input.len + 1);
+        if (!text_buf)
+            return 1;
+        memcpy (text_buf, input.chars, input.len);
+        text_buf[input.len] = '\0';
+    }
 
-    text_render_info_t local_info;
-    text_render_info_t *info_ptr = info ? info : &local_info;
-    int rc = text_layout_render (text_buf ? text_buf : "", &opts, out_paths, NULL, NULL, info_ptr);
+    text_layout_opts_t opts = drawing_text_opts (page, font_family, size_pt, frame_width_mm);
+    glyph_layout_t glyphs;
+    int rc = text_layout_render_glyphs (text_buf ? text_buf : "", &opts, &glyphs, info);
     free (text_buf);
-    if (rc != 0)
+    if (rc != 0) {
         LOGE ("Не вдалося сформувати контури тексту");
-    return rc == 0 ? 0 : 1;
+        return 1;
+    }
+
+    canvas_status_t canvas_rc = canvas_layout_glyphs (canvas_opts, &glyphs, out_layout);
+    glyph_layout_free (&glyphs);
+    if (canvas_rc == CANVAS_STATUS_INVALID_INPUT) {
+        LOGE ("Некоректні параметри полотна — перевірте орієнтацію чи поля");
+        return 2;
+    }
+    if (canvas_rc != CANVAS_STATUS_OK) {
+        LOGE ("Помилка під час планування полотна (код %d)", (int)canvas_rc);
+        return 1;
+    }
+    return 0;
 }
 
 /**
@@ -83,17 +183,7 @@ int drawing_build_layout (
     if (!page || !layout)
         return 1;
 
-    canvas_options_t canvas_opts = {
-        .paper_w_mm = page->paper_w_mm,
-        .paper_h_mm = page->paper_h_mm,
-        .margin_top_mm = page->margin_top_mm,
-        .margin_right_mm = page->margin_right_mm,
-        .margin_bottom_mm = page->margin_bottom_mm,
-        .margin_left_mm = page->margin_left_mm,
-        .orientation = page->orientation,
-        .font_family = font_family,
-        .fit_to_frame = page->fit_to_frame ? true : false,
-    };
+    canvas_options_t canvas_opts = drawing_canvas_opts (page, font_family);
 
     double frame_width_mm = 0.0;
     canvas_frame_dimensions (&canvas_opts, &frame_width_mm, NULL);
@@ -102,11 +192,23 @@ int drawing_build_layout (
         return 1;
     }
 
-    geom_paths_t text_paths;
     text_render_info_t info;
     memset (&info, 0, sizeof (info));
+    if (page->instanced) {
+        canvas_layout_t layout_mm;
+        int rc = drawing_build_text_glyphs (
+            input, font_family, font_size_pt, frame_width_mm, page, &canvas_opts, &layout_mm,
+            &info);
+        if (rc != 0)
+            return rc;
+        layout->layout = layout_mm;
+        layout->text_info = info;
+        return 0;
+    }
+
+    geom_paths_t text_paths;
     if (drawing_build_text_paths (
-            input, font_family, font_size_pt, frame_width_mm, &text_paths, &info)
+            input, font_family, font_size_pt, frame_width_mm, page, &text_paths, &info)
         != 0)
         return 1;
 
@@ -127,6 +229,51 @@ int drawing_build_layout (
     return 0;
 }
 
+/**
+ * @copydoc drawing_fit_font_size
+ */
+int drawing_fit_font_size (
+    const drawing_page_t *page,
+    const char *font_family,
+    double font_size_pt,
+    string_t input,
+    double min_size_pt,
+    double *out_size_pt) {
+    if (!page || !out_size_pt)
+        return 1;
+    double size_pt = (font_size_pt > 0.0) ? font_size_pt : 14.0;
+    *out_size_pt = size_pt;
+
+    canvas_options_t canvas_opts = drawing_canvas_opts (page, font_family);
+    double frame_w = 0.0, frame_h = 0.0;
+    canvas_frame_dimensions (&canvas_opts, &frame_w, &frame_h);
+    if (!(frame_w > 0.0) || !(frame_h > 0.0))
+        return 1;
+
+    char *text_buf = NULL;
+    if (input.len > 0) {
+        text_buf = (char *)malloc (input.len + 1);
+        if (!text_buf)
+            return 1;
+        memcpy (text_buf, input.chars, input.len);
+        text_buf[input.len] = '\0';
+    }
+    /* Рядки верстаються на ширину рамки, тож висота блоку лягає вздовж frame_h. */
+    double max_height = frame_h;
+    text_layout_opts_t opts = drawing_text_opts (page, font_family, size_pt, frame_w);
+    int rc = text_layout_fit_size (
+        text_buf ? text_buf : "", &opts, max_height, min_size_pt, out_size_pt);
+    free (text_buf);
+    if (rc != 0) {
+        *out_size_pt = size_pt;
+        return 1;
+    }
+    LOGD (
+        "drawing: fit кегль %.2f → %.2f пт (ширина %.1f, висота %.1f мм)", size_pt, *out_size_pt,
+        frame_w, max_height);
+    return 0;
+}
+
 /**
  * @brief Побудова розкладки з готових контурів.
  * @param page Параметри сторінки.
@@ -149,6 +296,7 @@ int drawing_build_layout_from_paths (
         .orientation = page->orientation,
         .font_family = NULL,
         .fit_to_frame = page->fit_to_frame ? true : false,
+        .anchored = page->anchored ? true : false,
     };
 
     canvas_layout_t layout_mm;
@@ -20,14 +20,18 @@ extern "C" {
  * @brief Параметри сторінки та полів та орієнтації.
  */
 typedef struct {
-    double paper_w_mm;         /**< Ширина паперу, мм. */
-    double paper_h_mm;         /**< Висота паперу, мм. */
-    double margin_top_mm;      /**< Верхнє поле, мм. */
-    double margin_right_mm;    /**< Праве поле, мм. */
-    double margin_bottom_mm;   /**< Нижнє поле, мм. */
-    double margin_left_mm;     /**< Ліве поле, мм. */
-    orientation_t orientation; /**< Орієнтація сторінки. */
-    int fit_to_frame;          /**< 1 — масштабувати вміст під рамку. */
+    double paper_w_mm;            /**< Ширина паперу, мм. */
+    double paper_h_mm;            /**< Висота паперу, мм. */
+    double margin_top_mm;         /**< Верхнє поле, мм. */
+    double margin_right_mm;       /**< Праве поле, мм. */
+    double margin_bottom_mm;      /**< Нижнє поле, мм. */
+    double margin_left_mm;        /**< Ліве поле, мм. */
+    orientation_t orientation;    /**< Орієнтація сторінки. */
+    int fit_to_frame;             /**< 1 — масштабувати вміст під рамку. */
+    text_break_mode_t break_mode; /**< Алгоритм розбиття тексту на рядки. */
+    int instanced;                /**< 1 — текст як екземпляри гліфів (лише для SVG‑превʼю). */
+    int anchored;                 /**< 1 — контури від початку рамки (сторінки, `page.h`). */
+    jobarena_t *arena;            /**< Арена проміжних даних верстки (NULL — купа). */
 } drawing_page_t;
 
 /**
@@ -63,8 +67,19 @@ typedef struct bytes {
     size_t len;     /**< Довжина буфера. */
 } bytes_t;
 
+/**
+ * @brief Параметри растеризації превʼю.
+ */
+typedef struct preview_opts {
+    double dpi;            /**< Роздільність, dpi (<=0 — типова для формату). */
+    unsigned max_width_px; /**< Найбільша ширина растру, пікселі (0 — без обмеження). */
+} preview_opts_t;
+
 /**
  * @brief Побудова розкладки на основі тексту та параметрів сторінки.
+ * @details З `page->instanced` розкладка містить екземпляри гліфів
+ *          (`canvas_layout_t::glyphs`) замість контурів і не використовує кеш верстки;
+ *          її розуміє лише `svg_write_layout`, для решти — `canvas_layout_flatten`.
  * @param page Параметри сторінки.
  * @param font_family Родина шрифту.
  * @param font_size_pt Розмір шрифту у пунктах.
@@ -79,6 +94,27 @@ int drawing_build_layout (
     string_t input,
     drawing_layout_t *layout);
 
+/**
+ * @brief Підбирає кегль, за якого текст вміщується в рамку сторінки.
+ * @details Працює лише з метриками рядків (`text_layout_fit_size`): перенос рядків
+ *          повторюється для кожної проби, а контури гліфів не будуються. Результат
+ *          передається в `drawing_build_layout`, тож текст рендериться один раз.
+ * @param page Параметри сторінки.
+ * @param font_family Родина шрифту.
+ * @param font_size_pt Бажаний (максимальний) кегль, пт.
+ * @param input Вхідний рядок.
+ * @param min_size_pt Мінімально допустимий кегль, пт.
+ * @param out_size_pt [out] Підібраний кегль (за помилки — бажаний).
+ * @return 0 — успіх, інакше — код помилки.
+ */
+int drawing_fit_font_size (
+    const drawing_page_t *page,
+    const char *font_family,
+    double font_size_pt,
+    string_t input,
+    double min_size_pt,
+    double *out_size_pt);
+
 /**
  * @brief Побудова розкладки з уже готових контурів.
  * @param page Параметри сторінки.
@@ -14,6 +14,8 @@
 #include <string.h>
 
 #include "log.h"
+#include "telemetry.h"
+#include "trace.h"
 
 /** Максимальна довжина форматованої команди. */
 #define EBB_CMD_MAX 128
@@ -22,18 +24,14 @@
 #define EBB_RESP_MAX 128
 
 /**
- * @brief Форматує та надсилає команду без очікування корисних даних (OK/ERR).
- * @param sp Відкритий серійний порт.
- * @param timeout_ms Тайм-аут читання відповіді (мс).
+ * @brief Форматує текст команди EBB.
+ * @param cmd [out] Буфер команди.
+ * @param cap Розмір буфера.
  * @param fmt Формат керуючої команди EBB.
  * @param ap Аргументи формату (va_list).
- * @return 0 — отримано OK, -1 — помилка.
+ * @return 0 — успіх, -1 — команда не вміщується або помилка форматування.
  */
-static int ebb_send_vcommand (serial_port_t *sp, int timeout_ms, const char *fmt, va_list ap) {
-    if (!sp || !fmt)
-        return -1;
-
-    char cmd[EBB_CMD_MAX];
+static int ebb_vformat (char *cmd, size_t cap, const char *fmt, va_list ap) {
 #if defined(__clang__)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wformat-nonliteral"
@@ -41,19 +39,46 @@ static int ebb_send_vcommand (serial_port_t *sp, int timeout_ms, const char *fmt
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
 #endif
-    int written = vsnprintf (cmd, sizeof (cmd), fmt, ap);
+    int written = vsnprintf (cmd, cap, fmt, ap);
 #if defined(__clang__)
 #pragma clang diagnostic pop
 #elif defined(__GNUC__)
 #pragma GCC diagnostic pop
 #endif
-    if (written < 0 || (size_t)written >= sizeof (cmd)) {
+    if (written < 0 || (size_t)written >= cap) {
         LOGE ("Команда контролера надто довга або форматована з помилкою");
         return -1;
     }
+    return 0;
+}
 
-    LOGD ("контролер → %s", cmd);
-    log_print (LOG_DEBUG, "контролер → %s", cmd);
+/** \brief Variadic-обгортка над ebb_vformat. */
+static int ebb_format (char *cmd, size_t cap, const char *fmt, ...) {
+    va_list ap;
+    va_start (ap, fmt);
+    int rc = ebb_vformat (cmd, cap, fmt, ap);
+    va_end (ap);
+    return rc;
+}
+
+/**
+ * @brief Форматує та надсилає команду без очікування корисних даних (OK/ERR).
+ * @param sp Відкритий серійний порт.
+ * @param timeout_ms Тайм-аут читання відповіді (мс).
+ * @param fmt Формат керуючої команди EBB.
+ * @param ap Аргументи формату (va_list).
+ * @return 0 — отримано OK, -1 — помилка.
+ */
+static int ebb_send_vcommand (serial_port_t *sp, int timeout_ms, const char *fmt, va_list ap) {
+    if (!sp || !fmt)
+        return -1;
+
+    char cmd[EBB_CMD_MAX];
+    if (ebb_vformat (cmd, sizeof (cmd), fmt, ap) != 0)
+        return -1;
+
+    TRACE_LOG (TRACE_EBB_SEND, cmd);
+    uint64_t sent_at = telemetry_now ();
     if (serial_write_line (sp, cmd) != 0) {
         LOGE ("Не вдалося надіслати команду до контролера");
         return -1;
@@ -68,10 +93,11 @@ static int ebb_send_vcommand (serial_port_t *sp, int timeout_ms, const char *fmt
             return -1;
         }
         resp[len] = '\0';
-        LOGD ("контролер ← %s", resp);
-        log_print (LOG_DEBUG, "контролер ← %s", resp);
-        if (strcmp (resp, "OK") == 0)
+        TRACE_LOG (TRACE_EBB_RECV, resp);
+        if (strcmp (resp, "OK") == 0) {
+            telemetry_rtt (sent_at);
             return 0;
+        }
         if (strncmp (resp, "ERR", 3) == 0 || resp[0] == '!') {
             LOGE ("Контролер повернув помилку: %s", resp);
             log_print (LOG_ERROR, "контролер: помилка відповіді '%s'", resp);
@@ -116,26 +142,11 @@ static int ebb_send_vquery (
         return -1;
 
     char cmd[EBB_CMD_MAX];
-#if defined(__clang__)
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wformat-nonliteral"
-#elif defined(__GNUC__)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-#endif
-    int written = vsnprintf (cmd, sizeof (cmd), fmt, ap);
-#if defined(__clang__)
-#pragma clang diagnostic pop
-#elif defined(__GNUC__)
-#pragma GCC diagnostic pop
-#endif
-    if (written < 0 || (size_t)written >= sizeof (cmd)) {
-        LOGE ("Команда контролера надто довга або форматована з помилкою");
+    if (ebb_vformat (cmd, sizeof (cmd), fmt, ap) != 0)
         return -1;
-    }
 
-    LOGD ("контролер → %s", cmd);
-    log_print (LOG_DEBUG, "контролер → %s", cmd);
+    TRACE_LOG (TRACE_EBB_SEND, cmd);
+    uint64_t sent_at = telemetry_now ();
     if (serial_write_line (sp, cmd) != 0) {
         LOGE ("Не вдалося надіслати команду до контролера");
         return -1;
@@ -152,14 +163,14 @@ static int ebb_send_vquery (
             return -1;
         }
         resp[len] = '\0';
-        LOGD ("контролер ← %s", resp);
-        log_print (LOG_DEBUG, "контролер ← %s", resp);
+        TRACE_LOG (TRACE_EBB_RECV, resp);
         if (strcmp (resp, "OK") == 0) {
             if (need_data && !data_received) {
                 LOGE ("Контролер не повернув дані у відповіді");
                 log_print (LOG_ERROR, "контролер: очікував дані від '%s', отримано лише ОК", cmd);
                 return -1;
             }
+            telemetry_rtt (sent_at);
             return 0;
         }
         if (strncmp (resp, "ERR", 3) == 0 || resp[0] == '!') {
@@ -171,7 +182,7 @@ static int ebb_send_vquery (
             strncpy (resp_out, resp, resp_len - 1);
             resp_out[resp_len - 1] = '\0';
             data_received = true;
-            log_print (LOG_DEBUG, "дані контролера: %s", resp_out);
+            TRACE_LOG (TRACE_EBB_DATA, resp_out);
         }
     }
 
@@ -226,10 +237,11 @@ int ebb_move_steps (
     return ebb_send_command (sp, timeout_ms, "SM,%u,%d,%d", duration_ms, steps1, steps2);
 }
 
-/** @copydoc ebb_pen_set */
-int ebb_pen_set (serial_port_t *sp, bool pen_up, int settle_ms, int portb_pin, int timeout_ms) {
-    if (!sp)
-        return -1;
+/**
+ * @brief Перевіряє параметри та форматує SP.
+ * @return 0 — успіх, -1 — параметри поза діапазоном.
+ */
+static int ebb_format_pen_set (char *cmd, size_t cap, bool pen_up, int settle_ms, int portb_pin) {
     if (settle_ms < 0 || settle_ms > 65535) {
         LOGE ("Тривалість затримки SP поза діапазоном: %d", settle_ms);
         return -1;
@@ -240,11 +252,20 @@ int ebb_pen_set (serial_port_t *sp, bool pen_up, int settle_ms, int portb_pin, i
     }
 
     if (portb_pin >= 0)
-        return ebb_send_command (
-            sp, timeout_ms, "SP,%d,%d,%d", pen_up ? 1 : 0, settle_ms, portb_pin);
+        return ebb_format (cmd, cap, "SP,%d,%d,%d", pen_up ? 1 : 0, settle_ms, portb_pin);
     if (settle_ms > 0)
-        return ebb_send_command (sp, timeout_ms, "SP,%d,%d", pen_up ? 1 : 0, settle_ms);
-    return ebb_send_command (sp, timeout_ms, "SP,%d", pen_up ? 1 : 0);
+        return ebb_format (cmd, cap, "SP,%d,%d", pen_up ? 1 : 0, settle_ms);
+    return ebb_format (cmd, cap, "SP,%d", pen_up ? 1 : 0);
+}
+
+/** @copydoc ebb_pen_set */
+int ebb_pen_set (serial_port_t *sp, bool pen_up, int settle_ms, int portb_pin, int timeout_ms) {
+    if (!sp)
+        return -1;
+    char cmd[EBB_CMD_MAX];
+    if (ebb_format_pen_set (cmd, sizeof (cmd), pen_up, settle_ms, portb_pin) != 0)
+        return -1;
+    return ebb_send_command (sp, timeout_ms, "%s", cmd);
 }
 
 /** @copydoc ebb_move_mixed */
@@ -269,19 +290,20 @@ static int ebb_validate_clear_flags (int clear_flags) {
     return (clear_flags == -1) || (clear_flags >= EBB_CLEAR_NONE && clear_flags <= EBB_CLEAR_BOTH);
 }
 
-/** @copydoc ebb_move_lowlevel_steps */
-int ebb_move_lowlevel_steps (
-    serial_port_t *sp,
+/**
+ * @brief Перевіряє параметри та форматує LM.
+ * @return 0 — успіх, -1 — параметри поза діапазоном.
+ */
+static int ebb_format_lowlevel_steps (
+    char *cmd,
+    size_t cap,
     uint32_t rate1,
     int32_t steps1,
     int32_t accel1,
     uint32_t rate2,
     int32_t steps2,
     int32_t accel2,
-    int clear_flags,
-    int timeout_ms) {
-    if (!sp)
-        return -1;
+    int clear_flags) {
     if (rate1 > 2147483647u || rate2 > 2147483647u) {
         LOGE ("Швидкість LM поза діапазоном: %" PRIu32 ", %" PRIu32, rate1, rate2);
         return -1;
@@ -296,14 +318,34 @@ int ebb_move_lowlevel_steps (
     }
 
     if (clear_flags >= 0)
-        return ebb_send_command (
-            sp, timeout_ms,
-            "LM,%" PRIu32 ",%" PRId32 ",%" PRId32 ",%" PRIu32 ",%" PRId32 ",%" PRId32 ",%d", rate1,
-            steps1, accel1, rate2, steps2, accel2, clear_flags);
+        return ebb_format (
+            cmd, cap, "LM,%" PRIu32 ",%" PRId32 ",%" PRId32 ",%" PRIu32 ",%" PRId32 ",%" PRId32 ",%d",
+            rate1, steps1, accel1, rate2, steps2, accel2, clear_flags);
 
-    return ebb_send_command (
-        sp, timeout_ms, "LM,%" PRIu32 ",%" PRId32 ",%" PRId32 ",%" PRIu32 ",%" PRId32 ",%" PRId32,
-        rate1, steps1, accel1, rate2, steps2, accel2);
+    return ebb_format (
+        cmd, cap, "LM,%" PRIu32 ",%" PRId32 ",%" PRId32 ",%" PRIu32 ",%" PRId32 ",%" PRId32, rate1,
+        steps1, accel1, rate2, steps2, accel2);
+}
+
+/** @copydoc ebb_move_lowlevel_steps */
+int ebb_move_lowlevel_steps (
+    serial_port_t *sp,
+    uint32_t rate1,
+    int32_t steps1,
+    int32_t accel1,
+    uint32_t rate2,
+    int32_t steps2,
+    int32_t accel2,
+    int clear_flags,
+    int timeout_ms) {
+    if (!sp)
+        return -1;
+    char cmd[EBB_CMD_MAX];
+    if (ebb_format_lowlevel_steps (
+            cmd, sizeof (cmd), rate1, steps1, accel1, rate2, steps2, accel2, clear_flags)
+        != 0)
+        return -1;
+    return ebb_send_command (sp, timeout_ms, "%s", cmd);
 }
 
 /** @copydoc ebb_move_lowlevel_time */
@@ -544,3 +586,217 @@ int ebb_set_servo_power_timeout (
         return ebb_send_command (sp, cmd_timeout_ms, "SR,%u,%d", timeout_ms, power_state);
     return ebb_send_command (sp, cmd_timeout_ms, "SR,%u", timeout_ms);
 }
+
+/** \brief Крок очікування відповіді в конвеєрі (мс). */
+#define EBB_PIPELINE_POLL_MS 20
+
+/** @copydoc ebb_pipeline_init */
+void ebb_pipeline_init (ebb_pipeline_t *pl, serial_port_t *sp, size_t depth, int timeout_ms) {
+    if (!pl)
+        return;
+    memset (pl, 0, sizeof (*pl));
+    pl->sp = sp;
+    pl->timeout_ms = (timeout_ms > 0) ? timeout_ms : 1000;
+    pl->depth = (depth == 0 || depth > EBB_PIPELINE_MAX) ? EBB_PIPELINE_MAX : depth;
+}
+
+/**
+ * @brief Зіставляє завершений рядок відповіді з найстарішою командою.
+ * @param pl Конвеєр (рядок у `pl->line`).
+ */
+static void ebb_pipeline_consume_line (ebb_pipeline_t *pl) {
+    pl->line[pl->line_len] = '\0';
+    size_t len = pl->line_len;
+    pl->line_len = 0;
+    if (len == 0)
+        return;
+    TRACE_LOG (TRACE_EBB_RECV, pl->line);
+    bool ok = strcmp (pl->line, "OK") == 0;
+    bool err = strncmp (pl->line, "ERR", 3) == 0 || pl->line[0] == '!';
+    if (!ok && !err)
+        return;
+    if (pl->count == 0) {
+        LOGW ("Контролер надіслав відповідь без відповідної команди: %s", pl->line);
+        return;
+    }
+    const ebb_pipeline_slot_t *slot = &pl->slots[pl->head];
+    if (err) {
+        LOGE (
+            "Контролер повернув помилку: %s на '%s' (блок №%lu, непідтверджених %zu)", pl->line,
+            slot->cmd, slot->tag, pl->count);
+        if (!pl->failed) {
+            pl->failed = true;
+            pl->failed_tag = slot->tag;
+        }
+    } else {
+        ++pl->acked;
+        pl->acked_tag = slot->tag;
+        telemetry_rtt (slot->sent_at);
+    }
+    pl->head = (pl->head + 1) % EBB_PIPELINE_MAX;
+    --pl->count;
+}
+
+/**
+ * @brief Записує в порт команди, накопичені в буфері передачі.
+ * @return 0 — успіх; -1 — помилка запису (конвеєр позначається зламаним).
+ */
+static int ebb_pipeline_flush (ebb_pipeline_t *pl) {
+    if (pl->unsent == 0)
+        return 0;
+    if (serial_flush_output (pl->sp) != 0) {
+        LOGE ("Не вдалося надіслати команду до контролера");
+        pl->failed = true;
+        pl->failed_tag = pl->slots[(pl->head + pl->count - pl->unsent) % EBB_PIPELINE_MAX].tag;
+        return -1;
+    }
+    pl->unsent = 0;
+    return 0;
+}
+
+/**
+ * @brief Дочитує відповіді контролера.
+ * @param pl Конвеєр.
+ * @param wait true — чекати, доки підтвердиться хоча б одна команда.
+ * @return 0 — успіх; -1 — помилка читання або тайм-аут (конвеєр позначається зламаним).
+ */
+static int ebb_pipeline_pump (ebb_pipeline_t *pl, bool wait) {
+    if (wait && ebb_pipeline_flush (pl) != 0)
+        return -1;
+    size_t before = pl->count;
+    int waited = 0;
+    char buf[64];
+    while (pl->count > 0) {
+        ssize_t rd = wait ? serial_read (pl->sp, buf, sizeof (buf), EBB_PIPELINE_POLL_MS)
+                          : serial_read_available (pl->sp, buf, sizeof (buf));
+        if (rd < 0) {
+            LOGE ("Не вдалося прочитати відповідь контролера");
+            pl->failed = true;
+            pl->failed_tag = pl->slots[pl->head].tag;
+            return -1;
+        }
+        if (rd == 0) {
+            if (!wait)
+                return 0;
+            waited += EBB_PIPELINE_POLL_MS;
+            if (waited > pl->timeout_ms) {
+                const ebb_pipeline_slot_t *slot = &pl->slots[pl->head];
+                LOGE (
+                    "Контролер не відповів на '%s' (блок №%lu, непідтверджених %zu)", slot->cmd,
+                    slot->tag, pl->count);
+                pl->failed = true;
+                pl->failed_tag = slot->tag;
+                return -1;
+            }
+            continue;
+        }
+        for (ssize_t i = 0; i < rd; ++i) {
+            char ch = buf[i];
+            if (ch == '\r' || ch == '\n')
+                ebb_pipeline_consume_line (pl);
+            else if (pl->line_len + 1 < sizeof (pl->line))
+                pl->line[pl->line_len++] = ch;
+        }
+        if (wait && pl->count < before)
+            return 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Записує готову команду в конвеєр, дотримуючись бюджету `depth`.
+ * @return 0 — записано; -1 — помилка.
+ */
+static int ebb_pipeline_submit (ebb_pipeline_t *pl, unsigned long tag, const char *cmd) {
+    if (pl->failed)
+        return -1;
+    uint64_t wait_start = pl->count >= pl->depth ? telemetry_now () : 0;
+    while (pl->count >= pl->depth) {
+        if (ebb_pipeline_pump (pl, true) != 0)
+            return -1;
+    }
+    telemetry_wait (TELEMETRY_WAIT_FIFO, wait_start);
+    if (pl->failed)
+        return -1;
+
+    TRACE_LOG (TRACE_EBB_PIPE_SEND, cmd, tag, pl->count);
+    size_t in_flight = pl->count - pl->unsent;
+    if (serial_queue_line (pl->sp, cmd) != 0) {
+        LOGE ("Не вдалося надіслати команду до контролера");
+        pl->failed = true;
+        pl->failed_tag = tag;
+        return -1;
+    }
+    ebb_pipeline_slot_t *slot = &pl->slots[(pl->head + pl->count) % EBB_PIPELINE_MAX];
+    slot->tag = tag;
+    slot->sent_at = telemetry_now ();
+    snprintf (slot->cmd, sizeof (slot->cmd), "%s", cmd);
+    ++pl->count;
+    ++pl->unsent;
+    ++pl->sent;
+    /* Контролер без роботи чекає на цю команду; інакше — накопичуємо пакет. */
+    if ((in_flight == 0 || pl->unsent >= EBB_PIPELINE_BATCH || pl->count >= pl->depth)
+        && ebb_pipeline_flush (pl) != 0)
+        return -1;
+
+    if (ebb_pipeline_pump (pl, false) != 0)
+        return -1;
+    if (pl->count == pl->unsent && ebb_pipeline_flush (pl) != 0)
+        return -1;
+    return pl->failed ? -1 : 0;
+}
+
+/** @copydoc ebb_pipeline_move_lowlevel_steps */
+int ebb_pipeline_move_lowlevel_steps (
+    ebb_pipeline_t *pl,
+    unsigned long tag,
+    uint32_t rate1,
+    int32_t steps1,
+    int32_t accel1,
+    uint32_t rate2,
+    int32_t steps2,
+    int32_t accel2,
+    int clear_flags) {
+    if (!pl || !pl->sp)
+        return -1;
+    char cmd[EBB_CMD_MAX];
+    if (ebb_format_lowlevel_steps (
+            cmd, sizeof (cmd), rate1, steps1, accel1, rate2, steps2, accel2, clear_flags)
+        != 0)
+        return -1;
+    return ebb_pipeline_submit (pl, tag, cmd);
+}
+
+/** @copydoc ebb_pipeline_pen_set */
+int ebb_pipeline_pen_set (
+    ebb_pipeline_t *pl, unsigned long tag, bool pen_up, int settle_ms, int portb_pin) {
+    if (!pl || !pl->sp)
+        return -1;
+    char cmd[EBB_CMD_MAX];
+    if (ebb_format_pen_set (cmd, sizeof (cmd), pen_up, settle_ms, portb_pin) != 0)
+        return -1;
+    return ebb_pipeline_submit (pl, tag, cmd);
+}
+
+/** @copydoc ebb_pipeline_drain */
+int ebb_pipeline_drain (ebb_pipeline_t *pl) {
+    if (!pl)
+        return -1;
+    while (pl->count > 0) {
+        if (ebb_pipeline_pump (pl, true) != 0) {
+            ebb_pipeline_abandon (pl);
+            return -1;
+        }
+    }
+    return pl->failed ? -1 : 0;
+}
+
+/** @copydoc ebb_pipeline_abandon */
+void ebb_pipeline_abandon (ebb_pipeline_t *pl) {
+    if (!pl)
+        return;
+    pl->head = 0;
+    pl->count = 0;
+    pl->unsent = 0;
+    pl->line_len = 0;
+}
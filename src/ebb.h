@@ -49,6 +49,98 @@ typedef struct {
     int fifo_pending;   /**< Кількість команд у черзі FIFO (якщо повідомляється). */
 } ebb_motion_status_t;
 
+/** Максимальна кількість непідтверджених команд у конвеєрі. */
+#define EBB_PIPELINE_MAX 16
+
+/** Скільки команд конвеєра накопичується для одного запису, поки контролер зайнятий. */
+#define EBB_PIPELINE_BATCH 4
+
+/** Максимальна довжина команди, що зберігається для діагностики конвеєра. */
+#define EBB_PIPELINE_CMD_MAX 64
+
+/**
+ * @brief Команда, надіслана без очікування відповіді.
+ */
+typedef struct {
+    unsigned long tag;              /**< Мітка джерела (номер блоку плану). */
+    char cmd[EBB_PIPELINE_CMD_MAX]; /**< Текст команди (для журналу помилок). */
+    uint64_t sent_at;               /**< Мітка постановки в порт для телеметрії (0 — без неї). */
+} ebb_pipeline_slot_t;
+
+/**
+ * @brief Конвеєр команд: запис підряд без очікування OK на кожну.
+ * @details Відповіді EBB надходять у порядку команд, тож кожен OK/ERR зіставляється з
+ *          найстарішою непідтвердженою командою. Запис блокується лише тоді, коли
+ *          непідтверджених команд `depth`; решта відповідей дочитується без очікування.
+ *          Поки контролер ще не підтвердив раніше записані команди, нові накопичуються
+ *          в буфері передачі порту й ідуть одним записом по `EBB_PIPELINE_BATCH`; якщо ж
+ *          усе записане вже підтверджено, команда записується одразу.
+ */
+typedef struct {
+    serial_port_t *sp;                           /**< Порт. */
+    int timeout_ms;                              /**< Тайм-аут очікування відповіді (мс). */
+    size_t depth;                                /**< Бюджет непідтверджених команд. */
+    ebb_pipeline_slot_t slots[EBB_PIPELINE_MAX]; /**< Кільце непідтверджених команд. */
+    size_t head;                                 /**< Найстаріша команда. */
+    size_t count;                                /**< Кількість непідтверджених команд. */
+    size_t unsent;                               /**< З них ще у буфері передачі порту. */
+    char line[128];                              /**< Незавершений рядок відповіді. */
+    size_t line_len;                             /**< Довжина `line`. */
+    bool failed;                                 /**< Отримано ERR або втрачено синхронізацію. */
+    unsigned long failed_tag;                    /**< Мітка команди, що спричинила помилку. */
+    unsigned long sent;                          /**< Надіслано команд. */
+    unsigned long acked;                         /**< Підтверджено команд. */
+    unsigned long acked_tag;                     /**< Мітка останньої підтвердженої команди. */
+} ebb_pipeline_t;
+
+/**
+ * @brief Ініціалізує конвеєр команд для порту.
+ * @param pl [out] Конвеєр.
+ * @param sp Відкритий порт EBB.
+ * @param depth Бюджет непідтверджених команд (0 або > EBB_PIPELINE_MAX — максимум).
+ * @param timeout_ms Тайм-аут очікування відповіді (мс).
+ */
+void ebb_pipeline_init (ebb_pipeline_t *pl, serial_port_t *sp, size_t depth, int timeout_ms);
+
+/**
+ * @brief Надсилає LM через конвеєр (параметри як у `ebb_move_lowlevel_steps`).
+ * @param pl Конвеєр.
+ * @param tag Мітка джерела (номер блоку) для діагностики.
+ * @return 0 — команду записано; -1 — помилка параметрів, запису або попередня ERR.
+ */
+int ebb_pipeline_move_lowlevel_steps (
+    ebb_pipeline_t *pl,
+    unsigned long tag,
+    uint32_t rate1,
+    int32_t steps1,
+    int32_t accel1,
+    uint32_t rate2,
+    int32_t steps2,
+    int32_t accel2,
+    int clear_flags);
+
+/**
+ * @brief Надсилає SP через конвеєр (параметри як у `ebb_pen_set`).
+ * @param pl Конвеєр.
+ * @param tag Мітка джерела (номер блоку).
+ * @return 0 — команду записано; -1 — помилка.
+ */
+int ebb_pipeline_pen_set (
+    ebb_pipeline_t *pl, unsigned long tag, bool pen_up, int settle_ms, int portb_pin);
+
+/**
+ * @brief Очікує підтвердження всіх надісланих команд.
+ * @param pl Конвеєр.
+ * @return 0 — усі OK; -1 — була помилка (див. `failed_tag`) або тайм-аут.
+ */
+int ebb_pipeline_drain (ebb_pipeline_t *pl);
+
+/**
+ * @brief Відкидає облік непідтверджених команд (після аварійної зупинки).
+ * @param pl Конвеєр.
+ */
+void ebb_pipeline_abandon (ebb_pipeline_t *pl);
+
 /**
  * @brief Увімкнути мотори з режимами мікрокроку.
  * @param sp Відкритий порт EBB.
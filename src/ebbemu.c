@@ -0,0 +1,381 @@
+/**
+ * @file ebbemu.c
+ * @brief Реалізація емулятора EBB на парі сокетів.
+ * @ingroup ebbemu
+ */
+#include "ebbemu.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+
+/** Найбільша глибина FIFO емулятора. */
+#define EBBEMU_FIFO_MAX 64
+/** Період таймера LowLevelMove, мс (40 мкс). */
+#define EBBEMU_LL_INTERVAL_MS 0.04
+/** Крок сну, після якого перевіряється запит зупинки, мс. */
+#define EBBEMU_SLEEP_SLICE_MS 20.0
+/** Найдовша команда (з завершальним нулем), байт. */
+#define EBBEMU_LINE_MAX 256
+/** Запас відповіді понад відлуння команди, байт. */
+#define EBBEMU_REPLY_EXTRA 64
+/** Рядок версії, яким відповідає емулятор. */
+#define EBBEMU_VERSION "EBBv13_and_above EB Firmware Version 2.8.1 (cplot emu)"
+
+/**
+ * @brief Стан емулятора.
+ */
+struct ebbemu_s {
+    ebbemu_config_t cfg;                 /**< Параметри. */
+    int fd;                              /**< Кінець пари сокетів на боці емулятора. */
+    pthread_t thread;                    /**< Потік обробки команд. */
+    bool stop;                           /**< Запит зупинки. */
+    double done_at_ms[EBBEMU_FIFO_MAX];  /**< Кінець виконання команд у черзі, мс. */
+    size_t head;                         /**< Найстаріша команда черги. */
+    size_t count;                        /**< Команд у черзі (включно з поточною). */
+    double tail_ms;                      /**< Кінець виконання останньої команди. */
+    long long steps1;                    /**< Позиція мотора 1, кроки. */
+    long long steps2;                    /**< Позиція мотора 2, кроки. */
+    bool pen_up;                         /**< Стан пера. */
+    uint32_t rng;                        /**< Стан генератора джитера. */
+    unsigned long commands;              /**< Оброблено команд. */
+    double motion_ms;                    /**< Сумарна тривалість руху, мс. */
+};
+
+/** @copydoc ebbemu_is_path */
+bool ebbemu_is_path (const char *path) {
+    return path && strncmp (path, EBBEMU_PREFIX, strlen (EBBEMU_PREFIX)) == 0;
+}
+
+/** @copydoc ebbemu_parse_config */
+int ebbemu_parse_config (const char *spec, ebbemu_config_t *out) {
+    if (!out)
+        return -1;
+    out->latency_ms = 1.0;
+    out->jitter_ms = 0.0;
+    out->fifo_depth = 1;
+    out->speed = 1.0;
+    out->seed = 1;
+    if (!spec || !spec[0])
+        return 0;
+    char buf[256];
+    snprintf (buf, sizeof (buf), "%s", spec);
+    char *save = NULL;
+    for (char *tok = strtok_r (buf, ",", &save); tok; tok = strtok_r (NULL, ",", &save)) {
+        char *eq = strchr (tok, '=');
+        if (!eq) {
+            LOGE ("емулятор EBB: параметр без значення: %s", tok);
+            return -1;
+        }
+        *eq = '\0';
+        char *end = NULL;
+        double v = strtod (eq + 1, &end);
+        if (!end || *end != '\0' || !(v >= 0.0) || !isfinite (v)) {
+            LOGE ("емулятор EBB: некоректне значення %s=%s", tok, eq + 1);
+            return -1;
+        }
+        if (strcmp (tok, "latency") == 0)
+            out->latency_ms = v;
+        else if (strcmp (tok, "jitter") == 0)
+            out->jitter_ms = v;
+        else if (strcmp (tok, "fifo") == 0 && v >= 1.0 && v < EBBEMU_FIFO_MAX)
+            out->fifo_depth = (size_t)v;
+        else if (strcmp (tok, "speed") == 0 && v > 0.0)
+            out->speed = v;
+        else if (strcmp (tok, "seed") == 0)
+            out->seed = (unsigned)v;
+        else {
+            LOGE ("емулятор EBB: невідомий або некоректний параметр %s=%s", tok, eq + 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** \brief Монотонний час, мс. */
+static double ebbemu_now_ms (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/** \brief Спить до моменту `until_ms`, перериваючись на запит зупинки. */
+static void ebbemu_sleep_until (ebbemu_t *emu, double until_ms) {
+    for (;;) {
+        if (__atomic_load_n (&emu->stop, __ATOMIC_ACQUIRE))
+            return;
+        double left = until_ms - ebbemu_now_ms ();
+        if (left <= 0.0)
+            return;
+        if (left > EBBEMU_SLEEP_SLICE_MS)
+            left = EBBEMU_SLEEP_SLICE_MS;
+        struct timespec ts = {
+            .tv_sec = 0,
+            .tv_nsec = (long)(left * 1e6),
+        };
+        nanosleep (&ts, NULL);
+    }
+}
+
+/** \brief Випадкове число з [0, 1) (xorshift32). */
+static double ebbemu_random (ebbemu_t *emu) {
+    uint32_t x = emu->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    emu->rng = x;
+    return (double)x / 4294967296.0;
+}
+
+/** \brief Прибирає з черги команди, що вже виконались. */
+static void ebbemu_expire (ebbemu_t *emu, double now_ms) {
+    while (emu->count > 0 && emu->done_at_ms[emu->head] <= now_ms) {
+        emu->head = (emu->head + 1) % EBBEMU_FIFO_MAX;
+        --emu->count;
+    }
+}
+
+/**
+ * @brief Ставить команду руху в чергу; за повного FIFO чекає звільнення місця.
+ * @param emu Емулятор.
+ * @param duration_ms Реальна тривалість команди, мс.
+ */
+static void ebbemu_enqueue (ebbemu_t *emu, double duration_ms) {
+    double now = ebbemu_now_ms ();
+    ebbemu_expire (emu, now);
+    while (emu->count > emu->cfg.fifo_depth && !emu->stop) {
+        ebbemu_sleep_until (emu, emu->done_at_ms[emu->head]);
+        now = ebbemu_now_ms ();
+        ebbemu_expire (emu, now);
+    }
+    double scaled = duration_ms / emu->cfg.speed;
+    double start = emu->count > 0 && emu->tail_ms > now ? emu->tail_ms : now;
+    emu->tail_ms = start + scaled;
+    emu->done_at_ms[(emu->head + emu->count) % EBBEMU_FIFO_MAX] = emu->tail_ms;
+    ++emu->count;
+    emu->motion_ms += duration_ms;
+}
+
+/**
+ * @brief Кількість інтервалів LM для осі (та сама модель, що в `axidraw.c`).
+ * @return Інтервали по 40 мкс; 0 — вісь не рухається або ціль недосяжна.
+ */
+static double ebbemu_lm_axis_intervals (double rate, double steps, double accel) {
+    double target = fabs (steps) * 2147483648.0;
+    if (target == 0.0)
+        return 0.0;
+    if (accel == 0.0)
+        return rate > 0.0 ? target / rate : 0.0;
+    double disc = rate * rate + 2.0 * accel * target;
+    if (disc < 0.0)
+        return accel < 0.0 && rate > 0.0 ? -rate / accel : 0.0;
+    double n = (sqrt (disc) - rate) / accel;
+    return n > 0.0 && isfinite (n) ? n : 0.0;
+}
+
+/**
+ * @brief Розбирає числові аргументи команди після назви.
+ * @param args Текст після першої коми (може бути NULL).
+ * @param out [out] Значення.
+ * @param max Ємність `out`.
+ * @return Кількість розібраних значень.
+ */
+static size_t ebbemu_args (const char *args, double *out, size_t max) {
+    size_t n = 0;
+    while (args && *args && n < max) {
+        char *end = NULL;
+        out[n++] = strtod (args, &end);
+        if (!end || *end != ',')
+            break;
+        args = end + 1;
+    }
+    return n;
+}
+
+/** \brief Пише відповідь у сокет повністю. */
+static void ebbemu_reply (ebbemu_t *emu, const char *text) {
+    size_t len = strlen (text);
+    while (len > 0) {
+        ssize_t wr = write (emu->fd, text, len);
+        if (wr < 0 && errno == EINTR)
+            continue;
+        if (wr <= 0)
+            return;
+        text += wr;
+        len -= (size_t)wr;
+    }
+}
+
+/**
+ * @brief Виконує одну команду і надсилає відповідь.
+ * @param emu Емулятор.
+ * @param line Команда без завершального CR/LF.
+ */
+static void ebbemu_command (ebbemu_t *emu, char *line) {
+    ++emu->commands;
+    double delay = emu->cfg.latency_ms + emu->cfg.jitter_ms * ebbemu_random (emu);
+    if (delay > 0.0)
+        ebbemu_sleep_until (emu, ebbemu_now_ms () + delay);
+
+    char *comma = strchr (line, ',');
+    const char *args = comma ? comma + 1 : NULL;
+    if (comma)
+        *comma = '\0';
+    double a[8] = { 0 };
+    size_t n = ebbemu_args (args, a, 8);
+    char reply[EBBEMU_LINE_MAX + EBBEMU_REPLY_EXTRA];
+
+    if (strcmp (line, "LM") == 0 && n >= 6) {
+        double n1 = ebbemu_lm_axis_intervals (a[0], a[1], a[2]);
+        double n2 = ebbemu_lm_axis_intervals (a[3], a[4], a[5]);
+        ebbemu_enqueue (emu, fmax (n1, n2) * EBBEMU_LL_INTERVAL_MS);
+        emu->steps1 += (long long)a[1];
+        emu->steps2 += (long long)a[4];
+    } else if (strcmp (line, "LT") == 0 && n >= 5) {
+        double ticks = a[0];
+        emu->steps1 += llround ((a[1] * ticks + a[2] * ticks * ticks / 2.0) / 2147483648.0);
+        emu->steps2 += llround ((a[3] * ticks + a[4] * ticks * ticks / 2.0) / 2147483648.0);
+        ebbemu_enqueue (emu, ticks * EBBEMU_LL_INTERVAL_MS);
+    } else if ((strcmp (line, "SM") == 0 || strcmp (line, "XM") == 0) && n >= 3) {
+        double s1 = a[1];
+        double s2 = a[2];
+        if (line[0] == 'X') {
+            s1 = a[1] + a[2];
+            s2 = a[1] - a[2];
+        }
+        emu->steps1 += (long long)s1;
+        emu->steps2 += (long long)s2;
+        ebbemu_enqueue (emu, a[0]);
+    } else if (strcmp (line, "HM") == 0 && n >= 1 && a[0] > 0.0) {
+        double t1 = n >= 3 ? a[1] : 0.0;
+        double t2 = n >= 3 ? a[2] : 0.0;
+        double d = fmax (fabs ((double)emu->steps1 - t1), fabs ((double)emu->steps2 - t2));
+        emu->steps1 = (long long)t1;
+        emu->steps2 = (long long)t2;
+        ebbemu_enqueue (emu, d / a[0] * 1000.0);
+    } else if (strcmp (line, "SP") == 0 && n >= 1) {
+        emu->pen_up = a[0] != 0.0;
+        ebbemu_enqueue (emu, n >= 2 ? a[1] : 0.0);
+    } else if (strcmp (line, "ES") == 0) {
+        emu->count = 0;
+        emu->tail_ms = 0.0;
+    } else if (strcmp (line, "CS") == 0) {
+        emu->steps1 = 0;
+        emu->steps2 = 0;
+    } else if (strcmp (line, "QM") == 0) {
+        ebbemu_expire (emu, ebbemu_now_ms ());
+        int active = emu->count > 0;
+        snprintf (
+            reply, sizeof (reply), "QM,%d,%d,%d,%zu\r\nOK\r\n", active, active, active,
+            emu->count > 1 ? emu->count - 1 : 0);
+        ebbemu_reply (emu, reply);
+        return;
+    } else if (strcmp (line, "QS") == 0) {
+        snprintf (reply, sizeof (reply), "%lld,%lld\r\nOK\r\n", emu->steps1, emu->steps2);
+        ebbemu_reply (emu, reply);
+        return;
+    } else if (strcmp (line, "QP") == 0) {
+        ebbemu_reply (emu, emu->pen_up ? "1\r\nOK\r\n" : "0\r\nOK\r\n");
+        return;
+    } else if (strcmp (line, "QR") == 0) {
+        ebbemu_reply (emu, "1\r\nOK\r\n");
+        return;
+    } else if (strcmp (line, "V") == 0) {
+        ebbemu_reply (emu, EBBEMU_VERSION "\r\n");
+        return;
+    } else if (strcmp (line, "LM") == 0 || strcmp (line, "LT") == 0 || strcmp (line, "SM") == 0
+               || strcmp (line, "XM") == 0 || strcmp (line, "SP") == 0) {
+        snprintf (reply, sizeof (reply), "!8 Err: %s: замало параметрів\r\n", line);
+        ebbemu_reply (emu, reply);
+        return;
+    }
+    ebbemu_reply (emu, "OK\r\n");
+}
+
+/** \brief Потік емулятора: читає команди до закриття порту або зупинки. */
+static void *ebbemu_main (void *arg) {
+    ebbemu_t *emu = (ebbemu_t *)arg;
+    char line[EBBEMU_LINE_MAX];
+    size_t len = 0;
+    char buf[256];
+    while (!__atomic_load_n (&emu->stop, __ATOMIC_ACQUIRE)) {
+        ssize_t rd = read (emu->fd, buf, sizeof (buf));
+        if (rd < 0 && errno == EINTR)
+            continue;
+        if (rd <= 0)
+            break;
+        for (ssize_t i = 0; i < rd; ++i) {
+            char ch = buf[i];
+            if (ch == '\r' || ch == '\n') {
+                if (len == 0)
+                    continue;
+                line[len] = '\0';
+                len = 0;
+                ebbemu_command (emu, line);
+            } else if (len + 1 < sizeof (line)) {
+                line[len++] = ch;
+            }
+        }
+    }
+    return NULL;
+}
+
+/** @copydoc ebbemu_start */
+ebbemu_t *ebbemu_start (const char *path, int *fd_out) {
+    if (!ebbemu_is_path (path) || !fd_out)
+        return NULL;
+    ebbemu_t *emu = (ebbemu_t *)calloc (1, sizeof (*emu));
+    if (!emu)
+        return NULL;
+    if (ebbemu_parse_config (path + strlen (EBBEMU_PREFIX), &emu->cfg) != 0) {
+        free (emu);
+        return NULL;
+    }
+    emu->rng = emu->cfg.seed ? emu->cfg.seed : 1u;
+    emu->pen_up = true;
+    int sv[2];
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        LOGE ("емулятор EBB: socketpair: %s", strerror (errno));
+        free (emu);
+        return NULL;
+    }
+    emu->fd = sv[1];
+    if (pthread_create (&emu->thread, NULL, ebbemu_main, emu) != 0) {
+        LOGE ("емулятор EBB: не вдалося запустити потік");
+        close (sv[0]);
+        close (sv[1]);
+        free (emu);
+        return NULL;
+    }
+    int flags = fcntl (sv[0], F_GETFL, 0);
+    fcntl (sv[0], F_SETFL, flags | O_NONBLOCK);
+    *fd_out = sv[0];
+    LOGI (
+        "емулятор EBB: затримка %.2f±%.2f мс, FIFO %zu, швидкість ×%.2f", emu->cfg.latency_ms,
+        emu->cfg.jitter_ms, emu->cfg.fifo_depth, emu->cfg.speed);
+    return emu;
+}
+
+/** @copydoc ebbemu_stop */
+void ebbemu_stop (ebbemu_t *emu) {
+    if (!emu)
+        return;
+    __atomic_store_n (&emu->stop, true, __ATOMIC_RELEASE);
+    shutdown (emu->fd, SHUT_RDWR);
+    pthread_join (emu->thread, NULL);
+    close (emu->fd);
+    LOGI (
+        "емулятор EBB: команд %lu, рух %.3f с (реального часу)", emu->commands,
+        emu->motion_ms / 1000.0);
+    free (emu);
+}
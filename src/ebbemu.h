@@ -0,0 +1,79 @@
+/**
+ * @file ebbemu.h
+ * @brief Емулятор контролера EBB у процесі — порт `emu:` для тестів без плотера.
+ * @defgroup ebbemu Емулятор EBB
+ * @ingroup device
+ * @details
+ * `serial_open ("emu:…")` замість пристрою створює пару сокетів і потік емулятора: решта
+ * стеку (`serial.c`, `ebb.c`, FIFO AxiDraw, конвеєр команд) працює з дескриптором так
+ * само, як із tty. Емулятор розбирає команди EBB, веде FIFO глибини `fifo` з тривалостями
+ * руху в реальному часі (LM/LT/SM/XM/HM — за параметрами кроків, SP — за затримкою
+ * пера) і відповідає із затримкою `latency` плюс випадкове `jitter`. Команда руху при
+ * повному FIFO, як і справжня плата, підтверджується лише після звільнення місця.
+ *
+ * Параметри — після `emu:` через кому: `latency=МС`, `jitter=МС`, `fifo=N`,
+ * `speed=K` (рух у K разів швидший за реальний), `seed=N`. Наприклад,
+ * `emu:latency=1.5,jitter=0.5,fifo=3,speed=10`. Відповіді на запити (QM, QS, QP, QR)
+ * мають форму, яку очікує `ebb.c`: рядок даних і `OK`; `V` — рядок версії.
+ */
+#ifndef CPLOT_EBBEMU_H
+#define CPLOT_EBBEMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Префікс шляху порту емулятора. */
+#define EBBEMU_PREFIX "emu:"
+
+/**
+ * @brief Параметри емулятора.
+ */
+typedef struct {
+    double latency_ms;  /**< Затримка відповіді на кожну команду, мс. */
+    double jitter_ms;   /**< Найбільша випадкова добавка до затримки, мс. */
+    size_t fifo_depth;  /**< Команд руху в черзі понад ту, що виконується. */
+    double speed;       /**< Прискорення часу руху (1 — реальний час). */
+    unsigned seed;      /**< Зерно генератора джитера. */
+} ebbemu_config_t;
+
+/** Непрозорий стан запущеного емулятора. */
+typedef struct ebbemu_s ebbemu_t;
+
+/**
+ * @brief Чи вказує шлях на емулятор.
+ * @param path Шлях порту.
+ * @return true — шлях починається з `EBBEMU_PREFIX`.
+ */
+bool ebbemu_is_path (const char *path);
+
+/**
+ * @brief Розбирає параметри емулятора (частина шляху після `emu:`).
+ * @param spec Рядок `ключ=значення,…` (NULL або порожній — типові).
+ * @param out [out] Параметри.
+ * @return 0 — успіх; -1 — невідомий ключ або некоректне значення.
+ */
+int ebbemu_parse_config (const char *spec, ebbemu_config_t *out);
+
+/**
+ * @brief Запускає емулятор.
+ * @param path Шлях `emu:…`.
+ * @param fd_out [out] Дескриптор «порту» для `serial_port_t` (неблокуючий).
+ * @return Емулятор або NULL (некоректні параметри чи помилка ресурсів).
+ */
+ebbemu_t *ebbemu_start (const char *path, int *fd_out);
+
+/**
+ * @brief Зупиняє емулятор після закриття дескриптора порту й звільняє стан.
+ * @param emu Емулятор (NULL — no-op).
+ */
+void ebbemu_stop (ebbemu_t *emu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
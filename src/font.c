@@ -5,153 +5,18 @@
  */
 
 #include "font.h"
+#include "fontcache.h"
 #include "str.h"
 #include "text.h"
 
-#include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <stdbool.h>
 
-/**
- * @brief Гарантує ємність масиву точок для додавання елементів.
- * @param pts [in,out] Масив точок (realloc за потреби).
- * @param cap [in,out] Поточна ємність масиву.
- * @param needed Потрібна загальна кількість елементів.
- * @return 0 — успіх, -1 — помилка виділення/аргументи.
- */
-static int font_ensure_point_capacity (geom_point_t **pts, size_t *cap, size_t needed) {
-    if (!pts || !cap)
-        return -1;
-    if (*cap >= needed)
-        return 0;
-    size_t new_cap = (*cap == 0) ? 8 : *cap;
-    while (new_cap < needed)
-        new_cap *= 2;
-    geom_point_t *resized = (geom_point_t *)realloc (*pts, new_cap * sizeof (*resized));
-    if (!resized)
-        return -1;
-    *pts = resized;
-    *cap = new_cap;
-    return 0;
-}
-
-/**
- * @brief Додає точку у кінець масиву (із розширенням за потреби).
- * @param pts [in,out] Масив точок.
- * @param len [in,out] Поточна довжина масиву.
- * @param cap [in,out] Поточна ємність масиву.
- * @param x Координата X.
- * @param y Координата Y.
- * @return 0 — успіх, -1 — помилка.
- */
-static int font_append_point (geom_point_t **pts, size_t *len, size_t *cap, double x, double y) {
-    if (font_ensure_point_capacity (pts, cap, *len + 1) != 0)
-        return -1;
-    (*pts)[*len].x = x;
-    (*pts)[*len].y = y;
-    (*len)++;
-    return 0;
-}
-
-/**
- * @brief Розбирає SVG path data (M/L/Z) у полілінії та додає до вихідних шляхів.
- * @param d Рядок атрибута 'd' SVG.
- * @param origin_x Початковий X у одиницях шрифту.
- * @param baseline_y Базова лінія в мм.
- * @param scale Масштаб одиниць шрифту до мм.
- * @param out [out] Вихідні шляхи (GEOM_UNITS_MM).
- * @return 0 — успіх, -1 — помилка розбору.
- */
-static int font_emit_path_data (
-    const char *d, double origin_x, double baseline_y, double scale, geom_paths_t *out) {
-    if (!d || !out)
-        return 0;
-
-    geom_point_t *pts = NULL;
-    size_t len = 0;
-    size_t cap = 0;
-    int rc = 0;
-    bool have_path = false;
-
-    const char *p = d;
-    while (*p) {
-        while (*p && isspace ((unsigned char)*p))
-            ++p;
-        char cmd = *p;
-        if (!cmd)
-            break;
-        ++p;
-        if (cmd != 'M' && cmd != 'L' && cmd != 'm' && cmd != 'l' && cmd != 'Z' && cmd != 'z')
-            continue;
-        if (cmd == 'Z' || cmd == 'z') {
-            if (have_path && len >= 2) {
-                if (geom_paths_push_path (out, pts, len) != 0) {
-                    rc = -1;
-                    break;
-                }
-            }
-            len = 0;
-            have_path = false;
-            continue;
-        }
-        while (*p && isspace ((unsigned char)*p))
-            ++p;
-        char *endptr = NULL;
-        double raw_x = strtod (p, &endptr);
-        if (endptr == p) {
-            rc = -1;
-            break;
-        }
-        p = endptr;
-        while (*p && isspace ((unsigned char)*p))
-            ++p;
-        double raw_y = strtod (p, &endptr);
-        if (endptr == p) {
-            rc = -1;
-            break;
-        }
-        p = endptr;
-        double x_mm = (origin_x + raw_x) * scale;
-        double y_mm = (baseline_y - raw_y) * scale;
-
-        if (cmd == 'M' || cmd == 'm') {
-            if (have_path && len >= 2) {
-                if (geom_paths_push_path (out, pts, len) != 0) {
-                    rc = -1;
-                    break;
-                }
-            }
-            len = 0;
-            have_path = true;
-            if (font_append_point (&pts, &len, &cap, x_mm, y_mm) != 0) {
-                rc = -1;
-                break;
-            }
-        } else {
-            if (!have_path) {
-                have_path = true;
-                len = 0;
-            }
-            if (font_append_point (&pts, &len, &cap, x_mm, y_mm) != 0) {
-                rc = -1;
-                break;
-            }
-        }
-    }
-
-    if (rc == 0 && have_path && len >= 2) {
-        if (geom_paths_push_path (out, pts, len) != 0)
-            rc = -1;
-    }
-
-    free (pts);
-    return rc;
-}
-
 /**
  * @brief Внутрішнє представлення шрифту Hershey (SVG-файл + кеш гліфів).
  */
@@ -161,12 +26,48 @@ struct font {
     char *id;
     char *family;
     font_metrics_t metrics;
-    glyph_t **glyphs;
-    uint32_t *glyph_codes;
+    glyph_t **glyphs;      /**< Гліфи, відсортовані за кодовою точкою. */
+    uint32_t *glyph_codes; /**< Кодові точки (паралельно до glyphs, за зростанням). */
     size_t glyph_count;
+    size_t glyph_cap;
     bool glyphs_loaded;
+    char *source_path;       /**< Шлях до SVG (ключ кешу). */
+    fontcache_entry_t cache; /**< Відкритий бінарний кеш (map != NULL — шрифт із кешу). */
+    unsigned refcount;       /**< Кількість власників дескриптора (див. `font_acquire`). */
 };
 
+/**
+ * @brief Процесний реєстр спільних шрифтів (ключ — шлях до файлу обличчя).
+ * @details Реєстр тримає власне посилання на кожен шрифт, тож повторні
+ *          `font_render_context_init` для того самого обличчя не перечитують SVG.
+ */
+static font_t **g_shared_fonts = NULL;
+static size_t g_shared_font_count = 0;
+static size_t g_shared_font_cap = 0;
+
+/**
+ * @brief Рекурсивний замок реєстру спільних шрифтів і ледачого розбору гліфів.
+ * @details Рекурсивний, бо `font_acquire` при помилці завантаження звільняє шрифт
+ *          через `font_release`.
+ */
+static pthread_mutex_t g_shared_fonts_lock;
+static pthread_once_t g_shared_fonts_lock_once = PTHREAD_ONCE_INIT;
+
+static void font_shared_lock_init (void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init (&attr);
+    pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init (&g_shared_fonts_lock, &attr);
+    pthread_mutexattr_destroy (&attr);
+}
+
+static void font_shared_lock (void) {
+    pthread_once (&g_shared_fonts_lock_once, font_shared_lock_init);
+    pthread_mutex_lock (&g_shared_fonts_lock);
+}
+
+static void font_shared_unlock (void) { pthread_mutex_unlock (&g_shared_fonts_lock); }
+
 /**
  * @brief Коефіцієнт переведення пунктів (pt) у задані одиниці (мм/дюйми).
  * @param units Цільові одиниці геометрії.
@@ -197,7 +98,7 @@ int font_render_context_init (
     if (size_pt <= 0.0)
         size_pt = 14.0;
 
-    if (font_load_from_file (face->path, &ctx->font) != 0)
+    if (font_acquire (face->path, &ctx->font) != 0)
         return -1;
     if (font_get_metrics (ctx->font, &ctx->metrics) != 0 || !(ctx->metrics.units_per_em > 0.0)) {
         font_release (ctx->font);
@@ -557,56 +458,6 @@ font_set_string_field (char **field, const char *segment, size_t seg_len, const
     return 0;
 }
 
-/**
- * @brief Декодує одну UTF-8 кодову точку.
- * @param input Вхідний байтовий рядок.
- * @param out_cp [out] Декодована кодова точка.
- * @param out_len [out] Спожита кількість байтів.
- * @return 0 — успіх; -1 — недійсна послідовність; -2 — некоректні аргументи.
- */
-static int font_decode_utf8_char (const char *input, uint32_t *out_cp, size_t *out_len) {
-    if (!input || !out_cp)
-        return -2;
-    const unsigned char *s = (const unsigned char *)input;
-    if (s[0] == '\0')
-        return -1;
-    uint32_t cp = 0;
-    size_t used = 0;
-    if ((s[0] & 0x80) == 0) {
-        cp = s[0];
-        used = 1;
-    } else if ((s[0] & 0xE0) == 0xC0) {
-        if ((s[1] & 0xC0) != 0x80)
-            return -1;
-        cp = ((uint32_t)(s[0] & 0x1F) << 6) | (uint32_t)(s[1] & 0x3F);
-        used = 2;
-        if (cp < 0x80)
-            return -1;
-    } else if ((s[0] & 0xF0) == 0xE0) {
-        if ((s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80)
-            return -1;
-        cp = ((uint32_t)(s[0] & 0x0F) << 12) | ((uint32_t)(s[1] & 0x3F) << 6)
-             | (uint32_t)(s[2] & 0x3F);
-        used = 3;
-        if (cp < 0x800)
-            return -1;
-    } else if ((s[0] & 0xF8) == 0xF0) {
-        if ((s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80)
-            return -1;
-        cp = ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12)
-             | ((uint32_t)(s[2] & 0x3F) << 6) | (uint32_t)(s[3] & 0x3F);
-        used = 4;
-        if (cp < 0x10000 || cp > 0x10FFFF)
-            return -1;
-    } else {
-        return -1;
-    }
-    if (out_len)
-        *out_len = used;
-    *out_cp = cp;
-    return 0;
-}
-
 /**
  * @brief Парсить кодову точку з HTML entity або UTF-8 символу.
  * @param value Рядок значення (напр., "&#x2014;" або "—").
@@ -642,7 +493,7 @@ static int font_parse_codepoint (const char *value, uint32_t *out_cp) {
         return 0;
     } else {
         uint32_t cp = 0;
-        if (font_decode_utf8_char (value, &cp, NULL) != 0)
+        if (str_utf8_decode (value, &cp, NULL) != 0)
             return -1;
         *out_cp = cp;
         return 0;
@@ -650,41 +501,141 @@ static int font_parse_codepoint (const char *value, uint32_t *out_cp) {
 }
 
 /**
- * @brief Додає гліф і кодову точку до таблиці шрифту.
+ * @brief Додає гліф і кодову точку до таблиці шрифту (амортизоване зростання).
  * @return 0 — успіх; -1 — помилка памʼяті.
  */
 static int font_append_glyph_entry (font_t *font, glyph_t *glyph, uint32_t codepoint) {
-    size_t new_count = font->glyph_count + 1;
-    glyph_t **glyphs = (glyph_t **)malloc (new_count * sizeof (*glyphs));
-    if (!glyphs)
-        return -1;
-    uint32_t *codes = (uint32_t *)malloc (new_count * sizeof (*codes));
-    if (!codes) {
-        free (glyphs);
+    if (font->glyph_count == font->glyph_cap) {
+        size_t new_cap = (font->glyph_cap == 0) ? 64 : font->glyph_cap * 2;
+        glyph_t **glyphs = (glyph_t **)realloc (font->glyphs, new_cap * sizeof (*glyphs));
+        if (!glyphs)
+            return -1;
+        font->glyphs = glyphs;
+        uint32_t *codes = (uint32_t *)realloc (font->glyph_codes, new_cap * sizeof (*codes));
+        if (!codes)
+            return -1;
+        font->glyph_codes = codes;
+        font->glyph_cap = new_cap;
+    }
+    font->glyphs[font->glyph_count] = glyph;
+    font->glyph_codes[font->glyph_count] = codepoint;
+    font->glyph_count++;
+    return 0;
+}
+
+/**
+ * @brief Запис тимчасового індексу для сортування гліфів.
+ */
+typedef struct {
+    uint32_t codepoint; /**< Кодова точка. */
+    size_t order;       /**< Порядковий номер у SVG (для стабільності). */
+    glyph_t *glyph;     /**< Гліф. */
+} font_index_entry_t;
+
+/** \brief Порівняння записів індексу: кодова точка, потім порядок у файлі. */
+static int font_index_entry_cmp (const void *a, const void *b) {
+    const font_index_entry_t *ea = (const font_index_entry_t *)a;
+    const font_index_entry_t *eb = (const font_index_entry_t *)b;
+    if (ea->codepoint != eb->codepoint)
+        return (ea->codepoint < eb->codepoint) ? -1 : 1;
+    if (ea->order != eb->order)
+        return (ea->order < eb->order) ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief Будує відсортований індекс кодових точок і прибирає дублікати.
+ * @details Для повторних кодових точок зберігається перший гліф у порядку файлу,
+ *          решта звільняється. Після виклику `glyph_codes` відсортовано за зростанням.
+ * @param font Обʼєкт шрифту.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int font_build_glyph_index (font_t *font) {
+    if (font->glyph_count < 2)
+        return 0;
+    font_index_entry_t *entries
+        = (font_index_entry_t *)malloc (font->glyph_count * sizeof (*entries));
+    if (!entries)
         return -1;
+    for (size_t i = 0; i < font->glyph_count; ++i) {
+        entries[i].codepoint = font->glyph_codes[i];
+        entries[i].order = i;
+        entries[i].glyph = font->glyphs[i];
     }
-    if (font->glyph_count > 0) {
-        memcpy (glyphs, font->glyphs, font->glyph_count * sizeof (*glyphs));
-        memcpy (codes, font->glyph_codes, font->glyph_count * sizeof (*codes));
+    qsort (entries, font->glyph_count, sizeof (*entries), font_index_entry_cmp);
+    size_t unique = 0;
+    for (size_t i = 0; i < font->glyph_count; ++i) {
+        if (unique > 0 && font->glyph_codes[unique - 1] == entries[i].codepoint) {
+            glyph_release (entries[i].glyph);
+            continue;
+        }
+        font->glyph_codes[unique] = entries[i].codepoint;
+        font->glyphs[unique] = entries[i].glyph;
+        unique++;
     }
-    glyphs[font->glyph_count] = glyph;
-    codes[font->glyph_count] = codepoint;
-    free (font->glyphs);
-    free (font->glyph_codes);
-    font->glyphs = glyphs;
-    font->glyph_codes = codes;
-    font->glyph_count = new_count;
+    font->glyph_count = unique;
+    free (entries);
     return 0;
 }
 
+/**
+ * @brief Бінарний пошук позиції кодової точки у відсортованому індексі.
+ * @return Індекс у `glyph_codes` або SIZE_MAX, якщо кодової точки немає.
+ */
+static size_t font_index_lookup (const font_t *font, uint32_t codepoint) {
+    size_t lo = 0;
+    size_t hi = font->glyph_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t code = font->glyph_codes[mid];
+        if (code == codepoint)
+            return mid;
+        if (code < codepoint)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return SIZE_MAX;
+}
+
+/**
+ * @brief Створює гліфи з відкритого бінарного кешу і закриває його.
+ * @param font Обʼєкт шрифту з `cache.map != NULL`.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int font_load_glyphs_from_cache (font_t *font) {
+    const fontcache_entry_t *entry = &font->cache;
+    for (size_t i = 0; i < entry->glyph_count; ++i) {
+        glyph_outline_t outline;
+        if (fontcache_glyph_outline (entry, i, &outline) != 0)
+            continue;
+        const fontcache_glyph_t *cg = &entry->glyphs[i];
+        glyph_t *glyph = NULL;
+        if (glyph_create_from_outline (cg->codepoint, cg->advance_width, &outline, &glyph) != 0)
+            return -1;
+        if (font_append_glyph_entry (font, glyph, cg->codepoint) != 0) {
+            glyph_release (glyph);
+            return -1;
+        }
+    }
+    fontcache_close (&font->cache);
+    return font_build_glyph_index (font);
+}
+
 /**
  * @brief Ліниво завантажує гліфи з SVG у внутрішні структури.
  * @param font Обʼєкт шрифту.
  * @return 0 — успіх; -1 — помилка.
  */
-static int font_ensure_glyphs_loaded (font_t *font) {
+static int font_load_glyphs (font_t *font) {
     if (font->glyphs_loaded)
         return 0;
+    if (font->cache.map) {
+        if (font_load_glyphs_from_cache (font) != 0)
+            return -1;
+        __atomic_store_n (&font->glyphs_loaded, true, __ATOMIC_RELEASE);
+        return 0;
+    }
     const char *cursor = font->svg_data;
     while (cursor && *cursor) {
         const char *glyph_tag = strstr (cursor, "<glyph");
@@ -706,13 +657,6 @@ static int font_ensure_glyphs_loaded (font_t *font) {
             continue;
         }
         free (unicode_val);
-        bool duplicate = false;
-        for (size_t i = 0; i < font->glyph_count; ++i) {
-            if (font->glyph_codes[i] == codepoint) {
-                duplicate = true;
-                break;
-            }
-        }
         double adv = font_parse_double_with_default (
             glyph_tag, seg_len, "horiz-adv-x=", font->metrics.units_per_em);
         char *path_val = NULL;
@@ -720,7 +664,7 @@ static int font_ensure_glyphs_loaded (font_t *font) {
         if (font_extract_attribute (glyph_tag, seg_len, "d=", &path_val) == 0 && path_val)
             path_data = path_val;
         glyph_t *glyph = NULL;
-        if (!duplicate && glyph_create_from_svg_path (codepoint, adv, path_data, &glyph) != 0)
+        if (glyph_create_from_svg_path (codepoint, adv, path_data, &glyph) != 0)
             glyph = NULL;
         if (path_val)
             free (path_val);
@@ -728,20 +672,34 @@ static int font_ensure_glyphs_loaded (font_t *font) {
             cursor = end + 1;
             continue;
         }
-        if (duplicate) {
+        if (font_append_glyph_entry (font, glyph, codepoint) != 0) {
             glyph_release (glyph);
-        } else {
-            if (font_append_glyph_entry (font, glyph, codepoint) != 0) {
-                glyph_release (glyph);
-                return -1;
-            }
+            return -1;
         }
         cursor = end + 1;
     }
-    font->glyphs_loaded = true;
+    if (font_build_glyph_index (font) != 0)
+        return -1;
+    __atomic_store_n (&font->glyphs_loaded, true, __ATOMIC_RELEASE);
+    if (font->source_path)
+        fontcache_store (
+            font->source_path, font->id, font->family, &font->metrics, font->glyph_codes,
+            font->glyphs, font->glyph_count);
     return 0;
 }
 
+/**
+ * \brief Гарантує розібрані гліфи; після публікації прапорця читання йде без замка.
+ */
+static int font_ensure_glyphs_loaded (font_t *font) {
+    if (__atomic_load_n (&font->glyphs_loaded, __ATOMIC_ACQUIRE))
+        return 0;
+    font_shared_lock ();
+    int rc = font_load_glyphs (font);
+    font_shared_unlock ();
+    return rc;
+}
+
 /** @copydoc font_load_from_file */
 int font_load_from_file (const char *path, font_t **out_font) {
     if (!path || !out_font)
@@ -749,10 +707,26 @@ int font_load_from_file (const char *path, font_t **out_font) {
     font_t *font = (font_t *)calloc (1, sizeof (*font));
     if (!font)
         return -1;
+    font->refcount = 1;
+    if (str_string_duplicate (path, &font->source_path) != 0) {
+        free (font);
+        return -1;
+    }
+    if (fontcache_open (path, &font->cache) == 0) {
+        if (str_string_duplicate (font->cache.id, &font->id) != 0
+            || (font->cache.family[0]
+                && str_string_duplicate (font->cache.family, &font->family) != 0)) {
+            font_release (font);
+            return -1;
+        }
+        font->metrics = font->cache.metrics;
+        *out_font = font;
+        return 0;
+    }
     char *svg = NULL;
     size_t svg_len = 0;
     if (font_read_entire_file (path, &svg, &svg_len) != 0) {
-        free (font);
+        font_release (font);
         return -1;
     }
     font->svg_data = svg;
@@ -824,13 +798,81 @@ int font_find_glyph (const font_t *font, uint32_t codepoint, const glyph_t **out
     font_t *mutable_font = (font_t *)font;
     if (font_ensure_glyphs_loaded (mutable_font) != 0)
         return -1;
-    for (size_t i = 0; i < mutable_font->glyph_count; ++i) {
-        if (mutable_font->glyph_codes[i] == codepoint) {
-            *out_glyph = mutable_font->glyphs[i];
-            return 0;
+    size_t idx = font_index_lookup (mutable_font, codepoint);
+    if (idx == SIZE_MAX)
+        return 1;
+    *out_glyph = mutable_font->glyphs[idx];
+    return 0;
+}
+
+/** @copydoc font_find_glyphs */
+int font_find_glyphs (
+    const font_t *font,
+    const uint32_t *codepoints,
+    size_t count,
+    const glyph_t **out_glyphs,
+    size_t *out_found) {
+    if (!font || (count > 0 && (!codepoints || !out_glyphs)))
+        return -1;
+    font_t *mutable_font = (font_t *)font;
+    if (font_ensure_glyphs_loaded (mutable_font) != 0)
+        return -1;
+    size_t found = 0;
+    uint32_t last_cp = 0;
+    const glyph_t *last_glyph = NULL;
+    bool have_last = false;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t cp = codepoints[i];
+        if (!have_last || cp != last_cp) {
+            size_t idx = font_index_lookup (mutable_font, cp);
+            last_glyph = (idx == SIZE_MAX) ? NULL : mutable_font->glyphs[idx];
+            last_cp = cp;
+            have_last = true;
         }
+        out_glyphs[i] = last_glyph;
+        if (last_glyph)
+            found++;
     }
-    return 1;
+    if (out_found)
+        *out_found = found;
+    return 0;
+}
+
+/** @copydoc font_emit_glyph_outline */
+int font_emit_glyph_outline (
+    const glyph_t *glyph,
+    double origin_x,
+    double baseline_y,
+    double scale,
+    geom_paths_t *out,
+    double *advance_units) {
+    if (!glyph || !out)
+        return -1;
+
+    glyph_info_t info;
+    glyph_outline_t outline;
+    if (glyph_get_info (glyph, &info) != 0 || glyph_get_outline (glyph, &outline) != 0)
+        return -1;
+    if (advance_units)
+        *advance_units = info.advance_width;
+    if (outline.stroke_count == 0)
+        return 0;
+
+    if (geom_paths_reserve (out, out->len + outline.stroke_count) != 0)
+        return -1;
+    const float *src = outline.coords;
+    for (size_t s = 0; s < outline.stroke_count; ++s) {
+        size_t n = outline.stroke_len[s];
+        geom_point_t *dst = NULL;
+        if (geom_paths_add_path (out, n, &dst) != 0)
+            return -1;
+        for (size_t i = 0; i < n; ++i, src += 2) {
+            dst[i].x = (origin_x + (double)src[0]) * scale;
+            dst[i].y = (baseline_y - (double)src[1]) * scale;
+        }
+    }
+
+    return 0;
 }
 
 /** @copydoc font_emit_glyph_paths */
@@ -850,24 +892,30 @@ int font_emit_glyph_paths (
     if (rc != 0 || !glyph)
         return 1;
 
-    glyph_info_t info;
-    if (glyph_get_info (glyph, &info) != 0)
-        return 1;
-    if (advance_units)
-        *advance_units = info.advance_width;
-
-    const char *d = glyph_get_path_data (glyph);
-    if (font_emit_path_data (d, origin_x, baseline_y, scale, out) != 0)
-        return -1;
-
-    return 0;
+    return font_emit_glyph_outline (glyph, origin_x, baseline_y, scale, out, advance_units);
 }
 
-/** @copydoc font_list_codepoints */
-int font_list_codepoints (const font_t *font, uint32_t **out_codes, size_t *out_count) {
+/** \brief `font_list_codepoints` під замком реєстру (кеш може закриватися розбором). */
+static int
+font_list_codepoints_unlocked (const font_t *font, uint32_t **out_codes, size_t *out_count) {
     if (!font || !out_codes || !out_count)
         return -1;
     font_t *mutable_font = (font_t *)font;
+    if (!mutable_font->glyphs_loaded && mutable_font->cache.map) {
+        /* Покриття читається прямо з кешу, без створення гліфів. */
+        const fontcache_entry_t *entry = &mutable_font->cache;
+        uint32_t *codes = NULL;
+        if (entry->glyph_count > 0) {
+            codes = (uint32_t *)malloc (entry->glyph_count * sizeof (*codes));
+            if (!codes)
+                return -1;
+            for (size_t i = 0; i < entry->glyph_count; ++i)
+                codes[i] = entry->glyphs[i].codepoint;
+        }
+        *out_codes = codes;
+        *out_count = entry->glyph_count;
+        return 0;
+    }
     if (font_ensure_glyphs_loaded (mutable_font) != 0)
         return -1;
     size_t count = mutable_font->glyph_count;
@@ -883,10 +931,57 @@ int font_list_codepoints (const font_t *font, uint32_t **out_codes, size_t *out_
     return 0;
 }
 
-/** @copydoc font_release */
-int font_release (font_t *font) {
+/** \brief `font_acquire` без замка реєстру. */
+static int font_acquire_unlocked (const char *path, font_t **out_font) {
+    if (!path || !out_font)
+        return -2;
+    for (size_t i = 0; i < g_shared_font_count; ++i) {
+        font_t *font = g_shared_fonts[i];
+        if (strcmp (font->source_path, path) == 0) {
+            font->refcount++;
+            *out_font = font;
+            return 0;
+        }
+    }
+    font_t *font = NULL;
+    int rc = font_load_from_file (path, &font);
+    if (rc != 0)
+        return rc;
+    if (g_shared_font_count == g_shared_font_cap) {
+        size_t new_cap = (g_shared_font_cap == 0) ? 8 : g_shared_font_cap * 2;
+        font_t **grown = (font_t **)realloc (g_shared_fonts, new_cap * sizeof (*grown));
+        if (!grown) {
+            /* Без реєстру шрифт усе одно придатний — віддаємо приватну копію. */
+            *out_font = font;
+            return 0;
+        }
+        g_shared_fonts = grown;
+        g_shared_font_cap = new_cap;
+    }
+    font->refcount++;
+    g_shared_fonts[g_shared_font_count++] = font;
+    *out_font = font;
+    return 0;
+}
+
+/** \brief `font_shared_cache_clear` без замка реєстру. */
+static void font_shared_cache_clear_unlocked (void) {
+    for (size_t i = 0; i < g_shared_font_count; ++i)
+        font_release (g_shared_fonts[i]);
+    free (g_shared_fonts);
+    g_shared_fonts = NULL;
+    g_shared_font_count = 0;
+    g_shared_font_cap = 0;
+}
+
+/** \brief `font_release` без замка реєстру. */
+static int font_release_unlocked (font_t *font) {
     if (!font)
         return 0;
+    if (font->refcount > 1) {
+        font->refcount--;
+        return 0;
+    }
     if (font->glyphs) {
         for (size_t i = 0; i < font->glyph_count; ++i)
             glyph_release (font->glyphs[i]);
@@ -896,10 +991,43 @@ int font_release (font_t *font) {
     free (font->svg_data);
     free (font->id);
     free (font->family);
+    free (font->source_path);
+    fontcache_close (&font->cache);
     free (font);
     return 0;
 }
 
+/** @copydoc font_list_codepoints */
+int font_list_codepoints (const font_t *font, uint32_t **out_codes, size_t *out_count) {
+    font_shared_lock ();
+    int rc = font_list_codepoints_unlocked (font, out_codes, out_count);
+    font_shared_unlock ();
+    return rc;
+}
+
+/** @copydoc font_acquire */
+int font_acquire (const char *path, font_t **out_font) {
+    font_shared_lock ();
+    int rc = font_acquire_unlocked (path, out_font);
+    font_shared_unlock ();
+    return rc;
+}
+
+/** @copydoc font_shared_cache_clear */
+void font_shared_cache_clear (void) {
+    font_shared_lock ();
+    font_shared_cache_clear_unlocked ();
+    font_shared_unlock ();
+}
+
+/** @copydoc font_release */
+int font_release (font_t *font) {
+    font_shared_lock ();
+    int rc = font_release_unlocked (font);
+    font_shared_unlock ();
+    return rc;
+}
+
 /** @copydoc font_style_context_resolve */
 int font_style_context_resolve (
     const char *preferred_family,
@@ -91,6 +91,42 @@ int font_get_metrics (const font_t *font, font_metrics_t *out);
  */
 int font_find_glyph (const font_t *font, uint32_t codepoint, const glyph_t **out_glyph);
 
+/**
+ * @brief Пакетний пошук гліфів для послідовності кодових точок.
+ * @details Індекс шрифту будується один раз при лінивому завантаженні; пошук кожної
+ *          кодової точки — бінарний, повтори поспіль не шукаються вдруге.
+ * @param font Обʼєкт шрифту.
+ * @param codepoints Масив кодових точок.
+ * @param count Кількість елементів.
+ * @param out_glyphs [out] Масив із `count` вказівників; NULL — гліф відсутній.
+ * @param out_found [out] Кількість знайдених гліфів (може бути NULL).
+ * @return 0 — успіх, -1 — помилка.
+ */
+int font_find_glyphs (
+    const font_t *font,
+    const uint32_t *codepoints,
+    size_t count,
+    const glyph_t **out_glyphs,
+    size_t *out_found);
+
+/**
+ * @brief Емітує контури вже знайденого гліфа у вихідні шляхи.
+ * @param glyph Гліф (див. `font_find_glyph`/`font_find_glyphs`).
+ * @param origin_x Початкова X-позиція (одиниці шрифту).
+ * @param baseline_y Базова лінія Y (одиниці шрифту).
+ * @param scale Масштаб із одиниць шрифту в цільові одиниці.
+ * @param out [out] Кінцеві шляхи.
+ * @param advance_units [out] Просування пера в одиницях шрифту.
+ * @return 0 — успіх, -1 — помилка.
+ */
+int font_emit_glyph_outline (
+    const glyph_t *glyph,
+    double origin_x,
+    double baseline_y,
+    double scale,
+    geom_paths_t *out,
+    double *advance_units);
+
 /**
  * @brief Емітує контури гліфа у вихідні шляхи.
  * @param font Шрифт.
@@ -204,7 +240,24 @@ int font_fallback_emit (
 int font_list_codepoints (const font_t *font, uint32_t **out_codes, size_t *out_count);
 
 /**
- * @brief Вивільняє обʼєкт шрифту та повʼязані ресурси.
+ * @brief Повертає спільний дескриптор шрифту для файлу (завантажує за потреби).
+ * @details Шрифти кешуються на рівні процесу за шляхом файлу; кожен виклик додає
+ *          посилання, яке знімає `font_release`. Гліфи спільного шрифту розбираються
+ *          один раз для всіх блоків, заголовків, списків і клітинок таблиць.
+ * @param path Шлях до файлу шрифту.
+ * @param out_font [out] Дескриптор (звільнити `font_release`).
+ * @return 0 — успіх, інакше помилка.
+ */
+int font_acquire (const char *path, font_t **out_font);
+
+/**
+ * @brief Відпускає посилання реєстру на всі спільні шрифти.
+ * @details Шрифти, що досі використовуються, звільняються з останнім `font_release`.
+ */
+void font_shared_cache_clear (void);
+
+/**
+ * @brief Знімає посилання на шрифт; останнє посилання звільняє ресурси.
  * @param font Обʼєкт для знищення (може бути NULL).
  * @return 0 — успіх.
  */
@@ -0,0 +1,361 @@
+/**
+ * @file fontcache.c
+ * @brief Реалізація бінарного кешу шрифтів Hershey.
+ * @ingroup fontcache
+ * @details
+ * Формат файлу (порядок байтів хоста, кеш не переноситься між машинами):
+ * заголовок `fontcache_header_t`, таблиця `fontcache_glyph_t`, довжини штрихів
+ * (`uint32_t`), координати (`float` парами), рядки id/family. Усі зсуви
+ * зберігаються у заголовку та перевіряються при відкритті.
+ */
+
+#include "fontcache.h"
+
+#include "config.h"
+#include "log.h"
+#include "str.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/** Сигнатура файлу кешу. */
+#define FONTCACHE_MAGIC "CPLFNTC"
+
+/** Версія формату; збільшується за будь-якої зміни структури. */
+#define FONTCACHE_VERSION 1u
+
+/**
+ * @brief Заголовок файлу кешу.
+ */
+typedef struct {
+    char magic[8];           /**< `FONTCACHE_MAGIC` із NUL. */
+    uint32_t version;        /**< `FONTCACHE_VERSION`. */
+    uint32_t header_size;    /**< sizeof (fontcache_header_t). */
+    uint64_t src_size;       /**< Розмір SVG-джерела, байт. */
+    int64_t src_mtime_sec;   /**< mtime джерела, секунди. */
+    int64_t src_mtime_nsec;  /**< mtime джерела, наносекунди. */
+    double metrics[5];       /**< units_per_em, ascent, descent, cap_height, x_height. */
+    uint64_t glyph_count;    /**< Кількість гліфів. */
+    uint64_t stroke_total;   /**< Загальна кількість штрихів. */
+    uint64_t point_total;    /**< Загальна кількість точок. */
+    uint64_t glyphs_offset;  /**< Зсув таблиці гліфів. */
+    uint64_t strokes_offset; /**< Зсув масиву довжин штрихів. */
+    uint64_t coords_offset;  /**< Зсув масиву координат. */
+    uint64_t id_offset;      /**< Зсув рядка id. */
+    uint64_t family_offset;  /**< Зсув рядка family. */
+    uint64_t file_size;      /**< Повний розмір файлу. */
+} fontcache_header_t;
+
+/**
+ * @brief Перевіряє, чи кеш не вимкнено змінною середовища.
+ * @return 1 — увімкнено, 0 — вимкнено.
+ */
+static int fontcache_enabled (void) {
+    const char *env = getenv ("CPLOT_FONT_CACHE");
+    if (env && (strcmp (env, "0") == 0 || str_string_equals_ci (env, "off")
+                || str_string_equals_ci (env, "no")))
+        return 0;
+    return 1;
+}
+
+/**
+ * @brief Обчислює каталог кешу шрифтів.
+ * @param buf [out] Буфер.
+ * @param buflen Розмір буфера.
+ * @return 0 — успіх; -1 — немає XDG_CACHE_HOME/HOME або замалий буфер.
+ */
+static int fontcache_dir (char *buf, size_t buflen) {
+    return config_xdg_dir ("XDG_CACHE_HOME", ".cache", "fonts", buf, buflen);
+}
+
+/**
+ * @brief Формує шлях файлу кешу для SVG-джерела.
+ * @details Імʼя складається з базового імені джерела та FNV-1a хешу повного шляху.
+ * @param font_path Шлях до SVG.
+ * @param buf [out] Буфер шляху.
+ * @param buflen Розмір буфера.
+ * @param dir_out [out] Каталог кешу (може бути NULL).
+ * @param dir_len Розмір `dir_out`.
+ * @return 0 — успіх; -1 — помилка.
+ */
+static int fontcache_entry_path (
+    const char *font_path, char *buf, size_t buflen, char *dir_out, size_t dir_len) {
+    char dir[PATH_MAX];
+    if (fontcache_dir (dir, sizeof (dir)) != 0)
+        return -1;
+    char resolved[PATH_MAX];
+    const char *key = realpath (font_path, resolved) ? resolved : font_path;
+    uint64_t hash = str_fnv1a (STR_FNV1A_OFFSET, key, strlen (key));
+    const char *base = strrchr (font_path, '/');
+    base = base ? base + 1 : font_path;
+    int written = snprintf (
+        buf, buflen, "%s/%s-%016llx.bin", dir, base, (unsigned long long)hash);
+    if (written < 0 || (size_t)written >= buflen)
+        return -1;
+    if (dir_out && dir_len > 0)
+        str_string_copy (dir_out, dir_len, dir);
+    return 0;
+}
+
+/**
+ * @brief Зчитує розмір і mtime джерела.
+ * @return 0 — успіх; -1 — помилка `stat`.
+ */
+static int
+fontcache_source_stamp (const char *font_path, uint64_t *size, int64_t *sec, int64_t *nsec) {
+    struct stat st;
+    if (stat (font_path, &st) != 0)
+        return -1;
+    *size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+    *sec = (int64_t)st.st_mtimespec.tv_sec;
+    *nsec = (int64_t)st.st_mtimespec.tv_nsec;
+#else
+    *sec = (int64_t)st.st_mtim.tv_sec;
+    *nsec = (int64_t)st.st_mtim.tv_nsec;
+#endif
+    return 0;
+}
+
+/**
+ * @brief Перевіряє, що діапазон [offset, offset+bytes) лежить у файлі.
+ */
+static int fontcache_range_ok (uint64_t offset, uint64_t count, uint64_t elem, uint64_t total) {
+    if (offset > total)
+        return 0;
+    if (elem != 0 && count > (total - offset) / elem)
+        return 0;
+    return 1;
+}
+
+/** @copydoc fontcache_open */
+int fontcache_open (const char *font_path, fontcache_entry_t *out) {
+    if (!font_path || !out)
+        return -1;
+    memset (out, 0, sizeof (*out));
+    if (!fontcache_enabled ())
+        return 1;
+
+    uint64_t src_size = 0;
+    int64_t src_sec = 0, src_nsec = 0;
+    if (fontcache_source_stamp (font_path, &src_size, &src_sec, &src_nsec) != 0)
+        return 1;
+    char path[PATH_MAX];
+    if (fontcache_entry_path (font_path, path, sizeof (path), NULL, 0) != 0)
+        return 1;
+
+    FILE *fp = fopen (path, "rb");
+    if (!fp)
+        return 1;
+    struct stat st;
+    if (fstat (fileno (fp), &st) != 0 || st.st_size < (off_t)sizeof (fontcache_header_t)) {
+        fclose (fp);
+        return 1;
+    }
+    size_t map_len = (size_t)st.st_size;
+    void *map = mmap (NULL, map_len, PROT_READ, MAP_PRIVATE, fileno (fp), 0);
+    fclose (fp);
+    if (map == MAP_FAILED)
+        return 1;
+
+    const fontcache_header_t *hdr = (const fontcache_header_t *)map;
+    const unsigned char *base = (const unsigned char *)map;
+    uint64_t total = (uint64_t)map_len;
+    int valid = memcmp (hdr->magic, FONTCACHE_MAGIC, sizeof (FONTCACHE_MAGIC)) == 0
+                && hdr->version == FONTCACHE_VERSION
+                && hdr->header_size == sizeof (fontcache_header_t) && hdr->file_size == total;
+    if (valid && (hdr->src_size != src_size || hdr->src_mtime_sec != src_sec
+                  || hdr->src_mtime_nsec != src_nsec)) {
+        log_print (LOG_DEBUG, "кеш шрифтів: застарілий запис %s", path);
+        valid = 0;
+    }
+    if (valid)
+        valid = fontcache_range_ok (
+                    hdr->glyphs_offset, hdr->glyph_count, sizeof (fontcache_glyph_t), total)
+                && fontcache_range_ok (
+                    hdr->strokes_offset, hdr->stroke_total, sizeof (uint32_t), total)
+                && fontcache_range_ok (
+                    hdr->coords_offset, hdr->point_total, 2 * sizeof (float), total)
+                && hdr->id_offset < total && hdr->family_offset < total
+                && base[total - 1] == '\0' && hdr->glyphs_offset % sizeof (double) == 0
+                && hdr->strokes_offset % sizeof (uint32_t) == 0
+                && hdr->coords_offset % sizeof (float) == 0;
+    if (!valid) {
+        munmap (map, map_len);
+        return 1;
+    }
+
+    out->map = map;
+    out->map_len = map_len;
+    out->id = (const char *)(base + hdr->id_offset);
+    out->family = (const char *)(base + hdr->family_offset);
+    out->metrics.units_per_em = hdr->metrics[0];
+    out->metrics.ascent = hdr->metrics[1];
+    out->metrics.descent = hdr->metrics[2];
+    out->metrics.cap_height = hdr->metrics[3];
+    out->metrics.x_height = hdr->metrics[4];
+    out->glyphs = (const fontcache_glyph_t *)(base + hdr->glyphs_offset);
+    out->glyph_count = (size_t)hdr->glyph_count;
+    out->stroke_len = (const uint32_t *)(base + hdr->strokes_offset);
+    out->coords = (const float *)(base + hdr->coords_offset);
+    log_print (LOG_DEBUG, "кеш шрифтів: використано %s (%zu гліфів)", path, out->glyph_count);
+    return 0;
+}
+
+/** @copydoc fontcache_glyph_outline */
+int fontcache_glyph_outline (const fontcache_entry_t *entry, size_t index, glyph_outline_t *out) {
+    if (!entry || !entry->map || !out || index >= entry->glyph_count)
+        return -1;
+    const fontcache_header_t *hdr = (const fontcache_header_t *)entry->map;
+    const fontcache_glyph_t *g = &entry->glyphs[index];
+    if ((uint64_t)g->stroke_offset + g->stroke_count > hdr->stroke_total
+        || (uint64_t)g->point_offset + g->point_count > hdr->point_total)
+        return -1;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < g->stroke_count; ++i)
+        sum += entry->stroke_len[g->stroke_offset + i];
+    if (sum != g->point_count)
+        return -1;
+    out->coords = entry->coords + (size_t)g->point_offset * 2;
+    out->stroke_len = entry->stroke_len + g->stroke_offset;
+    out->stroke_count = g->stroke_count;
+    out->point_count = g->point_count;
+    return 0;
+}
+
+/** @copydoc fontcache_close */
+void fontcache_close (fontcache_entry_t *entry) {
+    if (!entry)
+        return;
+    if (entry->map)
+        munmap (entry->map, entry->map_len);
+    memset (entry, 0, sizeof (*entry));
+}
+
+/** \brief Записує блок у файл; 0 — успіх. */
+static int fontcache_write (FILE *fp, const void *data, size_t len) {
+    if (len == 0)
+        return 0;
+    return fwrite (data, 1, len, fp) == len ? 0 : -1;
+}
+
+/** @copydoc fontcache_store */
+int fontcache_store (
+    const char *font_path,
+    const char *id,
+    const char *family,
+    const font_metrics_t *metrics,
+    const uint32_t *codes,
+    glyph_t *const *glyphs,
+    size_t count) {
+    if (!font_path || !metrics || (count > 0 && (!codes || !glyphs)))
+        return -1;
+    if (!fontcache_enabled ())
+        return 1;
+
+    fontcache_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, FONTCACHE_MAGIC, sizeof (FONTCACHE_MAGIC));
+    hdr.version = FONTCACHE_VERSION;
+    hdr.header_size = sizeof (hdr);
+    if (fontcache_source_stamp (font_path, &hdr.src_size, &hdr.src_mtime_sec, &hdr.src_mtime_nsec)
+        != 0)
+        return 1;
+    hdr.metrics[0] = metrics->units_per_em;
+    hdr.metrics[1] = metrics->ascent;
+    hdr.metrics[2] = metrics->descent;
+    hdr.metrics[3] = metrics->cap_height;
+    hdr.metrics[4] = metrics->x_height;
+
+    fontcache_glyph_t *table = NULL;
+    if (count > 0) {
+        table = (fontcache_glyph_t *)calloc (count, sizeof (*table));
+        if (!table)
+            return -1;
+    }
+    uint64_t strokes = 0, points = 0;
+    for (size_t i = 0; i < count; ++i) {
+        glyph_info_t info;
+        glyph_outline_t outline;
+        if (glyph_get_info (glyphs[i], &info) != 0
+            || glyph_get_outline (glyphs[i], &outline) != 0) {
+            free (table);
+            return -1;
+        }
+        if (strokes + outline.stroke_count > UINT32_MAX || points + outline.point_count > UINT32_MAX) {
+            free (table);
+            return -1;
+        }
+        table[i].codepoint = codes[i];
+        table[i].stroke_offset = (uint32_t)strokes;
+        table[i].stroke_count = (uint32_t)outline.stroke_count;
+        table[i].point_offset = (uint32_t)points;
+        table[i].point_count = (uint32_t)outline.point_count;
+        table[i].advance_width = info.advance_width;
+        strokes += outline.stroke_count;
+        points += outline.point_count;
+    }
+    const char *id_str = id ? id : "";
+    const char *family_str = family ? family : "";
+    size_t id_len = strlen (id_str) + 1;
+    size_t family_len = strlen (family_str) + 1;
+    hdr.glyph_count = count;
+    hdr.stroke_total = strokes;
+    hdr.point_total = points;
+    hdr.glyphs_offset = sizeof (hdr);
+    hdr.strokes_offset = hdr.glyphs_offset + count * sizeof (fontcache_glyph_t);
+    hdr.coords_offset = hdr.strokes_offset + strokes * sizeof (uint32_t);
+    hdr.id_offset = hdr.coords_offset + points * 2 * sizeof (float);
+    hdr.family_offset = hdr.id_offset + id_len;
+    hdr.file_size = hdr.family_offset + family_len;
+
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX + 32];
+    if (fontcache_entry_path (font_path, path, sizeof (path), dir, sizeof (dir)) != 0
+        || config_mkdir_p (dir) != 0) {
+        free (table);
+        return 1;
+    }
+    snprintf (tmp_path, sizeof (tmp_path), "%s.%ld.tmp", path, (long)getpid ());
+    FILE *fp = fopen (tmp_path, "wb");
+    if (!fp) {
+        free (table);
+        return 1;
+    }
+    int rc = fontcache_write (fp, &hdr, sizeof (hdr));
+    if (rc == 0)
+        rc = fontcache_write (fp, table, count * sizeof (*table));
+    for (size_t i = 0; rc == 0 && i < count; ++i) {
+        glyph_outline_t outline;
+        glyph_get_outline (glyphs[i], &outline);
+        rc = fontcache_write (fp, outline.stroke_len, outline.stroke_count * sizeof (uint32_t));
+    }
+    for (size_t i = 0; rc == 0 && i < count; ++i) {
+        glyph_outline_t outline;
+        glyph_get_outline (glyphs[i], &outline);
+        rc = fontcache_write (fp, outline.coords, outline.point_count * 2 * sizeof (float));
+    }
+    if (rc == 0)
+        rc = fontcache_write (fp, id_str, id_len);
+    if (rc == 0)
+        rc = fontcache_write (fp, family_str, family_len);
+    free (table);
+    if (fclose (fp) != 0)
+        rc = -1;
+    if (rc == 0 && rename (tmp_path, path) != 0)
+        rc = -1;
+    if (rc != 0) {
+        unlink (tmp_path);
+        log_print (LOG_DEBUG, "кеш шрифтів: не вдалося записати %s", path);
+        return -1;
+    }
+    log_print (LOG_DEBUG, "кеш шрифтів: збережено %s (%zu гліфів)", path, count);
+    return 0;
+}
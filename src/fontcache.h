@@ -0,0 +1,101 @@
+/**
+ * @file fontcache.h
+ * @brief Бінарний кеш розібраних шрифтів Hershey (XDG_CACHE_HOME).
+ * @defgroup fontcache Кеш шрифтів
+ * @ingroup font
+ * @details
+ * Для кожного SVG-шрифту зберігається файл із метриками, відсортованим переліком
+ * кодових точок і попередньо розібраними контурами гліфів. Запис ключується
+ * розміром та часом модифікації джерела; застарілий кеш ігнорується й перезаписується.
+ * Файл кешу відображається у памʼять (`mmap`) лише для читання.
+ *
+ * Каталог: `$XDG_CACHE_HOME/cplot/fonts` або `~/.cache/cplot/fonts`.
+ * Вимкнення: `CPLOT_FONT_CACHE=0`.
+ */
+#ifndef FONTCACHE_H
+#define FONTCACHE_H
+
+#include "font.h"
+#include "glyph.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Запис гліфа у кеші (розташований у відображеній памʼяті).
+ */
+typedef struct fontcache_glyph {
+    uint32_t codepoint;     /**< Кодова точка (записи відсортовано за зростанням). */
+    uint32_t stroke_offset; /**< Індекс першого штриха у масиві довжин. */
+    uint32_t stroke_count;  /**< Кількість штрихів. */
+    uint32_t point_offset;  /**< Індекс першої точки у масиві координат. */
+    uint32_t point_count;   /**< Кількість точок. */
+    uint32_t reserved;      /**< Вирівнювання (0). */
+    double advance_width;   /**< Просування пера (од. шрифту). */
+} fontcache_glyph_t;
+
+/**
+ * @brief Відкритий запис кешу одного шрифту.
+ */
+typedef struct fontcache_entry {
+    void *map;                       /**< Відображення файлу (`mmap`). */
+    size_t map_len;                  /**< Довжина відображення. */
+    const char *id;                  /**< Атрибут font id (NUL-термінований). */
+    const char *family;              /**< font-family (NUL-термінований, може бути порожнім). */
+    font_metrics_t metrics;          /**< Метрики шрифту. */
+    const fontcache_glyph_t *glyphs; /**< Таблиця гліфів. */
+    size_t glyph_count;              /**< Кількість гліфів. */
+    const uint32_t *stroke_len;      /**< Довжини штрихів усіх гліфів. */
+    const float *coords;             /**< Координати (x, y) усіх гліфів. */
+} fontcache_entry_t;
+
+/**
+ * @brief Відкриває кеш для SVG-шрифту, якщо він актуальний.
+ * @param font_path Шлях до SVG-файлу шрифту.
+ * @param out [out] Запис кешу (закрити `fontcache_close`).
+ * @return 0 — кеш знайдено; 1 — відсутній/застарілий/вимкнений; -1 — помилка аргументів.
+ */
+int fontcache_open (const char *font_path, fontcache_entry_t *out);
+
+/**
+ * @brief Заповнює опис контуру гліфа з запису кешу.
+ * @param entry Відкритий запис.
+ * @param index Індекс гліфа у `entry->glyphs`.
+ * @param out [out] Контур (вказує у відображену памʼять).
+ * @return 0 — успіх; -1 — помилка.
+ */
+int fontcache_glyph_outline (
+    const fontcache_entry_t *entry, size_t index, glyph_outline_t *out);
+
+/** Закриває запис кешу (знімає відображення). */
+void fontcache_close (fontcache_entry_t *entry);
+
+/**
+ * @brief Зберігає розібраний шрифт у кеш (атомарно, через тимчасовий файл).
+ * @param font_path Шлях до SVG-джерела (для ключа mtime/розмір).
+ * @param id Атрибут font id (може бути NULL).
+ * @param family font-family (може бути NULL).
+ * @param metrics Метрики шрифту.
+ * @param codes Кодові точки, відсортовані за зростанням, без повторів.
+ * @param glyphs Гліфи, паралельні до `codes`.
+ * @param count Кількість гліфів.
+ * @return 0 — успіх; 1 — кеш вимкнено/недоступний; -1 — помилка запису.
+ */
+int fontcache_store (
+    const char *font_path,
+    const char *id,
+    const char *family,
+    const font_metrics_t *metrics,
+    const uint32_t *codes,
+    glyph_t *const *glyphs,
+    size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
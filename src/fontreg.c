@@ -11,6 +11,7 @@
 #include "str.h"
 #include <ctype.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,10 +21,35 @@
 #define FONT_STYLE_ITALIC 0x02
 #define FONT_STYLE_BOLD 0x04
 
+/** Розмір блоку покриття (кодових точок) і кількість блоків у BMP. */
+#define FONTREG_BLOCK_SHIFT 8
+#define FONTREG_BLOCK_SIZE (1u << FONTREG_BLOCK_SHIFT)
+#define FONTREG_BMP_BLOCKS (0x10000u >> FONTREG_BLOCK_SHIFT)
+
+/** Бітова маска одного блоку з 256 кодових точок. */
+typedef uint64_t fontreg_block_bits_t[FONTREG_BLOCK_SIZE / 64];
+
+/**
+ * @brief Покриття кодових точок обличчям: розріджений бітсет по блоках BMP.
+ * @details `block_slot[b]` — 0 для порожнього блоку або індекс+1 у `blocks`.
+ *          Кодові точки поза BMP (рідкісні для Hershey) — у відсортованому `astral`.
+ */
+typedef struct {
+    uint16_t block_slot[FONTREG_BMP_BLOCKS];
+    fontreg_block_bits_t *blocks;
+    size_t block_count;
+    uint32_t *astral;
+    size_t astral_count;
+} fontreg_coverage_t;
+
+/** Стан ледачого завантаження покриття. */
+enum { FONTREG_COVERAGE_PENDING = 0, FONTREG_COVERAGE_READY = 1, FONTREG_COVERAGE_FAILED = -1 };
+
 typedef struct {
     font_face_t face;
     int style_flags;
-    uint32_t *codepoints;
+    int coverage_state;
+    fontreg_coverage_t coverage;
     size_t codepoint_count;
 } font_variant_info_t;
 
@@ -46,11 +72,37 @@ static font_face_t *g_cached_faces = NULL;
 static size_t g_cached_face_count = 0;
 static int g_faces_cache_ready = 0;
 
+/**
+ * @brief Рекурсивний замок стану реєстру.
+ * @details Каталог, кеш облич і покриття варіантів будуються ліниво, тож публічні
+ *          функції виконуються під замком: верстка окремих блоків Markdown іде
+ *          з кількох потоків. Замок рекурсивний, бо публічні функції викликають одна одну.
+ */
+static pthread_mutex_t g_registry_lock;
+static pthread_once_t g_registry_lock_once = PTHREAD_ONCE_INIT;
+
+static void fontreg_lock_init (void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init (&attr);
+    pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init (&g_registry_lock, &attr);
+    pthread_mutexattr_destroy (&attr);
+}
+
+static void fontreg_lock (void) {
+    pthread_once (&g_registry_lock_once, fontreg_lock_init);
+    pthread_mutex_lock (&g_registry_lock);
+}
+
+static void fontreg_unlock (void) { pthread_mutex_unlock (&g_registry_lock); }
+
 static void fontreg_catalog_clear (void) {
     for (size_t i = 0; i < g_family_count; ++i) {
         font_family_info_t *family = &g_families[i];
-        for (size_t j = 0; j < family->variant_count; ++j)
-            free (family->variants[j].codepoints);
+        for (size_t j = 0; j < family->variant_count; ++j) {
+            free (family->variants[j].coverage.blocks);
+            free (family->variants[j].coverage.astral);
+        }
         free (family->variants);
     }
     free (g_families);
@@ -295,6 +347,8 @@ static font_variant_info_t *fontreg_append_variant (font_family_info_t *family)
 
 /**
  * @brief Будує кеш каталогу родин та варіантів із індексу шрифтів.
+ * @details Файли шрифтів тут не відкриваються: покриття кодових точок кожного
+ *          варіанту завантажується ліниво (`fontreg_variant_ensure_coverage`).
  * @return 0 — успіх; -1 — помилка/порожній каталог.
  */
 static int fontreg_ensure_catalog (void) {
@@ -323,28 +377,7 @@ static int fontreg_ensure_catalog (void) {
         }
         variant->face = *face;
         variant->style_flags = fontreg_style_flags_from_face (face);
-
-        font_t *font = NULL;
-        if (font_load_from_file (face->path, &font) == 0) {
-            uint32_t *codes = NULL;
-            size_t code_count = 0;
-            if (font_list_codepoints (font, &codes, &code_count) != 0) {
-                free (codes);
-                codes = NULL;
-                code_count = 0;
-            }
-            font_release (font);
-            if (codes && code_count > 0) {
-                qsort (codes, code_count, sizeof (*codes), fontreg_cmp_uint32);
-                fontreg_dedupe_codepoints (codes, &code_count);
-            }
-            variant->codepoints = codes;
-            variant->codepoint_count = code_count;
-        } else {
-            variant->codepoints = NULL;
-            variant->codepoint_count = 0;
-            LOGW ("реєстр шрифтів: не вдалося завантажити %s", face->path);
-        }
+        variant->coverage_state = FONTREG_COVERAGE_PENDING;
 
         family->capability_mask |= variant->style_flags;
         if (family->display[0] == '\0')
@@ -394,19 +427,117 @@ static int fontreg_style_priority (int flags) {
 static int fontreg_has_style_flag (int mask, int flag) { return (mask & flag) ? 1 : 0; }
 
 /**
- * @brief Бінарний пошук кодової точки у списку варіанту.
+ * @brief Будує бітсет покриття з відсортованого масиву кодових точок.
+ * @param cov [out] Покриття (попередньо обнулене).
+ * @param codes Відсортовані кодові точки без повторів.
+ * @param count Кількість кодових точок.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int fontreg_coverage_build (fontreg_coverage_t *cov, const uint32_t *codes, size_t count) {
+    size_t blocks = 0;
+    size_t astral = 0;
+    uint32_t last_block = UINT32_MAX;
+    for (size_t i = 0; i < count; ++i) {
+        if (codes[i] > 0xFFFFu) {
+            astral++;
+            continue;
+        }
+        uint32_t block = codes[i] >> FONTREG_BLOCK_SHIFT;
+        if (block != last_block) {
+            blocks++;
+            last_block = block;
+        }
+    }
+    if (blocks > 0) {
+        cov->blocks = (fontreg_block_bits_t *)calloc (blocks, sizeof (*cov->blocks));
+        if (!cov->blocks)
+            return -1;
+    }
+    if (astral > 0) {
+        cov->astral = (uint32_t *)malloc (astral * sizeof (*cov->astral));
+        if (!cov->astral) {
+            free (cov->blocks);
+            cov->blocks = NULL;
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t cp = codes[i];
+        if (cp > 0xFFFFu) {
+            cov->astral[cov->astral_count++] = cp;
+            continue;
+        }
+        uint32_t block = cp >> FONTREG_BLOCK_SHIFT;
+        if (cov->block_slot[block] == 0)
+            cov->block_slot[block] = (uint16_t)(++cov->block_count);
+        uint32_t bit = cp & (FONTREG_BLOCK_SIZE - 1u);
+        cov->blocks[cov->block_slot[block] - 1][bit >> 6] |= (uint64_t)1 << (bit & 63u);
+    }
+    return 0;
+}
+
+/**
+ * @brief Ліниво завантажує покриття кодових точок варіанту.
  * @param variant Варіант обличчя.
+ * @return 0 — покриття доступне (можливо, порожнє після помилки завантаження).
+ */
+static int fontreg_variant_ensure_coverage (font_variant_info_t *variant) {
+    if (variant->coverage_state != FONTREG_COVERAGE_PENDING)
+        return 0;
+    memset (&variant->coverage, 0, sizeof (variant->coverage));
+    variant->codepoint_count = 0;
+    variant->coverage_state = FONTREG_COVERAGE_FAILED;
+
+    font_t *font = NULL;
+    if (font_acquire (variant->face.path, &font) != 0) {
+        LOGW ("реєстр шрифтів: не вдалося завантажити %s", variant->face.path);
+        return 0;
+    }
+    uint32_t *codes = NULL;
+    size_t code_count = 0;
+    if (font_list_codepoints (font, &codes, &code_count) != 0) {
+        free (codes);
+        codes = NULL;
+        code_count = 0;
+    }
+    font_release (font);
+    if (codes && code_count > 0) {
+        qsort (codes, code_count, sizeof (*codes), fontreg_cmp_uint32);
+        fontreg_dedupe_codepoints (codes, &code_count);
+    }
+    if (fontreg_coverage_build (&variant->coverage, codes, code_count) == 0) {
+        variant->codepoint_count = code_count;
+        variant->coverage_state = FONTREG_COVERAGE_READY;
+    }
+    free (codes);
+    log_print (
+        LOG_DEBUG, "реєстр шрифтів: покриття %s — %zu кодових точок", variant->face.id,
+        variant->codepoint_count);
+    return 0;
+}
+
+/**
+ * @brief Перевіряє, чи покриває варіант кодову точку (O(1) для BMP).
+ * @param variant Варіант обличчя (покриття вже завантажене).
  * @param cp Кодова точка Unicode.
  * @return 1 — знайдено; 0 — ні.
  */
 static int fontreg_variant_contains_codepoint (const font_variant_info_t *variant, uint32_t cp) {
     if (!variant || variant->codepoint_count == 0)
         return 0;
+    const fontreg_coverage_t *cov = &variant->coverage;
+    if (cp <= 0xFFFFu) {
+        uint16_t slot = cov->block_slot[cp >> FONTREG_BLOCK_SHIFT];
+        if (slot == 0)
+            return 0;
+        uint32_t bit = cp & (FONTREG_BLOCK_SIZE - 1u);
+        return (cov->blocks[slot - 1][bit >> 6] >> (bit & 63u)) & 1u ? 1 : 0;
+    }
     size_t left = 0;
-    size_t right = variant->codepoint_count;
+    size_t right = cov->astral_count;
     while (left < right) {
         size_t mid = left + (right - left) / 2;
-        uint32_t value = variant->codepoints[mid];
+        uint32_t value = cov->astral[mid];
         if (value == cp)
             return 1;
         if (value < cp)
@@ -456,7 +587,7 @@ typedef struct {
  * @param out [out] Заповнений результат оцінювання.
  */
 static void fontreg_evaluate_family (
-    const font_family_info_t *family,
+    font_family_info_t *family,
     const uint32_t *codepoints,
     size_t codepoint_count,
     family_eval_t *out) {
@@ -467,7 +598,8 @@ static void fontreg_evaluate_family (
     out->variant_count = (int)family->variant_count;
 
     for (size_t i = 0; i < family->variant_count; ++i) {
-        const font_variant_info_t *variant = &family->variants[i];
+        font_variant_info_t *variant = &family->variants[i];
+        fontreg_variant_ensure_coverage (variant);
         size_t cover = fontreg_variant_coverage (variant, codepoints, codepoint_count);
         int priority = fontreg_style_priority (variant->style_flags);
         int covers_all = (codepoint_count == 0) ? 1 : (cover == codepoint_count);
@@ -572,7 +704,8 @@ fontreg_find_family_index_by_variant_id (const char *id, family_eval_t *evals, s
 static char g_font_root[PATH_MAX];
 static int g_font_root_initialized = 0;
 
-void fontreg_set_root (const char *path) {
+/** \brief `fontreg_set_root` без замка реєстру. */
+static void fontreg_set_root_unlocked (const char *path) {
     fontreg_catalog_clear ();
     g_font_root_initialized = 1;
     if (!path || !*path) {
@@ -598,8 +731,8 @@ static const char *fontreg_effective_root (void) {
     return (g_font_root_initialized && g_font_root[0] != '\0') ? g_font_root : NULL;
 }
 
-/** @copydoc fontreg_list */
-int fontreg_list (font_face_t **faces, size_t *count) {
+/** \brief `fontreg_list` без замка реєстру. */
+static int fontreg_list_unlocked (font_face_t **faces, size_t *count) {
     if (!faces || !count)
         return -1;
     
@@ -668,97 +801,28 @@ int fontreg_list (font_face_t **faces, size_t *count) {
         return -3;
     }
 
-    const char *p = jsr_json_skip_ws (json);
-    if (*p != '{') {
+    /* Один прохід по індексу: ключі верхнього рівня — ідентифікатори шрифтів. */
+    jsr_doc_t doc;
+    jsr_doc_init (&doc);
+    if (jsr_parse (&doc, json, rd) != 0 || doc.tokens[0].type != JSR_OBJECT) {
+        jsr_doc_free (&doc);
         free (arr);
         free (json);
         LOGE ("некоректний формат індексу шрифтів (очікувався об’єкт)");
         log_print (LOG_ERROR, "реєстр шрифтів: некоректний формат індексу");
         return -4;
     }
-    p++;
-    while (1) {
-        p = jsr_json_skip_ws (p);
-        if (*p == '}') {
-            break;
-        }
-        if (*p != '"') {
-
-            while (*p && *p != ',' && *p != '}')
-                p++;
-            if (*p == ',') {
-                p++;
-                continue;
-            }
-            if (*p == '}')
-                break;
-        }
-
-        p++;
-        const char *kbeg = p;
-        while (*p && *p != '"')
-            p++;
-        if (*p != '"')
-            break;
-        size_t klen = (size_t)(p - kbeg);
+    for (size_t k = 1; k < doc.count; k = doc.tokens[k + 1].next) {
+        size_t klen = doc.tokens[k].len;
         char key[64];
         if (klen >= sizeof (key))
             klen = sizeof (key) - 1;
-        memcpy (key, kbeg, klen);
+        memcpy (key, json + doc.tokens[k].start, klen);
         key[klen] = '\0';
-        p++;
-        p = jsr_json_skip_ws (p);
-        if (*p != ':') {
-
-            while (*p && *p != ',' && *p != '}')
-                p++;
-            if (*p == ',') {
-                p++;
-                continue;
-            }
-            if (*p == '}')
-                break;
-        }
-        p++;
-        p = jsr_json_skip_ws (p);
-
-        const char *vptr = NULL;
-        size_t vlen = 0;
-        if (!jsr_json_get_raw (json, key, &vptr, &vlen)) {
-
-            int depth = 0, in_str = 0;
-            const char *q = p;
-            while (*q) {
-                if (!in_str) {
-                    if (*q == '"')
-                        in_str = 1;
-                    else if (*q == '{' || *q == '[')
-                        depth++;
-                    else if (*q == '}' || *q == ']') {
-                        if (depth == 0)
-                            break;
-                        depth--;
-                    } else if (*q == ',' && depth == 0)
-                        break;
-                } else {
-                    if (*q == '\\' && q[1]) {
-                        q += 2;
-                        continue;
-                    }
-                    if (*q == '"')
-                        in_str = 0;
-                }
-                q++;
-            }
-            p = q;
-            p = jsr_json_skip_ws (p);
-            if (*p == ',')
-                p++;
-            continue;
-        }
 
-        char *file = jsr_json_get_string (vptr, "file", NULL);
-        char *name = jsr_json_get_string (vptr, "name", NULL);
+        size_t entry = k + 1;
+        char *file = jsr_doc_string (&doc, jsr_doc_member (&doc, entry, "file"), NULL);
+        char *name = jsr_doc_string (&doc, jsr_doc_member (&doc, entry, "name"), NULL);
         if (file && name) {
             if (*count == cap) {
                 cap *= 2;
@@ -767,6 +831,7 @@ int fontreg_list (font_face_t **faces, size_t *count) {
                     free (file);
                     free (name);
                     free (arr);
+                    jsr_doc_free (&doc);
                     free (json);
                     LOGE ("нестача пам’яті під час збільшення масиву шрифтів");
                     return -5;
@@ -791,16 +856,8 @@ int fontreg_list (font_face_t **faces, size_t *count) {
         }
         free (file);
         free (name);
-
-        p = vptr + vlen;
-        p = jsr_json_skip_ws (p);
-        if (*p == ',') {
-            p++;
-            continue;
-        }
-        if (*p == '}')
-            break;
     }
+    jsr_doc_free (&doc);
 
     /* Зберігаємо в кеш для наступних викликів */
     g_cached_faces = (font_face_t *)malloc (*count * sizeof (*g_cached_faces));
@@ -817,8 +874,8 @@ int fontreg_list (font_face_t **faces, size_t *count) {
     return 0;
 }
 
-/** @copydoc fontreg_list_families */
-int fontreg_list_families (font_family_name_t **families, size_t *count) {
+/** \brief `fontreg_list_families` без замка реєстру. */
+static int fontreg_list_families_unlocked (font_family_name_t **families, size_t *count) {
     if (!families || !count)
         return -1;
     *families = NULL;
@@ -840,8 +897,8 @@ int fontreg_list_families (font_family_name_t **families, size_t *count) {
     return 0;
 }
 
-/** @copydoc fontreg_select_face_for_codepoints */
-int fontreg_select_face_for_codepoints (
+/** \brief `fontreg_select_face_for_codepoints` без замка реєстру. */
+static int fontreg_select_face_for_codepoints_unlocked (
     const char *preferred_family,
     const uint32_t *codepoints,
     size_t codepoint_count,
@@ -870,6 +927,28 @@ int fontreg_select_face_for_codepoints (
     if (g_family_count == 0)
         return -1;
 
+    /* Спершу — лише бажана родина: якщо вона покриває весь набір, інші не скануються. */
+    if (preferred_family && *preferred_family) {
+        font_face_t pref_face;
+        if (fontreg_resolve (preferred_family, &pref_face) == 0) {
+            for (size_t i = 0; i < g_family_count; ++i) {
+                font_family_info_t *family = &g_families[i];
+                int has_variant = 0;
+                for (size_t j = 0; j < family->variant_count && !has_variant; ++j)
+                    has_variant = strcmp (family->variants[j].face.id, pref_face.id) == 0;
+                if (!has_variant)
+                    continue;
+                family_eval_t pref_eval;
+                fontreg_evaluate_family (family, codepoints, codepoint_count, &pref_eval);
+                if (pref_eval.covers_all && pref_eval.best_variant) {
+                    *out_face = pref_eval.best_variant->face;
+                    return 0;
+                }
+                break;
+            }
+        }
+    }
+
     family_eval_t *evals = (family_eval_t *)calloc (g_family_count, sizeof (*evals));
     if (!evals)
         return -1;
@@ -931,8 +1010,8 @@ int fontreg_select_face_for_codepoints (
     return rc;
 }
 
-/** @copydoc fontreg_resolve */
-int fontreg_resolve (const char *query, font_face_t *out) {
+/** \brief `fontreg_resolve` без замка реєстру. */
+static int fontreg_resolve_unlocked (const char *query, font_face_t *out) {
     if (!out)
         return -1;
     font_face_t *faces = NULL;
@@ -987,3 +1066,47 @@ int fontreg_resolve (const char *query, font_face_t *out) {
         (query && *query) ? query : "<типовий>");
     return 0;
 }
+
+/** @copydoc fontreg_set_root */
+void fontreg_set_root (const char *path) {
+    fontreg_lock ();
+    fontreg_set_root_unlocked (path);
+    fontreg_unlock ();
+}
+
+/** @copydoc fontreg_list */
+int fontreg_list (font_face_t **faces, size_t *count) {
+    fontreg_lock ();
+    int rc = fontreg_list_unlocked (faces, count);
+    fontreg_unlock ();
+    return rc;
+}
+
+/** @copydoc fontreg_list_families */
+int fontreg_list_families (font_family_name_t **families, size_t *count) {
+    fontreg_lock ();
+    int rc = fontreg_list_families_unlocked (families, count);
+    fontreg_unlock ();
+    return rc;
+}
+
+/** @copydoc fontreg_select_face_for_codepoints */
+int fontreg_select_face_for_codepoints (
+    const char *preferred_family,
+    const uint32_t *codepoints,
+    size_t codepoint_count,
+    font_face_t *out_face) {
+    fontreg_lock ();
+    int rc = fontreg_select_face_for_codepoints_unlocked (
+        preferred_family, codepoints, codepoint_count, out_face);
+    fontreg_unlock ();
+    return rc;
+}
+
+/** @copydoc fontreg_resolve */
+int fontreg_resolve (const char *query, font_face_t *out) {
+    fontreg_lock ();
+    int rc = fontreg_resolve_unlocked (query, out);
+    fontreg_unlock ();
+    return rc;
+}
@@ -15,10 +15,20 @@
 #include <stdlib.h>
 #include <string.h>
 
-/** \brief FNV‑1a 64‑біт: початкове значення (offset basis). */
-#define GEOM_FNV64_OFFSET_BASIS 1469598103934665603ULL
-/** \brief FNV‑1a 64‑біт: множник (prime). */
-#define GEOM_FNV64_PRIME 1099511628211ULL
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define GEOM_SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GEOM_SIMD_NEON 1
+#endif
+
+/** \brief Хеш геометрії: множник смуг (простий, як у xxHash64). */
+#define GEOM_HASH_P1 11400714785074694791ULL
+/** \brief Хеш геометрії: множник вхідної пари. */
+#define GEOM_HASH_P2 14029467366897019727ULL
+/** \brief Хеш геометрії: множник і зсув перемішування. */
+#define GEOM_HASH_P3 1609587929392839161ULL
 /** \brief Кількість мікрометрів у 1 міліметрі (для квантування). */
 #define GEOM_MICROMETER_PER_MM 1000.0
 
@@ -29,10 +39,12 @@
 static void geom_path_free (geom_path_t *p) {
     if (!p)
         return;
-    free (p->pts);
+    if (!p->in_arena)
+        free (p->pts);
     p->pts = NULL;
     p->len = 0;
     p->cap = 0;
+    p->in_arena = false;
 }
 
 /**
@@ -45,6 +57,9 @@ int geom_paths_init (geom_paths_t *ps, geom_units_t units) {
     ps->len = 0;
     ps->cap = 0;
     ps->units = units;
+    ps->arena = NULL;
+    ps->arena_len = 0;
+    ps->arena_cap = 0;
     return 0;
 }
 
@@ -57,9 +72,44 @@ void geom_paths_free (geom_paths_t *ps) {
     for (size_t i = 0; i < ps->len; ++i)
         geom_path_free (&ps->items[i]);
     free (ps->items);
+    free (ps->arena);
     ps->items = NULL;
     ps->len = 0;
     ps->cap = 0;
+    ps->arena = NULL;
+    ps->arena_len = 0;
+    ps->arena_cap = 0;
+}
+
+/**
+ * @brief Гарантує місце для `extra` точок в арені контейнера.
+ * @details Арена росте геометрично; після переїзду буфера вказівники шляхів з
+ *          `in_arena` переносяться на нову адресу з тим самим зміщенням.
+ * @param ps Контейнер шляхів.
+ * @param extra Скільки точок треба додати.
+ * @return 0 — успіх; -1 — помилка виділення памʼяті.
+ */
+static int geom_paths_arena_reserve (geom_paths_t *ps, size_t extra) {
+    size_t need = ps->arena_len + extra;
+    if (need <= ps->arena_cap)
+        return 0;
+    size_t cap = ps->arena_cap ? ps->arena_cap : 256;
+    while (cap < need)
+        cap *= 2;
+    geom_point_t *grown = (geom_point_t *)malloc (cap * sizeof (*grown));
+    if (!grown)
+        return -1;
+    if (ps->arena_len > 0)
+        memcpy (grown, ps->arena, ps->arena_len * sizeof (*grown));
+    for (size_t i = 0; i < ps->len; ++i) {
+        geom_path_t *p = &ps->items[i];
+        if (p->in_arena && p->pts)
+            p->pts = grown + (p->pts - ps->arena);
+    }
+    free (ps->arena);
+    ps->arena = grown;
+    ps->arena_cap = cap;
+    return 0;
 }
 
 /**
@@ -71,6 +121,7 @@ int geom_path_init (geom_path_t *p, size_t cap0) {
     p->pts = NULL;
     p->len = 0;
     p->cap = 0;
+    p->in_arena = false;
     if (cap0 > 0) {
         p->pts = (geom_point_t *)malloc (cap0 * sizeof (*p->pts));
         if (!p->pts)
@@ -91,6 +142,18 @@ int geom_path_reserve (geom_path_t *p, size_t new_cap) {
     size_t cap = p->cap ? p->cap : 1;
     while (cap < new_cap)
         cap *= 2;
+    if (p->in_arena) {
+        /* Зріз арени не можна розширити на місці — шлях отримує власний буфер. */
+        geom_point_t *own = (geom_point_t *)malloc (cap * sizeof (*own));
+        if (!own)
+            return -1;
+        if (p->len > 0)
+            memcpy (own, p->pts, p->len * sizeof (*own));
+        p->pts = own;
+        p->cap = cap;
+        p->in_arena = false;
+        return 0;
+    }
     geom_point_t *grown = (geom_point_t *)realloc (p->pts, cap * sizeof (*grown));
     if (!grown)
         return -1;
@@ -135,21 +198,40 @@ int geom_path_push (geom_path_t *p, double x, double y) {
 }
 
 /**
- * @copydoc geom_paths_push_path
+ * @copydoc geom_paths_add_path
  */
-int geom_paths_push_path (geom_paths_t *ps, const geom_point_t *pts, size_t len) {
-    if (!ps || (len > 0 && !pts))
+int geom_paths_add_path (geom_paths_t *ps, size_t len, geom_point_t **out_pts) {
+    if (out_pts)
+        *out_pts = NULL;
+    if (!ps)
         return -1;
     if (geom_paths_reserve (ps, ps->len + 1) != 0)
         return -1;
-    geom_path_t *dst = &ps->items[ps->len];
-    if (geom_path_init (dst, len) != 0)
+    if (len > 0 && geom_paths_arena_reserve (ps, len) != 0)
         return -1;
-    if (len > 0) {
-        memcpy (dst->pts, pts, len * sizeof (*pts));
-        dst->len = len;
-    }
+    geom_path_t *dst = &ps->items[ps->len];
+    dst->pts = len > 0 ? ps->arena + ps->arena_len : NULL;
+    dst->len = len;
+    dst->cap = len;
+    dst->in_arena = len > 0;
+    ps->arena_len += len;
     ps->len++;
+    if (out_pts)
+        *out_pts = dst->pts;
+    return 0;
+}
+
+/**
+ * @copydoc geom_paths_push_path
+ */
+int geom_paths_push_path (geom_paths_t *ps, const geom_point_t *pts, size_t len) {
+    if (!ps || (len > 0 && !pts))
+        return -1;
+    geom_point_t *dst = NULL;
+    if (geom_paths_add_path (ps, len, &dst) != 0)
+        return -1;
+    if (len > 0)
+        memcpy (dst, pts, len * sizeof (*pts));
     return 0;
 }
 
@@ -161,20 +243,70 @@ int geom_paths_deep_copy (const geom_paths_t *src, geom_paths_t *dst) {
         return -1;
     if (geom_paths_init (dst, src->units) != 0)
         return -1;
-    if (geom_paths_reserve (dst, src->len) != 0)
+    if (geom_paths_append (dst, src) != 0) {
+        geom_paths_free (dst);
         return -1;
+    }
+    return 0;
+}
+
+/**
+ * @copydoc geom_paths_extend
+ */
+int geom_paths_extend (
+    geom_paths_t *ps,
+    size_t path_count,
+    size_t point_count,
+    geom_path_t **out_items,
+    geom_point_t **out_points) {
+    if (!ps)
+        return -1;
+    if (geom_paths_reserve (ps, ps->len + path_count) != 0
+        || (point_count > 0 && geom_paths_arena_reserve (ps, point_count) != 0))
+        return -1;
+    geom_path_t *items = ps->items + ps->len;
+    if (path_count > 0)
+        memset (items, 0, path_count * sizeof (*items));
+    if (out_items)
+        *out_items = items;
+    if (out_points)
+        *out_points = ps->arena ? ps->arena + ps->arena_len : NULL;
+    ps->len += path_count;
+    ps->arena_len += point_count;
+    return 0;
+}
+
+/**
+ * @copydoc geom_paths_copy_to
+ */
+void geom_paths_copy_to (const geom_paths_t *src, geom_path_t *items, geom_point_t *points) {
     for (size_t i = 0; i < src->len; ++i) {
         const geom_path_t *sp = &src->items[i];
-        if (geom_path_init (&dst->items[i], sp->len) != 0) {
-            geom_paths_free (dst);
-            return -1;
-        }
+        geom_path_t *dp = &items[i];
+        dp->pts = sp->len > 0 ? points : NULL;
+        dp->len = sp->len;
+        dp->cap = sp->len;
+        dp->in_arena = sp->len > 0;
         if (sp->len > 0)
-            memcpy (dst->items[i].pts, sp->pts, sp->len * sizeof (*sp->pts));
-        dst->items[i].len = sp->len;
+            memcpy (dp->pts, sp->pts, sp->len * sizeof (*sp->pts));
+        points += sp->len;
     }
-    dst->len = src->len;
-    dst->cap = src->len ? src->len : dst->cap;
+}
+
+/**
+ * @copydoc geom_paths_append
+ */
+int geom_paths_append (geom_paths_t *dst, const geom_paths_t *src) {
+    if (!dst || !src)
+        return -1;
+    size_t total = 0;
+    for (size_t i = 0; i < src->len; ++i)
+        total += src->items[i].len;
+    geom_path_t *items = NULL;
+    geom_point_t *points = NULL;
+    if (geom_paths_extend (dst, src->len, total, &items, &points) != 0)
+        return -1;
+    geom_paths_copy_to (src, items, points);
     return 0;
 }
 
@@ -194,6 +326,168 @@ static int geom_paths_clone (const geom_paths_t *src, geom_paths_t *dst) {
     return 0;
 }
 
+/**
+ * @copydoc geom_affine_translation
+ */
+geom_affine_t geom_affine_translation (double dx, double dy) {
+    return (geom_affine_t){ 1.0, 0.0, 0.0, 1.0, dx, dy };
+}
+
+/**
+ * @copydoc geom_affine_scaling
+ */
+geom_affine_t geom_affine_scaling (double sx, double sy) {
+    return (geom_affine_t){ sx, 0.0, 0.0, sy, 0.0, 0.0 };
+}
+
+/**
+ * @copydoc geom_affine_rotation
+ */
+geom_affine_t geom_affine_rotation (double radians, double cx, double cy) {
+    double s = sin (radians);
+    double c = cos (radians);
+    return (geom_affine_t){ c, s, -s, c, cx - (cx * c - cy * s), cy - (cx * s + cy * c) };
+}
+
+/**
+ * @copydoc geom_affine_then
+ */
+geom_affine_t geom_affine_then (const geom_affine_t *first, const geom_affine_t *then) {
+    const geom_affine_t *p = first;
+    const geom_affine_t *q = then;
+    return (geom_affine_t){
+        q->a * p->a + q->c * p->b,        q->b * p->a + q->d * p->b,
+        q->a * p->c + q->c * p->d,        q->b * p->c + q->d * p->d,
+        q->a * p->e + q->c * p->f + q->e, q->b * p->e + q->d * p->f + q->f,
+    };
+}
+
+/**
+ * @brief Перетворює суцільний зріз точок і розширює межі `bb` результатом.
+ * @param m Перетворення.
+ * @param pts [in,out] Точки.
+ * @param n Кількість точок.
+ * @param bb [in,out] Накопичені межі.
+ */
+static void
+geom_affine_apply_run (const geom_affine_t *m, geom_point_t *pts, size_t n, geom_bbox_t *bb) {
+#if defined(GEOM_SIMD_SSE2)
+    /* Точка (x,y) — один регістр: [x',y'] = [a,b]·x + [c,d]·y + [e,f]. */
+    const __m128d col_x = _mm_set_pd (m->b, m->a);
+    const __m128d col_y = _mm_set_pd (m->d, m->c);
+    const __m128d off = _mm_set_pd (m->f, m->e);
+    __m128d lo = _mm_set_pd (bb->min_y, bb->min_x);
+    __m128d hi = _mm_set_pd (bb->max_y, bb->max_x);
+    for (size_t i = 0; i < n; ++i) {
+        __m128d p = _mm_loadu_pd (&pts[i].x);
+        __m128d r = _mm_add_pd (
+            _mm_add_pd (
+                _mm_mul_pd (col_x, _mm_unpacklo_pd (p, p)),
+                _mm_mul_pd (col_y, _mm_unpackhi_pd (p, p))),
+            off);
+        _mm_storeu_pd (&pts[i].x, r);
+        lo = _mm_min_pd (lo, r);
+        hi = _mm_max_pd (hi, r);
+    }
+    double lo_v[2], hi_v[2];
+    _mm_storeu_pd (lo_v, lo);
+    _mm_storeu_pd (hi_v, hi);
+    bb->min_x = lo_v[0];
+    bb->min_y = lo_v[1];
+    bb->max_x = hi_v[0];
+    bb->max_y = hi_v[1];
+#elif defined(GEOM_SIMD_NEON)
+    const double cx_v[2] = { m->a, m->b };
+    const double cy_v[2] = { m->c, m->d };
+    const double off_v[2] = { m->e, m->f };
+    const double lo_v0[2] = { bb->min_x, bb->min_y };
+    const double hi_v0[2] = { bb->max_x, bb->max_y };
+    const float64x2_t col_x = vld1q_f64 (cx_v);
+    const float64x2_t col_y = vld1q_f64 (cy_v);
+    const float64x2_t off = vld1q_f64 (off_v);
+    float64x2_t lo = vld1q_f64 (lo_v0);
+    float64x2_t hi = vld1q_f64 (hi_v0);
+    for (size_t i = 0; i < n; ++i) {
+        float64x2_t p = vld1q_f64 (&pts[i].x);
+        float64x2_t r = vaddq_f64 (
+            vaddq_f64 (
+                vmulq_f64 (col_x, vdupq_laneq_f64 (p, 0)),
+                vmulq_f64 (col_y, vdupq_laneq_f64 (p, 1))),
+            off);
+        vst1q_f64 (&pts[i].x, r);
+        lo = vminq_f64 (lo, r);
+        hi = vmaxq_f64 (hi, r);
+    }
+    bb->min_x = vgetq_lane_f64 (lo, 0);
+    bb->min_y = vgetq_lane_f64 (lo, 1);
+    bb->max_x = vgetq_lane_f64 (hi, 0);
+    bb->max_y = vgetq_lane_f64 (hi, 1);
+#else
+    for (size_t i = 0; i < n; ++i) {
+        double x = pts[i].x;
+        double y = pts[i].y;
+        double xr = m->a * x + m->c * y + m->e;
+        double yr = m->b * x + m->d * y + m->f;
+        pts[i].x = xr;
+        pts[i].y = yr;
+        if (xr < bb->min_x)
+            bb->min_x = xr;
+        if (xr > bb->max_x)
+            bb->max_x = xr;
+        if (yr < bb->min_y)
+            bb->min_y = yr;
+        if (yr > bb->max_y)
+            bb->max_y = yr;
+    }
+#endif
+}
+
+/**
+ * @copydoc geom_paths_transform
+ */
+int geom_paths_transform (geom_paths_t *ps, const geom_affine_t *m, geom_bbox_t *out_bbox) {
+    if (!ps || !m)
+        return -1;
+    geom_bbox_t bb = { HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+    bool has_point = false;
+    for (size_t i = 0; i < ps->len; ++i) {
+        geom_path_t *p = &ps->items[i];
+        if (p->len == 0)
+            continue;
+        geom_affine_apply_run (m, p->pts, p->len, &bb);
+        has_point = true;
+    }
+    if (!has_point)
+        return 1;
+    if (out_bbox)
+        *out_bbox = bb;
+    return 0;
+}
+
+/**
+ * @copydoc geom_paths_translate_inplace
+ */
+int geom_paths_translate_inplace (geom_paths_t *ps, double dx, double dy) {
+    geom_affine_t m = geom_affine_translation (dx, dy);
+    return geom_paths_transform (ps, &m, NULL) < 0 ? -1 : 0;
+}
+
+/**
+ * @copydoc geom_paths_scale_inplace
+ */
+int geom_paths_scale_inplace (geom_paths_t *ps, double sx, double sy) {
+    geom_affine_t m = geom_affine_scaling (sx, sy);
+    return geom_paths_transform (ps, &m, NULL) < 0 ? -1 : 0;
+}
+
+/**
+ * @copydoc geom_paths_rotate_inplace
+ */
+int geom_paths_rotate_inplace (geom_paths_t *ps, double radians, double cx, double cy) {
+    geom_affine_t m = geom_affine_rotation (radians, cx, cy);
+    return geom_paths_transform (ps, &m, NULL) < 0 ? -1 : 0;
+}
+
 /**
  * @copydoc geom_paths_translate
  */
@@ -202,14 +496,7 @@ int geom_paths_translate (const geom_paths_t *a, double dx, double dy, geom_path
         return -1;
     if (geom_paths_clone (a, out) != 0)
         return -1;
-    for (size_t i = 0; i < out->len; ++i) {
-        geom_path_t *p = &out->items[i];
-        for (size_t j = 0; j < p->len; ++j) {
-            p->pts[j].x += dx;
-            p->pts[j].y += dy;
-        }
-    }
-    return 0;
+    return geom_paths_translate_inplace (out, dx, dy);
 }
 
 /**
@@ -220,14 +507,7 @@ int geom_paths_scale (const geom_paths_t *a, double sx, double sy, geom_paths_t
         return -1;
     if (geom_paths_clone (a, out) != 0)
         return -1;
-    for (size_t i = 0; i < out->len; ++i) {
-        geom_path_t *p = &out->items[i];
-        for (size_t j = 0; j < p->len; ++j) {
-            p->pts[j].x *= sx;
-            p->pts[j].y *= sy;
-        }
-    }
-    return 0;
+    return geom_paths_scale_inplace (out, sx, sy);
 }
 
 /**
@@ -239,20 +519,7 @@ int geom_paths_rotate (
         return -1;
     if (geom_paths_clone (a, out) != 0)
         return -1;
-    double s = sin (radians);
-    double c = cos (radians);
-    for (size_t i = 0; i < out->len; ++i) {
-        geom_path_t *p = &out->items[i];
-        for (size_t j = 0; j < p->len; ++j) {
-            double x = p->pts[j].x - cx;
-            double y = p->pts[j].y - cy;
-            double xr = x * c - y * s;
-            double yr = x * s + y * c;
-            p->pts[j].x = xr + cx;
-            p->pts[j].y = yr + cy;
-        }
-    }
-    return 0;
+    return geom_paths_rotate_inplace (out, radians, cx, cy);
 }
 
 /**
@@ -378,26 +645,28 @@ static double geom_unit_scale (geom_units_t from, geom_units_t to) {
     return 1.0;
 }
 
+/**
+ * @copydoc geom_paths_convert_inplace
+ */
+int geom_paths_convert_inplace (geom_paths_t *ps, geom_units_t to) {
+    if (!ps)
+        return -1;
+    double scale = geom_unit_scale (ps->units, to);
+    if (scale != 1.0 && geom_paths_scale_inplace (ps, scale, scale) != 0)
+        return -1;
+    ps->units = to;
+    return 0;
+}
+
 /**
  * @copydoc geom_paths_convert
  */
 int geom_paths_convert (const geom_paths_t *a, geom_units_t to, geom_paths_t *out) {
     if (!a || !out)
         return -1;
-    double scale = geom_unit_scale (a->units, to);
     if (geom_paths_clone (a, out) != 0)
         return -1;
-    if (scale != 1.0) {
-        for (size_t i = 0; i < out->len; ++i) {
-            geom_path_t *p = &out->items[i];
-            for (size_t j = 0; j < p->len; ++j) {
-                p->pts[j].x *= scale;
-                p->pts[j].y *= scale;
-            }
-        }
-    }
-    out->units = to;
-    return 0;
+    return geom_paths_convert_inplace (out, to);
 }
 
 /**
@@ -409,6 +678,294 @@ int geom_paths_normalize (const geom_paths_t *a, geom_paths_t *out) {
     return geom_paths_clone (a, out);
 }
 
+/**
+ * Кінець шляху в індексі зшивання.
+ */
+typedef struct {
+    uint64_t key; /**< Квантована клітинка (x, y). */
+    size_t end;   /**< 2·шлях + (0 — початок, 1 — кінець). */
+} geom_join_entry_t;
+
+/** \brief Пакує координати клітинки у ключ. */
+static uint64_t geom_join_key (int64_t cx, int64_t cy) {
+    return ((uint64_t)(uint32_t)(int32_t)cx << 32) | (uint64_t)(uint32_t)(int32_t)cy;
+}
+
+/** \brief Порівняння записів індексу (за ключем, потім за номером кінця). */
+static int geom_join_entry_cmp (const void *pa, const void *pb) {
+    const geom_join_entry_t *a = (const geom_join_entry_t *)pa;
+    const geom_join_entry_t *b = (const geom_join_entry_t *)pb;
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    return (a->end > b->end) - (a->end < b->end);
+}
+
+/**
+ * Індекс кінців шляхів для пошуку збігів у межах допуску.
+ */
+typedef struct {
+    const geom_paths_t *ps;    /**< Вихідні шляхи. */
+    geom_join_entry_t *items;  /**< Відсортовані записи. */
+    size_t count;              /**< Кількість записів. */
+    double cell;               /**< Розмір клітинки (≥ допуску). */
+    double tol;                /**< Допуск збігу. */
+    const unsigned char *used; /**< Позначки використаних шляхів. */
+} geom_join_index_t;
+
+/** \brief Точка кінця `end` (2·шлях + бік). */
+static const geom_point_t *geom_join_point (const geom_paths_t *ps, size_t end) {
+    const geom_path_t *p = &ps->items[end / 2];
+    return (end % 2) ? &p->pts[p->len - 1] : &p->pts[0];
+}
+
+/**
+ * @brief Шукає невикористаний шлях, кінець якого збігається з точкою.
+ * @return Номер кінця (2·шлях + бік) з найменшим індексом шляху або SIZE_MAX.
+ */
+static size_t geom_join_find (const geom_join_index_t *ix, const geom_point_t *pt) {
+    int64_t cx = (int64_t)floor (pt->x / ix->cell);
+    int64_t cy = (int64_t)floor (pt->y / ix->cell);
+    size_t best = SIZE_MAX;
+    for (int64_t dx = -1; dx <= 1; ++dx) {
+        for (int64_t dy = -1; dy <= 1; ++dy) {
+            geom_join_entry_t probe = { geom_join_key (cx + dx, cy + dy), 0 };
+            size_t lo = 0, hi = ix->count;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (ix->items[mid].key < probe.key)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            for (size_t i = lo; i < ix->count && ix->items[i].key == probe.key; ++i) {
+                size_t end = ix->items[i].end;
+                if (ix->used[end / 2] || end >= best)
+                    continue;
+                if (geom_point_eq (geom_join_point (ix->ps, end), pt, ix->tol))
+                    best = end;
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Додає точки шляху до ланцюга (опційно у зворотному порядку).
+ * @param skip_first true — перша додана точка збігається з кінцем ланцюга.
+ */
+static int geom_chain_append (
+    geom_path_t *chain, const geom_path_t *p, bool reverse, bool skip_first) {
+    if (geom_path_reserve (chain, chain->len + p->len) != 0)
+        return -1;
+    for (size_t k = skip_first ? 1u : 0u; k < p->len; ++k) {
+        const geom_point_t *pt = reverse ? &p->pts[p->len - 1 - k] : &p->pts[k];
+        chain->pts[chain->len++] = *pt;
+    }
+    return 0;
+}
+
+/** \brief Розвертає порядок точок шляху на місці. */
+static void geom_path_reverse (geom_path_t *p) {
+    for (size_t l = 0, r = p->len ? p->len - 1 : 0; l < r; ++l, --r) {
+        geom_point_t t = p->pts[l];
+        p->pts[l] = p->pts[r];
+        p->pts[r] = t;
+    }
+}
+
+/**
+ * @brief Дописує до хвоста ланцюга шляхи, що продовжують його в межах допуску.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int geom_chain_extend (geom_join_index_t *ix, unsigned char *used, geom_path_t *chain) {
+    for (;;) {
+        size_t end = geom_join_find (ix, &chain->pts[chain->len - 1]);
+        if (end == SIZE_MAX)
+            return 0;
+        used[end / 2] = 1;
+        if (geom_chain_append (chain, &ix->ps->items[end / 2], end % 2 == 1, true) != 0)
+            return -1;
+    }
+}
+
+/** \brief Квадрат відстані від точки до відрізка [a, b]. */
+static double
+geom_seg_dist2 (const geom_point_t *p, const geom_point_t *a, const geom_point_t *b) {
+    double vx = b->x - a->x, vy = b->y - a->y;
+    double wx = p->x - a->x, wy = p->y - a->y;
+    double len2 = vx * vx + vy * vy;
+    double t = (len2 > 0.0) ? (wx * vx + wy * vy) / len2 : 0.0;
+    if (t < 0.0)
+        t = 0.0;
+    else if (t > 1.0)
+        t = 1.0;
+    double dx = wx - t * vx, dy = wy - t * vy;
+    return dx * dx + dy * dy;
+}
+
+/**
+ * @brief Прибирає повтори й колінеарні точки на місці.
+ * @details Точка колінеарна, якщо лежить на відрізку між сусідами (відхилення ≤ 1e-9).
+ */
+static void geom_path_drop_collinear (geom_path_t *p) {
+    if (p->len < 3)
+        return;
+    size_t w = 1;
+    for (size_t i = 1; i < p->len; ++i) {
+        if (geom_point_eq (&p->pts[i], &p->pts[w - 1], 1e-12) && i + 1 < p->len)
+            continue;
+        if (w >= 2 && geom_seg_dist2 (&p->pts[w - 1], &p->pts[w - 2], &p->pts[i]) <= 1e-18) {
+            p->pts[w - 1] = p->pts[i];
+            continue;
+        }
+        p->pts[w++] = p->pts[i];
+    }
+    p->len = w;
+}
+
+/**
+ * @brief Рамер–Дуглас–Пекер на місці (ітеративно, з явним стеком).
+ * @details Позначки й стек беруться з арени й повертаються до її позначки на виході.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int geom_path_rdp (geom_path_t *p, double tol, jobarena_t *arena) {
+    if (p->len < 3 || !(tol > 0.0))
+        return 0;
+    jobarena_mark_t mark = jobarena_mark (arena);
+    unsigned char *keep = (unsigned char *)jobarena_calloc (arena, p->len, 1);
+    size_t *stack = (size_t *)jobarena_alloc (arena, 2 * p->len * sizeof (size_t));
+    if (!keep || !stack) {
+        jobarena_release (arena, keep);
+        jobarena_release (arena, stack);
+        jobarena_rewind (arena, mark);
+        return -1;
+    }
+    double tol2 = tol * tol;
+    size_t top = 0;
+    keep[0] = keep[p->len - 1] = 1;
+    stack[top++] = 0;
+    stack[top++] = p->len - 1;
+    while (top > 0) {
+        size_t hi = stack[--top];
+        size_t lo = stack[--top];
+        double worst = -1.0;
+        size_t at = lo;
+        for (size_t i = lo + 1; i < hi; ++i) {
+            double d2 = geom_seg_dist2 (&p->pts[i], &p->pts[lo], &p->pts[hi]);
+            if (d2 > worst) {
+                worst = d2;
+                at = i;
+            }
+        }
+        if (worst > tol2) {
+            keep[at] = 1;
+            stack[top++] = lo;
+            stack[top++] = at;
+            stack[top++] = at;
+            stack[top++] = hi;
+        }
+    }
+    size_t w = 0;
+    for (size_t i = 0; i < p->len; ++i)
+        if (keep[i])
+            p->pts[w++] = p->pts[i];
+    p->len = w;
+    jobarena_release (arena, keep);
+    jobarena_release (arena, stack);
+    jobarena_rewind (arena, mark);
+    return 0;
+}
+
+/**
+ * @copydoc geom_paths_simplify
+ */
+int geom_paths_simplify (
+    const geom_paths_t *a,
+    double join_tol,
+    double rdp_tol,
+    geom_paths_t *out,
+    geom_simplify_stats_t *stats,
+    jobarena_t *arena) {
+    if (!a || !out || a == out || join_tol < 0.0 || rdp_tol < 0.0)
+        return -1;
+    geom_simplify_stats_t st = { .paths_before = a->len };
+    for (size_t i = 0; i < a->len; ++i)
+        st.points_before += a->items[i].len;
+
+    jobarena_mark_t mark = jobarena_mark (arena);
+    unsigned char *used = (unsigned char *)jobarena_calloc (arena, a->len ? a->len : 1, 1);
+    geom_join_entry_t *items = (geom_join_entry_t *)jobarena_alloc (
+        arena, (a->len ? 2 * a->len : 1) * sizeof (*items));
+    if (!used || !items) {
+        jobarena_release (arena, used);
+        jobarena_release (arena, items);
+        jobarena_rewind (arena, mark);
+        return -1;
+    }
+    geom_join_index_t ix = { .ps = a, .items = items, .used = used, .tol = join_tol };
+    ix.cell = (join_tol > 1e-9) ? join_tol : 1e-9;
+    /* Клітинка ≥ допуску: збіг завжди лежить у сусідніх 3×3 клітинках. */
+    for (size_t i = 0; i < a->len; ++i) {
+        const geom_path_t *p = &a->items[i];
+        if (p->len == 0) {
+            used[i] = 1;
+            continue;
+        }
+        for (size_t side = 0; side < 2; ++side) {
+            const geom_point_t *pt = geom_join_point (a, 2 * i + side);
+            items[ix.count].key = geom_join_key (
+                (int64_t)floor (pt->x / ix.cell), (int64_t)floor (pt->y / ix.cell));
+            items[ix.count].end = 2 * i + side;
+            ++ix.count;
+        }
+    }
+    qsort (items, ix.count, sizeof (*items), geom_join_entry_cmp);
+
+    geom_paths_t res;
+    geom_paths_init (&res, a->units);
+    /* Ланцюг збирається в одному робочому буфері й копіюється в арену результату. */
+    geom_path_t chain;
+    geom_path_init (&chain, 0);
+    int rc = 0;
+    for (size_t i = 0; i < a->len && rc == 0; ++i) {
+        if (used[i])
+            continue;
+        used[i] = 1;
+        chain.len = 0;
+        rc = geom_chain_append (&chain, &a->items[i], false, false);
+        if (rc == 0)
+            rc = geom_chain_extend (&ix, used, &chain);
+        /* Голова: розвертаємо ланцюг, продовжуємо хвіст і повертаємо напрям. */
+        if (rc == 0 && geom_join_find (&ix, &chain.pts[0]) != SIZE_MAX) {
+            geom_path_reverse (&chain);
+            rc = geom_chain_extend (&ix, used, &chain);
+            geom_path_reverse (&chain);
+        }
+        if (rc == 0) {
+            geom_path_drop_collinear (&chain);
+            rc = geom_path_rdp (&chain, rdp_tol, arena);
+        }
+        if (rc == 0 && geom_paths_push_path (&res, chain.pts, chain.len) != 0)
+            rc = -1;
+        if (rc != 0)
+            break;
+        st.points_after += chain.len;
+    }
+    geom_path_free (&chain);
+    jobarena_release (arena, used);
+    jobarena_release (arena, items);
+    jobarena_rewind (arena, mark);
+    if (rc != 0) {
+        geom_paths_free (&res);
+        return -1;
+    }
+    st.paths_after = res.len;
+    *out = res;
+    if (stats)
+        *stats = st;
+    return 0;
+}
+
 /**
  * @copydoc geom_point_eq
  */
@@ -418,27 +975,106 @@ int geom_point_eq (const geom_point_t *a, const geom_point_t *b, double tol) {
     return fabs (a->x - b->x) <= tol && fabs (a->y - b->y) <= tol;
 }
 
+/** \brief Циклічний зсув ліворуч. */
+static uint64_t geom_hash_rotl (uint64_t v, unsigned r) {
+    return (v << r) | (v >> (64u - r));
+}
+
+#if !defined(GEOM_SIMD_SSE2)
+/** \brief Квантує координату до тисячних (поза `int32` і NaN — `INT32_MIN`, як у SSE2). */
+static uint32_t geom_hash_quantize (double v) {
+    v *= GEOM_MICROMETER_PER_MM;
+    if (!(v > -2147483648.5 && v < 2147483647.5))
+        return 0x80000000u;
+    return (uint32_t)(int32_t)lrint (v);
+}
+#endif
+
+/** \brief Квантована точка: X у молодших 32 бітах, Y — у старших. */
+static uint64_t geom_hash_pair (const geom_point_t *p) {
+#if defined(GEOM_SIMD_SSE2)
+    /* Одне множення і одне перетворення на пару; округлення — до парного, як `lrint`. */
+    const __m128d scale = _mm_set1_pd (GEOM_MICROMETER_PER_MM);
+    __m128i q = _mm_cvtpd_epi32 (_mm_mul_pd (_mm_loadu_pd (&p->x), scale));
+    uint64_t k;
+    _mm_storel_epi64 ((__m128i *)&k, q);
+    return k;
+#else
+    return (uint64_t)geom_hash_quantize (p->x) | ((uint64_t)geom_hash_quantize (p->y) << 32);
+#endif
+}
+
+/** \brief Крок смуги: додати пару з множником, перемішати зсувом і множенням. */
+static uint64_t geom_hash_round (uint64_t acc, uint64_t k) {
+    acc += k * GEOM_HASH_P2;
+    return geom_hash_rotl (acc, 31) * GEOM_HASH_P1;
+}
+
+/**
+ * @copydoc geom_hash_init
+ */
+void geom_hash_init (geom_hash_t *h) {
+    if (h)
+        h->state = GEOM_HASH_P3;
+}
+
+/**
+ * @copydoc geom_hash_path
+ * @details Точки розкладаються по чотирьох смугах (точка `i` — у смугу `i % 4`):
+ * ланцюги множень смуг незалежні, тож процесор веде їх паралельно. Смуги
+ * засіваються поточним станом, а після шляху зводяться разом із довжиною і
+ * перемішуються заново — так межі шляхів розрізняються.
+ */
+void geom_hash_path (geom_hash_t *h, const geom_point_t *pts, size_t len) {
+    if (!h || (len > 0 && !pts))
+        return;
+    uint64_t seed = h->state;
+    uint64_t v0 = seed + GEOM_HASH_P1 + GEOM_HASH_P2;
+    uint64_t v1 = seed + GEOM_HASH_P2;
+    uint64_t v2 = seed;
+    uint64_t v3 = seed - GEOM_HASH_P1;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        v0 = geom_hash_round (v0, geom_hash_pair (&pts[i]));
+        v1 = geom_hash_round (v1, geom_hash_pair (&pts[i + 1]));
+        v2 = geom_hash_round (v2, geom_hash_pair (&pts[i + 2]));
+        v3 = geom_hash_round (v3, geom_hash_pair (&pts[i + 3]));
+    }
+    if (i < len)
+        v0 = geom_hash_round (v0, geom_hash_pair (&pts[i++]));
+    if (i < len)
+        v1 = geom_hash_round (v1, geom_hash_pair (&pts[i++]));
+    if (i < len)
+        v2 = geom_hash_round (v2, geom_hash_pair (&pts[i++]));
+
+    uint64_t acc = geom_hash_rotl (v0, 1) + geom_hash_rotl (v1, 7) + geom_hash_rotl (v2, 12)
+                   + geom_hash_rotl (v3, 18);
+    const uint64_t lanes[4] = { v0, v1, v2, v3 };
+    for (int k = 0; k < 4; ++k)
+        acc = (acc ^ geom_hash_round (0, lanes[k])) * GEOM_HASH_P1 + GEOM_HASH_P3;
+    acc ^= (uint64_t)len * GEOM_HASH_P2;
+    acc ^= acc >> 33;
+    acc *= GEOM_HASH_P2;
+    acc ^= acc >> 29;
+    acc *= GEOM_HASH_P3;
+    acc ^= acc >> 32;
+    h->state = acc;
+}
+
+/**
+ * @copydoc geom_hash_value
+ */
+uint64_t geom_hash_value (const geom_hash_t *h) { return h ? h->state : 0; }
+
 /**
  * @copydoc geom_paths_hash_micro_mm
- * @details Використовує FNV‑1a 64‑біт із константами
- * GEOM_FNV64_OFFSET_BASIS та GEOM_FNV64_PRIME; координати квантуються
- * до мікрометрів множенням на GEOM_MICROMETER_PER_MM та округленням.
  */
 uint64_t geom_paths_hash_micro_mm (const geom_paths_t *ps) {
     if (!ps)
         return 0;
-    uint64_t hash = GEOM_FNV64_OFFSET_BASIS;
-    const double scale = GEOM_MICROMETER_PER_MM;
-    for (size_t i = 0; i < ps->len; ++i) {
-        const geom_path_t *p = &ps->items[i];
-        for (size_t j = 0; j < p->len; ++j) {
-            uint64_t xi = (uint64_t)llabs ((long long)llround (p->pts[j].x * scale));
-            uint64_t yi = (uint64_t)llabs ((long long)llround (p->pts[j].y * scale));
-            hash ^= xi;
-            hash *= GEOM_FNV64_PRIME;
-            hash ^= yi;
-            hash *= GEOM_FNV64_PRIME;
-        }
-    }
-    return hash;
+    geom_hash_t h;
+    geom_hash_init (&h);
+    for (size_t i = 0; i < ps->len; ++i)
+        geom_hash_path (&h, ps->items[i].pts, ps->items[i].len);
+    return geom_hash_value (&h);
 }
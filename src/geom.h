@@ -11,6 +11,9 @@
 #ifndef GEOM_H
 #define GEOM_H
 
+#include "jobarena.h"
+
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -40,6 +43,18 @@ typedef struct {
     double max_y; /**< Максимальна Y‑координата. */
 } geom_bbox_t;
 
+/**
+ * Афінне перетворення 2×3: `x' = a·x + c·y + e`, `y' = b·x + d·y + f`.
+ */
+typedef struct {
+    double a; /**< Внесок X у X'. */
+    double b; /**< Внесок X у Y'. */
+    double c; /**< Внесок Y у X'. */
+    double d; /**< Внесок Y у Y'. */
+    double e; /**< Зсув по X. */
+    double f; /**< Зсув по Y. */
+} geom_affine_t;
+
 /**
  * Один відкритий шлях (полілінія).
  */
@@ -47,16 +62,25 @@ typedef struct {
     geom_point_t *pts; /**< Масив точок шляху (довжина `len`). */
     size_t len;        /**< Кількість точок у шляху. */
     size_t cap;        /**< Ємність виділеного масиву `pts`. */
+    bool in_arena;     /**< Точки лежать в арені контейнера і не звільняються окремо. */
 } geom_path_t;
 
 /**
  * Набір шляхів з однаковими одиницями виміру.
+ * @details Точки шляхів, доданих через `geom_paths_push_path`/`geom_paths_add_path`
+ * і скопійованих `geom_paths_deep_copy`, лежать в одному суцільному буфері `arena`
+ * (шлях — зріз `pts[0..len)` цього буфера). Шляхи можна переставляти в межах
+ * контейнера, але не переносити в інший контейнер. Шлях, що росте через
+ * `geom_path_push`, виходить з арени у власний буфер.
  */
 typedef struct {
-    geom_path_t *items; /**< Масив шляхів (довжина `len`). */
-    size_t len;         /**< Кількість наявних шляхів. */
-    size_t cap;         /**< Ємність виділеного масиву `items`. */
-    geom_units_t units; /**< Одиниці виміру для всіх шляхів. */
+    geom_path_t *items;  /**< Масив шляхів (довжина `len`). */
+    size_t len;          /**< Кількість наявних шляхів. */
+    size_t cap;          /**< Ємність виділеного масиву `items`. */
+    geom_units_t units;  /**< Одиниці виміру для всіх шляхів. */
+    geom_point_t *arena; /**< Спільний буфер точок шляхів з `in_arena`. */
+    size_t arena_len;    /**< Зайнято точок в арені. */
+    size_t arena_cap;    /**< Ємність арени (точок). */
 } geom_paths_t;
 
 /**
@@ -123,6 +147,53 @@ int geom_path_push (geom_path_t *p, double x, double y);
  */
 int geom_paths_push_path (geom_paths_t *ps, const geom_point_t *pts, size_t len);
 
+/**
+ * @brief Додає новий шлях із `len` точок в арені контейнера.
+ * @details Точки не ініціалізуються: викликач заповнює `pts[0..len)` сам. Вказівник
+ *          дійсний до наступного додавання шляху в цей контейнер.
+ * @param ps Набір шляхів.
+ * @param len Кількість точок (0 — порожній шлях).
+ * @param out_pts [out] Точки нового шляху (може бути `NULL`).
+ * @return 0 — успіх; -1 — помилка аргументів або виділення памʼяті.
+ */
+int geom_paths_add_path (geom_paths_t *ps, size_t len, geom_point_t **out_pts);
+
+/**
+ * @brief Дописує в кінець набору `path_count` шляхів зі спільними `point_count` точками.
+ * @details Нові шляхи обнулені, а точки не ініціалізовані: викликач розподіляє їх між
+ *          шляхами сам (`geom_paths_copy_to`). Різні шляхи можна заповнювати паралельно.
+ *          Вказівники дійсні до наступного додавання шляхів у цей контейнер.
+ * @param ps Набір шляхів.
+ * @param path_count Кількість нових шляхів.
+ * @param point_count Сумарна кількість їхніх точок.
+ * @param out_items [out] Перший новий шлях (може бути `NULL`).
+ * @param out_points [out] Перша нова точка в арені (може бути `NULL`).
+ * @return 0 — успіх; -1 — помилка аргументів або виділення памʼяті.
+ */
+int geom_paths_extend (
+    geom_paths_t *ps,
+    size_t path_count,
+    size_t point_count,
+    geom_path_t **out_items,
+    geom_point_t **out_points);
+
+/**
+ * @brief Копіює шляхи `src` у підготовлені `geom_paths_extend` слоти.
+ * @param src Джерело.
+ * @param items [out] Слоти під `src->len` шляхів.
+ * @param points [out] Точки арени під усі точки `src`.
+ */
+void geom_paths_copy_to (const geom_paths_t *src, geom_path_t *items, geom_point_t *points);
+
+/**
+ * @brief Дописує копії всіх шляхів `src` у кінець `dst` у тому ж порядку.
+ * @details Одиниці `src` мають збігатися з `dst`: точки копіюються без перетворення.
+ * @param dst Набір шляхів призначення.
+ * @param src Джерело.
+ * @return 0 — успіх; -1 — помилка аргументів або виділення памʼяті.
+ */
+int geom_paths_append (geom_paths_t *dst, const geom_paths_t *src);
+
 /**
  * @brief Зсув усіх шляхів на `dx`,`dy`.
  * @param a Вхідні шляхи.
@@ -155,6 +226,86 @@ int geom_paths_scale (const geom_paths_t *a, double sx, double sy, geom_paths_t
 int geom_paths_rotate (
     const geom_paths_t *a, double radians, double cx, double cy, geom_paths_t *out);
 
+/**
+ * @brief Матриця зсуву на `dx`,`dy`.
+ * @param dx Зсув по X.
+ * @param dy Зсув по Y.
+ * @return Перетворення.
+ */
+geom_affine_t geom_affine_translation (double dx, double dy);
+
+/**
+ * @brief Матриця масштабування відносно початку координат.
+ * @param sx Масштаб по осі X.
+ * @param sy Масштаб по осі Y.
+ * @return Перетворення.
+ */
+geom_affine_t geom_affine_scaling (double sx, double sy);
+
+/**
+ * @brief Матриця обертання навколо точки `(cx,cy)`.
+ * @param radians Кут у радіанах (додатний — проти годинникової стрілки).
+ * @param cx X‑координата центру обертання.
+ * @param cy Y‑координата центру обертання.
+ * @return Перетворення.
+ */
+geom_affine_t geom_affine_rotation (double radians, double cx, double cy);
+
+/**
+ * @brief Композиція перетворень: спершу `first`, потім `then`.
+ * @param first Перше перетворення.
+ * @param then Друге перетворення.
+ * @return Перетворення `then ∘ first`.
+ */
+geom_affine_t geom_affine_then (const geom_affine_t *first, const geom_affine_t *then);
+
+/**
+ * @brief Застосовує афінне перетворення до всіх точок на місці за один прохід.
+ * @details Межовий прямокутник результату рахується в тому ж проході. Точки
+ *          обробляються парами (x,y) у векторних регістрах SSE2/NEON, де вони є.
+ * @param ps [in,out] Набір шляхів.
+ * @param m Перетворення.
+ * @param out_bbox [out] Межі результату (може бути `NULL`).
+ * @return 0 — успіх; 1 — точок немає (`out_bbox` не змінено); -1 — некоректні аргументи.
+ */
+int geom_paths_transform (geom_paths_t *ps, const geom_affine_t *m, geom_bbox_t *out_bbox);
+
+/**
+ * @brief Зсуває всі шляхи на місці.
+ * @param ps [in,out] Набір шляхів.
+ * @param dx Зсув по X.
+ * @param dy Зсув по Y.
+ * @return 0 — успіх; -1 — некоректні аргументи.
+ */
+int geom_paths_translate_inplace (geom_paths_t *ps, double dx, double dy);
+
+/**
+ * @brief Масштабує всі шляхи на місці.
+ * @param ps [in,out] Набір шляхів.
+ * @param sx Масштаб по осі X.
+ * @param sy Масштаб по осі Y.
+ * @return 0 — успіх; -1 — некоректні аргументи.
+ */
+int geom_paths_scale_inplace (geom_paths_t *ps, double sx, double sy);
+
+/**
+ * @brief Обертає всі шляхи на місці навколо точки `(cx,cy)`.
+ * @param ps [in,out] Набір шляхів.
+ * @param radians Кут у радіанах (додатний — проти годинникової стрілки).
+ * @param cx X‑координата центру обертання.
+ * @param cy Y‑координата центру обертання.
+ * @return 0 — успіх; -1 — некоректні аргументи.
+ */
+int geom_paths_rotate_inplace (geom_paths_t *ps, double radians, double cx, double cy);
+
+/**
+ * @brief Конвертує одиниці виміру всіх точок на місці.
+ * @param ps [in,out] Набір шляхів.
+ * @param to Цільові одиниці.
+ * @return 0 — успіх; -1 — некоректні аргументи.
+ */
+int geom_paths_convert_inplace (geom_paths_t *ps, geom_units_t to);
+
 /**
  * @brief Розрахунок обмежувального прямокутника одного шляху.
  * @param p Шлях.
@@ -211,6 +362,39 @@ int geom_paths_convert (const geom_paths_t *a, geom_units_t to, geom_paths_t *ou
  */
 int geom_paths_normalize (const geom_paths_t *a, geom_paths_t *out);
 
+/**
+ * Підсумок спрощення геометрії.
+ */
+typedef struct {
+    size_t paths_before;  /**< Кількість шляхів до спрощення. */
+    size_t paths_after;   /**< Кількість шляхів після зшивання. */
+    size_t points_before; /**< Кількість точок до спрощення. */
+    size_t points_after;  /**< Кількість точок після спрощення. */
+} geom_simplify_stats_t;
+
+/**
+ * @brief Спрощує шляхи перед плануванням руху.
+ * @details Три кроки:
+ *  1. Зшиває шляхи, кінці яких збігаються в межах `join_tol` (за потреби розвертаючи).
+ *  2. Прибирає повтори та колінеарні внутрішні точки.
+ *  3. Застосовує Рамера–Дугласа–Пекера з допуском `rdp_tol` (0 — пропустити).
+ * Перший шлях кожного зшитого ланцюга зберігає позицію в наборі.
+ * @param a Вхідні шляхи.
+ * @param join_tol Допуск зшивання кінців (0 — лише точний збіг).
+ * @param rdp_tol Максимальне відхилення спрощеної лінії.
+ * @param out [out] Результат.
+ * @param stats [out] Підсумок (може бути `NULL`).
+ * @param arena Арена для індексу кінців і стеку RDP (NULL — купа); результат — у купі.
+ * @return 0 — успіх; -1 — помилка аргументів або виділення памʼяті.
+ */
+int geom_paths_simplify (
+    const geom_paths_t *a,
+    double join_tol,
+    double rdp_tol,
+    geom_paths_t *out,
+    geom_simplify_stats_t *stats,
+    jobarena_t *arena);
+
 /**
  * @brief Порівняння точок із допуском.
  * @param a Перша точка.
@@ -220,10 +404,43 @@ int geom_paths_normalize (const geom_paths_t *a, geom_paths_t *out);
  */
 int geom_point_eq (const geom_point_t *a, const geom_point_t *b, double tol);
 
+/**
+ * Накопичувальний хеш геометрії.
+ * @details Оновлюється шлях за шляхом — тим кодом, що й так проходить точки (запис
+ * чи читання кешу, копіювання), тож відбиток не потребує окремого обходу. Координати
+ * квантуються до тисячних одиниці (мікрометри для мм) у пару `int32`; пари
+ * змішуються множенням у чотирьох незалежних смугах, а межі шляхів і їх довжини
+ * входять у хеш. Значення залежить від порядку шляхів і точок.
+ */
+typedef struct {
+    uint64_t state; /**< Хеш завершених шляхів. */
+} geom_hash_t;
+
+/**
+ * @brief Починає новий хеш.
+ * @param h [out] Стан хешу.
+ */
+void geom_hash_init (geom_hash_t *h);
+
+/**
+ * @brief Додає до хешу один шлях.
+ * @param h [in,out] Стан хешу.
+ * @param pts Точки шляху (може бути NULL, якщо `len == 0`).
+ * @param len Кількість точок.
+ */
+void geom_hash_path (geom_hash_t *h, const geom_point_t *pts, size_t len);
+
+/**
+ * @brief Поточне значення хешу (стан не змінюється, додавати шляхи можна далі).
+ * @param h Стан хешу.
+ * @return 64‑бітове значення.
+ */
+uint64_t geom_hash_value (const geom_hash_t *h);
+
 /**
  * @brief Хеш набору шляхів у мікро‑міліметрах.
- * @details Обчислює FNV‑подібний хеш, квантувавши координати до мікронів
- * (масштаб 1000 для мм). Корисно для кешування/порівняння контурів.
+ * @details Те саме значення, що й `geom_hash_path` для кожного шляху по черзі.
+ * Корисно для кешування/порівняння контурів.
  * @param ps Набір шляхів.
  * @return 64‑бітове хеш‑значення; 0 для `NULL`.
  */
@@ -4,12 +4,14 @@
  * @ingroup glyph
  * @details
  * Містить внутрішнє представлення гліфа та реалізації операцій створення з
- * SVG-path, отримання метаданих і звільнення ресурсів.
+ * SVG-path, отримання метаданих і звільнення ресурсів. Рядок `d` розбирається
+ * один раз: контур зберігається як точки `float` в одному блоці памʼяті.
  */
 
 #include "glyph.h"
-#include "str.h"
 
+#include <ctype.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -19,9 +21,122 @@
 struct glyph {
     uint32_t codepoint;   /**< Юнікод кодова точка гліфа. */
     double advance_width; /**< Просування пера після гліфа (од. шрифту). */
-    char *path_data;      /**< Копія рядка атрибута `d` SVG (власність обʼєкта). */
+    float *coords;        /**< Пари (x, y); той самий блок містить і `stroke_len`. */
+    uint32_t *stroke_len; /**< Кількість точок у кожному штриху (всередині блоку `coords`). */
+    size_t stroke_count;  /**< Кількість штрихів. */
+    size_t point_count;   /**< Загальна кількість точок. */
 };
 
+/**
+ * Тимчасовий стан розбору SVG-path.
+ */
+typedef struct {
+    float *coords;        /**< Зібрані пари координат. */
+    size_t point_count;   /**< Кількість прийнятих точок. */
+    size_t point_cap;     /**< Ємність `coords` у парах. */
+    uint32_t *stroke_len; /**< Довжини завершених штрихів. */
+    size_t stroke_count;  /**< Кількість завершених штрихів. */
+    size_t stroke_cap;    /**< Ємність `stroke_len`. */
+    size_t stroke_start;  /**< Індекс першої точки поточного штриха. */
+} glyph_outline_builder_t;
+
+/** \brief Додає точку до поточного штриха. */
+static int glyph_builder_push_point (glyph_outline_builder_t *b, double x, double y) {
+    if (b->point_count == b->point_cap) {
+        size_t new_cap = (b->point_cap == 0) ? 16 : b->point_cap * 2;
+        float *grown = (float *)realloc (b->coords, new_cap * 2 * sizeof (*grown));
+        if (!grown)
+            return -1;
+        b->coords = grown;
+        b->point_cap = new_cap;
+    }
+    b->coords[b->point_count * 2] = (float)x;
+    b->coords[b->point_count * 2 + 1] = (float)y;
+    b->point_count++;
+    return 0;
+}
+
+/**
+ * @brief Завершує поточний штрих.
+ * @details Штрих із менш ніж двома точками відкидається (як і раніше при емісії контурів).
+ * @return 0 — успіх, -1 — помилка памʼяті.
+ */
+static int glyph_builder_end_stroke (glyph_outline_builder_t *b) {
+    size_t len = b->point_count - b->stroke_start;
+    if (len < 2) {
+        b->point_count = b->stroke_start;
+        return 0;
+    }
+    if (b->stroke_count == b->stroke_cap) {
+        size_t new_cap = (b->stroke_cap == 0) ? 4 : b->stroke_cap * 2;
+        uint32_t *grown = (uint32_t *)realloc (b->stroke_len, new_cap * sizeof (*grown));
+        if (!grown)
+            return -1;
+        b->stroke_len = grown;
+        b->stroke_cap = new_cap;
+    }
+    b->stroke_len[b->stroke_count++] = (uint32_t)len;
+    b->stroke_start = b->point_count;
+    return 0;
+}
+
+/**
+ * @brief Розбирає SVG path data (M/L/Z) у набір штрихів.
+ * @param d Рядок атрибута 'd' SVG.
+ * @param b [in,out] Стан збирача.
+ * @return 0 — успіх, -1 — помилка памʼяті, -3 — помилка розбору.
+ */
+static int glyph_parse_path_data (const char *d, glyph_outline_builder_t *b) {
+    bool have_path = false;
+    const char *p = d;
+    while (*p) {
+        while (*p && isspace ((unsigned char)*p))
+            ++p;
+        char cmd = *p;
+        if (!cmd)
+            break;
+        ++p;
+        if (cmd != 'M' && cmd != 'L' && cmd != 'm' && cmd != 'l' && cmd != 'Z' && cmd != 'z')
+            continue;
+        if (cmd == 'Z' || cmd == 'z') {
+            if (have_path && glyph_builder_end_stroke (b) != 0)
+                return -1;
+            b->point_count = b->stroke_start;
+            have_path = false;
+            continue;
+        }
+        while (*p && isspace ((unsigned char)*p))
+            ++p;
+        char *endptr = NULL;
+        double raw_x = strtod (p, &endptr);
+        if (endptr == p)
+            return -3;
+        p = endptr;
+        while (*p && isspace ((unsigned char)*p))
+            ++p;
+        double raw_y = strtod (p, &endptr);
+        if (endptr == p)
+            return -3;
+        p = endptr;
+
+        if (cmd == 'M' || cmd == 'm') {
+            if (have_path && glyph_builder_end_stroke (b) != 0)
+                return -1;
+            b->point_count = b->stroke_start;
+            have_path = true;
+        } else if (!have_path) {
+            b->point_count = b->stroke_start;
+            have_path = true;
+        }
+        if (glyph_builder_push_point (b, raw_x, raw_y) != 0)
+            return -1;
+    }
+    if (have_path && glyph_builder_end_stroke (b) != 0)
+        return -1;
+    b->point_count = b->stroke_start;
+    return 0;
+}
+
 /**
  * @copydoc glyph_create_from_svg_path
  */
@@ -29,14 +144,55 @@ int glyph_create_from_svg_path (
     uint32_t codepoint, double advance_width, const char *path_data, glyph_t **out_glyph) {
     if (!path_data || !out_glyph)
         return -2;
+    glyph_outline_builder_t builder = { 0 };
+    int rc = glyph_parse_path_data (path_data, &builder);
+    if (rc != 0) {
+        free (builder.coords);
+        free (builder.stroke_len);
+        return rc;
+    }
+
+    glyph_outline_t outline = {
+        .coords = builder.coords,
+        .stroke_len = builder.stroke_len,
+        .stroke_count = builder.stroke_count,
+        .point_count = builder.point_count,
+    };
+    rc = glyph_create_from_outline (codepoint, advance_width, &outline, out_glyph);
+    free (builder.coords);
+    free (builder.stroke_len);
+    return rc;
+}
+
+/**
+ * @copydoc glyph_create_from_outline
+ */
+int glyph_create_from_outline (
+    uint32_t codepoint, double advance_width, const glyph_outline_t *outline,
+    glyph_t **out_glyph) {
+    if (!outline || !out_glyph)
+        return -2;
+    if (outline->stroke_count > 0 && (!outline->coords || !outline->stroke_len))
+        return -2;
     glyph_t *glyph = (glyph_t *)calloc (1, sizeof (*glyph));
     if (!glyph)
         return -1;
     glyph->codepoint = codepoint;
     glyph->advance_width = advance_width;
-    if (str_string_duplicate (path_data, &glyph->path_data) != 0) {
-        free (glyph);
-        return -1;
+    if (outline->stroke_count > 0) {
+        size_t coords_bytes = outline->point_count * 2 * sizeof (float);
+        size_t lens_bytes = outline->stroke_count * sizeof (uint32_t);
+        unsigned char *block = (unsigned char *)malloc (coords_bytes + lens_bytes);
+        if (!block) {
+            free (glyph);
+            return -1;
+        }
+        memcpy (block, outline->coords, coords_bytes);
+        memcpy (block + coords_bytes, outline->stroke_len, lens_bytes);
+        glyph->coords = (float *)block;
+        glyph->stroke_len = (uint32_t *)(block + coords_bytes);
+        glyph->stroke_count = outline->stroke_count;
+        glyph->point_count = outline->point_count;
     }
     *out_glyph = glyph;
     return 0;
@@ -54,12 +210,16 @@ int glyph_get_info (const glyph_t *glyph, glyph_info_t *out) {
 }
 
 /**
- * @copydoc glyph_get_path_data
+ * @copydoc glyph_get_outline
  */
-const char *glyph_get_path_data (const glyph_t *glyph) {
-    if (!glyph)
-        return NULL;
-    return glyph->path_data;
+int glyph_get_outline (const glyph_t *glyph, glyph_outline_t *out) {
+    if (!glyph || !out)
+        return -1;
+    out->coords = glyph->coords;
+    out->stroke_len = glyph->stroke_len;
+    out->stroke_count = glyph->stroke_count;
+    out->point_count = glyph->point_count;
+    return 0;
 }
 
 /**
@@ -68,7 +228,7 @@ const char *glyph_get_path_data (const glyph_t *glyph) {
 int glyph_release (glyph_t *glyph) {
     if (!glyph)
         return 0;
-    free (glyph->path_data);
+    free (glyph->coords);
     free (glyph);
     return 0;
 }
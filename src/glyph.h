@@ -6,7 +6,8 @@
  * @details
  * Надає непрозорий тип гліфа, базову інформацію про нього та операції
  * створення/читання/звільнення. Джерелом контурів виступає рядок SVG-path
- * (значення атрибуту `d`).
+ * (значення атрибуту `d`), який розбирається один раз під час створення гліфа
+ * у компактні полілінії (`glyph_outline_t`).
  */
 #ifndef GLYPH_H
 #define GLYPH_H
@@ -32,19 +33,44 @@ typedef struct glyph_info {
     double advance_width; /**< Просування пера після гліфа (од. шрифту). */
 } glyph_info_t;
 
+/**
+ * Попередньо розібраний контур гліфа (полілінії в одиницях шрифту).
+ * @details Точки всіх штрихів зберігаються поспіль в одному буфері; межі штрихів
+ * задає масив `stroke_len`. Штрихи з менш ніж двома точками відкидаються на етапі розбору.
+ */
+typedef struct glyph_outline {
+    const float *coords;        /**< Пари (x, y) усіх штрихів поспіль, од. шрифту. */
+    const uint32_t *stroke_len; /**< Кількість точок у кожному штриху. */
+    size_t stroke_count;        /**< Кількість штрихів. */
+    size_t point_count;         /**< Загальна кількість точок (пар у `coords`). */
+} glyph_outline_t;
+
 /**
  * @brief Створює гліф із SVG-path даних.
  * @param codepoint Юнікод кодова точка.
  * @param advance_width Просування у одиницях шрифту (метрики шрифту).
- * @param path_data Рядок даних атрибута `d` SVG (не `NULL`).
+ * @param path_data Рядок даних атрибута `d` SVG (не `NULL`); підтримуються команди M/L/Z.
  * @param out_glyph [out] Куди помістити вказівник на створений гліф (не `NULL`).
  * @return 0 — успіх;
  *         -1 — помилка виділення памʼяті;
- *         -2 — некоректні аргументи (`path_data==NULL` або `out_glyph==NULL`).
+ *         -2 — некоректні аргументи (`path_data==NULL` або `out_glyph==NULL`);
+ *         -3 — некоректні дані контуру (очікувалась пара координат).
  */
 int glyph_create_from_svg_path (
     uint32_t codepoint, double advance_width, const char *path_data, glyph_t **out_glyph);
 
+/**
+ * @brief Створює гліф із уже розібраного контуру (напр., із кешу шрифтів).
+ * @param codepoint Юнікод кодова точка.
+ * @param advance_width Просування у одиницях шрифту.
+ * @param outline Контур; дані копіюються у власний блок гліфа.
+ * @param out_glyph [out] Створений гліф.
+ * @return 0 — успіх; -1 — помилка виділення памʼяті; -2 — некоректні аргументи.
+ */
+int glyph_create_from_outline (
+    uint32_t codepoint, double advance_width, const glyph_outline_t *outline,
+    glyph_t **out_glyph);
+
 /**
  * @brief Отримує базову інформацію про гліф.
  * @param glyph Вхідний гліф.
@@ -54,12 +80,12 @@ int glyph_create_from_svg_path (
 int glyph_get_info (const glyph_t *glyph, glyph_info_t *out);
 
 /**
- * @brief Повертає сирі SVG-path дані гліфа.
+ * @brief Повертає попередньо розібраний контур гліфа.
  * @param glyph Вхідний гліф.
- * @return Вказівник на внутрішній рядок даних `d` або `NULL` для `NULL` гліфа.
- * @warning Рядок належить гліфу й лишається дійсним до `glyph_release()`.
+ * @param out [out] Опис контуру; вказівники належать гліфу до `glyph_release()`.
+ * @return 0 — успіх; -1 — некоректні аргументи.
  */
-const char *glyph_get_path_data (const glyph_t *glyph);
+int glyph_get_outline (const glyph_t *glyph, glyph_outline_t *out);
 
 /**
  * @brief Вивільняє гліф і повʼязані ресурси.
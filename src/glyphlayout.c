@@ -0,0 +1,314 @@
+/**
+ * @file glyphlayout.c
+ * @brief Реалізація розкладки з екземплярів гліфів.
+ * @ingroup glyphlayout
+ */
+
+#include "glyphlayout.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Початкова ємність хеш‑таблиці форм (степінь двійки). */
+#define GLYPH_LAYOUT_INDEX_MIN 64
+
+/** \brief Хеш ключа форми: адреса гліфа і біти масштабу. */
+static size_t glyph_layout_hash (const glyph_t *glyph, double scale) {
+    uint64_t bits;
+    memcpy (&bits, &scale, sizeof (bits));
+    uint64_t h = (uint64_t)(uintptr_t)glyph * 0x9E3779B97F4A7C15ULL;
+    h ^= bits + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    return (size_t)(h ^ (h >> 29));
+}
+
+/**
+ * @brief Перебудовує хеш‑таблицю під подвоєну ємність.
+ * @return 0 — успіх, -1 — брак памʼяті.
+ */
+static int glyph_layout_rehash (glyph_layout_t *gl) {
+    size_t cap = gl->index_cap ? gl->index_cap * 2 : GLYPH_LAYOUT_INDEX_MIN;
+    uint32_t *index = (uint32_t *)calloc (cap, sizeof (*index));
+    if (!index)
+        return -1;
+    for (size_t i = 0; i < gl->atlas_len; ++i) {
+        const glyph_layout_shape_t *s = &gl->atlas[i];
+        size_t slot = glyph_layout_hash (s->glyph, s->scale) & (cap - 1);
+        while (index[slot])
+            slot = (slot + 1) & (cap - 1);
+        index[slot] = (uint32_t)i + 1;
+    }
+    free (gl->index);
+    gl->index = index;
+    gl->index_cap = cap;
+    return 0;
+}
+
+/**
+ * @brief Дописує елемент розкладки.
+ * @return 0 — успіх, -1 — брак памʼяті.
+ */
+static int glyph_layout_push_item (glyph_layout_t *gl, const glyph_layout_item_t *item) {
+    if (gl->item_len == gl->item_cap) {
+        size_t cap = gl->item_cap ? gl->item_cap * 2 : 256;
+        glyph_layout_item_t *grown
+            = (glyph_layout_item_t *)realloc (gl->items, cap * sizeof (*grown));
+        if (!grown)
+            return -1;
+        gl->items = grown;
+        gl->item_cap = cap;
+    }
+    gl->items[gl->item_len++] = *item;
+    return 0;
+}
+
+/**
+ * @brief Знаходить форму гліфа в атласі або додає її.
+ * @param outline Контур гліфа (одиниці шрифту).
+ * @param out_shape [out] Номер форми.
+ * @return 0 — успіх, -1 — брак памʼяті.
+ */
+static int glyph_layout_intern (
+    glyph_layout_t *gl,
+    const glyph_t *glyph,
+    double scale,
+    const glyph_outline_t *outline,
+    uint32_t *out_shape) {
+    if ((gl->atlas_len + 1) * 2 > gl->index_cap && glyph_layout_rehash (gl) != 0)
+        return -1;
+    size_t slot = glyph_layout_hash (glyph, scale) & (gl->index_cap - 1);
+    while (gl->index[slot]) {
+        const glyph_layout_shape_t *s = &gl->atlas[gl->index[slot] - 1];
+        if (s->glyph == glyph && s->scale == scale) {
+            *out_shape = gl->index[slot] - 1;
+            return 0;
+        }
+        slot = (slot + 1) & (gl->index_cap - 1);
+    }
+
+    if (gl->atlas_len == gl->atlas_cap) {
+        size_t cap = gl->atlas_cap ? gl->atlas_cap * 2 : 64;
+        glyph_layout_shape_t *grown
+            = (glyph_layout_shape_t *)realloc (gl->atlas, cap * sizeof (*grown));
+        if (!grown)
+            return -1;
+        gl->atlas = grown;
+        gl->atlas_cap = cap;
+    }
+    glyph_layout_shape_t *shape = &gl->atlas[gl->atlas_len];
+    shape->glyph = glyph;
+    shape->scale = scale;
+    shape->first = gl->shapes.len;
+    shape->count = outline->stroke_count;
+
+    if (geom_paths_reserve (&gl->shapes, gl->shapes.len + outline->stroke_count) != 0)
+        return -1;
+    const float *src = outline->coords;
+    for (size_t s = 0; s < outline->stroke_count; ++s) {
+        size_t n = outline->stroke_len[s];
+        geom_point_t *dst = NULL;
+        if (geom_paths_add_path (&gl->shapes, n, &dst) != 0)
+            return -1;
+        for (size_t i = 0; i < n; ++i, src += 2) {
+            dst[i].x = (double)src[0] * scale;
+            dst[i].y = -(double)src[1] * scale;
+        }
+    }
+    gl->index[slot] = (uint32_t)gl->atlas_len + 1;
+    *out_shape = (uint32_t)gl->atlas_len++;
+    return 0;
+}
+
+/** @copydoc glyph_layout_init */
+int glyph_layout_init (glyph_layout_t *gl, geom_units_t units) {
+    if (!gl)
+        return -1;
+    memset (gl, 0, sizeof (*gl));
+    gl->units = units;
+    if (geom_paths_init (&gl->shapes, units) != 0 || geom_paths_init (&gl->loose, units) != 0)
+        return -1;
+    return 0;
+}
+
+/** @copydoc glyph_layout_free */
+void glyph_layout_free (glyph_layout_t *gl) {
+    if (!gl)
+        return;
+    geom_paths_free (&gl->shapes);
+    geom_paths_free (&gl->loose);
+    free (gl->atlas);
+    free (gl->index);
+    free (gl->items);
+    memset (gl, 0, sizeof (*gl));
+}
+
+/** @copydoc glyph_layout_place */
+int glyph_layout_place (
+    glyph_layout_t *gl,
+    const glyph_t *glyph,
+    double origin_x,
+    double baseline_y,
+    double scale,
+    double *advance_units) {
+    if (!gl || !glyph)
+        return -1;
+    glyph_info_t info;
+    glyph_outline_t outline;
+    if (glyph_get_info (glyph, &info) != 0 || glyph_get_outline (glyph, &outline) != 0)
+        return -1;
+    if (advance_units)
+        *advance_units = info.advance_width;
+    if (outline.stroke_count == 0)
+        return 0;
+
+    glyph_layout_item_t item = { .x = origin_x * scale, .y = baseline_y * scale };
+    if (glyph_layout_intern (gl, glyph, scale, &outline, &item.shape) != 0)
+        return -1;
+    return glyph_layout_push_item (gl, &item);
+}
+
+/** @copydoc glyph_layout_add_paths */
+int glyph_layout_add_paths (glyph_layout_t *gl, const geom_paths_t *paths, size_t first) {
+    if (!gl || !paths)
+        return -1;
+    for (size_t i = first; i < paths->len; ++i) {
+        const geom_path_t *p = &paths->items[i];
+        if (p->len == 0)
+            continue;
+        glyph_layout_item_t item = {
+            .shape = GLYPH_LAYOUT_LOOSE,
+            .index = (uint32_t)gl->loose.len,
+        };
+        if (geom_paths_push_path (&gl->loose, p->pts, p->len) != 0
+            || glyph_layout_push_item (gl, &item) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/** @copydoc glyph_layout_bbox */
+int glyph_layout_bbox (const glyph_layout_t *gl, geom_bbox_t *out) {
+    if (!gl || !out)
+        return -1;
+    geom_bbox_t bb = { HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+    bool has_point = false;
+
+    /* Межі кожної форми рахуються один раз; екземпляр лише зсуває їх. */
+    geom_bbox_t *shape_bb = NULL;
+    if (gl->atlas_len > 0) {
+        shape_bb = (geom_bbox_t *)malloc (gl->atlas_len * sizeof (*shape_bb));
+        if (!shape_bb)
+            return -1;
+    }
+    for (size_t i = 0; i < gl->atlas_len; ++i) {
+        const glyph_layout_shape_t *s = &gl->atlas[i];
+        geom_bbox_t sb = { HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+        for (size_t k = s->first; k < s->first + s->count; ++k) {
+            const geom_path_t *p = &gl->shapes.items[k];
+            for (size_t j = 0; j < p->len; ++j) {
+                sb.min_x = fmin (sb.min_x, p->pts[j].x);
+                sb.min_y = fmin (sb.min_y, p->pts[j].y);
+                sb.max_x = fmax (sb.max_x, p->pts[j].x);
+                sb.max_y = fmax (sb.max_y, p->pts[j].y);
+            }
+        }
+        shape_bb[i] = sb;
+    }
+    for (size_t i = 0; i < gl->item_len; ++i) {
+        const glyph_layout_item_t *it = &gl->items[i];
+        geom_bbox_t ib;
+        if (it->shape == GLYPH_LAYOUT_LOOSE) {
+            if (geom_bbox_of_path (&gl->loose.items[it->index], &ib) != 0)
+                continue;
+        } else {
+            ib = shape_bb[it->shape];
+            if (!(ib.min_x <= ib.max_x))
+                continue;
+            ib.min_x += it->x;
+            ib.max_x += it->x;
+            ib.min_y += it->y;
+            ib.max_y += it->y;
+        }
+        bb.min_x = fmin (bb.min_x, ib.min_x);
+        bb.min_y = fmin (bb.min_y, ib.min_y);
+        bb.max_x = fmax (bb.max_x, ib.max_x);
+        bb.max_y = fmax (bb.max_y, ib.max_y);
+        has_point = true;
+    }
+    free (shape_bb);
+    if (!has_point)
+        return 1;
+    *out = bb;
+    return 0;
+}
+
+/** @copydoc glyph_layout_transform */
+int glyph_layout_transform (glyph_layout_t *gl, const geom_affine_t *m) {
+    if (!gl || !m)
+        return -1;
+    geom_affine_t linear = { m->a, m->b, m->c, m->d, 0.0, 0.0 };
+    if (geom_paths_transform (&gl->shapes, &linear, NULL) < 0
+        || geom_paths_transform (&gl->loose, m, NULL) < 0)
+        return -1;
+    for (size_t i = 0; i < gl->item_len; ++i) {
+        glyph_layout_item_t *it = &gl->items[i];
+        if (it->shape == GLYPH_LAYOUT_LOOSE)
+            continue;
+        double x = it->x;
+        double y = it->y;
+        it->x = m->a * x + m->c * y + m->e;
+        it->y = m->b * x + m->d * y + m->f;
+    }
+    return 0;
+}
+
+/** @copydoc glyph_layout_convert */
+int glyph_layout_convert (glyph_layout_t *gl, geom_units_t to) {
+    if (!gl)
+        return -1;
+    if (gl->units == to)
+        return 0;
+    double k = (to == GEOM_UNITS_MM) ? 25.4 : 1.0 / 25.4;
+    geom_affine_t m = geom_affine_scaling (k, k);
+    if (glyph_layout_transform (gl, &m) != 0)
+        return -1;
+    gl->units = to;
+    geom_paths_set_units (&gl->shapes, to);
+    geom_paths_set_units (&gl->loose, to);
+    return 0;
+}
+
+/** @copydoc glyph_layout_flatten */
+int glyph_layout_flatten (const glyph_layout_t *gl, geom_paths_t *out) {
+    if (!gl || !out)
+        return -1;
+    size_t paths = 0;
+    for (size_t i = 0; i < gl->item_len; ++i) {
+        const glyph_layout_item_t *it = &gl->items[i];
+        paths += it->shape == GLYPH_LAYOUT_LOOSE ? 1 : gl->atlas[it->shape].count;
+    }
+    if (geom_paths_reserve (out, out->len + paths) != 0)
+        return -1;
+    for (size_t i = 0; i < gl->item_len; ++i) {
+        const glyph_layout_item_t *it = &gl->items[i];
+        if (it->shape == GLYPH_LAYOUT_LOOSE) {
+            const geom_path_t *p = &gl->loose.items[it->index];
+            if (geom_paths_push_path (out, p->pts, p->len) != 0)
+                return -1;
+            continue;
+        }
+        const glyph_layout_shape_t *s = &gl->atlas[it->shape];
+        for (size_t k = s->first; k < s->first + s->count; ++k) {
+            const geom_path_t *p = &gl->shapes.items[k];
+            geom_point_t *dst = NULL;
+            if (geom_paths_add_path (out, p->len, &dst) != 0)
+                return -1;
+            for (size_t j = 0; j < p->len; ++j) {
+                dst[j].x = it->x + p->pts[j].x;
+                dst[j].y = it->y + p->pts[j].y;
+            }
+        }
+    }
+    return 0;
+}
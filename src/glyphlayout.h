@@ -0,0 +1,145 @@
+/**
+ * @file glyphlayout.h
+ * @brief Розкладка тексту як екземпляри гліфів: атлас форм і розміщення.
+ * @defgroup glyphlayout Екземпляри гліфів
+ * @ingroup glyph
+ * @details
+ * Замість копії контурів на кожен символ розкладка зберігає атлас: по одній формі
+ * на пару (гліф, масштаб) — контури відносно початку гліфа — і масив розміщень
+ * (номер форми, X, Y). Сторінка з тисячами символів тримає кілька десятків форм і
+ * по 24 байти на символ. Контури, що не є гліфами атласу (запасні шрифти тощо),
+ * зберігаються окремо як «вільні» елементи в тому ж порядку виведення.
+ *
+ * Афінне перетворення сторінки застосовується до розміщень і вільних контурів
+ * повністю, а до форм атласу — лише лінійною частиною. `glyph_layout_flatten`
+ * розгортає розкладку у звичайні контури в порядку виведення — так само, як їх
+ * створила б звичайна верстка.
+ */
+#ifndef CPLOT_GLYPHLAYOUT_H
+#define CPLOT_GLYPHLAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "geom.h"
+#include "glyph.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Позначка вільного контуру в `glyph_layout_item_t::shape`. */
+#define GLYPH_LAYOUT_LOOSE UINT32_MAX
+
+/**
+ * @brief Форма атласу: контури одного гліфа в одному масштабі.
+ */
+typedef struct {
+    const glyph_t *glyph; /**< Ключ: гліф. */
+    double scale;         /**< Ключ: масштаб одиниць шрифту. */
+    size_t first;         /**< Перший контур у `glyph_layout_t::shapes`. */
+    size_t count;         /**< Кількість контурів. */
+} glyph_layout_shape_t;
+
+/**
+ * @brief Елемент розкладки: екземпляр форми або вільний контур.
+ */
+typedef struct {
+    double x;       /**< Початок гліфа по X (для вільного контуру — 0). */
+    double y;       /**< Початок гліфа по Y (для вільного контуру — 0). */
+    uint32_t shape; /**< Номер форми або `GLYPH_LAYOUT_LOOSE`. */
+    uint32_t index; /**< Номер вільного контуру в `loose`. */
+} glyph_layout_item_t;
+
+/**
+ * @brief Розкладка з екземплярів гліфів.
+ */
+typedef struct {
+    geom_units_t units;           /**< Одиниці координат. */
+    geom_paths_t shapes;          /**< Контури всіх форм атласу відносно початку гліфа. */
+    glyph_layout_shape_t *atlas;  /**< Форми атласу. */
+    size_t atlas_len;             /**< Кількість форм. */
+    size_t atlas_cap;             /**< Ємність `atlas`. */
+    uint32_t *index;              /**< Хеш‑таблиця (гліф, масштаб) → номер форми + 1. */
+    size_t index_cap;             /**< Ємність `index` (степінь двійки). */
+    glyph_layout_item_t *items;   /**< Елементи в порядку виведення. */
+    size_t item_len;              /**< Кількість елементів. */
+    size_t item_cap;              /**< Ємність `items`. */
+    geom_paths_t loose;           /**< Вільні контури. */
+} glyph_layout_t;
+
+/**
+ * @brief Ініціалізує порожню розкладку.
+ * @param gl [out] Розкладка.
+ * @param units Одиниці координат.
+ * @return 0 — успіх; -1 — помилка.
+ */
+int glyph_layout_init (glyph_layout_t *gl, geom_units_t units);
+
+/** Звільняє розкладку (NULL — no-op). */
+void glyph_layout_free (glyph_layout_t *gl);
+
+/**
+ * @brief Розміщує гліф (аналог `font_emit_glyph_outline` без копії контурів).
+ * @param gl Розкладка.
+ * @param glyph Гліф.
+ * @param origin_x Початкова X-позиція (одиниці шрифту).
+ * @param baseline_y Базова лінія Y (одиниці шрифту).
+ * @param scale Масштаб із одиниць шрифту в одиниці розкладки.
+ * @param advance_units [out] Просування пера в одиницях шрифту (може бути NULL).
+ * @return 0 — успіх, -1 — помилка.
+ */
+int glyph_layout_place (
+    glyph_layout_t *gl,
+    const glyph_t *glyph,
+    double origin_x,
+    double baseline_y,
+    double scale,
+    double *advance_units);
+
+/**
+ * @brief Дописує контури `paths[first..len)` як вільні елементи.
+ * @param gl Розкладка.
+ * @param paths Джерело (ті самі одиниці).
+ * @param first Перший контур.
+ * @return 0 — успіх, -1 — помилка.
+ */
+int glyph_layout_add_paths (glyph_layout_t *gl, const geom_paths_t *paths, size_t first);
+
+/**
+ * @brief Межі всіх елементів.
+ * @param gl Розкладка.
+ * @param out [out] Межі.
+ * @return 0 — успіх; 1 — розкладка без точок; -1 — помилка аргументів.
+ */
+int glyph_layout_bbox (const glyph_layout_t *gl, geom_bbox_t *out);
+
+/**
+ * @brief Застосовує афінне перетворення до розкладки.
+ * @param gl Розкладка.
+ * @param m Перетворення.
+ * @return 0 — успіх, -1 — помилка аргументів.
+ */
+int glyph_layout_transform (glyph_layout_t *gl, const geom_affine_t *m);
+
+/**
+ * @brief Перетворює одиниці розкладки (мм/дюйми).
+ * @param gl Розкладка.
+ * @param to Цільові одиниці.
+ * @return 0 — успіх, -1 — помилка.
+ */
+int glyph_layout_convert (glyph_layout_t *gl, geom_units_t to);
+
+/**
+ * @brief Дописує розкладку у звичайні контури в порядку виведення.
+ * @param gl Розкладка.
+ * @param out Контейнер (ініціалізований, ті самі одиниці).
+ * @return 0 — успіх, -1 — помилка.
+ */
+int glyph_layout_flatten (const glyph_layout_t *gl, geom_paths_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
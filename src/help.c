@@ -298,6 +298,9 @@ typedef struct command_option_section {
 /** \brief Перелік секцій опцій, згрупованих за командами. */
 static const command_option_section_t k_command_sections[] = {
     { "print", "layout", "Параметри розкладки" },
+    { "plan", "plan", "Опції команди plan (розкладка — як у print)" },
+    { "batch", "batch", "Опції команди batch (розкладка — як у print)" },
+    { "serve", "serve", "Опції команди serve (розкладка — як у print)" },
     { "device", "device-settings", "Налаштування перед виконанням дій" },
     { "font", "font", "Опції команди font" },
     { "config", "config", "Опції команди config" },
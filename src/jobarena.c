@@ -0,0 +1,227 @@
+/**
+ * @file jobarena.c
+ * @brief Реалізація арени завдання.
+ * @ingroup jobarena
+ * @details
+ * Блоки утворюють стек: новий стає поточним, попередні лишаються за ним до позначки
+ * чи скидання. Виділення, більше за блок, отримує власний блок свого розміру.
+ * Відкат повертає звільнені блоки в `malloc`, окрім найбільшого — він чекає в
+ * `spare`, тож цикл «верстка → відкат» у межах завдання не звертається до купи.
+ */
+
+#include "jobarena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Вирівнювання виділень, байт. */
+#define JOBARENA_ALIGN 16u
+
+/**
+ * @brief Блок арени: заголовок і дані за ним.
+ */
+struct jobarena_chunk {
+    jobarena_chunk_t *prev; /**< Попередній блок. */
+    size_t size;            /**< Місткість даних, байт. */
+    size_t top;             /**< Зайнято даних, байт. */
+};
+
+/** Зсув даних від початку блоку (кратний вирівнюванню). */
+#define JOBARENA_HEADER                                                                            \
+    ((sizeof (jobarena_chunk_t) + JOBARENA_ALIGN - 1u) & ~(size_t)(JOBARENA_ALIGN - 1u))
+
+/** \brief Дані блоку. */
+static unsigned char *jobarena_data (jobarena_chunk_t *c) {
+    return (unsigned char *)c + JOBARENA_HEADER;
+}
+
+/** \brief Розмір з вирівнюванням; 0 — переповнення. */
+static size_t jobarena_round (size_t size) {
+    if (size == 0)
+        size = 1;
+    if (size > SIZE_MAX - JOBARENA_ALIGN)
+        return 0;
+    return (size + JOBARENA_ALIGN - 1u) & ~(size_t)(JOBARENA_ALIGN - 1u);
+}
+
+/** \brief Повертає звільнений блок: найбільший лишається запасним. */
+static void jobarena_retire (jobarena_t *a, jobarena_chunk_t *c) {
+    if (a->spare && a->spare->size >= c->size) {
+        free (c);
+        return;
+    }
+    free (a->spare);
+    a->spare = c;
+}
+
+/**
+ * @brief Робить поточним блок щонайменше на `need` байт.
+ * @return 0 — успіх; -1 — брак памʼяті.
+ */
+static int jobarena_grow (jobarena_t *a, size_t need) {
+    jobarena_chunk_t *c = NULL;
+    if (a->spare && a->spare->size >= need) {
+        c = a->spare;
+        a->spare = NULL;
+    } else {
+        size_t size = need > a->chunk_size ? need : a->chunk_size;
+        if (size > SIZE_MAX - JOBARENA_HEADER)
+            return -1;
+        c = (jobarena_chunk_t *)malloc (JOBARENA_HEADER + size);
+        if (!c)
+            return -1;
+        c->size = size;
+    }
+    c->top = 0;
+    c->prev = a->chunk;
+    a->chunk = c;
+    return 0;
+}
+
+/**
+ * @copydoc jobarena_init
+ */
+void jobarena_init (jobarena_t *a, size_t chunk_size) {
+    if (!a)
+        return;
+    memset (a, 0, sizeof (*a));
+    a->chunk_size = chunk_size ? chunk_size : JOBARENA_CHUNK_SIZE;
+}
+
+/**
+ * @copydoc jobarena_alloc
+ */
+void *jobarena_alloc (jobarena_t *a, size_t size) {
+    if (!a)
+        return malloc (size ? size : 1);
+    size_t need = jobarena_round (size);
+    if (need == 0)
+        return NULL;
+    if ((!a->chunk || a->chunk->size - a->chunk->top < need) && jobarena_grow (a, need) != 0)
+        return NULL;
+    void *p = jobarena_data (a->chunk) + a->chunk->top;
+    a->chunk->top += need;
+    a->used += need;
+    if (a->used > a->peak)
+        a->peak = a->used;
+    a->allocs++;
+    return p;
+}
+
+/**
+ * @copydoc jobarena_calloc
+ */
+void *jobarena_calloc (jobarena_t *a, size_t n, size_t size) {
+    if (!a)
+        return calloc (n ? n : 1, size ? size : 1);
+    if (size != 0 && n > SIZE_MAX / size)
+        return NULL;
+    void *p = jobarena_alloc (a, n * size);
+    if (p)
+        memset (p, 0, n * size);
+    return p;
+}
+
+/**
+ * @copydoc jobarena_realloc
+ */
+void *jobarena_realloc (jobarena_t *a, void *p, size_t old_size, size_t new_size) {
+    if (!a)
+        return realloc (p, new_size ? new_size : 1);
+    if (!p)
+        return jobarena_alloc (a, new_size);
+    if (new_size <= old_size)
+        return p;
+    size_t old_need = jobarena_round (old_size);
+    size_t new_need = jobarena_round (new_size);
+    if (new_need == 0)
+        return NULL;
+    jobarena_chunk_t *c = a->chunk;
+    /* Останнє виділення поточного блоку росте на місці. */
+    if (c && (unsigned char *)p + old_need == jobarena_data (c) + c->top
+        && c->size - c->top >= new_need - old_need) {
+        c->top += new_need - old_need;
+        a->used += new_need - old_need;
+        if (a->used > a->peak)
+            a->peak = a->used;
+        return p;
+    }
+    void *q = jobarena_alloc (a, new_size);
+    if (q)
+        memcpy (q, p, old_size);
+    return q;
+}
+
+/**
+ * @copydoc jobarena_release
+ */
+void jobarena_release (jobarena_t *a, void *p) {
+    if (!a)
+        free (p);
+}
+
+/**
+ * @copydoc jobarena_mark
+ */
+jobarena_mark_t jobarena_mark (const jobarena_t *a) {
+    jobarena_mark_t m = { NULL, 0, 0 };
+    if (a) {
+        m.chunk = a->chunk;
+        m.top = a->chunk ? a->chunk->top : 0;
+        m.used = a->used;
+    }
+    return m;
+}
+
+/**
+ * @copydoc jobarena_rewind
+ */
+void jobarena_rewind (jobarena_t *a, jobarena_mark_t mark) {
+    if (!a)
+        return;
+    while (a->chunk && a->chunk != mark.chunk) {
+        jobarena_chunk_t *c = a->chunk;
+        a->chunk = c->prev;
+        jobarena_retire (a, c);
+    }
+    if (a->chunk)
+        a->chunk->top = mark.top;
+    a->used = mark.used;
+}
+
+/**
+ * @copydoc jobarena_reset
+ */
+void jobarena_reset (jobarena_t *a) {
+    if (!a)
+        return;
+    jobarena_mark_t empty = { NULL, 0, 0 };
+    jobarena_rewind (a, empty);
+    a->peak = 0;
+    a->allocs = 0;
+}
+
+/**
+ * @copydoc jobarena_free
+ */
+void jobarena_free (jobarena_t *a) {
+    if (!a)
+        return;
+    jobarena_reset (a);
+    free (a->spare);
+    a->spare = NULL;
+}
+
+/**
+ * @copydoc jobarena_absorb
+ */
+void jobarena_absorb (jobarena_t *a, jobarena_t *child) {
+    if (!child)
+        return;
+    if (a) {
+        a->allocs += child->allocs;
+        if (a->used + child->peak > a->peak)
+            a->peak = a->used + child->peak;
+    }
+    jobarena_free (child);
+}
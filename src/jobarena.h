@@ -0,0 +1,135 @@
+/**
+ * @file jobarena.h
+ * @brief Арена завдання друку: послідовне виділення проміжних даних.
+ * @defgroup jobarena Арена завдання
+ * @ingroup util
+ * @details
+ * Верстка одного документа робить тисячі дрібних виділень, що живуть лише до кінця
+ * виклику: токени й сегменти слів, рядки та фрагменти, масиви Кнута—Пласса, стек
+ * RDP. Арена видає їх зсувом вказівника в блоках по `JOBARENA_CHUNK_SIZE` байт, а
+ * повертає всі разом: `jobarena_rewind` — до позначки (після кожної верстки), тоді
+ * `jobarena_reset`/`jobarena_free` — наприкінці завдання.
+ *
+ * Арена — необовʼязкова: модулі беруть її з параметрів (`text_layout_opts_t::arena`,
+ * `markdown_opts_t::arena`, `drawing_page_t::arena`), і з `NULL` кожна функція тут
+ * зводиться до `malloc`/`realloc`/`free`. Окреме звільнення з арени — порожня дія.
+ *
+ * Арена не потокобезпечна: робочі потоки заводять власні й після `pthread_join`
+ * зливають їх у батьківську `jobarena_absorb`, тож лічильники охоплюють усе
+ * завдання (`--profile`: `arena_allocs`, `arena_peak_bytes`).
+ */
+#ifndef CPLOT_JOBARENA_H
+#define CPLOT_JOBARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Типовий розмір блоку арени, байт. */
+#define JOBARENA_CHUNK_SIZE (64u * 1024u)
+
+/** \brief Блок арени (внутрішня структура). */
+typedef struct jobarena_chunk jobarena_chunk_t;
+
+/**
+ * @brief Арена завдання.
+ */
+typedef struct jobarena {
+    jobarena_chunk_t *chunk; /**< Поточний блок; попередні — ланцюжком за ним. */
+    jobarena_chunk_t *spare; /**< Звільнений блок, що чекає повторного вжитку. */
+    size_t chunk_size;       /**< Розмір нового блоку, байт. */
+    size_t used;             /**< Видано байт (з вирівнюванням). */
+    size_t peak;             /**< Найбільше `used` від початку завдання. */
+    uint64_t allocs;         /**< Виділень від початку завдання. */
+} jobarena_t;
+
+/**
+ * @brief Позначка стану арени для `jobarena_rewind`.
+ */
+typedef struct {
+    jobarena_chunk_t *chunk; /**< Поточний блок на момент позначки. */
+    size_t top;              /**< Зайнято в ньому, байт. */
+    size_t used;             /**< `jobarena_t::used` на момент позначки. */
+} jobarena_mark_t;
+
+/**
+ * @brief Ініціалізує порожню арену (памʼять виділяється з першим запитом).
+ * @param a [out] Арена.
+ * @param chunk_size Розмір блоку, байт (0 — `JOBARENA_CHUNK_SIZE`).
+ */
+void jobarena_init (jobarena_t *a, size_t chunk_size);
+
+/**
+ * @brief Виділяє `size` байт, вирівняних під будь-який тип.
+ * @param a Арена (NULL — `malloc`).
+ * @param size Розмір, байт.
+ * @return Памʼять або NULL при браку.
+ */
+void *jobarena_alloc (jobarena_t *a, size_t size);
+
+/**
+ * @brief Виділяє обнулений масив.
+ * @param a Арена (NULL — `calloc`).
+ * @param n Кількість елементів.
+ * @param size Розмір елемента, байт.
+ * @return Памʼять або NULL при браку чи переповненні.
+ */
+void *jobarena_calloc (jobarena_t *a, size_t n, size_t size);
+
+/**
+ * @brief Змінює розмір виділення.
+ * @details Останнє виділення блоку росте на місці; інше копіюється в нове (старе
+ *          лишається до позначки чи скидання).
+ * @param a Арена (NULL — `realloc`).
+ * @param p Попереднє виділення з цієї арени (може бути NULL).
+ * @param old_size Його розмір, байт.
+ * @param new_size Новий розмір, байт.
+ * @return Памʼять або NULL при браку (тоді `p` лишається дійсним).
+ */
+void *jobarena_realloc (jobarena_t *a, void *p, size_t old_size, size_t new_size);
+
+/**
+ * @brief Звільняє виділення: з `NULL`-ареною — `free`, інакше нічого не робить.
+ * @param a Арена.
+ * @param p Виділення.
+ */
+void jobarena_release (jobarena_t *a, void *p);
+
+/**
+ * @brief Позначка поточного стану (для NULL-арени — порожня).
+ */
+jobarena_mark_t jobarena_mark (const jobarena_t *a);
+
+/**
+ * @brief Повертає все, виділене після позначки; лічильники зберігаються.
+ * @param a Арена (NULL — нічого).
+ * @param mark Позначка цієї арени.
+ */
+void jobarena_rewind (jobarena_t *a, jobarena_mark_t mark);
+
+/**
+ * @brief Звільняє блоки, крім одного для наступного завдання, і обнуляє лічильники.
+ */
+void jobarena_reset (jobarena_t *a);
+
+/**
+ * @brief Звільняє всю памʼять арени.
+ */
+void jobarena_free (jobarena_t *a);
+
+/**
+ * @brief Додає лічильники дочірньої арени до батьківської і звільняє дочірню.
+ * @details Пік батька — не менший за його поточне `used` плюс пік дочірньої.
+ * @param a Батьківська арена (NULL — лише звільнити дочірню).
+ * @param child Дочірня арена (після виклику — порожня).
+ */
+void jobarena_absorb (jobarena_t *a, jobarena_t *child);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -5,14 +5,20 @@
  * @details
  * Мінімалістична реалізація пошуку та вилучення значень за ключами верхнього
  * рівня без повної перевірки синтаксису JSON. Придатна для невеликих конфігів.
+ * Стрічка токенів розбирається рекурсивним спуском з обмеженою глибиною; токени
+ * лежать в одному масиві, що росте геометрично.
  */
 
 #include "jsr.h"
 
 #include <ctype.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+/** Найбільша вкладеність контейнерів у стрічці токенів. */
+#define JSR_MAX_DEPTH 64
+
 /**
  * @copydoc jsr_json_skip_ws
  */
@@ -87,97 +93,71 @@ int jsr_json_get_raw (const char *json, const char *key, const char **out_ptr, s
 }
 
 /**
- * @copydoc jsr_json_get_string
+ * @brief Копіює вміст рядка JSON (без лапок) у нову памʼять, розкриваючи ескейпи.
+ * @param p Перший байт після відкривної лапки.
+ * @param n Довжина вмісту до закривної лапки.
+ * @param out_len [out] Якщо не `NULL` — довжина результату.
+ * @return Новий рядок або `NULL` при браку памʼяті.
  */
-char *jsr_json_get_string (const char *json, const char *key, size_t *out_len) {
-    const char *v = jsr_json_find_value (json, key);
-    if (!v || *v != '"')
-        return NULL;
-    v++;
-    const char *p = v;
-    size_t cap = 64;
-    size_t len = 0;
-    char *buf = (char *)malloc (cap);
+static char *jsr_unescape (const char *p, size_t n, size_t *out_len) {
+    /* Ескейп ніколи не довший за свій результат, тож n + 1 байтів достатньо. */
+    char *buf = (char *)malloc (n + 1);
     if (!buf)
         return NULL;
-
-/**
- * \brief Локальний макрос гарантує достатню ємність буфера `buf`.
- * @param extra Скільки додаткових байтів потрібно вмістити.
- */
-#define ENSURE_CAP(extra)                                                                          \
-    do {                                                                                           \
-        if (len + (extra) >= cap) {                                                                \
-            size_t new_cap = cap ? cap : 64;                                                       \
-            while (len + (extra) >= new_cap)                                                       \
-                new_cap *= 2;                                                                      \
-            char *tmp = (char *)realloc (buf, new_cap);                                            \
-            if (!tmp)                                                                              \
-                goto fail;                                                                         \
-            buf = tmp;                                                                             \
-            cap = new_cap;                                                                         \
-        }                                                                                          \
-    } while (0)
-
-    while (*p) {
-        if (*p == '\\') {
-            p++;
-            if (*p == '\0')
-                break;
-            if (*p == 'n') {
-                ENSURE_CAP (1);
-                buf[len++] = '\n';
-                p++;
-                continue;
-            }
-            if (*p == 't') {
-                ENSURE_CAP (1);
-                buf[len++] = '\t';
-                p++;
-                continue;
-            }
-            if (*p == 'r') {
-                ENSURE_CAP (1);
-                buf[len++] = '\r';
-                p++;
-                continue;
-            }
-            if (*p == '"' || *p == '\\' || *p == '/') {
-                ENSURE_CAP (1);
-                buf[len++] = *p++;
-                continue;
-            }
-            if (*p == 'u') {
-                p++;
-                int digits = 0;
-                while (digits < 4 && p[digits] && isxdigit ((unsigned char)p[digits]))
-                    digits++;
-                p += digits;
-                ENSURE_CAP (1);
-                buf[len++] = '?';
-                continue;
-            }
-            ENSURE_CAP (1);
+    const char *end = p + n;
+    size_t len = 0;
+    while (p < end) {
+        if (*p != '\\') {
             buf[len++] = *p++;
             continue;
         }
-        if (*p == '"') {
-            p++;
+        if (++p == end)
+            break;
+        char c = *p++;
+        switch (c) {
+        case 'n':
+            buf[len++] = '\n';
+            break;
+        case 't':
+            buf[len++] = '\t';
+            break;
+        case 'r':
+            buf[len++] = '\r';
+            break;
+        case 'u': {
+            int digits = 0;
+            while (digits < 4 && p + digits < end && isxdigit ((unsigned char)p[digits]))
+                digits++;
+            p += digits;
+            buf[len++] = '?';
+            break;
+        }
+        default:
+            buf[len++] = c;
             break;
         }
-        ENSURE_CAP (1);
-        buf[len++] = *p++;
     }
+    buf[len] = '\0';
     if (out_len)
         *out_len = len;
-    ENSURE_CAP (1);
-    buf[len] = '\0';
-#undef ENSURE_CAP
     return buf;
+}
 
-fail:
-    free (buf);
-    return NULL;
+/**
+ * @copydoc jsr_json_get_string
+ */
+char *jsr_json_get_string (const char *json, const char *key, size_t *out_len) {
+    const char *v = jsr_json_find_value (json, key);
+    if (!v || *v != '"')
+        return NULL;
+    v++;
+    const char *p = v;
+    while (*p && *p != '"') {
+        if (*p == '\\' && p[1])
+            p++;
+        p++;
+    }
+    return jsr_unescape (v, (size_t)(p - v), out_len);
 }
 
 /**
@@ -207,3 +187,226 @@ double jsr_json_get_double (const char *json, const char *key, double defval) {
         return defval;
     return d;
 }
+
+/** @copydoc jsr_doc_init */
+void jsr_doc_init (jsr_doc_t *doc) {
+    if (doc)
+        memset (doc, 0, sizeof (*doc));
+}
+
+/** @copydoc jsr_doc_free */
+void jsr_doc_free (jsr_doc_t *doc) {
+    if (!doc)
+        return;
+    free (doc->tokens);
+    memset (doc, 0, sizeof (*doc));
+}
+
+/** \brief Пропускає пробіли в межах документа. */
+static size_t jsr_skip_ws_n (const jsr_doc_t *doc, size_t pos) {
+    while (pos < doc->len) {
+        char c = doc->json[pos];
+        if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+            break;
+        pos++;
+    }
+    return pos;
+}
+
+/**
+ * @brief Додає токен у стрічку.
+ * @return Індекс токена або `JSR_NONE` при браку памʼяті.
+ */
+static size_t jsr_push (jsr_doc_t *doc, jsr_type_t type, size_t start) {
+    if (doc->count == doc->cap) {
+        size_t nc = doc->cap ? doc->cap * 2 : 64;
+        jsr_token_t *grown = (jsr_token_t *)realloc (doc->tokens, nc * sizeof (*grown));
+        if (!grown)
+            return JSR_NONE;
+        doc->tokens = grown;
+        doc->cap = nc;
+    }
+    jsr_token_t *t = &doc->tokens[doc->count];
+    t->type = (uint32_t)type;
+    t->start = (uint32_t)start;
+    t->len = 0;
+    t->next = 0;
+    return doc->count++;
+}
+
+/**
+ * @brief Розбирає одне значення з позиції `*pos` (рекурсивно для контейнерів).
+ * @return 0 — успіх; -1 — помилка.
+ */
+static int jsr_parse_value (jsr_doc_t *doc, size_t *pos, int depth) {
+    size_t p = jsr_skip_ws_n (doc, *pos);
+    if (p >= doc->len || depth > JSR_MAX_DEPTH)
+        return -1;
+    const char *s = doc->json;
+    char c = s[p];
+    size_t idx;
+    if (c == '{' || c == '[') {
+        bool object = c == '{';
+        char close = object ? '}' : ']';
+        idx = jsr_push (doc, object ? JSR_OBJECT : JSR_ARRAY, p);
+        if (idx == JSR_NONE)
+            return -1;
+        p = jsr_skip_ws_n (doc, p + 1);
+        if (p < doc->len && s[p] == close) {
+            p++;
+        } else {
+            for (;;) {
+                if (object) {
+                    p = jsr_skip_ws_n (doc, p);
+                    if (p >= doc->len || s[p] != '"' || jsr_parse_value (doc, &p, depth + 1) != 0)
+                        return -1;
+                    p = jsr_skip_ws_n (doc, p);
+                    if (p >= doc->len || s[p] != ':')
+                        return -1;
+                    p++;
+                }
+                if (jsr_parse_value (doc, &p, depth + 1) != 0)
+                    return -1;
+                p = jsr_skip_ws_n (doc, p);
+                if (p < doc->len && s[p] == ',') {
+                    p++;
+                    continue;
+                }
+                if (p < doc->len && s[p] == close) {
+                    p++;
+                    break;
+                }
+                return -1;
+            }
+        }
+    } else if (c == '"') {
+        idx = jsr_push (doc, JSR_STRING, p + 1);
+        if (idx == JSR_NONE)
+            return -1;
+        size_t q = p + 1;
+        while (q < doc->len && s[q] != '"')
+            q += (s[q] == '\\') ? 2 : 1;
+        if (q >= doc->len)
+            return -1;
+        doc->tokens[idx].len = (uint32_t)(q - p - 1);
+        p = q + 1;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        idx = jsr_push (doc, JSR_NUMBER, p);
+        if (idx == JSR_NONE)
+            return -1;
+        size_t q = p + 1;
+        while (q < doc->len
+               && ((s[q] >= '0' && s[q] <= '9') || s[q] == '.' || s[q] == 'e' || s[q] == 'E'
+                   || s[q] == '+' || s[q] == '-'))
+            q++;
+        doc->tokens[idx].len = (uint32_t)(q - p);
+        p = q;
+    } else {
+        static const struct {
+            const char *word;
+            jsr_type_t type;
+        } k_literals[] = { { "true", JSR_TRUE }, { "false", JSR_FALSE }, { "null", JSR_NULL } };
+        size_t i = 0;
+        size_t n = 0;
+        for (; i < sizeof (k_literals) / sizeof (k_literals[0]); ++i) {
+            n = strlen (k_literals[i].word);
+            if (doc->len - p >= n && memcmp (s + p, k_literals[i].word, n) == 0)
+                break;
+        }
+        if (i == sizeof (k_literals) / sizeof (k_literals[0]))
+            return -1;
+        idx = jsr_push (doc, k_literals[i].type, p);
+        if (idx == JSR_NONE)
+            return -1;
+        doc->tokens[idx].len = (uint32_t)n;
+        p += n;
+    }
+    if (c == '{' || c == '[')
+        doc->tokens[idx].len = (uint32_t)(p - doc->tokens[idx].start);
+    doc->tokens[idx].next = (uint32_t)doc->count;
+    *pos = p;
+    return 0;
+}
+
+/** @copydoc jsr_parse */
+int jsr_parse (jsr_doc_t *doc, const char *json, size_t len) {
+    if (!doc || !json || len > UINT32_MAX)
+        return -1;
+    doc->json = json;
+    doc->len = len;
+    doc->count = 0;
+    size_t pos = 0;
+    if (jsr_parse_value (doc, &pos, 0) != 0 || jsr_skip_ws_n (doc, pos) != len) {
+        doc->count = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/** @copydoc jsr_doc_member */
+size_t jsr_doc_member (const jsr_doc_t *doc, size_t obj, const char *key) {
+    if (!doc || !key || obj >= doc->count || doc->tokens[obj].type != JSR_OBJECT)
+        return JSR_NONE;
+    size_t klen = strlen (key);
+    size_t end = doc->tokens[obj].next;
+    for (size_t k = obj + 1; k < end; k = doc->tokens[k + 1].next) {
+        const jsr_token_t *t = &doc->tokens[k];
+        if (t->len == klen && memcmp (doc->json + t->start, key, klen) == 0)
+            return k + 1;
+    }
+    return JSR_NONE;
+}
+
+/** @copydoc jsr_doc_path */
+size_t jsr_doc_path (const jsr_doc_t *doc, const char *path) {
+    if (!doc || !path || doc->count == 0)
+        return JSR_NONE;
+    size_t tok = 0;
+    char key[128];
+    while (*path && tok != JSR_NONE) {
+        const char *dot = strchr (path, '.');
+        size_t n = dot ? (size_t)(dot - path) : strlen (path);
+        if (n >= sizeof (key))
+            return JSR_NONE;
+        memcpy (key, path, n);
+        key[n] = '\0';
+        tok = jsr_doc_member (doc, tok, key);
+        path += n + (dot ? 1 : 0);
+    }
+    return tok;
+}
+
+/** @copydoc jsr_doc_string */
+char *jsr_doc_string (const jsr_doc_t *doc, size_t tok, size_t *out_len) {
+    if (!doc || tok >= doc->count || doc->tokens[tok].type != JSR_STRING)
+        return NULL;
+    const jsr_token_t *t = &doc->tokens[tok];
+    return jsr_unescape (doc->json + t->start, t->len, out_len);
+}
+
+/** @copydoc jsr_doc_double */
+double jsr_doc_double (const jsr_doc_t *doc, size_t tok, double defval) {
+    if (!doc || tok >= doc->count || doc->tokens[tok].type != JSR_NUMBER)
+        return defval;
+    const jsr_token_t *t = &doc->tokens[tok];
+    /* Текст не обовʼязково завершений `\0` — копія для `strtod`. */
+    char buf[64];
+    if (t->len >= sizeof (buf))
+        return defval;
+    memcpy (buf, doc->json + t->start, t->len);
+    buf[t->len] = '\0';
+    char *end;
+    double d = strtod (buf, &end);
+    return end == buf ? defval : d;
+}
+
+/** @copydoc jsr_doc_bool */
+int jsr_doc_bool (const jsr_doc_t *doc, size_t tok, int defval) {
+    if (!doc || tok >= doc->count)
+        return defval;
+    if (doc->tokens[tok].type == JSR_TRUE)
+        return 1;
+    if (doc->tokens[tok].type == JSR_FALSE)
+        return 0;
+    return defval;
+}
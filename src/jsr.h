@@ -12,11 +12,18 @@
  * Обмеження: не виконує повну валідацію JSON, не підтримує повністю `\uXXXX`
  * (підставляє `?`), не розбирає вкладені обʼєкти в глибину та припускає унікальні
  * ключі верхнього рівня. Призначений для невеликих конфігурацій.
+ *
+ * Для документів, з яких читається багато полів, є стрічка токенів (`jsr_doc_t`):
+ * один прохід будує масив токенів (тип, зсув, довжина, кінець піддерева) без
+ * виділення памʼяті на значення, після чого пошук за ключем чи шляхом іде по
+ * токенах, а не по тексту. Стрічку можна перевикористовувати для рядків JSONL —
+ * ємність зберігається між викликами `jsr_parse`.
  */
 #ifndef CPLOT_JSR_H
 #define CPLOT_JSR_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -78,6 +85,94 @@ int jsr_json_get_bool (const char *json, const char *key, int defval);
  */
 double jsr_json_get_double (const char *json, const char *key, double defval);
 
+/** Позначка відсутнього токена. */
+#define JSR_NONE SIZE_MAX
+
+/**
+ * @brief Тип токена стрічки.
+ */
+typedef enum {
+    JSR_OBJECT = 1, /**< Обʼєкт: далі пари токенів ключ (рядок) — значення. */
+    JSR_ARRAY,      /**< Масив: далі елементи. */
+    JSR_STRING,     /**< Рядок (зсув і довжина — без лапок, ескейпи не розкрито). */
+    JSR_NUMBER,     /**< Число. */
+    JSR_TRUE,       /**< `true`. */
+    JSR_FALSE,      /**< `false`. */
+    JSR_NULL        /**< `null`. */
+} jsr_type_t;
+
+/**
+ * @brief Токен стрічки.
+ */
+typedef struct {
+    uint32_t type;  /**< `jsr_type_t`. */
+    uint32_t start; /**< Зсув першого байта у документі. */
+    uint32_t len;   /**< Довжина, байт (для контейнерів — до закривної дужки включно). */
+    uint32_t next;  /**< Індекс першого токена після піддерева. */
+} jsr_token_t;
+
+/**
+ * @brief Розібраний документ: стрічка токенів над вихідним буфером.
+ */
+typedef struct {
+    const char *json;    /**< Вихідний текст (не копіюється; має жити довше за стрічку). */
+    size_t len;          /**< Довжина тексту, байт. */
+    jsr_token_t *tokens; /**< Токени в порядку документа; [0] — корінь. */
+    size_t count;        /**< Кількість токенів. */
+    size_t cap;          /**< Ємність `tokens`. */
+} jsr_doc_t;
+
+/** Ініціалізує порожню стрічку. */
+void jsr_doc_init (jsr_doc_t *doc);
+
+/** Звільняє стрічку (NULL — no-op). */
+void jsr_doc_free (jsr_doc_t *doc);
+
+/**
+ * @brief Будує стрічку токенів за один прохід.
+ * @details Попередній вміст стрічки відкидається, ємність зберігається. Після
+ *          значення верхнього рівня допускаються лише пробіли.
+ * @param doc Стрічка (ініціалізована).
+ * @param json Текст (не обовʼязково завершений `\0`).
+ * @param len Довжина тексту, байт.
+ * @return 0 — успіх; -1 — синтаксична помилка, завелика вкладеність або брак памʼяті.
+ */
+int jsr_parse (jsr_doc_t *doc, const char *json, size_t len);
+
+/**
+ * @brief Значення за ключем в обʼєкті.
+ * @param doc Стрічка.
+ * @param obj Токен обʼєкта (0 — корінь).
+ * @param key Ключ (порівнюється з сирим текстом ключа).
+ * @return Індекс токена значення або `JSR_NONE`.
+ */
+size_t jsr_doc_member (const jsr_doc_t *doc, size_t obj, const char *key);
+
+/**
+ * @brief Значення за шляхом з ключів через крапку від кореня (`"a.b.c"`).
+ * @return Індекс токена значення або `JSR_NONE`.
+ */
+size_t jsr_doc_path (const jsr_doc_t *doc, const char *path);
+
+/**
+ * @brief Копіює рядковий токен у нову памʼять, розкриваючи ескейпи.
+ * @param doc Стрічка.
+ * @param tok Токен (`JSR_NONE` або не рядок — `NULL`).
+ * @param out_len [out] Якщо не `NULL` — довжина без термінатора.
+ * @return Рядок (звільнити `free()`) або `NULL`.
+ */
+char *jsr_doc_string (const jsr_doc_t *doc, size_t tok, size_t *out_len);
+
+/**
+ * @brief Число з токена; `defval`, якщо токен відсутній чи не число.
+ */
+double jsr_doc_double (const jsr_doc_t *doc, size_t tok, double defval);
+
+/**
+ * @brief Булеве значення з токена; `defval`, якщо токен відсутній чи не булевий.
+ */
+int jsr_doc_bool (const jsr_doc_t *doc, size_t tok, int defval);
+
 #ifdef __cplusplus
 }
 #endif
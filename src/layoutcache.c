@@ -0,0 +1,1070 @@
+/**
+ * @file layoutcache.c
+ * @brief Реалізація дискового кешу розверстаних контурів тексту.
+ * @ingroup layoutcache
+ * @details
+ * Формат файлу (порядок байтів хоста, кеш не переноситься між машинами):
+ * заголовок `layoutcache_header_t`, довжини шляхів (`uint32_t`, вирівняні до 8 байт),
+ * координати (`double` парами), текст і родина ключа. Координати зберігаються з
+ * повною точністю, тож превʼю з кешу побайтно збігається зі свіжою версткою.
+ * Заголовок і запис блоку несуть `geom_hash_t` своїх контурів: він рахується тим
+ * самим проходом, що копіює точки, і відсіює записи, координати яких при читанні
+ * розходяться зі збереженими більш ніж на мікрометр.
+ *
+ * Кеш блоків Markdown — хеш-таблиця процесу під мʼютексом (блоки рендеряться
+ * паралельно). Файл `blocks.bin` містить заголовок і всі записи таблиці підряд;
+ * він читається цілком і переписується одним файлом, бо блоків у документі сотні.
+ */
+
+#include "layoutcache.h"
+
+#include "config.h"
+#include "fontreg.h"
+#include "log.h"
+#include "str.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+/** Сигнатура файлу кешу. */
+#define LAYOUTCACHE_MAGIC "CPLLAYC"
+
+/** Версія формату; збільшується за будь-якої зміни структури чи верстки. */
+#define LAYOUTCACHE_VERSION 3u
+
+/** Скільки записів лишається в каталозі після збереження нового (решта — найстаріші). */
+#define LAYOUTCACHE_MAX_ENTRIES 32
+
+/**
+ * @brief Заголовок файлу кешу.
+ */
+typedef struct {
+    char magic[8];            /**< `LAYOUTCACHE_MAGIC` із NUL. */
+    uint32_t version;         /**< `LAYOUTCACHE_VERSION`. */
+    uint32_t header_size;     /**< sizeof (layoutcache_header_t). */
+    uint64_t fonts_stamp;     /**< Відбиток шрифтів реєстру. */
+    double size_pt;           /**< Кегль ключа, пт. */
+    double frame_width_mm;    /**< Ширина рамки ключа, мм. */
+    uint32_t style_flags;     /**< Стиль ключа. */
+    uint32_t break_mode;      /**< Алгоритм розбиття на рядки ключа. */
+    uint64_t text_len;        /**< Довжина тексту ключа, байт. */
+    uint64_t family_len;      /**< Довжина родини ключа, байт (без NUL). */
+    uint64_t path_count;      /**< Кількість шляхів. */
+    uint64_t point_total;     /**< Загальна кількість точок. */
+    double info_size_pt;      /**< `text_render_info_t::size_pt`. */
+    double info_line_height;  /**< `text_render_info_t::line_height`. */
+    uint64_t info_rendered;   /**< `text_render_info_t::rendered_glyphs`. */
+    uint64_t info_missing;    /**< `text_render_info_t::missing_glyphs`. */
+    uint64_t info_resolved;   /**< `text_render_info_t::resolved_glyphs`. */
+    char resolved_family[96]; /**< `text_render_info_t::resolved_family`. */
+    uint64_t geom_hash;       /**< `geom_hash_t` контурів. */
+    uint64_t file_size;       /**< Повний розмір файлу. */
+} layoutcache_header_t;
+
+/**
+ * @brief Зсуви секцій файлу, що випливають із лічильників заголовка.
+ */
+typedef struct {
+    uint64_t lens;   /**< Довжини шляхів. */
+    uint64_t coords; /**< Координати. */
+    uint64_t text;   /**< Текст ключа. */
+    uint64_t family; /**< Родина ключа. */
+    uint64_t end;    /**< Кінець файлу. */
+} layoutcache_layout_t;
+
+/**
+ * @brief Перевіряє, чи кеш не вимкнено змінною середовища.
+ * @return 1 — увімкнено, 0 — вимкнено.
+ */
+static int layoutcache_enabled (void) {
+    const char *env = getenv ("CPLOT_LAYOUT_CACHE");
+    if (env && (strcmp (env, "0") == 0 || str_string_equals_ci (env, "off")
+                || str_string_equals_ci (env, "no")))
+        return 0;
+    return 1;
+}
+
+/**
+ * @brief Обчислює каталог кешу верстки.
+ * @param buf [out] Буфер.
+ * @param buflen Розмір буфера.
+ * @return 0 — успіх; -1 — немає XDG_CACHE_HOME/HOME або замалий буфер.
+ */
+static int layoutcache_dir (char *buf, size_t buflen) {
+    return config_xdg_dir ("XDG_CACHE_HOME", ".cache", "layout", buf, buflen);
+}
+
+/**
+ * @brief Відбиток усіх шрифтів реєстру (шлях, розмір, mtime).
+ * @details Зміна будь-якого SVG-шрифту (зокрема fallback) робить записи застарілими.
+ * @param out [out] Відбиток.
+ * @return 0 — успіх; -1 — реєстр недоступний.
+ */
+static int layoutcache_fonts_stamp (uint64_t *out) {
+    font_face_t *faces = NULL;
+    size_t count = 0;
+    if (fontreg_list (&faces, &count) != 0)
+        return -1;
+    uint64_t hash = STR_FNV1A_OFFSET;
+    for (size_t i = 0; i < count; ++i) {
+        struct stat st;
+        int64_t stamp[3] = { -1, 0, 0 };
+        if (stat (faces[i].path, &st) == 0) {
+            stamp[0] = (int64_t)st.st_size;
+#ifdef __APPLE__
+            stamp[1] = (int64_t)st.st_mtimespec.tv_sec;
+            stamp[2] = (int64_t)st.st_mtimespec.tv_nsec;
+#else
+            stamp[1] = (int64_t)st.st_mtim.tv_sec;
+            stamp[2] = (int64_t)st.st_mtim.tv_nsec;
+#endif
+        }
+        hash = str_fnv1a (hash, faces[i].path, strlen (faces[i].path) + 1);
+        hash = str_fnv1a (hash, stamp, sizeof (stamp));
+    }
+    free (faces);
+    *out = hash;
+    return 0;
+}
+
+/**
+ * @brief Формує шлях файлу кешу для ключа.
+ * @param key Параметри верстки.
+ * @param fonts_stamp Відбиток шрифтів.
+ * @param buf [out] Буфер шляху.
+ * @param buflen Розмір буфера.
+ * @param dir_out [out] Каталог кешу (може бути NULL).
+ * @param dir_len Розмір `dir_out`.
+ * @return 0 — успіх; -1 — помилка.
+ */
+static int layoutcache_entry_path (
+    const layoutcache_key_t *key,
+    uint64_t fonts_stamp,
+    char *buf,
+    size_t buflen,
+    char *dir_out,
+    size_t dir_len) {
+    char dir[PATH_MAX];
+    if (layoutcache_dir (dir, sizeof (dir)) != 0)
+        return -1;
+    const char *family = key->family ? key->family : "";
+    uint32_t style = key->style_flags;
+    uint64_t hash = STR_FNV1A_OFFSET;
+    hash = str_fnv1a (hash, key->text, key->text_len);
+    hash = str_fnv1a (hash, family, strlen (family) + 1);
+    hash = str_fnv1a (hash, &key->size_pt, sizeof (key->size_pt));
+    hash = str_fnv1a (hash, &style, sizeof (style));
+    uint32_t break_mode = key->break_mode;
+    hash = str_fnv1a (hash, &break_mode, sizeof (break_mode));
+    hash = str_fnv1a (hash, &key->frame_width_mm, sizeof (key->frame_width_mm));
+    hash = str_fnv1a (hash, &fonts_stamp, sizeof (fonts_stamp));
+    int written = snprintf (buf, buflen, "%s/%016llx.bin", dir, (unsigned long long)hash);
+    if (written < 0 || (size_t)written >= buflen)
+        return -1;
+    if (dir_out && dir_len > 0)
+        str_string_copy (dir_out, dir_len, dir);
+    return 0;
+}
+
+/**
+ * @brief Обчислює зсуви секцій за лічильниками заголовка.
+ * @return 0 — успіх; -1 — переповнення.
+ */
+static int layoutcache_sections (const layoutcache_header_t *hdr, layoutcache_layout_t *out) {
+    if (hdr->path_count > UINT64_MAX / 8 || hdr->point_total > UINT64_MAX / 32
+        || hdr->text_len > UINT64_MAX / 4 || hdr->family_len > UINT64_MAX / 4)
+        return -1;
+    out->lens = sizeof (layoutcache_header_t);
+    uint64_t lens_bytes = hdr->path_count * sizeof (uint32_t);
+    out->coords = out->lens + ((lens_bytes + 7u) & ~(uint64_t)7u);
+    out->text = out->coords + hdr->point_total * 2 * sizeof (double);
+    out->family = out->text + hdr->text_len;
+    out->end = out->family + hdr->family_len;
+    return 0;
+}
+
+/**
+ * @brief Запис каталогу кешу для витіснення.
+ */
+typedef struct {
+    char name[32]; /**< Імʼя файлу. */
+    time_t mtime;  /**< Час останньої зміни. */
+} layoutcache_dirent_t;
+
+/** \brief Порівнює записи за mtime (новіші — першими). */
+static int layoutcache_dirent_cmp (const void *a, const void *b) {
+    const layoutcache_dirent_t *x = (const layoutcache_dirent_t *)a;
+    const layoutcache_dirent_t *y = (const layoutcache_dirent_t *)b;
+    if (x->mtime != y->mtime)
+        return x->mtime > y->mtime ? -1 : 1;
+    return strcmp (x->name, y->name);
+}
+
+/**
+ * @brief Видаляє найстаріші записи, якщо їх більше за `LAYOUTCACHE_MAX_ENTRIES`.
+ * @param dir Каталог кешу.
+ */
+static void layoutcache_prune (const char *dir) {
+    DIR *d = opendir (dir);
+    if (!d)
+        return;
+    layoutcache_dirent_t *list = NULL;
+    size_t count = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir (d)) != NULL) {
+        size_t len = strlen (de->d_name);
+        if (len < 5 || len >= sizeof (list->name) || strcmp (de->d_name + len - 4, ".bin") != 0)
+            continue;
+        char full[PATH_MAX];
+        struct stat st;
+        int written = snprintf (full, sizeof (full), "%s/%s", dir, de->d_name);
+        if (written < 0 || (size_t)written >= sizeof (full) || stat (full, &st) != 0)
+            continue;
+        if (count == cap) {
+            size_t new_cap = cap ? cap * 2 : 64;
+            layoutcache_dirent_t *grown
+                = (layoutcache_dirent_t *)realloc (list, new_cap * sizeof (*grown));
+            if (!grown)
+                break;
+            list = grown;
+            cap = new_cap;
+        }
+        str_string_copy (list[count].name, sizeof (list[count].name), de->d_name);
+        list[count].mtime = st.st_mtime;
+        ++count;
+    }
+    closedir (d);
+    if (count > LAYOUTCACHE_MAX_ENTRIES) {
+        qsort (list, count, sizeof (*list), layoutcache_dirent_cmp);
+        for (size_t i = LAYOUTCACHE_MAX_ENTRIES; i < count; ++i) {
+            char full[PATH_MAX];
+            int written = snprintf (full, sizeof (full), "%s/%s", dir, list[i].name);
+            if (written < 0 || (size_t)written >= sizeof (full))
+                continue;
+            unlink (full);
+        }
+    }
+    free (list);
+}
+
+/** \brief Записує блок у файл; 0 — успіх. */
+static int layoutcache_write (FILE *fp, const void *data, size_t len) {
+    if (len == 0)
+        return 0;
+    return fwrite (data, 1, len, fp) == len ? 0 : -1;
+}
+
+/** @copydoc layoutcache_load */
+int layoutcache_load (
+    const layoutcache_key_t *key, geom_paths_t *out_paths, text_render_info_t *out_info) {
+    if (!key || (key->text_len > 0 && !key->text) || !out_paths)
+        return -1;
+    if (!layoutcache_enabled ())
+        return 1;
+    uint64_t fonts_stamp = 0;
+    char path[PATH_MAX];
+    if (layoutcache_fonts_stamp (&fonts_stamp) != 0
+        || layoutcache_entry_path (key, fonts_stamp, path, sizeof (path), NULL, 0) != 0)
+        return 1;
+
+    FILE *fp = fopen (path, "rb");
+    if (!fp)
+        return 1;
+    struct stat st;
+    if (fstat (fileno (fp), &st) != 0 || st.st_size < (off_t)sizeof (layoutcache_header_t)) {
+        fclose (fp);
+        return 1;
+    }
+    size_t file_len = (size_t)st.st_size;
+    unsigned char *buf = (unsigned char *)malloc (file_len);
+    if (!buf) {
+        fclose (fp);
+        return 1;
+    }
+    size_t got = fread (buf, 1, file_len, fp);
+    fclose (fp);
+
+    layoutcache_header_t hdr;
+    memcpy (&hdr, buf, sizeof (hdr));
+    const char *family = key->family ? key->family : "";
+    size_t family_len = strlen (family);
+    layoutcache_layout_t sec;
+    int valid = got == file_len
+                && memcmp (hdr.magic, LAYOUTCACHE_MAGIC, sizeof (LAYOUTCACHE_MAGIC)) == 0
+                && hdr.version == LAYOUTCACHE_VERSION && hdr.header_size == sizeof (hdr)
+                && hdr.file_size == (uint64_t)file_len && layoutcache_sections (&hdr, &sec) == 0
+                && sec.end == hdr.file_size;
+    if (valid)
+        valid = hdr.fonts_stamp == fonts_stamp && hdr.size_pt == key->size_pt
+                && hdr.frame_width_mm == key->frame_width_mm
+                && hdr.style_flags == (uint32_t)key->style_flags
+                && hdr.break_mode == (uint32_t)key->break_mode
+                && hdr.text_len == (uint64_t)key->text_len
+                && hdr.family_len == (uint64_t)family_len
+                && memcmp (buf + sec.text, key->text ? key->text : "", key->text_len) == 0
+                && memcmp (buf + sec.family, family, family_len) == 0;
+    if (!valid) {
+        log_print (LOG_DEBUG, "кеш верстки: запис %s не підходить", path);
+        free (buf);
+        return 1;
+    }
+
+    geom_paths_t paths;
+    geom_paths_init (&paths, GEOM_UNITS_MM);
+    int rc = geom_paths_reserve (&paths, (size_t)hdr.path_count);
+    const unsigned char *lens = buf + sec.lens;
+    const unsigned char *coords = buf + sec.coords;
+    uint64_t used = 0;
+    geom_hash_t gh;
+    geom_hash_init (&gh);
+    for (uint64_t i = 0; rc == 0 && i < hdr.path_count; ++i) {
+        uint32_t n;
+        memcpy (&n, lens + i * sizeof (n), sizeof (n));
+        if (n > hdr.point_total - used) {
+            rc = -1;
+            break;
+        }
+        geom_point_t *dst = NULL;
+        rc = geom_paths_add_path (&paths, n, &dst);
+        if (rc == 0 && n > 0)
+            memcpy (dst, coords + used * 2 * sizeof (double), (size_t)n * 2 * sizeof (double));
+        if (rc == 0)
+            geom_hash_path (&gh, dst, n);
+        used += n;
+    }
+    if (rc == 0 && (used != hdr.point_total || geom_hash_value (&gh) != hdr.geom_hash))
+        rc = -1;
+    free (buf);
+    if (rc != 0) {
+        geom_paths_free (&paths);
+        log_print (LOG_DEBUG, "кеш верстки: пошкоджений запис %s", path);
+        return 1;
+    }
+
+    if (out_info) {
+        memset (out_info, 0, sizeof (*out_info));
+        hdr.resolved_family[sizeof (hdr.resolved_family) - 1] = '\0';
+        str_string_copy (
+            out_info->resolved_family, sizeof (out_info->resolved_family), hdr.resolved_family);
+        out_info->size_pt = hdr.info_size_pt;
+        out_info->line_height = hdr.info_line_height;
+        out_info->rendered_glyphs = (size_t)hdr.info_rendered;
+        out_info->missing_glyphs = (size_t)hdr.info_missing;
+        out_info->resolved_glyphs = (size_t)hdr.info_resolved;
+    }
+    *out_paths = paths;
+    (void)utime (path, NULL); /* свіжий mtime — запис витісняється останнім */
+    log_print (LOG_DEBUG, "кеш верстки: використано %s (%zu контурів)", path, paths.len);
+    return 0;
+}
+
+/** @copydoc layoutcache_store */
+int layoutcache_store (
+    const layoutcache_key_t *key, const geom_paths_t *paths, const text_render_info_t *info) {
+    if (!key || (key->text_len > 0 && !key->text) || !paths || !info
+        || paths->units != GEOM_UNITS_MM)
+        return -1;
+    if (!layoutcache_enabled ())
+        return 1;
+
+    layoutcache_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, LAYOUTCACHE_MAGIC, sizeof (LAYOUTCACHE_MAGIC));
+    hdr.version = LAYOUTCACHE_VERSION;
+    hdr.header_size = sizeof (hdr);
+    if (layoutcache_fonts_stamp (&hdr.fonts_stamp) != 0)
+        return 1;
+    const char *family = key->family ? key->family : "";
+    hdr.size_pt = key->size_pt;
+    hdr.frame_width_mm = key->frame_width_mm;
+    hdr.style_flags = (uint32_t)key->style_flags;
+    hdr.break_mode = (uint32_t)key->break_mode;
+    hdr.text_len = key->text_len;
+    hdr.family_len = strlen (family);
+    hdr.path_count = paths->len;
+    geom_hash_t gh;
+    geom_hash_init (&gh);
+    for (size_t i = 0; i < paths->len; ++i) {
+        if (paths->items[i].len > UINT32_MAX)
+            return -1;
+        hdr.point_total += paths->items[i].len;
+        geom_hash_path (&gh, paths->items[i].pts, paths->items[i].len);
+    }
+    hdr.geom_hash = geom_hash_value (&gh);
+    hdr.info_size_pt = info->size_pt;
+    hdr.info_line_height = info->line_height;
+    hdr.info_rendered = info->rendered_glyphs;
+    hdr.info_missing = info->missing_glyphs;
+    hdr.info_resolved = info->resolved_glyphs;
+    str_string_copy (hdr.resolved_family, sizeof (hdr.resolved_family), info->resolved_family);
+    layoutcache_layout_t sec;
+    if (layoutcache_sections (&hdr, &sec) != 0)
+        return -1;
+    hdr.file_size = sec.end;
+
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX + 32];
+    if (layoutcache_entry_path (key, hdr.fonts_stamp, path, sizeof (path), dir, sizeof (dir)) != 0
+        || config_mkdir_p (dir) != 0)
+        return 1;
+    static unsigned tmp_seq = 0;
+    unsigned seq = __atomic_fetch_add (&tmp_seq, 1u, __ATOMIC_RELAXED);
+    snprintf (tmp_path, sizeof (tmp_path), "%s.%ld.%u.tmp", path, (long)getpid (), seq);
+    FILE *fp = fopen (tmp_path, "wb");
+    if (!fp)
+        return 1;
+    int rc = layoutcache_write (fp, &hdr, sizeof (hdr));
+    for (size_t i = 0; rc == 0 && i < paths->len; ++i) {
+        uint32_t n = (uint32_t)paths->items[i].len;
+        rc = layoutcache_write (fp, &n, sizeof (n));
+    }
+    static const unsigned char zeros[8] = { 0 };
+    if (rc == 0)
+        rc = layoutcache_write (
+            fp, zeros, (size_t)(sec.coords - sec.lens - hdr.path_count * sizeof (uint32_t)));
+    for (size_t i = 0; rc == 0 && i < paths->len; ++i) {
+        const geom_path_t *p = &paths->items[i];
+        for (size_t j = 0; rc == 0 && j < p->len; ++j) {
+            double xy[2] = { p->pts[j].x, p->pts[j].y };
+            rc = layoutcache_write (fp, xy, sizeof (xy));
+        }
+    }
+    if (rc == 0)
+        rc = layoutcache_write (fp, key->text, key->text_len);
+    if (rc == 0)
+        rc = layoutcache_write (fp, family, (size_t)hdr.family_len);
+    if (fclose (fp) != 0)
+        rc = -1;
+    if (rc == 0 && rename (tmp_path, path) != 0)
+        rc = -1;
+    if (rc != 0) {
+        unlink (tmp_path);
+        log_print (LOG_DEBUG, "кеш верстки: не вдалося записати %s", path);
+        return -1;
+    }
+    log_print (LOG_DEBUG, "кеш верстки: збережено %s (%zu контурів)", path, paths->len);
+    layoutcache_prune (dir);
+    return 0;
+}
+
+/** Сигнатура файлу кешу блоків Markdown. */
+#define LAYOUTCACHE_BLOCKS_MAGIC "CPLMDBC"
+
+/** Версія формату файлу блоків; збільшується за зміни структури чи верстки Markdown. */
+#define LAYOUTCACHE_BLOCKS_VERSION 2u
+
+/** Імʼя файлу кешу блоків у каталозі кешу верстки. */
+#define LAYOUTCACHE_BLOCKS_FILE "blocks.bin"
+
+/** Найбільше записів у таблиці блоків; надлишок витісняється за давністю вжитку. */
+#define LAYOUTCACHE_BLOCKS_MAX_ENTRIES 8192
+
+/** Найбільше точок у таблиці блоків (32 МБ координат). */
+#define LAYOUTCACHE_BLOCKS_MAX_POINTS (2u << 20)
+
+/** Кошиків хеш-таблиці блоків (степінь двійки). */
+#define LAYOUTCACHE_BLOCKS_BUCKETS 4096u
+
+/**
+ * @brief Запис таблиці блоків: ключ і результат верстки блоку.
+ */
+typedef struct layoutcache_block_s {
+    struct layoutcache_block_s *next; /**< Наступний запис кошика. */
+    uint64_t hash;                    /**< Хеш ключа. */
+    uint32_t kind;                    /**< Вид блоку. */
+    uint32_t break_mode;              /**< Алгоритм розбиття на рядки. */
+    double size_pt;                   /**< Базовий кегль, пт. */
+    double frame_width_mm;            /**< Ширина рамки, мм. */
+    double advance_mm;                /**< Крок до наступного блоку, мм. */
+    char *text;                       /**< Джерело блоку (власна копія). */
+    size_t text_len;                  /**< Довжина джерела, байт. */
+    char *family;                     /**< Запитана родина (власна копія, з NUL). */
+    uint32_t *lens;                   /**< Довжини контурів. */
+    size_t path_count;                /**< Кількість контурів. */
+    geom_point_t *pts;                /**< Точки всіх контурів підряд. */
+    size_t point_total;               /**< Загальна кількість точок. */
+    uint64_t geom_hash;               /**< `geom_hash_t` контурів. */
+    text_render_info_t info;          /**< Метрики блоку. */
+    uint64_t used;                    /**< Момент останнього вжитку (лічильник таблиці). */
+} layoutcache_block_t;
+
+/**
+ * @brief Таблиця блоків процесу.
+ */
+typedef struct {
+    pthread_mutex_t lock;                                     /**< Захищає таблицю. */
+    layoutcache_block_t *buckets[LAYOUTCACHE_BLOCKS_BUCKETS]; /**< Ланцюжки записів. */
+    size_t count;                                             /**< Записів. */
+    size_t points;                                            /**< Точок у всіх записах. */
+    uint64_t clock;                                           /**< Лічильник вжитку. */
+    uint64_t fonts_stamp;                                     /**< Відбиток шрифтів таблиці. */
+    bool started;     /**< `layoutcache_blocks_begin` уже викликано. */
+    bool memory_only; /**< Без файлу (сервер). */
+    bool dirty;       /**< Таблиця змінилась після читання файлу. */
+} layoutcache_blocks_t;
+
+static layoutcache_blocks_t g_blocks = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * @brief Заголовок файлу кешу блоків; далі — `entry_count` записів.
+ */
+typedef struct {
+    char magic[8];        /**< `LAYOUTCACHE_BLOCKS_MAGIC` із NUL. */
+    uint32_t version;     /**< `LAYOUTCACHE_BLOCKS_VERSION`. */
+    uint32_t header_size; /**< sizeof (layoutcache_blocks_header_t). */
+    uint64_t fonts_stamp; /**< Відбиток шрифтів реєстру. */
+    uint64_t entry_count; /**< Кількість записів. */
+    uint64_t file_size;   /**< Повний розмір файлу. */
+} layoutcache_blocks_header_t;
+
+/**
+ * @brief Заголовок запису у файлі; далі — довжини контурів (вирівняні до 8 байт),
+ *        координати, джерело і родина (разом вирівняні до 8 байт).
+ */
+typedef struct {
+    uint64_t hash;            /**< Хеш ключа. */
+    uint32_t kind;            /**< Вид блоку. */
+    uint32_t break_mode;      /**< Алгоритм розбиття на рядки. */
+    double size_pt;           /**< Базовий кегль, пт. */
+    double frame_width_mm;    /**< Ширина рамки, мм. */
+    double advance_mm;        /**< Крок до наступного блоку, мм. */
+    uint64_t text_len;        /**< Довжина джерела, байт. */
+    uint64_t family_len;      /**< Довжина родини, байт (без NUL). */
+    uint64_t path_count;      /**< Кількість контурів. */
+    uint64_t point_total;     /**< Загальна кількість точок. */
+    double info_size_pt;      /**< `text_render_info_t::size_pt`. */
+    double info_line_height;  /**< `text_render_info_t::line_height`. */
+    uint64_t info_rendered;   /**< `text_render_info_t::rendered_glyphs`. */
+    uint64_t info_missing;    /**< `text_render_info_t::missing_glyphs`. */
+    uint64_t info_resolved;   /**< `text_render_info_t::resolved_glyphs`. */
+    char resolved_family[96]; /**< `text_render_info_t::resolved_family`. */
+    uint64_t geom_hash;       /**< `geom_hash_t` контурів. */
+} layoutcache_block_record_t;
+
+/** \brief Округлює розмір секції до 8 байт. */
+static uint64_t layoutcache_pad8 (uint64_t n) { return (n + 7u) & ~(uint64_t)7u; }
+
+/** \brief Хеш ключа блоку (без відбитка шрифтів — він спільний для таблиці). */
+static uint64_t layoutcache_block_hash (
+    const char *text,
+    size_t text_len,
+    uint32_t kind,
+    const char *family,
+    double size_pt,
+    double frame_width_mm,
+    uint32_t break_mode) {
+    uint64_t hash = STR_FNV1A_OFFSET;
+    hash = str_fnv1a (hash, text, text_len);
+    hash = str_fnv1a (hash, family, strlen (family) + 1);
+    hash = str_fnv1a (hash, &kind, sizeof (kind));
+    hash = str_fnv1a (hash, &size_pt, sizeof (size_pt));
+    hash = str_fnv1a (hash, &frame_width_mm, sizeof (frame_width_mm));
+    hash = str_fnv1a (hash, &break_mode, sizeof (break_mode));
+    return hash;
+}
+
+/** \brief Звільняє запис таблиці блоків. */
+static void layoutcache_block_free (layoutcache_block_t *e) {
+    if (!e)
+        return;
+    free (e->text);
+    free (e->family);
+    free (e->lens);
+    free (e->pts);
+    free (e);
+}
+
+/**
+ * @brief Шукає запис за ключем (під `g_blocks.lock`).
+ * @return Запис або NULL.
+ */
+static layoutcache_block_t *layoutcache_blocks_find (
+    uint64_t hash,
+    const char *text,
+    size_t text_len,
+    uint32_t kind,
+    const char *family,
+    double size_pt,
+    double frame_width_mm,
+    uint32_t break_mode) {
+    layoutcache_block_t *e = g_blocks.buckets[hash & (LAYOUTCACHE_BLOCKS_BUCKETS - 1u)];
+    for (; e; e = e->next)
+        if (e->hash == hash && e->kind == kind && e->break_mode == break_mode
+            && e->size_pt == size_pt && e->frame_width_mm == frame_width_mm
+            && e->text_len == text_len && memcmp (e->text, text, text_len) == 0
+            && strcmp (e->family, family) == 0)
+            return e;
+    return NULL;
+}
+
+/** \brief Видаляє всі записи таблиці (під `g_blocks.lock`). */
+static void layoutcache_blocks_clear (void) {
+    for (size_t b = 0; b < LAYOUTCACHE_BLOCKS_BUCKETS; ++b) {
+        layoutcache_block_t *e = g_blocks.buckets[b];
+        while (e) {
+            layoutcache_block_t *next = e->next;
+            layoutcache_block_free (e);
+            e = next;
+        }
+        g_blocks.buckets[b] = NULL;
+    }
+    g_blocks.count = 0;
+    g_blocks.points = 0;
+}
+
+/** \brief Порівнює записи за давністю вжитку (давніші — першими). */
+static int layoutcache_block_used_cmp (const void *a, const void *b) {
+    const layoutcache_block_t *x = *(layoutcache_block_t *const *)a;
+    const layoutcache_block_t *y = *(layoutcache_block_t *const *)b;
+    return (x->used > y->used) - (x->used < y->used);
+}
+
+/**
+ * @brief Витісняє найдавніше вживані записи до трьох чвертей меж (під `g_blocks.lock`).
+ * @details Витіснення пачкою робить його рідкісним: сортування раз на тисячі вставок.
+ */
+static void layoutcache_blocks_evict (void) {
+    layoutcache_block_t **all = (layoutcache_block_t **)malloc (g_blocks.count * sizeof (*all));
+    if (!all)
+        return;
+    size_t n = 0;
+    for (size_t b = 0; b < LAYOUTCACHE_BLOCKS_BUCKETS; ++b)
+        for (layoutcache_block_t *e = g_blocks.buckets[b]; e; e = e->next)
+            all[n++] = e;
+    qsort (all, n, sizeof (*all), layoutcache_block_used_cmp);
+    size_t keep_entries = LAYOUTCACHE_BLOCKS_MAX_ENTRIES / 4 * 3;
+    size_t keep_points = LAYOUTCACHE_BLOCKS_MAX_POINTS / 4 * 3;
+    for (size_t i = 0; i < n && (g_blocks.count > keep_entries || g_blocks.points > keep_points);
+         ++i) {
+        layoutcache_block_t *victim = all[i];
+        layoutcache_block_t **link
+            = &g_blocks.buckets[victim->hash & (LAYOUTCACHE_BLOCKS_BUCKETS - 1u)];
+        while (*link != victim)
+            link = &(*link)->next;
+        *link = victim->next;
+        g_blocks.count--;
+        g_blocks.points -= victim->point_total;
+        layoutcache_block_free (victim);
+    }
+    free (all);
+}
+
+/** \brief Додає запис у таблицю і за потреби витісняє давні (під `g_blocks.lock`). */
+static void layoutcache_blocks_insert (layoutcache_block_t *e) {
+    layoutcache_block_t **bucket = &g_blocks.buckets[e->hash & (LAYOUTCACHE_BLOCKS_BUCKETS - 1u)];
+    e->next = *bucket;
+    *bucket = e;
+    e->used = ++g_blocks.clock;
+    g_blocks.count++;
+    g_blocks.points += e->point_total;
+    if (g_blocks.count > LAYOUTCACHE_BLOCKS_MAX_ENTRIES
+        || g_blocks.points > LAYOUTCACHE_BLOCKS_MAX_POINTS)
+        layoutcache_blocks_evict ();
+}
+
+/**
+ * @brief Формує шлях файлу кешу блоків.
+ * @return 0 — успіх; -1 — немає каталогу кешу або замалий буфер.
+ */
+static int layoutcache_blocks_path (char *buf, size_t buflen, char *dir, size_t dir_len) {
+    if (layoutcache_dir (dir, dir_len) != 0)
+        return -1;
+    int written = snprintf (buf, buflen, "%s/%s", dir, LAYOUTCACHE_BLOCKS_FILE);
+    return (written < 0 || (size_t)written >= buflen) ? -1 : 0;
+}
+
+/**
+ * @brief Розбирає один запис файлу блоків.
+ * @param buf Вміст файлу.
+ * @param len Розмір файлу.
+ * @param pos [in,out] Зсув запису; після успіху — зсув наступного.
+ * @return Запис або NULL (пошкоджений файл чи брак памʼяті).
+ */
+static layoutcache_block_t *
+layoutcache_blocks_parse (const unsigned char *buf, uint64_t len, uint64_t *pos) {
+    layoutcache_block_record_t rec;
+    if (len - *pos < sizeof (rec))
+        return NULL;
+    memcpy (&rec, buf + *pos, sizeof (rec));
+    if (rec.path_count > len || rec.point_total > len || rec.text_len > len
+        || rec.family_len > len)
+        return NULL;
+    uint64_t lens_at = *pos + sizeof (rec);
+    uint64_t coords_at = lens_at + layoutcache_pad8 (rec.path_count * sizeof (uint32_t));
+    uint64_t text_at = coords_at + rec.point_total * 2 * sizeof (double);
+    uint64_t end = text_at + layoutcache_pad8 (rec.text_len + rec.family_len);
+    if (end > len)
+        return NULL;
+    layoutcache_block_t *e = (layoutcache_block_t *)calloc (1, sizeof (*e));
+    if (!e)
+        return NULL;
+    e->hash = rec.hash;
+    e->kind = rec.kind;
+    e->break_mode = rec.break_mode;
+    e->size_pt = rec.size_pt;
+    e->frame_width_mm = rec.frame_width_mm;
+    e->advance_mm = rec.advance_mm;
+    e->text_len = (size_t)rec.text_len;
+    e->path_count = (size_t)rec.path_count;
+    e->point_total = (size_t)rec.point_total;
+    e->text = (char *)malloc (e->text_len + 1);
+    e->family = (char *)malloc ((size_t)rec.family_len + 1);
+    e->lens = (uint32_t *)malloc ((e->path_count + 1) * sizeof (*e->lens));
+    e->pts = (geom_point_t *)malloc ((e->point_total + 1) * sizeof (*e->pts));
+    if (!e->text || !e->family || !e->lens || !e->pts) {
+        layoutcache_block_free (e);
+        return NULL;
+    }
+    memcpy (e->lens, buf + lens_at, e->path_count * sizeof (*e->lens));
+    uint64_t sum = 0;
+    for (size_t i = 0; i < e->path_count; ++i)
+        sum += e->lens[i];
+    if (sum != rec.point_total) {
+        layoutcache_block_free (e);
+        return NULL;
+    }
+    geom_hash_t gh;
+    geom_hash_init (&gh);
+    size_t at = 0;
+    for (size_t i = 0; i < e->path_count; ++i) {
+        for (size_t k = at; k < at + e->lens[i]; ++k) {
+            double xy[2];
+            memcpy (xy, buf + coords_at + k * sizeof (xy), sizeof (xy));
+            e->pts[k] = (geom_point_t){ xy[0], xy[1] };
+        }
+        geom_hash_path (&gh, e->pts + at, e->lens[i]);
+        at += e->lens[i];
+    }
+    e->geom_hash = rec.geom_hash;
+    if (geom_hash_value (&gh) != rec.geom_hash) {
+        layoutcache_block_free (e);
+        return NULL;
+    }
+    memcpy (e->text, buf + text_at, e->text_len);
+    e->text[e->text_len] = '\0';
+    memcpy (e->family, buf + text_at + rec.text_len, (size_t)rec.family_len);
+    e->family[rec.family_len] = '\0';
+    rec.resolved_family[sizeof (rec.resolved_family) - 1] = '\0';
+    str_string_copy (
+        e->info.resolved_family, sizeof (e->info.resolved_family), rec.resolved_family);
+    e->info.size_pt = rec.info_size_pt;
+    e->info.line_height = rec.info_line_height;
+    e->info.rendered_glyphs = (size_t)rec.info_rendered;
+    e->info.missing_glyphs = (size_t)rec.info_missing;
+    e->info.resolved_glyphs = (size_t)rec.info_resolved;
+    *pos = end;
+    return e;
+}
+
+/**
+ * @brief Читає файл блоків у таблицю (під `g_blocks.lock`).
+ * @details Файл іншої версії або з іншим відбитком шрифтів ігнорується.
+ */
+static void layoutcache_blocks_read (void) {
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    if (layoutcache_blocks_path (path, sizeof (path), dir, sizeof (dir)) != 0)
+        return;
+    FILE *fp = fopen (path, "rb");
+    if (!fp)
+        return;
+    struct stat st;
+    if (fstat (fileno (fp), &st) != 0 || st.st_size < (off_t)sizeof (layoutcache_blocks_header_t)) {
+        fclose (fp);
+        return;
+    }
+    uint64_t len = (uint64_t)st.st_size;
+    unsigned char *buf = (unsigned char *)malloc ((size_t)len);
+    if (!buf) {
+        fclose (fp);
+        return;
+    }
+    size_t got = fread (buf, 1, (size_t)len, fp);
+    fclose (fp);
+    layoutcache_blocks_header_t hdr;
+    memcpy (&hdr, buf, sizeof (hdr));
+    if (got != len
+        || memcmp (hdr.magic, LAYOUTCACHE_BLOCKS_MAGIC, sizeof (LAYOUTCACHE_BLOCKS_MAGIC)) != 0
+        || hdr.version != LAYOUTCACHE_BLOCKS_VERSION || hdr.header_size != sizeof (hdr)
+        || hdr.file_size != len || hdr.fonts_stamp != g_blocks.fonts_stamp) {
+        log_print (LOG_DEBUG, "кеш блоків: файл %s не підходить", path);
+        free (buf);
+        return;
+    }
+    uint64_t pos = sizeof (hdr);
+    size_t loaded = 0;
+    for (uint64_t i = 0; i < hdr.entry_count; ++i) {
+        layoutcache_block_t *e = layoutcache_blocks_parse (buf, len, &pos);
+        if (!e) {
+            log_print (
+                LOG_DEBUG, "кеш блоків: пошкоджений запис %llu у %s", (unsigned long long)i,
+                path);
+            break;
+        }
+        layoutcache_blocks_insert (e);
+        ++loaded;
+    }
+    free (buf);
+    log_print (LOG_DEBUG, "кеш блоків: прочитано %zu записів з %s", loaded, path);
+}
+
+/** \brief Записує запис таблиці у файл блоків; 0 — успіх. */
+static int layoutcache_blocks_write_entry (FILE *fp, const layoutcache_block_t *e) {
+    layoutcache_block_record_t rec;
+    memset (&rec, 0, sizeof (rec));
+    rec.hash = e->hash;
+    rec.kind = e->kind;
+    rec.break_mode = e->break_mode;
+    rec.size_pt = e->size_pt;
+    rec.frame_width_mm = e->frame_width_mm;
+    rec.advance_mm = e->advance_mm;
+    rec.text_len = e->text_len;
+    rec.family_len = strlen (e->family);
+    rec.path_count = e->path_count;
+    rec.point_total = e->point_total;
+    rec.geom_hash = e->geom_hash;
+    rec.info_size_pt = e->info.size_pt;
+    rec.info_line_height = e->info.line_height;
+    rec.info_rendered = e->info.rendered_glyphs;
+    rec.info_missing = e->info.missing_glyphs;
+    rec.info_resolved = e->info.resolved_glyphs;
+    str_string_copy (rec.resolved_family, sizeof (rec.resolved_family), e->info.resolved_family);
+    static const unsigned char zeros[8] = { 0 };
+    uint64_t lens_bytes = e->path_count * sizeof (uint32_t);
+    uint64_t tail_bytes = rec.text_len + rec.family_len;
+    int rc = layoutcache_write (fp, &rec, sizeof (rec));
+    if (rc == 0)
+        rc = layoutcache_write (fp, e->lens, (size_t)lens_bytes);
+    if (rc == 0)
+        rc = layoutcache_write (fp, zeros, (size_t)(layoutcache_pad8 (lens_bytes) - lens_bytes));
+    for (size_t i = 0; rc == 0 && i < e->point_total; ++i) {
+        double xy[2] = { e->pts[i].x, e->pts[i].y };
+        rc = layoutcache_write (fp, xy, sizeof (xy));
+    }
+    if (rc == 0)
+        rc = layoutcache_write (fp, e->text, e->text_len);
+    if (rc == 0)
+        rc = layoutcache_write (fp, e->family, (size_t)rec.family_len);
+    if (rc == 0)
+        rc = layoutcache_write (fp, zeros, (size_t)(layoutcache_pad8 (tail_bytes) - tail_bytes));
+    return rc;
+}
+
+/**
+ * @brief Записує таблицю блоків у файл (атомарно), якщо вона змінилась.
+ * @details Реєструється через `atexit` першим `layoutcache_blocks_begin`.
+ */
+static void layoutcache_blocks_flush (void) {
+    pthread_mutex_lock (&g_blocks.lock);
+    if (!g_blocks.dirty || g_blocks.memory_only) {
+        pthread_mutex_unlock (&g_blocks.lock);
+        return;
+    }
+    char dir[PATH_MAX];
+    char path[PATH_MAX];
+    char tmp_path[PATH_MAX + 32];
+    FILE *fp = NULL;
+    if (layoutcache_blocks_path (path, sizeof (path), dir, sizeof (dir)) == 0
+        && config_mkdir_p (dir) == 0) {
+        snprintf (tmp_path, sizeof (tmp_path), "%s.%ld.tmp", path, (long)getpid ());
+        fp = fopen (tmp_path, "wb");
+    }
+    if (!fp) {
+        pthread_mutex_unlock (&g_blocks.lock);
+        return;
+    }
+    layoutcache_blocks_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, LAYOUTCACHE_BLOCKS_MAGIC, sizeof (LAYOUTCACHE_BLOCKS_MAGIC));
+    hdr.version = LAYOUTCACHE_BLOCKS_VERSION;
+    hdr.header_size = sizeof (hdr);
+    hdr.fonts_stamp = g_blocks.fonts_stamp;
+    hdr.entry_count = g_blocks.count;
+    int rc = layoutcache_write (fp, &hdr, sizeof (hdr));
+    for (size_t b = 0; rc == 0 && b < LAYOUTCACHE_BLOCKS_BUCKETS; ++b)
+        for (const layoutcache_block_t *e = g_blocks.buckets[b]; rc == 0 && e; e = e->next)
+            rc = layoutcache_blocks_write_entry (fp, e);
+    /* Розмір відомий лише після запису: заголовок перезаписується наприкінці. */
+    long end = rc == 0 ? ftell (fp) : -1;
+    if (end > 0) {
+        hdr.file_size = (uint64_t)end;
+        rc = fseek (fp, 0, SEEK_SET) == 0 ? layoutcache_write (fp, &hdr, sizeof (hdr)) : -1;
+    } else {
+        rc = -1;
+    }
+    if (fclose (fp) != 0)
+        rc = -1;
+    if (rc == 0 && rename (tmp_path, path) != 0)
+        rc = -1;
+    if (rc != 0) {
+        unlink (tmp_path);
+        log_print (LOG_DEBUG, "кеш блоків: не вдалося записати %s", path);
+    } else {
+        g_blocks.dirty = false;
+        log_print (LOG_DEBUG, "кеш блоків: збережено %zu записів у %s", g_blocks.count, path);
+    }
+    pthread_mutex_unlock (&g_blocks.lock);
+}
+
+/** @copydoc layoutcache_blocks_memory_only */
+void layoutcache_blocks_memory_only (void) {
+    pthread_mutex_lock (&g_blocks.lock);
+    g_blocks.memory_only = true;
+    pthread_mutex_unlock (&g_blocks.lock);
+}
+
+/** @copydoc layoutcache_blocks_begin */
+int layoutcache_blocks_begin (void) {
+    if (!layoutcache_enabled ())
+        return 1;
+    uint64_t stamp = 0;
+    if (layoutcache_fonts_stamp (&stamp) != 0)
+        return 1;
+    pthread_mutex_lock (&g_blocks.lock);
+    if (!g_blocks.started) {
+        g_blocks.started = true;
+        g_blocks.fonts_stamp = stamp;
+        if (!g_blocks.memory_only) {
+            layoutcache_blocks_read ();
+            atexit (layoutcache_blocks_flush);
+        }
+    } else if (g_blocks.fonts_stamp != stamp) {
+        layoutcache_blocks_clear ();
+        g_blocks.fonts_stamp = stamp;
+        g_blocks.dirty = true;
+        log_print (LOG_DEBUG, "кеш блоків: шрифти змінились — таблицю очищено");
+    }
+    pthread_mutex_unlock (&g_blocks.lock);
+    return 0;
+}
+
+/** @copydoc layoutcache_block_load */
+int layoutcache_block_load (
+    const layoutcache_block_key_t *key,
+    geom_paths_t *out_paths,
+    double *out_advance_mm,
+    text_render_info_t *out_info) {
+    if (!key || (key->text_len > 0 && !key->text) || !out_paths || !out_advance_mm)
+        return -1;
+    const char *family = key->family ? key->family : "";
+    const char *text = key->text ? key->text : "";
+    uint64_t hash = layoutcache_block_hash (
+        text, key->text_len, key->kind, family, key->size_pt, key->frame_width_mm,
+        key->break_mode);
+    pthread_mutex_lock (&g_blocks.lock);
+    layoutcache_block_t *e = NULL;
+    if (g_blocks.started)
+        e = layoutcache_blocks_find (
+            hash, text, key->text_len, key->kind, family, key->size_pt, key->frame_width_mm,
+            key->break_mode);
+    if (!e) {
+        pthread_mutex_unlock (&g_blocks.lock);
+        return 1;
+    }
+    geom_paths_t paths;
+    int rc = geom_paths_init (&paths, GEOM_UNITS_MM);
+    if (rc == 0)
+        rc = geom_paths_reserve (&paths, e->path_count);
+    const geom_point_t *src = e->pts;
+    for (size_t i = 0; rc == 0 && i < e->path_count; ++i) {
+        geom_point_t *dst = NULL;
+        rc = geom_paths_add_path (&paths, e->lens[i], &dst);
+        if (rc == 0 && e->lens[i] > 0)
+            memcpy (dst, src, e->lens[i] * sizeof (*dst));
+        src += e->lens[i];
+    }
+    if (rc != 0) {
+        pthread_mutex_unlock (&g_blocks.lock);
+        geom_paths_free (&paths);
+        return 1;
+    }
+    e->used = ++g_blocks.clock;
+    *out_advance_mm = e->advance_mm;
+    if (out_info)
+        *out_info = e->info;
+    pthread_mutex_unlock (&g_blocks.lock);
+    *out_paths = paths;
+    return 0;
+}
+
+/** @copydoc layoutcache_block_store */
+int layoutcache_block_store (
+    const layoutcache_block_key_t *key,
+    const geom_paths_t *paths,
+    double advance_mm,
+    const text_render_info_t *info) {
+    if (!key || (key->text_len > 0 && !key->text) || !paths || !info
+        || paths->units != GEOM_UNITS_MM)
+        return -1;
+    const char *family = key->family ? key->family : "";
+    const char *text = key->text ? key->text : "";
+    layoutcache_block_t *e = (layoutcache_block_t *)calloc (1, sizeof (*e));
+    if (!e)
+        return -1;
+    e->kind = key->kind;
+    e->break_mode = key->break_mode;
+    e->size_pt = key->size_pt;
+    e->frame_width_mm = key->frame_width_mm;
+    e->advance_mm = advance_mm;
+    e->text_len = key->text_len;
+    e->path_count = paths->len;
+    for (size_t i = 0; i < paths->len; ++i) {
+        if (paths->items[i].len > UINT32_MAX) {
+            layoutcache_block_free (e);
+            return -1;
+        }
+        e->point_total += paths->items[i].len;
+    }
+    e->text = (char *)malloc (e->text_len + 1);
+    e->family = strdup (family);
+    e->lens = (uint32_t *)malloc ((e->path_count + 1) * sizeof (*e->lens));
+    e->pts = (geom_point_t *)malloc ((e->point_total + 1) * sizeof (*e->pts));
+    if (!e->text || !e->family || !e->lens || !e->pts) {
+        layoutcache_block_free (e);
+        return -1;
+    }
+    memcpy (e->text, text, e->text_len);
+    e->text[e->text_len] = '\0';
+    geom_point_t *dst = e->pts;
+    geom_hash_t gh;
+    geom_hash_init (&gh);
+    for (size_t i = 0; i < paths->len; ++i) {
+        const geom_path_t *p = &paths->items[i];
+        e->lens[i] = (uint32_t)p->len;
+        if (p->len > 0)
+            memcpy (dst, p->pts, p->len * sizeof (*dst));
+        geom_hash_path (&gh, dst, p->len);
+        dst += p->len;
+    }
+    e->geom_hash = geom_hash_value (&gh);
+    e->info = *info;
+    e->hash = layoutcache_block_hash (
+        text, e->text_len, e->kind, family, e->size_pt, e->frame_width_mm, e->break_mode);
+
+    pthread_mutex_lock (&g_blocks.lock);
+    bool started = g_blocks.started;
+    if (!started
+        || layoutcache_blocks_find (
+            e->hash, text, e->text_len, e->kind, family, e->size_pt, e->frame_width_mm,
+            e->break_mode)) {
+        pthread_mutex_unlock (&g_blocks.lock);
+        layoutcache_block_free (e);
+        return started ? 0 : 1;
+    }
+    layoutcache_blocks_insert (e);
+    g_blocks.dirty = true;
+    pthread_mutex_unlock (&g_blocks.lock);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file layoutcache.h
+ * @brief Дисковий кеш розверстаних контурів тексту (XDG_CACHE_HOME).
+ * @defgroup layoutcache Кеш верстки
+ * @ingroup drawing
+ * @details
+ * Зберігає контури тексту до розміщення на сторінці разом із `text_render_info_t`.
+ * Запис ключується всім, від чого залежить верстка: текстом, родиною, кеглем,
+ * стилем, шириною рамки, алгоритмом розбиття на рядки, а також відбитком
+ * (шлях, розмір, mtime) усіх шрифтів реєстру. Поля, орієнтація і масштаб під рамку
+ * застосовуються вже після кешу, тож їх зміна не вимагає повторної верстки. Ключ
+ * зберігається у файлі повністю і звіряється при читанні, хеш лише дає імʼя файлу.
+ *
+ * Окремо ведеться кеш блоків Markdown (`layoutcache_block_*`): контури і висота
+ * кожного блоку верхнього рівня за його джерелом, видом і стилем. Після правки
+ * одного абзацу решта блоків документа береться з кешу і лише зсувається на місце.
+ * Таблиця блоків живе в памʼяті процесу; поза сервером вона читається з одного файлу
+ * `blocks.bin` при першому зверненні і записується назад при виході.
+ *
+ * Каталог: `$XDG_CACHE_HOME/cplot/layout` або `~/.cache/cplot/layout`.
+ * Вимкнення: `CPLOT_LAYOUT_CACHE=0`.
+ */
+#ifndef LAYOUTCACHE_H
+#define LAYOUTCACHE_H
+
+#include "geom.h"
+#include "text.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Параметри верстки, що визначають запис кешу.
+ */
+typedef struct layoutcache_key {
+    const char *text;      /**< Текст (UTF-8, не обовʼязково з NUL). */
+    size_t text_len;       /**< Довжина тексту, байт. */
+    const char *family;    /**< Запитана родина (може бути NULL). */
+    double size_pt;        /**< Кегль, пт. */
+    unsigned style_flags;  /**< Біти `TEXT_STYLE_*`. */
+    double frame_width_mm; /**< Ширина рамки верстки, мм. */
+    unsigned break_mode;   /**< Алгоритм розбиття на рядки (`text_break_mode_t`). */
+} layoutcache_key_t;
+
+/**
+ * @brief Читає контури тексту з кешу.
+ * @param key Параметри верстки.
+ * @param out_paths [out] Контури у мм (звільнити `geom_paths_free`).
+ * @param out_info [out] Відомості про рендеринг (може бути NULL).
+ * @return 0 — знайдено; 1 — відсутній/застарілий/вимкнений; -1 — помилка аргументів.
+ */
+int layoutcache_load (
+    const layoutcache_key_t *key, geom_paths_t *out_paths, text_render_info_t *out_info);
+
+/**
+ * @brief Зберігає контури тексту в кеш (атомарно, через тимчасовий файл).
+ * @param key Параметри верстки.
+ * @param paths Контури у мм.
+ * @param info Відомості про рендеринг.
+ * @return 0 — успіх; 1 — кеш вимкнено/недоступний; -1 — помилка запису.
+ */
+int layoutcache_store (
+    const layoutcache_key_t *key, const geom_paths_t *paths, const text_render_info_t *info);
+
+/**
+ * @brief Параметри, що визначають запис кешу блоків Markdown.
+ */
+typedef struct layoutcache_block_key {
+    const char *text;      /**< Джерело блоку (не обовʼязково з NUL). */
+    size_t text_len;       /**< Довжина джерела, байт. */
+    unsigned kind;         /**< Вид блоку (внутрішній код `markdown.c`). */
+    const char *family;    /**< Запитана родина (може бути NULL). */
+    double size_pt;        /**< Базовий кегль, пт. */
+    double frame_width_mm; /**< Ширина рамки, мм. */
+    unsigned break_mode;   /**< Алгоритм розбиття на рядки (`text_break_mode_t`). */
+} layoutcache_block_key_t;
+
+/**
+ * @brief Готує кеш блоків до верстки документа.
+ * @details При першому виклику читає `blocks.bin` (якщо таблиця не лише в памʼяті) і
+ *          реєструє запис при виході; за зміни шрифтів реєстру очищає таблицю.
+ * @return 0 — кеш доступний; 1 — вимкнений.
+ */
+int layoutcache_blocks_begin (void);
+
+/**
+ * @brief Тримає таблицю блоків лише в памʼяті процесу, без файлу (`cplot serve`).
+ * @details Викликається до першого `layoutcache_blocks_begin`.
+ */
+void layoutcache_blocks_memory_only (void);
+
+/**
+ * @brief Шукає блок у кеші (потокобезпечно).
+ * @param key Параметри блоку.
+ * @param out_paths [out] Контури блоку від y = 0 (звільнити `geom_paths_free`).
+ * @param out_advance_mm [out] Вертикальний крок до наступного блоку, мм.
+ * @param out_info [out] Метрики блоку (може бути NULL).
+ * @return 0 — знайдено; 1 — відсутній або кеш вимкнено; -1 — помилка аргументів.
+ */
+int layoutcache_block_load (
+    const layoutcache_block_key_t *key,
+    geom_paths_t *out_paths,
+    double *out_advance_mm,
+    text_render_info_t *out_info);
+
+/**
+ * @brief Додає блок у кеш (потокобезпечно); найдавніше вживані записи витісняються.
+ * @param key Параметри блоку.
+ * @param paths Контури блоку у мм від y = 0.
+ * @param advance_mm Вертикальний крок до наступного блоку, мм.
+ * @param info Метрики блоку.
+ * @return 0 — успіх; 1 — кеш вимкнено; -1 — помилка аргументів або памʼяті.
+ */
+int layoutcache_block_store (
+    const layoutcache_block_key_t *key,
+    const geom_paths_t *paths,
+    double advance_mm,
+    const text_render_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
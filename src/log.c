@@ -92,6 +92,8 @@ void log_vprint (log_level_t level, const char *fmt, va_list ap) {
         return;
     const char *col = log_level_color (level);
     const char *lab = log_level_label (level);
+    /* Рядок журналу виводиться цілим навіть із кількох потоків. */
+    flockfile (stderr);
     if (g_cfg.use_colors && col[0])
         fprintf (stderr, "%s[%s]%s ", col, lab, NO_COLOR);
     else
@@ -110,6 +112,7 @@ void log_vprint (log_level_t level, const char *fmt, va_list ap) {
 #pragma GCC diagnostic pop
 #endif
     fputc ('\n', stderr);
+    funlockfile (stderr);
 }
 
 /**
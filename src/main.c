@@ -18,8 +18,12 @@
 
 #include "args.h"
 #include "cli.h"
+#include "font.h"
 #include "help.h"
 #include "log.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "ttime.h"
 
 /**
  * @brief Запуск застосунку.
@@ -55,6 +59,14 @@ int main (int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (options.profile)
+        ttime_profile_enable ();
+    telemetry_start (options.telemetry_path);
+    trace_start (options.trace_path);
     int rc = cli_run (&options, argc, argv);
+    trace_stop ();
+    telemetry_stop ();
+    ttime_profile_write_json (stderr);
+    font_shared_cache_clear ();
     return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -7,9 +7,13 @@
 #include "markdown.h"
 
 #include "geom.h"
+#include "layoutcache.h"
+#include "log.h"
+#include "parallel.h"
 #include "shape.h"
 #include "str.h"
 #include "text.h"
+#include "ttime.h"
 
 #include <ctype.h>
 #include <stdbool.h>
@@ -17,6 +21,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+/** Верхня межа робочих потоків рендерингу блоків. */
+#define MARKDOWN_MAX_THREADS 16
+/** Блоків, що рендеряться разом у потоковому режимі (`markdown_render_stream`). */
+#define MARKDOWN_STREAM_WINDOW 32
+
 /**
  * @brief Буфер інлайнового тексту після розмітки Markdown.
  */
@@ -332,6 +341,10 @@ static int markdown_md_render_inline_block (
         .hyphenate = 1,
         .line_spacing = 1.0,
         .break_long_words = force_break ? 1 : 0,
+        .break_mode = opts ? opts->break_mode : TEXT_BREAK_GREEDY,
+        /* Блоки вже верстаються паралельно — без вкладених потоків. */
+        .threads = 1,
+        .arena = opts ? opts->arena : NULL,
     };
 
     geom_paths_t layout_paths;
@@ -346,13 +359,15 @@ static int markdown_md_render_inline_block (
         != 0)
         return 2;
 
-    if (geom_paths_translate (&layout_paths, x_offset_mm, y_offset_mm, &out_block->paths) != 0) {
+    geom_affine_t shift = geom_affine_translation (x_offset_mm, y_offset_mm);
+    int shift_rc = geom_paths_transform (&layout_paths, &shift, &out_block->bbox);
+    if (shift_rc < 0) {
         geom_paths_free (&layout_paths);
         if (lines_local)
             text_layout_free_lines (lines_local);
         return 2;
     }
-    geom_paths_free (&layout_paths);
+    out_block->paths = layout_paths;
 
     if (want_lines) {
         out_block->lines = lines_local;
@@ -361,7 +376,7 @@ static int markdown_md_render_inline_block (
         text_layout_free_lines (lines_local);
     }
 
-    if (geom_bbox_of_paths (&out_block->paths, &out_block->bbox) != 0)
+    if (shift_rc != 0)
         memset (&out_block->bbox, 0, sizeof (out_block->bbox));
 
     return 0;
@@ -399,11 +414,12 @@ static void markdown_first_line_bounds (
     double cutoff_adjust_mm,
     double *top_out,
     double *bottom_out) {
-    if (top_out)
-        *top_out = 0.0;
-    if (bottom_out)
-        *bottom_out = 0.0;
-    if (!paths || paths->len == 0 || !top_out || !bottom_out)
+    if (!top_out || !bottom_out)
+        return;
+    /* Без контурів — номінальний рядок від зсуву блоку, а не від початку документа. */
+    *top_out = y_offset_mm;
+    *bottom_out = y_offset_mm + line_height_mm;
+    if (!paths || paths->len == 0)
         return;
 
     double cutoff = 1e9;
@@ -658,12 +674,102 @@ markdown_table_is_separator_line (const char *line, size_t len, int *align_out,
     return ok;
 }
 
+/**
+ * @brief Обробка одного елемента спільної черги.
+ * @param items Масив елементів.
+ * @param index Індекс елемента.
+ * @param opts Опції рендерингу потоку (з його ареною).
+ */
+typedef void (*md_work_fn) (void *items, size_t index, const markdown_opts_t *opts);
+
+/**
+ * @brief Власні опції виконавця з дочірньою ареною.
+ */
+typedef struct {
+    markdown_opts_t opts; /**< Опції рендерингу з `arena` цього виконавця. */
+    jobarena_t arena;     /**< Дочірня арена (задіяна, лише якщо є батьківська). */
+} md_worker_t;
+
+/**
+ * @brief Спільні дані паралельного проходу.
+ */
+typedef struct {
+    md_work_fn work;     /**< Обробка одного елемента. */
+    void *items;         /**< Елементи в порядку документа. */
+    md_worker_t *worker; /**< Виконавці за номером. */
+} md_work_queue_t;
+
+/**
+ * @brief `parallel_work_fn`: обробляє елемент з опціями свого виконавця.
+ */
+static void markdown_work_item (void *items, size_t index, size_t worker) {
+    md_work_queue_t *queue = (md_work_queue_t *)items;
+    queue->work (queue->items, index, &queue->worker[worker].opts);
+}
+
+/**
+ * @brief Обробляє `count` елементів у робочих потоках; перший працює у викликача.
+ * @details Арена не потокобезпечна, тож кожен потік верстає у власну дочірню, а після
+ *          `parallel_for` її лічильники зливаються в арену `opts`. Потоки, що лишилися
+ *          понад кількість робочих, діляться між ними (`markdown_opts_t::threads`) для
+ *          вкладеної роботи — так єдина велика таблиця документа верстається на всіх
+ *          ядрах, а багато блоків не множать потоки.
+ * @return Кількість задіяних потоків.
+ */
+static size_t
+markdown_run_parallel (md_work_fn work, void *items, size_t count, const markdown_opts_t *opts) {
+    size_t workers = parallel_threads (opts->threads, MARKDOWN_MAX_THREADS, count);
+    size_t share
+        = parallel_threads (opts->threads, MARKDOWN_MAX_THREADS, MARKDOWN_MAX_THREADS) / workers;
+    md_worker_t ctx[MARKDOWN_MAX_THREADS];
+    for (size_t i = 0; i < workers; ++i) {
+        ctx[i].opts = *opts;
+        ctx[i].opts.threads = share ? (unsigned)share : 1u;
+        jobarena_init (&ctx[i].arena, opts->arena ? opts->arena->chunk_size : 0);
+        ctx[i].opts.arena = opts->arena ? &ctx[i].arena : NULL;
+    }
+    md_work_queue_t queue = { .work = work, .items = items, .worker = ctx };
+    size_t used = parallel_for (markdown_work_item, &queue, count, workers);
+    for (size_t i = 0; i < workers; ++i)
+        jobarena_absorb (opts->arena, &ctx[i].arena);
+    return used;
+}
+
+/**
+ * @brief Комірка таблиці: параметри верстки і її результат.
+ */
+typedef struct {
+    const char *text;      /**< Текст комірки (з розбиття рядка). */
+    double x;              /**< Лівий край тексту, мм. */
+    double width;          /**< Ширина тексту, мм. */
+    text_align_t align;    /**< Вирівнювання колонки. */
+    md_render_block_t blk; /**< Контури від y = 0 і їхні межі. */
+    bool rendered;         /**< `blk` заповнено. */
+} md_table_cell_t;
+
+/**
+ * @brief `md_work_fn` для комірок таблиці: верстає комірку від y = 0.
+ * @details Висоту рядка дають межі вже зверстаних комірок, а розміщення лише зсуває
+ *          їх по Y — тож кожна комірка проходить `text_layout_render` один раз.
+ */
+static void markdown_table_cell_work (void *items, size_t index, const markdown_opts_t *opts) {
+    md_table_cell_t *cell = &((md_table_cell_t *)items)[index];
+    md_inline_buffer_t ib;
+    markdown_md_inline_buffer_init (&ib);
+    if (markdown_md_inline_parse (cell->text, &ib) == 0)
+        cell->rendered = markdown_md_render_inline_block (
+                             opts, &ib, markdown_default_font_size (opts), cell->width, cell->x,
+                             0.0, false, cell->align, true, NULL, &cell->blk)
+                         == 0;
+    markdown_md_inline_buffer_dispose (&ib);
+}
+
 /**
  * @brief Прагне розпізнати таблицю Markdown і відрендерити її.
  * @param p Поточна позиція у тексті.
  * @param opts Опції рендерингу.
  * @param y_offset [in,out] Поточний вертикальний зсув; оновлюється після таблиці.
- * @param out [out] Акумулятор контурів (додаються нові шляхи).
+ * @param out [out] Акумулятор контурів (додаються нові шляхи); `NULL` — лише знайти межі блоку.
  * @param p_out [out] Позиція після обробленого блоку.
  * @return 1 — таблицю оброблено; 0 — це не таблиця; 2 — помилка.
  */
@@ -675,7 +781,7 @@ static int markdown_try_table (
     const char **p_out) {
     if (p_out)
         *p_out = p;
-    if (!p || !opts || !y_offset || !out)
+    if (!p || !opts || !y_offset)
         return 0;
 
     const char *line1_end = strchr (p, '\n');
@@ -768,147 +874,78 @@ static int markdown_try_table (
         cursor = le ? (le + 1) : (cursor + ll);
     }
 
+    if (!out) {
+        if (p_out)
+            *p_out = cursor;
+        markdown_table_free_cells (head_cells, head_cols);
+        for (size_t r = 0; r < rows_len; ++r)
+            markdown_table_free_cells (rows[r], row_counts[r]);
+        free (rows);
+        free (row_counts);
+        free (align);
+        return 1;
+    }
+
     const double padding = 1.5;
     const double frame_w = opts->frame_width_mm;
     double col_w = frame_w / (double)cols;
+    double fw = col_w - 2.0 * padding;
+    if (!(fw > 4.0))
+        fw = 4.0;
 
     double base_line_mm = markdown_pt_to_mm (markdown_default_font_size (opts));
     double y = *y_offset;
 
-    {
-        double max_h = 0.0;
-        for (size_t ci = 0; ci < cols; ++ci) {
-            const char *text = (ci < head_cols) ? head_cells[ci] : "";
-            md_inline_buffer_t ib;
-            markdown_md_inline_buffer_init (&ib);
-            if (markdown_md_inline_parse (text, &ib) == 0) {
-                double x = (double)ci * col_w + padding;
-                double fw = col_w - 2.0 * padding;
-                if (!(fw > 4.0))
-                    fw = 4.0;
-                md_render_block_t blk;
-                text_render_info_t ci_info;
-                if (markdown_md_render_inline_block (
-                        opts, &ib, markdown_default_font_size (opts), fw, x, y, true,
-                        (align[ci] == 1)   ? TEXT_ALIGN_CENTER
-                        : (align[ci] == 2) ? TEXT_ALIGN_RIGHT
-                                           : TEXT_ALIGN_LEFT,
-                        true, &ci_info, &blk)
-                    == 0) {
-                    double h = blk.bbox.max_y - blk.bbox.min_y;
-                    if (h > max_h)
-                        max_h = h;
-                    markdown_md_render_block_dispose (&blk);
-                }
-            }
-            markdown_md_inline_buffer_dispose (&ib);
-        }
-        double min_row_h = markdown_pt_to_mm (markdown_default_font_size (opts)) + 2.0 * padding;
-        double row_h = max_h + 2.0 * padding;
-        if (!(row_h > min_row_h))
-            row_h = min_row_h;
-
-        for (size_t ci = 0; ci < cols; ++ci) {
-            const char *text = (ci < head_cols) ? head_cells[ci] : "";
-            md_inline_buffer_t ib;
-            markdown_md_inline_buffer_init (&ib);
-            if (markdown_md_inline_parse (text, &ib) == 0) {
-                double x = (double)ci * col_w + padding;
-                double fw = col_w - 2.0 * padding;
-                if (!(fw > 4.0))
-                    fw = 4.0;
-                md_render_block_t blk;
-                text_render_info_t ci_info;
-                if (markdown_md_render_inline_block (
-                        opts, &ib, markdown_default_font_size (opts), fw, x, y, true,
-                        (align[ci] == 1)   ? TEXT_ALIGN_CENTER
-                        : (align[ci] == 2) ? TEXT_ALIGN_RIGHT
-                                           : TEXT_ALIGN_LEFT,
-                        true, &ci_info, &blk)
-                    == 0) {
-                    double desired_top = y + padding;
-                    double dy = desired_top - blk.bbox.min_y;
-                    geom_paths_t shifted;
-                    if (geom_paths_translate (&blk.paths, 0.0, dy, &shifted) == 0) {
-                        (void)markdown_paths_append (out, &shifted);
-                        geom_paths_free (&shifted);
-                    }
-                    markdown_md_render_block_dispose (&blk);
-                }
-            }
-            markdown_md_inline_buffer_dispose (&ib);
-        }
+    /* Рядок 0 — заголовок; кожна комірка верстається один раз і від y = 0. */
+    size_t row_total = rows_len + 1;
+    md_table_cell_t *grid = NULL;
+    if (row_total <= SIZE_MAX / cols / sizeof (*grid))
+        grid = (md_table_cell_t *)calloc (row_total * cols, sizeof (*grid));
+    if (!grid) {
+        markdown_table_free_cells (head_cells, head_cols);
+        for (size_t r = 0; r < rows_len; ++r)
+            markdown_table_free_cells (rows[r], row_counts[r]);
+        free (rows);
+        free (row_counts);
+        free (align);
+        return 2;
+    }
+    for (size_t r = 0; r < row_total; ++r) {
+        char **cells = r ? rows[r - 1] : head_cells;
+        size_t cc = r ? row_counts[r - 1] : head_cols;
         for (size_t ci = 0; ci < cols; ++ci) {
-            double x0 = (double)ci * col_w;
-            (void)shape_rect (out, x0, y, col_w, row_h);
+            md_table_cell_t *cell = &grid[r * cols + ci];
+            cell->text = (ci < cc) ? cells[ci] : "";
+            cell->x = (double)ci * col_w + padding;
+            cell->width = fw;
+            cell->align = (align[ci] == 1)   ? TEXT_ALIGN_CENTER
+                          : (align[ci] == 2) ? TEXT_ALIGN_RIGHT
+                                             : TEXT_ALIGN_LEFT;
         }
-        y += row_h;
     }
+    (void)markdown_run_parallel (markdown_table_cell_work, grid, row_total * cols, opts);
 
-    for (size_t r = 0; r < rows_len; ++r) {
-        char **cells = rows[r];
-        size_t cc = row_counts[r];
+    double min_row_h = markdown_pt_to_mm (markdown_default_font_size (opts)) + 2.0 * padding;
+    for (size_t r = 0; r < row_total; ++r) {
+        md_table_cell_t *row = &grid[r * cols];
         double max_h = 0.0;
         for (size_t ci = 0; ci < cols; ++ci) {
-            const char *text = (ci < cc) ? cells[ci] : "";
-            md_inline_buffer_t ib;
-            markdown_md_inline_buffer_init (&ib);
-            if (markdown_md_inline_parse (text, &ib) == 0) {
-                double x = (double)ci * col_w + padding;
-                double fw = col_w - 2.0 * padding;
-                if (!(fw > 4.0))
-                    fw = 4.0;
-                md_render_block_t blk;
-                text_render_info_t ci_info;
-                if (markdown_md_render_inline_block (
-                        opts, &ib, markdown_default_font_size (opts), fw, x, y, true,
-                        (align[ci] == 1)   ? TEXT_ALIGN_CENTER
-                        : (align[ci] == 2) ? TEXT_ALIGN_RIGHT
-                                           : TEXT_ALIGN_LEFT,
-                        true, &ci_info, &blk)
-                    == 0) {
-                    double h = blk.bbox.max_y - blk.bbox.min_y;
-                    if (h > max_h)
-                        max_h = h;
-                    markdown_md_render_block_dispose (&blk);
-                }
-            }
-            markdown_md_inline_buffer_dispose (&ib);
+            if (!row[ci].rendered)
+                continue;
+            double h = row[ci].blk.bbox.max_y - row[ci].blk.bbox.min_y;
+            if (h > max_h)
+                max_h = h;
         }
-        double min_row_h = markdown_pt_to_mm (markdown_default_font_size (opts)) + 2.0 * padding;
         double row_h = max_h + 2.0 * padding;
         if (!(row_h > min_row_h))
             row_h = min_row_h;
 
         for (size_t ci = 0; ci < cols; ++ci) {
-            const char *text = (ci < cc) ? cells[ci] : "";
-            md_inline_buffer_t ib;
-            markdown_md_inline_buffer_init (&ib);
-            if (markdown_md_inline_parse (text, &ib) == 0) {
-                double x = (double)ci * col_w + padding;
-                double fw = col_w - 2.0 * padding;
-                if (!(fw > 4.0))
-                    fw = 4.0;
-                md_render_block_t blk;
-                text_render_info_t ci_info;
-                if (markdown_md_render_inline_block (
-                        opts, &ib, markdown_default_font_size (opts), fw, x, y, true,
-                        (align[ci] == 1)   ? TEXT_ALIGN_CENTER
-                        : (align[ci] == 2) ? TEXT_ALIGN_RIGHT
-                                           : TEXT_ALIGN_LEFT,
-                        true, &ci_info, &blk)
-                    == 0) {
-                    double desired_top = y + padding;
-                    double dy = desired_top - blk.bbox.min_y;
-                    geom_paths_t shifted;
-                    if (geom_paths_translate (&blk.paths, 0.0, dy, &shifted) == 0) {
-                        (void)markdown_paths_append (out, &shifted);
-                        geom_paths_free (&shifted);
-                    }
-                    markdown_md_render_block_dispose (&blk);
-                }
-            }
-            markdown_md_inline_buffer_dispose (&ib);
+            if (!row[ci].rendered)
+                continue;
+            double dy = y + padding - row[ci].blk.bbox.min_y;
+            if (geom_paths_translate_inplace (&row[ci].blk.paths, 0.0, dy) == 0)
+                (void)markdown_paths_append (out, &row[ci].blk.paths);
         }
         for (size_t ci = 0; ci < cols; ++ci) {
             double x0 = (double)ci * col_w;
@@ -916,6 +953,10 @@ static int markdown_try_table (
         }
         y += row_h;
     }
+    for (size_t i = 0; i < row_total * cols; ++i)
+        if (grid[i].rendered)
+            markdown_md_render_block_dispose (&grid[i].blk);
+    free (grid);
 
     *y_offset = y + base_line_mm;
     if (p_out)
@@ -1186,35 +1227,28 @@ static int markdown_render_ol_item (
     double label_baseline = (label_block.line_count > 0) ? label_block.lines[0].baseline_y : 0.0;
     double label_y = *y_offset + text_baseline - label_baseline;
 
-    geom_paths_t label_shifted;
-    if (geom_paths_translate (&label_block.paths, indent_mm, label_y, &label_shifted) != 0) {
+    if (geom_paths_translate_inplace (&label_block.paths, indent_mm, label_y) != 0
+        || markdown_paths_append (out, &label_block.paths) != 0) {
         markdown_md_render_block_dispose (&label_block);
         markdown_md_render_block_dispose (&item_block);
         return 2;
     }
 
-    if (markdown_paths_append (out, &label_shifted) != 0) {
-        geom_paths_free (&label_shifted);
-        markdown_md_render_block_dispose (&label_block);
-        markdown_md_render_block_dispose (&item_block);
-        return 2;
-    }
-    geom_paths_free (&label_shifted);
-
     if (markdown_paths_append (out, &item_block.paths) != 0) {
         markdown_md_render_block_dispose (&label_block);
         markdown_md_render_block_dispose (&item_block);
         return 2;
     }
 
-    double top = item_block.bbox.min_y;
-    double bottom = item_block.bbox.max_y;
-    double label_top = label_block.bbox.min_y + label_y;
-    double label_bottom = label_block.bbox.max_y + label_y;
-    if (label_top < top)
-        top = label_top;
-    if (label_bottom > bottom)
-        bottom = label_bottom;
+    /* Пункт без жодного гліфа має нульовий bbox, що не залежить від зсуву блоку. */
+    double top = label_block.bbox.min_y + label_y;
+    double bottom = label_block.bbox.max_y + label_y;
+    if (item_block.paths.len > 0) {
+        if (item_block.bbox.min_y < top)
+            top = item_block.bbox.min_y;
+        if (item_block.bbox.max_y > bottom)
+            bottom = item_block.bbox.max_y;
+    }
 
     double line_height_mm = markdown_line_height (&item_info, size_pt);
     double block_h = bottom - top;
@@ -1232,7 +1266,7 @@ static int markdown_render_ol_item (
  * @param p Поточна позиція тексту.
  * @param opts Опції рендерингу.
  * @param y_offset [in,out] Поточний вертикальний зсув; оновлюється.
- * @param out [out] Акумулятор контурів.
+ * @param out [out] Акумулятор контурів; `NULL` — лише знайти межі блоку.
  * @param info [out] Метрики останнього текстового блоку (може бути `NULL`).
  * @param out_next [out] Позиція після обробленого рядка.
  * @return 1 — оброблено; 0 — не заголовок; 2 — помилка.
@@ -1264,6 +1298,11 @@ static int markdown_try_heading (
         return 0;
 
     ++cursor;
+    if (!out) {
+        if (out_next)
+            *out_next = line_end ? (line_end + 1) : (p + linelen);
+        return 1;
+    }
     size_t text_len = (size_t)(linelen - (cursor - p));
     char *heading = (char *)malloc (text_len + 1);
     if (!heading)
@@ -1291,7 +1330,7 @@ static int markdown_try_heading (
  * @param p Поточна позиція тексту.
  * @param opts Опції рендерингу.
  * @param y_offset [in,out] Поточний вертикальний зсув; оновлюється.
- * @param out [out] Акумулятор контурів.
+ * @param out [out] Акумулятор контурів; `NULL` — лише знайти межі блоку.
  * @param info [out] Метрики останнього текстового блоку (може бути `NULL`).
  * @param out_next [out] Позиція після обробленого блоку.
  * @return 1 — оброблено; 0 — не абзац; 2 — помилка.
@@ -1371,16 +1410,20 @@ static int markdown_try_paragraph (
     else
         buffer[0] = '\0';
 
-    double size_pt = markdown_default_font_size (opts);
-    double block_h = 0.0;
-    int rc = markdown_render_text_block (buffer, opts, size_pt, *y_offset, out, info, &block_h);
+    if (out) {
+        double size_pt = markdown_default_font_size (opts);
+        double block_h = 0.0;
+        int rc
+            = markdown_render_text_block (buffer, opts, size_pt, *y_offset, out, info, &block_h);
+        if (rc != 0) {
+            free (buffer);
+            return 2;
+        }
+        if (!(block_h > 0.0))
+            block_h = markdown_pt_to_mm (size_pt);
+        *y_offset += block_h + markdown_block_gap (opts);
+    }
     free (buffer);
-    if (rc != 0)
-        return 2;
-
-    if (!(block_h > 0.0))
-        block_h = markdown_pt_to_mm (size_pt);
-    *y_offset += block_h + markdown_block_gap (opts);
 
     while (*cursor == '\n')
         ++cursor;
@@ -1471,6 +1514,7 @@ static int markdown_is_ol_marker (const char *line, size_t len, size_t *digits_l
 
 /**
  * @brief Прагне розпізнати та відрендерити блок цитати ('>').
+ * @details За `out == NULL` лише знаходить межі блоку, нічого не рендерячи.
  * @return 1 — оброблено; 0 — не цитата; 2 — помилка.
  */
 static int markdown_parse_blockquote (
@@ -1491,6 +1535,12 @@ static int markdown_parse_blockquote (
         free (block_text);
         return 2;
     }
+    if (!out) {
+        free (block_text);
+        if (p_out)
+            *p_out = next;
+        return 1;
+    }
 
     md_inline_buffer_t inline_buf;
     markdown_md_inline_buffer_init (&inline_buf);
@@ -1545,6 +1595,7 @@ static int markdown_parse_blockquote (
 
 /**
  * @brief Прагне розпізнати та відрендерити невпорядкований список.
+ * @details За `out == NULL` лише знаходить межі блоку, нічого не рендерячи.
  * @return 1 — оброблено; 0 — не список; 2 — помилка.
  */
 static int markdown_parse_unordered_list (
@@ -1567,7 +1618,7 @@ static int markdown_parse_unordered_list (
         return 2;
 
     while (status == 1) {
-        if (markdown_render_ul_item (opts, &item, y_offset, out) != 0) {
+        if (out && markdown_render_ul_item (opts, &item, y_offset, out) != 0) {
             markdown_md_list_item_dispose (&item);
             return 2;
         }
@@ -1588,6 +1639,7 @@ static int markdown_parse_unordered_list (
 
 /**
  * @brief Прагне розпізнати та відрендерити впорядкований список.
+ * @details За `out == NULL` лише знаходить межі блоку, нічого не рендерячи.
  * @return 1 — оброблено; 0 — не список; 2 — помилка.
  */
 static int markdown_parse_ordered_list (
@@ -1629,7 +1681,7 @@ static int markdown_parse_ordered_list (
         prev_level = level;
         counters[level]++;
 
-        if (markdown_render_ol_item (opts, &item, counters[level], y_offset, out) != 0) {
+        if (out && markdown_render_ol_item (opts, &item, counters[level], y_offset, out) != 0) {
             markdown_md_list_item_dispose (&item);
             return 2;
         }
@@ -1650,18 +1702,133 @@ static int markdown_parse_ordered_list (
 }
 
 /**
- * @copydoc markdown_render_paths
+ * @brief Вид блоку верхнього рівня.
  */
-int markdown_render_paths (
-    const char *text, const markdown_opts_t *opts, geom_paths_t *out, text_render_info_t *info) {
-    if (!text || !opts || !out)
-        return 1;
-    if (geom_paths_init (out, GEOM_UNITS_MM) != 0)
-        return 1;
+typedef enum {
+    MD_BLOCK_HEADING = 0, /**< Заголовок `#`..`###`. */
+    MD_BLOCK_QUOTE,       /**< Цитата `>`. */
+    MD_BLOCK_OL,          /**< Впорядкований список. */
+    MD_BLOCK_UL,          /**< Невпорядкований список. */
+    MD_BLOCK_TABLE,       /**< Таблиця. */
+    MD_BLOCK_PARAGRAPH,   /**< Абзац. */
+} md_block_kind_t;
 
-    const char *cursor = text;
-    double y_offset = 0.0;
+/**
+ * @brief Розпізнає блок, що починається з `p`, і рендерить його (якщо `out != NULL`).
+ * @param p Початок рядка.
+ * @param opts Опції рендерингу.
+ * @param y_offset [in,out] Вертикальний зсув; оновлюється лише під час рендерингу.
+ * @param out [out] Акумулятор контурів або `NULL` — лише знайти межі блоку.
+ * @param info [out] Метрики текстового блоку (заголовок/абзац; може бути `NULL`).
+ * @param kind_out [out] Вид розпізнаного блоку.
+ * @param out_next [out] Позиція після блоку.
+ * @return 1 — оброблено; 0 — рядок не належить жодному блоку; 2 — помилка.
+ */
+static int markdown_dispatch_block (
+    const char *p,
+    const markdown_opts_t *opts,
+    double *y_offset,
+    geom_paths_t *out,
+    text_render_info_t *info,
+    md_block_kind_t *kind_out,
+    const char **out_next) {
+    int handled = markdown_try_heading (p, opts, y_offset, out, info, out_next);
+    *kind_out = MD_BLOCK_HEADING;
+    if (handled != 0)
+        return handled;
+    handled = markdown_parse_blockquote (p, opts, y_offset, out, out_next);
+    *kind_out = MD_BLOCK_QUOTE;
+    if (handled != 0)
+        return handled;
+    handled = markdown_parse_ordered_list (p, opts, y_offset, out, out_next);
+    *kind_out = MD_BLOCK_OL;
+    if (handled != 0)
+        return handled;
+    handled = markdown_parse_unordered_list (p, opts, y_offset, out, out_next);
+    *kind_out = MD_BLOCK_UL;
+    if (handled != 0)
+        return handled;
+    handled = markdown_try_table (p, opts, y_offset, out, out_next);
+    *kind_out = MD_BLOCK_TABLE;
+    if (handled != 0)
+        return handled;
+    *kind_out = MD_BLOCK_PARAGRAPH;
+    return markdown_try_paragraph (p, opts, y_offset, out, info, out_next);
+}
+
+/**
+ * @brief Завдання рендерингу одного блоку верхнього рівня.
+ */
+typedef struct {
+    const char *start;       /**< Початок блоку у вхідному тексті. */
+    const char *end;         /**< Позиція після блоку (з першого проходу). */
+    md_block_kind_t kind;    /**< Вид блоку (з першого проходу). */
+    geom_paths_t paths;      /**< Власні контури блоку, від y = 0. */
+    double advance_mm;       /**< Вертикальний крок до наступного блоку (з інтервалом). */
+    text_render_info_t info; /**< Метрики текстового блоку. */
+    int rc;                  /**< 0 — успіх; 1 — помилка рендерингу. */
+    bool cached;             /**< Контури взято з кешу блоків. */
+} md_block_job_t;
+
+/**
+ * @brief Рендерить одне завдання у власний набір контурів.
+ */
+static void markdown_render_job (md_block_job_t *job, const markdown_opts_t *opts) {
+    job->rc = 1;
+    /* Блок визначається своїм джерелом і стилем: незмінений береться з кешу. */
+    layoutcache_block_key_t key = {
+        .text = job->start,
+        .text_len = (size_t)(job->end - job->start),
+        .kind = (unsigned)job->kind,
+        .family = opts->family,
+        .size_pt = opts->base_size_pt,
+        .frame_width_mm = opts->frame_width_mm,
+        .break_mode = (unsigned)opts->break_mode,
+    };
+    if (layoutcache_block_load (&key, &job->paths, &job->advance_mm, &job->info) == 0) {
+        job->cached = true;
+        job->rc = 0;
+        return;
+    }
+    if (geom_paths_init (&job->paths, GEOM_UNITS_MM) != 0)
+        return;
+    double y = 0.0;
+    md_block_kind_t kind = job->kind;
+    const char *next = job->start;
+    int handled
+        = markdown_dispatch_block (job->start, opts, &y, &job->paths, &job->info, &kind, &next);
+    if (handled != 1)
+        return;
+    job->advance_mm = y;
+    job->rc = 0;
+    (void)layoutcache_block_store (&key, &job->paths, job->advance_mm, &job->info);
+}
 
+/**
+ * @brief Звільняє завдання разом із контурами.
+ */
+static void markdown_jobs_dispose (md_block_job_t *jobs, size_t count) {
+    if (!jobs)
+        return;
+    for (size_t i = 0; i < count; ++i)
+        geom_paths_free (&jobs[i].paths);
+    free (jobs);
+}
+
+/**
+ * @brief Знаходить межі блоків верхнього рівня без рендерингу (прохід 1).
+ * @param text Вхідний Markdown.
+ * @param opts Опції рендерингу.
+ * @param out_jobs [out] Завдання в порядку документа (звільнити `markdown_jobs_dispose`).
+ * @param out_count [out] Кількість завдань.
+ * @return 0 — успіх; 1 — помилка розбору або памʼяті.
+ */
+static int markdown_collect_jobs (
+    const char *text, const markdown_opts_t *opts, md_block_job_t **out_jobs, size_t *out_count) {
+    md_block_job_t *jobs = NULL;
+    size_t job_count = 0, job_cap = 0;
+    const char *cursor = text;
+    (void)layoutcache_blocks_begin ();
     while (*cursor) {
         while (*cursor == '\n' || *cursor == '\r')
             ++cursor;
@@ -1669,69 +1836,145 @@ int markdown_render_paths (
             break;
 
         const char *next = cursor;
-        int handled = markdown_try_heading (cursor, opts, &y_offset, out, info, &next);
+        double scan_y = 0.0;
+        md_block_kind_t kind = MD_BLOCK_PARAGRAPH;
+        int handled = markdown_dispatch_block (cursor, opts, &scan_y, NULL, NULL, &kind, &next);
         if (handled == 2) {
-            geom_paths_free (out);
+            markdown_jobs_dispose (jobs, job_count);
             return 1;
         }
-        if (handled == 1) {
-            cursor = next;
+        if (handled == 0) {
+            const char *fallback = strchr (cursor, '\n');
+            cursor = fallback ? (fallback + 1) : (cursor + strlen (cursor));
             continue;
         }
-
-        handled = markdown_parse_blockquote (cursor, opts, &y_offset, out, &next);
-        if (handled == 2) {
-            geom_paths_free (out);
-            return 1;
-        }
-        if (handled == 1) {
-            cursor = next;
-            continue;
+        if (job_count == job_cap) {
+            size_t new_cap = job_cap ? job_cap * 2 : 16;
+            md_block_job_t *grown = (md_block_job_t *)realloc (jobs, new_cap * sizeof (*grown));
+            if (!grown) {
+                markdown_jobs_dispose (jobs, job_count);
+                return 1;
+            }
+            jobs = grown;
+            job_cap = new_cap;
         }
+        md_block_job_t *job = &jobs[job_count++];
+        memset (job, 0, sizeof (*job));
+        job->start = cursor;
+        job->end = next;
+        job->kind = kind;
+        cursor = next;
+    }
+    *out_jobs = jobs;
+    *out_count = job_count;
+    return 0;
+}
 
-        handled = markdown_parse_ordered_list (cursor, opts, &y_offset, out, &next);
-        if (handled == 2) {
-            geom_paths_free (out);
-            return 1;
-        }
-        if (handled == 1) {
-            cursor = next;
-            continue;
-        }
+/** \brief `md_work_fn` для завдань блоків верхнього рівня. */
+static void markdown_render_job_work (void *items, size_t index, const markdown_opts_t *opts) {
+    markdown_render_job (&((md_block_job_t *)items)[index], opts);
+}
 
-        handled = markdown_parse_unordered_list (cursor, opts, &y_offset, out, &next);
-        if (handled == 2) {
-            geom_paths_free (out);
-            return 1;
-        }
-        if (handled == 1) {
-            cursor = next;
-            continue;
-        }
+/**
+ * @brief Рендерить завдання паралельно, кожне від y = 0 (прохід 2).
+ * @param jobs Завдання.
+ * @param count Кількість завдань.
+ * @param opts Опції рендерингу.
+ * @return Кількість задіяних потоків.
+ */
+static size_t
+markdown_render_jobs (md_block_job_t *jobs, size_t count, const markdown_opts_t *opts) {
+    return markdown_run_parallel (markdown_render_job_work, jobs, count, opts);
+}
 
-        handled = markdown_try_table (cursor, opts, &y_offset, out, &next);
-        if (handled == 2) {
-            geom_paths_free (out);
-            return 1;
-        }
-        if (handled == 1) {
-            cursor = next;
-            continue;
-        }
+/**
+ * @brief Верстає Markdown у контури (тіло `markdown_render_paths` без профілю).
+ */
+static int markdown_render_paths_run (
+    const char *text, const markdown_opts_t *opts, geom_paths_t *out, text_render_info_t *info) {
+    if (!text || !opts || !out)
+        return 1;
+    if (geom_paths_init (out, GEOM_UNITS_MM) != 0)
+        return 1;
 
-        handled = markdown_try_paragraph (cursor, opts, &y_offset, out, info, &next);
-        if (handled == 2) {
+    /* Прохід 1: межі блоків без рендерингу. */
+    md_block_job_t *jobs = NULL;
+    size_t job_count = 0;
+    if (markdown_collect_jobs (text, opts, &jobs, &job_count) != 0) {
+        geom_paths_free (out);
+        return 1;
+    }
+
+    /* Прохід 2: блоки незалежні, крім зсуву Y, тож рендеряться паралельно від y = 0. */
+    size_t threads = markdown_render_jobs (jobs, job_count, opts);
+    size_t cached = 0;
+    for (size_t i = 0; i < job_count; ++i)
+        cached += jobs[i].cached ? 1u : 0u;
+    LOGD ("markdown: %zu блоків (з кешу %zu), потоків %zu", job_count, cached, threads);
+
+    /* Прохід 3: складання блоків за виміряними висотами. */
+    double y_offset = 0.0;
+    for (size_t i = 0; i < job_count; ++i) {
+        md_block_job_t *job = &jobs[i];
+        if (job->rc != 0
+            || (y_offset != 0.0 && geom_paths_translate_inplace (&job->paths, 0.0, y_offset) < 0)
+            || markdown_paths_append (out, &job->paths) != 0) {
+            markdown_jobs_dispose (jobs, job_count);
             geom_paths_free (out);
             return 1;
         }
-        if (handled == 1) {
-            cursor = next;
-            continue;
-        }
-
-        const char *fallback = strchr (cursor, '\n');
-        cursor = fallback ? (fallback + 1) : (cursor + strlen (cursor));
+        if (info && (job->kind == MD_BLOCK_HEADING || job->kind == MD_BLOCK_PARAGRAPH))
+            *info = job->info;
+        y_offset += job->advance_mm;
     }
-
+    markdown_jobs_dispose (jobs, job_count);
     return 0;
 }
+
+/**
+ * @copydoc markdown_render_paths
+ */
+int markdown_render_paths (
+    const char *text, const markdown_opts_t *opts, geom_paths_t *out, text_render_info_t *info) {
+    uint64_t t0 = ttime_stage_begin ();
+    int rc = markdown_render_paths_run (text, opts, out, info);
+    ttime_stage_end (TTIME_STAGE_MARKDOWN, t0);
+    return rc;
+}
+
+/**
+ * @copydoc markdown_render_stream
+ */
+int markdown_render_stream (
+    const char *text, const markdown_opts_t *opts, markdown_block_fn fn, void *ctx) {
+    if (!text || !opts || !fn)
+        return 1;
+    uint64_t t0 = ttime_stage_begin ();
+    md_block_job_t *jobs = NULL;
+    size_t job_count = 0;
+    int rc = markdown_collect_jobs (text, opts, &jobs, &job_count);
+    ttime_stage_end (TTIME_STAGE_MARKDOWN, t0);
+    if (rc != 0)
+        return 1;
+
+    /* Вікно блоків рендериться паралельно і віддається по порядку; контури вікна
+     * звільняються до наступного, тож памʼять не залежить від довжини документа. */
+    size_t cached = 0;
+    for (size_t base = 0; base < job_count && rc == 0; base += MARKDOWN_STREAM_WINDOW) {
+        size_t n = job_count - base;
+        if (n > MARKDOWN_STREAM_WINDOW)
+            n = MARKDOWN_STREAM_WINDOW;
+        t0 = ttime_stage_begin ();
+        (void)markdown_render_jobs (&jobs[base], n, opts);
+        ttime_stage_end (TTIME_STAGE_MARKDOWN, t0);
+        for (size_t i = base; i < base + n; ++i) {
+            cached += jobs[i].cached ? 1u : 0u;
+            if (rc == 0 && (jobs[i].rc != 0 || fn (ctx, &jobs[i].paths, jobs[i].advance_mm) != 0))
+                rc = 1;
+            geom_paths_free (&jobs[i].paths);
+        }
+    }
+    LOGD ("markdown: потоково %zu блоків (з кешу %zu)", job_count, cached);
+    markdown_jobs_dispose (jobs, job_count);
+    return rc;
+}
@@ -23,9 +23,13 @@ extern "C" {
  * @brief Опції рендерингу Markdown.
  */
 typedef struct markdown_opts {
-    const char *family;    /**< Родина шрифтів Hershey для тексту (може бути `NULL`). */
-    double base_size_pt;   /**< Базовий кегль у пунктах; якщо <=0 — використовується 14 pt. */
-    double frame_width_mm; /**< Ширина кадру для переносу рядків (мм). */
+    const char *family;           /**< Родина шрифтів Hershey для тексту (може бути `NULL`). */
+    double base_size_pt;          /**< Базовий кегль, пт; якщо <=0 — використовується 14 pt. */
+    double frame_width_mm;        /**< Ширина кадру для переносу рядків (мм). */
+    unsigned threads;             /**< Потоки верстки блоків і комірок таблиць: 0 — за ядрами,
+                                     1 — без потоків. */
+    text_break_mode_t break_mode; /**< Алгоритм розбиття абзаців на рядки. */
+    jobarena_t *arena;            /**< Арена проміжних даних (NULL — купа). */
 } markdown_opts_t;
 
 /**
@@ -34,13 +38,39 @@ typedef struct markdown_opts {
  * @param opts Опції рендерингу; обовʼязкові поля: `frame_width_mm`; `family`/`base_size_pt` —
  *            необовʼязкові (мають розумні типові значення).
  * @param out [out] Контейнер шляхів у мм; ініціалізується всередині функції.
+ * @details Спершу знаходяться межі блоків верхнього рівня; далі блоки рендеряться
+ *          незалежно (у `opts->threads` потоках) кожен від y = 0 у власний набір
+ *          контурів, а останній прохід складає їх за виміряними висотами.
  * @param info [out] Якщо не `NULL` — метрики рендерингу (висота рядка тощо) для
- *             останнього блоку.
+ *             останнього текстового блоку.
  * @return 0 — успіх; 1/2 — помилка розбору або виділення памʼяті.
  */
 int markdown_render_paths (
     const char *text, const markdown_opts_t *opts, geom_paths_t *out, text_render_info_t *info);
 
+/**
+ * @brief Споживач відрендереного блоку верхнього рівня.
+ * @param ctx Контекст викликача.
+ * @param paths Контури блоку у мм від y = 0 (дійсні лише під час виклику).
+ * @param advance_mm Вертикальний крок до наступного блоку (з інтервалом), мм.
+ * @return 0 — продовжити; інше — зупинити рендеринг з помилкою.
+ */
+typedef int (*markdown_block_fn) (void *ctx, const geom_paths_t *paths, double advance_mm);
+
+/**
+ * @brief Рендерить Markdown поблоково і віддає блоки споживачу в порядку документа.
+ * @details Ті самі блоки, що й у `markdown_render_paths`, але без складання в один
+ *          набір: блоки рендеряться паралельними вікнами фіксованого розміру, тож
+ *          одночасно в памʼяті лише одне вікно (посторінкова верстка, `page.h`).
+ * @param text Вхідний Markdown (UTF‑8).
+ * @param opts Опції рендерингу (як у `markdown_render_paths`).
+ * @param fn Споживач блоків.
+ * @param ctx Контекст споживача.
+ * @return 0 — успіх; 1 — помилка розбору, рендерингу або споживача.
+ */
+int markdown_render_stream (
+    const char *text, const markdown_opts_t *opts, markdown_block_fn fn, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
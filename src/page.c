@@ -0,0 +1,382 @@
+/**
+ * @file page.c
+ * @brief Посторінкова верстка: потік частин документа, розрізання на сторінки.
+ * @ingroup page
+ */
+#include "page.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "canvas.h"
+#include "log.h"
+#include "markdown.h"
+#include "text.h"
+
+/** Орієнтовний розмір частини простого тексту (межа — найближчий кінець рядка), байт. */
+#define PAGE_TEXT_CHUNK 4096
+/** Допуск порівняння висот, мм. */
+#define PAGE_EPS_MM 1e-6
+
+/**
+ * @brief Межа контуру для розрізання: вертикальна подія «початок» або «кінець».
+ */
+typedef struct {
+    double y;  /**< Координата, мм. */
+    int delta; /**< +1 — контур починається; -1 — закінчується. */
+} page_event_t;
+
+/**
+ * @brief Стан розрізання потоку контурів на сторінки.
+ */
+typedef struct {
+    const drawing_page_t *page; /**< Параметри сторінки (із `anchored`, без fit). */
+    double height_mm;           /**< Висота вмісту сторінки, мм. */
+    geom_paths_t pending;       /**< Ще не віддані контури (координати документа). */
+    geom_bbox_t *boxes;         /**< Межі кожного контуру `pending`. */
+    size_t boxes_cap;           /**< Ємність `boxes`. */
+    double top;                 /**< Верх вмісту `pending`, мм. */
+    double bottom;              /**< Низ вмісту `pending`, мм. */
+    double cursor_y;            /**< Початок наступної частини, мм. */
+    size_t pages;               /**< Віддано сторінок. */
+    bool warned_tall;           /**< Попередження про контур, вищий за сторінку, вже було. */
+    page_fn fn;                 /**< Споживач сторінок. */
+    void *ctx;                  /**< Контекст споживача. */
+} page_splitter_t;
+
+/** \brief Порядок подій: за Y, на однаковій висоті кінці раніше за початки. */
+static int page_event_cmp (const void *a, const void *b) {
+    const page_event_t *ea = (const page_event_t *)a;
+    const page_event_t *eb = (const page_event_t *)b;
+    if (ea->y < eb->y)
+        return -1;
+    if (ea->y > eb->y)
+        return 1;
+    return ea->delta - eb->delta;
+}
+
+/** \brief Перераховує верх і низ вмісту `pending` за межами контурів. */
+static void page_splitter_bounds (page_splitter_t *ps) {
+    ps->top = INFINITY;
+    ps->bottom = -INFINITY;
+    for (size_t i = 0; i < ps->pending.len; ++i) {
+        ps->top = fmin (ps->top, ps->boxes[i].min_y);
+        ps->bottom = fmax (ps->bottom, ps->boxes[i].max_y);
+    }
+}
+
+/**
+ * @brief Висота розрізу в межах [верх + H/2; верх + H], яку перетинає найменше контурів.
+ * @details Кандидати — нижні краї контурів; за рівної кількості перетинів — нижчий
+ *          розріз (більше вмісту на сторінці). Між рядками перетинів немає.
+ * @return Висота розрізу, мм (без кандидатів — нижня межа сторінки).
+ */
+static double page_splitter_find_cut (const page_splitter_t *ps) {
+    double limit = ps->top + ps->height_mm;
+    double lo = ps->top + ps->height_mm * 0.5;
+    page_event_t *ev = (page_event_t *)malloc (2 * ps->pending.len * sizeof (*ev));
+    if (!ev)
+        return limit;
+    size_t n = 0;
+    for (size_t i = 0; i < ps->pending.len; ++i) {
+        const geom_bbox_t *b = &ps->boxes[i];
+        if (!(b->max_y > b->min_y))
+            continue;
+        ev[n++] = (page_event_t){ b->min_y, 1 };
+        ev[n++] = (page_event_t){ b->max_y, -1 };
+    }
+    qsort (ev, n, sizeof (*ev), page_event_cmp);
+    double best_y = limit;
+    long best_count = LONG_MAX;
+    long active = 0;
+    for (size_t i = 0; i < n; ++i) {
+        active += ev[i].delta;
+        if (ev[i].delta > 0 || (i + 1 < n && ev[i + 1].y == ev[i].y && ev[i + 1].delta < 0))
+            continue;
+        if (ev[i].y > limit + PAGE_EPS_MM)
+            break;
+        if (ev[i].y >= lo && active <= best_count) {
+            best_count = active;
+            best_y = ev[i].y;
+        }
+    }
+    free (ev);
+    return best_y;
+}
+
+/**
+ * @brief Віддає сторінку: розміщує контури в рамці й передає споживачу.
+ * @param ps Стан розрізання.
+ * @param paths Контури сторінки від верху вмісту (володіння переходить сюди).
+ * @return 0 — успіх; 1 — помилка.
+ */
+static int page_splitter_emit (page_splitter_t *ps, geom_paths_t *paths) {
+    drawing_layout_t layout = { 0 };
+    int rc = drawing_build_layout_from_paths (ps->page, paths, &layout);
+    geom_paths_free (paths);
+    if (rc != 0)
+        return 1;
+    LOGI ("Сторінка %zu: контурів %zu", ps->pages + 1, layout.layout.paths_mm.len);
+    rc = ps->fn (ps->ctx, ps->pages, &layout) != 0 ? 1 : 0;
+    drawing_layout_dispose (&layout);
+    ++ps->pages;
+    return rc;
+}
+
+/**
+ * @brief Відрізає одну сторінку від початку `pending` і віддає її.
+ * @param ps Стан розрізання.
+ * @param final true — віддати все, що лишилось (кінець документа).
+ * @return 0 — успіх; 1 — помилка.
+ */
+static int page_splitter_cut (page_splitter_t *ps, bool final) {
+    double cut = final ? INFINITY : page_splitter_find_cut (ps);
+    double top = ps->top;
+    size_t taken = 0;
+    for (size_t i = 0; i < ps->pending.len; ++i)
+        if ((ps->boxes[i].min_y + ps->boxes[i].max_y) * 0.5 <= cut)
+            ++taken;
+    if (taken == 0) {
+        /* Контур, вищий за сторінку: віддати верхній окремою сторінкою. */
+        cut = top + PAGE_EPS_MM;
+        if (!ps->warned_tall) {
+            LOGW ("Контур вищий за сторінку — він вийде за нижнє поле");
+            ps->warned_tall = true;
+        }
+    }
+
+    geom_paths_t page_paths, rest;
+    if (geom_paths_init (&page_paths, GEOM_UNITS_MM) != 0)
+        return 1;
+    if (geom_paths_init (&rest, GEOM_UNITS_MM) != 0) {
+        geom_paths_free (&page_paths);
+        return 1;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < ps->pending.len; ++i) {
+        const geom_path_t *p = &ps->pending.items[i];
+        const geom_bbox_t *b = &ps->boxes[i];
+        bool on_page = taken ? (b->min_y + b->max_y) * 0.5 <= cut : b->min_y <= cut;
+        geom_point_t *pts = NULL;
+        if (geom_paths_add_path (on_page ? &page_paths : &rest, p->len, &pts) != 0) {
+            geom_paths_free (&page_paths);
+            geom_paths_free (&rest);
+            return 1;
+        }
+        for (size_t k = 0; k < p->len; ++k)
+            pts[k] = on_page ? (geom_point_t){ p->pts[k].x, p->pts[k].y - top } : p->pts[k];
+        if (!on_page)
+            ps->boxes[kept++] = *b;
+    }
+    geom_paths_free (&ps->pending);
+    ps->pending = rest;
+    page_splitter_bounds (ps);
+    return page_splitter_emit (ps, &page_paths);
+}
+
+/**
+ * @brief Додає частину документа під попередньою і віддає сторінки, що заповнились.
+ * @param ps Стан розрізання.
+ * @param chunk Контури частини від y = 0.
+ * @param advance_mm Вертикальний крок до наступної частини, мм.
+ * @return 0 — успіх; 1 — помилка.
+ */
+static int page_splitter_push (page_splitter_t *ps, const geom_paths_t *chunk, double advance_mm) {
+    size_t need = ps->pending.len + chunk->len;
+    if (need > ps->boxes_cap) {
+        size_t cap = ps->boxes_cap ? ps->boxes_cap : 256;
+        while (cap < need)
+            cap *= 2;
+        geom_bbox_t *grown = (geom_bbox_t *)realloc (ps->boxes, cap * sizeof (*grown));
+        if (!grown)
+            return 1;
+        ps->boxes = grown;
+        ps->boxes_cap = cap;
+    }
+    for (size_t i = 0; i < chunk->len; ++i) {
+        const geom_path_t *p = &chunk->items[i];
+        if (p->len == 0 || !p->pts)
+            continue;
+        geom_point_t *pts = NULL;
+        if (geom_paths_add_path (&ps->pending, p->len, &pts) != 0)
+            return 1;
+        geom_bbox_t *b = &ps->boxes[ps->pending.len - 1];
+        b->min_x = b->min_y = INFINITY;
+        b->max_x = b->max_y = -INFINITY;
+        for (size_t k = 0; k < p->len; ++k) {
+            pts[k].x = p->pts[k].x;
+            pts[k].y = p->pts[k].y + ps->cursor_y;
+            b->min_x = fmin (b->min_x, pts[k].x);
+            b->max_x = fmax (b->max_x, pts[k].x);
+            b->min_y = fmin (b->min_y, pts[k].y);
+            b->max_y = fmax (b->max_y, pts[k].y);
+        }
+        ps->top = fmin (ps->top, b->min_y);
+        ps->bottom = fmax (ps->bottom, b->max_y);
+    }
+    ps->cursor_y += advance_mm;
+    while (ps->pending.len > 0 && ps->bottom - ps->top > ps->height_mm + PAGE_EPS_MM)
+        if (page_splitter_cut (ps, false) != 0)
+            return 1;
+    return 0;
+}
+
+/** \brief Споживач блоків Markdown: блок стає наступною частиною потоку. */
+static int page_markdown_block (void *ctx, const geom_paths_t *paths, double advance_mm) {
+    return page_splitter_push ((page_splitter_t *)ctx, paths, advance_mm);
+}
+
+/**
+ * @brief Верстає простий текст частинами до `PAGE_TEXT_CHUNK` байт по межах рядків.
+ * @details Абзаци (рядки вводу) розбиваються на рядки незалежно, тож частини
+ *          верстаються окремо, а крок між ними — кількість рядків на міжрядковий крок.
+ * @return 0 — успіх; 1 — помилка.
+ */
+static int page_stream_text (
+    page_splitter_t *ps, const char *family, double size_pt, double frame_w, string_t input) {
+    text_layout_opts_t opts = {
+        .family = family,
+        .size_pt = size_pt,
+        .style_flags = TEXT_STYLE_NONE,
+        .units = GEOM_UNITS_MM,
+        .frame_width = frame_w,
+        .align = TEXT_ALIGN_LEFT,
+        .hyphenate = 1,
+        .line_spacing = 1.0,
+        .break_mode = ps->page->break_mode,
+    };
+    char *buf = (char *)malloc (PAGE_TEXT_CHUNK + 1);
+    if (!buf)
+        return 1;
+    size_t pos = 0;
+    int rc = 0;
+    while (pos < input.len && rc == 0) {
+        size_t end = pos + PAGE_TEXT_CHUNK < input.len ? pos + PAGE_TEXT_CHUNK : input.len;
+        size_t next = end;
+        if (end < input.len) {
+            const char *nl = (const char *)memchr (input.chars + pos, '\n', end - pos);
+            const char *last = NULL;
+            while (nl) {
+                last = nl;
+                nl = (const char *)memchr (nl + 1, '\n', (size_t)(input.chars + end - nl - 1));
+            }
+            if (last) {
+                end = (size_t)(last - input.chars);
+                next = end + 1;
+            } else {
+                /* Рядок довший за частину: до кінця рядка, скільки б він не займав. */
+                const char *eol
+                    = (const char *)memchr (input.chars + end, '\n', input.len - end);
+                end = eol ? (size_t)(eol - input.chars) : input.len;
+                next = eol ? end + 1 : end;
+            }
+        }
+        size_t len = end - pos;
+        char *text = buf;
+        if (len > PAGE_TEXT_CHUNK) {
+            text = (char *)malloc (len + 1);
+            if (!text) {
+                rc = 1;
+                break;
+            }
+        }
+        memcpy (text, input.chars + pos, len);
+        text[len] = '\0';
+
+        geom_paths_t paths;
+        size_t line_count = 0;
+        text_render_info_t info;
+        memset (&info, 0, sizeof (info));
+        if (text_layout_render (text, &opts, &paths, NULL, &line_count, &info) != 0) {
+            LOGE ("Не вдалося сформувати контури тексту");
+            rc = 1;
+        } else {
+            if (line_count == 0)
+                line_count = 1;
+            double advance = (double)line_count * info.line_height * opts.line_spacing;
+            rc = page_splitter_push (ps, &paths, advance);
+            geom_paths_free (&paths);
+        }
+        if (text != buf)
+            free (text);
+        pos = next;
+    }
+    free (buf);
+    return rc;
+}
+
+/**
+ * @copydoc page_layout_stream
+ */
+int page_layout_stream (
+    const drawing_page_t *page,
+    const char *family,
+    double font_size_pt,
+    string_t input,
+    bool markdown,
+    unsigned threads,
+    page_fn fn,
+    void *ctx,
+    size_t *out_pages) {
+    if (out_pages)
+        *out_pages = 0;
+    if (!page || !fn)
+        return 1;
+    drawing_page_t sheet = *page;
+    sheet.anchored = 1;
+    sheet.fit_to_frame = 0;
+    sheet.instanced = 0;
+    canvas_options_t copts = {
+        .paper_w_mm = sheet.paper_w_mm,
+        .paper_h_mm = sheet.paper_h_mm,
+        .margin_top_mm = sheet.margin_top_mm,
+        .margin_right_mm = sheet.margin_right_mm,
+        .margin_bottom_mm = sheet.margin_bottom_mm,
+        .margin_left_mm = sheet.margin_left_mm,
+        .orientation = sheet.orientation,
+        .font_family = family,
+    };
+    /* Рядки йдуть уздовж ширини рамки, висота вмісту — уздовж її висоти. */
+    double frame_w = 0.0, frame_h = 0.0;
+    canvas_frame_dimensions (&copts, &frame_w, &frame_h);
+    if (!(frame_w > 0.0) || !(frame_h > 0.0)) {
+        LOGE ("Недостатня доступна ширина для тексту — перевірте поля та орієнтацію");
+        return 2;
+    }
+    double size_pt = font_size_pt > 0.0 ? font_size_pt : 14.0;
+
+    page_splitter_t ps;
+    memset (&ps, 0, sizeof (ps));
+    ps.page = &sheet;
+    ps.height_mm = frame_h;
+    ps.top = INFINITY;
+    ps.bottom = -INFINITY;
+    ps.fn = fn;
+    ps.ctx = ctx;
+    if (geom_paths_init (&ps.pending, GEOM_UNITS_MM) != 0)
+        return 1;
+
+    int rc;
+    if (markdown) {
+        markdown_opts_t mopts = { .family = family,
+                                  .base_size_pt = size_pt,
+                                  .frame_width_mm = frame_w,
+                                  .threads = threads,
+                                  .break_mode = sheet.break_mode };
+        const char *text = input.chars ? input.chars : "";
+        rc = markdown_render_stream (text, &mopts, page_markdown_block, &ps);
+    } else {
+        rc = page_stream_text (&ps, family, size_pt, frame_w, input);
+    }
+    if (rc == 0 && ps.pending.len > 0)
+        rc = page_splitter_cut (&ps, true);
+    LOGD ("сторінки: віддано %zu (висота вмісту %.1f мм)", ps.pages, ps.height_mm);
+    if (out_pages)
+        *out_pages = ps.pages;
+    geom_paths_free (&ps.pending);
+    free (ps.boxes);
+    return rc;
+}
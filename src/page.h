@@ -0,0 +1,68 @@
+/**
+ * @file page.h
+ * @brief Посторінкова потокова верстка документів, довших за одну сторінку.
+ * @defgroup page Сторінки
+ * @ingroup drawing
+ * @details
+ * Текст і Markdown верстаються частинами (абзаци простого тексту, вікна блоків
+ * Markdown — `markdown_render_stream`) і стікають у рамку сторінки. Коли вміст
+ * перевищує висоту рамки, сторінка розрізається по горизонталі, яку перетинає
+ * найменше контурів (між рядками — жодного), тож довгий абзац переходить на
+ * наступну сторінку цілими рядками. Готова сторінка одразу віддається споживачу
+ * (план і друк, превʼю) — до верстки наступної, тож памʼять обмежена однією
+ * сторінкою незалежно від довжини документа.
+ *
+ * Сторінки розміщуються від спільного початку рамки (`drawing_page_t::anchored`):
+ * лівий край і верх тексту збігаються на всіх аркушах. `fit_to_frame` не
+ * застосовується — пагінація замінює зменшення.
+ */
+#ifndef CPLOT_PAGE_H
+#define CPLOT_PAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "drawing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Споживач готової сторінки.
+ * @param ctx Контекст викликача.
+ * @param index Номер сторінки (від 0).
+ * @param layout Розкладка сторінки (мм); споживач може її змінювати, звільняє модуль.
+ * @return 0 — продовжити; інше — зупинити верстку з помилкою.
+ */
+typedef int (*page_fn) (void *ctx, size_t index, drawing_layout_t *layout);
+
+/**
+ * @brief Верстає документ посторінково і віддає сторінки споживачу по черзі.
+ * @param page Параметри сторінки.
+ * @param family Родина шрифтів (NULL — типова).
+ * @param font_size_pt Кегль, пт (<=0 — 14 пт).
+ * @param input Вхідний текст.
+ * @param markdown true — інтерпретувати як Markdown.
+ * @param threads Потоки для блоків Markdown (0 — за кількістю CPU).
+ * @param fn Споживач сторінок.
+ * @param ctx Контекст споживача.
+ * @param out_pages [out] Кількість відданих сторінок (може бути NULL).
+ * @return 0 — успіх; 1 — помилка верстки або споживача; 2 — некоректні параметри сторінки.
+ */
+int page_layout_stream (
+    const drawing_page_t *page,
+    const char *family,
+    double font_size_pt,
+    string_t input,
+    bool markdown,
+    unsigned threads,
+    page_fn fn,
+    void *ctx,
+    size_t *out_pages);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
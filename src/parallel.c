@@ -0,0 +1,80 @@
+/**
+ * @file parallel.c
+ * @brief Реалізація паралельного циклу.
+ * @ingroup parallel
+ */
+
+#include "parallel.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/** \brief Спільна черга індексів. */
+typedef struct {
+    parallel_work_fn work; /**< Обробка елемента. */
+    void *items;           /**< Дані для `work`. */
+    size_t count;          /**< Кількість елементів. */
+    size_t next;           /**< Наступний невзятий індекс. */
+    pthread_mutex_t lock;  /**< Захищає `next`. */
+} parallel_queue_t;
+
+/** \brief Виконавець: черга і його номер. */
+typedef struct {
+    parallel_queue_t *queue; /**< Спільна черга. */
+    size_t worker;           /**< Номер виконавця. */
+} parallel_worker_t;
+
+/** \brief Цикл виконавця: бере індекси з черги, доки вони є. */
+static void *parallel_worker_main (void *arg) {
+    parallel_worker_t *self = (parallel_worker_t *)arg;
+    parallel_queue_t *queue = self->queue;
+    for (;;) {
+        pthread_mutex_lock (&queue->lock);
+        size_t idx = queue->next < queue->count ? queue->next++ : queue->count;
+        pthread_mutex_unlock (&queue->lock);
+        if (idx >= queue->count)
+            break;
+        queue->work (queue->items, idx, self->worker);
+    }
+    return NULL;
+}
+
+/** @copydoc parallel_threads */
+size_t parallel_threads (size_t want, size_t max_threads, size_t count) {
+    if (want == 0) {
+        long online = sysconf (_SC_NPROCESSORS_ONLN);
+        want = (online > 0) ? (size_t)online : 1;
+    }
+    if (max_threads == 0 || max_threads > PARALLEL_MAX_THREADS)
+        max_threads = PARALLEL_MAX_THREADS;
+    if (want > max_threads)
+        want = max_threads;
+    if (want > count)
+        want = count;
+    return want ? want : 1;
+}
+
+/** @copydoc parallel_for */
+size_t parallel_for (parallel_work_fn work, void *items, size_t count, size_t max_threads) {
+    if (!work || count == 0)
+        return 0;
+    size_t threads = max_threads ? parallel_threads (max_threads, max_threads, count)
+                                 : parallel_threads (0, 0, count);
+    parallel_queue_t queue = { .work = work, .items = items, .count = count, .next = 0 };
+    pthread_mutex_init (&queue.lock, NULL);
+    parallel_worker_t ctx[PARALLEL_MAX_THREADS];
+    pthread_t tids[PARALLEL_MAX_THREADS];
+    size_t started = 0;
+    for (size_t i = 1; i < threads; ++i) {
+        ctx[i] = (parallel_worker_t){ .queue = &queue, .worker = i };
+        if (pthread_create (&tids[started], NULL, parallel_worker_main, &ctx[i]) != 0)
+            break;
+        started++;
+    }
+    ctx[0] = (parallel_worker_t){ .queue = &queue, .worker = 0 };
+    parallel_worker_main (&ctx[0]);
+    for (size_t i = 0; i < started; ++i)
+        pthread_join (tids[i], NULL);
+    pthread_mutex_destroy (&queue.lock);
+    return started + 1;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file parallel.h
+ * @brief Паралельний цикл по елементах зі спільною чергою індексів.
+ * @defgroup parallel Паралельний цикл
+ * @ingroup util
+ * @details
+ * `parallel_for` роздає індекси `[0, count)` робочим потокам по одному: потік бере
+ * наступний невзятий індекс під замком і викликає для нього `work`. Викликач теж
+ * працює як виконавець №0, тож один потік (або невдалий `pthread_create`) означає
+ * звичайний послідовний цикл у порядку індексів. Кількість потоків підбирає
+ * `parallel_threads` за кількістю ядер і межами викликача.
+ *
+ * Виконавці нумеруються `0 … threads - 1`, тож власний стан потоку (фолбек шрифтів,
+ * дочірня арена, буфер смуги) викликач тримає в масиві за номером виконавця.
+ */
+#ifndef CPLOT_PARALLEL_H
+#define CPLOT_PARALLEL_H
+
+#include <stddef.h>
+
+/** Верхня межа потоків одного `parallel_for` (разом із викликачем). */
+#define PARALLEL_MAX_THREADS 64
+
+/**
+ * @brief Обробка одного елемента.
+ * @param items Спільні дані викликача.
+ * @param index Індекс елемента.
+ * @param worker Номер виконавця (0 — викликач), менший за кількість потоків.
+ */
+typedef void (*parallel_work_fn) (void *items, size_t index, size_t worker);
+
+/**
+ * @brief Кількість потоків для `count` елементів.
+ * @param want Бажана кількість (0 — за кількістю активних ядер).
+ * @param max_threads Межа викликача (0 — `PARALLEL_MAX_THREADS`).
+ * @param count Кількість елементів.
+ * @return Від 1 до меншого з `want`, `max_threads`, `PARALLEL_MAX_THREADS`, `count`.
+ */
+size_t parallel_threads (size_t want, size_t max_threads, size_t count);
+
+/**
+ * @brief Викликає `work` для кожного індексу `[0, count)` у кількох потоках.
+ * @details Повертається після завершення всіх елементів; усе, що записали виконавці,
+ *          видно викликачу.
+ * @param work Обробка елемента.
+ * @param items Спільні дані для `work`.
+ * @param count Кількість елементів.
+ * @param max_threads Найбільше потоків разом із викликачем (0 — `parallel_threads`).
+ * @return Кількість задіяних потоків (0 — немає елементів).
+ */
+size_t parallel_for (parallel_work_fn work, void *items, size_t count, size_t max_threads);
+
+#endif
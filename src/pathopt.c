@@ -0,0 +1,449 @@
+/**
+ * @file pathopt.c
+ * @brief Реалізація оптимізації порядку контурів (найближчий сусід + 2-opt).
+ * @ingroup pathopt
+ * @details
+ * Кожен непорожній шлях — вузол із двома кінцями (перша й остання точка). Кінці
+ * розкладаються по рівномірній сітці, тож пошук найближчого невідвіданого кінця
+ * переглядає лише кільця сусідніх клітинок. Покращення 2-opt розвертає відрізок
+ * маршруту разом із напрямом кожного контуру в ньому; пари позицій обмежено вікном
+ * `PATHOPT_WINDOW`, щоб вартість лишалась лінійною для сотень тисяч контурів.
+ */
+
+#include "pathopt.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Ширина вікна позицій для 2-opt. */
+#define PATHOPT_WINDOW 48
+/** \brief Максимальна кількість проходів 2-opt. */
+#define PATHOPT_MAX_PASSES 8
+/** \brief Мінімальний виграш, що вважається покращенням (одиниці шляхів). */
+#define PATHOPT_EPS 1e-9
+
+/**
+ * Рівномірна сітка кінців контурів із лінивим видаленням.
+ */
+typedef struct {
+    double min_x;        /**< Ліва межа сітки. */
+    double min_y;        /**< Нижня межа сітки. */
+    double cell;         /**< Розмір клітинки. */
+    size_t gx;           /**< Кількість клітинок по X. */
+    size_t gy;           /**< Кількість клітинок по Y. */
+    size_t *cell_start;  /**< Початок клітинки у `slots` (gx*gy + 1 елементів). */
+    size_t *cell_live;   /**< Кількість ще не відвіданих кінців у клітинці. */
+    size_t *slots;       /**< Ідентифікатори кінців, згруповані за клітинками. */
+    size_t *slot_of;     /**< Позиція кінця у `slots`. */
+    size_t *cell_of;     /**< Клітинка кожного кінця. */
+    size_t live;         /**< Загальна кількість невідвіданих кінців. */
+} pathopt_grid_t;
+
+/** \brief Квадрат відстані між точками. */
+static double pathopt_d2 (const geom_point_t *a, const geom_point_t *b) {
+    double dx = a->x - b->x;
+    double dy = a->y - b->y;
+    return dx * dx + dy * dy;
+}
+
+/** \brief Відстань між точками. */
+static double pathopt_dist (const geom_point_t *a, const geom_point_t *b) {
+    return sqrt (pathopt_d2 (a, b));
+}
+
+/** \brief Індекс клітинки по осі з обмеженням до меж сітки. */
+static size_t pathopt_grid_axis (double v, double min, double cell, size_t n) {
+    double f = floor ((v - min) / cell);
+    if (!(f > 0.0))
+        return 0;
+    if (f >= (double)n)
+        return n - 1;
+    return (size_t)f;
+}
+
+/** \brief Звільняє памʼять сітки. */
+static void pathopt_grid_free (pathopt_grid_t *g) {
+    free (g->cell_start);
+    free (g->cell_live);
+    free (g->slots);
+    free (g->slot_of);
+    free (g->cell_of);
+    memset (g, 0, sizeof (*g));
+}
+
+/**
+ * @brief Будує сітку для `count` кінців.
+ * @param g [out] Сітка.
+ * @param ends Координати кінців.
+ * @param count Кількість кінців (>0).
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int pathopt_grid_build (pathopt_grid_t *g, const geom_point_t *ends, size_t count) {
+    memset (g, 0, sizeof (*g));
+    double min_x = ends[0].x, max_x = ends[0].x;
+    double min_y = ends[0].y, max_y = ends[0].y;
+    for (size_t i = 1; i < count; ++i) {
+        min_x = fmin (min_x, ends[i].x);
+        max_x = fmax (max_x, ends[i].x);
+        min_y = fmin (min_y, ends[i].y);
+        max_y = fmax (max_y, ends[i].y);
+    }
+    double w = fmax (max_x - min_x, 1e-6);
+    double h = fmax (max_y - min_y, 1e-6);
+    /* Близько двох кінців на клітинку; загальна кількість клітинок не перевищує 4·count. */
+    double cell = fmax (sqrt (w * h / (double)count) * 1.4142135623730951, 1e-6);
+    size_t max_cells = 4 * count + 16;
+    for (;;) {
+        double gx = ceil (w / cell);
+        double gy = ceil (h / cell);
+        if (gx * gy <= (double)max_cells) {
+            g->gx = gx < 1.0 ? 1u : (size_t)gx;
+            g->gy = gy < 1.0 ? 1u : (size_t)gy;
+            break;
+        }
+        cell *= 1.5;
+    }
+    g->min_x = min_x;
+    g->min_y = min_y;
+    g->cell = cell;
+
+    size_t cells = g->gx * g->gy;
+    g->cell_start = (size_t *)calloc (cells + 1, sizeof (size_t));
+    g->cell_live = (size_t *)calloc (cells, sizeof (size_t));
+    g->slots = (size_t *)malloc (count * sizeof (size_t));
+    g->slot_of = (size_t *)malloc (count * sizeof (size_t));
+    g->cell_of = (size_t *)malloc (count * sizeof (size_t));
+    if (!g->cell_start || !g->cell_live || !g->slots || !g->slot_of || !g->cell_of) {
+        pathopt_grid_free (g);
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        size_t cx = pathopt_grid_axis (ends[i].x, g->min_x, g->cell, g->gx);
+        size_t cy = pathopt_grid_axis (ends[i].y, g->min_y, g->cell, g->gy);
+        g->cell_of[i] = cy * g->gx + cx;
+        g->cell_live[g->cell_of[i]]++;
+    }
+    for (size_t c = 0; c < cells; ++c)
+        g->cell_start[c + 1] = g->cell_start[c] + g->cell_live[c];
+    memset (g->cell_live, 0, cells * sizeof (size_t));
+    for (size_t i = 0; i < count; ++i) {
+        size_t c = g->cell_of[i];
+        size_t slot = g->cell_start[c] + g->cell_live[c]++;
+        g->slots[slot] = i;
+        g->slot_of[i] = slot;
+    }
+    g->live = count;
+    return 0;
+}
+
+/** \brief Видаляє кінець із сітки (обмін з останнім живим у клітинці). */
+static void pathopt_grid_remove (pathopt_grid_t *g, size_t end) {
+    size_t c = g->cell_of[end];
+    size_t pos = g->slot_of[end];
+    size_t last = g->cell_start[c] + g->cell_live[c] - 1;
+    if (pos > last)
+        return;
+    size_t other = g->slots[last];
+    g->slots[last] = end;
+    g->slots[pos] = other;
+    g->slot_of[other] = pos;
+    g->slot_of[end] = last;
+    g->cell_live[c]--;
+    g->live--;
+}
+
+/** \brief Оновлює найкращого кандидата серед живих кінців клітинки. */
+static void pathopt_grid_scan_cell (
+    const pathopt_grid_t *g,
+    const geom_point_t *ends,
+    size_t cx,
+    size_t cy,
+    const geom_point_t *p,
+    size_t *best,
+    double *best_d2) {
+    size_t c = cy * g->gx + cx;
+    size_t from = g->cell_start[c];
+    size_t to = from + g->cell_live[c];
+    for (size_t s = from; s < to; ++s) {
+        size_t e = g->slots[s];
+        double d2 = pathopt_d2 (&ends[e], p);
+        if (d2 < *best_d2 || (d2 == *best_d2 && e < *best)) {
+            *best_d2 = d2;
+            *best = e;
+        }
+    }
+}
+
+/**
+ * @brief Знаходить найближчий живий кінець до точки.
+ * @return Ідентифікатор кінця або SIZE_MAX, якщо живих не лишилось.
+ */
+static size_t
+pathopt_grid_nearest (const pathopt_grid_t *g, const geom_point_t *ends, const geom_point_t *p) {
+    if (g->live == 0)
+        return SIZE_MAX;
+    long cx = (long)pathopt_grid_axis (p->x, g->min_x, g->cell, g->gx);
+    long cy = (long)pathopt_grid_axis (p->y, g->min_y, g->cell, g->gy);
+    long gx = (long)g->gx, gy = (long)g->gy;
+    long max_r = gx > gy ? gx : gy;
+    size_t best = SIZE_MAX;
+    double best_d2 = INFINITY;
+    for (long r = 0; r <= max_r; ++r) {
+        long y0 = cy - r, y1 = cy + r;
+        for (long x = cx - r; x <= cx + r; ++x) {
+            if (x < 0 || x >= gx)
+                continue;
+            if (y0 >= 0)
+                pathopt_grid_scan_cell (g, ends, (size_t)x, (size_t)y0, p, &best, &best_d2);
+            if (y1 != y0 && y1 < gy)
+                pathopt_grid_scan_cell (g, ends, (size_t)x, (size_t)y1, p, &best, &best_d2);
+        }
+        for (long y = cy - r + 1; y <= cy + r - 1; ++y) {
+            if (y < 0 || y >= gy)
+                continue;
+            if (cx - r >= 0)
+                pathopt_grid_scan_cell (g, ends, (size_t)(cx - r), (size_t)y, p, &best, &best_d2);
+            if (r > 0 && cx + r < gx)
+                pathopt_grid_scan_cell (g, ends, (size_t)(cx + r), (size_t)y, p, &best, &best_d2);
+        }
+        /* Кінці за межами кільця r лежать не ближче ніж r клітинок від точки. */
+        double bound = (double)r * g->cell;
+        if (best != SIZE_MAX && best_d2 <= bound * bound)
+            break;
+    }
+    return best;
+}
+
+/** \brief Точка входу у вузол на позиції маршруту. */
+static const geom_point_t *
+pathopt_entry (const geom_point_t *ends, const size_t *order, const unsigned char *rev, size_t k) {
+    return &ends[2 * order[k] + (rev[k] ? 1u : 0u)];
+}
+
+/** \brief Точка виходу з вузла на позиції маршруту. */
+static const geom_point_t *
+pathopt_exit (const geom_point_t *ends, const size_t *order, const unsigned char *rev, size_t k) {
+    return &ends[2 * order[k] + (rev[k] ? 0u : 1u)];
+}
+
+/** \brief Довжина переїздів маршруту (від `start`, якщо задано). */
+static double pathopt_route_travel (
+    const geom_point_t *ends,
+    const size_t *order,
+    const unsigned char *rev,
+    size_t m,
+    const geom_point_t *start) {
+    double total = 0.0;
+    if (m > 0 && start)
+        total += pathopt_dist (start, pathopt_entry (ends, order, rev, 0));
+    for (size_t k = 1; k < m; ++k)
+        total += pathopt_dist (
+            pathopt_exit (ends, order, rev, k - 1), pathopt_entry (ends, order, rev, k));
+    return total;
+}
+
+/**
+ * @brief Покращує маршрут розворотами відрізків (2-opt у вікні).
+ * @details Позиції без змін поблизу з попереднього проходу не переглядаються
+ *          повторно («don't look bits»), тож наступні проходи дешеві.
+ * @return Кількість виконаних проходів або 0, якщо забракло памʼяті.
+ */
+static unsigned pathopt_two_opt (
+    const geom_point_t *ends,
+    size_t *order,
+    unsigned char *rev,
+    size_t m,
+    const geom_point_t *start) {
+    unsigned char *look = (unsigned char *)malloc (m);
+    if (!look)
+        return 0;
+    memset (look, 1, m);
+    unsigned passes = 0;
+    size_t first = start ? 0u : 1u;
+    bool improved = true;
+    while (improved && passes < PATHOPT_MAX_PASSES) {
+        improved = false;
+        ++passes;
+        for (size_t i = first; i < m; ++i) {
+            if (!look[i])
+                continue;
+            look[i] = 0;
+            const geom_point_t *prev = (i == 0) ? start : pathopt_exit (ends, order, rev, i - 1);
+            size_t j_end = (m - 1 < i + PATHOPT_WINDOW) ? m - 1 : i + PATHOPT_WINDOW;
+            for (size_t j = i; j <= j_end; ++j) {
+                const geom_point_t *in_i = pathopt_entry (ends, order, rev, i);
+                const geom_point_t *out_j = pathopt_exit (ends, order, rev, j);
+                double before = pathopt_dist (prev, in_i);
+                double after = pathopt_dist (prev, out_j);
+                if (j + 1 < m) {
+                    const geom_point_t *next = pathopt_entry (ends, order, rev, j + 1);
+                    before += pathopt_dist (out_j, next);
+                    after += pathopt_dist (in_i, next);
+                }
+                if (after + PATHOPT_EPS >= before)
+                    continue;
+                for (size_t a = i, b = j; a < b; ++a, --b) {
+                    size_t t = order[a];
+                    order[a] = order[b];
+                    order[b] = t;
+                    unsigned char r = rev[a];
+                    rev[a] = rev[b];
+                    rev[b] = r;
+                }
+                for (size_t k = i; k <= j; ++k)
+                    rev[k] = (unsigned char)!rev[k];
+                look[i] = look[j] = 1;
+                if (i > 0)
+                    look[i - 1] = 1;
+                if (j + 1 < m)
+                    look[j + 1] = 1;
+                improved = true;
+            }
+        }
+    }
+    free (look);
+    return passes;
+}
+
+/** \brief Розвертає порядок точок шляху на місці. */
+static void pathopt_reverse_path (geom_path_t *p) {
+    for (size_t a = 0, b = p->len ? p->len - 1 : 0; a < b; ++a, --b) {
+        geom_point_t t = p->pts[a];
+        p->pts[a] = p->pts[b];
+        p->pts[b] = t;
+    }
+}
+
+/**
+ * @copydoc pathopt_travel_length
+ */
+double pathopt_travel_length (const geom_paths_t *ps, const geom_point_t *start) {
+    if (!ps)
+        return 0.0;
+    double total = 0.0;
+    const geom_point_t *prev = start;
+    for (size_t i = 0; i < ps->len; ++i) {
+        const geom_path_t *p = &ps->items[i];
+        if (p->len == 0)
+            continue;
+        if (prev)
+            total += pathopt_dist (prev, &p->pts[0]);
+        prev = &p->pts[p->len - 1];
+    }
+    return total;
+}
+
+/**
+ * @copydoc pathopt_optimize_order
+ */
+int pathopt_optimize_order (
+    geom_paths_t *ps, const geom_point_t *start, pathopt_stats_t *stats) {
+    if (!ps)
+        return -1;
+    pathopt_stats_t local = { 0 };
+    local.travel_before = pathopt_travel_length (ps, start);
+    local.travel_after = local.travel_before;
+
+    size_t m = 0;
+    for (size_t i = 0; i < ps->len; ++i)
+        if (ps->items[i].len > 0)
+            ++m;
+    if (m < 2 && !(start && m == 1)) {
+        if (stats)
+            *stats = local;
+        return 0;
+    }
+
+    size_t *node_path = (size_t *)malloc (m * sizeof (size_t));
+    geom_point_t *ends = (geom_point_t *)malloc (2 * m * sizeof (geom_point_t));
+    size_t *order = (size_t *)malloc (m * sizeof (size_t));
+    unsigned char *rev = (unsigned char *)calloc (m, 1);
+    geom_path_t *items = (geom_path_t *)malloc (ps->len * sizeof (geom_path_t));
+    pathopt_grid_t grid = { 0 };
+    if (!node_path || !ends || !order || !rev || !items) {
+        free (node_path);
+        free (ends);
+        free (order);
+        free (rev);
+        free (items);
+        return -1;
+    }
+    for (size_t i = 0, n = 0; i < ps->len; ++i) {
+        const geom_path_t *p = &ps->items[i];
+        if (p->len == 0)
+            continue;
+        node_path[n] = i;
+        ends[2 * n] = p->pts[0];
+        ends[2 * n + 1] = p->pts[p->len - 1];
+        ++n;
+    }
+    if (pathopt_grid_build (&grid, ends, 2 * m) != 0) {
+        free (node_path);
+        free (ends);
+        free (order);
+        free (rev);
+        free (items);
+        return -1;
+    }
+
+    /* Найближчий сусід: з `start` або з незмінного першого контуру. */
+    size_t placed = 0;
+    geom_point_t pos;
+    if (start) {
+        pos = *start;
+    } else {
+        order[0] = 0;
+        rev[0] = 0;
+        pathopt_grid_remove (&grid, 0);
+        pathopt_grid_remove (&grid, 1);
+        pos = ends[1];
+        placed = 1;
+    }
+    while (placed < m) {
+        size_t e = pathopt_grid_nearest (&grid, ends, &pos);
+        if (e == SIZE_MAX)
+            break;
+        size_t node = e / 2;
+        order[placed] = node;
+        rev[placed] = (unsigned char)(e % 2);
+        pathopt_grid_remove (&grid, 2 * node);
+        pathopt_grid_remove (&grid, 2 * node + 1);
+        pos = ends[2 * node + (e % 2 ? 0u : 1u)];
+        ++placed;
+    }
+    pathopt_grid_free (&grid);
+
+    local.passes = pathopt_two_opt (ends, order, rev, m, start);
+    local.travel_after = pathopt_route_travel (ends, order, rev, m, start);
+
+    if (local.travel_after + PATHOPT_EPS < local.travel_before) {
+        size_t out = 0;
+        for (size_t k = 0; k < m; ++k) {
+            items[out] = ps->items[node_path[order[k]]];
+            if (rev[k]) {
+                pathopt_reverse_path (&items[out]);
+                ++local.reversed;
+            }
+            ++out;
+        }
+        for (size_t i = 0; i < ps->len; ++i)
+            if (ps->items[i].len == 0)
+                items[out++] = ps->items[i];
+        memcpy (ps->items, items, ps->len * sizeof (geom_path_t));
+    } else {
+        local.travel_after = local.travel_before;
+        local.passes = 0;
+    }
+
+    free (node_path);
+    free (ends);
+    free (order);
+    free (rev);
+    free (items);
+    if (stats)
+        *stats = local;
+    return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file pathopt.h
+ * @brief Оптимізація порядку контурів для скорочення переїздів без пера.
+ * @defgroup pathopt Порядок контурів
+ * @ingroup geom
+ * @details
+ * Переставляє шляхи `geom_paths_t` і за потреби розвертає їх, щоб зменшити сумарну
+ * довжину холостих переїздів між кінцем одного контуру і початком наступного.
+ * Початковий порядок будується жадібно (найближчий сусід) через просторову сітку
+ * кінцевих точок, далі покращується 2-opt у ковзному вікні позицій.
+ */
+#ifndef PATHOPT_H
+#define PATHOPT_H
+
+#include "geom.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Підсумок оптимізації порядку.
+ */
+typedef struct {
+    double travel_before; /**< Холості переїзди до оптимізації (одиниці шляхів). */
+    double travel_after;  /**< Холості переїзди після оптимізації. */
+    size_t reversed;      /**< Кількість розвернутих контурів. */
+    unsigned passes;      /**< Кількість проходів 2-opt. */
+} pathopt_stats_t;
+
+/**
+ * @brief Сумарна довжина переїздів між послідовними непорожніми шляхами.
+ * @param ps Набір шляхів.
+ * @param start Початкова позиція пера (NULL — рахувати від першого шляху).
+ * @return Довжина у одиницях шляхів; 0 для `NULL`.
+ */
+double pathopt_travel_length (const geom_paths_t *ps, const geom_point_t *start);
+
+/**
+ * @brief Переставляє та розвертає шляхи для мінімізації переїздів без пера.
+ * @details Порожні шляхи переносяться в кінець. Якщо `start == NULL`, перший
+ *          шлях лишається першим і не розвертається (план починається з нього).
+ * @param ps [in,out] Набір шляхів.
+ * @param start Початкова позиція пера (може бути NULL).
+ * @param stats [out] Підсумок (може бути NULL).
+ * @return 0 — успіх; -1 — помилка аргументів або памʼяті (порядок не змінено).
+ */
+int pathopt_optimize_order (
+    geom_paths_t *ps, const geom_point_t *start, pathopt_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
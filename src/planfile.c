@@ -0,0 +1,410 @@
+/**
+ * @file planfile.c
+ * @brief Кодування і декодування файлів плану руху.
+ * @ingroup planfile
+ * @details
+ * Заголовок (`PLANFILE_HEADER_SIZE` байт, little-endian): сигнатура, версія, розмір
+ * заголовка, кількість блоків, розмір записів, початкова позиція в мкм, модель і межа
+ * швидкості в 0.01 мм/с. За ним — записи блоків (див. `planfile.h`). Лічильники
+ * заголовка дописуються при закритті, тож обірваний файл не пройде перевірку розміру.
+ */
+
+#include "planfile.h"
+
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Сигнатура файлу плану. */
+#define PLANFILE_MAGIC "CPLPLAN"
+
+/** Версія формату; збільшується за будь-якої зміни заголовка чи записів. */
+#define PLANFILE_VERSION 1u
+
+/** Розмір заголовка, байт. */
+#define PLANFILE_HEADER_SIZE 88u
+
+/** \brief Одиниць квантування позиції та довжин на мм (мкм). */
+#define PLANFILE_MM_SCALE 1000.0
+/** \brief Похибка довжини блоку від квантування зміщень і довжин фаз, мкм (≈ √2 + ½). */
+#define PLANFILE_SNAP_UM 2.0
+/** \brief Одиниць квантування швидкості на мм/с. */
+#define PLANFILE_SPEED_SCALE 100.0
+/** \brief Одиниць квантування прискорення на мм/с². */
+#define PLANFILE_ACCEL_SCALE 10.0
+
+/** \brief Найбільша довжина запису блоку, байт (прапорці + 10 цілих по 10 байт). */
+#define PLANFILE_RECORD_MAX 101
+
+/** Прапорці запису блоку. */
+enum {
+    PLANFILE_F_PEN_DOWN = 1u << 0, /**< Перо опущене. */
+    PLANFILE_F_CRUISE = 1u << 1,   /**< Є круїз (і збережено довжину гальмування). */
+    PLANFILE_F_START = 1u << 2,    /**< Початкова швидкість ≠ кінцевій попереднього блоку. */
+    PLANFILE_F_ACCEL = 1u << 3,    /**< Нове прискорення. */
+    PLANFILE_F_JERK = 1u << 4,     /**< Новий ривок. */
+    PLANFILE_F_NOMINAL = 1u << 5,  /**< Збережено номінальну швидкість. */
+    PLANFILE_F_SEQ = 1u << 6,      /**< Номер не на один більший за попередній. */
+};
+
+/** \brief Записує `uint32_t` little-endian. */
+static void planfile_put_u32 (unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; ++i)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+/** \brief Записує `uint64_t` little-endian. */
+static void planfile_put_u64 (unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; ++i)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+/** \brief Читає `uint32_t` little-endian. */
+static uint32_t planfile_get_u32 (const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+/** \brief Читає `uint64_t` little-endian. */
+static uint64_t planfile_get_u64 (const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+/** \brief Квантує невідʼємну величину (відʼємні та нескінченні — 0). */
+static uint64_t planfile_quantize (double value, double scale) {
+    double q = value * scale;
+    if (!(q > 0.0) || !isfinite (q))
+        return 0;
+    if (q >= 9.0e18)
+        return (uint64_t)9.0e18;
+    return (uint64_t)llround (q);
+}
+
+/** \brief Квантує координату, мкм. */
+static int64_t planfile_quantize_pos (double mm) {
+    double q = mm * PLANFILE_MM_SCALE;
+    if (!isfinite (q))
+        return 0;
+    if (q > 9.0e18)
+        q = 9.0e18;
+    if (q < -9.0e18)
+        q = -9.0e18;
+    return (int64_t)llround (q);
+}
+
+/** \brief Дописує ціле LEB128. @return Нова довжина буфера. */
+static size_t planfile_put_varint (unsigned char *buf, size_t len, uint64_t v) {
+    while (v >= 0x80u) {
+        buf[len++] = (unsigned char)(v | 0x80u);
+        v >>= 7;
+    }
+    buf[len++] = (unsigned char)v;
+    return len;
+}
+
+/** \brief Дописує знакове ціле (zigzag + LEB128). @return Нова довжина буфера. */
+static size_t planfile_put_svarint (unsigned char *buf, size_t len, int64_t v) {
+    uint64_t zz = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    return planfile_put_varint (buf, len, zz);
+}
+
+/**
+ * @brief Читає ціле LEB128 у межах відображення.
+ * @return true — прочитано; false — запис обірвано або задовгий.
+ */
+static bool planfile_get_varint (planfile_reader_t *r, uint64_t *out) {
+    const unsigned char *p = (const unsigned char *)r->map;
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (r->offset >= r->map_len)
+            return false;
+        unsigned char byte = p[r->offset++];
+        v |= (uint64_t)(byte & 0x7fu) << shift;
+        if (!(byte & 0x80u)) {
+            *out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+/** \brief Читає знакове ціле (zigzag + LEB128). */
+static bool planfile_get_svarint (planfile_reader_t *r, int64_t *out) {
+    uint64_t zz;
+    if (!planfile_get_varint (r, &zz))
+        return false;
+    *out = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1u);
+    return true;
+}
+
+/** \brief Записує заголовок у початок файлу. */
+static int planfile_write_header (planfile_writer_t *w) {
+    unsigned char hdr[PLANFILE_HEADER_SIZE];
+    memset (hdr, 0, sizeof (hdr));
+    memcpy (hdr, PLANFILE_MAGIC, sizeof (PLANFILE_MAGIC));
+    planfile_put_u32 (hdr + 8, PLANFILE_VERSION);
+    planfile_put_u32 (hdr + 12, PLANFILE_HEADER_SIZE);
+    planfile_put_u64 (hdr + 16, w->info.block_count);
+    planfile_put_u64 (hdr + 24, w->data_size);
+    planfile_put_u64 (hdr + 32, (uint64_t)planfile_quantize_pos (w->info.start_mm[0]));
+    planfile_put_u64 (hdr + 40, (uint64_t)planfile_quantize_pos (w->info.start_mm[1]));
+    memcpy (hdr + 48, w->info.model, sizeof (w->info.model));
+    uint64_t max_speed = planfile_quantize (w->info.max_speed_mm_s, PLANFILE_SPEED_SCALE);
+    planfile_put_u64 (hdr + 80, max_speed);
+    if (fseek (w->fp, 0, SEEK_SET) != 0 || fwrite (hdr, 1, sizeof (hdr), w->fp) != sizeof (hdr))
+        return -1;
+    return 0;
+}
+
+/**
+ * @copydoc planfile_writer_open
+ */
+int planfile_writer_open (planfile_writer_t *w, const char *path, const planfile_info_t *info) {
+    if (!w || !path || !info)
+        return -1;
+    memset (w, 0, sizeof (*w));
+    w->info = *info;
+    w->info.model[sizeof (w->info.model) - 1] = '\0';
+    w->info.block_count = 0;
+    w->pos_mm[0] = w->info.start_mm[0];
+    w->pos_mm[1] = w->info.start_mm[1];
+    w->codec.pos_um[0] = planfile_quantize_pos (w->pos_mm[0]);
+    w->codec.pos_um[1] = planfile_quantize_pos (w->pos_mm[1]);
+    w->fp = fopen (path, "wb");
+    if (!w->fp)
+        return -1;
+    if (planfile_write_header (w) != 0) {
+        fclose (w->fp);
+        w->fp = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @copydoc planfile_write_block
+ */
+int planfile_write_block (planfile_writer_t *w, const plan_block_t *block) {
+    if (!w || !w->fp || !block || w->failed)
+        return -1;
+    planfile_codec_t *c = &w->codec;
+
+    w->pos_mm[0] += block->delta_mm[0];
+    w->pos_mm[1] += block->delta_mm[1];
+    int64_t pos[2]
+        = { planfile_quantize_pos (w->pos_mm[0]), planfile_quantize_pos (w->pos_mm[1]) };
+    uint64_t start = planfile_quantize (block->start_speed_mm_s, PLANFILE_SPEED_SCALE);
+    uint64_t cruise = planfile_quantize (block->cruise_speed_mm_s, PLANFILE_SPEED_SCALE);
+    uint64_t end = planfile_quantize (block->end_speed_mm_s, PLANFILE_SPEED_SCALE);
+    uint64_t nominal = planfile_quantize (block->nominal_speed_mm_s, PLANFILE_SPEED_SCALE);
+    uint64_t accel = planfile_quantize (block->accel_mm_s2, PLANFILE_ACCEL_SCALE);
+    uint64_t jerk = planfile_quantize (block->jerk_mm_s3, 1.0);
+    uint64_t accel_d = planfile_quantize (block->accel_distance_mm, PLANFILE_MM_SCALE);
+    uint64_t cruise_d = planfile_quantize (block->cruise_distance_mm, PLANFILE_MM_SCALE);
+    uint64_t decel_d = planfile_quantize (block->decel_distance_mm, PLANFILE_MM_SCALE);
+
+    unsigned flags = 0;
+    if (block->pen_down)
+        flags |= PLANFILE_F_PEN_DOWN;
+    if (cruise_d > 0)
+        flags |= PLANFILE_F_CRUISE;
+    if (start != c->end_q)
+        flags |= PLANFILE_F_START;
+    if (accel != c->accel_q)
+        flags |= PLANFILE_F_ACCEL;
+    if (jerk != c->jerk_q)
+        flags |= PLANFILE_F_JERK;
+    if (cruise == 0 && nominal > 0)
+        flags |= PLANFILE_F_NOMINAL;
+    if (block->seq != c->seq + 1)
+        flags |= PLANFILE_F_SEQ;
+
+    unsigned char rec[PLANFILE_RECORD_MAX];
+    size_t len = 0;
+    rec[len++] = (unsigned char)flags;
+    if (flags & PLANFILE_F_SEQ)
+        len = planfile_put_svarint (rec, len, (int64_t)(block->seq - c->seq - 1));
+    len = planfile_put_svarint (rec, len, pos[0] - c->pos_um[0]);
+    len = planfile_put_svarint (rec, len, pos[1] - c->pos_um[1]);
+    if (flags & PLANFILE_F_START)
+        len = planfile_put_varint (rec, len, start);
+    len = planfile_put_varint (rec, len, cruise);
+    len = planfile_put_varint (rec, len, end);
+    if (flags & PLANFILE_F_NOMINAL)
+        len = planfile_put_varint (rec, len, nominal);
+    if (flags & PLANFILE_F_ACCEL)
+        len = planfile_put_varint (rec, len, accel);
+    if (flags & PLANFILE_F_JERK)
+        len = planfile_put_varint (rec, len, jerk);
+    len = planfile_put_varint (rec, len, accel_d);
+    if (flags & PLANFILE_F_CRUISE)
+        len = planfile_put_varint (rec, len, decel_d);
+
+    if (fwrite (rec, 1, len, w->fp) != len) {
+        w->failed = true;
+        return -1;
+    }
+    c->pos_um[0] = pos[0];
+    c->pos_um[1] = pos[1];
+    c->seq = block->seq;
+    c->end_q = end;
+    c->accel_q = accel;
+    c->jerk_q = jerk;
+    w->data_size += len;
+    w->info.block_count++;
+    return 0;
+}
+
+/**
+ * @copydoc planfile_writer_close
+ */
+int planfile_writer_close (planfile_writer_t *w) {
+    if (!w || !w->fp)
+        return -1;
+    int rc = w->failed ? -1 : planfile_write_header (w);
+    if (fclose (w->fp) != 0)
+        rc = -1;
+    w->fp = NULL;
+    return rc;
+}
+
+/**
+ * @copydoc planfile_reader_open
+ */
+int planfile_reader_open (const char *path, planfile_reader_t *r) {
+    if (!path || !r)
+        return -1;
+    memset (r, 0, sizeof (*r));
+    FILE *fp = fopen (path, "rb");
+    if (!fp)
+        return -1;
+    struct stat st;
+    if (fstat (fileno (fp), &st) != 0) {
+        fclose (fp);
+        return -1;
+    }
+    if (st.st_size < (off_t)PLANFILE_HEADER_SIZE) {
+        fclose (fp);
+        return 1;
+    }
+    size_t map_len = (size_t)st.st_size;
+    void *map = mmap (NULL, map_len, PROT_READ, MAP_PRIVATE, fileno (fp), 0);
+    fclose (fp);
+    if (map == MAP_FAILED)
+        return -1;
+
+    const unsigned char *hdr = (const unsigned char *)map;
+    uint64_t data_size = planfile_get_u64 (hdr + 24);
+    bool valid = memcmp (hdr, PLANFILE_MAGIC, sizeof (PLANFILE_MAGIC)) == 0
+                 && planfile_get_u32 (hdr + 8) == PLANFILE_VERSION
+                 && planfile_get_u32 (hdr + 12) == PLANFILE_HEADER_SIZE
+                 && data_size == (uint64_t)map_len - PLANFILE_HEADER_SIZE;
+    if (!valid) {
+        munmap (map, map_len);
+        return 1;
+    }
+    r->map = map;
+    r->map_len = map_len;
+    r->offset = PLANFILE_HEADER_SIZE;
+    r->info.block_count = planfile_get_u64 (hdr + 16);
+    int64_t start_um[2]
+        = { (int64_t)planfile_get_u64 (hdr + 32), (int64_t)planfile_get_u64 (hdr + 40) };
+    r->info.start_mm[0] = (double)start_um[0] / PLANFILE_MM_SCALE;
+    r->info.start_mm[1] = (double)start_um[1] / PLANFILE_MM_SCALE;
+    memcpy (r->info.model, hdr + 48, sizeof (r->info.model));
+    r->info.model[sizeof (r->info.model) - 1] = '\0';
+    r->info.max_speed_mm_s = (double)planfile_get_u64 (hdr + 80) / PLANFILE_SPEED_SCALE;
+    r->codec.pos_um[0] = start_um[0];
+    r->codec.pos_um[1] = start_um[1];
+    return 0;
+}
+
+/**
+ * @copydoc planfile_read_block
+ */
+int planfile_read_block (planfile_reader_t *r, plan_block_t *out) {
+    if (!r || !r->map || !out)
+        return -1;
+    if (r->decoded >= r->info.block_count)
+        return r->offset == r->map_len ? 0 : -1;
+    if (r->offset >= r->map_len)
+        return -1;
+    planfile_codec_t *c = &r->codec;
+    unsigned flags = ((const unsigned char *)r->map)[r->offset++];
+
+    int64_t seq_gap = 0, dx = 0, dy = 0;
+    uint64_t start = c->end_q, cruise = 0, end = 0, nominal = 0;
+    uint64_t accel = c->accel_q, jerk = c->jerk_q, accel_d = 0, decel_d = 0;
+    bool ok = (!(flags & PLANFILE_F_SEQ) || planfile_get_svarint (r, &seq_gap))
+              && planfile_get_svarint (r, &dx) && planfile_get_svarint (r, &dy)
+              && (!(flags & PLANFILE_F_START) || planfile_get_varint (r, &start))
+              && planfile_get_varint (r, &cruise) && planfile_get_varint (r, &end)
+              && (!(flags & PLANFILE_F_NOMINAL) || planfile_get_varint (r, &nominal))
+              && (!(flags & PLANFILE_F_ACCEL) || planfile_get_varint (r, &accel))
+              && (!(flags & PLANFILE_F_JERK) || planfile_get_varint (r, &jerk))
+              && planfile_get_varint (r, &accel_d)
+              && (!(flags & PLANFILE_F_CRUISE) || planfile_get_varint (r, &decel_d));
+    if (!ok)
+        return -1;
+
+    memset (out, 0, sizeof (*out));
+    out->seq = c->seq + 1 + (unsigned long)seq_gap;
+    out->delta_mm[0] = (double)dx / PLANFILE_MM_SCALE;
+    out->delta_mm[1] = (double)dy / PLANFILE_MM_SCALE;
+    double length = hypot (out->delta_mm[0], out->delta_mm[1]);
+    out->length_mm = length;
+    if (length > 0.0) {
+        out->unit_vec[0] = out->delta_mm[0] / length;
+        out->unit_vec[1] = out->delta_mm[1] / length;
+    }
+    out->start_speed_mm_s = (double)start / PLANFILE_SPEED_SCALE;
+    out->cruise_speed_mm_s = (double)cruise / PLANFILE_SPEED_SCALE;
+    out->end_speed_mm_s = (double)end / PLANFILE_SPEED_SCALE;
+    out->nominal_speed_mm_s = (double)((flags & PLANFILE_F_NOMINAL) ? nominal : cruise)
+                              / PLANFILE_SPEED_SCALE;
+    out->accel_mm_s2 = (double)accel / PLANFILE_ACCEL_SCALE;
+    out->jerk_mm_s3 = (double)jerk;
+    out->pen_down = (flags & PLANFILE_F_PEN_DOWN) != 0;
+
+    /* Довжини фаз узгоджуються з довжиною зі зміщення; залишок у межах похибки
+       квантування приєднується до розгону, а не стає окремою фазою. */
+    double quantum = PLANFILE_SNAP_UM / PLANFILE_MM_SCALE;
+    double accel_mm = fmin ((double)accel_d / PLANFILE_MM_SCALE, length);
+    double decel_mm = (flags & PLANFILE_F_CRUISE)
+                          ? fmin ((double)decel_d / PLANFILE_MM_SCALE, length - accel_mm)
+                          : length - accel_mm;
+    double cruise_mm = length - accel_mm - decel_mm;
+    if (!(flags & PLANFILE_F_CRUISE) && decel_mm < quantum) {
+        accel_mm = length;
+        decel_mm = 0.0;
+    }
+    out->accel_distance_mm = accel_mm;
+    out->cruise_distance_mm = cruise_mm > 0.0 ? cruise_mm : 0.0;
+    out->decel_distance_mm = decel_mm > 0.0 ? decel_mm : 0.0;
+
+    c->pos_um[0] += dx;
+    c->pos_um[1] += dy;
+    c->seq = out->seq;
+    c->end_q = end;
+    c->accel_q = accel;
+    c->jerk_q = jerk;
+    r->decoded++;
+    return 1;
+}
+
+/**
+ * @copydoc planfile_reader_close
+ */
+void planfile_reader_close (planfile_reader_t *r) {
+    if (!r)
+        return;
+    if (r->map)
+        munmap (r->map, r->map_len);
+    memset (r, 0, sizeof (*r));
+}
@@ -0,0 +1,132 @@
+/**
+ * @file planfile.h
+ * @brief Компактний двійковий формат плану руху (`.cplan`): збереження та повтор.
+ * @defgroup planfile Файл плану
+ * @ingroup planner
+ * @details
+ * Блоки планувальника зберігаються у фіксованій комі з дельта‑кодуванням, тож
+ * повторний друк того самого завдання не потребує ні верстки, ні планування: файл
+ * відображається у памʼять (`mmap`) і блоки по одному декодуються у `plan_block_t`.
+ *
+ * Запис блоку — байт прапорців і цілі змінної довжини (LEB128, знакові — zigzag):
+ * зміщення до абсолютної позиції в мкм (похибка квантування не накопичується),
+ * швидкості в 0.01 мм/с, прискорення в 0.1 мм/с², ривок у мм/с³, довжини фаз у мкм.
+ * Типовий блок займає 12–20 байт замість ~110 у памʼяті. Не зберігаються величини, що
+ * випливають з інших: довжина й напрямок (зі зміщення), початкова швидкість (дорівнює
+ * кінцевій попереднього блоку), номер (на один більший), прискорення і ривок (як у
+ * попереднього блоку), довжина гальмування без круїзу (решта після розгону). Номінальна
+ * швидкість потрібна крокувачу лише як запасна для блоку без крейсерської швидкості,
+ * тож зберігається тільки тоді, а інакше дорівнює крейсерській.
+ *
+ * Заголовок і записи не залежать від порядку байтів хоста.
+ */
+#ifndef CPLOT_PLANFILE_H
+#define CPLOT_PLANFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "planner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Відомості заголовка файлу плану.
+ */
+typedef struct {
+    char model[32];        /**< Модель пристрою, для якої складено план (може бути порожньою). */
+    double start_mm[2];    /**< Початкова позиція (X,Y), мм. */
+    double max_speed_mm_s; /**< Межа швидкості планувальника, мм/с (для оцінки тривалості). */
+    uint64_t block_count;  /**< Кількість блоків (при записі заповнюється автоматично). */
+} planfile_info_t;
+
+/**
+ * @brief Стан дельта‑кодування, спільний для запису і читання.
+ */
+typedef struct {
+    int64_t pos_um[2];  /**< Квантована абсолютна позиція після останнього блоку, мкм. */
+    unsigned long seq;  /**< Номер останнього блоку. */
+    uint64_t end_q;     /**< Кінцева швидкість останнього блоку, 0.01 мм/с. */
+    uint64_t accel_q;   /**< Прискорення останнього блоку, 0.1 мм/с². */
+    uint64_t jerk_q;    /**< Ривок останнього блоку, мм/с³. */
+} planfile_codec_t;
+
+/**
+ * @brief Відкритий для запису файл плану.
+ */
+typedef struct {
+    FILE *fp;               /**< Потік файлу. */
+    planfile_info_t info;   /**< Заголовок (лічильник блоків оновлюється при закритті). */
+    planfile_codec_t codec; /**< Стан кодування. */
+    double pos_mm[2];       /**< Точна (незаквантована) позиція після останнього блоку, мм. */
+    uint64_t data_size;     /**< Записано байт записів. */
+    bool failed;            /**< Була помилка запису. */
+} planfile_writer_t;
+
+/**
+ * @brief Відкритий для читання (відображений у памʼять) файл плану.
+ */
+typedef struct {
+    void *map;              /**< Відображення файлу (`mmap`). */
+    size_t map_len;         /**< Довжина відображення. */
+    planfile_info_t info;   /**< Заголовок. */
+    size_t offset;          /**< Зсув наступного запису. */
+    uint64_t decoded;       /**< Прочитано блоків. */
+    planfile_codec_t codec; /**< Стан декодування. */
+} planfile_reader_t;
+
+/**
+ * @brief Створює файл плану і записує попередній заголовок.
+ * @param w [out] Стан запису.
+ * @param path Шлях до файлу (перезаписується).
+ * @param info Модель, початкова позиція і межа швидкості плану.
+ * @return 0 — успіх; -1 — помилка відкриття або запису.
+ */
+int planfile_writer_open (planfile_writer_t *w, const char *path, const planfile_info_t *info);
+
+/**
+ * @brief Кодує і дописує блок плану.
+ * @param w Стан запису.
+ * @param block Блок від планувальника.
+ * @return 0 — успіх; -1 — помилка запису.
+ */
+int planfile_write_block (planfile_writer_t *w, const plan_block_t *block);
+
+/**
+ * @brief Оновлює заголовок (кількість блоків, розмір даних) і закриває файл.
+ * @param w Стан запису.
+ * @return 0 — успіх; -1 — помилка запису (файл лишається неповним).
+ */
+int planfile_writer_close (planfile_writer_t *w);
+
+/**
+ * @brief Відкриває файл плану для читання і перевіряє заголовок.
+ * @param path Шлях до файлу.
+ * @param r [out] Стан читання (закрити `planfile_reader_close`).
+ * @return 0 — успіх; 1 — не файл плану або несумісна версія; -1 — помилка відкриття.
+ */
+int planfile_reader_open (const char *path, planfile_reader_t *r);
+
+/**
+ * @brief Декодує наступний блок.
+ * @param r Стан читання.
+ * @param out [out] Блок плану.
+ * @return 1 — блок прочитано; 0 — блоків більше немає; -1 — пошкоджений запис.
+ */
+int planfile_read_block (planfile_reader_t *r, plan_block_t *out);
+
+/**
+ * @brief Знімає відображення файлу.
+ * @param r Стан читання (може бути NULL).
+ */
+void planfile_reader_close (planfile_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,40 +3,71 @@
  * @brief Реалізація планувальника траєкторій і профілів швидкості.
  * @ingroup planner
  * @details
- * Формує безпечні швидкісні профілі (трапецієвидні/трикутні) для послідовності
- * векторних сегментів з урахуванням обмежень швидкості, прискорення і заокруглень
- * на стиках (cornering). Виконує обʼєднання дуже коротких колінеарних сегментів.
+ * Формує безпечні швидкісні профілі (трапецієвидні/трикутні або S‑подібні з обмеженим
+ * ривком) для послідовності векторних сегментів з урахуванням обмежень швидкості,
+ * прискорення і заокруглень на стиках (cornering). Виконує обʼєднання дуже коротких колінеарних сегментів, а в
+ * режимі хорд — складання штрихів пера у хорди з обмеженим відхиленням.
  */
 
 #include "planner.h"
 
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "log.h"
+#include "ttime.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PLANNER_SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PLANNER_SIMD_NEON 1
+#endif
 
 /** \brief Допуск довжини для нульового сегмента, у мм. */
 #define EPSILON_MM 1e-6
 
+/** \brief Скільки проміжних вершин може поглинути одна хорда. */
+#define PLANNER_CHORD_MAX_POINTS 32
+
+/** \brief Ітерації бісекції пікової швидкості S‑подібного профілю. */
+#define PLANNER_SCURVE_BISECT_ITERS 48
+
+/** \brief Кількість смуг `planner_lanes_t` (усі в одному виділенні). */
+#define PLANNER_LANE_COUNT 5
+
 /**
- * @brief Внутрішній вузол планування (один сегмент із розрахованими межами швидкостей).
+ * @brief Внутрішній вузол планування: геометрія і ліміти одного сегмента.
+ * @details Швидкості, які переписують проходи планування, лежать окремо в смугах
+ *          `planner_lanes_t` з тими самими індексами.
  */
 typedef struct {
-    double target[2];       /**< Кінцева точка сегмента (мм). */
-    double delta[2];        /**< Вектор зміщення (мм). */
-    double unit_vec[2];     /**< Одиничний напрямний вектор. */
-    double length_mm;       /**< Довжина сегмента, мм. */
-    double nominal_speed;   /**< Номінальна швидкість (обмежена feed/лімітами), мм/с. */
-    double max_entry_speed; /**< Максимальна дозволена швидкість входу, мм/с. */
-    double entry_speed;     /**< Обрана швидкість входу, мм/с. */
-    double exit_speed;      /**< Обрана швидкість виходу, мм/с. */
-    bool pen_down;          /**< Стан пера. */
-    unsigned long seq;      /**< Порядковий номер. */
+    double target[2];     /**< Кінцева точка сегмента (мм). */
+    double delta[2];      /**< Вектор зміщення (мм). */
+    double unit_vec[2];   /**< Одиничний напрямний вектор. */
+    double length_mm;     /**< Довжина сегмента, мм. */
+    double nominal_speed; /**< Номінальна швидкість (обмежена feed/лімітами), мм/с. */
+    double accel;         /**< Прискорення вздовж сегмента (з межами моторів), мм/с². */
+    bool pen_down;        /**< Стан пера. */
+    unsigned long seq;    /**< Порядковий номер. */
 } planner_node_t;
 
-/** \brief Поточні глобальні ліміти, що застосовуються при розрахунках. */
-static planner_limits_t g_limits;
+/**
+ * @brief Швидкості вузлів як структура масивів, у квадратах (мм²/с²).
+ * @details Без обмеження ривка досяжна швидкість — `v² + 2·a·L`, тож проходи планування
+ *          стають рекурентністю з додавання й мінімуму без жодного кореня; корінь
+ *          береться лише для виданого блоку.
+ */
+typedef struct {
+    double *reach2;     /**< Приріст квадрата швидкості на довжині вузла, 2·a·L. */
+    double *max_entry2; /**< Межа входу (стик, стан пера, номінали). */
+    double *nominal2;   /**< Номінальна швидкість. */
+    double *entry2;     /**< Обрана швидкість входу. */
+    double *exit2;      /**< Обрана швидкість виходу. */
+} planner_lanes_t;
 
 /**
  * @brief Повертає додатне скінченне значення або запасне.
@@ -49,63 +80,152 @@ static double planner_clamp_positive (double value, double fallback) {
     return value;
 }
 
+/**
+ * @brief Межа швидкості для стану пера.
+ * @param lim Ліміти планування.
+ * @param pen_down Стан пера.
+ * @return `max_speed_mm_s` для малювання, `travel_speed_mm_s` (якщо задано) для переїздів.
+ */
+static double planner_speed_cap (const planner_limits_t *lim, bool pen_down) {
+    if (pen_down)
+        return lim->max_speed_mm_s;
+    return planner_clamp_positive (lim->travel_speed_mm_s, lim->max_speed_mm_s);
+}
+
+/**
+ * @brief Прискорення для стану пера.
+ * @param lim Ліміти планування.
+ * @param pen_down Стан пера.
+ * @return `max_accel_mm_s2` для малювання, `travel_accel_mm_s2` (якщо задано) для переїздів.
+ */
+static double planner_accel_cap (const planner_limits_t *lim, bool pen_down) {
+    if (pen_down)
+        return lim->max_accel_mm_s2;
+    return planner_clamp_positive (lim->travel_accel_mm_s2, lim->max_accel_mm_s2);
+}
+
 /**
  * @brief Обчислює ліміт швидкості на стику двох сегментів.
+ * @param lim Ліміти планування.
  * @param prev Попередній вузол.
  * @param curr Поточний вузол.
  * @return Максимальна швидкість входу згідно з `cornering_distance_mm` і кутом між векторами.
  */
-static double
-planner_compute_junction_speed (const planner_node_t *prev, const planner_node_t *curr) {
+static double planner_compute_junction_speed (
+    const planner_limits_t *lim, const planner_node_t *prev, const planner_node_t *curr) {
     if (!prev || !curr)
         return 0.0;
     double dot = prev->unit_vec[0] * curr->unit_vec[0] + prev->unit_vec[1] * curr->unit_vec[1];
     if (!isfinite (dot))
         return 0.0;
-    if (g_limits.cornering_distance_mm <= 0.0)
-        return (dot > 0.999999) ? planner_clamp_positive (g_limits.max_speed_mm_s, 0.0) : 0.0;
+    double cap = planner_speed_cap (lim, curr->pen_down);
+    if (lim->cornering_distance_mm <= 0.0)
+        return (dot > 0.999999) ? planner_clamp_positive (cap, 0.0) : 0.0;
     if (dot > 0.999999)
-        return planner_clamp_positive (g_limits.max_speed_mm_s, 0.0);
+        return planner_clamp_positive (cap, 0.0);
     if (dot < -0.999999)
         dot = -0.999999;
     double sin_theta_half = sqrt (0.5 * (1.0 - dot));
     if (sin_theta_half <= 1e-9)
-        return planner_clamp_positive (g_limits.max_speed_mm_s, 0.0);
-    double numerator = g_limits.max_accel_mm_s2 * g_limits.cornering_distance_mm * sin_theta_half;
+        return planner_clamp_positive (cap, 0.0);
+    double accel = fmin (prev->accel, curr->accel);
+    double numerator = accel * lim->cornering_distance_mm * sin_theta_half;
     double denom = 1.0 - sin_theta_half;
     if (denom <= 0.0)
         return 0.0;
     double limit = sqrt (numerator / denom);
     if (!isfinite (limit) || limit <= 0.0)
         return 0.0;
-    if (limit > g_limits.max_speed_mm_s)
-        limit = g_limits.max_speed_mm_s;
+    if (limit > cap)
+        limit = cap;
     return limit;
 }
 
+/**
+ * @brief Тривалість S‑подібної зміни швидкості на `dv` з обмеженими прискоренням і ривком.
+ * @details Прискорення наростає з ривком `jerk` до `accel` (або до меншого піку, якщо
+ *          `dv < accel²/jerk`), тримається і так само спадає до нуля.
+ */
+static double planner_scurve_time_s (double dv, double accel, double jerk) {
+    dv = fabs (dv);
+    if (dv >= accel * accel / jerk)
+        return dv / accel + accel / jerk;
+    return 2.0 * sqrt (dv / jerk);
+}
+
+/**
+ * @brief Шлях зміни швидкості між `v0` і `v1` за профілем лімітів.
+ * @details S‑крива симетрична, тож середня швидкість дорівнює `(v0 + v1) / 2`.
+ * @return Відстань, мм.
+ */
+static double
+planner_transition_mm (const planner_limits_t *lim, double accel, double v0, double v1) {
+    if (!(lim->max_jerk_mm_s3 > 0.0))
+        return fabs (v1 * v1 - v0 * v0) / (2.0 * accel);
+    return 0.5 * (v0 + v1) * planner_scurve_time_s (v1 - v0, accel, lim->max_jerk_mm_s3);
+}
+
+/**
+ * @brief Найбільша швидкість, якої можна досягти зі швидкості `v` на шляху `length`.
+ * @details Для S‑кривої обернено розвʼязує `planner_transition_mm`: без фази сталого
+ *          прискорення — кубічне рівняння відносно `√dv`, інакше — квадратне відносно `dv`.
+ * @return Швидкість, мм/с.
+ */
+static double
+planner_reach_speed (const planner_limits_t *lim, double accel, double v, double length) {
+    if (!(lim->max_jerk_mm_s3 > 0.0))
+        return sqrt (fmax (0.0, v * v + 2.0 * accel * length));
+    if (!(length > 0.0))
+        return v;
+    double jerk = lim->max_jerk_mm_s3;
+    double dv_full = accel * accel / jerk;
+    double dv;
+    if (length <= (2.0 * v + dv_full) * accel / jerk) {
+        /* s³ + 2v·s − L·√J = 0, де s = √dv (єдиний дійсний корінь, формула Кардано). */
+        double p = 2.0 * v;
+        double q = length * sqrt (jerk);
+        double u = cbrt (0.5 * q + sqrt (0.25 * q * q + p * p * p / 27.0));
+        double s = u - p / (3.0 * u);
+        s -= (s * s * s + p * s - q) / (3.0 * s * s + p);
+        dv = s * s;
+    } else {
+        double b = 2.0 * v + dv_full;
+        double c = 2.0 * v * dv_full - 2.0 * length * accel;
+        dv = -2.0 * c / (b + sqrt (b * b - 4.0 * c));
+    }
+    return v + fmax (0.0, dv);
+}
+
 /**
  * @brief Обчислює параметри трапецієвидного профілю для сегмента.
- * @param node Джерельний вузол з довжиною та граничними швидкостями.
+ * @param lim Ліміти планування.
+ * @param node Джерельний вузол з довжиною та номінальною швидкістю.
+ * @param v0 Обрана швидкість входу, мм/с.
+ * @param v1 Обрана швидкість виходу, мм/с.
  * @param out [out] Блок для заповнення відстаней/швидкостей/прискорення.
  */
-static void planner_compute_trapezoid_profile (const planner_node_t *node, plan_block_t *out) {
+static void planner_compute_trapezoid_profile (
+    const planner_limits_t *lim,
+    const planner_node_t *node,
+    double v0,
+    double v1,
+    plan_block_t *out) {
     const double length = node->length_mm;
-    double v0 = node->entry_speed;
-    double v1 = node->exit_speed;
+    double cap = planner_speed_cap (lim, node->pen_down);
     if (!(v0 > 0.0))
         v0 = 0.0;
     if (!(v1 > 0.0))
         v1 = 0.0;
-    if (v0 > g_limits.max_speed_mm_s)
-        v0 = g_limits.max_speed_mm_s;
-    if (v1 > g_limits.max_speed_mm_s)
-        v1 = g_limits.max_speed_mm_s;
+    if (v0 > cap)
+        v0 = cap;
+    if (v1 > cap)
+        v1 = cap;
     if (!(length > 0.0)) {
         out->accel_distance_mm = 0.0;
         out->decel_distance_mm = 0.0;
         out->cruise_distance_mm = 0.0;
         out->cruise_speed_mm_s = fmax (fmax (v0, v1), 0.0);
-        double accel_default = g_limits.max_accel_mm_s2;
+        double accel_default = planner_accel_cap (lim, node->pen_down);
         if (!(accel_default > 0.0))
             accel_default = 1000.0;
         out->accel_mm_s2 = accel_default;
@@ -117,18 +237,46 @@ static void planner_compute_trapezoid_profile (const planner_node_t *node, plan_
     }
 
     double vmax = node->nominal_speed;
-    if (!(vmax > 0.0) || vmax > g_limits.max_speed_mm_s)
-        vmax = g_limits.max_speed_mm_s;
-    double accel = g_limits.max_accel_mm_s2;
+    if (!(vmax > 0.0) || vmax > cap)
+        vmax = cap;
+    double accel = node->accel;
     if (!(accel > 0.0))
         accel = 1000.0;
 
     double accel_dist = fmax (0.0, (vmax * vmax - v0 * v0) / (2.0 * accel));
     double decel_dist = fmax (0.0, (vmax * vmax - v1 * v1) / (2.0 * accel));
     double cruise_speed = vmax;
+    bool scurve = lim->max_jerk_mm_s3 > 0.0;
+    if (scurve) {
+        accel_dist = planner_transition_mm (lim, accel, v0, fmax (v0, vmax));
+        decel_dist = planner_transition_mm (lim, accel, v1, fmax (v1, vmax));
+    }
 
     double sum_dist = accel_dist + decel_dist;
-    if (sum_dist > length) {
+    if (scurve && sum_dist > length) {
+        /* Пік S‑профілю: шлях розгону й гальмування монотонно зростає з ним. */
+        double lo = fmax (v0, v1);
+        double hi = fmax (lo, vmax);
+        for (int i = 0; i < PLANNER_SCURVE_BISECT_ITERS; ++i) {
+            double mid = 0.5 * (lo + hi);
+            if (planner_transition_mm (lim, accel, v0, mid)
+                    + planner_transition_mm (lim, accel, v1, mid)
+                > length)
+                hi = mid;
+            else
+                lo = mid;
+        }
+        cruise_speed = lo;
+        accel_dist = planner_transition_mm (lim, accel, v0, lo);
+        decel_dist = planner_transition_mm (lim, accel, v1, lo);
+        sum_dist = accel_dist + decel_dist;
+        if (sum_dist > length && sum_dist > 0.0) {
+            double scale = length / sum_dist;
+            accel_dist *= scale;
+            decel_dist *= scale;
+            sum_dist = accel_dist + decel_dist;
+        }
+    } else if (sum_dist > length) {
         double numerator = fmax (0.0, 2.0 * accel * length + v0 * v0 + v1 * v1);
         double v_peak = sqrt (numerator / 2.0);
         if (v_peak < fmax (v0, v1))
@@ -156,6 +304,7 @@ static void planner_compute_trapezoid_profile (const planner_node_t *node, plan_
     out->cruise_distance_mm = cruise_dist;
     out->cruise_speed_mm_s = cruise_speed;
     out->accel_mm_s2 = accel;
+    out->jerk_mm_s3 = scurve ? lim->max_jerk_mm_s3 : 0.0;
 
     if (out->start_speed_mm_s > cruise_speed)
         out->start_speed_mm_s = cruise_speed;
@@ -164,286 +313,1121 @@ static void planner_compute_trapezoid_profile (const planner_node_t *node, plan_
 }
 
 /**
- * @brief Обчислює межі швидкості входу для кожного стику.
+ * @brief Задає прискорення вузла та обмежує його номінальну швидкість межами моторів CoreXY.
+ * @details Мотори рухаються зі швидкостями v·(ux + uy) і v·(ux − uy), тож найбільш
+ *          навантажений мотор обертається в |ux| + |uy| (1..√2) разів швидше за перо.
+ * @param lim Ліміти планування.
+ * @param node Вузол з уже заданими напрямком і номінальною швидкістю.
  */
-static void planner_compute_all_junction_limits (planner_node_t *nodes, size_t count) {
-    if (!nodes || count == 0)
+static void planner_node_apply_motor_limits (const planner_limits_t *lim, planner_node_t *node) {
+    double load = fabs (node->unit_vec[0]) + fabs (node->unit_vec[1]);
+    node->accel = planner_clamp_positive (planner_accel_cap (lim, node->pen_down), 1000.0);
+    if (!(load > 0.0))
         return;
-    nodes[0].max_entry_speed = fmax (0.0, fmin (nodes[0].nominal_speed, g_limits.max_speed_mm_s));
-    for (size_t i = 1; i < count; ++i) {
-        double junction = planner_compute_junction_speed (&nodes[i - 1], &nodes[i]);
-        double lim = junction;
-        if (!(lim > 0.0))
-            lim = 0.0;
+    if (lim->max_motor_accel_mm_s2 > 0.0)
+        node->accel = fmin (node->accel, lim->max_motor_accel_mm_s2 / load);
+    if (lim->max_motor_speed_mm_s > 0.0)
+        node->nominal_speed = fmin (node->nominal_speed, lim->max_motor_speed_mm_s / load);
+}
+
+/**
+ * @brief Обчислює межу швидкості входу у вузол.
+ * @details План починається зі стану спокою, а зміна стану пера рухає сервопривід
+ *          між блоками — там каретка теж має зупинитися.
+ * @param lim Ліміти планування.
+ * @param prev Попередній вузол (NULL — початок плану).
+ * @param node Вузол, для якого рахується межа.
+ * @return Максимальна швидкість входу, мм/с.
+ */
+static double planner_node_entry_limit (
+    const planner_limits_t *lim, const planner_node_t *prev, const planner_node_t *node) {
+    if (!prev || prev->pen_down != node->pen_down)
+        return 0.0;
+    double v = planner_compute_junction_speed (lim, prev, node);
+    if (!(v > 0.0))
+        v = 0.0;
+    v = fmin (v, prev->nominal_speed);
+    v = fmin (v, node->nominal_speed);
+    v = fmin (v, planner_speed_cap (lim, node->pen_down));
+    if (v < 0.0)
+        v = 0.0;
+    return v;
+}
 
-        lim = fmin (lim, nodes[i - 1].nominal_speed);
-        lim = fmin (lim, nodes[i].nominal_speed);
-        lim = fmin (lim, g_limits.max_speed_mm_s);
-        if (lim < 0.0)
-            lim = 0.0;
-        nodes[i].max_entry_speed = lim;
+/** \brief Менше з двох значень (без обробки NaN, на відміну від `fmin`). */
+static double planner_min (double a, double b) {
+    return a < b ? a : b;
+}
+
+/**
+ * @brief Межа входу у вузол у квадраті швидкості, мм²/с².
+ * @param lim Ліміти планування.
+ * @param prev Попередній вузол (NULL — початок плану).
+ * @param node Вузол, для якого рахується межа.
+ */
+static double planner_node_entry_limit2 (
+    const planner_limits_t *lim, const planner_node_t *prev, const planner_node_t *node) {
+    double v = planner_node_entry_limit (lim, prev, node);
+    return v * v;
+}
+
+#if defined(PLANNER_SIMD_SSE2) || defined(PLANNER_SIMD_NEON)
+/**
+ * @brief Межі входу у квадраті для пар вузлів `[first, count)` (`first` ≥ 1).
+ * @details Те саме, що `planner_node_entry_limit2` при `cornering_distance_mm` > 0, але
+ *          для двох стиків за раз і без кореня з межі: v² = a·d·s / (1 − s). Номінали
+ *          читаються зі смуги `nominal2` поруч.
+ * @return Індекс першого вузла, який лишився скалярному циклу.
+ */
+static size_t planner_entry_limits2_pairs (
+    const planner_limits_t *lim,
+    const planner_node_t *nodes,
+    const double *nominal2,
+    double *max_entry2,
+    size_t first,
+    size_t count) {
+    const double cap_draw = planner_speed_cap (lim, true);
+    const double cap_travel = planner_speed_cap (lim, false);
+    const double cap2[2] = { cap_travel * cap_travel, cap_draw * cap_draw };
+    size_t i = first;
+#if defined(PLANNER_SIMD_SSE2)
+    const __m128d one = _mm_set1_pd (1.0);
+    const __m128d half = _mm_set1_pd (0.5);
+    const __m128d zero = _mm_setzero_pd ();
+    const __m128d inf = _mm_set1_pd (INFINITY);
+    const __m128d straight_dot = _mm_set1_pd (0.999999);
+    const __m128d reverse_dot = _mm_set1_pd (-0.999999);
+    const __m128d corner = _mm_set1_pd (lim->cornering_distance_mm);
+    for (; i + 2 <= count; i += 2) {
+        const planner_node_t *p = &nodes[i - 1];
+        const planner_node_t *c0 = &nodes[i];
+        const planner_node_t *c1 = &nodes[i + 1];
+        __m128d dot = _mm_add_pd (
+            _mm_mul_pd (
+                _mm_set_pd (c0->unit_vec[0], p->unit_vec[0]),
+                _mm_set_pd (c1->unit_vec[0], c0->unit_vec[0])),
+            _mm_mul_pd (
+                _mm_set_pd (c0->unit_vec[1], p->unit_vec[1]),
+                _mm_set_pd (c1->unit_vec[1], c0->unit_vec[1])));
+        __m128d accel = _mm_min_pd (
+            _mm_set_pd (c0->accel, p->accel), _mm_set_pd (c1->accel, c0->accel));
+        __m128d cap = _mm_set_pd (cap2[c1->pen_down], cap2[c0->pen_down]);
+        __m128d s = _mm_sqrt_pd (
+            _mm_mul_pd (half, _mm_sub_pd (one, _mm_max_pd (dot, reverse_dot))));
+        __m128d v2 = _mm_div_pd (_mm_mul_pd (_mm_mul_pd (accel, corner), s), _mm_sub_pd (one, s));
+        __m128d valid = _mm_and_pd (
+            _mm_cmpord_pd (dot, dot), _mm_and_pd (_mm_cmpgt_pd (v2, zero), _mm_cmplt_pd (v2, inf)));
+        __m128d straight = _mm_cmpgt_pd (dot, straight_dot);
+        v2 = _mm_and_pd (valid, _mm_min_pd (v2, cap));
+        v2 = _mm_or_pd (_mm_and_pd (straight, cap), _mm_andnot_pd (straight, v2));
+        v2 = _mm_min_pd (v2, _mm_loadu_pd (&nominal2[i - 1]));
+        v2 = _mm_min_pd (v2, _mm_loadu_pd (&nominal2[i]));
+        __m128d same_pen = _mm_cmpeq_pd (
+            _mm_set_pd (c0->pen_down, p->pen_down), _mm_set_pd (c1->pen_down, c0->pen_down));
+        _mm_storeu_pd (&max_entry2[i], _mm_and_pd (same_pen, v2));
+    }
+#else
+    const float64x2_t one = vdupq_n_f64 (1.0);
+    const float64x2_t half = vdupq_n_f64 (0.5);
+    const float64x2_t zero = vdupq_n_f64 (0.0);
+    const float64x2_t inf = vdupq_n_f64 (INFINITY);
+    const float64x2_t straight_dot = vdupq_n_f64 (0.999999);
+    const float64x2_t reverse_dot = vdupq_n_f64 (-0.999999);
+    const float64x2_t corner = vdupq_n_f64 (lim->cornering_distance_mm);
+    for (; i + 2 <= count; i += 2) {
+        const planner_node_t *p = &nodes[i - 1];
+        const planner_node_t *c0 = &nodes[i];
+        const planner_node_t *c1 = &nodes[i + 1];
+        const double pux[2] = { p->unit_vec[0], c0->unit_vec[0] };
+        const double puy[2] = { p->unit_vec[1], c0->unit_vec[1] };
+        const double cux[2] = { c0->unit_vec[0], c1->unit_vec[0] };
+        const double cuy[2] = { c0->unit_vec[1], c1->unit_vec[1] };
+        const double pacc[2] = { p->accel, c0->accel };
+        const double cacc[2] = { c0->accel, c1->accel };
+        const double cap_v[2] = { cap2[c0->pen_down], cap2[c1->pen_down] };
+        const double ppen[2] = { p->pen_down, c0->pen_down };
+        const double cpen[2] = { c0->pen_down, c1->pen_down };
+        float64x2_t dot = vaddq_f64 (
+            vmulq_f64 (vld1q_f64 (pux), vld1q_f64 (cux)),
+            vmulq_f64 (vld1q_f64 (puy), vld1q_f64 (cuy)));
+        float64x2_t accel = vminq_f64 (vld1q_f64 (pacc), vld1q_f64 (cacc));
+        float64x2_t cap = vld1q_f64 (cap_v);
+        float64x2_t s
+            = vsqrtq_f64 (vmulq_f64 (half, vsubq_f64 (one, vmaxq_f64 (dot, reverse_dot))));
+        float64x2_t v2 = vdivq_f64 (vmulq_f64 (vmulq_f64 (accel, corner), s), vsubq_f64 (one, s));
+        uint64x2_t valid = vandq_u64 (vcgtq_f64 (v2, zero), vcltq_f64 (v2, inf));
+        uint64x2_t straight = vcgtq_f64 (dot, straight_dot);
+        v2 = vbslq_f64 (valid, vminq_f64 (v2, cap), zero);
+        v2 = vbslq_f64 (straight, cap, v2);
+        v2 = vminq_f64 (v2, vld1q_f64 (&nominal2[i - 1]));
+        v2 = vminq_f64 (v2, vld1q_f64 (&nominal2[i]));
+        uint64x2_t same_pen = vceqq_f64 (vld1q_f64 (ppen), vld1q_f64 (cpen));
+        vst1q_f64 (&max_entry2[i], vbslq_f64 (same_pen, v2, zero));
     }
+#endif
+    return i;
+}
+#endif
+
+/**
+ * @brief Квадрат швидкості, досяжної на вузлі зі швидкості `√v2`.
+ * @details Без ривка — додавання `reach2`; S‑крива йде через `planner_reach_speed`.
+ */
+static double planner_lane_reach2 (
+    const planner_limits_t *lim, const planner_node_t *node, double reach2, double v2) {
+    if (!(lim->max_jerk_mm_s3 > 0.0))
+        return v2 + reach2;
+    double v = planner_reach_speed (lim, node->accel, sqrt (v2), node->length_mm);
+    return v * v;
 }
 
 /**
  * @brief Виконує двонапрямну корекцію швидкостей входу/виходу згідно з прискоренням.
+ * @details Кінець вікна вважається зупинкою. Паралельно зі зворотним проходом рахується
+ *          песимістична оцінка (вхід в останній вузол = 0, бо його ще можна злити з
+ *          наступним сегментом): вузол, що впирається у `max_entry2` навіть за такої
+ *          оцінки, відсікає вплив майбутніх сегментів на всі попередні.
+ *
+ *          Обидва проходи працюють зі смугами у квадратах швидкостей: зворотний тримає
+ *          e = min(M, e + R) у регістрі, прямий — ще не обрізану номіналом швидкість
+ *          входу, як і раніше.
+ * @param lim Ліміти планування.
+ * @param nodes Вузли вікна.
+ * @param lanes Смуги вікна (з тими самими індексами).
+ * @param count Кількість вузлів.
+ * @param head_entry2 Зафіксований квадрат швидкості входу першого вузла.
+ * @param tail_open true — до вікна ще можуть надійти сегменти.
+ * @return Кількість вузлів на початку вікна, чиї профілі вже не зміняться.
  */
-static void planner_recompute_entry_exit_speeds (planner_node_t *nodes, size_t count) {
+static size_t planner_recompute_entry_exit_speeds (
+    const planner_limits_t *lim,
+    const planner_node_t *nodes,
+    const planner_lanes_t *lanes,
+    size_t count,
+    double head_entry2,
+    bool tail_open) {
     if (!nodes || count == 0)
-        return;
+        return 0;
+    const double *reach2 = lanes->reach2;
+    const double *max_entry2 = lanes->max_entry2;
+    const double *nominal2 = lanes->nominal2;
+    double *entry2 = lanes->entry2;
+    double *exit2 = lanes->exit2;
 
-    const double accel = (g_limits.max_accel_mm_s2 > 0.0) ? g_limits.max_accel_mm_s2 : 1000.0;
+    size_t last = count - 1;
+    double e = planner_min (
+        max_entry2[last], planner_lane_reach2 (lim, &nodes[last], reach2[last], 0.0));
+    entry2[last] = e;
+    for (size_t idx = last; idx-- > 0;) {
+        e = planner_min (max_entry2[idx], planner_lane_reach2 (lim, &nodes[idx], reach2[idx], e));
+        entry2[idx] = e;
+    }
 
-    nodes[count - 1].exit_speed = 0.0;
+    size_t final_count = 0;
+    if (tail_open) {
+        double floor2 = 0.0;
+        for (size_t idx = last; idx-- > 1;) {
+            floor2 = planner_lane_reach2 (lim, &nodes[idx], reach2[idx], floor2);
+            if (max_entry2[idx] <= floor2) {
+                final_count = idx;
+                break;
+            }
+        }
+    }
 
-    double v_allow = sqrt (fmax (0.0, 2.0 * accel * nodes[count - 1].length_mm));
-    double v_entry = fmin (nodes[count - 1].max_entry_speed, v_allow);
-    if (v_entry < 0.0)
-        v_entry = 0.0;
-    nodes[count - 1].entry_speed = v_entry;
+    e = head_entry2;
+    for (size_t i = 0; i < last; ++i) {
+        double next = planner_min (
+            entry2[i + 1], planner_lane_reach2 (lim, &nodes[i], reach2[i], e));
+        entry2[i] = planner_min (e, nominal2[i]);
+        exit2[i] = planner_min (next, nominal2[i]);
+        e = next;
+    }
+    entry2[last] = planner_min (e, nominal2[last]);
+    exit2[last] = 0.0;
 
-    for (size_t idx = count - 1; idx-- > 0;) {
+    return tail_open ? final_count : count;
+}
 
-        nodes[idx].exit_speed = nodes[idx + 1].entry_speed;
+/**
+ * @brief Стан інкрементального планувальника (вікно вузлів, як у буфері Grbl).
+ * @details Вікно — це `nodes[head .. head + count)`: видача блоку лише зсуває `head`,
+ *          а вузли переносяться на початок буфера, коли новому вже немає місця в кінці.
+ *          Смуги `lanes` індексуються так само і переносяться разом із вузлами.
+ */
+struct planner_stream {
+    planner_limits_t limits;     /**< Ліміти планування. */
+    planner_node_t *nodes;       /**< Буфер вузлів; `nodes[head]` — найстаріший у вікні. */
+    planner_lanes_t lanes;       /**< Смуги швидкостей; `reach2` — початок виділення. */
+    size_t node_cap;             /**< Виділений розмір `nodes` і кожної смуги (≥ `capacity`). */
+    size_t head;                 /**< Індекс першого вузла вікна. */
+    size_t count;                /**< Кількість вузлів у вікні. */
+    size_t capacity;             /**< Розмір вікна. */
+    size_t ready;                /**< Скільки вузлів на початку вікна вже остаточні. */
+    bool dirty;                  /**< Вікно змінилося після останнього перерахунку. */
+    bool finished;               /**< Сегментів більше не буде. */
+    bool batch_limits;           /**< Межі входу рахує `planner_stream_fill_entry_limits`. */
+    double head_entry2;          /**< Зафіксований квадрат швидкості входу першого вузла. */
+    double current_pos[2];       /**< Кінцева точка останнього сегмента, мм. */
+    planner_node_t last_emitted; /**< Останній виданий вузол (для стику з головою вікна). */
+    bool have_last_emitted;      /**< Чи є `last_emitted`. */
+    unsigned long next_seq;      /**< Лічильник порядкових номерів. */
+    double chord_pts[PLANNER_CHORD_MAX_POINTS][2]; /**< Вершини, поглинуті останнім вузлом. */
+    size_t chord_count;                            /**< Кількість елементів `chord_pts`. */
+};
 
-        double v_next = nodes[idx].exit_speed;
-        double v_max_by_decel
-            = sqrt (fmax (0.0, v_next * v_next + 2.0 * accel * nodes[idx].length_mm));
-        double v_cap = fmin (nodes[idx].max_entry_speed, v_max_by_decel);
-        if (v_cap < 0.0)
-            v_cap = 0.0;
-        nodes[idx].entry_speed = v_cap;
-    }
+/** \brief Перший вузол вікна. */
+static planner_node_t *planner_stream_window (const planner_stream_t *ps) {
+    return ps->nodes + ps->head;
+}
 
-    for (size_t i = 0; i + 1 < count; ++i) {
-        double v_curr = nodes[i].entry_speed;
+/** \brief Повертає вузол, що передує `index`-му вузлу вікна (можливо, вже виданий). */
+static const planner_node_t *planner_stream_prev_node (const planner_stream_t *ps, size_t index) {
+    if (index > 0)
+        return &planner_stream_window (ps)[index - 1];
+    return ps->have_last_emitted ? &ps->last_emitted : NULL;
+}
 
-        double v_allow_fwd = sqrt (fmax (0.0, v_curr * v_curr + 2.0 * accel * nodes[i].length_mm));
-        if (nodes[i + 1].entry_speed > v_allow_fwd) {
-            nodes[i + 1].entry_speed = v_allow_fwd;
-        }
+/** \brief Останній вузол непорожнього вікна. */
+static planner_node_t *planner_stream_last (const planner_stream_t *ps) {
+    return &planner_stream_window (ps)[ps->count - 1];
+}
+
+/** \brief Розкладає `PLANNER_LANE_COUNT` смуг по `cap` елементів у виділенні `buf`. */
+static void planner_lanes_bind (planner_lanes_t *lanes, double *buf, size_t cap) {
+    lanes->reach2 = buf;
+    lanes->max_entry2 = buf + cap;
+    lanes->nominal2 = buf + 2 * cap;
+    lanes->entry2 = buf + 3 * cap;
+    lanes->exit2 = buf + 4 * cap;
+}
+
+/** \brief Смуги, зсунуті на початок вікна (індекс 0 — `nodes[head]`). */
+static planner_lanes_t planner_stream_lanes (const planner_stream_t *ps) {
+    planner_lanes_t lanes = ps->lanes;
+    lanes.reach2 += ps->head;
+    lanes.max_entry2 += ps->head;
+    lanes.nominal2 += ps->head;
+    lanes.entry2 += ps->head;
+    lanes.exit2 += ps->head;
+    return lanes;
+}
+
+/**
+ * @brief Записує в смуги ліміти `index`-го вузла вікна.
+ * @details Межу входу пропускає пакетне планування — її заповнить
+ *          `planner_stream_fill_entry_limits`.
+ */
+static void planner_stream_store_limits (planner_stream_t *ps, size_t index) {
+    const planner_node_t *node = &planner_stream_window (ps)[index];
+    planner_lanes_t lanes = planner_stream_lanes (ps);
+    lanes.reach2[index] = 2.0 * node->accel * node->length_mm;
+    lanes.nominal2[index] = node->nominal_speed * node->nominal_speed;
+    if (!ps->batch_limits)
+        lanes.max_entry2[index]
+            = planner_node_entry_limit2 (&ps->limits, planner_stream_prev_node (ps, index), node);
+}
+
+/**
+ * @brief Рахує межі входу всіх вузлів вікна одним проходом (пакетне планування).
+ * @details Стики незалежні, тож при заокругленні кутів їх рахує векторне ядро по два.
+ */
+static void planner_stream_fill_entry_limits (planner_stream_t *ps) {
+    const planner_limits_t *lim = &ps->limits;
+    const planner_node_t *nodes = planner_stream_window (ps);
+    planner_lanes_t lanes = planner_stream_lanes (ps);
+    if (ps->count == 0)
+        return;
+    lanes.max_entry2[0] = planner_node_entry_limit2 (lim, planner_stream_prev_node (ps, 0), nodes);
+    size_t i = 1;
+#if defined(PLANNER_SIMD_SSE2) || defined(PLANNER_SIMD_NEON)
+    if (lim->cornering_distance_mm > 0.0)
+        i = planner_entry_limits2_pairs (
+            lim, nodes, lanes.nominal2, lanes.max_entry2, i, ps->count);
+#endif
+    for (; i < ps->count; ++i)
+        lanes.max_entry2[i] = planner_node_entry_limit2 (lim, &nodes[i - 1], &nodes[i]);
+}
+
+/**
+ * @brief Переводить кінець останнього вузла вікна у кінцеву точку сегмента.
+ * @param ps Планувальник.
+ * @param segment Поглинутий сегмент.
+ * @param dx Нове зміщення вузла по X, мм.
+ * @param dy Нове зміщення вузла по Y, мм.
+ * @param length Нова довжина вузла (> 0), мм.
+ */
+static void planner_stream_retarget_last (
+    planner_stream_t *ps, const planner_segment_t *segment, double dx, double dy, double length) {
+    planner_node_t *last_node = planner_stream_last (ps);
+    last_node->target[0] = segment->target_mm[0];
+    last_node->target[1] = segment->target_mm[1];
+    last_node->delta[0] = dx;
+    last_node->delta[1] = dy;
+    last_node->length_mm = length;
+    double inv_length = 1.0 / length;
+    last_node->unit_vec[0] = dx * inv_length;
+    last_node->unit_vec[1] = dy * inv_length;
+    const planner_limits_t *lim = &ps->limits;
+    double cap = planner_speed_cap (lim, last_node->pen_down);
+    double new_nominal = planner_clamp_positive (segment->feed_mm_s, cap);
+    if (new_nominal > cap)
+        new_nominal = cap;
+    if (last_node->nominal_speed <= 0.0 || new_nominal < last_node->nominal_speed)
+        last_node->nominal_speed = new_nominal;
+    planner_node_apply_motor_limits (lim, last_node);
+    planner_stream_store_limits (ps, ps->count - 1);
+}
 
-        nodes[i].exit_speed = nodes[i + 1].entry_speed;
+/**
+ * @brief Намагається злити короткий сегмент з останнім вузлом вікна.
+ * @return true — сегмент поглинуто.
+ */
+static bool planner_stream_try_merge (planner_stream_t *ps, const planner_segment_t *segment) {
+    if (ps->count == 0)
+        return false;
+    planner_node_t *last_node = planner_stream_last (ps);
+    double start_x = last_node->target[0] - last_node->delta[0];
+    double start_y = last_node->target[1] - last_node->delta[1];
+    double new_delta_x = segment->target_mm[0] - start_x;
+    double new_delta_y = segment->target_mm[1] - start_y;
+    double new_length = sqrt (new_delta_x * new_delta_x + new_delta_y * new_delta_y);
+    if (!(new_length > EPSILON_MM) || last_node->pen_down != segment->pen_down)
+        return false;
+    double inv_new_len = 1.0 / new_length;
+    double dot = last_node->unit_vec[0] * new_delta_x * inv_new_len
+                 + last_node->unit_vec[1] * new_delta_y * inv_new_len;
+    if (dot > 1.0)
+        dot = 1.0;
+    if (dot < 0.999)
+        return false;
+    planner_stream_retarget_last (ps, segment, new_delta_x, new_delta_y, new_length);
+    return true;
+}
 
-        if (nodes[i].entry_speed > nodes[i].nominal_speed)
-            nodes[i].entry_speed = nodes[i].nominal_speed;
-        if (nodes[i].exit_speed > nodes[i].nominal_speed)
-            nodes[i].exit_speed = nodes[i].nominal_speed;
+/** \brief Відстань від точки до відрізка [a, b], мм. */
+static double planner_point_segment_dist (const double p[2], const double a[2], const double b[2]) {
+    double dx = b[0] - a[0];
+    double dy = b[1] - a[1];
+    double len2 = dx * dx + dy * dy;
+    double t = 0.0;
+    if (len2 > 0.0) {
+        t = ((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / len2;
+        if (t < 0.0)
+            t = 0.0;
+        else if (t > 1.0)
+            t = 1.0;
     }
+    double ex = p[0] - (a[0] + t * dx);
+    double ey = p[1] - (a[1] + t * dy);
+    return sqrt (ex * ex + ey * ey);
+}
 
-    if (nodes[count - 1].entry_speed > nodes[count - 1].nominal_speed)
-        nodes[count - 1].entry_speed = nodes[count - 1].nominal_speed;
+/**
+ * @brief Намагається продовжити останній вузол хордою до кінця сегмента (режим хорд).
+ * @details Вузол стає хордою від свого початку до `segment->target_mm`, якщо всі
+ *          поглинуті вершини (разом із поточним кінцем вузла) лишаються ближче ніж
+ *          `chord_tolerance_mm` до нової хорди. Довжина сегмента не має значення, тож
+ *          плавні криві складаються з кількох довгих блоків без зниження швидкості на
+ *          кожному стику. Вузол, що йде одразу за вже виданим, не змінюється: швидкість
+ *          входу в нього зафіксована і не може врахувати новий напрям.
+ * @return true — сегмент поглинуто.
+ */
+static bool planner_stream_try_chord (planner_stream_t *ps, const planner_segment_t *segment) {
+    if (ps->count == 0 || !segment->pen_down)
+        return false;
+    if (ps->count == 1 && ps->have_last_emitted)
+        return false;
+    planner_node_t *last_node = planner_stream_last (ps);
+    if (!last_node->pen_down || ps->chord_count >= PLANNER_CHORD_MAX_POINTS)
+        return false;
+    double start[2] = { last_node->target[0] - last_node->delta[0],
+                        last_node->target[1] - last_node->delta[1] };
+    double new_delta_x = segment->target_mm[0] - start[0];
+    double new_delta_y = segment->target_mm[1] - start[1];
+    double new_length = sqrt (new_delta_x * new_delta_x + new_delta_y * new_delta_y);
+    if (!(new_length > EPSILON_MM))
+        return false;
+    const double tol = ps->limits.chord_tolerance_mm;
+    if (planner_point_segment_dist (last_node->target, start, segment->target_mm) > tol)
+        return false;
+    for (size_t i = 0; i < ps->chord_count; ++i)
+        if (planner_point_segment_dist (ps->chord_pts[i], start, segment->target_mm) > tol)
+            return false;
+    ps->chord_pts[ps->chord_count][0] = last_node->target[0];
+    ps->chord_pts[ps->chord_count][1] = last_node->target[1];
+    ++ps->chord_count;
+    planner_stream_retarget_last (ps, segment, new_delta_x, new_delta_y, new_length);
+    return true;
 }
 
-/** \brief Додає вузол до масиву та збільшує лічильник. */
-static void planner_store_node (planner_node_t *nodes, size_t *node_count, planner_node_t node) {
-    nodes[*node_count] = node;
-    ++(*node_count);
+/** \brief Обнуляє блок і переносить у нього геометрію, номінал і стан пера вузла. */
+static void planner_block_init (const planner_node_t *node, plan_block_t *block) {
+    memset (block, 0, sizeof (*block));
+    block->seq = node->seq;
+    block->delta_mm[0] = node->delta[0];
+    block->delta_mm[1] = node->delta[1];
+    block->length_mm = node->length_mm;
+    block->unit_vec[0] = node->unit_vec[0];
+    block->unit_vec[1] = node->unit_vec[1];
+    block->nominal_speed_mm_s = node->nominal_speed;
+    block->pen_down = node->pen_down;
+}
+
+/** \brief Журналює готовий блок (лише у налагоджувальній збірці). */
+static void planner_block_log (const plan_block_t *block) {
+#ifdef DEBUG
+    log_print (
+        LOG_DEBUG,
+        "планувальник: блок №%lu довжина=%.3f старт=%.3f кінець=%.3f крейсер=%.3f "
+        "a/c/d=%.3f/%.3f/%.3f перо=%d",
+        block->seq, block->length_mm, block->start_speed_mm_s, block->end_speed_mm_s,
+        block->cruise_speed_mm_s, block->accel_distance_mm, block->cruise_distance_mm,
+        block->decel_distance_mm, block->pen_down);
+#else
+    (void)block;
+#endif
+}
+
+/** \brief Заповнює блок плану з остаточного вузла і його швидкостей входу/виходу. */
+static void planner_node_to_block (
+    const planner_limits_t *lim,
+    const planner_node_t *node,
+    double entry_speed,
+    double exit_speed,
+    plan_block_t *block) {
+    planner_block_init (node, block);
+    block->start_speed_mm_s = entry_speed;
+    block->end_speed_mm_s = exit_speed;
+
+    planner_compute_trapezoid_profile (lim, node, entry_speed, exit_speed, block);
+    planner_block_log (block);
 }
 
 /**
- * @copydoc planner_plan
+ * @brief Трапецієвидний профіль `index`-го вузла зі смуг, без ривка і без розгалужень.
+ * @details Пік p² = min(vmax², (2·a·L + v0² + v1²) / 2), не нижчий за max(v0², v1²),
+ *          описує і повну трапецію (тоді він дорівнює vmax²), і трикутник, тож квадрати
+ *          швидкостей зі смуг ідуть у формули напряму. Результат збігається з
+ *          `planner_compute_trapezoid_profile` з точністю до округлення.
+ * @param lim Ліміти планування.
+ * @param node Вузол.
+ * @param lanes Смуги вікна.
+ * @param index Індекс вузла у вікні.
+ * @param block [out] Блок (уже з `planner_block_init`).
  */
-bool planner_plan (
+static void planner_block_trapezoid2 (
+    const planner_limits_t *lim,
+    const planner_node_t *node,
+    const planner_lanes_t *lanes,
+    size_t index,
+    plan_block_t *block) {
+    double cap = planner_speed_cap (lim, node->pen_down);
+    double cap2 = cap * cap;
+    double e2 = planner_min (lanes->entry2[index], cap2);
+    double x2 = planner_min (lanes->exit2[index], cap2);
+    double vmax2 = planner_min (lanes->nominal2[index], cap2);
+    double half_inv_a = 0.5 / node->accel;
+    double peak2 = fmax (
+        planner_min (vmax2, 0.5 * (lanes->reach2[index] + e2 + x2)), fmax (e2, x2));
+    double accel_dist = fmax (0.0, (peak2 - e2) * half_inv_a);
+    double decel_dist = fmax (0.0, (peak2 - x2) * half_inv_a);
+    double scale = planner_min (node->length_mm / (accel_dist + decel_dist), 1.0);
+    accel_dist *= scale;
+    decel_dist *= scale;
+    double cruise = sqrt (peak2);
+    block->start_speed_mm_s = planner_min (sqrt (lanes->entry2[index]), cruise);
+    block->end_speed_mm_s = planner_min (sqrt (lanes->exit2[index]), cruise);
+    block->cruise_speed_mm_s = cruise;
+    block->accel_distance_mm = accel_dist;
+    block->decel_distance_mm = decel_dist;
+    block->cruise_distance_mm = fmax (0.0, node->length_mm - (accel_dist + decel_dist));
+    block->accel_mm_s2 = node->accel;
+}
+
+/**
+ * @brief Блоки всіх вузлів вікна без ривка: векторне ядро по два вузли, решта скалярно.
+ * @param lim Ліміти планування.
+ * @param nodes Вузли вікна.
+ * @param lanes Смуги вікна з обраними швидкостями.
+ * @param count Кількість вузлів.
+ * @param blocks [out] Блоки (`count` елементів).
+ */
+static void planner_trapezoids2 (
+    const planner_limits_t *lim,
+    const planner_node_t *nodes,
+    const planner_lanes_t *lanes,
+    size_t count,
+    plan_block_t *blocks) {
+    size_t i = 0;
+#if defined(PLANNER_SIMD_SSE2) || defined(PLANNER_SIMD_NEON)
+    const double cap_draw = planner_speed_cap (lim, true);
+    const double cap_travel = planner_speed_cap (lim, false);
+    const double cap2[2] = { cap_travel * cap_travel, cap_draw * cap_draw };
+#endif
+#if defined(PLANNER_SIMD_SSE2)
+    const __m128d zero = _mm_setzero_pd ();
+    const __m128d half = _mm_set1_pd (0.5);
+    const __m128d one = _mm_set1_pd (1.0);
+    for (; i + 2 <= count; i += 2) {
+        const planner_node_t *n0 = &nodes[i];
+        const planner_node_t *n1 = &nodes[i + 1];
+        plan_block_t *b0 = &blocks[i];
+        plan_block_t *b1 = &blocks[i + 1];
+        planner_block_init (n0, b0);
+        planner_block_init (n1, b1);
+        __m128d cap = _mm_set_pd (cap2[n1->pen_down], cap2[n0->pen_down]);
+        __m128d len = _mm_set_pd (n1->length_mm, n0->length_mm);
+        __m128d accel = _mm_set_pd (n1->accel, n0->accel);
+        __m128d e_raw = _mm_loadu_pd (&lanes->entry2[i]);
+        __m128d x_raw = _mm_loadu_pd (&lanes->exit2[i]);
+        __m128d e2 = _mm_min_pd (e_raw, cap);
+        __m128d x2 = _mm_min_pd (x_raw, cap);
+        __m128d vmax2 = _mm_min_pd (_mm_loadu_pd (&lanes->nominal2[i]), cap);
+        __m128d half_inv_a = _mm_div_pd (half, accel);
+        __m128d tri2
+            = _mm_mul_pd (half, _mm_add_pd (_mm_loadu_pd (&lanes->reach2[i]), _mm_add_pd (e2, x2)));
+        __m128d peak2 = _mm_max_pd (_mm_min_pd (vmax2, tri2), _mm_max_pd (e2, x2));
+        __m128d ad = _mm_max_pd (zero, _mm_mul_pd (_mm_sub_pd (peak2, e2), half_inv_a));
+        __m128d dd = _mm_max_pd (zero, _mm_mul_pd (_mm_sub_pd (peak2, x2), half_inv_a));
+        __m128d scale = _mm_min_pd (_mm_div_pd (len, _mm_add_pd (ad, dd)), one);
+        ad = _mm_mul_pd (ad, scale);
+        dd = _mm_mul_pd (dd, scale);
+        __m128d cd = _mm_max_pd (zero, _mm_sub_pd (len, _mm_add_pd (ad, dd)));
+        __m128d cruise = _mm_sqrt_pd (peak2);
+        __m128d start = _mm_min_pd (_mm_sqrt_pd (e_raw), cruise);
+        __m128d end = _mm_min_pd (_mm_sqrt_pd (x_raw), cruise);
+        _mm_storel_pd (&b0->start_speed_mm_s, start);
+        _mm_storeh_pd (&b1->start_speed_mm_s, start);
+        _mm_storel_pd (&b0->end_speed_mm_s, end);
+        _mm_storeh_pd (&b1->end_speed_mm_s, end);
+        _mm_storel_pd (&b0->cruise_speed_mm_s, cruise);
+        _mm_storeh_pd (&b1->cruise_speed_mm_s, cruise);
+        _mm_storel_pd (&b0->accel_distance_mm, ad);
+        _mm_storeh_pd (&b1->accel_distance_mm, ad);
+        _mm_storel_pd (&b0->decel_distance_mm, dd);
+        _mm_storeh_pd (&b1->decel_distance_mm, dd);
+        _mm_storel_pd (&b0->cruise_distance_mm, cd);
+        _mm_storeh_pd (&b1->cruise_distance_mm, cd);
+        b0->accel_mm_s2 = n0->accel;
+        b1->accel_mm_s2 = n1->accel;
+    }
+#elif defined(PLANNER_SIMD_NEON)
+    const float64x2_t zero = vdupq_n_f64 (0.0);
+    const float64x2_t half = vdupq_n_f64 (0.5);
+    const float64x2_t one = vdupq_n_f64 (1.0);
+    for (; i + 2 <= count; i += 2) {
+        const planner_node_t *n0 = &nodes[i];
+        const planner_node_t *n1 = &nodes[i + 1];
+        plan_block_t *b0 = &blocks[i];
+        plan_block_t *b1 = &blocks[i + 1];
+        planner_block_init (n0, b0);
+        planner_block_init (n1, b1);
+        const double cap_v[2] = { cap2[n0->pen_down], cap2[n1->pen_down] };
+        const double len_v[2] = { n0->length_mm, n1->length_mm };
+        const double accel_v[2] = { n0->accel, n1->accel };
+        float64x2_t cap = vld1q_f64 (cap_v);
+        float64x2_t len = vld1q_f64 (len_v);
+        float64x2_t e_raw = vld1q_f64 (&lanes->entry2[i]);
+        float64x2_t x_raw = vld1q_f64 (&lanes->exit2[i]);
+        float64x2_t e2 = vminq_f64 (e_raw, cap);
+        float64x2_t x2 = vminq_f64 (x_raw, cap);
+        float64x2_t vmax2 = vminq_f64 (vld1q_f64 (&lanes->nominal2[i]), cap);
+        float64x2_t half_inv_a = vdivq_f64 (half, vld1q_f64 (accel_v));
+        float64x2_t tri2
+            = vmulq_f64 (half, vaddq_f64 (vld1q_f64 (&lanes->reach2[i]), vaddq_f64 (e2, x2)));
+        float64x2_t peak2 = vmaxq_f64 (vminq_f64 (vmax2, tri2), vmaxq_f64 (e2, x2));
+        float64x2_t ad = vmaxq_f64 (zero, vmulq_f64 (vsubq_f64 (peak2, e2), half_inv_a));
+        float64x2_t dd = vmaxq_f64 (zero, vmulq_f64 (vsubq_f64 (peak2, x2), half_inv_a));
+        float64x2_t scale = vminq_f64 (vdivq_f64 (len, vaddq_f64 (ad, dd)), one);
+        ad = vmulq_f64 (ad, scale);
+        dd = vmulq_f64 (dd, scale);
+        float64x2_t cd = vmaxq_f64 (zero, vsubq_f64 (len, vaddq_f64 (ad, dd)));
+        float64x2_t cruise = vsqrtq_f64 (peak2);
+        float64x2_t start = vminq_f64 (vsqrtq_f64 (e_raw), cruise);
+        float64x2_t end = vminq_f64 (vsqrtq_f64 (x_raw), cruise);
+        vst1q_lane_f64 (&b0->start_speed_mm_s, start, 0);
+        vst1q_lane_f64 (&b1->start_speed_mm_s, start, 1);
+        vst1q_lane_f64 (&b0->end_speed_mm_s, end, 0);
+        vst1q_lane_f64 (&b1->end_speed_mm_s, end, 1);
+        vst1q_lane_f64 (&b0->cruise_speed_mm_s, cruise, 0);
+        vst1q_lane_f64 (&b1->cruise_speed_mm_s, cruise, 1);
+        vst1q_lane_f64 (&b0->accel_distance_mm, ad, 0);
+        vst1q_lane_f64 (&b1->accel_distance_mm, ad, 1);
+        vst1q_lane_f64 (&b0->decel_distance_mm, dd, 0);
+        vst1q_lane_f64 (&b1->decel_distance_mm, dd, 1);
+        vst1q_lane_f64 (&b0->cruise_distance_mm, cd, 0);
+        vst1q_lane_f64 (&b1->cruise_distance_mm, cd, 1);
+        b0->accel_mm_s2 = n0->accel;
+        b1->accel_mm_s2 = n1->accel;
+    }
+#endif
+    for (; i < count; ++i) {
+        planner_block_init (&nodes[i], &blocks[i]);
+        planner_block_trapezoid2 (lim, &nodes[i], lanes, i, &blocks[i]);
+    }
+#ifdef DEBUG
+    for (i = 0; i < count; ++i)
+        planner_block_log (&blocks[i]);
+#endif
+}
+
+/** \brief Перевіряє ліміти планувальника. */
+static bool planner_limits_valid (const planner_limits_t *limits) {
+    if (!(limits->max_speed_mm_s > 0.0) || !(limits->max_accel_mm_s2 > 0.0)) {
+        LOGE ("планувальник: швидкість та прискорення повинні бути додатними");
+        return false;
+    }
+    if (!(limits->cornering_distance_mm >= 0.0) || !(limits->min_segment_mm >= 0.0)
+        || !(limits->chord_tolerance_mm >= 0.0) || !(limits->max_jerk_mm_s3 >= 0.0)
+        || !(limits->max_motor_speed_mm_s >= 0.0) || !(limits->max_motor_accel_mm_s2 >= 0.0)
+        || !(limits->travel_speed_mm_s >= 0.0) || !(limits->travel_accel_mm_s2 >= 0.0)) {
+        LOGE ("планувальник: кути та мінімальна довжина не можуть бути від’ємними");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Готує планувальник до нового плану, зберігаючи вже виділений буфер вузлів.
+ * @param ps Планувальник.
+ * @param limits Обмеження пристрою (вже перевірені).
+ * @param start_position_mm Початкова позиція (X,Y) у мм; може бути `NULL` (0,0).
+ * @param window Розмір вікна у вузлах (≥ 2).
+ * @return true — успіх; false — не вдалося збільшити буфер (стан не змінено).
+ */
+static bool planner_stream_reset (
+    planner_stream_t *ps,
     const planner_limits_t *limits,
     const double start_position_mm[2],
-    const planner_segment_t *segments,
-    size_t segment_count,
-    plan_block_t **out_blocks,
-    size_t *out_count) {
-    if (out_blocks)
-        *out_blocks = NULL;
-    if (out_count)
-        *out_count = 0;
+    size_t window) {
+    if (window > ps->node_cap) {
+        if (window > SIZE_MAX / (sizeof (*ps->nodes) + PLANNER_LANE_COUNT * sizeof (double))) {
+            LOGE ("планувальник: неможливо виділити пам’ять під вузли");
+            return false;
+        }
+        double *lane_buf
+            = realloc (ps->lanes.reach2, window * PLANNER_LANE_COUNT * sizeof (*lane_buf));
+        if (!lane_buf) {
+            LOGE ("планувальник: неможливо виділити пам’ять під вузли");
+            return false;
+        }
+        planner_lanes_bind (&ps->lanes, lane_buf, ps->node_cap);
+        planner_node_t *grown = realloc (ps->nodes, window * sizeof (*grown));
+        if (!grown) {
+            LOGE ("планувальник: неможливо виділити пам’ять під вузли");
+            return false;
+        }
+        ps->nodes = grown;
+        ps->node_cap = window;
+        planner_lanes_bind (&ps->lanes, lane_buf, window);
+    }
+    planner_node_t *nodes = ps->nodes;
+    planner_lanes_t lanes = ps->lanes;
+    size_t node_cap = ps->node_cap;
+    memset (ps, 0, sizeof (*ps));
+    ps->nodes = nodes;
+    ps->lanes = lanes;
+    ps->node_cap = node_cap;
+    ps->limits = *limits;
+    ps->capacity = window;
+    if (start_position_mm) {
+        ps->current_pos[0] = start_position_mm[0];
+        ps->current_pos[1] = start_position_mm[1];
+    }
+    return true;
+}
 
-    if (!limits || !segments || !out_blocks || !out_count) {
+/**
+ * @copydoc planner_stream_create
+ */
+bool planner_stream_create (
+    const planner_limits_t *limits,
+    const double start_position_mm[2],
+    size_t window,
+    planner_stream_t **out_stream) {
+    if (out_stream)
+        *out_stream = NULL;
+    if (!limits || !out_stream || window < 2) {
         LOGE ("планувальник: некоректні параметри виклику");
         return false;
     }
-    if (!(limits->max_speed_mm_s > 0.0) || !(limits->max_accel_mm_s2 > 0.0)) {
-        LOGE ("планувальник: швидкість та прискорення повинні бути додатними");
+    if (!planner_limits_valid (limits))
+        return false;
+    planner_stream_t *ps = calloc (1, sizeof (*ps));
+    if (!ps) {
+        LOGE ("планувальник: неможливо виділити пам’ять під вузли");
         return false;
     }
-    if (!(limits->cornering_distance_mm >= 0.0) || !(limits->min_segment_mm >= 0.0)) {
-        LOGE ("планувальник: кути та мінімальна довжина не можуть бути від’ємними");
+    if (!planner_stream_reset (ps, limits, start_position_mm, window)) {
+        free (ps);
         return false;
     }
+    *out_stream = ps;
+    return true;
+}
 
-    if (segment_count == 0) {
+/** \brief Тіло `planner_push_segment` без профілю. */
+static bool planner_push_segment_run (planner_stream_t *ps, const planner_segment_t *segment) {
+    if (!ps || !segment || ps->finished) {
+        LOGE ("планувальник: некоректні параметри виклику");
+        return false;
+    }
+    const planner_limits_t *lim = &ps->limits;
+
+    double delta[2];
+    delta[0] = segment->target_mm[0] - ps->current_pos[0];
+    delta[1] = segment->target_mm[1] - ps->current_pos[1];
+    double length_mm = sqrt (delta[0] * delta[0] + delta[1] * delta[1]);
+
+    if (length_mm <= EPSILON_MM) {
+        ps->current_pos[0] = segment->target_mm[0];
+        ps->current_pos[1] = segment->target_mm[1];
         return true;
     }
 
-    planner_node_t *nodes = calloc (segment_count, sizeof (*nodes));
-    if (!nodes) {
-        LOGE ("планувальник: неможливо виділити пам’ять під вузли");
+    bool merged;
+    if (lim->chord_tolerance_mm > 0.0 && segment->pen_down)
+        merged = planner_stream_try_chord (ps, segment);
+    else
+        merged = length_mm < lim->min_segment_mm && planner_stream_try_merge (ps, segment);
+    if (merged) {
+        ps->current_pos[0] = segment->target_mm[0];
+        ps->current_pos[1] = segment->target_mm[1];
+        ps->dirty = true;
+        return true;
+    }
+
+    if (ps->count == ps->capacity) {
+        LOGE ("планувальник: вікно заповнене — спершу заберіть готові блоки");
         return false;
     }
+    if (ps->head + ps->count == ps->node_cap) {
+        planner_lanes_t from = planner_stream_lanes (ps);
+        memmove (ps->nodes, planner_stream_window (ps), ps->count * sizeof (*ps->nodes));
+        memmove (ps->lanes.reach2, from.reach2, ps->count * sizeof (double));
+        memmove (ps->lanes.max_entry2, from.max_entry2, ps->count * sizeof (double));
+        memmove (ps->lanes.nominal2, from.nominal2, ps->count * sizeof (double));
+        ps->head = 0;
+    }
 
-    g_limits = *limits;
+    planner_node_t node;
+    memset (&node, 0, sizeof (node));
+    node.target[0] = segment->target_mm[0];
+    node.target[1] = segment->target_mm[1];
+    node.delta[0] = delta[0];
+    node.delta[1] = delta[1];
+    node.length_mm = length_mm;
+    node.pen_down = segment->pen_down;
 
-    double current_pos[2] = { 0.0, 0.0 };
-    if (start_position_mm) {
-        current_pos[0] = start_position_mm[0];
-        current_pos[1] = start_position_mm[1];
-    }
-
-    bool pending_short = false;
-    planner_segment_t pending_segment;
-    double pending_start[2] = { 0.0, 0.0 };
-
-    size_t node_count = 0;
-    unsigned long next_seq = 0;
-
-    size_t seg_index = 0;
-    while (seg_index < segment_count || pending_short) {
-        planner_segment_t segment;
-        double start_point[2];
-        bool was_pending = false;
-
-        if (pending_short) {
-            segment = pending_segment;
-            start_point[0] = pending_start[0];
-            start_point[1] = pending_start[1];
-            pending_short = false;
-            was_pending = true;
-        } else {
-            segment = segments[seg_index++];
-            start_point[0] = current_pos[0];
-            start_point[1] = current_pos[1];
-        }
+    double inv_length = 1.0 / length_mm;
+    node.unit_vec[0] = delta[0] * inv_length;
+    node.unit_vec[1] = delta[1] * inv_length;
 
-        double delta[2];
-        delta[0] = segment.target_mm[0] - start_point[0];
-        delta[1] = segment.target_mm[1] - start_point[1];
-        double length_mm = hypot (delta[0], delta[1]);
+    double cap = planner_speed_cap (lim, node.pen_down);
+    double nominal = planner_clamp_positive (segment->feed_mm_s, cap);
+    if (nominal > cap)
+        nominal = cap;
+    node.nominal_speed = nominal;
+    planner_node_apply_motor_limits (lim, &node);
+    node.seq = ++ps->next_seq;
 
-        if (length_mm <= EPSILON_MM) {
-            current_pos[0] = segment.target_mm[0];
-            current_pos[1] = segment.target_mm[1];
-            continue;
-        }
+    planner_stream_window (ps)[ps->count++] = node;
+    planner_stream_store_limits (ps, ps->count - 1);
+    ps->chord_count = 0;
+    ps->current_pos[0] = segment->target_mm[0];
+    ps->current_pos[1] = segment->target_mm[1];
+    ps->dirty = true;
+    return true;
+}
 
-        if (!was_pending && node_count == 0 && g_limits.min_segment_mm > 0.0
-            && length_mm < g_limits.min_segment_mm) {
-            pending_short = true;
-            pending_segment = segment;
-            pending_start[0] = start_point[0];
-            pending_start[1] = start_point[1];
-            current_pos[0] = segment.target_mm[0];
-            current_pos[1] = segment.target_mm[1];
-            continue;
-        }
+/**
+ * @copydoc planner_push_segment
+ */
+bool planner_push_segment (planner_stream_t *ps, const planner_segment_t *segment) {
+    uint64_t t0 = ttime_stage_begin ();
+    bool ok = planner_push_segment_run (ps, segment);
+    ttime_stage_end (TTIME_STAGE_PLAN, t0);
+    return ok;
+}
 
-        bool merged = false;
-        if (length_mm < g_limits.min_segment_mm && node_count > 0) {
-            planner_node_t *last_node = &nodes[node_count - 1];
-            double start_x = last_node->target[0] - last_node->delta[0];
-            double start_y = last_node->target[1] - last_node->delta[1];
-            double new_delta_x = segment.target_mm[0] - start_x;
-            double new_delta_y = segment.target_mm[1] - start_y;
-            double new_length = hypot (new_delta_x, new_delta_y);
-            if (new_length > EPSILON_MM && last_node->pen_down == segment.pen_down) {
-                double inv_new_len = 1.0 / new_length;
-                double new_unit_x = new_delta_x * inv_new_len;
-                double new_unit_y = new_delta_y * inv_new_len;
-                double dot
-                    = last_node->unit_vec[0] * new_unit_x + last_node->unit_vec[1] * new_unit_y;
-                if (dot > 1.0)
-                    dot = 1.0;
-                if (dot >= 0.999) {
-                    last_node->target[0] = segment.target_mm[0];
-                    last_node->target[1] = segment.target_mm[1];
-                    last_node->delta[0] = new_delta_x;
-                    last_node->delta[1] = new_delta_y;
-                    last_node->length_mm = new_length;
-                    last_node->unit_vec[0] = new_unit_x;
-                    last_node->unit_vec[1] = new_unit_y;
-                    double new_nominal
-                        = planner_clamp_positive (segment.feed_mm_s, g_limits.max_speed_mm_s);
-                    if (new_nominal > g_limits.max_speed_mm_s)
-                        new_nominal = g_limits.max_speed_mm_s;
-                    if (last_node->nominal_speed <= 0.0 || new_nominal < last_node->nominal_speed)
-                        last_node->nominal_speed = new_nominal;
-
-                    merged = true;
-                }
-            }
-        }
+/**
+ * @copydoc planner_stream_finish
+ */
+void planner_stream_finish (planner_stream_t *ps) {
+    if (!ps || ps->finished)
+        return;
+    ps->finished = true;
+    ps->dirty = true;
+}
+
+/** \brief Тіло `planner_pop_ready_block` без профілю. */
+static bool planner_pop_ready_block_run (planner_stream_t *ps, plan_block_t *out_block) {
+    if (!ps || !out_block || ps->count == 0)
+        return false;
+    planner_node_t *window = planner_stream_window (ps);
+    planner_lanes_t lanes = planner_stream_lanes (ps);
+    if (ps->dirty) {
+        ps->ready = planner_recompute_entry_exit_speeds (
+            &ps->limits, window, &lanes, ps->count, ps->head_entry2, !ps->finished);
+        ps->dirty = false;
+    }
+    if (ps->ready == 0) {
+        if (ps->count < ps->capacity)
+            return false;
+        /* Вікно заповнене: голова виходить зі швидкістю, що дозволяє зупинитися в його кінці. */
+        ps->ready = 1;
+    }
+
+    planner_node_to_block (
+        &ps->limits, &window[0], sqrt (lanes.entry2[0]), sqrt (lanes.exit2[0]), out_block);
+    ps->last_emitted = window[0];
+    ps->have_last_emitted = true;
+    --ps->count;
+    --ps->ready;
+    if (ps->count > 0) {
+        ++ps->head;
+        ps->head_entry2 = lanes.entry2[1];
+    } else {
+        ps->head = 0;
+    }
+    return true;
+}
+
+/**
+ * @copydoc planner_pop_ready_block
+ */
+bool planner_pop_ready_block (planner_stream_t *ps, plan_block_t *out_block) {
+    uint64_t t0 = ttime_stage_begin ();
+    bool ok = planner_pop_ready_block_run (ps, out_block);
+    ttime_stage_end (TTIME_STAGE_PLAN, t0);
+    if (ok)
+        ttime_count (TTIME_COUNT_BLOCKS, 1);
+    return ok;
+}
+
+/**
+ * @copydoc planner_stream_destroy
+ */
+void planner_stream_destroy (planner_stream_t *ps) {
+    if (!ps)
+        return;
+    free (ps->nodes);
+    free (ps->lanes.reach2);
+    free (ps);
+}
 
-        if (merged) {
-            current_pos[0] = segment.target_mm[0];
-            current_pos[1] = segment.target_mm[1];
-            continue;
+/**
+ * @brief Видає всі вузли завершеного вікна одним проходом (пакетне планування).
+ * @details Те саме, що `planner_pop_ready_block` до спорожнення вікна, але після одного
+ *          перерахунку; без ривка профілі рахує `planner_trapezoids2`.
+ * @param ps Планувальник після `planner_stream_finish`.
+ * @param blocks [out] Блоки (щонайменше `ps->count` елементів).
+ * @return Кількість виданих блоків.
+ */
+static size_t planner_stream_emit_all (planner_stream_t *ps, plan_block_t *blocks) {
+    const planner_limits_t *lim = &ps->limits;
+    const planner_node_t *nodes = planner_stream_window (ps);
+    planner_lanes_t lanes = planner_stream_lanes (ps);
+    size_t count = ps->count;
+    if (count == 0)
+        return 0;
+    planner_recompute_entry_exit_speeds (lim, nodes, &lanes, count, ps->head_entry2, false);
+    if (!(lim->max_jerk_mm_s3 > 0.0)) {
+        planner_trapezoids2 (lim, nodes, &lanes, count, blocks);
+    } else {
+        for (size_t i = 0; i < count; ++i)
+            planner_node_to_block (
+                lim, &nodes[i], sqrt (lanes.entry2[i]), sqrt (lanes.exit2[i]), &blocks[i]);
+    }
+    ps->last_emitted = nodes[count - 1];
+    ps->have_last_emitted = true;
+    ps->head = 0;
+    ps->count = 0;
+    ps->ready = 0;
+    ps->dirty = false;
+    return count;
+}
+
+/**
+ * @brief Контекст повторного планування.
+ * @details Єдиний стан, яким користуються розрахунки, — ліміти у вбудованому
+ *          планувальнику; буфери вузлів і блоків живуть між викликами.
+ */
+struct planner_ctx {
+    planner_stream_t stream; /**< Планувальник із буфером вузлів. */
+    plan_block_t *blocks;    /**< Буфер результатних блоків. */
+    size_t block_cap;        /**< Розмір `blocks`. */
+};
+
+/**
+ * @copydoc planner_ctx_create
+ */
+bool planner_ctx_create (const planner_limits_t *limits, planner_ctx_t **out_ctx) {
+    if (out_ctx)
+        *out_ctx = NULL;
+    if (!limits || !out_ctx) {
+        LOGE ("планувальник: некоректні параметри виклику");
+        return false;
+    }
+    if (!planner_limits_valid (limits))
+        return false;
+    planner_ctx_t *ctx = calloc (1, sizeof (*ctx));
+    if (!ctx) {
+        LOGE ("планувальник: неможливо виділити пам’ять під контекст");
+        return false;
+    }
+    ctx->stream.limits = *limits;
+    *out_ctx = ctx;
+    return true;
+}
+
+/**
+ * @copydoc planner_ctx_set_limits
+ */
+bool planner_ctx_set_limits (planner_ctx_t *ctx, const planner_limits_t *limits) {
+    if (!ctx || !limits) {
+        LOGE ("планувальник: некоректні параметри виклику");
+        return false;
+    }
+    if (!planner_limits_valid (limits))
+        return false;
+    ctx->stream.limits = *limits;
+    return true;
+}
+
+/**
+ * @brief Тіло `planner_ctx_plan` без профілю.
+ * @param ctx Контекст.
+ * @param start_position_mm Початкова позиція, мм (може бути `NULL`).
+ * @param segments Сегменти (непорожні).
+ * @param segment_count Кількість сегментів.
+ * @param out_count [out] Кількість блоків у `ctx->blocks`.
+ * @return true — успіх.
+ */
+static bool planner_ctx_plan_run (
+    planner_ctx_t *ctx,
+    const double start_position_mm[2],
+    const planner_segment_t *segments,
+    size_t segment_count,
+    size_t *out_count) {
+    /* Вікно на весь документ: межі входу й перерахунок — один раз після останнього сегмента. */
+    planner_stream_t *ps = &ctx->stream;
+    planner_limits_t limits = ps->limits;
+    if (!planner_stream_reset (
+            ps, &limits, start_position_mm, segment_count < 2 ? 2 : segment_count))
+        return false;
+    ps->batch_limits = true;
+    for (size_t i = 0; i < segment_count; ++i)
+        if (!planner_push_segment_run (ps, &segments[i]))
+            return false;
+    planner_stream_fill_entry_limits (ps);
+    planner_stream_finish (ps);
+
+    size_t node_count = ps->count;
+    if (node_count > ctx->block_cap) {
+        plan_block_t *grown = realloc (ctx->blocks, node_count * sizeof (*grown));
+        if (!grown) {
+            LOGE ("планувальник: неможливо виділити пам’ять під блоки");
+            return false;
         }
+        ctx->blocks = grown;
+        ctx->block_cap = node_count;
+    }
+    *out_count = planner_stream_emit_all (ps, ctx->blocks);
+    return true;
+}
 
-        planner_node_t node;
-        memset (&node, 0, sizeof (node));
-        node.target[0] = segment.target_mm[0];
-        node.target[1] = segment.target_mm[1];
-        node.delta[0] = delta[0];
-        node.delta[1] = delta[1];
-        node.length_mm = length_mm;
-        node.pen_down = segment.pen_down;
-
-        double inv_length = 1.0 / length_mm;
-        node.unit_vec[0] = delta[0] * inv_length;
-        node.unit_vec[1] = delta[1] * inv_length;
-
-        double nominal = planner_clamp_positive (segment.feed_mm_s, g_limits.max_speed_mm_s);
-        if (nominal > g_limits.max_speed_mm_s)
-            nominal = g_limits.max_speed_mm_s;
-        node.nominal_speed = nominal;
-        node.seq = ++next_seq;
-        node.max_entry_speed = 0.0;
-        node.entry_speed = 0.0;
-        node.exit_speed = 0.0;
-
-        planner_store_node (nodes, &node_count, node);
-
-        current_pos[0] = segment.target_mm[0];
-        current_pos[1] = segment.target_mm[1];
-    }
-
-    plan_block_t *blocks = calloc (node_count, sizeof (*blocks));
-    if (!blocks) {
-        free (nodes);
-        LOGE ("планувальник: неможливо виділити пам’ять під блоки");
+/**
+ * @copydoc planner_ctx_plan
+ */
+bool planner_ctx_plan (
+    planner_ctx_t *ctx,
+    const double start_position_mm[2],
+    const planner_segment_t *segments,
+    size_t segment_count,
+    const plan_block_t **out_blocks,
+    size_t *out_count) {
+    if (out_blocks)
+        *out_blocks = NULL;
+    if (out_count)
+        *out_count = 0;
+    if (!ctx || !segments || !out_blocks || !out_count) {
+        LOGE ("планувальник: некоректні параметри виклику");
         return false;
     }
+    if (segment_count == 0)
+        return true;
 
-    planner_compute_all_junction_limits (nodes, node_count);
-    planner_recompute_entry_exit_speeds (nodes, node_count);
+    uint64_t t0 = ttime_stage_begin ();
+    size_t produced = 0;
+    bool ok = planner_ctx_plan_run (ctx, start_position_mm, segments, segment_count, &produced);
+    ttime_stage_end (TTIME_STAGE_PLAN, t0);
+    if (!ok)
+        return false;
+    ttime_count (TTIME_COUNT_BLOCKS, produced);
 
-    for (size_t i = 0; i < node_count; ++i) {
-        const planner_node_t *node = &nodes[i];
-        plan_block_t *block = &blocks[i];
-        block->seq = node->seq;
-        block->delta_mm[0] = node->delta[0];
-        block->delta_mm[1] = node->delta[1];
-        block->length_mm = node->length_mm;
-        block->unit_vec[0] = node->unit_vec[0];
-        block->unit_vec[1] = node->unit_vec[1];
-        block->start_speed_mm_s = node->entry_speed;
-        block->end_speed_mm_s = node->exit_speed;
-        block->nominal_speed_mm_s = node->nominal_speed;
-        block->pen_down = node->pen_down;
+    *out_blocks = ctx->blocks;
+    *out_count = produced;
+    return true;
+}
 
-        planner_compute_trapezoid_profile (node, block);
+/**
+ * @copydoc planner_ctx_destroy
+ */
+void planner_ctx_destroy (planner_ctx_t *ctx) {
+    if (!ctx)
+        return;
+    free (ctx->stream.nodes);
+    free (ctx->stream.lanes.reach2);
+    free (ctx->blocks);
+    free (ctx);
+}
 
-#ifdef DEBUG
-        log_print (
-            LOG_DEBUG,
-            "планувальник: блок №%lu довжина=%.3f старт=%.3f кінець=%.3f крейсер=%.3f "
-            "a/c/d=%.3f/%.3f/%.3f перо=%d",
-            block->seq, block->length_mm, block->start_speed_mm_s, block->end_speed_mm_s,
-            block->cruise_speed_mm_s, block->accel_distance_mm, block->cruise_distance_mm,
-            block->decel_distance_mm, block->pen_down);
-#endif
+/**
+ * @copydoc planner_plan
+ */
+bool planner_plan (
+    const planner_limits_t *limits,
+    const double start_position_mm[2],
+    const planner_segment_t *segments,
+    size_t segment_count,
+    plan_block_t **out_blocks,
+    size_t *out_count) {
+    if (out_blocks)
+        *out_blocks = NULL;
+    if (out_count)
+        *out_count = 0;
+
+    if (!limits || !segments || !out_blocks || !out_count) {
+        LOGE ("планувальник: некоректні параметри виклику");
+        return false;
     }
+    if (!planner_limits_valid (limits))
+        return false;
 
-    free (nodes);
+    if (segment_count == 0) {
+        return true;
+    }
 
-    *out_blocks = blocks;
-    *out_count = node_count;
+    planner_ctx_t ctx = { .stream = { .limits = *limits } };
+    const plan_block_t *blocks = NULL;
+    size_t produced = 0;
+    bool ok = planner_ctx_plan (&ctx, start_position_mm, segments, segment_count, &blocks, &produced);
+    free (ctx.stream.nodes);
+    free (ctx.stream.lanes.reach2);
+    if (!ok) {
+        free (ctx.blocks);
+        return false;
+    }
+    if (!ctx.blocks) {
+        ctx.blocks = calloc (1, sizeof (*ctx.blocks));
+        if (!ctx.blocks) {
+            LOGE ("планувальник: неможливо виділити пам’ять під блоки");
+            return false;
+        }
+    }
+    *out_blocks = ctx.blocks;
+    *out_count = produced;
     return true;
 }
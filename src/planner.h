@@ -3,10 +3,15 @@
  * @brief Планування траєкторії руху з обмеженнями швидкості/прискорення.
  * @defgroup planner Планувальник
  * @details
- * Планувальник будує послідовність відрізків руху з урахуванням глобальних
- * лімітів (максимальні швидкість/прискорення, радіус заокруглення на стиках)
+ * Планувальник будує послідовність відрізків руху з урахуванням
+ * лімітів пристрою (максимальні швидкість/прискорення, радіус заокруглення на стиках)
  * і властивостей вхідних сегментів. На виході формується масив блоків із
- * профілями швидкості (трапеція/трикутник) для кожного сегмента.
+ * профілями швидкості (трапеція/трикутник) для кожного сегмента. З обмеженням ривка
+ * розгін і гальмування стають S‑подібними: прискорення наростає й спадає лінійно.
+ * Межі моторів CoreXY зменшують номінальну швидкість і прискорення блоку залежно від
+ * напрямку: уздовж осей працюють обидва мотори з швидкістю пера, а на діагоналі — один
+ * мотор у √2 разів швидше. Переїзди з піднятим пером не лишають сліду, тож мають власні
+ * межі швидкості й прискорення (`travel_*`); зміна стану пера завжди зупиняє каретку.
  */
 #ifndef CPLOT_PLANNER_H
 #define CPLOT_PLANNER_H
@@ -27,6 +32,17 @@ typedef struct {
     double cornering_distance_mm; /**< Ефективна довжина заокруглення на стиках, мм. 0 — жорстка
                                      зупинка. */
     double min_segment_mm;        /**< Мінімальна довжина сегмента; коротші можуть зливатися, мм. */
+    double chord_tolerance_mm;    /**< Допустиме відхилення хорди від штриха пера, мм. 0 — лише
+                                     злиття коротких колінеарних сегментів. */
+    double max_jerk_mm_s3;        /**< Обмеження ривка, мм/с³. 0 — трапецієвидні профілі. */
+    double max_motor_speed_mm_s;  /**< Межа швидкості кожного мотора CoreXY (A = X + Y,
+                                     B = X − Y), мм/с. 0 — без обмеження. */
+    double max_motor_accel_mm_s2; /**< Межа прискорення кожного мотора CoreXY, мм/с². 0 — без
+                                     обмеження. */
+    double travel_speed_mm_s;     /**< Межа швидкості переїздів з піднятим пером, мм/с. 0 — як
+                                     `max_speed_mm_s`. */
+    double travel_accel_mm_s2;    /**< Прискорення переїздів з піднятим пером, мм/с². 0 — як
+                                     `max_accel_mm_s2`. */
 } planner_limits_t;
 
 /**
@@ -51,6 +67,7 @@ typedef struct {
     double end_speed_mm_s;     /**< Швидкість у кінці сегмента, мм/с. */
     double nominal_speed_mm_s; /**< Номінальна (обмежена feed/лімітами) швидкість, мм/с. */
     double accel_mm_s2;        /**< Використане прискорення/гальмування, мм/с². */
+    double jerk_mm_s3;         /**< Ривок S‑подібних розгону/гальмування, мм/с³ (0 — трапеція). */
     double accel_distance_mm;  /**< Довжина розгону, мм. */
     double cruise_distance_mm; /**< Довжина крейсерської ділянки, мм. */
     double decel_distance_mm;  /**< Довжина гальмування, мм. */
@@ -76,6 +93,112 @@ bool planner_plan (
     plan_block_t **out_blocks,
     size_t *out_count);
 
+/**
+ * @brief Непрозорий контекст планування для повторних викликів.
+ * @details Містить ліміти та буфери вузлів і блоків, що переживають виклики
+ *          `planner_ctx_plan`: повторне планування документа не більшого розміру не
+ *          виділяє памʼяті. Спільного стану між контекстами немає, тож різні контексти
+ *          можна використовувати з різних потоків одночасно; один контекст — лише з
+ *          одного потоку за раз.
+ */
+typedef struct planner_ctx planner_ctx_t;
+
+/**
+ * @brief Створює контекст планування.
+ * @param limits Обмеження пристрою.
+ * @param out_ctx [out] Контекст (звільнити `planner_ctx_destroy`).
+ * @return true — успіх; false — некоректні ліміти або бракує памʼяті.
+ */
+bool planner_ctx_create (const planner_limits_t *limits, planner_ctx_t **out_ctx);
+
+/**
+ * @brief Замінює ліміти контексту для наступних планів.
+ * @param ctx Контекст.
+ * @param limits Нові обмеження.
+ * @return true — успіх; false — некоректні ліміти (попередні лишаються).
+ */
+bool planner_ctx_set_limits (planner_ctx_t *ctx, const planner_limits_t *limits);
+
+/**
+ * @brief Обчислює блоки руху, як `planner_plan`, у буферах контексту.
+ * @param ctx Контекст.
+ * @param start_position_mm Початкова позиція (X,Y) у мм; може бути `NULL` (0,0).
+ * @param segments Масив вхідних сегментів.
+ * @param segment_count Кількість елементів у `segments`.
+ * @param out_blocks [out] Блоки плану; належать контексту й дійсні до наступного
+ * `planner_ctx_plan` або `planner_ctx_destroy`.
+ * @param out_count [out] Кількість блоків.
+ * @return true — успіх; false — помилка параметрів або виділення памʼяті.
+ */
+bool planner_ctx_plan (
+    planner_ctx_t *ctx,
+    const double start_position_mm[2],
+    const planner_segment_t *segments,
+    size_t segment_count,
+    const plan_block_t **out_blocks,
+    size_t *out_count);
+
+/**
+ * @brief Звільняє контекст планування.
+ * @param ctx Контекст (може бути NULL).
+ */
+void planner_ctx_destroy (planner_ctx_t *ctx);
+
+/**
+ * @brief Непрозорий інкрементальний планувальник із вікном попереднього перегляду.
+ * @details Як буфер планувальника Grbl: сегменти додаються по одному, а блок
+ *          видається, щойно його швидкість виходу вже не може змінитися (наступний
+ *          вузол упирається у власну межу швидкості входу або зміну стану пера). Якщо
+ *          вікно заповнене раніше, найстаріший блок видається з розрахунку на зупинку
+ *          в кінці вікна. Памʼять — O(window).
+ */
+typedef struct planner_stream planner_stream_t;
+
+/**
+ * @brief Створює інкрементальний планувальник.
+ * @param limits Обмеження пристрою.
+ * @param start_position_mm Початкова позиція (X,Y) у мм; може бути `NULL` (0,0).
+ * @param window Розмір вікна у вузлах (≥ 2).
+ * @param out_stream [out] Планувальник (звільнити `planner_stream_destroy`).
+ * @return true — успіх; false — помилка параметрів або памʼяті.
+ */
+bool planner_stream_create (
+    const planner_limits_t *limits,
+    const double start_position_mm[2],
+    size_t window,
+    planner_stream_t **out_stream);
+
+/**
+ * @brief Додає сегмент до вікна (короткі колінеарні сегменти зливаються з останнім вузлом).
+ * @details Якщо `chord_tolerance_mm > 0`, сегменти з опущеним пером будь-якої довжини
+ *          складаються в хорду останнього вузла, поки відхилення не перевищує допуск.
+ * @param stream Планувальник.
+ * @param segment Вхідний сегмент.
+ * @return true — прийнято; false — вікно заповнене (спершу `planner_pop_ready_block`)
+ *         або вже викликано `planner_stream_finish`.
+ */
+bool planner_push_segment (planner_stream_t *stream, const planner_segment_t *segment);
+
+/**
+ * @brief Забирає наступний остаточний блок.
+ * @param stream Планувальник.
+ * @param out_block [out] Блок із профілем швидкості.
+ * @return true — блок видано; false — готових блоків поки немає.
+ */
+bool planner_pop_ready_block (planner_stream_t *stream, plan_block_t *out_block);
+
+/**
+ * @brief Позначає кінець вхідних сегментів: решта вікна плануються до зупинки.
+ * @param stream Планувальник.
+ */
+void planner_stream_finish (planner_stream_t *stream);
+
+/**
+ * @brief Звільняє інкрементальний планувальник.
+ * @param stream Планувальник (може бути NULL).
+ */
+void planner_stream_destroy (planner_stream_t *stream);
+
 #ifdef __cplusplus
 }
 #endif
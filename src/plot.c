@@ -6,36 +6,66 @@
 #include "plot.h"
 
 #include "axidraw.h"
+#include "checkpoint.h"
 #include "log.h"
+#include "planfile.h"
+#include "sim.h"
 #include "stepper.h"
+#include "str.h"
+#include "ttime.h"
 
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+/**
+ * @brief Конфігурація завдання: передана точкою входу або прочитана з файлу.
+ * @param config Конфігурація точки входу (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @param local [out] Сховище для прочитаної конфігурації.
+ * @return Конфігурація для завдання.
+ */
+static const config_t *
+plot_job_config (const config_t *config, const char *model, config_t *local) {
+    if (config)
+        return config;
+    if (config_load (local) != 0)
+        config_factory_defaults (local, (model && *model) ? model : CONFIG_DEFAULT_MODEL);
+    return local;
+}
 
 /**
  * @brief Заповнює налаштування AxiDraw із профілю моделі.
  *
- * Ініціалізує конфігурацію за замовчуванням для вказаної моделі, застосовує
- * профіль пристрою (швидкість/прискорення/розміри) і переносить релевантні
- * поля до `axidraw_settings_t`. Значення `steps_per_mm` встановлюється з
- * профілю; якщо воно невалідне (≤ 0), функція повертає `false`.
+ * Застосовує до конфігурації завдання профіль пристрою (швидкість/прискорення/
+ * розміри) і переносить релевантні поля до `axidraw_settings_t`. Параметри пера
+ * (положення, швидкості, затримки та їх перекриття з переїздом) беруться з
+ * конфігурації користувача; перекриття обмежується безпечною межею профілю.
+ * Значення `steps_per_mm` встановлюється з профілю; якщо воно невалідне (≤ 0),
+ * функція повертає `false`.
  *
+ * @param config Конфігурація завдання (`plot_job_config`).
  * @param model Ідентифікатор моделі (NULL — типова модель з CONFIG_DEFAULT_MODEL).
  * @param out [out] Місце призначення для налаштувань AxiDraw.
  * @return true — успіх; false — помилка або некоректний профіль (steps_per_mm ≤ 0).
  */
-static bool plot_load_settings (const char *model, axidraw_settings_t *out) {
-    if (!out)
+static bool
+plot_load_settings (const config_t *config, const char *model, axidraw_settings_t *out) {
+    if (!config || !out)
         return false;
     const char *model_id = (model && *model) ? model : CONFIG_DEFAULT_MODEL;
-    config_t cfg;
-    if (config_factory_defaults (&cfg, model_id) != 0)
-        return false;
+    config_t cfg = *config;
     const axidraw_device_profile_t *profile = axidraw_device_profile_for_model (model_id);
     axidraw_device_profile_apply (&cfg, profile);
     axidraw_settings_reset (out);
     out->pen_up_delay_ms = cfg.pen_up_delay_ms;
     out->pen_down_delay_ms = cfg.pen_down_delay_ms;
+    out->pen_lead_ms = cfg.pen_lead_ms;
+    if (profile && out->pen_lead_ms > profile->pen_lead_max_ms)
+        out->pen_lead_ms = profile->pen_lead_max_ms;
     out->pen_up_pos = cfg.pen_up_pos;
     out->pen_down_pos = cfg.pen_down_pos;
     out->pen_up_speed = cfg.pen_up_speed;
@@ -48,6 +78,352 @@ static bool plot_load_settings (const char *model, axidraw_settings_t *out) {
     return (out->steps_per_mm > 0.0);
 }
 
+/**
+ * @brief Найбільший проміжок між контурами, що долається без підйому пера.
+ * @details Береться з ключа конфігурації `pen_hop` і обмежується межею профілю моделі
+ *          (у межах гліфа чи слова, але не через пробіл між словами).
+ * @param config Конфігурація завдання.
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @return Проміжок, мм (0 — кожен перехід з підйомом пера).
+ */
+static double plot_pen_hop_mm (const config_t *config, const char *model) {
+    const char *model_id = (model && *model) ? model : CONFIG_DEFAULT_MODEL;
+    const axidraw_device_profile_t *profile = axidraw_device_profile_for_model (model_id);
+    double hop_mm = config->pen_hop_mm > 0.0 ? config->pen_hop_mm : 0.0;
+    if (profile && hop_mm > profile->pen_hop_max_mm)
+        hop_mm = profile->pen_hop_max_mm;
+    return hop_mm;
+}
+
+/** \brief Скільки останніх блоків сеанс памʼятає для точки відновлення (більше за конвеєр). */
+#define PLOT_CHECKPOINT_RING 256
+/** \brief Інтервал періодичного збереження точки відновлення, мс. */
+#define PLOT_CHECKPOINT_INTERVAL_MS 1000.0
+
+/**
+ * @brief Поданий блок: стан пера і початок штриха, до якого він належить.
+ */
+typedef struct {
+    unsigned long seq;        /**< Номер блоку. */
+    unsigned long stroke_seq; /**< Перший блок штриха з опущеним пером. */
+    bool pen_down;            /**< Стан пера блоку. */
+    bool used;                /**< Слот заповнено. */
+} plot_stroke_slot_t;
+
+/**
+ * @brief Сеанс виконання плану: пристрій (або імітація), крокувач і стан пера.
+ */
+typedef struct {
+    axidraw_device_t dev;   /**< Пристрій або локальна імітація для dry‑run. */
+    stepper_context_t sc;   /**< Контекст крокувача. */
+    bool dry_run;           /**< Імітація без підключення. */
+    bool connected;         /**< Чи встановлено зʼєднання з пристроєм. */
+    bool pen_is_up;         /**< Поточний стан пера. */
+    int lock_fd;            /**< Дескриптор lock‑файлу (-1 — не захоплено). */
+    int lift_overlap_ms;    /**< Наскільки раніше після підйому пера починається переїзд. */
+    int drop_overlap_ms;    /**< Наскільки раніше кінця переїзду опускається перо. */
+    bool merge_phases;      /**< Обʼєднувати фази руху в спільні LM (ключ `merge_phases`). */
+    plan_block_t pending;   /**< Переїзд, що чекає наступного блоку. */
+    bool have_pending;      /**< Чи є `pending`. */
+    bool finished;          /**< Усі блоки плану передано крокувачу. */
+    bool shared_port;       /**< Порт не вказано явно: точка відновлення — спільна для cplot. */
+    bool checkpointing;     /**< Зберігати точку відновлення (лише друк на пристрій). */
+    checkpoint_t checkpoint;                          /**< Відбиток завдання і стан. */
+    plot_stroke_slot_t strokes[PLOT_CHECKPOINT_RING]; /**< Останні подані блоки. */
+    unsigned long stroke_seq;                         /**< Початок поточного штриха. */
+    bool last_pen_down;                               /**< Стан пера останнього блоку. */
+    struct timespec checkpoint_at;                    /**< Час останнього збереження. */
+} plot_session_t;
+
+/**
+ * @brief Готує відкритий сеанс до нового завдання: скидає стан плану і крокувача.
+ * @details Підключення, lock і режим моторів лишаються; крокувач рахує кроки від
+ *          поточного положення каретки, як і після нового підключення.
+ */
+static void plot_session_begin_job (plot_session_t *session) {
+    session->pen_is_up = true;
+    session->have_pending = false;
+    session->finished = false;
+    session->checkpointing = false;
+    memset (&session->checkpoint, 0, sizeof (session->checkpoint));
+    memset (session->strokes, 0, sizeof (session->strokes));
+    session->stroke_seq = 0;
+    session->last_pen_down = false;
+    stepper_config_t scfg = { .dev = &session->dev, .merge_phases = session->merge_phases };
+    stepper_init (&session->sc, &scfg);
+}
+
+/**
+ * @brief Відкриває сеанс: у dry‑run — лише налаштування, інакше lock, підключення, мотори, перо.
+ * @param port Шлях до порту (NULL — автоматичний пошук, як раніше).
+ * @return 0 — успіх; 1 — помилка (ресурси звільнено).
+ */
+static int plot_session_open (
+    plot_session_t *session,
+    const config_t *config,
+    const char *model,
+    const char *port,
+    bool dry_run) {
+    memset (session, 0, sizeof (*session));
+    session->lock_fd = -1;
+    session->dry_run = dry_run;
+    session->pen_is_up = true;
+    session->shared_port = !(port && port[0]);
+
+    axidraw_settings_t settings;
+    if (!plot_load_settings (config, model, &settings))
+        return 1;
+    session->merge_phases = config->merge_phases != 0;
+    axidraw_device_init (&session->dev);
+    axidraw_apply_settings (&session->dev, &settings);
+    session->lift_overlap_ms = axidraw_pen_overlap_ms (&settings, true);
+    session->drop_overlap_ms = axidraw_pen_overlap_ms (&settings, false);
+
+    if (!dry_run) {
+        axidraw_device_config (&session->dev, port, 9600, 5000, settings.min_cmd_interval_ms);
+        (void)axidraw_device_resolve_port (&session->dev);
+        if (axidraw_device_lock_acquire_port (session->dev.port_path, &session->lock_fd) != 0) {
+            LOGE ("Пристрій %s вже використовується",
+                  session->dev.port_path[0] ? session->dev.port_path : "AxiDraw");
+            return 1;
+        }
+        char err[128];
+        if (axidraw_device_connect (&session->dev, err, sizeof (err)) != 0) {
+            LOGE ("Не вдалося підключитися до пристрою: %s", err);
+            axidraw_device_disconnect (&session->dev);
+            axidraw_device_lock_release (session->lock_fd);
+            return 1;
+        }
+        session->connected = true;
+        (void)axidraw_motors_set_mode (
+            &session->dev, AXIDRAW_MOTOR_STEP_16, AXIDRAW_MOTOR_STEP_16);
+        (void)axidraw_pen_up (&session->dev);
+        axidraw_set_pipelined (&session->dev, true);
+    }
+    plot_session_begin_job (session);
+    return 0;
+}
+
+/**
+ * @brief Вмикає точку відновлення для сеансу друку на пристрій.
+ * @param job Відбиток завдання.
+ * @param model Модель пристрою (NULL — типова).
+ * @param keep true — відновлений друк: стара точка лишається до першого підтвердження.
+ */
+static void plot_session_enable_checkpoint (
+    plot_session_t *session, uint64_t job, const char *model, bool keep) {
+    /* Файл точки відновлення один: його веде лише друк на типовий пристрій. */
+    if (session->dry_run || !session->shared_port)
+        return;
+    session->checkpointing = true;
+    session->checkpoint.job = job;
+    str_string_copy (session->checkpoint.model, sizeof (session->checkpoint.model), model);
+    clock_gettime (CLOCK_MONOTONIC, &session->checkpoint_at);
+    if (!keep)
+        checkpoint_clear ();
+}
+
+/**
+ * @brief Записує точку відновлення за останнім підтвердженим контролером блоком.
+ * @return true — збережено; false — нічого не підтверджено, блок забутий або помилка запису.
+ */
+static bool plot_session_checkpoint (plot_session_t *session) {
+    unsigned long tag;
+    if (!session->checkpointing || !axidraw_pipeline_acked_tag (&session->dev, &tag))
+        return false;
+    const plot_stroke_slot_t *slot = &session->strokes[tag % PLOT_CHECKPOINT_RING];
+    if (!slot->used || slot->seq != tag) {
+        LOGD ("plot: блок №%lu поза вікном точки відновлення", tag);
+        return false;
+    }
+    session->checkpoint.seq = tag;
+    session->checkpoint.pen_down = slot->pen_down;
+    /* Перерваний штрих повторюється з початку; після переїзду — наступний штрих. */
+    session->checkpoint.resume_seq = slot->pen_down ? slot->stroke_seq : tag;
+    return checkpoint_save (&session->checkpoint) == 0;
+}
+
+/**
+ * @brief Запамʼятовує блок для точки відновлення і періодично зберігає її.
+ */
+static void plot_session_track (plot_session_t *session, const plan_block_t *blk) {
+    if (!session->checkpointing)
+        return;
+    if (blk->pen_down && !session->last_pen_down)
+        session->stroke_seq = blk->seq;
+    session->last_pen_down = blk->pen_down;
+    plot_stroke_slot_t *slot = &session->strokes[blk->seq % PLOT_CHECKPOINT_RING];
+    slot->seq = blk->seq;
+    slot->stroke_seq = session->stroke_seq;
+    slot->pen_down = blk->pen_down;
+    slot->used = true;
+
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    if (time_diff_ms (&now, &session->checkpoint_at) >= PLOT_CHECKPOINT_INTERVAL_MS) {
+        (void)plot_session_checkpoint (session);
+        session->checkpoint_at = now;
+    }
+}
+
+/**
+ * @brief Подає команду пера (лише з пристроєм) і запамʼятовує новий стан.
+ * @details Відкладена фаза крокувача видається раніше: рух до зміни пера не обʼєднується
+ *          з рухом після неї.
+ * @param delay_ms Затримка перед наступною командою FIFO, мс.
+ * @return true — успіх; false — помилка відправлення відкладеної фази.
+ */
+static bool plot_session_pen (plot_session_t *session, bool pen_up, int delay_ms) {
+    if (!stepper_flush (&session->sc))
+        return false;
+    if (!session->dry_run) {
+        if (delay_ms < 0)
+            delay_ms = 0;
+        (void)axidraw_pen_set (&session->dev, pen_up, delay_ms);
+    }
+    session->pen_is_up = pen_up;
+    return true;
+}
+
+/**
+ * @brief Перемикає перо під стан блоку: підйом — зі скороченою на перекриття затримкою.
+ * @return true — успіх; false — помилка відправлення.
+ */
+static bool plot_session_pen_for (plot_session_t *session, const plan_block_t *blk) {
+    const axidraw_settings_t *settings = axidraw_device_settings (&session->dev);
+    bool drop = blk->pen_down && session->pen_is_up;
+    bool lift = !blk->pen_down && !session->pen_is_up;
+    if ((drop || lift) && !stepper_flush (&session->sc))
+        return false;
+    if (!session->dry_run)
+        axidraw_set_command_tag (&session->dev, blk->seq);
+    if (drop)
+        return plot_session_pen (session, false, settings->pen_down_delay_ms);
+    if (lift)
+        return plot_session_pen (
+            session, true, settings->pen_up_delay_ms - session->lift_overlap_ms);
+    return true;
+}
+
+/**
+ * @brief Виконує відкладений переїзд; перед малюванням перо опускається ще під час підходу.
+ * @details Останні `drop_overlap_ms` переїзду відокремлюються в окремий блок, а команда
+ *          опускання з відповідно скороченою затримкою стає в FIFO між частинами: від
+ *          команди пера до початку малювання минає повна затримка опускання.
+ * @param travel Блок переїзду (перо підняте).
+ * @param drop true — наступний блок малює.
+ * @return true — успіх; false — помилка відправлення.
+ */
+static bool plot_session_travel (plot_session_t *session, const plan_block_t *travel, bool drop) {
+    if (!plot_session_pen_for (session, travel))
+        return false;
+    if (!drop)
+        return stepper_submit_block (&session->sc, travel, session->dry_run);
+
+    const axidraw_settings_t *settings = axidraw_device_settings (&session->dev);
+    double overlap_s = session->drop_overlap_ms / 1000.0;
+    double travel_s = stepper_block_duration_s (travel);
+    plan_block_t head, tail;
+    if (stepper_split_block_tail (travel, overlap_s, &head, &tail)) {
+        if (!stepper_submit_block (&session->sc, &head, session->dry_run))
+            return false;
+        if (!plot_session_pen (
+                session, false, settings->pen_down_delay_ms - session->drop_overlap_ms))
+            return false;
+        return stepper_submit_block (&session->sc, &tail, session->dry_run);
+    }
+    /* Переїзд коротший за перекриття: перо опускається ще до його початку. */
+    int lead_ms = (int)(travel_s * 1000.0);
+    if (lead_ms > session->drop_overlap_ms)
+        lead_ms = session->drop_overlap_ms;
+    if (!plot_session_pen (session, false, settings->pen_down_delay_ms - lead_ms))
+        return false;
+    return stepper_submit_block (&session->sc, travel, session->dry_run);
+}
+
+/**
+ * @brief Перемикає перо за потреби та передає блок крокувачу.
+ * @details За ненульового перекриття опускання переїзд відкладається до наступного
+ *          блоку: лише тоді відомо, чи треба опускати перо в його кінці.
+ * @return true — успіх; false — помилка відправлення.
+ */
+static bool plot_session_submit (plot_session_t *session, const plan_block_t *blk) {
+    plot_session_track (session, blk);
+    if (session->have_pending) {
+        session->have_pending = false;
+        if (!plot_session_travel (session, &session->pending, blk->pen_down))
+            return false;
+    }
+    if (!blk->pen_down && session->drop_overlap_ms > 0) {
+        session->pending = *blk;
+        session->have_pending = true;
+        return true;
+    }
+    if (!plot_session_pen_for (session, blk))
+        return false;
+    return stepper_submit_block (&session->sc, blk, session->dry_run);
+}
+
+/** \brief Виконує відкладений переїзд і відкладену фазу крокувача в кінці плану. */
+static bool plot_session_flush (plot_session_t *session) {
+    if (session->have_pending) {
+        session->have_pending = false;
+        if (!plot_session_travel (session, &session->pending, false))
+            return false;
+    }
+    if (!stepper_flush (&session->sc))
+        return false;
+    session->finished = true;
+    LOGD (
+        "plot: команд руху=%lu, обʼєднано фаз=%lu", session->sc.commands,
+        session->sc.merged_phases);
+    return true;
+}
+
+/**
+ * @brief Завершує завдання: піднімає перо і чекає завершення руху (зʼєднання лишається).
+ * @details Після повного успішного виконання точка відновлення видаляється, інакше
+ *          зберігається за останнім підтвердженим блоком.
+ * @return 0 — усі команди підтверджено; 1 — контролер відхилив команду конвеєра.
+ */
+static int plot_session_end_job (plot_session_t *session) {
+    int status = 0;
+    if (session->connected) {
+        if (!session->pen_is_up)
+            (void)axidraw_pen_up (&session->dev);
+        if (axidraw_pipeline_sync (&session->dev) != 0)
+            status = 1;
+        if (session->checkpointing) {
+            if (status == 0 && session->finished)
+                checkpoint_clear ();
+            else if (plot_session_checkpoint (session))
+                LOGI (
+                    "Друк перервано; точку відновлення збережено (блок №%lu, штрих з №%lu). "
+                    "Поверніть каретку в початкову позицію і запустіть print --resume",
+                    session->checkpoint.seq, session->checkpoint.resume_seq);
+        }
+        (void)axidraw_wait_for_idle (&session->dev, 2000);
+        session->pen_is_up = true;
+    }
+    return status;
+}
+
+/**
+ * @brief Завершує завдання, відключається і звільняє lock.
+ * @return Як у `plot_session_end_job`.
+ */
+static int plot_session_close (plot_session_t *session) {
+    int status = plot_session_end_job (session);
+    if (session->connected) {
+        axidraw_device_disconnect (&session->dev);
+        session->connected = false;
+    }
+    if (!session->dry_run)
+        axidraw_device_lock_release (session->lock_fd);
+    session->lock_fd = -1;
+    return status;
+}
+
 /**
  * @brief Виконує послідовність блоків руху на пристрої або імітує (dry‑run).
  *
@@ -73,84 +449,685 @@ int plot_execute_plan (
     if (!blocks || count == 0)
         return 0;
 
-    if (dry_run) {
-        axidraw_settings_t settings;
-        if (!plot_load_settings (model, &settings))
-            return 1;
-        axidraw_device_t sim;
-        axidraw_device_init (&sim);
-        axidraw_apply_settings (&sim, &settings);
-        stepper_config_t scfg = { .dev = &sim };
-        stepper_context_t sc;
-        stepper_init (&sc, &scfg);
-        for (size_t i = 0; i < count; ++i) {
-            if (!stepper_submit_block (&sc, &blocks[i], true))
-                return 1;
+    config_t local;
+    const config_t *config = plot_job_config (NULL, model, &local);
+    plot_session_t session;
+    if (plot_session_open (&session, config, model, NULL, dry_run) != 0)
+        return 1;
+    int status = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!plot_session_submit (&session, &blocks[i])) {
+            status = 1;
+            break;
         }
+    }
+    if (status == 0 && !plot_session_flush (&session))
+        status = 1;
+    if (plot_session_close (&session) != 0)
+        status = 1;
+    return status;
+}
+
+/** \brief Ємність кільцевого буфера готових блоків між планувальником і пристроєм. */
+#define PLOT_STREAM_RING_CAPACITY 256
+/** \brief Розмір вікна попереднього перегляду інкрементального планувальника, вузлів. */
+#define PLOT_STREAM_LOOKAHEAD 256
+
+/**
+ * @brief Обмежений кільцевий буфер блоків (виробник — потік планування).
+ */
+typedef struct {
+    plan_block_t slots[PLOT_STREAM_RING_CAPACITY]; /**< Слоти блоків. */
+    size_t head;                                   /**< Індекс найстаршого блоку. */
+    size_t count;                                  /**< Кількість блоків у буфері. */
+    bool done;                                     /**< Виробник завершив роботу. */
+    bool failed;                                   /**< Виробник завершився з помилкою. */
+    bool cancelled;                                /**< Споживач припинив виконання. */
+    pthread_mutex_t lock;                          /**< Захищає поля вище. */
+    pthread_cond_t not_empty;                      /**< Сигнал: зʼявився блок або done. */
+    pthread_cond_t not_full;                       /**< Сигнал: звільнився слот або cancelled. */
+} plot_block_ring_t;
+
+/**
+ * @brief Стан потоку планування.
+ */
+typedef struct {
+    const canvas_layout_t *layout; /**< Джерело шляхів. */
+    planner_limits_t limits;       /**< Ліміти планувальника. */
+    double feed_mm_s;              /**< Швидкість подачі сегментів. */
+    double hop_mm;                 /**< Проміжок без підйому пера, мм. */
+    plot_block_ring_t *ring;       /**< Вихідний буфер. */
+} plot_stream_producer_t;
+
+/**
+ * @brief Кладе блок у буфер, очікуючи вільного слоту.
+ * @return true — блок покладено; false — споживач скасував виконання.
+ */
+static bool plot_ring_push (plot_block_ring_t *ring, const plan_block_t *block) {
+    pthread_mutex_lock (&ring->lock);
+    while (ring->count == PLOT_STREAM_RING_CAPACITY && !ring->cancelled)
+        pthread_cond_wait (&ring->not_full, &ring->lock);
+    bool accepted = !ring->cancelled;
+    if (accepted) {
+        ring->slots[(ring->head + ring->count) % PLOT_STREAM_RING_CAPACITY] = *block;
+        ring->count++;
+        pthread_cond_signal (&ring->not_empty);
+    }
+    pthread_mutex_unlock (&ring->lock);
+    return accepted;
+}
+
+/**
+ * @brief Забирає блок із буфера, очікуючи виробника.
+ * @return 0 — блок отримано; 1 — блоків більше не буде; -1 — виробник завершився помилкою.
+ */
+static int plot_ring_pop (plot_block_ring_t *ring, plan_block_t *out) {
+    pthread_mutex_lock (&ring->lock);
+    while (ring->count == 0 && !ring->done)
+        pthread_cond_wait (&ring->not_empty, &ring->lock);
+    int rc;
+    if (ring->failed) {
+        rc = -1;
+    } else if (ring->count == 0) {
+        rc = 1;
+    } else {
+        *out = ring->slots[ring->head];
+        ring->head = (ring->head + 1) % PLOT_STREAM_RING_CAPACITY;
+        ring->count--;
+        pthread_cond_signal (&ring->not_full);
+        rc = 0;
+    }
+    pthread_mutex_unlock (&ring->lock);
+    return rc;
+}
+
+/** \brief Позначає завершення виробника (успішне чи ні) і будить споживача. */
+static void plot_ring_finish (plot_block_ring_t *ring, bool failed) {
+    pthread_mutex_lock (&ring->lock);
+    ring->done = true;
+    ring->failed = failed;
+    pthread_cond_broadcast (&ring->not_empty);
+    pthread_mutex_unlock (&ring->lock);
+}
+
+/** \brief Скасовує виробника з боку споживача. */
+static void plot_ring_cancel (plot_block_ring_t *ring) {
+    pthread_mutex_lock (&ring->lock);
+    ring->cancelled = true;
+    pthread_cond_broadcast (&ring->not_full);
+    pthread_mutex_unlock (&ring->lock);
+}
+
+/**
+ * @brief Передає у буфер усі блоки, які планувальник уже вважає остаточними.
+ * @return true — успіх; false — споживач скасував виконання.
+ */
+static bool plot_stream_drain (planner_stream_t *planner, plot_block_ring_t *ring) {
+    plan_block_t block;
+    while (planner_pop_ready_block (planner, &block)) {
+        if (!plot_ring_push (ring, &block))
+            return false;
+    }
+    return true;
+}
+
+/** \brief Точка входу потоку планування: сегменти → інкрементальний планувальник → буфер. */
+static void *plot_stream_producer_main (void *arg) {
+    plot_stream_producer_t *prod = (plot_stream_producer_t *)arg;
+    canvas_segment_iter_t it;
+    planner_stream_t *planner = NULL;
+    bool ok = (canvas_segment_iter_init (&it, prod->layout, prod->feed_mm_s) == 0)
+              && planner_stream_create (&prod->limits, it.start_mm, PLOT_STREAM_LOOKAHEAD, &planner);
+    it.hop_mm = prod->hop_mm;
+    planner_segment_t segment;
+    while (ok && canvas_segment_iter_next (&it, &segment) == 0)
+        ok = planner_push_segment (planner, &segment) && plot_stream_drain (planner, prod->ring);
+    if (ok) {
+        planner_stream_finish (planner);
+        ok = plot_stream_drain (planner, prod->ring);
+    }
+    if (it.hops > 0)
+        LOGD ("plot: проміжків без підйому пера=%zu (≤ %.2f мм)", it.hops, it.hop_mm);
+    planner_stream_destroy (planner);
+    plot_ring_finish (prod->ring, !ok);
+    return NULL;
+}
+
+/**
+ * @brief Відбиток завдання для точки відновлення.
+ * @details Координати квантуються до 1 мкм; ліміти входять повністю, бо від них залежить
+ *          розбиття на блоки, а отже й номери блоків.
+ */
+static uint64_t plot_job_fingerprint (
+    const canvas_layout_t *layout, const planner_limits_t *limits, const char *model) {
+    uint64_t hash = STR_FNV1A_OFFSET;
+    for (size_t i = 0; i < layout->paths_mm.len; ++i) {
+        const geom_path_t *path = &layout->paths_mm.items[i];
+        uint64_t len = path->len;
+        hash = str_fnv1a (hash, &len, sizeof (len));
+        for (size_t j = 0; j < path->len; ++j) {
+            int64_t q[2] = { llround (path->pts[j].x * 1000.0), llround (path->pts[j].y * 1000.0) };
+            hash = str_fnv1a (hash, q, sizeof (q));
+        }
+    }
+    double lim[] = { limits->max_speed_mm_s,        limits->max_accel_mm_s2,
+                     limits->cornering_distance_mm, limits->min_segment_mm,
+                     limits->chord_tolerance_mm,    limits->max_jerk_mm_s3,
+                     limits->max_motor_speed_mm_s,  limits->max_motor_accel_mm_s2,
+                     limits->travel_speed_mm_s,     limits->travel_accel_mm_s2 };
+    hash = str_fnv1a (hash, lim, sizeof (lim));
+    if (model)
+        hash = str_fnv1a (hash, model, strlen (model));
+    return hash;
+}
+
+/**
+ * @brief Стан пропуску вже надрукованих блоків під час відновлення.
+ */
+typedef struct {
+    bool active;             /**< Ще пропускаємо блоки. */
+    unsigned long from_seq;  /**< Номер блоку, з якого продовжувати. */
+    double pos_mm[2];        /**< Позиція після пропущених блоків. */
+    unsigned long skipped;   /**< Пропущено блоків. */
+} plot_resume_t;
+
+/**
+ * @brief Читає точку відновлення і перевіряє, що вона належить цьому завданню.
+ * @return true — можна продовжувати; false — немає точки або вона чужа (у журналі).
+ */
+static bool plot_resume_begin (
+    plot_resume_t *resume, uint64_t job, const double start_mm[2], checkpoint_t *out) {
+    int rc = checkpoint_load (out);
+    if (rc == 1) {
+        LOGE ("Немає точки відновлення: перерваного друку не знайдено");
+        return false;
+    }
+    if (rc != 0)
+        return false;
+    if (out->job != job) {
+        LOGE (
+            "Точка відновлення належить іншому завданню (інший документ, параметри "
+            "розкладки, профіль руху чи модель)");
+        return false;
+    }
+    resume->active = true;
+    resume->from_seq = out->resume_seq;
+    resume->pos_mm[0] = start_mm[0];
+    resume->pos_mm[1] = start_mm[1];
+    LOGI (
+        "Відновлення друку: підтверджено блок №%lu (перо %s), продовження зі штриха №%lu",
+        out->seq, out->pen_down ? "опущене" : "підняте", out->resume_seq);
+    return true;
+}
+
+/**
+ * @brief Пропускає надруковані блоки; на першому ненадрукованому штриху подає переїзд.
+ * @details Штрих починається з блоку з опущеним пером після піднятого: там швидкість
+ *          нульова, тож план з цього блоку виконується без змін. Переїзд з піднятим пером
+ *          від початкової позиції плану планується окремо і має номер першого блоку штриха.
+ * @param block Черговий блок плану.
+ * @param start_mm Початкова позиція плану (де стоїть каретка).
+ * @return 1 — блок пропущено; 0 — блок виконувати; -1 — помилка переїзду.
+ */
+static int plot_resume_filter (
+    plot_resume_t *resume,
+    plot_session_t *session,
+    const planner_limits_t *limits,
+    const double start_mm[2],
+    const plan_block_t *block) {
+    if (!resume->active)
         return 0;
+    if (block->seq < resume->from_seq || !block->pen_down) {
+        resume->pos_mm[0] += block->delta_mm[0];
+        resume->pos_mm[1] += block->delta_mm[1];
+        ++resume->skipped;
+        return 1;
     }
+    resume->active = false;
+    LOGI (
+        "Пропущено надрукованих блоків: %lu; переїзд до (%.2f, %.2f) мм", resume->skipped,
+        resume->pos_mm[0], resume->pos_mm[1]);
+    planner_segment_t travel = {
+        .target_mm = { resume->pos_mm[0], resume->pos_mm[1] },
+        .feed_mm_s = 0.0, /* Межа переїздів планувальника. */
+        .pen_down = false,
+    };
+    plan_block_t *blocks = NULL;
+    size_t count = 0;
+    if (!planner_plan (limits, start_mm, &travel, 1, &blocks, &count))
+        return -1;
+    int rc = 0;
+    for (size_t i = 0; i < count && rc == 0; ++i) {
+        blocks[i].seq = block->seq;
+        if (!plot_session_submit (session, &blocks[i]))
+            rc = -1;
+    }
+    free (blocks);
+    return rc;
+}
 
-    int lock_fd = -1;
-    if (axidraw_device_lock_acquire (&lock_fd) != 0)
+/**
+ * @brief Спільна частина `plot_stream_layout` і `plot_hold_stream`.
+ * @param config Конфігурація завдання (`plot_job_config`).
+ * @param held Відкритий сеанс (NULL — відкрити власний паралельно з плануванням і
+ *             закрити після завдання).
+ */
+static int plot_stream_run (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    bool dry_run,
+    bool resume,
+    plot_session_t *held) {
+    if (!layout)
+        return 1;
+    if (layout->paths_mm.len == 0)
+        return 0;
+
+    plot_stream_producer_t prod;
+    memset (&prod, 0, sizeof (prod));
+    prod.layout = layout;
+    if (canvas_default_motion_limits (&prod.limits, &prod.feed_mm_s) != 0)
+        return 1;
+    if (limits)
+        prod.limits = *limits;
+    prod.hop_mm = plot_pen_hop_mm (config, model);
+
+    uint64_t job = plot_job_fingerprint (layout, &prod.limits, model);
+    LOGD ("plot: відбиток завдання %016" PRIx64, job);
+    canvas_segment_iter_t origin;
+    if (canvas_segment_iter_init (&origin, layout, prod.feed_mm_s) != 0)
+        return 1;
+    plot_resume_t skip = { 0 };
+    checkpoint_t saved;
+    if (resume && !plot_resume_begin (&skip, job, origin.start_mm, &saved))
+        return 1;
+    plot_block_ring_t *ring = (plot_block_ring_t *)calloc (1, sizeof (*ring));
+    if (!ring)
         return 1;
+    pthread_mutex_init (&ring->lock, NULL);
+    pthread_cond_init (&ring->not_empty, NULL);
+    pthread_cond_init (&ring->not_full, NULL);
+    prod.ring = ring;
 
+    pthread_t producer;
+    if (pthread_create (&producer, NULL, plot_stream_producer_main, &prod) != 0) {
+        LOGE ("Не вдалося запустити потік планування");
+        free (ring);
+        return 1;
+    }
+
+    /* Підключення до пристрою відбувається паралельно з плануванням перших ділянок. */
     int status = 0;
-    axidraw_settings_t settings;
-    if (!plot_load_settings (model, &settings)) {
+    plot_session_t own;
+    plot_session_t *session = held ? held : &own;
+    bool session_open;
+    if (held) {
+        plot_session_begin_job (held);
+        session_open = true;
+    } else {
+        session_open = (plot_session_open (&own, config, model, NULL, dry_run) == 0);
+    }
+    if (!session_open)
         status = 1;
-        goto cleanup;
+    else
+        plot_session_enable_checkpoint (session, job, model, resume);
+
+    unsigned long submitted = 0;
+    plan_block_t block;
+    while (session_open) {
+        int rc = plot_ring_pop (ring, &block);
+        if (rc == 1) {
+            if (!plot_session_flush (session))
+                status = 1;
+            break;
+        }
+        if (rc < 0) {
+            LOGE ("Помилка планування траєкторії");
+            status = 1;
+            break;
+        }
+        int skip_rc = plot_resume_filter (&skip, session, &prod.limits, origin.start_mm, &block);
+        if (skip_rc == 1)
+            continue;
+        if (skip_rc < 0 || !plot_session_submit (session, &block)) {
+            status = 1;
+            break;
+        }
+        ++submitted;
     }
+    if (status == 0 && skip.active)
+        LOGW ("Точка відновлення — після останнього штриха: друкувати нічого");
+    plot_ring_cancel (ring);
+    pthread_join (producer, NULL);
+    if (session_open && (held ? plot_session_end_job (held) : plot_session_close (&own)) != 0)
+        status = 1;
+    LOGD ("plot: потоково виконано блоків=%lu", submitted);
 
-    axidraw_device_t dev;
-    axidraw_device_init (&dev);
-    axidraw_apply_settings (&dev, &settings);
-    axidraw_device_config (&dev, NULL, 9600, 5000, settings.min_cmd_interval_ms);
+    pthread_cond_destroy (&ring->not_full);
+    pthread_cond_destroy (&ring->not_empty);
+    pthread_mutex_destroy (&ring->lock);
+    free (ring);
+    return status;
+}
 
-    char err[128];
-    if (axidraw_device_connect (&dev, err, sizeof (err)) != 0) {
-        LOGE ("Не вдалося підключитися до пристрою: %s", err);
-        status = 1;
-        goto cleanup_dev;
+/**
+ * @copydoc plot_stream_layout
+ */
+int plot_stream_layout (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    bool dry_run,
+    bool resume,
+    bool verbose) {
+    (void)verbose;
+    config_t local;
+    config = plot_job_config (config, model, &local);
+    return plot_stream_run (layout, limits, config, model, dry_run, resume, NULL);
+}
+
+/**
+ * @brief Утримуваний сеанс: зʼєднання, lock і режим моторів між завданнями.
+ */
+struct plot_hold {
+    plot_session_t session; /**< Сеанс (адреса стабільна: крокувач посилається на `dev`). */
+    config_t config;        /**< Конфігурація завдань сеансу. */
+    char model[64];         /**< Модель пристрою (порожньо — типова). */
+    char port[256];         /**< Порт (порожньо — автоматичний пошук). */
+    bool dry_run;           /**< Імітація без підключення. */
+    bool open;              /**< Сеанс відкрито. */
+};
+
+/** \brief Модель утримуваного сеансу для функцій, що приймають NULL як типову. */
+static const char *plot_hold_model (const plot_hold_t *hold) {
+    return hold->model[0] ? hold->model : NULL;
+}
+
+/**
+ * @copydoc plot_hold_open
+ */
+int plot_hold_open (
+    plot_hold_t **out, const config_t *config, const char *model, const char *port, bool dry_run) {
+    if (!out)
+        return 1;
+    *out = NULL;
+    plot_hold_t *hold = (plot_hold_t *)calloc (1, sizeof (*hold));
+    if (!hold)
+        return 1;
+    str_string_copy (hold->model, sizeof (hold->model), model ? model : "");
+    str_string_copy (hold->port, sizeof (hold->port), port ? port : "");
+    hold->dry_run = dry_run;
+    config_t local;
+    hold->config = *plot_job_config (config, model, &local);
+    if (plot_session_open (
+            &hold->session, &hold->config, plot_hold_model (hold), hold->port, dry_run)
+        != 0) {
+        free (hold);
+        return 1;
     }
+    hold->open = true;
+    *out = hold;
+    return 0;
+}
 
-    (void)axidraw_motors_set_mode (&dev, AXIDRAW_MOTOR_STEP_16, AXIDRAW_MOTOR_STEP_16);
-    (void)axidraw_pen_up (&dev);
+/**
+ * @copydoc plot_hold_stream
+ */
+int plot_hold_stream (
+    plot_hold_t *hold, const canvas_layout_t *layout, const planner_limits_t *limits) {
+    if (!hold || !layout)
+        return 1;
+    const char *model = plot_hold_model (hold);
+    if (!hold->open) {
+        LOGI ("Повторне підключення до пристрою");
+        if (plot_session_open (&hold->session, &hold->config, model, hold->port, hold->dry_run)
+            != 0)
+            return 1;
+        hold->open = true;
+    }
+    int status = plot_stream_run (
+        layout, limits, &hold->config, model, hold->dry_run, false, &hold->session);
+    if (status != 0 && !hold->dry_run) {
+        /* Стан контролера після збою невідомий: наступне завдання підключиться заново. */
+        (void)plot_session_close (&hold->session);
+        hold->open = false;
+    }
+    return status;
+}
 
-    stepper_config_t scfg = { .dev = &dev };
-    stepper_context_t sc;
-    stepper_init (&sc, &scfg);
-    bool pen_is_up = true;
-    for (size_t i = 0; i < count; ++i) {
-        const plan_block_t *blk = &blocks[i];
-        if (blk->pen_down && pen_is_up) {
-            (void)axidraw_pen_down (&dev);
-            pen_is_up = false;
-        } else if (!blk->pen_down && !pen_is_up) {
-            (void)axidraw_pen_up (&dev);
-            pen_is_up = true;
-        }
-        if (!stepper_submit_block (&sc, blk, false)) {
+/**
+ * @copydoc plot_hold_close
+ */
+void plot_hold_close (plot_hold_t *hold) {
+    if (!hold)
+        return;
+    if (hold->open)
+        (void)plot_session_close (&hold->session);
+    free (hold);
+}
+
+/**
+ * @brief Споживач блоків синхронного планування.
+ * @return true — продовжити; false — зупинити планування з помилкою.
+ */
+typedef bool (*plot_block_fn) (void *ctx, const plan_block_t *block);
+
+/**
+ * @brief Планує розкладку і передає блоки споживачу без потоків і журналів на блок.
+ * @return true — успіх; false — помилка планування або споживача.
+ */
+static bool plot_plan_blocks (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    double feed_mm_s,
+    double hop_mm,
+    plot_block_fn consume,
+    void *ctx) {
+    canvas_segment_iter_t it;
+    planner_stream_t *planner = NULL;
+    bool ok = (canvas_segment_iter_init (&it, layout, feed_mm_s) == 0)
+              && planner_stream_create (limits, it.start_mm, PLOT_STREAM_LOOKAHEAD, &planner);
+    it.hop_mm = hop_mm;
+    planner_segment_t segment;
+    plan_block_t block;
+    while (ok && canvas_segment_iter_next (&it, &segment) == 0) {
+        ok = planner_push_segment (planner, &segment);
+        while (ok && planner_pop_ready_block (planner, &block))
+            ok = consume (ctx, &block);
+    }
+    if (ok) {
+        planner_stream_finish (planner);
+        while (ok && planner_pop_ready_block (planner, &block))
+            ok = consume (ctx, &block);
+    }
+    planner_stream_destroy (planner);
+    return ok;
+}
+
+/** \brief Споживач блоків для оцінки тривалості. */
+static bool plot_sim_consume (void *ctx, const plan_block_t *block) {
+    sim_add_block ((sim_stats_t *)ctx, block);
+    return true;
+}
+
+/** \brief Завершує імітацію і друкує підсумок JSON. @return 0 — успіх; 1 — помилка запису. */
+static int plot_estimate_report (sim_stats_t *stats, FILE *out) {
+    sim_finish (stats);
+    LOGD ("plot: оцінено блоків=%lu, тривалість≈%.1f с", stats->blocks, sim_total_s (stats));
+    if (sim_write_json (stats, out) != 0) {
+        LOGE ("Не вдалося записати оцінку тривалості");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @copydoc plot_estimate_layout
+ */
+int plot_estimate_layout (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    FILE *out) {
+    if (!layout || !out)
+        return 1;
+
+    planner_limits_t lim;
+    double feed_mm_s = 0.0;
+    if (canvas_default_motion_limits (&lim, &feed_mm_s) != 0)
+        return 1;
+    if (limits)
+        lim = *limits;
+    config_t local;
+    config = plot_job_config (config, model, &local);
+    axidraw_settings_t settings;
+    if (!plot_load_settings (config, model, &settings))
+        return 1;
+
+    sim_stats_t stats;
+    sim_init (&stats, &settings, fmax (lim.max_speed_mm_s, lim.travel_speed_mm_s));
+    double hop_mm = plot_pen_hop_mm (config, model);
+    if (layout->paths_mm.len > 0
+        && !plot_plan_blocks (layout, &lim, feed_mm_s, hop_mm, plot_sim_consume, &stats)) {
+        LOGE ("Помилка планування траєкторії");
+        return 1;
+    }
+    return plot_estimate_report (&stats, out);
+}
+
+/** \brief Споживач блоків для запису у файл плану. */
+static bool plot_file_consume (void *ctx, const plan_block_t *block) {
+    return planfile_write_block ((planfile_writer_t *)ctx, block) == 0;
+}
+
+/**
+ * @copydoc plot_save_layout
+ */
+int plot_save_layout (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    const char *path) {
+    if (!layout || !path)
+        return 1;
+
+    planner_limits_t lim;
+    double feed_mm_s = 0.0;
+    if (canvas_default_motion_limits (&lim, &feed_mm_s) != 0)
+        return 1;
+    if (limits)
+        lim = *limits;
+    canvas_segment_iter_t it;
+    if (canvas_segment_iter_init (&it, layout, feed_mm_s) != 0)
+        return 1;
+    config_t local;
+    double hop_mm = plot_pen_hop_mm (plot_job_config (config, model, &local), model);
+
+    planfile_info_t info = { .start_mm = { it.start_mm[0], it.start_mm[1] },
+                             .max_speed_mm_s = fmax (lim.max_speed_mm_s, lim.travel_speed_mm_s) };
+    str_string_copy (info.model, sizeof (info.model), model ? model : "");
+    planfile_writer_t writer;
+    if (planfile_writer_open (&writer, path, &info) != 0) {
+        LOGE ("Не вдалося створити файл плану: %s", path);
+        return 1;
+    }
+    bool planned = layout->paths_mm.len == 0
+                   || plot_plan_blocks (
+                       layout, &lim, feed_mm_s, hop_mm, plot_file_consume, &writer);
+    int rc = planfile_writer_close (&writer);
+    if (!planned || rc != 0) {
+        if (planned)
+            LOGE ("Не вдалося записати файл плану: %s", path);
+        else
+            LOGE ("Помилка планування траєкторії");
+        remove (path);
+        return 1;
+    }
+    unsigned long blocks = (unsigned long)writer.info.block_count;
+    LOGI (
+        "План збережено: %s (блоків %lu, %.1f КіБ, %.1f байт/блок)", path, blocks,
+        (double)writer.data_size / 1024.0,
+        blocks > 0 ? (double)writer.data_size / (double)blocks : 0.0);
+    return 0;
+}
+
+/**
+ * @copydoc plot_replay_plan
+ */
+int plot_replay_plan (
+    planfile_reader_t *plan,
+    const config_t *config,
+    const char *model,
+    bool dry_run,
+    bool verbose) {
+    (void)verbose;
+    if (!plan)
+        return 1;
+    if (plan->info.block_count == 0)
+        return 0;
+
+    config_t local;
+    config = plot_job_config (config, model, &local);
+    plot_session_t session;
+    if (plot_session_open (&session, config, model, NULL, dry_run) != 0)
+        return 1;
+    int status = 0;
+    plan_block_t block;
+    int rc;
+    while ((rc = planfile_read_block (plan, &block)) > 0) {
+        if (!plot_session_submit (&session, &block)) {
             status = 1;
             break;
         }
     }
-    if (!pen_is_up)
-        (void)axidraw_pen_up (&dev);
-    (void)axidraw_wait_for_idle (&dev, 2000);
-
-cleanup_dev:
-    axidraw_device_disconnect (&dev);
-cleanup:
-    axidraw_device_lock_release (lock_fd);
+    if (rc < 0) {
+        LOGE ("Файл плану пошкоджено (блок %lu)", (unsigned long)plan->decoded + 1);
+        status = 1;
+    }
+    if (status == 0 && !plot_session_flush (&session))
+        status = 1;
+    if (plot_session_close (&session) != 0)
+        status = 1;
+    LOGD ("plot: повторено блоків=%lu", (unsigned long)plan->decoded);
     return status;
 }
 
+/**
+ * @copydoc plot_estimate_plan
+ */
+int plot_estimate_plan (
+    planfile_reader_t *plan, const config_t *config, const char *model, FILE *out) {
+    if (!plan || !out)
+        return 1;
+    config_t local;
+    axidraw_settings_t settings;
+    if (!plot_load_settings (plot_job_config (config, model, &local), model, &settings))
+        return 1;
+    sim_stats_t stats;
+    double speed_limit = plan->info.max_speed_mm_s > 0.0 ? plan->info.max_speed_mm_s
+                                                         : settings.speed_mm_s;
+    sim_init (&stats, &settings, speed_limit);
+    plan_block_t block;
+    int rc;
+    while ((rc = planfile_read_block (plan, &block)) > 0)
+        sim_add_block (&stats, &block);
+    if (rc < 0) {
+        LOGE ("Файл плану пошкоджено (блок %lu)", (unsigned long)plan->decoded + 1);
+        return 1;
+    }
+    return plot_estimate_report (&stats, out);
+}
+
 /**
  * @brief Генерує план руху з макета полотна та виконує його (або dry‑run).
  *
- * Викликає `canvas_generate_motion_plan()` для отримання блоків руху з
- * нормалізованих шляхів полотна, далі делегує виконання у `plot_execute_plan()`.
- * Відповідальність за звільнення памʼяті блокується всередині цієї функції.
+ * Делегує у `plot_stream_layout()` з типовими лімітами профілю: блоки плануються
+ * у фоновому потоці й виконуються в міру готовності.
  *
  * @param layout Макет полотна (кінцеві шляхи у мм).
  * @param model Ідентифікатор моделі (NULL — типова).
@@ -160,14 +1137,5 @@ cleanup:
  */
 int plot_canvas_execute (
     const canvas_layout_t *layout, const char *model, bool dry_run, bool verbose) {
-    (void)verbose;
-    if (!layout)
-        return 1;
-    plan_block_t *blocks = NULL;
-    size_t count = 0;
-    if (canvas_generate_motion_plan (layout, NULL, &blocks, &count) != 0)
-        return 1;
-    int rc = plot_execute_plan (blocks, count, model, dry_run, verbose);
-    free (blocks);
-    return rc;
+    return plot_stream_layout (layout, NULL, NULL, model, dry_run, false, verbose);
 }
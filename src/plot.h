@@ -7,8 +7,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 
 #include "canvas.h"
+#include "config.h"
+#include "planfile.h"
 #include "planner.h"
 
 #ifdef __cplusplus
@@ -27,6 +30,137 @@ extern "C" {
 int plot_execute_plan (
     const plan_block_t *blocks, size_t count, const char *model, bool dry_run, bool verbose);
 
+/**
+ * @brief Планує та виконує розкладку потоково (виробник/споживач).
+ * @details Потік планування обходить шляхи макета, передає сегменти інкрементальному
+ *          планувальнику з фіксованим вікном (`planner_push_segment`) і кладе остаточні
+ *          блоки в обмежений кільцевий буфер; поточний потік паралельно підключається до пристрою та
+ *          передає блоки у `stepper_submit_block`. Перший рух не чекає планування
+ *          всього документа, а памʼять не залежить від його розміру.
+ *
+ *          Під час друку на пристрій зберігається точка відновлення (`checkpoint.h`). З
+ *          `resume` блоки до збереженого штриха лише плануються, каретка з початкової
+ *          позиції плану переїжджає з піднятим пером до початку штриха, і друк триває
+ *          звідти з тими самими номерами блоків.
+ * @param layout Розкладка з фінальними шляхами у мм.
+ * @param limits Ліміти планувальника (NULL — з профілю).
+ * @param config Конфігурація завдання (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @param dry_run true — без підключення; лише обчислення.
+ * @param resume true — продовжити перерваний друк із точки відновлення.
+ * @param verbose true — докладні журнали.
+ * @return 0 — успіх; 1 — помилка планування або виконання, немає точки відновлення або
+ *         вона належить іншому завданню.
+ */
+int plot_stream_layout (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    bool dry_run,
+    bool resume,
+    bool verbose);
+
+/**
+ * @brief Сеанс пристрою, що лишається відкритим між завданнями (`cplot serve`).
+ * @details Lock, підключення і режим моторів встановлюються один раз; кожне завдання
+ *          лише планується і виконується. Після збою виконання зʼєднання закривається, а
+ *          наступне завдання підключається заново.
+ */
+typedef struct plot_hold plot_hold_t;
+
+/**
+ * @brief Відкриває утримуваний сеанс.
+ * @param out [out] Сеанс (звільнити `plot_hold_close`).
+ * @param config Конфігурація завдань сеансу (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @param port Шлях до порту (NULL — автоматичний пошук). Lock захоплюється на цей порт;
+ *             точка відновлення ведеться лише без явного порту.
+ * @param dry_run true — без підключення до пристрою.
+ * @return 0 — успіх; 1 — пристрій зайнятий, недоступний або брак памʼяті.
+ */
+int plot_hold_open (
+    plot_hold_t **out, const config_t *config, const char *model, const char *port, bool dry_run);
+
+/**
+ * @brief Планує та виконує розкладку в утримуваному сеансі (як `plot_stream_layout`).
+ * @details Кроки рахуються від положення, де каретка зупинилась після попереднього
+ *          завдання, — як і між окремими запусками `print`.
+ * @param hold Сеанс.
+ * @param layout Розкладка з фінальними шляхами у мм.
+ * @param limits Ліміти планувальника (NULL — з профілю).
+ * @return 0 — успіх; 1 — помилка планування, підключення або виконання.
+ */
+int plot_hold_stream (
+    plot_hold_t *hold, const canvas_layout_t *layout, const planner_limits_t *limits);
+
+/** Закриває сеанс: піднімає перо, відключається і звільняє lock (NULL — no-op). */
+void plot_hold_close (plot_hold_t *hold);
+
+/**
+ * @brief Оцінює тривалість друку розкладки без пристрою.
+ * @details Планує ті самі блоки, що й `plot_stream_layout` (вікно того ж розміру), але
+ *          замість крокувача передає їх у `sim_add_block`: точні тривалості фаз
+ *          трапецієвидних профілів плюс затримки пера з профілю моделі. Підсумок
+ *          друкується одним JSON‑обʼєктом (див. `sim_write_json`).
+ * @param layout Розкладка з фінальними шляхами у мм.
+ * @param limits Ліміти планувальника (NULL — з профілю).
+ * @param config Конфігурація завдання (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @param out Потік для JSON.
+ * @return 0 — успіх; 1 — помилка планування або запису.
+ */
+int plot_estimate_layout (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    FILE *out);
+
+/**
+ * @brief Планує розкладку і зберігає блоки у файл плану (`planfile`).
+ * @details Блоки ті самі, що й у `plot_stream_layout` (вікно того ж розміру, проміжки
+ *          без підйому пера з конфігурації моделі). За помилки файл видаляється.
+ * @param layout Розкладка з фінальними шляхами у мм.
+ * @param limits Ліміти планувальника (NULL — з профілю).
+ * @param config Конфігурація завдання (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова); записується у заголовок.
+ * @param path Шлях до файлу плану.
+ * @return 0 — успіх; 1 — помилка планування або запису.
+ */
+int plot_save_layout (
+    const canvas_layout_t *layout,
+    const planner_limits_t *limits,
+    const config_t *config,
+    const char *model,
+    const char *path);
+
+/**
+ * @brief Виконує збережений план без верстки і планування (або dry-run).
+ * @details Блоки декодуються з відображеного файлу по одному й проходять той самий
+ *          сеанс, що й у `plot_execute_plan`: перемикання пера, перекриття затримок,
+ *          `stepper_submit_block`.
+ * @param plan Відкритий файл плану (читання продовжується з поточного блоку).
+ * @param config Конфігурація завдання (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @param dry_run true — без підключення; лише обчислення.
+ * @param verbose true — докладні журнали.
+ * @return 0 — успіх; 1 — пошкоджений файл або помилка виконання.
+ */
+int plot_replay_plan (
+    planfile_reader_t *plan, const config_t *config, const char *model, bool dry_run, bool verbose);
+
+/**
+ * @brief Оцінює тривалість виконання збереженого плану (як `plot_estimate_layout`).
+ * @param plan Відкритий файл плану.
+ * @param config Конфігурація завдання (NULL — прочитати файл конфігурації).
+ * @param model Ідентифікатор моделі (NULL — типова).
+ * @param out Потік для JSON.
+ * @return 0 — успіх; 1 — пошкоджений файл або помилка запису.
+ */
+int plot_estimate_plan (
+    planfile_reader_t *plan, const config_t *config, const char *model, FILE *out);
+
 /**
  * @brief Генерує план із розкладки та виконує його (або dry-run).
  * @param layout Розкладка, що містить фінальні шляхи полотна.
@@ -3,17 +3,23 @@
  * @brief Реалізація растрового превʼю (PNG).
  * @ingroup png
  * @details
- * Генерує мінімальне PNG (IHDR/IDAT/IEND) у відтінках сірого (8‑біт) з
- * некорпімованим Deflate‑потоком (zlib контейнер). Лінії конвертуються з
- * міліметрових координат у пікселі за сталим DPI і растеризуються алгоритмом
- * Брезенгема.
+ * Генерує мінімальне PNG (IHDR/IDAT/IEND) у відтінках сірого (8‑біт). Лінії
+ * конвертуються з міліметрових координат у пікселі за заданою роздільністю (типово
+ * `PNG_DPI`), проріджуються до пів пікселя, розкладаються по смугах рядків (за
+ * рамками з урахуванням штриха) і малюються згладженими штрихами товщини пера. Смуги
+ * растеризуються й фільтруються паралельно (`parallel_for`), а стискаються по черзі:
+ * відфільтровані рядки смуг по порядку йдуть у потоковий кодер Deflate
+ * (LZ77 за ланцюжками хешів, фіксовані або динамічні коди Хаффмана — що коротше для
+ * блоку) у zlib‑контейнері; стиснуті дані йдуть у приймач чанками IDAT.
  */
 
 #include "png.h"
 
 #include "log.h"
+#include "parallel.h"
 
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +29,7 @@
 #pragma clang diagnostic ignored "-Wformat-nonliteral"
 #endif
 
-/** \brief Базова роздільність превʼю у точках на дюйм. */
+/** \brief Типова роздільність превʼю у точках на дюйм. */
 #define PNG_DPI 96.0
 
 /**
@@ -38,33 +44,61 @@ static void png_write_u32_be (uint8_t *dst, uint32_t value) {
     dst[3] = (uint8_t)(value & 0xFF);
 }
 
+/** \brief Таблиці CRC‑32 для обробки по 8 байтів (slicing‑by‑8). */
+static uint32_t png_crc_table[8][256];
+/** \brief Однократна ініціалізація `png_crc_table`. */
+static pthread_once_t png_crc_once = PTHREAD_ONCE_INIT;
+
+/** \brief Будує таблиці CRC‑32: `[0]` — класична, `[k]` — зсув ще на k байтів. */
+static void png_crc_init (void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int j = 0; j < 8; ++j)
+            c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+        png_crc_table[0][i] = c;
+    }
+    for (int k = 1; k < 8; ++k)
+        for (int i = 0; i < 256; ++i) {
+            uint32_t c = png_crc_table[k - 1][i];
+            png_crc_table[k][i] = (c >> 8) ^ png_crc_table[0][c & 0xFF];
+        }
+}
+
 /**
  * @brief Обчислює CRC‑32 (поліном 0xEDB88320) для шматка даних.
+ * @details Основний цикл обробляє 8 байтів за крок (slicing‑by‑8), хвіст — побайтно.
  * @param crc Поточне значення CRC (0 — для початку). Внутрішньо застосовується XOR із 0xFFFFFFFF.
  * @param data Дані.
  * @param len Довжина у байтах.
  * @return Оновлене CRC‑32.
  */
 static uint32_t png_crc32_update (uint32_t crc, const uint8_t *data, size_t len) {
-    static uint32_t table[256];
-    static int table_init = 0;
-    if (!table_init) {
-        for (uint32_t i = 0; i < 256; ++i) {
-            uint32_t c = i;
-            for (int j = 0; j < 8; ++j)
-                c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
-            table[i] = c;
-        }
-        table_init = 1;
-    }
+    pthread_once (&png_crc_once, png_crc_init);
+    uint32_t (*t)[256] = png_crc_table;
     crc = crc ^ 0xFFFFFFFFU;
-    for (size_t i = 0; i < len; ++i)
-        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    while (len >= 8) {
+        uint32_t lo = crc
+                      ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16)
+                         | ((uint32_t)data[3] << 24));
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+              ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
     return crc ^ 0xFFFFFFFFU;
 }
 
+/** \brief Модуль Adler‑32. */
+#define PNG_ADLER_BASE 65521U
+/** \brief Найбільше число байтів, після якого `s2` ще не переповнює 32 біти. */
+#define PNG_ADLER_NMAX 5552
+
 /**
  * @brief Оновлює контрольну суму Adler‑32 для zlib.
+ * @details Взяття за модулем відкладається на `PNG_ADLER_NMAX` байтів, внутрішній цикл
+ *          розгорнуто на 16 байтів, щоб компілятор міг векторизувати суми.
  * @param adler Поточне значення (типово 1).
  * @param data Дані.
  * @param len Довжина.
@@ -73,9 +107,23 @@ static uint32_t png_crc32_update (uint32_t crc, const uint8_t *data, size_t len)
 static uint32_t png_adler32_update (uint32_t adler, const uint8_t *data, size_t len) {
     uint32_t s1 = adler & 0xFFFFU;
     uint32_t s2 = (adler >> 16) & 0xFFFFU;
-    for (size_t i = 0; i < len; ++i) {
-        s1 = (s1 + data[i]) % 65521U;
-        s2 = (s2 + s1) % 65521U;
+    while (len > 0) {
+        size_t n = len < PNG_ADLER_NMAX ? len : PNG_ADLER_NMAX;
+        len -= n;
+        while (n >= 16) {
+            for (int i = 0; i < 16; ++i) {
+                s1 += data[i];
+                s2 += s1;
+            }
+            data += 16;
+            n -= 16;
+        }
+        while (n--) {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= PNG_ADLER_BASE;
+        s2 %= PNG_ADLER_BASE;
     }
     return (s2 << 16) | s1;
 }
@@ -115,137 +163,1024 @@ static int png_append_byte (uint8_t **buf, size_t *len, size_t *cap, uint8_t val
 }
 
 /**
- * @brief Додає PNG‑чанк у буфер: length + type + data + CRC.
- * @param buf [in,out] Буфер PNG.
- * @param len [in,out] Поточна довжина.
- * @param cap [in,out] Ємність.
+ * @brief Записує PNG‑чанк у приймач: length + type + data + CRC.
+ * @param out Приймач.
  * @param type 4‑символьний тип ("IHDR", "IDAT", ...).
  * @param data Тіло чанка (може бути `NULL` при `data_len==0`).
  * @param data_len Довжина даних.
- * @return 0 — успіх; -1 — помилка памʼяті.
+ * @return 0 — успіх; -1 — помилка запису.
  */
-static int png_append_chunk (
-    uint8_t **buf,
-    size_t *len,
-    size_t *cap,
-    const char type[4],
-    const uint8_t *data,
-    uint32_t data_len) {
+static int
+png_write_chunk (sink_t *out, const char type[4], const uint8_t *data, uint32_t data_len) {
     uint8_t header[8];
     png_write_u32_be (header, data_len);
     memcpy (header + 4, type, 4);
-    if (png_append_bytes (buf, len, cap, header, 8) != 0)
-        return -1;
-    if (data_len > 0 && png_append_bytes (buf, len, cap, data, data_len) != 0)
-        return -1;
     uint32_t crc = png_crc32_update (0, (const uint8_t *)type, 4);
     crc = png_crc32_update (crc, data, data_len);
     uint8_t crc_bytes[4];
     png_write_u32_be (crc_bytes, crc);
-    return png_append_bytes (buf, len, cap, crc_bytes, 4);
+    if (sink_write (out, header, 8) != 0 || sink_write (out, data, data_len) != 0)
+        return -1;
+    return sink_write (out, crc_bytes, 4);
+}
+
+/* ---- Deflate (RFC 1951): LZ77 + фіксовані/динамічні коди Хаффмана ---- */
+
+/** \brief Розмір вікна LZ77 (максимальна відстань Deflate). */
+#define PNG_LZ_WINDOW 32768
+/** \brief Кількість бітів хешу трійок байтів. */
+#define PNG_LZ_HASH_BITS 15
+/** \brief Найбільша кількість кандидатів у ланцюжку хешу на одну позицію. */
+#define PNG_LZ_MAX_CHAIN 48
+/** \brief Довжина збігу, після якої пошук кращого кандидата припиняється. */
+#define PNG_LZ_NICE_MATCH 128
+/** \brief Мінімальна і максимальна довжина збігу. */
+#define PNG_LZ_MIN_MATCH 3
+#define PNG_LZ_MAX_MATCH 258
+/** \brief Кількість токенів LZ77 в одному блоці Deflate. */
+#define PNG_BLOCK_TOKENS 16384
+/** \brief Кількість символів літералів/довжин і відстаней. */
+#define PNG_NUM_LITLEN 286
+#define PNG_NUM_DIST 30
+/** \brief Кількість символів алфавіту довжин кодів. */
+#define PNG_NUM_CLEN 19
+
+/** \brief Потік бітів Deflate (молодші біти першими) поверх динамічного буфера. */
+typedef struct {
+    uint8_t *buf;   /**< Буфер байтів. */
+    size_t len;     /**< Записано байтів. */
+    size_t cap;     /**< Ємність буфера. */
+    uint64_t acc;   /**< Накопичувач бітів. */
+    unsigned nbits; /**< Кількість бітів у накопичувачі. */
+    int failed;     /**< Ненульове після помилки памʼяті. */
+} png_bits_t;
+
+/** \brief Дописує `n` (≤ 32) молодших бітів `value`. */
+static void png_bits_put (png_bits_t *bw, uint32_t value, unsigned n) {
+    bw->acc |= (uint64_t)value << bw->nbits;
+    bw->nbits += n;
+    while (bw->nbits >= 8) {
+        if (!bw->failed && png_append_byte (&bw->buf, &bw->len, &bw->cap, (uint8_t)bw->acc) != 0)
+            bw->failed = 1;
+        bw->acc >>= 8;
+        bw->nbits -= 8;
+    }
+}
+
+/** \brief Доповнює потік нулями до межі байта. */
+static void png_bits_align (png_bits_t *bw) {
+    if (bw->nbits > 0)
+        png_bits_put (bw, 0, 8 - bw->nbits);
+}
+
+/** \brief Код Хаффмана одного символу: біти у порядку запису та довжина. */
+typedef struct {
+    uint16_t code; /**< Код, уже розвернутий для запису молодшими бітами вперед. */
+    uint8_t len;   /**< Довжина коду (0 — символ відсутній). */
+} png_huff_code_t;
+
+/**
+ * @brief Будує довжини кодів Хаффмана, обмежені `max_bits`.
+ * @details Дерево будується методом двох черг над відсортованими частотами. Якщо
+ *          найглибший лист глибший за `max_bits`, частоти стискаються вдвічі і дерево
+ *          перебудовується. Єдиний символ отримує довжину 1.
+ * @param freq Частоти символів.
+ * @param n Кількість символів (≤ `PNG_NUM_LITLEN`).
+ * @param max_bits Найбільша допустима довжина коду.
+ * @param lens [out] Довжини кодів.
+ */
+static void png_huff_lengths (const uint32_t *freq, int n, int max_bits, uint8_t *lens) {
+    uint32_t f[PNG_NUM_LITLEN];
+    int sym[PNG_NUM_LITLEN];
+    uint32_t weight[2 * PNG_NUM_LITLEN];
+    int parent[2 * PNG_NUM_LITLEN];
+    memcpy (f, freq, (size_t)n * sizeof (*f));
+    memset (lens, 0, (size_t)n);
+    for (;;) {
+        int m = 0;
+        for (int i = 0; i < n; ++i)
+            if (f[i] > 0)
+                sym[m++] = i;
+        if (m == 0)
+            return;
+        if (m == 1) {
+            lens[sym[0]] = 1;
+            return;
+        }
+        /* Сортування вставками за частотою: алфавіти малі. */
+        for (int i = 1; i < m; ++i) {
+            int s = sym[i];
+            int j = i;
+            while (j > 0 && f[sym[j - 1]] > f[s]) {
+                sym[j] = sym[j - 1];
+                --j;
+            }
+            sym[j] = s;
+        }
+        for (int i = 0; i < m; ++i)
+            weight[i] = f[sym[i]];
+        int leaf = 0;
+        int inner = m;
+        int next = m;
+        while (next < 2 * m - 1) {
+            int pick[2];
+            for (int k = 0; k < 2; ++k) {
+                if (leaf < m && (inner >= next || weight[leaf] <= weight[inner]))
+                    pick[k] = leaf++;
+                else
+                    pick[k] = inner++;
+            }
+            weight[next] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = next;
+            parent[pick[1]] = next;
+            ++next;
+        }
+        /* Глибина вузла = глибина батька + 1; корінь — останній вузол. */
+        int root = 2 * m - 2;
+        int depth_max = 0;
+        uint32_t *depth = weight;
+        depth[root] = 0;
+        for (int i = root - 1; i >= 0; --i) {
+            depth[i] = depth[parent[i]] + 1;
+            if (i < m && (int)depth[i] > depth_max)
+                depth_max = (int)depth[i];
+        }
+        if (depth_max <= max_bits) {
+            for (int i = 0; i < m; ++i)
+                lens[sym[i]] = (uint8_t)depth[i];
+            return;
+        }
+        for (int i = 0; i < n; ++i)
+            if (f[i] > 0)
+                f[i] = (f[i] >> 1) | 1U;
+    }
 }
 
 /**
- * @brief Рисує відрізок на растровому полотні чорним кольором (0).
- * @param pixels Буфер пікселів у форматі 8‑біт сірого, рядок за рядком.
+ * @brief Призначає канонічні коди за довжинами (RFC 1951, 3.2.2).
+ * @param lens Довжини кодів.
+ * @param n Кількість символів.
+ * @param codes [out] Коди, розвернуті для запису молодшими бітами вперед.
+ */
+static void png_huff_codes (const uint8_t *lens, int n, png_huff_code_t *codes) {
+    unsigned bl_count[16] = { 0 };
+    unsigned next_code[16];
+    for (int i = 0; i < n; ++i)
+        bl_count[lens[i]]++;
+    bl_count[0] = 0;
+    unsigned code = 0;
+    for (int bits = 1; bits < 16; ++bits) {
+        code = (code + bl_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+    for (int i = 0; i < n; ++i) {
+        unsigned len = lens[i];
+        codes[i].len = (uint8_t)len;
+        codes[i].code = 0;
+        if (len == 0)
+            continue;
+        unsigned c = next_code[len]++;
+        unsigned rev = 0;
+        for (unsigned b = 0; b < len; ++b)
+            rev |= ((c >> b) & 1U) << (len - 1 - b);
+        codes[i].code = (uint16_t)rev;
+    }
+}
+
+/** \brief Символ довжини збігу (257..285) та кількість/значення додаткових бітів. */
+static int png_len_symbol (unsigned length, unsigned *extra_bits, unsigned *extra) {
+    unsigned v = length - PNG_LZ_MIN_MATCH;
+    if (length == PNG_LZ_MAX_MATCH) {
+        *extra_bits = 0;
+        *extra = 0;
+        return 285;
+    }
+    if (v < 8) {
+        *extra_bits = 0;
+        *extra = 0;
+        return 257 + (int)v;
+    }
+    unsigned k = 31U - (unsigned)__builtin_clz (v);
+    *extra_bits = k - 2;
+    *extra = v & ((1U << (k - 2)) - 1U);
+    return 257 + 4 * (int)(k - 1) + (int)((v >> (k - 2)) & 3U);
+}
+
+/** \brief Символ відстані (0..29) та кількість/значення додаткових бітів. */
+static int png_dist_symbol (unsigned dist, unsigned *extra_bits, unsigned *extra) {
+    unsigned v = dist - 1;
+    if (v < 4) {
+        *extra_bits = 0;
+        *extra = 0;
+        return (int)v;
+    }
+    unsigned k = 31U - (unsigned)__builtin_clz (v);
+    *extra_bits = k - 1;
+    *extra = v & ((1U << (k - 1)) - 1U);
+    return 2 * (int)k + (int)((v >> (k - 1)) & 1U);
+}
+
+/** \brief Токен LZ77: літерал (`dist == 0`) або збіг довжини `litlen` на відстані `dist`. */
+typedef struct {
+    uint16_t litlen; /**< Байт літерала або довжина збігу. */
+    uint16_t dist;   /**< Відстань збігу; 0 — літерал. */
+} png_lz_token_t;
+
+/** \brief Порядок запису довжин кодів алфавіту довжин (RFC 1951, 3.2.7). */
+static const uint8_t k_png_clen_order[PNG_NUM_CLEN]
+    = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+/**
+ * @brief Кодує послідовність довжин кодів символами 0..18 (RLE 16/17/18).
+ * @param lens Довжини кодів літералів/довжин, за ними — відстаней.
+ * @param n Загальна кількість довжин.
+ * @param out_sym [out] Символи алфавіту довжин.
+ * @param out_extra [out] Значення додаткових бітів для 16/17/18.
+ * @return Кількість символів.
+ */
+static int png_clen_rle (const uint8_t *lens, int n, uint8_t *out_sym, uint8_t *out_extra) {
+    int count = 0;
+    for (int i = 0; i < n;) {
+        uint8_t l = lens[i];
+        int run = 1;
+        while (i + run < n && lens[i + run] == l)
+            ++run;
+        i += run;
+        if (l == 0) {
+            while (run >= 11) {
+                int r = run > 138 ? 138 : run;
+                out_sym[count] = 18;
+                out_extra[count++] = (uint8_t)(r - 11);
+                run -= r;
+            }
+            if (run >= 3) {
+                out_sym[count] = 17;
+                out_extra[count++] = (uint8_t)(run - 3);
+                run = 0;
+            }
+        } else {
+            out_sym[count] = l;
+            out_extra[count++] = 0;
+            --run;
+            while (run >= 3) {
+                int r = run > 6 ? 6 : run;
+                out_sym[count] = 16;
+                out_extra[count++] = (uint8_t)(r - 3);
+                run -= r;
+            }
+        }
+        while (run-- > 0) {
+            out_sym[count] = l;
+            out_extra[count++] = 0;
+        }
+    }
+    return count;
+}
+
+/** \brief Вартість токенів блоку в бітах за заданими довжинами кодів. */
+static uint64_t png_block_cost (
+    const uint32_t *lit_freq, const uint32_t *dist_freq, const uint8_t *lit_lens,
+    const uint8_t *dist_lens) {
+    static const uint8_t len_extra[PNG_NUM_LITLEN - 257]
+        = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    uint64_t bits = 0;
+    for (int i = 0; i < PNG_NUM_LITLEN; ++i)
+        bits += (uint64_t)lit_freq[i] * (lit_lens[i] + (i > 256 ? len_extra[i - 257] : 0));
+    for (int i = 0; i < PNG_NUM_DIST; ++i)
+        bits += (uint64_t)dist_freq[i] * (dist_lens[i] + (i < 4 ? 0 : (unsigned)(i / 2 - 1)));
+    return bits;
+}
+
+/**
+ * @brief Записує один блок Deflate найвигіднішим способом: збереженим, з фіксованими
+ *        або з динамічними кодами Хаффмана.
+ * @param bw Потік бітів.
+ * @param tokens Токени LZ77 блоку.
+ * @param ntokens Кількість токенів.
+ * @param raw Вхідні байти, які покриває блок (для збереженого варіанта).
+ * @param raw_len Кількість вхідних байтів.
+ * @param final 1 — останній блок потоку.
+ */
+static void png_deflate_block (
+    png_bits_t *bw,
+    const png_lz_token_t *tokens,
+    size_t ntokens,
+    const uint8_t *raw,
+    size_t raw_len,
+    int final) {
+    uint32_t lit_freq[PNG_NUM_LITLEN] = { 0 };
+    uint32_t dist_freq[PNG_NUM_DIST] = { 0 };
+    unsigned eb, ev;
+    for (size_t i = 0; i < ntokens; ++i) {
+        if (tokens[i].dist == 0) {
+            lit_freq[tokens[i].litlen]++;
+        } else {
+            lit_freq[png_len_symbol (tokens[i].litlen, &eb, &ev)]++;
+            dist_freq[png_dist_symbol (tokens[i].dist, &eb, &ev)]++;
+        }
+    }
+    lit_freq[256] = 1;
+
+    /* Фіксовані коди (RFC 1951, 3.2.6). */
+    uint8_t fixed_lit[288];
+    uint8_t fixed_dist[PNG_NUM_DIST];
+    for (int i = 0; i < 288; ++i)
+        fixed_lit[i] = (uint8_t)(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+    memset (fixed_dist, 5, sizeof (fixed_dist));
+    uint64_t fixed_cost = 3 + png_block_cost (lit_freq, dist_freq, fixed_lit, fixed_dist);
+
+    /* Динамічні коди й заголовок до них. */
+    uint8_t dyn_lens[PNG_NUM_LITLEN + PNG_NUM_DIST];
+    uint8_t *dyn_lit = dyn_lens;
+    uint8_t dyn_dist[PNG_NUM_DIST];
+    png_huff_lengths (lit_freq, PNG_NUM_LITLEN, 15, dyn_lit);
+    png_huff_lengths (dist_freq, PNG_NUM_DIST, 15, dyn_dist);
+    int hlit = PNG_NUM_LITLEN;
+    while (hlit > 257 && dyn_lit[hlit - 1] == 0)
+        --hlit;
+    int hdist = PNG_NUM_DIST;
+    while (hdist > 1 && dyn_dist[hdist - 1] == 0)
+        --hdist;
+    if (dyn_dist[0] == 0 && hdist == 1)
+        dyn_dist[0] = 1; /* Блок без збігів: один «порожній» код відстані. */
+    uint8_t all_lens[PNG_NUM_LITLEN + PNG_NUM_DIST];
+    memcpy (all_lens, dyn_lit, (size_t)hlit);
+    memcpy (all_lens + hlit, dyn_dist, (size_t)hdist);
+    uint8_t rle_sym[PNG_NUM_LITLEN + PNG_NUM_DIST];
+    uint8_t rle_extra[PNG_NUM_LITLEN + PNG_NUM_DIST];
+    int nrle = png_clen_rle (all_lens, hlit + hdist, rle_sym, rle_extra);
+    uint32_t clen_freq[PNG_NUM_CLEN] = { 0 };
+    for (int i = 0; i < nrle; ++i)
+        clen_freq[rle_sym[i]]++;
+    uint8_t clen_lens[PNG_NUM_CLEN];
+    png_huff_lengths (clen_freq, PNG_NUM_CLEN, 7, clen_lens);
+    int clen_used = 0;
+    for (int i = 0; i < PNG_NUM_CLEN; ++i)
+        clen_used += clen_lens[i] ? 1 : 0;
+    if (clen_used == 1) /* Алфавіт довжин має бути повним: додаємо другий код. */
+        clen_lens[clen_lens[0] ? 1 : 0] = 1;
+    int hclen = PNG_NUM_CLEN;
+    while (hclen > 4 && clen_lens[k_png_clen_order[hclen - 1]] == 0)
+        --hclen;
+    uint64_t dyn_cost = 3 + 5 + 5 + 4 + 3 * (uint64_t)hclen;
+    for (int i = 0; i < nrle; ++i)
+        dyn_cost += clen_lens[rle_sym[i]]
+                    + (rle_sym[i] == 16 ? 2 : rle_sym[i] == 17 ? 3 : rle_sym[i] == 18 ? 7 : 0);
+    dyn_cost += png_block_cost (lit_freq, dist_freq, dyn_lit, dyn_dist);
+
+    uint64_t stored_cost = 8 * ((uint64_t)raw_len + 5 * ((raw_len + 65534) / 65535 + 1)) + 8;
+    if (stored_cost < fixed_cost && stored_cost < dyn_cost) {
+        size_t off = 0;
+        do {
+            size_t chunk = raw_len - off;
+            if (chunk > 65535)
+                chunk = 65535;
+            int last = (off + chunk == raw_len) ? final : 0;
+            png_bits_put (bw, (uint32_t)last, 3);
+            png_bits_align (bw);
+            png_bits_put (bw, (uint32_t)chunk, 16);
+            png_bits_put (bw, (uint32_t)(~chunk & 0xFFFFU), 16);
+            if (!bw->failed && png_append_bytes (&bw->buf, &bw->len, &bw->cap, raw + off, chunk) != 0)
+                bw->failed = 1;
+            off += chunk;
+        } while (off < raw_len);
+        return;
+    }
+
+    png_huff_code_t lit_codes[288];
+    png_huff_code_t dist_codes[PNG_NUM_DIST];
+    if (fixed_cost <= dyn_cost) {
+        png_bits_put (bw, (uint32_t)(final | (1 << 1)), 3);
+        png_huff_codes (fixed_lit, 288, lit_codes);
+        png_huff_codes (fixed_dist, PNG_NUM_DIST, dist_codes);
+    } else {
+        png_bits_put (bw, (uint32_t)(final | (2 << 1)), 3);
+        png_bits_put (bw, (uint32_t)(hlit - 257), 5);
+        png_bits_put (bw, (uint32_t)(hdist - 1), 5);
+        png_bits_put (bw, (uint32_t)(hclen - 4), 4);
+        for (int i = 0; i < hclen; ++i)
+            png_bits_put (bw, clen_lens[k_png_clen_order[i]], 3);
+        png_huff_code_t clen_codes[PNG_NUM_CLEN];
+        png_huff_codes (clen_lens, PNG_NUM_CLEN, clen_codes);
+        for (int i = 0; i < nrle; ++i) {
+            uint8_t sy = rle_sym[i];
+            png_bits_put (bw, clen_codes[sy].code, clen_codes[sy].len);
+            if (sy == 16)
+                png_bits_put (bw, rle_extra[i], 2);
+            else if (sy == 17)
+                png_bits_put (bw, rle_extra[i], 3);
+            else if (sy == 18)
+                png_bits_put (bw, rle_extra[i], 7);
+        }
+        png_huff_codes (dyn_lit, PNG_NUM_LITLEN, lit_codes);
+        png_huff_codes (dyn_dist, PNG_NUM_DIST, dist_codes);
+    }
+
+    for (size_t i = 0; i < ntokens; ++i) {
+        const png_lz_token_t *t = &tokens[i];
+        if (t->dist == 0) {
+            png_bits_put (bw, lit_codes[t->litlen].code, lit_codes[t->litlen].len);
+            continue;
+        }
+        int ls = png_len_symbol (t->litlen, &eb, &ev);
+        png_bits_put (bw, lit_codes[ls].code, lit_codes[ls].len);
+        if (eb)
+            png_bits_put (bw, ev, eb);
+        int ds = png_dist_symbol (t->dist, &eb, &ev);
+        png_bits_put (bw, dist_codes[ds].code, dist_codes[ds].len);
+        if (eb)
+            png_bits_put (bw, ev, eb);
+    }
+    png_bits_put (bw, lit_codes[256].code, lit_codes[256].len);
+}
+
+/** \brief Хеш трьох байтів для пошуку збігів LZ77. */
+static inline uint32_t png_lz_hash (const uint8_t *p) {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761U) >> (32 - PNG_LZ_HASH_BITS);
+}
+
+/** \brief Найбільше вхідних байтів в одному блоці Deflate. */
+#define PNG_BLOCK_RAW 131072
+/** \brief Ємність вхідного буфера кодера: поточний блок, вікно LZ77 і запас на випередження. */
+#define PNG_LZ_BUF (PNG_BLOCK_RAW + PNG_LZ_WINDOW + 4 * PNG_LZ_MAX_MATCH)
+
+/**
+ * @brief Потоковий кодер zlib (RFC 1950) з блоками Deflate.
+ * @details Позиції в хеш‑таблицях абсолютні (від початку потоку), тож зсув буфера не
+ *          вимагає їх перерахунку: у буфері лишаються вікно 32 КіБ перед `pos` і вхід
+ *          поточного блоку (для збереженого варіанта).
+ */
+typedef struct {
+    uint8_t *buf;           /**< Вхідні байти, починаючи з позиції `base`. */
+    size_t base;            /**< Абсолютна позиція `buf[0]`. */
+    size_t end;             /**< Абсолютна позиція кінця прийнятих байтів. */
+    size_t pos;             /**< Перша ще не закодована позиція. */
+    size_t block_start;     /**< Початок поточного блоку. */
+    size_t *head;           /**< Для кожного хешу — остання позиція + 1 (0 — немає). */
+    size_t *prev;           /**< Попередня позиція + 1 з тим самим хешем (індекс — позиція у вікні). */
+    png_lz_token_t *tokens; /**< Токени поточного блоку. */
+    size_t ntokens;         /**< Кількість токенів поточного блоку. */
+    uint32_t adler;         /**< Adler‑32 прийнятих байтів. */
+    png_bits_t bw;          /**< Стиснуті байти, ще не передані далі. */
+} png_deflate_t;
+
+/** \brief Звільняє ресурси кодера. */
+static void png_deflate_dispose (png_deflate_t *z) {
+    free (z->buf);
+    free (z->head);
+    free (z->prev);
+    free (z->tokens);
+    free (z->bw.buf);
+    memset (z, 0, sizeof (*z));
+}
+
+/**
+ * @brief Ініціалізує кодер і записує заголовок zlib.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int png_deflate_init (png_deflate_t *z) {
+    memset (z, 0, sizeof (*z));
+    z->buf = (uint8_t *)malloc (PNG_LZ_BUF);
+    z->head = (size_t *)calloc ((size_t)1 << PNG_LZ_HASH_BITS, sizeof (size_t));
+    z->prev = (size_t *)malloc (sizeof (size_t) * PNG_LZ_WINDOW);
+    z->tokens = (png_lz_token_t *)malloc (sizeof (png_lz_token_t) * PNG_BLOCK_TOKENS);
+    if (!z->buf || !z->head || !z->prev || !z->tokens) {
+        png_deflate_dispose (z);
+        return -1;
+    }
+    z->adler = 1;
+    png_bits_put (&z->bw, 0x78, 8);
+    png_bits_put (&z->bw, 0x9C, 8);
+    return z->bw.failed ? -1 : 0;
+}
+
+/** \brief Закриває поточний блок. */
+static void png_deflate_flush_block (png_deflate_t *z, int final) {
+    png_deflate_block (
+        &z->bw, z->tokens, z->ntokens, z->buf + (z->block_start - z->base),
+        z->pos - z->block_start, final);
+    z->block_start = z->pos;
+    z->ntokens = 0;
+}
+
+/**
+ * @brief Кодує прийняті байти.
+ * @details Збіги шукаються жадібно ланцюжками хешів трійок байтів у вікні 32 КіБ
+ *          (не більше `PNG_LZ_MAX_CHAIN` кандидатів). Блок закривається після
+ *          `PNG_BLOCK_TOKENS` токенів або `PNG_BLOCK_RAW` вхідних байтів. Поки потік
+ *          не завершено, останні `PNG_LZ_MAX_MATCH` байтів лишаються на випередження.
+ * @param z Кодер.
+ * @param final 1 — вхід завершено, кодувати до кінця.
+ */
+static void png_deflate_run (png_deflate_t *z, int final) {
+    while (z->pos < z->end && (final || z->end - z->pos >= PNG_LZ_MAX_MATCH)) {
+        const uint8_t *cur = z->buf + (z->pos - z->base);
+        size_t left = z->end - z->pos;
+        size_t max_len = left < PNG_LZ_MAX_MATCH ? left : PNG_LZ_MAX_MATCH;
+        unsigned best_len = 0;
+        size_t best_dist = 0;
+        if (max_len >= PNG_LZ_MIN_MATCH) {
+            size_t cand = z->head[png_lz_hash (cur)];
+            for (int chain = 0; cand && chain < PNG_LZ_MAX_CHAIN; ++chain) {
+                size_t cpos = cand - 1;
+                size_t dist = z->pos - cpos;
+                if (dist > PNG_LZ_WINDOW - 1)
+                    break;
+                const uint8_t *ref = z->buf + (cpos - z->base);
+                if (ref[best_len] == cur[best_len]) {
+                    unsigned l = 0;
+                    while (l < max_len && ref[l] == cur[l])
+                        ++l;
+                    if (l > best_len) {
+                        best_len = l;
+                        best_dist = dist;
+                        if (l == max_len || l >= PNG_LZ_NICE_MATCH)
+                            break;
+                    }
+                }
+                size_t nxt = z->prev[cpos % PNG_LZ_WINDOW];
+                if (nxt >= cand)
+                    break;
+                cand = nxt;
+            }
+        }
+        size_t advance = 1;
+        png_lz_token_t *t = &z->tokens[z->ntokens++];
+        if (best_len >= PNG_LZ_MIN_MATCH) {
+            t->litlen = (uint16_t)best_len;
+            t->dist = (uint16_t)best_dist;
+            advance = best_len;
+        } else {
+            t->litlen = *cur;
+            t->dist = 0;
+        }
+        for (size_t k = 0; k < advance; ++k, ++z->pos) {
+            if (z->end - z->pos >= PNG_LZ_MIN_MATCH) {
+                uint32_t h = png_lz_hash (z->buf + (z->pos - z->base));
+                z->prev[z->pos % PNG_LZ_WINDOW] = z->head[h];
+                z->head[h] = z->pos + 1;
+            }
+        }
+        if (z->ntokens == PNG_BLOCK_TOKENS || z->pos - z->block_start >= PNG_BLOCK_RAW)
+            png_deflate_flush_block (z, 0);
+    }
+}
+
+/**
+ * @brief Приймає шматок вхідних байтів.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int png_deflate_feed (png_deflate_t *z, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t room = PNG_LZ_BUF - (z->end - z->base);
+        if (room == 0) {
+            /* Лишаємо вікно перед `pos` і вхід поточного блоку. */
+            size_t keep = z->pos > PNG_LZ_WINDOW ? z->pos - PNG_LZ_WINDOW : 0;
+            if (z->block_start < keep)
+                keep = z->block_start;
+            memmove (z->buf, z->buf + (keep - z->base), z->end - keep);
+            z->base = keep;
+            room = PNG_LZ_BUF - (z->end - z->base);
+        }
+        size_t take = len < room ? len : room;
+        memcpy (z->buf + (z->end - z->base), data, take);
+        z->adler = png_adler32_update (z->adler, data, take);
+        z->end += take;
+        data += take;
+        len -= take;
+        png_deflate_run (z, 0);
+    }
+    return z->bw.failed ? -1 : 0;
+}
+
+/**
+ * @brief Кодує залишок, закриває останній блок і дописує Adler‑32.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int png_deflate_finish (png_deflate_t *z) {
+    png_deflate_run (z, 1);
+    png_deflate_flush_block (z, 1);
+    png_bits_align (&z->bw);
+    png_bits_put (&z->bw, (z->adler >> 24) & 0xFF, 8);
+    png_bits_put (&z->bw, (z->adler >> 16) & 0xFF, 8);
+    png_bits_put (&z->bw, (z->adler >> 8) & 0xFF, 8);
+    png_bits_put (&z->bw, z->adler & 0xFF, 8);
+    return z->bw.failed ? -1 : 0;
+}
+
+/* ---- Фільтри рядків PNG ---- */
+
+/** \brief Передбачувач Паета (PNG, 9.4). */
+static inline uint8_t png_paeth (uint8_t a, uint8_t b, uint8_t c) {
+    int p = (int)a + (int)b - (int)c;
+    int pa = abs (p - (int)a);
+    int pb = abs (p - (int)b);
+    int pc = abs (p - (int)c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+/**
+ * @brief Фільтрує рядок пікселів (1 байт на піксель) найвигіднішим із пʼяти фільтрів PNG.
+ * @details Вибір — за мінімальною сумою модулів залишків як знакових байтів. Для штрихової
+ *          графіки на білому тлі більшість рядків збігається з попереднім: тоді фільтр Up
+ *          дає нулі, решта фільтрів не перевіряється, а LZ77 стискає рядок довгими збігами.
+ * @param row Поточний рядок.
+ * @param prior Попередній рядок (NULL для першого).
+ * @param width Ширина рядка у байтах.
+ * @param scratch Робочий буфер на `5 * width` байтів.
+ * @param out [out] Байт типу фільтра і `width` відфільтрованих байтів.
+ */
+static void png_filter_row (
+    const uint8_t *row, const uint8_t *prior, size_t width, uint8_t *scratch, uint8_t *out) {
+    if (prior && memcmp (row, prior, width) == 0) {
+        out[0] = 2;
+        memset (out + 1, 0, width);
+        return;
+    }
+    uint64_t cost[5] = { 0 };
+    uint8_t *dst[5];
+    for (int type = 0; type < 5; ++type)
+        dst[type] = scratch + (size_t)type * width;
+    for (size_t x = 0; x < width; ++x) {
+        uint8_t a = x > 0 ? row[x - 1] : 0;
+        uint8_t b = prior ? prior[x] : 0;
+        uint8_t c = (prior && x > 0) ? prior[x - 1] : 0;
+        uint8_t r = row[x];
+        dst[0][x] = r;
+        dst[1][x] = (uint8_t)(r - a);
+        dst[2][x] = (uint8_t)(r - b);
+        dst[3][x] = (uint8_t)(r - (uint8_t)(((unsigned)a + (unsigned)b) >> 1));
+        dst[4][x] = (uint8_t)(r - png_paeth (a, b, c));
+        for (int type = 0; type < 5; ++type)
+            cost[type] += (uint64_t)abs ((int)(int8_t)dst[type][x]);
+    }
+    int best = 0;
+    for (int type = 1; type < 5; ++type)
+        if (cost[type] < cost[best])
+            best = type;
+    out[0] = (uint8_t)best;
+    memcpy (out + 1, dst[best], width);
+}
+
+/** \brief Рядків пікселів в одній смузі (плитці) растеризації. */
+#define PNG_STRIP_ROWS 64
+/** \brief Поріг стиснутих байтів, після якого вони записуються окремим чанком IDAT. */
+#define PNG_IDAT_BYTES 65536
+/** \brief Товщина штриха, мм (як `stroke-width` у SVG‑превʼю). */
+#define PNG_PEN_WIDTH_MM 0.3
+/** \brief Верхня межа потоків растеризації. */
+#define PNG_MAX_THREADS 8
+
+/** \brief Квадрат найменшої відстані між точками контуру, що растеризуються, пікселі². */
+#define PNG_DECIMATE_PX2 0.25
+
+/** \brief Відрізок контуру в піксельних координатах сторінки. */
+typedef struct {
+    double x0, y0; /**< Початок. */
+    double x1, y1; /**< Кінець. */
+} png_seg_t;
+
+/**
+ * @brief Накладає згладжений штрих відрізка на покриття смуги.
+ * @details Штрих — капсула радіуса `radius` навколо відрізка. Покриття пікселя
+ *          наближається як `radius + 0.5 − d` (d — відстань від центру пікселя до
+ *          відрізка), обмежене [0, 1]; перекриття штрихів беруть максимум, тож стики
+ *          не темнішають. Для кожного рядка обходяться лише стовпці, що можуть
+ *          потрапити в капсулу.
+ * @param ink Покриття смуги (0 — папір, 255 — повне чорнило).
  * @param width Ширина в пікселях.
- * @param height Висота в пікселях.
- * @param scale Множник перетворення мм→піксель.
- * @param x0_mm,y0_mm Початкова точка у мм.
- * @param x1_mm,y1_mm Кінцева точка у мм.
+ * @param y_from Перший рядок смуги на сторінці.
+ * @param rows Кількість рядків смуги.
+ * @param s Відрізок.
+ * @param radius Напівтовщина штриха, пікселі.
+ */
+static void png_stroke_segment (
+    uint8_t *ink, int width, int y_from, int rows, const png_seg_t *s, double radius) {
+    double reach = radius + 0.5;
+    double dx = s->x1 - s->x0;
+    double dy = s->y1 - s->y0;
+    double len2 = dx * dx + dy * dy;
+    double inv_len2 = len2 > 0.0 ? 1.0 / len2 : 0.0;
+    double ymin = (s->y0 < s->y1 ? s->y0 : s->y1) - reach;
+    double ymax = (s->y0 < s->y1 ? s->y1 : s->y0) + reach;
+    int row_a = (int)floor (ymin);
+    int row_b = (int)ceil (ymax);
+    if (row_a < y_from)
+        row_a = y_from;
+    if (row_b > y_from + rows - 1)
+        row_b = y_from + rows - 1;
+    for (int y = row_a; y <= row_b; ++y) {
+        double yc = y + 0.5;
+        /* Межі по X: точки відрізка в смузі [yc − reach, yc + reach], розширені на reach. */
+        double ta = 0.0, tb = 1.0;
+        if (dy != 0.0) {
+            ta = (yc - reach - s->y0) / dy;
+            tb = (yc + reach - s->y0) / dy;
+            if (ta > tb) {
+                double t = ta;
+                ta = tb;
+                tb = t;
+            }
+            if (ta < 0.0)
+                ta = 0.0;
+            if (tb > 1.0)
+                tb = 1.0;
+            if (ta > tb)
+                continue;
+        }
+        double xa = s->x0 + dx * ta;
+        double xb = s->x0 + dx * tb;
+        int col_a = (int)floor ((xa < xb ? xa : xb) - reach);
+        int col_b = (int)ceil ((xa < xb ? xb : xa) + reach);
+        if (col_a < 0)
+            col_a = 0;
+        if (col_b > width - 1)
+            col_b = width - 1;
+        uint8_t *row = ink + (size_t)(y - y_from) * (size_t)width;
+        for (int x = col_a; x <= col_b; ++x) {
+            double px = x + 0.5 - s->x0;
+            double py = yc - s->y0;
+            double t = (px * dx + py * dy) * inv_len2;
+            if (t < 0.0)
+                t = 0.0;
+            else if (t > 1.0)
+                t = 1.0;
+            double ex = px - dx * t;
+            double ey = py - dy * t;
+            double d2 = ex * ex + ey * ey;
+            if (d2 >= reach * reach)
+                continue;
+            double cov = reach - sqrt (d2);
+            uint8_t v = cov >= 1.0 ? 255 : (uint8_t)(cov * 255.0 + 0.5);
+            if (v > row[x])
+                row[x] = v;
+        }
+    }
+}
+
+/**
+ * @brief Розкладає відрізки контурів по смугах за їхніми рамками (з урахуванням штриха).
+ * @details Точки, ближчі за пів пікселя до попередньої збереженої, пропускаються
+ *          (кінцеву точку контуру збережено), тож дрібні деталі не множать роботу
+ *          на малих роздільностях.
+ * @param paths Контури у мм.
+ * @param scale Множник мм→піксель.
+ * @param width,height Розмір сторінки в пікселях.
+ * @param reach Запас рамки навколо відрізка, пікселі.
+ * @param nstrips Кількість смуг.
+ * @param out_segs [out] Відрізки (malloc).
+ * @param out_start [out] Початки списків смуг у `out_index`, `nstrips + 1` елементів (malloc).
+ * @param out_index [out] Індекси відрізків, згруповані за смугами (malloc).
+ * @return 0 — успіх; -1 — помилка памʼяті.
  */
-static void png_draw_line (
-    uint8_t *pixels,
+static int png_bin_segments (
+    const geom_paths_t *paths,
+    double scale,
     int width,
     int height,
-    double scale,
-    double x0_mm,
-    double y0_mm,
-    double x1_mm,
-    double y1_mm) {
-    double x0 = x0_mm * scale;
-    double y0 = y0_mm * scale;
-    double x1 = x1_mm * scale;
-    double y1 = y1_mm * scale;
-    int ix0 = (int)round (x0);
-    int iy0 = (int)round (y0);
-    int ix1 = (int)round (x1);
-    int iy1 = (int)round (y1);
-
-    int dx = abs (ix1 - ix0);
-    int sx = ix0 < ix1 ? 1 : -1;
-    int dy = -abs (iy1 - iy0);
-    int sy = iy0 < iy1 ? 1 : -1;
-    int err = dx + dy;
-
-    while (1) {
-        if (ix0 >= 0 && ix0 < width && iy0 >= 0 && iy0 < height)
-            pixels[iy0 * width + ix0] = 0;
-        if (ix0 == ix1 && iy0 == iy1)
-            break;
-        int e2 = 2 * err;
-        if (e2 >= dy) {
-            err += dy;
-            ix0 += sx;
-        }
-        if (e2 <= dx) {
-            err += dx;
-            iy0 += sy;
+    double reach,
+    size_t nstrips,
+    png_seg_t **out_segs,
+    size_t **out_start,
+    size_t **out_index) {
+    size_t total = 0;
+    for (size_t i = 0; i < paths->len; ++i)
+        if (paths->items[i].len >= 2)
+            total += paths->items[i].len - 1;
+    png_seg_t *segs = (png_seg_t *)malloc ((total ? total : 1) * sizeof (*segs));
+    size_t *span = (size_t *)malloc ((total ? total : 1) * 2 * sizeof (size_t));
+    size_t *start = (size_t *)calloc (nstrips + 1, sizeof (size_t));
+    if (!segs || !span || !start) {
+        free (segs);
+        free (span);
+        free (start);
+        return -1;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < paths->len; ++i) {
+        const geom_path_t *path = &paths->items[i];
+        if (path->len < 2)
+            continue;
+        double kx = path->pts[0].x * scale;
+        double ky = path->pts[0].y * scale;
+        for (size_t j = 1; j < path->len; ++j) {
+            double nx = path->pts[j].x * scale;
+            double ny = path->pts[j].y * scale;
+            /* Проріджування: точка ближче пів пікселя до попередньої не змінює растр. */
+            if (j + 1 < path->len
+                && (nx - kx) * (nx - kx) + (ny - ky) * (ny - ky) < PNG_DECIMATE_PX2)
+                continue;
+            png_seg_t s = { kx, ky, nx, ny };
+            kx = nx;
+            ky = ny;
+            double ymin = (s.y0 < s.y1 ? s.y0 : s.y1) - reach;
+            double ymax = (s.y0 < s.y1 ? s.y1 : s.y0) + reach;
+            double xmin = (s.x0 < s.x1 ? s.x0 : s.x1) - reach;
+            double xmax = (s.x0 < s.x1 ? s.x1 : s.x0) + reach;
+            if (ymax < 0.0 || ymin >= height || xmax < 0.0 || xmin >= width)
+                continue;
+            size_t first = ymin <= 0.0 ? 0 : (size_t)ymin / PNG_STRIP_ROWS;
+            size_t last = ymax >= height ? nstrips - 1 : (size_t)ymax / PNG_STRIP_ROWS;
+            segs[n] = s;
+            span[2 * n] = first;
+            span[2 * n + 1] = last;
+            ++n;
+            for (size_t k = first; k <= last; ++k)
+                start[k + 1]++;
         }
     }
+    for (size_t k = 0; k < nstrips; ++k)
+        start[k + 1] += start[k];
+    size_t *index = (size_t *)malloc ((start[nstrips] ? start[nstrips] : 1) * sizeof (size_t));
+    size_t *fill = (size_t *)malloc (nstrips * sizeof (size_t));
+    if (!index || !fill) {
+        free (index);
+        free (fill);
+        free (segs);
+        free (span);
+        free (start);
+        return -1;
+    }
+    memcpy (fill, start, nstrips * sizeof (size_t));
+    for (size_t i = 0; i < n; ++i)
+        for (size_t k = span[2 * i]; k <= span[2 * i + 1]; ++k)
+            index[fill[k]++] = i;
+    free (fill);
+    free (span);
+    *out_segs = segs;
+    *out_start = start;
+    *out_index = index;
+    return 0;
+}
+
+/** \brief Буфер смуги одного виконавця. */
+typedef struct {
+    uint8_t *pixels;   /**< Пікселі смуги (8‑біт сірий). */
+    uint8_t *filtered; /**< Відфільтровані рядки (байт фільтра + пікселі). */
+    uint8_t *scratch;  /**< Робочий буфер фільтрів (`5 * width`). */
+} png_slot_t;
+
+/**
+ * @brief Спільний стан растеризації сторінки.
+ * @details Смуги растеризуються паралельно, а стискаються по черзі в порядку смуг: потік,
+ *          що дорастеризував смугу `k`, чекає, доки стиснуть `k - 1`, і стискає свою.
+ */
+typedef struct {
+    const png_seg_t *segs;   /**< Відрізки. */
+    const size_t *bin_start; /**< Початки списків смуг. */
+    const size_t *bin_index; /**< Індекси відрізків за смугами. */
+    int width;               /**< Ширина сторінки, пікселі. */
+    int height;              /**< Висота сторінки, пікселі. */
+    double radius;           /**< Напівтовщина штриха, пікселі. */
+    png_slot_t *slots;       /**< Буфери смуг за номером виконавця. */
+    uint8_t *prior;          /**< Останній рядок попередньої стиснутої смуги. */
+    png_deflate_t *z;        /**< Кодер Deflate. */
+    sink_t *out;             /**< Приймач. */
+    pthread_mutex_t lock;    /**< Захищає поля нижче. */
+    pthread_cond_t cv_turn;  /**< Стиснуто чергову смугу. */
+    size_t consumed;         /**< Скільки смуг уже стиснуто. */
+    int abort;               /**< Ненульове — помилка, решту смуг пропустити. */
+} png_raster_t;
+
+/**
+ * @brief Растеризує смугу `k` у буфер і фільтрує всі рядки, крім першого.
+ * @details Перший рядок залежить від останнього рядка попередньої смуги, тож його
+ *          фільтрують під час стиснення.
+ */
+static void png_render_strip (const png_raster_t *r, png_slot_t *slot, size_t k) {
+    size_t width = (size_t)r->width;
+    int y_from = (int)(k * PNG_STRIP_ROWS);
+    int rows = r->height - y_from < PNG_STRIP_ROWS ? r->height - y_from : PNG_STRIP_ROWS;
+    memset (slot->pixels, 0, (size_t)rows * width);
+    for (size_t b = r->bin_start[k]; b < r->bin_start[k + 1]; ++b)
+        png_stroke_segment (
+            slot->pixels, r->width, y_from, rows, &r->segs[r->bin_index[b]], r->radius);
+    for (size_t i = 0; i < (size_t)rows * width; ++i)
+        slot->pixels[i] = (uint8_t)(255 - slot->pixels[i]);
+    for (int y = 1; y < rows; ++y)
+        png_filter_row (
+            slot->pixels + (size_t)y * width, slot->pixels + (size_t)(y - 1) * width, width,
+            slot->scratch, slot->filtered + (size_t)y * (width + 1));
+}
+
+/** \brief Передає накопичені стиснуті байти у приймач окремим чанком IDAT. */
+static int png_emit_idat (sink_t *out, png_deflate_t *z) {
+    if (z->bw.len == 0)
+        return 0;
+    if (png_write_chunk (out, "IDAT", z->bw.buf, (uint32_t)z->bw.len) != 0)
+        return -1;
+    z->bw.len = 0;
+    return 0;
+}
+
+/**
+ * @brief Фільтрує перший рядок смуги `k` і стискає всю смугу.
+ * @details Викликається строго в порядку смуг.
+ * @return 0 — успіх; -1 — помилка запису.
+ */
+static int png_compress_strip (png_raster_t *r, png_slot_t *slot, size_t k) {
+    size_t width = (size_t)r->width;
+    int y_from = (int)(k * PNG_STRIP_ROWS);
+    int rows = r->height - y_from < PNG_STRIP_ROWS ? r->height - y_from : PNG_STRIP_ROWS;
+    png_filter_row (slot->pixels, k > 0 ? r->prior : NULL, width, slot->scratch, slot->filtered);
+    memcpy (r->prior, slot->pixels + (size_t)(rows - 1) * width, width);
+    for (int y = 0; y < rows; ++y) {
+        if (png_deflate_feed (r->z, slot->filtered + (size_t)y * (width + 1), width + 1) != 0)
+            return -1;
+        if (r->z->bw.len >= PNG_IDAT_BYTES && png_emit_idat (r->out, r->z) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/** \brief `parallel_work_fn`: растеризує смугу, дочікується своєї черги і стискає її. */
+static void png_strip_work (void *items, size_t k, size_t worker) {
+    png_raster_t *r = (png_raster_t *)items;
+    png_slot_t *slot = &r->slots[worker];
+    pthread_mutex_lock (&r->lock);
+    int skip = r->abort;
+    pthread_mutex_unlock (&r->lock);
+    if (!skip)
+        png_render_strip (r, slot, k);
+
+    pthread_mutex_lock (&r->lock);
+    while (!r->abort && r->consumed != k)
+        pthread_cond_wait (&r->cv_turn, &r->lock);
+    skip = r->abort;
+    pthread_mutex_unlock (&r->lock);
+    int rc = skip ? 0 : png_compress_strip (r, slot, k);
+
+    pthread_mutex_lock (&r->lock);
+    r->consumed = k + 1;
+    if (rc != 0)
+        r->abort = 1;
+    pthread_cond_broadcast (&r->cv_turn);
+    pthread_mutex_unlock (&r->lock);
 }
 
 /**
- * @copydoc png_render_layout
+ * @copydoc png_write_layout
  */
-int png_render_layout (const drawing_layout_t *layout, bytes_t *out) {
+int png_write_layout (const drawing_layout_t *layout, const preview_opts_t *opts, sink_t *out) {
     if (!layout || !out)
         return 1;
 
     const canvas_layout_t *c = &layout->layout;
-    double scale = PNG_DPI / 25.4;
+    double dpi = (opts && opts->dpi > 0.0) ? opts->dpi : PNG_DPI;
+    double scale = dpi / 25.4;
     int width_px = (int)ceil (c->paper_w_mm * scale);
+    if (opts && opts->max_width_px > 0 && width_px > (int)opts->max_width_px) {
+        scale = (double)opts->max_width_px / c->paper_w_mm;
+        width_px = (int)opts->max_width_px;
+    }
     int height_px = (int)ceil (c->paper_h_mm * scale);
     if (width_px <= 0 || height_px <= 0)
         return 1;
 
-    uint8_t *pixels = (uint8_t *)malloc ((size_t)width_px * (size_t)height_px);
-    if (!pixels)
+    png_raster_t r = { 0 };
+    r.width = width_px;
+    r.height = height_px;
+    r.radius = 0.5 * PNG_PEN_WIDTH_MM * scale;
+    size_t nstrips = ((size_t)height_px + PNG_STRIP_ROWS - 1) / PNG_STRIP_ROWS;
+    png_seg_t *segs = NULL;
+    size_t *bin_start = NULL;
+    size_t *bin_index = NULL;
+    if (png_bin_segments (
+            &c->paths_mm, scale, width_px, height_px, r.radius + 1.0, nstrips, &segs,
+            &bin_start, &bin_index)
+        != 0) {
+        LOGE ("Не вдалося сформувати прев’ю");
         return 1;
-    memset (pixels, 0xFF, (size_t)width_px * (size_t)height_px);
-
-    const geom_paths_t *paths = &c->paths_mm;
-    for (size_t i = 0; i < paths->len; ++i) {
-        const geom_path_t *path = &paths->items[i];
-        if (path->len < 2)
-            continue;
-        for (size_t j = 1; j < path->len; ++j)
-            png_draw_line (
-                pixels, width_px, height_px, scale, path->pts[j - 1].x, path->pts[j - 1].y,
-                path->pts[j].x, path->pts[j].y);
     }
+    r.segs = segs;
+    r.bin_start = bin_start;
+    r.bin_index = bin_index;
 
-    size_t row_bytes = 1 + (size_t)width_px;
-    size_t raw_size = row_bytes * (size_t)height_px;
-    uint8_t *raw = (uint8_t *)malloc (raw_size);
-    if (!raw) {
-        free (pixels);
-        return 1;
-    }
+    size_t threads = parallel_threads (0, PNG_MAX_THREADS, nstrips);
 
-    for (int y = 0; y < height_px; ++y) {
-        raw[y * row_bytes] = 0;
-        memcpy (&raw[y * row_bytes + 1], &pixels[y * width_px], width_px);
+    int rc = 1;
+    size_t width = (size_t)width_px;
+    png_deflate_t z;
+    int z_ready = png_deflate_init (&z) == 0;
+    r.slots = (png_slot_t *)calloc (threads, sizeof (png_slot_t));
+    r.prior = (uint8_t *)malloc (width);
+    if (!z_ready || !r.slots || !r.prior)
+        goto done;
+    for (size_t i = 0; i < threads; ++i) {
+        r.slots[i].pixels = (uint8_t *)malloc (PNG_STRIP_ROWS * width);
+        r.slots[i].filtered = (uint8_t *)malloc (PNG_STRIP_ROWS * (width + 1));
+        r.slots[i].scratch = (uint8_t *)malloc (5 * width);
+        if (!r.slots[i].pixels || !r.slots[i].filtered || !r.slots[i].scratch)
+            goto done;
     }
-    free (pixels);
-
-    uint8_t *png = NULL;
-    size_t len = 0;
-    size_t cap = 0;
 
     const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
-    if (png_append_bytes (&png, &len, &cap, signature, sizeof (signature)) != 0)
-        goto fail;
+    if (sink_write (out, signature, sizeof (signature)) != 0)
+        goto done;
 
     uint8_t ihdr[13];
     png_write_u32_be (&ihdr[0], (uint32_t)width_px);
@@ -255,63 +1190,61 @@ int png_render_layout (const drawing_layout_t *layout, bytes_t *out) {
     ihdr[10] = 0;
     ihdr[11] = 0;
     ihdr[12] = 0;
-    if (png_append_chunk (&png, &len, &cap, "IHDR", ihdr, sizeof (ihdr)) != 0)
-        goto fail;
-
-    size_t zcap = raw_size + raw_size / 255 + 100;
-    uint8_t *zdata = (uint8_t *)malloc (zcap);
-    if (!zdata)
-        goto fail;
-    size_t zlen = 0;
-
-    png_append_byte (&zdata, &zlen, &zcap, 0x78);
-    png_append_byte (&zdata, &zlen, &zcap, 0x01);
-
-    size_t offset = 0;
-    uint32_t adler = 1;
-    while (offset < raw_size) {
-        size_t chunk = raw_size - offset;
-        if (chunk > 65535)
-            chunk = 65535;
-        int final = (offset + chunk == raw_size) ? 1 : 0;
-        png_append_byte (&zdata, &zlen, &zcap, (uint8_t)(final));
-        uint16_t len16 = (uint16_t)chunk;
-        uint16_t nlen = ~len16;
-        png_append_byte (&zdata, &zlen, &zcap, len16 & 0xFF);
-        png_append_byte (&zdata, &zlen, &zcap, (len16 >> 8) & 0xFF);
-        png_append_byte (&zdata, &zlen, &zcap, nlen & 0xFF);
-        png_append_byte (&zdata, &zlen, &zcap, (nlen >> 8) & 0xFF);
-        if (png_append_bytes (&zdata, &zlen, &zcap, raw + offset, chunk) != 0) {
-            free (zdata);
-            goto fail;
-        }
-        adler = png_adler32_update (adler, raw + offset, chunk);
-        offset += chunk;
-    }
+    if (png_write_chunk (out, "IHDR", ihdr, sizeof (ihdr)) != 0)
+        goto done;
 
-    uint8_t adler_bytes[4];
-    png_write_u32_be (adler_bytes, adler);
-    png_append_bytes (&zdata, &zlen, &zcap, adler_bytes, sizeof (adler_bytes));
-    free (raw);
+    r.z = &z;
+    r.out = out;
+    pthread_mutex_init (&r.lock, NULL);
+    pthread_cond_init (&r.cv_turn, NULL);
+    parallel_for (png_strip_work, &r, nstrips, threads);
+    pthread_cond_destroy (&r.cv_turn);
+    pthread_mutex_destroy (&r.lock);
+    if (r.abort)
+        goto done;
 
-    if (png_append_chunk (&png, &len, &cap, "IDAT", zdata, (uint32_t)zlen) != 0) {
-        free (zdata);
-        goto fail;
-    }
-    free (zdata);
+    if (png_deflate_finish (&z) != 0 || png_emit_idat (out, &z) != 0)
+        goto done;
+    if (png_write_chunk (out, "IEND", NULL, 0) != 0)
+        goto done;
+    rc = 0;
 
-    if (png_append_chunk (&png, &len, &cap, "IEND", NULL, 0) != 0)
-        goto fail;
+done:
+    if (z_ready)
+        png_deflate_dispose (&z);
+    if (r.slots) {
+        for (size_t i = 0; i < threads; ++i) {
+            free (r.slots[i].pixels);
+            free (r.slots[i].filtered);
+            free (r.slots[i].scratch);
+        }
+        free (r.slots);
+    }
+    free (r.prior);
+    free (segs);
+    free (bin_start);
+    free (bin_index);
+    if (rc != 0)
+        LOGE ("Не вдалося сформувати прев’ю");
+    return rc;
+}
 
-    out->bytes = png;
-    out->len = len;
+/**
+ * @copydoc png_render_layout
+ */
+int png_render_layout (const drawing_layout_t *layout, bytes_t *out) {
+    if (!layout || !out)
+        return 1;
+    sink_memory_t mem = { 0 };
+    sink_t sink;
+    sink_init_memory (&sink, &mem);
+    if (png_write_layout (layout, NULL, &sink) != 0) {
+        free (mem.bytes);
+        return 1;
+    }
+    out->bytes = mem.bytes;
+    out->len = mem.len;
     return 0;
-
-fail:
-    free (raw);
-    free (png);
-    LOGE ("Не вдалося сформувати прев’ю");
-    return 1;
 }
 
 #if defined(__clang__)
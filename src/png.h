@@ -4,14 +4,15 @@
  * @defgroup png PNG
  * @ingroup drawing
  * @details
- * Модуль формує монохромне PNG‑зображення (8‑біт сірий) з контурів у мм,
- * масштабованих згідно з фіксованою роздільністю. Призначено для швидкого
+ * Модуль формує PNG‑зображення (8‑біт сірий) зі згладженими штрихами товщини пера
+ * з контурів у мм, масштабованих згідно із заданою роздільністю. Призначено для швидкого
  * превʼю без зовнішніх залежностей (власна реалізація PNG+zlib‑стиснення).
  */
 #ifndef CPLOT_PNG_H
 #define CPLOT_PNG_H
 
 #include "drawing.h"
+#include "sink.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +27,18 @@ extern "C" {
  */
 int png_render_layout (const drawing_layout_t *layout, bytes_t *out);
 
+/**
+ * @brief Рендерить PNG‑превʼю потоково у приймач.
+ * @details Сторінка растеризується смугами рядків (паралельно, якщо ядер кілька),
+ *          рядки фільтруються і стискаються по порядку, а стиснуті дані записуються
+ *          чанками IDAT. Памʼять — по смузі пікселів на потік і вікно кодера, а не весь растр.
+ * @param layout Вхідна розкладка сторінки та шляхів у мм.
+ * @param opts Роздільність і найбільша ширина (NULL — типові 96 dpi без обмеження).
+ * @param out Приймач вихідних байтів.
+ * @return 0 — успіх; 1 — помилка аргументів, виділення памʼяті або запису.
+ */
+int png_write_layout (const drawing_layout_t *layout, const preview_opts_t *opts, sink_t *out);
+
 #ifdef __cplusplus
 }
 #endif
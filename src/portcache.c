@@ -0,0 +1,121 @@
+/**
+ * @file portcache.c
+ * @brief Реалізація кешу портів EBB.
+ * @ingroup portcache
+ */
+
+#include "portcache.h"
+
+#include "config.h"
+#include "log.h"
+#include "str.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Перший рядок файлу: сигнатура і версія формату. */
+#define PORTCACHE_SIGNATURE "cplot-ports 1"
+
+/**
+ * @brief Обчислює каталог кешу cplot.
+ * @param buf [out] Буфер.
+ * @param buflen Розмір буфера.
+ * @return 0 — успіх; -1 — немає XDG_CACHE_HOME/HOME або замалий буфер.
+ */
+static int portcache_dir (char *buf, size_t buflen) {
+    return config_xdg_dir ("XDG_CACHE_HOME", ".cache", NULL, buf, buflen);
+}
+
+/**
+ * @brief Розбирає рядок `id<TAB>path<TAB>version`.
+ * @return true — рядок коректний.
+ */
+static bool portcache_parse_line (char *line, portcache_entry_t *out) {
+    line[strcspn (line, "\r\n")] = '\0';
+    char *path = strchr (line, '\t');
+    if (!path)
+        return false;
+    *path++ = '\0';
+    char *version = strchr (path, '\t');
+    if (!version)
+        return false;
+    *version++ = '\0';
+    if (!line[0] || !path[0])
+        return false;
+    str_string_copy (out->id, sizeof (out->id), line);
+    str_string_copy (out->path, sizeof (out->path), path);
+    str_string_copy (out->version, sizeof (out->version), version);
+    return true;
+}
+
+/** @copydoc portcache_load */
+int portcache_load (portcache_entry_t *out, size_t *count) {
+    if (!out || !count)
+        return -1;
+    *count = 0;
+    char dir[PATH_MAX];
+    char path[PATH_MAX + 8];
+    if (portcache_dir (dir, sizeof (dir)) != 0)
+        return 0;
+    snprintf (path, sizeof (path), "%s/ports", dir);
+    FILE *fp = fopen (path, "r");
+    if (!fp)
+        return 0;
+    char line[512];
+    bool valid = fgets (line, sizeof (line), fp)
+                 && strncmp (line, PORTCACHE_SIGNATURE, strlen (PORTCACHE_SIGNATURE)) == 0;
+    while (valid && *count < PORTCACHE_MAX && fgets (line, sizeof (line), fp)) {
+        if (portcache_parse_line (line, &out[*count]))
+            ++*count;
+    }
+    fclose (fp);
+    if (!valid)
+        LOGD ("кеш портів: %s має інший формат — ігнорую", path);
+    return 0;
+}
+
+/** @copydoc portcache_store */
+int portcache_store (const portcache_entry_t *entries, size_t count) {
+    if (!entries && count > 0)
+        return -1;
+    char dir[PATH_MAX];
+    char path[PATH_MAX + 8];
+    char tmp[PATH_MAX + 16];
+    if (portcache_dir (dir, sizeof (dir)) != 0 || config_mkdir_p (dir) != 0) {
+        LOGD ("кеш портів: каталог недоступний");
+        return -1;
+    }
+    snprintf (path, sizeof (path), "%s/ports", dir);
+    snprintf (tmp, sizeof (tmp), "%s.tmp", path);
+    FILE *fp = fopen (tmp, "w");
+    if (!fp) {
+        LOGD ("кеш портів: не вдалося відкрити %s", tmp);
+        return -1;
+    }
+    fprintf (fp, "%s\n", PORTCACHE_SIGNATURE);
+    for (size_t i = 0; i < count && i < PORTCACHE_MAX; ++i)
+        fprintf (fp, "%s\t%s\t%s\n", entries[i].id, entries[i].path, entries[i].version);
+    bool ok = !ferror (fp);
+    if (fclose (fp) != 0)
+        ok = false;
+    if (!ok || rename (tmp, path) != 0) {
+        LOGD ("кеш портів: помилка запису %s", path);
+        remove (tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/** @copydoc portcache_find */
+const portcache_entry_t *
+portcache_find (const portcache_entry_t *entries, size_t count, const char *id) {
+    if (!entries || !id)
+        return NULL;
+    for (size_t i = 0; i < count; ++i)
+        if (strcmp (entries[i].id, id) == 0)
+            return &entries[i];
+    return NULL;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file portcache.h
+ * @brief Кеш портів, на яких відповідав контролер EBB.
+ * @defgroup portcache Кеш портів
+ * @ingroup device
+ * @details
+ * Зіставляє стабільний ідентифікатор USB‑пристрою (`serial_port_identity`) з портом і
+ * версією прошивки, отриманими під час останнього успішного опитування. Якщо пристрій
+ * з тим самим ідентифікатором знову на тому самому порту, опитування (відкриття порту
+ * і команда `V` з тайм‑аутом) пропускається.
+ *
+ * Файл — рядки `ідентифікатор<TAB>порт<TAB>версія` у `$XDG_CACHE_HOME/cplot/ports`
+ * (або `~/.cache/cplot/ports`); записується атомарно через перейменування.
+ */
+#ifndef CPLOT_PORTCACHE_H
+#define CPLOT_PORTCACHE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Найбільша кількість записів кешу (старіші відкидаються). */
+#define PORTCACHE_MAX 32
+
+/**
+ * @brief Запис кешу: пристрій, порт і версія прошивки.
+ */
+typedef struct {
+    char id[160];     /**< Стабільний ідентифікатор USB‑пристрою. */
+    char path[256];   /**< Порт, на якому контролер відповів. */
+    char version[64]; /**< Рядок версії прошивки. */
+} portcache_entry_t;
+
+/**
+ * @brief Зчитує кеш.
+ * @param out [out] Записи (ємність `PORTCACHE_MAX`).
+ * @param count [out] Кількість записів (0 — кешу немає або він пошкоджений).
+ * @return 0 — успіх (зокрема порожній кеш); -1 — помилка аргументів.
+ */
+int portcache_load (portcache_entry_t *out, size_t *count);
+
+/**
+ * @brief Перезаписує кеш.
+ * @param entries Записи.
+ * @param count Кількість (понад `PORTCACHE_MAX` — відкидаються).
+ * @return 0 — успіх; -1 — не вдалося записати (кеш необовʼязковий — лише журнал).
+ */
+int portcache_store (const portcache_entry_t *entries, size_t count);
+
+/**
+ * @brief Шукає запис за ідентифікатором.
+ * @return Запис або NULL.
+ */
+const portcache_entry_t *
+portcache_find (const portcache_entry_t *entries, size_t count, const char *id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
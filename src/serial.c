@@ -9,25 +9,42 @@
  */
 #include "serial.h"
 
+#include "ebbemu.h"
 #include "log.h"
+#include "ttime.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
 
+/** \brief Розмір приймального буфера, байт. */
+#define SERIAL_RX_CAP 512
+/** \brief Розмір буфера запису (кілька команд EBB одним `write`), байт. */
+#define SERIAL_TX_CAP 512
+
 /**
  * @brief Внутрішній стан відкритого порту.
  */
 struct serial_port_s {
-    int fd;                 /**< Файловий дескриптор порту. */
-    int default_timeout_ms; /**< Тайм‑аут читання за замовчуванням, мс. */
+    int fd;                    /**< Файловий дескриптор порту. */
+    int default_timeout_ms;    /**< Тайм‑аут читання за замовчуванням, мс. */
+    uint8_t rx[SERIAL_RX_CAP]; /**< Прийняті, ще не видані байти. */
+    size_t rx_pos;             /**< Початок невиданих байтів у `rx`. */
+    size_t rx_len;             /**< Кількість невиданих байтів. */
+    uint8_t tx[SERIAL_TX_CAP]; /**< Поставлені в чергу, ще не записані байти. */
+    size_t tx_len;             /**< Кількість байтів у `tx`. */
+    ebbemu_t *emu;             /**< Емулятор EBB для порту `emu:` (інакше NULL). */
 };
 
 /**
@@ -71,7 +88,19 @@ serial_open (const char *path, int baud, int read_timeout_ms, char *errbuf, size
         log_print (LOG_ERROR, "послідовний: не вказано шлях до порту");
         return NULL;
     }
-    int fd = open (path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    ebbemu_t *emu = NULL;
+    int fd = -1;
+    if (ebbemu_is_path (path)) {
+        emu = ebbemu_start (path, &fd);
+        if (!emu) {
+            if (errbuf && errlen)
+                snprintf (errbuf, errlen, "некоректні параметри емулятора '%s'", path);
+            log_print (LOG_ERROR, "послідовний: не вдалося запустити емулятор '%s'", path);
+            return NULL;
+        }
+    } else {
+        fd = open (path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    }
     if (fd < 0) {
         if (errbuf && errlen)
             snprintf (errbuf, errlen, "open('%s'): %s", path, strerror (errno));
@@ -121,10 +150,12 @@ serial_open (const char *path, int baud, int read_timeout_ms, char *errbuf, size
         if (errbuf && errlen)
             snprintf (errbuf, errlen, "нестача пам’яті");
         close (fd);
+        ebbemu_stop (emu);
         log_print (LOG_ERROR, "serial: нестача пам'яті для дескриптора '%s'", path);
         return NULL;
     }
     sp->fd = fd;
+    sp->emu = emu;
     sp->default_timeout_ms = (read_timeout_ms > 0) ? read_timeout_ms : 1000;
 
     LOGD ("відкрито порт: %s @ %d бод", path, baud);
@@ -141,76 +172,195 @@ void serial_close (serial_port_t *sp) {
     if (!sp)
         return;
     if (sp->fd >= 0) {
+        if (sp->tx_len > 0 && serial_flush_output (sp) != 0)
+            log_print (
+                LOG_WARN, "послідовний: не вдалося дописати %zu байт перед закриттям",
+                sp->tx_len);
         log_print (LOG_INFO, "послідовний: закрито fd=%d", sp->fd);
         close (sp->fd);
     }
+    ebbemu_stop (sp->emu);
     free (sp);
 }
 
+/** \brief Поточний час монотонного годинника, мс. */
+static int64_t serial_now_ms (void) {
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 /**
- * @copydoc serial_write
+ * @brief Записує байти у дескриптор, чекаючи готовності через `poll(2)`.
+ * @return Кількість записаних байтів (може бути < `len` при тайм‑ауті) або -1 при помилці.
  */
-ssize_t serial_write (serial_port_t *sp, const void *data, size_t len, int timeout_ms) {
-    if (!sp || sp->fd < 0 || !data)
-        return -1;
-    const uint8_t *p = (const uint8_t *)data;
+static ssize_t serial_write_fd_run (int fd, const uint8_t *p, size_t len, int timeout_ms) {
     size_t left = len;
     int tmo = (timeout_ms > 0) ? timeout_ms : 2000;
 
     while (left > 0) {
-        struct pollfd pfd = { .fd = sp->fd, .events = POLLOUT };
-        int pr = poll (&pfd, 1, tmo);
-        if (pr <= 0) {
-            if (pr == 0)
-                return (ssize_t)(len - left);
-            if (errno == EINTR)
-                continue;
-            return -1;
+        ssize_t wr = write (fd, p, left);
+        if (wr > 0) {
+            left -= (size_t)wr;
+            p += wr;
+            continue;
         }
-        ssize_t wr = write (sp->fd, p, left);
-        if (wr < 0) {
-            if (errno == EAGAIN || errno == EINTR)
-                continue;
+        if (wr < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return -1;
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        int pr = poll (&pfd, 1, tmo);
+        if (pr == 0)
+            return (ssize_t)(len - left);
+        if (pr < 0 && errno != EINTR)
             return -1;
-        }
-        left -= (size_t)wr;
-        p += wr;
     }
     return (ssize_t)len;
 }
 
+/** \brief `serial_write_fd_run` із профілем: час обміну і записані байти. */
+static ssize_t serial_write_fd (int fd, const uint8_t *p, size_t len, int timeout_ms) {
+    uint64_t t0 = ttime_stage_begin ();
+    ssize_t wr = serial_write_fd_run (fd, p, len, timeout_ms);
+    ttime_stage_end (TTIME_STAGE_SERIAL, t0);
+    if (wr > 0)
+        ttime_count (TTIME_COUNT_SERIAL_BYTES, (uint64_t)wr);
+    return wr;
+}
+
 /**
- * @copydoc serial_read
+ * @copydoc serial_flush_output
  */
-ssize_t serial_read (serial_port_t *sp, void *buf, size_t len, int timeout_ms) {
-    if (!sp || sp->fd < 0 || !buf || len == 0)
+int serial_flush_output (serial_port_t *sp) {
+    if (!sp || sp->fd < 0)
+        return -1;
+    if (sp->tx_len == 0)
+        return 0;
+    ssize_t wr = serial_write_fd (sp->fd, sp->tx, sp->tx_len, 2000);
+    if (wr < 0 || (size_t)wr < sp->tx_len) {
+        if (wr > 0) {
+            memmove (sp->tx, sp->tx + wr, sp->tx_len - (size_t)wr);
+            sp->tx_len -= (size_t)wr;
+        }
         return -1;
-    size_t got = 0;
-    int tmo = (timeout_ms > 0) ? timeout_ms : sp->default_timeout_ms;
+    }
+    sp->tx_len = 0;
+    return 0;
+}
 
-    while (got < len) {
-        struct pollfd pfd = { .fd = sp->fd, .events = POLLIN };
-        int pr = poll (&pfd, 1, tmo);
-        if (pr <= 0) {
-            if (pr == 0)
-                break;
+/**
+ * @copydoc serial_pending_output
+ */
+size_t serial_pending_output (const serial_port_t *sp) { return sp ? sp->tx_len : 0; }
+
+/**
+ * @copydoc serial_discard_output
+ */
+void serial_discard_output (serial_port_t *sp) {
+    if (sp)
+        sp->tx_len = 0;
+}
+
+/**
+ * @copydoc serial_write
+ */
+ssize_t serial_write (serial_port_t *sp, const void *data, size_t len, int timeout_ms) {
+    if (!sp || sp->fd < 0 || !data)
+        return -1;
+    if (serial_flush_output (sp) != 0)
+        return -1;
+    return serial_write_fd (sp->fd, (const uint8_t *)data, len, timeout_ms);
+}
+
+/**
+ * @brief Дочитує байти з порту у приймальний буфер.
+ * @param sp Порт.
+ * @param timeout_ms Очікування даних (мс; 0 — лише вже наявні байти).
+ * @return Кількість нових байтів (0 — тайм‑аут або даних немає) або -1 при помилці.
+ */
+static ssize_t serial_fill_run (serial_port_t *sp, int timeout_ms) {
+    if (sp->rx_pos > 0) {
+        memmove (sp->rx, sp->rx + sp->rx_pos, sp->rx_len);
+        sp->rx_pos = 0;
+    }
+    size_t room = sizeof (sp->rx) - sp->rx_len;
+    if (room == 0)
+        return 0;
+    int64_t deadline = serial_now_ms () + (timeout_ms > 0 ? timeout_ms : 0);
+    bool hangup = false;
+    for (;;) {
+        ssize_t rd = read (sp->fd, sp->rx + sp->rx_len, room);
+        if (rd > 0) {
+            sp->rx_len += (size_t)rd;
+            return rd;
+        }
+        if (rd < 0) {
             if (errno == EINTR)
                 continue;
-            return -1;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return -1;
         }
-        ssize_t rd = read (sp->fd, (uint8_t *)buf + got, len - got);
-        if (rd < 0) {
-            if (errno == EAGAIN || errno == EINTR)
+        /* У raw‑режимі з VMIN=0 порожній tty повертає 0, тож чекаємо через poll. */
+        int left = (int)(deadline - serial_now_ms ());
+        if (hangup || left <= 0)
+            return 0;
+        struct pollfd pfd = { .fd = sp->fd, .events = POLLIN };
+        int pr = poll (&pfd, 1, left);
+        if (pr == 0)
+            return 0;
+        if (pr < 0) {
+            if (errno == EINTR)
                 continue;
             return -1;
         }
-        if (rd == 0)
-            break;
-        got += (size_t)rd;
+        hangup = (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+    }
+}
+
+/** \brief `serial_fill_run` із профілем: час очікування відповіді. */
+static ssize_t serial_fill (serial_port_t *sp, int timeout_ms) {
+    uint64_t t0 = ttime_stage_begin ();
+    ssize_t rd = serial_fill_run (sp, timeout_ms);
+    ttime_stage_end (TTIME_STAGE_SERIAL, t0);
+    return rd;
+}
+
+/** \brief Видає до `len` байтів із приймального буфера. */
+static size_t serial_take (serial_port_t *sp, void *buf, size_t len) {
+    size_t n = sp->rx_len < len ? sp->rx_len : len;
+    memcpy (buf, sp->rx + sp->rx_pos, n);
+    sp->rx_pos += n;
+    sp->rx_len -= n;
+    if (sp->rx_len == 0)
+        sp->rx_pos = 0;
+    return n;
+}
 
-        break;
+/**
+ * @copydoc serial_read
+ */
+ssize_t serial_read (serial_port_t *sp, void *buf, size_t len, int timeout_ms) {
+    if (!sp || sp->fd < 0 || !buf || len == 0)
+        return -1;
+    /* Відповідь очікується на вже поставлені в чергу команди — вони мають піти першими. */
+    if (serial_flush_output (sp) != 0)
+        return -1;
+    if (sp->rx_len == 0) {
+        int tmo = (timeout_ms > 0) ? timeout_ms : sp->default_timeout_ms;
+        if (serial_fill (sp, tmo) < 0)
+            return -1;
     }
-    return (ssize_t)got;
+    return (ssize_t)serial_take (sp, buf, len);
+}
+
+/**
+ * @copydoc serial_read_available
+ */
+ssize_t serial_read_available (serial_port_t *sp, void *buf, size_t len) {
+    if (!sp || sp->fd < 0 || !buf || len == 0)
+        return -1;
+    if (sp->rx_len == 0 && serial_fill (sp, 0) < 0)
+        return -1;
+    return (ssize_t)serial_take (sp, buf, len);
 }
 
 /**
@@ -219,8 +369,10 @@ ssize_t serial_read (serial_port_t *sp, void *buf, size_t len, int timeout_ms) {
 int serial_flush_input (serial_port_t *sp) {
     if (!sp || sp->fd < 0)
         return -1;
+    int total = (int)sp->rx_len;
+    sp->rx_pos = 0;
+    sp->rx_len = 0;
     uint8_t tmp[256];
-    int total = 0;
     while (1) {
         ssize_t rd = read (sp->fd, tmp, sizeof tmp);
         if (rd <= 0) {
@@ -240,47 +392,67 @@ int serial_flush_input (serial_port_t *sp) {
 }
 
 /**
- * @copydoc serial_write_line
+ * @copydoc serial_queue_line
  */
-int serial_write_line (serial_port_t *sp, const char *s) {
-    if (!sp || !s)
+int serial_queue_line (serial_port_t *sp, const char *s) {
+    if (!sp || sp->fd < 0 || !s)
         return -1;
+    ttime_count (TTIME_COUNT_EBB_COMMANDS, 1);
     size_t n = strlen (s);
-    if (serial_write (sp, s, n, 2000) < 0)
-        return -1;
-    const char cr = '\r';
-    if (serial_write (sp, &cr, 1, 200) < 0)
+    if (sp->tx_len + n + 1 > sizeof (sp->tx) && serial_flush_output (sp) != 0)
         return -1;
+    if (n + 1 > sizeof (sp->tx)) {
+        /* Рядок, довший за буфер, пишеться напряму (буфер уже порожній). */
+        const char cr = '\r';
+        if (serial_write (sp, s, n, 2000) != (ssize_t)n || serial_write (sp, &cr, 1, 200) != 1)
+            return -1;
+        return 0;
+    }
+    memcpy (sp->tx + sp->tx_len, s, n);
+    sp->tx[sp->tx_len + n] = '\r';
+    sp->tx_len += n + 1;
     return 0;
 }
 
+/**
+ * @copydoc serial_write_line
+ */
+int serial_write_line (serial_port_t *sp, const char *s) {
+    if (serial_queue_line (sp, s) != 0)
+        return -1;
+    return serial_flush_output (sp);
+}
+
 /**
  * @copydoc serial_read_line
  */
 ssize_t serial_read_line (serial_port_t *sp, char *buf, size_t maxlen, int timeout_ms) {
-    if (!sp || !buf || maxlen == 0)
+    if (!sp || sp->fd < 0 || !buf || maxlen == 0)
         return -1;
+    if (serial_flush_output (sp) != 0)
+        return -1;
+    int64_t deadline = serial_now_ms () + (timeout_ms > 0 ? timeout_ms : 0);
     size_t pos = 0;
-    int elapsed = 0;
-    const int step = 20;
-    while (elapsed <= timeout_ms) {
-        char ch;
-        ssize_t rd = serial_read (sp, &ch, 1, step);
-        if (rd < 0)
-            return -1;
-        if (rd == 0) {
-            elapsed += step;
-            continue;
-        }
-        if (ch == '\r' || ch == '\n') {
-            if (pos < maxlen)
+    for (;;) {
+        while (sp->rx_len > 0) {
+            char ch = (char)sp->rx[sp->rx_pos++];
+            --sp->rx_len;
+            if (ch == '\r' || ch == '\n') {
+                /* Порожні рядки (LF після CR) пропускаються: 0 означає лише тайм‑аут. */
+                if (pos == 0)
+                    continue;
                 buf[pos] = '\0';
-            return (ssize_t)pos;
+                return (ssize_t)pos;
+            }
+            if (pos + 1 < maxlen)
+                buf[pos++] = ch;
         }
-        if (pos + 1 < maxlen)
-            buf[pos++] = ch;
+        sp->rx_pos = 0;
+        int left = (int)(deadline - serial_now_ms ());
+        ssize_t rd = serial_fill (sp, left > 0 ? left : 0);
+        if (rd <= 0)
+            return rd < 0 ? -1 : 0;
     }
-    return 0;
 }
 
 /**
@@ -306,8 +478,121 @@ int serial_probe_ebb (serial_port_t *sp, char *version_out, size_t version_len)
     return 0;
 }
 
-#ifdef __APPLE__
-#include <dirent.h>
+/** \brief USB VID контролера EBB (Microchip). */
+#define SERIAL_EBB_VID "04d8"
+/** \brief USB PID контролера EBB. */
+#define SERIAL_EBB_PID "fd92"
+
+#ifdef __linux__
+/**
+ * @brief Читає перший рядок атрибута sysfs без завершального переводу рядка.
+ * @return 0 — успіх; -1 — атрибута немає або він порожній.
+ */
+static int serial_sysfs_read (const char *dir, const char *name, char *out, size_t out_len) {
+    char path[PATH_MAX];
+    int written = snprintf (path, sizeof (path), "%s/%s", dir, name);
+    if (written < 0 || (size_t)written >= sizeof (path))
+        return -1;
+    FILE *fp = fopen (path, "r");
+    if (!fp)
+        return -1;
+    bool ok = fgets (out, (int)out_len, fp) != NULL;
+    fclose (fp);
+    if (!ok)
+        return -1;
+    out[strcspn (out, "\r\n")] = '\0';
+    return out[0] ? 0 : -1;
+}
+
+/**
+ * @brief Знаходить каталог USB‑пристрою в sysfs для вузла tty (`ttyACM0`).
+ * @details `/sys/class/tty/<вузол>/device` вказує на USB‑інтерфейс; каталог пристрою з
+ *          `idVendor`/`idProduct` — один із його предків.
+ * @return 0 — знайдено; -1 — не USB або sysfs недоступна.
+ */
+static int serial_sysfs_usb_dir (const char *node, char *out, size_t out_len) {
+    char link[PATH_MAX];
+    int written = snprintf (link, sizeof (link), "/sys/class/tty/%s/device", node);
+    if (written < 0 || (size_t)written >= sizeof (link))
+        return -1;
+    char dir[PATH_MAX];
+    if (!realpath (link, dir))
+        return -1;
+    for (int depth = 0; depth < 4; ++depth) {
+        char probe[PATH_MAX];
+        written = snprintf (probe, sizeof (probe), "%s/idVendor", dir);
+        if (written > 0 && (size_t)written < sizeof (probe) && access (probe, R_OK) == 0) {
+            if (strlen (dir) >= out_len)
+                return -1;
+            memcpy (out, dir, strlen (dir) + 1);
+            return 0;
+        }
+        char *slash = strrchr (dir, '/');
+        if (!slash || slash == dir)
+            break;
+        *slash = '\0';
+    }
+    return -1;
+}
+
+/**
+ * @brief Зчитує VID/PID і серійний номер (або топологію USB) вузла tty.
+ * @return 0 — успіх; -1 — не USB‑пристрій.
+ */
+static int serial_sysfs_usb_ids (
+    const char *node, char vid[8], char pid[8], char *serial, size_t serial_len) {
+    char dir[PATH_MAX];
+    if (serial_sysfs_usb_dir (node, dir, sizeof (dir)) != 0
+        || serial_sysfs_read (dir, "idVendor", vid, 8) != 0
+        || serial_sysfs_read (dir, "idProduct", pid, 8) != 0)
+        return -1;
+    if (serial_sysfs_read (dir, "serial", serial, serial_len) != 0) {
+        /* Без серійного номера стабільне лише гніздо USB (`1-1.2`). */
+        const char *topo = strrchr (dir, '/');
+        snprintf (serial, serial_len, "@%s", topo ? topo + 1 : dir);
+    }
+    return 0;
+}
+#endif
+
+/**
+ * \brief Імʼя вузла пристрою після розкриття символьних посилань.
+ * @return 0 — успіх; -1 — імʼя не вміщується в буфер.
+ */
+static int serial_node_name (const char *path, char *buf, size_t buflen) {
+    char real[PATH_MAX];
+    const char *resolved = realpath (path, real) ? real : path;
+    const char *slash = strrchr (resolved, '/');
+    int written = snprintf (buf, buflen, "%s", slash ? slash + 1 : resolved);
+    return (written < 0 || (size_t)written >= buflen) ? -1 : 0;
+}
+
+/**
+ * @copydoc serial_port_identity
+ */
+int serial_port_identity (const char *path, char *out, size_t out_len) {
+    if (!path || !path[0] || !out || out_len == 0)
+        return -1;
+    char node[NAME_MAX + 1];
+    if (serial_node_name (path, node, sizeof (node)) != 0)
+        return -1;
+    int written = -1;
+#if defined(__linux__)
+    char vid[8];
+    char pid[8];
+    char serial[128];
+    if (serial_sysfs_usb_ids (node, vid, pid, serial, sizeof (serial)) != 0)
+        return -1;
+    written = snprintf (out, out_len, "usb:%s:%s:%s", vid, pid, serial);
+#elif defined(__APPLE__)
+    /* Імʼя `usbmodemXXXX` містить location ID гнізда USB — стабільне між підключеннями. */
+    if (!strstr (node, "usbmodem") && !strstr (node, "usbserial"))
+        return -1;
+    const char *dot = strchr (node, '.');
+    written = snprintf (out, out_len, "dev:%s", dot ? dot + 1 : node);
+#endif
+    return (written < 0 || (size_t)written >= out_len) ? -1 : 0;
+}
 
 /**
  * @copydoc serial_guess_axidraw_port
@@ -315,6 +600,40 @@ int serial_probe_ebb (serial_port_t *sp, char *version_out, size_t version_len)
 int serial_guess_axidraw_port (char *out_path, size_t out_len) {
     if (!out_path || out_len == 0)
         return -1;
+    const char *env = getenv ("CPLOT_PORT");
+    if (env && *env) {
+        int written = snprintf (out_path, out_len, "%s", env);
+        return (written < 0 || (size_t)written >= out_len) ? -1 : 0;
+    }
+#if defined(__linux__)
+    /* Вузли tty з VID/PID EBB; за кількох плат — найменше імʼя, щоб вибір був сталим. */
+    DIR *d = opendir ("/sys/class/tty");
+    if (!d)
+        return -1;
+    struct dirent *e;
+    char best[NAME_MAX + 1] = "";
+    while ((e = readdir (d)) != NULL) {
+        if (strncmp (e->d_name, "ttyACM", 6) != 0 && strncmp (e->d_name, "ttyUSB", 6) != 0)
+            continue;
+        char vid[8];
+        char pid[8];
+        char serial[128];
+        if (serial_sysfs_usb_ids (e->d_name, vid, pid, serial, sizeof (serial)) != 0
+            || strcasecmp (vid, SERIAL_EBB_VID) != 0 || strcasecmp (pid, SERIAL_EBB_PID) != 0)
+            continue;
+        if (!best[0] || strcmp (e->d_name, best) < 0)
+            snprintf (best, sizeof (best), "%s", e->d_name);
+    }
+    closedir (d);
+    if (!best[0])
+        return -1;
+    int written = snprintf (out_path, out_len, "/dev/%s", best);
+    if (written < 0 || (size_t)written >= out_len) {
+        LOGW ("шлях до tty занадто довгий: %s", best);
+        return -1;
+    }
+    return 0;
+#elif defined(__APPLE__)
     DIR *d = opendir ("/dev");
     if (!d)
         return -1;
@@ -334,5 +653,7 @@ int serial_guess_axidraw_port (char *out_path, size_t out_len) {
     }
     closedir (d);
     return rc;
-}
+#else
+    return -1;
 #endif
+}
@@ -8,6 +8,12 @@
  * простих службових дій над POSIX‑сумісним серійним портом. Використовує
  * неблокуючі дескриптори і `poll(2)` для тайм‑аутів. Усі повідомлення —
  * українською. Порт відкривається у режимі raw без керування потоком.
+ *
+ * Прийом буферизований: кожен `read(2)` забирає все, що вже надійшло, а рядки
+ * відповідей виділяються з внутрішнього буфера без системного виклику на байт.
+ * Запис рядків накопичується у буфері передачі (`serial_queue_line`) і йде одним
+ * `write(2)` під час `serial_flush_output`; будь-яке блокуюче читання спершу
+ * виштовхує чергу, бо відповідь очікується саме на поставлені команди.
  */
 #ifndef SERIAL_H
 #define SERIAL_H
@@ -26,7 +32,7 @@ typedef struct serial_port_s serial_port_t;
 
 /**
  * @brief Відкриває серійний порт.
- * @param path Шлях до пристрою (наприклад, `/dev/tty.usbmodem*`).
+ * @param path Шлях до пристрою (наприклад, `/dev/tty.usbmodem*`) або `emu:…` — емулятор EBB.
  * @param baud Швидкість у бодах (9600, 115200, ...).
  * @param read_timeout_ms Тайм‑аут читання за замовчуванням (мс; >0).
  * @param errbuf [out] Якщо не `NULL` — буфер для тексту помилки.
@@ -62,6 +68,15 @@ ssize_t serial_write (serial_port_t *sp, const void *data, size_t len, int timeo
  */
 ssize_t serial_read (serial_port_t *sp, void *buf, size_t len, int timeout_ms);
 
+/**
+ * @brief Зчитує лише ті байти, що вже надійшли (без очікування).
+ * @param sp Порт.
+ * @param buf [out] Буфер призначення.
+ * @param len Розмір буфера.
+ * @return Кількість прочитаних байтів (0 — даних немає) або -1 при помилці.
+ */
+ssize_t serial_read_available (serial_port_t *sp, void *buf, size_t len);
+
 /**
  * @brief Очищає вхідний буфер порту, дочитуючи наявні байти.
  * @param sp Порт.
@@ -70,7 +85,7 @@ ssize_t serial_read (serial_port_t *sp, void *buf, size_t len, int timeout_ms);
 int serial_flush_input (serial_port_t *sp);
 
 /**
- * @brief Надсилає рядок та CR (\r) наприкінці.
+ * @brief Надсилає рядок та CR (\r) наприкінці одним записом (разом із чергою).
  * @param sp Порт.
  * @param s Рядок ASCII.
  * @return 0 — успіх; -1 — помилка.
@@ -78,7 +93,35 @@ int serial_flush_input (serial_port_t *sp);
 int serial_write_line (serial_port_t *sp, const char *s);
 
 /**
- * @brief Зчитує рядок до CR/LF або тайм‑ауту.
+ * @brief Ставить рядок та CR у буфер передачі без запису в порт.
+ * @details Якщо буфер заповнений, спершу виштовхує накопичене.
+ * @param sp Порт.
+ * @param s Рядок ASCII.
+ * @return 0 — успіх; -1 — помилка запису.
+ */
+int serial_queue_line (serial_port_t *sp, const char *s);
+
+/**
+ * @brief Записує накопичений буфер передачі в порт.
+ * @param sp Порт.
+ * @return 0 — успіх (буфер порожній); -1 — помилка або тайм‑аут запису.
+ */
+int serial_flush_output (serial_port_t *sp);
+
+/**
+ * @brief Кількість байтів у буфері передачі, ще не записаних у порт.
+ * @param sp Порт (`NULL` — 0).
+ */
+size_t serial_pending_output (const serial_port_t *sp);
+
+/**
+ * @brief Відкидає незаписаний буфер передачі (після аварійної зупинки).
+ * @param sp Порт (`NULL` — no‑op).
+ */
+void serial_discard_output (serial_port_t *sp);
+
+/**
+ * @brief Зчитує рядок до CR/LF або тайм‑ауту (порожні рядки пропускаються).
  * @param sp Порт.
  * @param buf [out] Буфер для рядка (термінатор `\0` додається, якщо дозволяє розмір).
  * @param maxlen Розмір буфера.
@@ -96,16 +139,29 @@ ssize_t serial_read_line (serial_port_t *sp, char *buf, size_t maxlen, int timeo
  */
 int serial_probe_ebb (serial_port_t *sp, char *version_out, size_t version_len);
 
-#ifdef __APPLE__
+/**
+ * @brief Стабільний ідентифікатор USB‑пристрою за шляхом порту.
+ * @details Linux — `usb:VID:PID:серійний номер` із sysfs (без номера — гніздо USB);
+ *          macOS — location ID з імені `usbmodem*`. Не залежить від того, яким став
+ *          номер `ttyACM*` після перепідключення, і не відкриває порт.
+ * @param path Шлях до порту (символьні посилання розкриваються).
+ * @param out [out] Буфер.
+ * @param out_len Розмір буфера.
+ * @return 0 — успіх; -1 — не USB‑пристрій, платформа без підтримки, задовге імʼя вузла
+ *         або замалий буфер.
+ */
+int serial_port_identity (const char *path, char *out, size_t out_len);
 
 /**
- * @brief Евристичний пошук шляху до порту AxiDraw (macOS).
- * @param out_path [out] Буфер для шляху (наприклад, `/dev/tty.usbmodemXXXX`).
+ * @brief Пошук порту AxiDraw без відкриття портів.
+ * @details Змінна середовища `CPLOT_PORT` має пріоритет (зокрема `emu:…` — емулятор EBB).
+ *          Linux — вузол `ttyACM*`/`ttyUSB*` з USB VID/PID контролера EBB (sysfs);
+ *          macOS — перший `/dev/tty.usbmodem*`; інші платформи — не знайдено.
+ * @param out_path [out] Буфер для шляху (наприклад, `/dev/ttyACM0`).
  * @param out_len Розмір буфера.
  * @return 0 — знайдено; -1 — не знайдено або помилка.
  */
 int serial_guess_axidraw_port (char *out_path, size_t out_len);
-#endif
 
 #ifdef __cplusplus
 }
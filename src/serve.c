@@ -0,0 +1,399 @@
+/**
+ * @file serve.c
+ * @brief Реалізація сервера завдань на Unix-сокеті.
+ * @ingroup serve
+ */
+
+#include "serve.h"
+
+#include "log.h"
+#include "ttime.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Скільки чекати на текст запиту від підключеного клієнта, с. */
+#define SERVE_READ_TIMEOUT_S 5
+/** Період перевірки прапорця зупинки в циклі прийому, мс. */
+#define SERVE_POLL_MS 250
+
+/**
+ * @brief Завдання в черзі.
+ */
+typedef struct serve_request {
+    struct serve_request *next; /**< Наступне завдання. */
+    int fd;                     /**< Підключення клієнта. */
+    unsigned long job;          /**< Номер завдання. */
+    char *text;                 /**< Запит (malloc). */
+    size_t len;                 /**< Довжина запиту, байт. */
+    struct timespec received;   /**< Час надходження. */
+} serve_request_t;
+
+/**
+ * @brief Черга завдань між потоком прийому і виконавцем.
+ */
+typedef struct {
+    serve_request_t *head; /**< Найстаріше завдання. */
+    serve_request_t *tail; /**< Найновіше завдання. */
+    size_t count;          /**< Завдань у черзі. */
+    bool stop;             /**< Прийом зупинено. */
+    serve_job_fn fn;       /**< Обробник. */
+    void *ctx;             /**< Контекст обробника. */
+    pthread_mutex_t lock;  /**< Захищає поля вище. */
+    pthread_cond_t ready;  /**< Сигнал: зʼявилось завдання або stop. */
+} serve_queue_t;
+
+/** Прапорець зупинки від SIGINT/SIGTERM. */
+static volatile sig_atomic_t g_serve_stop = 0;
+
+/** \brief Обробник сигналів зупинки. */
+static void serve_on_signal (int sig) {
+    (void)sig;
+    g_serve_stop = 1;
+}
+
+/** @copydoc serve_default_socket_path */
+int serve_default_socket_path (char *buf, size_t buflen) {
+    const char *runtime = getenv ("XDG_RUNTIME_DIR");
+    int written;
+    if (runtime && runtime[0])
+        written = snprintf (buf, buflen, "%s/cplot.sock", runtime);
+    else
+        written = snprintf (buf, buflen, "/tmp/cplot-%lu.sock", (unsigned long)getuid ());
+    if (written < 0 || (size_t)written >= buflen)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Відкриває потік відповіді поверх підключення (дескриптор дублюється).
+ * @return Потік або NULL.
+ */
+static FILE *serve_reply_open (int fd) {
+    int dup_fd = dup (fd);
+    if (dup_fd < 0)
+        return NULL;
+    FILE *out = fdopen (dup_fd, "w");
+    if (!out)
+        close (dup_fd);
+    return out;
+}
+
+/**
+ * @brief Надсилає відповідь без виконання: підтвердження або відмову.
+ * @param queued Позиція в черзі (для підтвердження).
+ * @param error Текст помилки (NULL — підтвердження).
+ */
+static void serve_reply_status (int fd, unsigned long job, size_t queued, const char *error) {
+    FILE *out = serve_reply_open (fd);
+    if (!out)
+        return;
+    json_writer_t w;
+    jsw_jsonw_init (&w, out);
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "job");
+    jsw_jsonw_int (&w, (long long)job);
+    if (error) {
+        jsw_jsonw_key (&w, "error");
+        jsw_jsonw_string_cstr (&w, error);
+        jsw_jsonw_key (&w, "ok");
+        jsw_jsonw_bool (&w, 0);
+    } else {
+        jsw_jsonw_key (&w, "queued");
+        jsw_jsonw_int (&w, (long long)queued);
+    }
+    jsw_jsonw_end_object (&w);
+    fputc ('\n', out);
+    fclose (out);
+}
+
+/**
+ * @brief Читає запит до першого `\n` або кінця запису клієнтом.
+ * @param out_text [out] Запит (malloc).
+ * @param out_len [out] Довжина без `\n`.
+ * @return 0 — успіх; -1 — тайм-аут, помилка читання, порожній або завеликий запит.
+ */
+static int serve_read_request (int fd, char **out_text, size_t *out_len) {
+    struct timeval tv = { .tv_sec = SERVE_READ_TIMEOUT_S, .tv_usec = 0 };
+    (void)setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    size_t cap = 4096;
+    size_t len = 0;
+    char *buf = (char *)malloc (cap);
+    if (!buf)
+        return -1;
+    for (;;) {
+        if (len == cap) {
+            if (cap >= SERVE_REQUEST_MAX) {
+                free (buf);
+                return -1;
+            }
+            char *grown = (char *)realloc (buf, cap * 2);
+            if (!grown) {
+                free (buf);
+                return -1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+        ssize_t n = read (fd, buf + len, cap - len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            free (buf);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        char *nl = (char *)memchr (buf + len, '\n', (size_t)n);
+        len += (size_t)n;
+        if (nl) {
+            len = (size_t)(nl - buf);
+            break;
+        }
+    }
+    if (len == 0) {
+        free (buf);
+        return -1;
+    }
+    *out_text = buf;
+    *out_len = len;
+    return 0;
+}
+
+/** \brief Виконує завдання і надсилає результат; звільняє запит і закриває підключення. */
+static void serve_execute (serve_queue_t *q, serve_request_t *req) {
+    struct timespec start;
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    FILE *out = serve_reply_open (req->fd);
+    if (!out) {
+        LOGW ("Сервер: завдання %lu — не вдалося відкрити відповідь", req->job);
+    } else {
+        json_writer_t w;
+        jsw_jsonw_init (&w, out);
+        jsw_jsonw_begin_object (&w);
+        jsw_jsonw_key (&w, "job");
+        jsw_jsonw_int (&w, (long long)req->job);
+        jsw_jsonw_key (&w, "wait_ms");
+        jsw_jsonw_double (&w, time_diff_ms (&start, &req->received));
+        int rc = q->fn (q->ctx, req->job, req->text, req->len, &w);
+        jsw_jsonw_key (&w, "ok");
+        jsw_jsonw_bool (&w, rc == 0);
+        jsw_jsonw_end_object (&w);
+        fputc ('\n', out);
+        fclose (out);
+        LOGI ("Сервер: завдання %lu — %s", req->job, rc == 0 ? "виконано" : "помилка");
+    }
+    close (req->fd);
+    free (req->text);
+    free (req);
+}
+
+/** \brief Точка входу виконавця: бере завдання з черги до зупинки. */
+static void *serve_worker_main (void *arg) {
+    serve_queue_t *q = (serve_queue_t *)arg;
+    for (;;) {
+        pthread_mutex_lock (&q->lock);
+        while (!q->head && !q->stop)
+            pthread_cond_wait (&q->ready, &q->lock);
+        if (q->stop) {
+            pthread_mutex_unlock (&q->lock);
+            break;
+        }
+        serve_request_t *req = q->head;
+        q->head = req->next;
+        if (!q->head)
+            q->tail = NULL;
+        q->count--;
+        pthread_mutex_unlock (&q->lock);
+        serve_execute (q, req);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Приймає одне підключення: читає запит і ставить його в чергу.
+ * @param next_job [in,out] Лічильник номерів завдань.
+ */
+static void serve_accept (serve_queue_t *q, int listen_fd, unsigned long *next_job) {
+    int fd = accept (listen_fd, NULL, NULL);
+    if (fd < 0)
+        return;
+    unsigned long job = (*next_job)++;
+    serve_request_t *req = (serve_request_t *)calloc (1, sizeof (*req));
+    if (!req || serve_read_request (fd, &req->text, &req->len) != 0) {
+        serve_reply_status (fd, job, 0, req ? "запит не прочитано" : "брак памʼяті");
+        free (req);
+        close (fd);
+        return;
+    }
+    req->fd = fd;
+    req->job = job;
+    clock_gettime (CLOCK_MONOTONIC, &req->received);
+
+    pthread_mutex_lock (&q->lock);
+    size_t position = q->count;
+    pthread_mutex_unlock (&q->lock);
+    if (position >= SERVE_QUEUE_MAX) {
+        serve_reply_status (fd, job, 0, "черга заповнена");
+        free (req->text);
+        free (req);
+        close (fd);
+        return;
+    }
+    /* Підтвердження — до постановки в чергу: інакше результат міг би випередити його. */
+    serve_reply_status (fd, job, position, NULL);
+    pthread_mutex_lock (&q->lock);
+    if (q->tail)
+        q->tail->next = req;
+    else
+        q->head = req;
+    q->tail = req;
+    q->count++;
+    pthread_cond_signal (&q->ready);
+    pthread_mutex_unlock (&q->lock);
+}
+
+/**
+ * @brief Відкриває сокет, що слухає; прибирає залишений після аварії файл сокета.
+ * @return Дескриптор або -1.
+ */
+static int serve_listen (const char *path) {
+    struct sockaddr_un addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen (path) >= sizeof (addr.sun_path)) {
+        LOGE ("Шлях сокета задовгий: %s", path);
+        return -1;
+    }
+    strcpy (addr.sun_path, path);
+    int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE ("Не вдалося створити сокет: %s", strerror (errno));
+        return -1;
+    }
+    int rc = bind (fd, (struct sockaddr *)&addr, sizeof (addr));
+    if (rc != 0 && errno == EADDRINUSE) {
+        int probe = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool alive = probe >= 0 && connect (probe, (struct sockaddr *)&addr, sizeof (addr)) == 0;
+        if (probe >= 0)
+            close (probe);
+        if (alive) {
+            LOGE ("Сервер уже працює на %s", path);
+            close (fd);
+            return -1;
+        }
+        (void)unlink (path);
+        rc = bind (fd, (struct sockaddr *)&addr, sizeof (addr));
+    }
+    if (rc != 0) {
+        LOGE ("Не вдалося відкрити сокет %s: %s", path, strerror (errno));
+        close (fd);
+        return -1;
+    }
+    (void)chmod (path, 0600);
+    if (listen (fd, 16) != 0) {
+        LOGE ("Не вдалося слухати сокет %s: %s", path, strerror (errno));
+        close (fd);
+        (void)unlink (path);
+        return -1;
+    }
+    return fd;
+}
+
+/** @copydoc serve_run */
+int serve_run (const char *socket_path, serve_job_fn fn, void *ctx) {
+    if (!fn)
+        return 1;
+    char path[108];
+    if (socket_path && socket_path[0]) {
+        if (strlen (socket_path) >= sizeof (path)) {
+            LOGE ("Шлях сокета задовгий: %s", socket_path);
+            return 1;
+        }
+        strcpy (path, socket_path);
+    } else if (serve_default_socket_path (path, sizeof (path)) != 0) {
+        LOGE ("Не вдалося визначити шлях сокета");
+        return 1;
+    }
+
+    /* Клієнт може відʼєднатися, не дочекавшись результату. */
+    signal (SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = serve_on_signal;
+    sigemptyset (&sa.sa_mask);
+    g_serve_stop = 0;
+    sigaction (SIGINT, &sa, NULL);
+    sigaction (SIGTERM, &sa, NULL);
+
+    int listen_fd = serve_listen (path);
+    if (listen_fd < 0)
+        return 1;
+
+    serve_queue_t q;
+    memset (&q, 0, sizeof (q));
+    q.fn = fn;
+    q.ctx = ctx;
+    pthread_mutex_init (&q.lock, NULL);
+    pthread_cond_init (&q.ready, NULL);
+
+    /* Сигнали зупинки обробляє лише потік прийому. */
+    sigset_t block, old;
+    sigemptyset (&block);
+    sigaddset (&block, SIGINT);
+    sigaddset (&block, SIGTERM);
+    pthread_sigmask (SIG_BLOCK, &block, &old);
+    pthread_t worker;
+    int spawn_rc = pthread_create (&worker, NULL, serve_worker_main, &q);
+    pthread_sigmask (SIG_SETMASK, &old, NULL);
+    if (spawn_rc != 0) {
+        LOGE ("Не вдалося запустити потік виконання завдань");
+        close (listen_fd);
+        (void)unlink (path);
+        pthread_cond_destroy (&q.ready);
+        pthread_mutex_destroy (&q.lock);
+        return 1;
+    }
+
+    LOGI ("Сервер: очікування завдань на %s", path);
+    unsigned long next_job = 1;
+    while (!g_serve_stop) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        int ready = poll (&pfd, 1, SERVE_POLL_MS);
+        if (ready > 0 && (pfd.revents & POLLIN))
+            serve_accept (&q, listen_fd, &next_job);
+    }
+    close (listen_fd);
+    (void)unlink (path);
+    LOGI ("Сервер: зупинка — завершується поточне завдання");
+
+    pthread_mutex_lock (&q.lock);
+    q.stop = true;
+    pthread_cond_signal (&q.ready);
+    pthread_mutex_unlock (&q.lock);
+    pthread_join (worker, NULL);
+
+    for (serve_request_t *req = q.head; req;) {
+        serve_request_t *next = req->next;
+        serve_reply_status (req->fd, req->job, 0, "сервер зупинено");
+        close (req->fd);
+        free (req->text);
+        free (req);
+        req = next;
+    }
+    pthread_cond_destroy (&q.ready);
+    pthread_mutex_destroy (&q.lock);
+    return 0;
+}
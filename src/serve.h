@@ -0,0 +1,66 @@
+/**
+ * @file serve.h
+ * @brief Сервер завдань на Unix-сокеті (`cplot serve`).
+ * @defgroup serve Сервер завдань
+ * @ingroup cli
+ * @details
+ * Клієнт підключається до сокета, надсилає одне завдання — рядок JSON, завершений `\n`
+ * (або закриттям запису), — і отримує два рядки JSON: підтвердження постановки в чергу
+ * `{"job":N,"queued":K}` і, після виконання, результат `{"job":N,...,"ok":true}`.
+ * Клієнт може відʼєднатися після першого рядка: завдання все одно виконається.
+ *
+ * Завдання виконуються по одному окремим потоком у порядку надходження; основний
+ * потік лише приймає підключення, тож нові завдання стають у чергу під час друку.
+ * SIGINT/SIGTERM зупиняють прийом: поточне завдання дописується, а ще не розпочаті
+ * отримують відповідь з помилкою.
+ */
+#ifndef CPLOT_SERVE_H
+#define CPLOT_SERVE_H
+
+#include <stddef.h>
+
+#include "jsw.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Найбільша кількість завдань у черзі (решта відхиляються одразу). */
+#define SERVE_QUEUE_MAX 64
+/** Найбільший розмір запиту, байт. */
+#define SERVE_REQUEST_MAX (16u << 20)
+
+/**
+ * @brief Виконує одне завдання.
+ * @param ctx Контекст, переданий у `serve_run`.
+ * @param job Номер завдання (від 1).
+ * @param request Текст запиту (без завершального `\n`; не завершений `\0`).
+ * @param len Довжина запиту, байт.
+ * @param reply Відкритий обʼєкт відповіді: обробник може додати ключі (`"error"` тощо).
+ * @return 0 — успіх; інакше помилка.
+ */
+typedef int (*serve_job_fn) (
+    void *ctx, unsigned long job, const char *request, size_t len, json_writer_t *reply);
+
+/**
+ * @brief Типовий шлях сокета: `$XDG_RUNTIME_DIR/cplot.sock` або `/tmp/cplot-UID.sock`.
+ * @param buf [out] Буфер.
+ * @param buflen Розмір буфера.
+ * @return 0 — успіх; -1 — замалий буфер.
+ */
+int serve_default_socket_path (char *buf, size_t buflen);
+
+/**
+ * @brief Слухає сокет і виконує завдання до SIGINT/SIGTERM.
+ * @param socket_path Шлях сокета (NULL або порожній — типовий).
+ * @param fn Обробник завдань.
+ * @param ctx Контекст обробника.
+ * @return 0 — штатна зупинка; 1 — не вдалося відкрити сокет або запустити потік.
+ */
+int serve_run (const char *socket_path, serve_job_fn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
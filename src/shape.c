@@ -4,8 +4,9 @@
  * @ingroup shape
  * @details
  * Формує полілінії для простих фігур. Кола/еліпси/заокруглення кутів
- * апроксимуються кубічними Безьє з параметром плоскості (`flatness`, мм)
- * через рекурсивне підділення.
+ * апроксимуються кубічними Безьє з параметром плоскості (`flatness`, мм):
+ * кількість відрізків кожної кривої обчислюється наперед за формулою Ванга,
+ * точки — прямими різницями. Допуск не буває дрібнішим за крок мотора.
  */
 
 #include "shape.h"
@@ -14,9 +15,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "axidraw.h"
+
 /** \brief Допуск для порівняння координат при замиканні контурів, мм. */
 #define SHAPE_TOL 1e-9
 
+/** \brief Верхня межа відрізків на одну криву (захист від завеликих координат). */
+#define SHAPE_MAX_SEGMENTS 4096
+
 /**
  * @brief Тимчасовий шлях для накопичення точок перед додаванням у `geom_paths_t`.
  */
@@ -76,24 +82,46 @@ static void shape_tmp_path_free (tmp_path_t *p) {
 }
 
 /**
- * @brief Відстань від точки `p` до прямої через `a`–`b`.
+ * @brief Кількість відрізків для кубічної кривої за формулою Ванга.
+ * @details Для ламаної з `n` рівних кроків параметра відхилення від кривої не
+ *          перевищує `3/4 · M / n²`, де `M` — найбільша друга різниця опорних
+ *          точок. Тож `n = ⌈√(0.75 · M / tol)⌉` гарантує допуск без підділення.
+ * @param p0,p1,p2,p3 Опорні точки кривої.
+ * @param tol Допуск апроксимації (мм; >0).
+ * @return Кількість відрізків у межах [1, SHAPE_MAX_SEGMENTS].
  */
-static double shape_dist_point_to_line (geom_point_t a, geom_point_t b, geom_point_t p) {
-    double vx = b.x - a.x, vy = b.y - a.y;
-    double wx = p.x - a.x, wy = p.y - a.y;
-    double denom = hypot (vx, vy);
-    if (denom <= SHAPE_TOL)
-        return hypot (wx, wy);
-    double cross = fabs (vx * wy - vy * wx);
-    return cross / denom;
+static size_t shape_cubic_segments (
+    geom_point_t p0, geom_point_t p1, geom_point_t p2, geom_point_t p3, double tol) {
+    double m = fmax (
+        hypot (p0.x - 2.0 * p1.x + p2.x, p0.y - 2.0 * p1.y + p2.y),
+        hypot (p1.x - 2.0 * p2.x + p3.x, p1.y - 2.0 * p2.y + p3.y));
+    double n = ceil (sqrt (0.75 * m / tol));
+    if (!(n >= 1.0))
+        return 1;
+    if (n > (double)SHAPE_MAX_SEGMENTS)
+        return SHAPE_MAX_SEGMENTS;
+    return (size_t)n;
 }
 
 /**
- * @brief Рекурсивно апроксимує кубічну криву Безьє ламаною з допуском `flatness`.
+ * @brief Найменший осмислений допуск: один крок мотора типового пристрою, мм.
+ * @details Дрібніших відхилень плотер не відтворить — вони лише множать точки.
+ */
+static double shape_step_flatness (void) {
+    const axidraw_device_profile_t *profile = axidraw_device_profile_default ();
+    if (!profile || !(profile->steps_per_mm > 0.0))
+        return 0.0;
+    return 1.0 / profile->steps_per_mm;
+}
+
+/**
+ * @brief Апроксимує кубічну криву Безьє ламаною з допуском `flatness`.
+ * @details Кількість відрізків обчислюється наперед (`shape_cubic_segments`),
+ *          буфер резервується один раз, а точки рахуються прямими різницями —
+ *          по три додавання на координату. Допуск не менший за крок мотора.
  * @param out Буфер вихідних точок (початкова точка має бути вже додана).
  * @param p0,p1,p2,p3 Опорні точки кубічної кривої.
  * @param flatness Максимально допустиме відхилення (мм).
- * @param depth Поточна глибина рекурсії (обмежена 20).
  * @return 0 — успіх; -1 — помилка памʼяті.
  */
 static int shape_flatten_cubic (
@@ -102,29 +130,38 @@ static int shape_flatten_cubic (
     geom_point_t p1,
     geom_point_t p2,
     geom_point_t p3,
-    double flatness,
-    int depth) {
-    if (depth > 20) {
-
-        return shape_tmp_path_push (out, p3.x, p3.y);
-    }
-    double d1 = shape_dist_point_to_line (p0, p3, p1);
-    double d2 = shape_dist_point_to_line (p0, p3, p2);
-    if (d1 <= flatness && d2 <= flatness) {
+    double flatness) {
+    size_t n = shape_cubic_segments (p0, p1, p2, p3, fmax (flatness, shape_step_flatness ()));
+    if (shape_tmp_path_reserve (out, out->len + n) != 0)
+        return -1;
 
-        return shape_tmp_path_push (out, p3.x, p3.y);
+    /* B(t) = a·t³ + b·t² + c·t + p0; різниці першого–третього порядку для кроку h. */
+    double h = 1.0 / (double)n;
+    double h2 = h * h, h3 = h2 * h;
+    double ax = -p0.x + 3.0 * (p1.x - p2.x) + p3.x;
+    double ay = -p0.y + 3.0 * (p1.y - p2.y) + p3.y;
+    double bx = 3.0 * (p0.x - 2.0 * p1.x + p2.x);
+    double by = 3.0 * (p0.y - 2.0 * p1.y + p2.y);
+    double cx = 3.0 * (p1.x - p0.x);
+    double cy = 3.0 * (p1.y - p0.y);
+    double d1x = ax * h3 + bx * h2 + cx * h, d1y = ay * h3 + by * h2 + cy * h;
+    double d2x = 6.0 * ax * h3 + 2.0 * bx * h2, d2y = 6.0 * ay * h3 + 2.0 * by * h2;
+    double d3x = 6.0 * ax * h3, d3y = 6.0 * ay * h3;
+
+    geom_point_t *dst = out->pts + out->len;
+    double x = p0.x, y = p0.y;
+    for (size_t i = 0; i + 1 < n; ++i) {
+        x += d1x;
+        y += d1y;
+        dst[i] = (geom_point_t){ x, y };
+        d1x += d2x;
+        d1y += d2y;
+        d2x += d3x;
+        d2y += d3y;
     }
-
-    geom_point_t p01 = { (p0.x + p1.x) * 0.5, (p0.y + p1.y) * 0.5 };
-    geom_point_t p12 = { (p1.x + p2.x) * 0.5, (p1.y + p2.y) * 0.5 };
-    geom_point_t p23 = { (p2.x + p3.x) * 0.5, (p2.y + p3.y) * 0.5 };
-    geom_point_t p012 = { (p01.x + p12.x) * 0.5, (p01.y + p12.y) * 0.5 };
-    geom_point_t p123 = { (p12.x + p23.x) * 0.5, (p12.y + p23.y) * 0.5 };
-    geom_point_t p0123 = { (p012.x + p123.x) * 0.5, (p012.y + p123.y) * 0.5 };
-    if (shape_flatten_cubic (out, p0, p01, p012, p0123, flatness, depth + 1) != 0)
-        return -1;
-    if (shape_flatten_cubic (out, p0123, p123, p23, p3, flatness, depth + 1) != 0)
-        return -1;
+    /* Кінцева точка — точно p3: накопичена похибка різниць не розриває стики дуг. */
+    dst[n - 1] = p3;
+    out->len += n;
     return 0;
 }
 
@@ -241,7 +278,7 @@ static int shape_round_rect_internal (
         geom_point_t p1 = { p0.x + k * rx, p0.y };
         geom_point_t p3 = { x1, y0 + ry };
         geom_point_t p2 = { p3.x, p3.y - k * ry };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0) {
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0) {
             shape_tmp_path_free (&tp);
             return -1;
         }
@@ -257,7 +294,7 @@ static int shape_round_rect_internal (
         geom_point_t p1 = { p0.x, p0.y + k * ry };
         geom_point_t p3 = { x1 - rx, y1 };
         geom_point_t p2 = { p3.x + k * rx, p3.y };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0) {
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0) {
             shape_tmp_path_free (&tp);
             return -1;
         }
@@ -273,7 +310,7 @@ static int shape_round_rect_internal (
         geom_point_t p1 = { p0.x - k * rx, p0.y };
         geom_point_t p3 = { x0, y1 - ry };
         geom_point_t p2 = { p3.x, p3.y + k * ry };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0) {
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0) {
             shape_tmp_path_free (&tp);
             return -1;
         }
@@ -289,7 +326,7 @@ static int shape_round_rect_internal (
         geom_point_t p1 = { p0.x, p0.y - k * ry };
         geom_point_t p3 = { x0 + rx, y0 };
         geom_point_t p2 = { p3.x - k * rx, p3.y };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0) {
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0) {
             shape_tmp_path_free (&tp);
             return -1;
         }
@@ -343,7 +380,7 @@ int shape_ellipse (geom_paths_t *out, double cx, double cy, double rx, double ry
         geom_point_t p1 = { p0.x, p0.y + k * ry };
         geom_point_t p3 = { cx, cy + ry };
         geom_point_t p2 = { p3.x + k * rx, p3.y };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0)
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0)
             goto fail;
         p0 = p3;
     }
@@ -352,7 +389,7 @@ int shape_ellipse (geom_paths_t *out, double cx, double cy, double rx, double ry
         geom_point_t p1 = { p0.x - k * rx, p0.y };
         geom_point_t p3 = { cx - rx, cy };
         geom_point_t p2 = { p3.x, p3.y + k * ry };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0)
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0)
             goto fail;
         p0 = p3;
     }
@@ -361,7 +398,7 @@ int shape_ellipse (geom_paths_t *out, double cx, double cy, double rx, double ry
         geom_point_t p1 = { p0.x, p0.y - k * ry };
         geom_point_t p3 = { cx, cy - ry };
         geom_point_t p2 = { p3.x - k * rx, p3.y };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0)
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0)
             goto fail;
         p0 = p3;
     }
@@ -370,7 +407,7 @@ int shape_ellipse (geom_paths_t *out, double cx, double cy, double rx, double ry
         geom_point_t p1 = { p0.x + k * rx, p0.y };
         geom_point_t p3 = (geom_point_t){ cx + rx, cy };
         geom_point_t p2 = { p3.x, p3.y - k * ry };
-        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0)
+        if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0)
             goto fail;
 
         if (shape_tmp_path_push (&tp, tp.pts[0].x, tp.pts[0].y) != 0)
@@ -414,7 +451,7 @@ int shape_bezier_cubic (
         shape_tmp_path_free (&tp);
         return -1;
     }
-    if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness, 0) != 0) {
+    if (shape_flatten_cubic (&tp, p0, p1, p2, p3, flatness) != 0) {
         shape_tmp_path_free (&tp);
         return -1;
     }
@@ -6,7 +6,8 @@
  * @details
  * Набір утиліт для генерації простих контурів у міліметрах: прямокутники,
  * заокруглені прямокутники, кола/еліпси, полілінії та криві Безьє. Криві
- * апроксимуються ламаними з контролем параметра плоскості (`flatness`, мм).
+ * апроксимуються ламаними з контролем параметра плоскості (`flatness`, мм);
+ * допуск, дрібніший за крок мотора типового пристрою, підвищується до кроку.
  */
 #ifndef CPLOT_SHAPE_H
 #define CPLOT_SHAPE_H
@@ -0,0 +1,144 @@
+/**
+ * @file sim.c
+ * @brief Реалізація імітації виконання плану.
+ * @ingroup sim
+ */
+
+#include "sim.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "jsw.h"
+#include "stepper.h"
+
+/** \brief Переводить затримку сервоприводу з мс у с (відʼємні — як у `axidraw_exec_pen`). */
+static double sim_delay_s (int delay_ms) { return delay_ms > 0 ? (double)delay_ms / 1000.0 : 0.0; }
+
+/**
+ * @copydoc sim_init
+ */
+void sim_init (sim_stats_t *stats, const axidraw_settings_t *settings, double speed_limit_mm_s) {
+    if (!stats)
+        return;
+    memset (stats, 0, sizeof (*stats));
+    if (settings) {
+        stats->pen_up_delay_s = sim_delay_s (settings->pen_up_delay_ms);
+        stats->pen_down_delay_s = sim_delay_s (settings->pen_down_delay_ms);
+        stats->lift_overlap_s = sim_delay_s (axidraw_pen_overlap_ms (settings, true));
+        stats->drop_overlap_s = sim_delay_s (axidraw_pen_overlap_ms (settings, false));
+    }
+    stats->bin_mm_s = (speed_limit_mm_s > 0.0 ? speed_limit_mm_s : 1.0) / SIM_SPEED_BINS;
+    stats->pen_up = true;
+    stats->servo_s = stats->pen_up_delay_s;
+}
+
+/**
+ * @copydoc sim_add_block
+ */
+void sim_add_block (sim_stats_t *stats, const plan_block_t *block) {
+    if (!stats || !block)
+        return;
+    if (block->pen_down && stats->pen_up) {
+        /* Опускання починається під час попереднього переїзду (як у сеансі `plot`). */
+        double overlap_s = floor (stats->last_travel_s * 1000.0) / 1000.0;
+        if (overlap_s > stats->drop_overlap_s)
+            overlap_s = stats->drop_overlap_s;
+        stats->servo_s += stats->pen_down_delay_s - overlap_s;
+        stats->pen_drops++;
+        stats->pen_up = false;
+    } else if (!block->pen_down && !stats->pen_up) {
+        stats->servo_s += stats->pen_up_delay_s - stats->lift_overlap_s;
+        stats->pen_lifts++;
+        stats->pen_up = true;
+    }
+    stats->blocks++;
+
+    double duration_s = stepper_block_duration_s (block);
+    stats->last_travel_s = block->pen_down ? 0.0 : duration_s;
+    if (!(duration_s > 0.0))
+        return;
+    if (block->pen_down) {
+        stats->draw_s += duration_s;
+        stats->draw_mm += block->length_mm;
+    } else {
+        stats->travel_s += duration_s;
+        stats->travel_mm += block->length_mm;
+    }
+
+    double speed = block->cruise_speed_mm_s > 0.0 ? block->cruise_speed_mm_s : 0.0;
+    if (speed > stats->max_speed_mm_s)
+        stats->max_speed_mm_s = speed;
+    size_t bin = (size_t)(speed / stats->bin_mm_s);
+    if (bin >= SIM_SPEED_BINS)
+        bin = SIM_SPEED_BINS - 1;
+    stats->hist_blocks[bin]++;
+    stats->hist_s[bin] += duration_s;
+}
+
+/**
+ * @copydoc sim_finish
+ */
+void sim_finish (sim_stats_t *stats) {
+    if (!stats || stats->pen_up)
+        return;
+    stats->servo_s += stats->pen_up_delay_s;
+    stats->pen_lifts++;
+    stats->pen_up = true;
+}
+
+/**
+ * @copydoc sim_total_s
+ */
+double sim_total_s (const sim_stats_t *stats) {
+    return stats ? stats->draw_s + stats->travel_s + stats->servo_s : 0.0;
+}
+
+/**
+ * @copydoc sim_write_json
+ */
+int sim_write_json (const sim_stats_t *stats, FILE *out) {
+    if (!stats || !out)
+        return -1;
+    json_writer_t w;
+    jsw_jsonw_init (&w, out);
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "duration_s");
+    jsw_jsonw_double (&w, sim_total_s (stats));
+    jsw_jsonw_key (&w, "draw_s");
+    jsw_jsonw_double (&w, stats->draw_s);
+    jsw_jsonw_key (&w, "travel_s");
+    jsw_jsonw_double (&w, stats->travel_s);
+    jsw_jsonw_key (&w, "servo_s");
+    jsw_jsonw_double (&w, stats->servo_s);
+    jsw_jsonw_key (&w, "draw_mm");
+    jsw_jsonw_double (&w, stats->draw_mm);
+    jsw_jsonw_key (&w, "travel_mm");
+    jsw_jsonw_double (&w, stats->travel_mm);
+    jsw_jsonw_key (&w, "blocks");
+    jsw_jsonw_int (&w, (long long)stats->blocks);
+    jsw_jsonw_key (&w, "pen_lifts");
+    jsw_jsonw_int (&w, (long long)stats->pen_lifts);
+    jsw_jsonw_key (&w, "pen_drops");
+    jsw_jsonw_int (&w, (long long)stats->pen_drops);
+    jsw_jsonw_key (&w, "max_speed_mm_s");
+    jsw_jsonw_double (&w, stats->max_speed_mm_s);
+    jsw_jsonw_key (&w, "speed_histogram");
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "bin_mm_s");
+    jsw_jsonw_double (&w, stats->bin_mm_s);
+    jsw_jsonw_key (&w, "blocks");
+    jsw_jsonw_begin_array (&w);
+    for (size_t i = 0; i < SIM_SPEED_BINS; ++i)
+        jsw_jsonw_int (&w, (long long)stats->hist_blocks[i]);
+    jsw_jsonw_end_array (&w);
+    jsw_jsonw_key (&w, "seconds");
+    jsw_jsonw_begin_array (&w);
+    for (size_t i = 0; i < SIM_SPEED_BINS; ++i)
+        jsw_jsonw_double (&w, stats->hist_s[i]);
+    jsw_jsonw_end_array (&w);
+    jsw_jsonw_end_object (&w);
+    jsw_jsonw_end_object (&w);
+    fputc ('\n', out);
+    return ferror (out) ? -1 : 0;
+}
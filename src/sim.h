@@ -0,0 +1,92 @@
+/**
+ * @file sim.h
+ * @brief Імітація виконання плану: тривалість друку та підсумки руху без пристрою.
+ * @defgroup sim Оцінка тривалості
+ * @ingroup stepper
+ * @details
+ * Накопичує підсумки для послідовності блоків плану так, як їх виконав би сеанс
+ * `plot`: час руху береться з трапецієвидних профілів (`stepper_block_duration_s`),
+ * а кожна зміна стану пера додає затримку сервоприводу з `axidraw_settings_t` за
+ * вирахуванням її перекриття з переїздом (`axidraw_pen_overlap_ms`).
+ * Журналів на блок чи фазу немає, тож мільйони блоків обробляються за частки секунди.
+ */
+#ifndef CPLOT_SIM_H
+#define CPLOT_SIM_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "axidraw.h"
+#include "planner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Кількість інтервалів гістограми крейсерських швидкостей. */
+#define SIM_SPEED_BINS 16
+
+/**
+ * @brief Підсумки імітації.
+ */
+typedef struct {
+    unsigned long blocks;                      /**< Кількість виконаних блоків. */
+    double draw_s;                             /**< Рух з опущеним пером, с. */
+    double travel_s;                           /**< Рух з піднятим пером, с. */
+    double servo_s;                            /**< Очікування сервоприводу пера, с. */
+    double draw_mm;                            /**< Шлях з опущеним пером, мм. */
+    double travel_mm;                          /**< Шлях з піднятим пером, мм. */
+    unsigned long pen_lifts;                   /**< Підйоми пера після малювання. */
+    unsigned long pen_drops;                   /**< Опускання пера. */
+    double max_speed_mm_s;                     /**< Найбільша крейсерська швидкість, мм/с. */
+    double bin_mm_s;                           /**< Ширина інтервалу гістограми, мм/с. */
+    unsigned long hist_blocks[SIM_SPEED_BINS]; /**< Блоки за інтервалами швидкості. */
+    double hist_s[SIM_SPEED_BINS];             /**< Час руху за інтервалами швидкості, с. */
+    bool pen_up;                               /**< Поточний стан пера. */
+    double pen_up_delay_s;                     /**< Затримка підйому пера, с. */
+    double pen_down_delay_s;                   /**< Затримка опускання пера, с. */
+    double lift_overlap_s;                     /**< Перекриття підйому з переїздом, с. */
+    double drop_overlap_s;                     /**< Перекриття опускання з переїздом, с. */
+    double last_travel_s;                      /**< Тривалість попереднього переїзду, с. */
+} sim_stats_t;
+
+/**
+ * @brief Починає імітацію: перо піднімається, як під час відкриття сеансу.
+ * @param stats [out] Підсумки.
+ * @param settings Налаштування пристрою (затримки пера).
+ * @param speed_limit_mm_s Верхня межа гістограми швидкостей, мм/с (> 0).
+ */
+void sim_init (sim_stats_t *stats, const axidraw_settings_t *settings, double speed_limit_mm_s);
+
+/**
+ * @brief Додає блок плану (з перемиканням пера за потреби).
+ * @param stats Підсумки.
+ * @param block Блок плану.
+ */
+void sim_add_block (sim_stats_t *stats, const plan_block_t *block);
+
+/**
+ * @brief Завершує імітацію: опущене перо піднімається, як під час закриття сеансу.
+ * @param stats Підсумки.
+ */
+void sim_finish (sim_stats_t *stats);
+
+/**
+ * @brief Загальна тривалість: рух і сервопривід, с.
+ * @param stats Підсумки.
+ */
+double sim_total_s (const sim_stats_t *stats);
+
+/**
+ * @brief Друкує підсумки одним JSON‑обʼєктом (з переведенням рядка).
+ * @param stats Підсумки.
+ * @param out Потік виводу.
+ * @return 0 — успіх; -1 — помилка запису.
+ */
+int sim_write_json (const sim_stats_t *stats, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file sink.c
+ * @brief Реалізація приймачів байтів.
+ * @ingroup sink
+ */
+
+#include "sink.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** \brief Запис у `FILE*`. */
+static int sink_file_write (void *ctx, const uint8_t *data, size_t len) {
+    return fwrite (data, 1, len, (FILE *)ctx) == len ? 0 : -1;
+}
+
+/** \brief Запис у дескриптор; повторює частковий запис і перериваний `EINTR`. */
+static int sink_fd_write (void *ctx, const uint8_t *data, size_t len) {
+    int fd = (int)(intptr_t)ctx;
+    while (len > 0) {
+        ssize_t n = write (fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/** \brief Дописування у буфер памʼяті з подвоєнням ємності. */
+static int sink_memory_write (void *ctx, const uint8_t *data, size_t len) {
+    sink_memory_t *mem = (sink_memory_t *)ctx;
+    size_t need = mem->len + len;
+    if (need > mem->cap) {
+        size_t new_cap = mem->cap ? mem->cap : 4096;
+        while (new_cap < need)
+            new_cap *= 2;
+        uint8_t *grown = (uint8_t *)realloc (mem->bytes, new_cap);
+        if (!grown)
+            return -1;
+        mem->bytes = grown;
+        mem->cap = new_cap;
+    }
+    memcpy (mem->bytes + mem->len, data, len);
+    mem->len += len;
+    return 0;
+}
+
+/**
+ * @copydoc sink_init_file
+ */
+void sink_init_file (sink_t *sink, FILE *fp) {
+    memset (sink, 0, sizeof (*sink));
+    sink->write = sink_file_write;
+    sink->ctx = fp;
+}
+
+/**
+ * @copydoc sink_init_fd
+ */
+void sink_init_fd (sink_t *sink, int fd) {
+    memset (sink, 0, sizeof (*sink));
+    sink->write = sink_fd_write;
+    sink->ctx = (void *)(intptr_t)fd;
+}
+
+/**
+ * @copydoc sink_init_memory
+ */
+void sink_init_memory (sink_t *sink, sink_memory_t *mem) {
+    memset (sink, 0, sizeof (*sink));
+    sink->write = sink_memory_write;
+    sink->ctx = mem;
+}
+
+/**
+ * @copydoc sink_write
+ */
+int sink_write (sink_t *sink, const void *data, size_t len) {
+    if (!sink || sink->failed)
+        return -1;
+    if (len == 0)
+        return 0;
+    if (!sink->write || sink->write (sink->ctx, (const uint8_t *)data, len) != 0) {
+        sink->failed = 1;
+        return -1;
+    }
+    sink->written += len;
+    return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file sink.h
+ * @brief Приймач байтів для потокового виводу (FILE*, дескриптор, памʼять).
+ * @defgroup sink Приймач виводу
+ * @ingroup util
+ * @details
+ * Кодери превʼю (SVG, PNG) пишуть результат шматками через `sink_write`, не
+ * тримаючи весь файл у памʼяті. Приймач запамʼятовує першу помилку запису: подальші
+ * виклики нічого не роблять і повертають -1, тож кодер може перевіряти лише
+ * результат наприкінці.
+ */
+#ifndef CPLOT_SINK_H
+#define CPLOT_SINK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Функція запису шматка байтів.
+ * @param ctx Контекст приймача.
+ * @param data Дані.
+ * @param len Довжина, байт.
+ * @return 0 — успіх; -1 — помилка запису.
+ */
+typedef int (*sink_write_fn) (void *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Приймач байтів.
+ */
+typedef struct sink {
+    sink_write_fn write; /**< Функція запису. */
+    void *ctx;           /**< Контекст для `write`. */
+    size_t written;      /**< Усього успішно записано байтів. */
+    int failed;          /**< Ненульове після першої помилки. */
+} sink_t;
+
+/**
+ * @brief Буфер у памʼяті для `sink_init_memory`.
+ */
+typedef struct sink_memory {
+    uint8_t *bytes; /**< Дані (malloc; звільняє власник). */
+    size_t len;     /**< Довжина даних. */
+    size_t cap;     /**< Ємність буфера. */
+} sink_memory_t;
+
+/**
+ * @brief Приймач, що пише у потік `FILE*` (буферизація — засобами stdio).
+ * @param sink [out] Приймач.
+ * @param fp Відкритий потік.
+ */
+void sink_init_file (sink_t *sink, FILE *fp);
+
+/**
+ * @brief Приймач, що пише у файловий дескриптор (`write`, з дозаписом при частковому записі).
+ * @param sink [out] Приймач.
+ * @param fd Відкритий дескриптор.
+ */
+void sink_init_fd (sink_t *sink, int fd);
+
+/**
+ * @brief Приймач, що накопичує байти у памʼяті.
+ * @param sink [out] Приймач.
+ * @param mem [in,out] Буфер (має бути обнулений або вже ініціалізований).
+ */
+void sink_init_memory (sink_t *sink, sink_memory_t *mem);
+
+/**
+ * @brief Записує шматок у приймач.
+ * @param sink Приймач.
+ * @param data Дані (може бути NULL при `len == 0`).
+ * @param len Довжина, байт.
+ * @return 0 — успіх; -1 — помилка (зараз або раніше).
+ */
+int sink_write (sink_t *sink, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
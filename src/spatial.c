@@ -0,0 +1,282 @@
+/**
+ * @file spatial.c
+ * @brief Реалізація просторового індексу відрізків.
+ * @ingroup spatial
+ * @details
+ * Розмір клітинки — як у сітці `pathopt`: близько двох відрізків на клітинку, але
+ * не менше за середній розмах відрізка, щоб довгі відрізки не розмножувались у
+ * десятки клітинок; кількість клітинок не перевищує 4·n. Побудова — два проходи:
+ * підрахунок записів на клітинку, тоді розкладання в суцільний масив.
+ */
+
+#include "spatial.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Кількість відрізків контуру (шлях з однієї точки — один відрізок-точка).
+ */
+static size_t spatial_path_segments (const geom_path_t *p) {
+    return p->len >= 2 ? p->len - 1 : p->len;
+}
+
+/** \brief Індекс клітинки по осі з обмеженням до меж сітки. */
+static size_t spatial_axis (double v, double min, double cell, size_t n) {
+    double f = floor ((v - min) / cell);
+    if (!(f > 0.0))
+        return 0;
+    if (f >= (double)n)
+        return n - 1;
+    return (size_t)f;
+}
+
+/**
+ * @copydoc spatial_segment
+ */
+void spatial_segment (
+    const spatial_index_t *ix, const spatial_ref_t *ref, geom_point_t *a, geom_point_t *b) {
+    const geom_path_t *p = &ix->paths->items[ref->path];
+    *a = p->pts[ref->seg];
+    *b = p->pts[ref->seg + 1 < p->len ? ref->seg + 1 : ref->seg];
+}
+
+/**
+ * @brief Межі відрізка.
+ */
+static geom_bbox_t spatial_segment_bbox (const spatial_index_t *ix, const spatial_ref_t *ref) {
+    geom_point_t a, b;
+    spatial_segment (ix, ref, &a, &b);
+    return (geom_bbox_t){ fmin (a.x, b.x), fmin (a.y, b.y), fmax (a.x, b.x), fmax (a.y, b.y) };
+}
+
+/**
+ * @brief Діапазон клітинок, які перекривають межі `bb`.
+ */
+static void spatial_cell_range (
+    const spatial_index_t *ix,
+    const geom_bbox_t *bb,
+    size_t *x0,
+    size_t *y0,
+    size_t *x1,
+    size_t *y1) {
+    *x0 = spatial_axis (bb->min_x, ix->bounds.min_x, ix->cell, ix->gx);
+    *y0 = spatial_axis (bb->min_y, ix->bounds.min_y, ix->cell, ix->gy);
+    *x1 = spatial_axis (bb->max_x, ix->bounds.min_x, ix->cell, ix->gx);
+    *y1 = spatial_axis (bb->max_y, ix->bounds.min_y, ix->cell, ix->gy);
+}
+
+/**
+ * @copydoc spatial_index_free
+ */
+void spatial_index_free (spatial_index_t *ix) {
+    if (!ix)
+        return;
+    free (ix->cell_start);
+    free (ix->refs);
+    free (ix->seg_first);
+    memset (ix, 0, sizeof (*ix));
+}
+
+/**
+ * @copydoc spatial_index_build
+ */
+int spatial_index_build (spatial_index_t *ix, const geom_paths_t *paths) {
+    if (!ix || !paths)
+        return -1;
+    memset (ix, 0, sizeof (*ix));
+    ix->paths = paths;
+    ix->seg_first = (size_t *)malloc ((paths->len + 1) * sizeof (size_t));
+    if (!ix->seg_first)
+        return -1;
+
+    /* Межі та середній розмах відрізків — для розміру клітинки. */
+    double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    double extent = 0.0;
+    size_t segments = 0;
+    for (size_t i = 0; i < paths->len; ++i) {
+        const geom_path_t *p = &paths->items[i];
+        ix->seg_first[i] = segments;
+        segments += spatial_path_segments (p);
+        for (size_t k = 0; k < p->len; ++k) {
+            min_x = fmin (min_x, p->pts[k].x);
+            max_x = fmax (max_x, p->pts[k].x);
+            min_y = fmin (min_y, p->pts[k].y);
+            max_y = fmax (max_y, p->pts[k].y);
+            if (k > 0)
+                extent += fmax (
+                    fabs (p->pts[k].x - p->pts[k - 1].x), fabs (p->pts[k].y - p->pts[k - 1].y));
+        }
+    }
+    ix->seg_first[paths->len] = segments;
+    ix->segments = segments;
+    if (segments == 0) {
+        ix->gx = ix->gy = 1;
+        ix->cell = 1.0;
+        ix->cell_start = (size_t *)calloc (2, sizeof (size_t));
+        if (!ix->cell_start) {
+            spatial_index_free (ix);
+            return -1;
+        }
+        return 0;
+    }
+    ix->bounds = (geom_bbox_t){ min_x, min_y, max_x, max_y };
+
+    double w = fmax (max_x - min_x, 1e-6);
+    double h = fmax (max_y - min_y, 1e-6);
+    double cell = sqrt (w * h / (double)segments) * 1.4142135623730951;
+    cell = fmax (fmax (cell, extent / (double)segments), 1e-6);
+    size_t max_cells = 4 * segments + 16;
+    for (;;) {
+        double gx = ceil (w / cell);
+        double gy = ceil (h / cell);
+        if (gx * gy <= (double)max_cells) {
+            ix->gx = gx < 1.0 ? 1u : (size_t)gx;
+            ix->gy = gy < 1.0 ? 1u : (size_t)gy;
+            break;
+        }
+        cell *= 1.5;
+    }
+    ix->cell = cell;
+
+    size_t cells = ix->gx * ix->gy;
+    ix->cell_start = (size_t *)calloc (cells + 1, sizeof (size_t));
+    size_t *fill = (size_t *)malloc (cells * sizeof (size_t));
+    if (!ix->cell_start || !fill) {
+        free (fill);
+        spatial_index_free (ix);
+        return -1;
+    }
+    for (size_t i = 0; i < paths->len; ++i) {
+        size_t n = spatial_path_segments (&paths->items[i]);
+        for (size_t s = 0; s < n; ++s) {
+            spatial_ref_t ref = { i, s };
+            geom_bbox_t bb = spatial_segment_bbox (ix, &ref);
+            size_t x0, y0, x1, y1;
+            spatial_cell_range (ix, &bb, &x0, &y0, &x1, &y1);
+            for (size_t cy = y0; cy <= y1; ++cy)
+                for (size_t cx = x0; cx <= x1; ++cx)
+                    ix->cell_start[cy * ix->gx + cx + 1]++;
+        }
+    }
+    for (size_t c = 0; c < cells; ++c)
+        ix->cell_start[c + 1] += ix->cell_start[c];
+    size_t total = ix->cell_start[cells];
+    ix->refs = (spatial_ref_t *)malloc ((total ? total : 1) * sizeof (spatial_ref_t));
+    if (!ix->refs) {
+        free (fill);
+        spatial_index_free (ix);
+        return -1;
+    }
+    memcpy (fill, ix->cell_start, cells * sizeof (size_t));
+    for (size_t i = 0; i < paths->len; ++i) {
+        size_t n = spatial_path_segments (&paths->items[i]);
+        for (size_t s = 0; s < n; ++s) {
+            spatial_ref_t ref = { i, s };
+            geom_bbox_t bb = spatial_segment_bbox (ix, &ref);
+            size_t x0, y0, x1, y1;
+            spatial_cell_range (ix, &bb, &x0, &y0, &x1, &y1);
+            for (size_t cy = y0; cy <= y1; ++cy)
+                for (size_t cx = x0; cx <= x1; ++cx)
+                    ix->refs[fill[cy * ix->gx + cx]++] = ref;
+        }
+    }
+    free (fill);
+    return 0;
+}
+
+/**
+ * @copydoc spatial_index_query
+ */
+int spatial_index_query (
+    const spatial_index_t *ix, const geom_bbox_t *region, spatial_visit_fn fn, void *ctx) {
+    if (!ix || !region || !fn || !ix->cell_start)
+        return -1;
+    if (ix->segments == 0 || region->max_x < ix->bounds.min_x || region->min_x > ix->bounds.max_x
+        || region->max_y < ix->bounds.min_y || region->min_y > ix->bounds.max_y)
+        return 0;
+    size_t rx0, ry0, rx1, ry1;
+    spatial_cell_range (ix, region, &rx0, &ry0, &rx1, &ry1);
+    for (size_t cy = ry0; cy <= ry1; ++cy) {
+        for (size_t cx = rx0; cx <= rx1; ++cx) {
+            size_t c = cy * ix->gx + cx;
+            for (size_t k = ix->cell_start[c]; k < ix->cell_start[c + 1]; ++k) {
+                const spatial_ref_t *ref = &ix->refs[k];
+                geom_bbox_t bb = spatial_segment_bbox (ix, ref);
+                if (bb.max_x < region->min_x || bb.min_x > region->max_x
+                    || bb.max_y < region->min_y || bb.min_y > region->max_y)
+                    continue;
+                /* Відрізок є в усіх клітинках своїх меж — видаємо лише в першій спільній. */
+                size_t sx0, sy0, sx1, sy1;
+                spatial_cell_range (ix, &bb, &sx0, &sy0, &sx1, &sy1);
+                if (cx != (sx0 > rx0 ? sx0 : rx0) || cy != (sy0 > ry0 ? sy0 : ry0))
+                    continue;
+                int rc = fn (ctx, ref);
+                if (rc != 0)
+                    return rc;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Накопичувач номерів контурів для `spatial_index_paths`.
+ */
+typedef struct {
+    size_t *items; /**< Номери (з повторами). */
+    size_t len;    /**< Кількість. */
+    size_t cap;    /**< Ємність. */
+} spatial_path_list_t;
+
+/** \brief Обробник запиту: додає контур відрізка. */
+static int spatial_collect_path (void *ctx, const spatial_ref_t *ref) {
+    spatial_path_list_t *list = (spatial_path_list_t *)ctx;
+    if (list->len > 0 && list->items[list->len - 1] == ref->path)
+        return 0;
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        size_t *grown = (size_t *)realloc (list->items, cap * sizeof (size_t));
+        if (!grown)
+            return -1;
+        list->items = grown;
+        list->cap = cap;
+    }
+    list->items[list->len++] = ref->path;
+    return 0;
+}
+
+/** \brief Порівняння номерів для `qsort`. */
+static int spatial_cmp_size (const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @copydoc spatial_index_paths
+ */
+int spatial_index_paths (
+    const spatial_index_t *ix, const geom_bbox_t *region, size_t **out, size_t *out_count) {
+    if (!out || !out_count)
+        return -1;
+    *out = NULL;
+    *out_count = 0;
+    spatial_path_list_t list = { 0 };
+    if (spatial_index_query (ix, region, spatial_collect_path, &list) != 0) {
+        free (list.items);
+        return -1;
+    }
+    if (list.len == 0) {
+        free (list.items);
+        return 0;
+    }
+    qsort (list.items, list.len, sizeof (size_t), spatial_cmp_size);
+    size_t n = 1;
+    for (size_t i = 1; i < list.len; ++i)
+        if (list.items[i] != list.items[n - 1])
+            list.items[n++] = list.items[i];
+    *out = list.items;
+    *out_count = n;
+    return 0;
+}
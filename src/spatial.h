@@ -0,0 +1,107 @@
+/**
+ * @file spatial.h
+ * @brief Просторовий індекс відрізків контурів на рівномірній сітці.
+ * @defgroup spatial Просторовий індекс
+ * @ingroup geom
+ * @details
+ * Межі кожного відрізка `geom_paths_t` розкладаються по клітинках рівномірної
+ * сітки, які вони перекривають (сортування підрахунком, суцільний масив записів).
+ * Запит «які відрізки перетинають прямокутник» переглядає лише клітинки цього
+ * прямокутника, тож обрізання рамкою чи розкладання по плитках — O(n) на побудову
+ * плюс розмір відповіді, а не O(n × плиток). Відрізок шляху з однієї точки —
+ * сама точка.
+ */
+#ifndef CPLOT_SPATIAL_H
+#define CPLOT_SPATIAL_H
+
+#include <stddef.h>
+
+#include "geom.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Посилання на відрізок.
+ */
+typedef struct {
+    size_t path; /**< Контур. */
+    size_t seg;  /**< Відрізок контуру: точки `seg` і `seg + 1`. */
+} spatial_ref_t;
+
+/**
+ * @brief Індекс відрізків набору контурів.
+ */
+typedef struct {
+    const geom_paths_t *paths; /**< Проіндексовані контури (мають жити довше за індекс). */
+    geom_bbox_t bounds;        /**< Межі всіх відрізків. */
+    double cell;               /**< Розмір клітинки. */
+    size_t gx;                 /**< Кількість клітинок по X. */
+    size_t gy;                 /**< Кількість клітинок по Y. */
+    size_t *cell_start;        /**< Початок клітинки в `refs` (gx·gy + 1 елементів). */
+    spatial_ref_t *refs;       /**< Відрізки, згруповані за клітинками. */
+    size_t *seg_first;         /**< Наскрізний номер першого відрізка контуру (len + 1). */
+    size_t segments;           /**< Кількість відрізків. */
+} spatial_index_t;
+
+/**
+ * @brief Обробник відрізка, знайденого запитом.
+ * @param ctx Контекст викликача.
+ * @param ref Відрізок.
+ * @return 0 — продовжити; інше — зупинити запит із цим кодом.
+ */
+typedef int (*spatial_visit_fn) (void *ctx, const spatial_ref_t *ref);
+
+/**
+ * @brief Будує індекс відрізків.
+ * @param ix [out] Індекс (звільнити `spatial_index_free`).
+ * @param paths Контури; не змінюються, поки індекс використовується.
+ * @return 0 — успіх; -1 — аргументи або памʼять.
+ */
+int spatial_index_build (spatial_index_t *ix, const geom_paths_t *paths);
+
+/**
+ * @brief Звільняє індекс.
+ */
+void spatial_index_free (spatial_index_t *ix);
+
+/**
+ * @brief Кінці відрізка.
+ * @param ix Індекс.
+ * @param ref Відрізок.
+ * @param a [out] Перша точка.
+ * @param b [out] Друга точка (для контуру з однієї точки — та сама).
+ */
+void spatial_segment (
+    const spatial_index_t *ix, const spatial_ref_t *ref, geom_point_t *a, geom_point_t *b);
+
+/**
+ * @brief Відвідує кожен відрізок, межі якого перетинають `region` (межі включно).
+ * @details Відрізок, що лежить у кількох клітинках, видається один раз — у першій
+ *          з клітинок перетину його меж із запитом. Порядок — за клітинками.
+ * @param ix Індекс.
+ * @param region Прямокутник запиту.
+ * @param fn Обробник.
+ * @param ctx Контекст обробника.
+ * @return 0 — успіх; -1 — аргументи; інше — код зупинки від `fn`.
+ */
+int spatial_index_query (
+    const spatial_index_t *ix, const geom_bbox_t *region, spatial_visit_fn fn, void *ctx);
+
+/**
+ * @brief Контури, відрізки яких перетинають `region`.
+ * @param ix Індекс.
+ * @param region Прямокутник запиту.
+ * @param out [out] Номери контурів за зростанням (malloc; NULL, якщо порожньо).
+ * @param out_count [out] Кількість номерів.
+ * @return 0 — успіх; -1 — аргументи або памʼять.
+ */
+int spatial_index_paths (
+    const spatial_index_t *ix, const geom_bbox_t *region, size_t **out, size_t *out_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,7 +6,9 @@
  * Розбиває кожен блок руху на фази (розгін/круїз/гальмування), розподіляє кроки
  * між осями A/B та обчислює початкові швидкості/прискорення в одиницях EBB
  * (інтервали 40 мкс, фіксована‑кома частоти кроків). За `dry_run` команди на
- * пристрій не надсилаються, генеруються лише журнали.
+ * пристрій не надсилаються, генеруються лише журнали. У режимі `merge_phases`
+ * сусідні фази з однаковим прискоренням уздовж однієї прямої видаються однією
+ * командою LM.
  */
 
 #include "stepper.h"
@@ -14,13 +16,28 @@
 #include <limits.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "log.h"
+#include "trace.h"
+#include "ttime.h"
 
 /** \brief Допуск для ігнорування дуже коротких відрізків, мм. */
 #define STEPPER_EPS_MM 1e-6
 /** \brief Допуск для перевірки нульових швидкостей. */
 #define SPEED_EPS 1e-6
+/** \brief Найбільше відхилення проміжної точки від хорди обʼєднаної фази, кроки. */
+#define STEPPER_MERGE_TOL_STEPS 0.5
+/** \brief Відносний допуск збігу швидкостей і прискорень обʼєднуваних фаз. */
+#define STEPPER_MERGE_REL_EPS 1e-6
+/** \brief Скількома сходинками сталого прискорення наближається зміна прискорення S‑кривої. */
+#define STEPPER_SCURVE_RAMP_SPLIT 2
+/** \brief Найкоротша фаза S‑кривої, мм: коротші зливаються з сусідньою (≈ 4 кроки). */
+#define STEPPER_SCURVE_MIN_PHASE_MM 0.05
+/** \brief Найбільша кількість фаз однієї S‑подібної зміни швидкості. */
+#define STEPPER_SCURVE_MAX_PHASES (2 * STEPPER_SCURVE_RAMP_SPLIT + 1)
+/** \brief Найбільша кількість фаз блоку: дві зміни швидкості та круїз. */
+#define STEPPER_BLOCK_MAX_PHASES (2 * STEPPER_SCURVE_MAX_PHASES + 1)
 
 /**
  * @brief Одна фаза руху всередині блоку (розгін/круїз/гальмування).
@@ -84,16 +101,15 @@ stepper_emit_phase (stepper_context_t *ctx, const stepper_phase_t *phase, bool s
     }
 
     const char *mode = (send_command && ctx->cfg.dev != NULL) ? "відправка" : "імітація";
-    log_print (
-        LOG_DEBUG,
-        "крокувач.фаза: блок №%lu фаза %zu/%zu режим=%s відстань=%.4f початок=%.3f кінець=%.3f "
-        "крокиA=%d крокиB=%d тривалість=%.4f",
-        phase->block_seq, phase->phase_index + 1, phase->phase_count, mode, phase->distance_mm,
-        phase->start_speed_mm_s, phase->end_speed_mm_s, phase->steps_a, phase->steps_b, duration_s);
+    TRACE_LOG (
+        TRACE_STEP_PHASE, phase->block_seq, phase->phase_index + 1, phase->phase_count, mode,
+        phase->distance_mm, phase->start_speed_mm_s, phase->end_speed_mm_s, phase->steps_a,
+        phase->steps_b, duration_s);
 
     if (!send_command || ctx->cfg.dev == NULL)
         return true;
 
+    axidraw_set_command_tag (ctx->cfg.dev, phase->block_seq);
     int rc = axidraw_move_lowlevel_phase_xy (
         ctx->cfg.dev, phase->distance_mm, phase->start_speed_mm_s, phase->end_speed_mm_s,
         phase->steps_a, phase->steps_b, duration_s);
@@ -107,84 +123,308 @@ stepper_emit_phase (stepper_context_t *ctx, const stepper_phase_t *phase, bool s
     return true;
 }
 
+/** \brief Прискорення вздовж фази з її довжини та крайових швидкостей, мм/с². */
+static double stepper_phase_accel (const stepper_phase_t *phase) {
+    return (phase->end_speed_mm_s * phase->end_speed_mm_s
+            - phase->start_speed_mm_s * phase->start_speed_mm_s)
+           / (2.0 * phase->distance_mm);
+}
+
+/** \brief Чи збігаються величини з відносним допуском `STEPPER_MERGE_REL_EPS`. */
+static bool stepper_nearly_equal (double a, double b) {
+    double scale = fmax (1.0, fmax (fabs (a), fabs (b)));
+    return fabs (a - b) <= STEPPER_MERGE_REL_EPS * scale;
+}
+
+/**
+ * @brief Чи можна продовжити відкладену фазу новою однією командою LM.
+ * @details Потрібні неперервна швидкість, однакове прискорення і той самий напрямок:
+ *          проміжна точка відхиляється від хорди не більше ніж на півкроку.
+ */
+static bool stepper_can_merge (
+    const stepper_pending_phase_t *pending,
+    const stepper_phase_t *phase,
+    double accel,
+    bool pen_down,
+    bool send) {
+    if (!pending->active || pending->send != send || pending->pen_down != pen_down)
+        return false;
+    if (!stepper_nearly_equal (pending->end_speed_mm_s, phase->start_speed_mm_s)
+        || !stepper_nearly_equal (pending->accel_mm_s2, accel))
+        return false;
+    double px = (double)pending->steps_x;
+    double py = (double)pending->steps_y;
+    double sx = px + (double)phase->steps_a;
+    double sy = py + (double)phase->steps_b;
+    double chord = hypot (sx, sy);
+    if (!(chord > 0.0) || px * (double)phase->steps_a + py * (double)phase->steps_b <= 0.0)
+        return false;
+    if (fabs (sx) > (double)INT32_MAX || fabs (sy) > (double)INT32_MAX)
+        return false;
+    return fabs (px * sy - py * sx) / chord <= STEPPER_MERGE_TOL_STEPS;
+}
+
+/**
+ * @copydoc stepper_flush
+ */
+bool stepper_flush (stepper_context_t *ctx) {
+    if (!ctx || !ctx->pending.active)
+        return true;
+    stepper_pending_phase_t *pending = &ctx->pending;
+    pending->active = false;
+    stepper_phase_t phase = {
+        .distance_mm = pending->distance_mm,
+        .start_speed_mm_s = pending->start_speed_mm_s,
+        .end_speed_mm_s = pending->end_speed_mm_s,
+        .steps_a = pending->steps_x,
+        .steps_b = pending->steps_y,
+        .duration_s = pending->duration_s,
+        .block_seq = pending->first_seq,
+        .phase_index = pending->phase_index,
+        .phase_count = pending->phase_count,
+    };
+    if (pending->phases > 1)
+        TRACE_LOG (TRACE_STEP_MERGED, pending->phases, pending->first_seq, pending->last_seq);
+    ++ctx->commands;
+    return stepper_emit_phase (ctx, &phase, pending->send);
+}
+
+/**
+ * @brief Додає фазу до відкладеної або, якщо обʼєднання неможливе, видає відкладену.
+ * @return true — успіх; false — помилка відправлення.
+ */
+static bool stepper_queue_phase (
+    stepper_context_t *ctx, const stepper_phase_t *phase, bool pen_down, bool send) {
+    if (phase->distance_mm <= STEPPER_EPS_MM || (phase->steps_a == 0 && phase->steps_b == 0))
+        return true;
+    stepper_pending_phase_t *pending = &ctx->pending;
+    double accel = stepper_phase_accel (phase);
+    if (stepper_can_merge (pending, phase, accel, pen_down, send)) {
+        pending->distance_mm += phase->distance_mm;
+        pending->end_speed_mm_s = phase->end_speed_mm_s;
+        pending->steps_x += phase->steps_a;
+        pending->steps_y += phase->steps_b;
+        pending->duration_s += phase->duration_s;
+        pending->last_seq = phase->block_seq;
+        ++pending->phases;
+        ++ctx->merged_phases;
+        return true;
+    }
+    if (!stepper_flush (ctx))
+        return false;
+    *pending = (stepper_pending_phase_t){
+        .active = true,
+        .send = send,
+        .pen_down = pen_down,
+        .distance_mm = phase->distance_mm,
+        .start_speed_mm_s = phase->start_speed_mm_s,
+        .end_speed_mm_s = phase->end_speed_mm_s,
+        .accel_mm_s2 = accel,
+        .steps_x = phase->steps_a,
+        .steps_y = phase->steps_b,
+        .duration_s = phase->duration_s,
+        .first_seq = phase->block_seq,
+        .last_seq = phase->block_seq,
+        .phase_index = phase->phase_index,
+        .phase_count = phase->phase_count,
+        .phases = 1,
+    };
+    return true;
+}
+
 /**
  * @copydoc stepper_init
  */
 void stepper_init (stepper_context_t *ctx, const stepper_config_t *cfg) {
     if (!ctx)
         return;
-    if (cfg) {
+    memset (ctx, 0, sizeof (*ctx));
+    if (cfg)
         ctx->cfg = *cfg;
-    } else {
-        ctx->cfg.dev = NULL;
-    }
-    ctx->emitted_blocks = 0;
 }
 
-/** \brief Конвертує зміщення блоку у кроки по осях X/Y через AxiDraw. */
+/**
+ * @brief Конвертує зміщення блоку у кроки X/Y з переносом дробової частини.
+ * @details Залишок округлення зберігається в контексті і додається до наступного
+ *          блоку, а видані кроки — до абсолютної позиції.
+ */
 static void stepper_mm_to_steps (
-    const stepper_context_t *ctx,
-    const plan_block_t *block,
-    int32_t *steps_x_out,
-    int32_t *steps_y_out) {
-    int32_t sx = 0, sy = 0;
-    if (ctx && ctx->cfg.dev) {
-        sx = axidraw_mm_to_steps (ctx->cfg.dev, block->delta_mm[0]);
-        sy = axidraw_mm_to_steps (ctx->cfg.dev, block->delta_mm[1]);
-    } else {
+    stepper_context_t *ctx, const plan_block_t *block, int32_t *steps_x_out, int32_t *steps_y_out) {
+    int32_t steps[2] = { 0, 0 };
+    const axidraw_settings_t *cfg = ctx->cfg.dev ? axidraw_device_settings (ctx->cfg.dev) : NULL;
+    double spmm = (cfg && cfg->steps_per_mm > 0.0) ? cfg->steps_per_mm : 0.0;
+    if (!ctx->cfg.dev) {
         LOGE ("крокувач: відсутній пристрій для конвертації мм→кроки (потрібен профіль пристрою)");
+    } else if (!(spmm > 0.0)) {
+        LOGE ("Крокувач: коефіцієнт кроків на мм не встановлено — профіль не застосовано");
+    } else {
+        for (int axis = 0; axis < 2; ++axis) {
+            double exact = block->delta_mm[axis] * spmm + ctx->residual_steps[axis];
+            steps[axis] = stepper_clamp_i32 (exact);
+            if (!isfinite (exact))
+                exact = 0.0;
+            ctx->residual_steps[axis] = exact - (double)steps[axis];
+            ctx->position_steps[axis] += steps[axis];
+        }
     }
-    if (steps_x_out)
-        *steps_x_out = sx;
-    if (steps_y_out)
-        *steps_y_out = sy;
+    *steps_x_out = steps[0];
+    *steps_y_out = steps[1];
 }
 
 /**
- * @copydoc stepper_submit_block
+ * @brief Швидкість і пройдений шлях S‑подібної зміни швидкості в момент `t`.
+ * @param v0 Початкова швидкість, мм/с.
+ * @param sign +1 — розгін, −1 — гальмування.
+ * @param jerk Ривок, мм/с³.
+ * @param ramp_s Тривалість наростання (і спадання) прискорення, с.
+ * @param hold_s Тривалість сталого прискорення, с.
+ * @param t Час від початку зміни швидкості, с.
+ * @param out_v [out] Швидкість, мм/с.
+ * @param out_s [out] Шлях, мм.
  */
-bool stepper_submit_block (stepper_context_t *ctx, const plan_block_t *block, bool dry_run) {
-    if (!ctx || !block)
-        return true;
-    if (block->length_mm < STEPPER_EPS_MM)
-        return true;
+static void stepper_scurve_state (
+    double v0,
+    double sign,
+    double jerk,
+    double ramp_s,
+    double hold_s,
+    double t,
+    double *out_v,
+    double *out_s) {
+    double peak = jerk * ramp_s;
+    double tau = fmin (t, ramp_s);
+    double v = v0 + sign * jerk * tau * tau / 2.0;
+    double s = v0 * tau + sign * jerk * tau * tau * tau / 6.0;
+    if (t > ramp_s) {
+        tau = fmin (t - ramp_s, hold_s);
+        s += v * tau + sign * peak * tau * tau / 2.0;
+        v += sign * peak * tau;
+    }
+    if (t > ramp_s + hold_s) {
+        tau = fmin (t - ramp_s - hold_s, ramp_s);
+        s += v * tau + sign * (peak * tau * tau / 2.0 - jerk * tau * tau * tau / 6.0);
+        v += sign * (peak * tau - jerk * tau * tau / 2.0);
+    }
+    *out_v = v;
+    *out_s = s;
+}
 
-    int32_t steps_x_total = 0;
-    int32_t steps_y_total = 0;
-    stepper_mm_to_steps (ctx, block, &steps_x_total, &steps_y_total);
+/**
+ * @brief Розкладає S‑подібну зміну швидкості `v0 → v1` на фази сталого прискорення.
+ * @details Команда LM тримає прискорення сталим, тож наростання і спадання прискорення
+ *          наближаються `STEPPER_SCURVE_RAMP_SPLIT` сходинками кожне. Швидкості на межах
+ *          фаз лежать на точній S‑кривій, а шляхи масштабуються до `distance_mm` блоку.
+ *          Фази, коротші за `STEPPER_SCURVE_MIN_PHASE_MM`, зливаються з наступною (остання —
+ *          з попередньою): кожна команда має рухати мотори хоча б на кілька кроків.
+ * @param block Блок плану (прискорення і ривок).
+ * @param distance_mm Шлях зміни швидкості, мм.
+ * @param v0 Початкова швидкість, мм/с.
+ * @param v1 Кінцева швидкість, мм/с.
+ * @param phases [out] Щонайменше `STEPPER_SCURVE_MAX_PHASES` фаз.
+ * @return Кількість фаз (≥ 1).
+ */
+static size_t stepper_scurve_phases (
+    const plan_block_t *block, double distance_mm, double v0, double v1, stepper_phase_t *phases) {
+    double dv = fabs (v1 - v0);
+    double accel = block->accel_mm_s2;
+    double jerk = block->jerk_mm_s3;
+    double ramp_s = dv >= accel * accel / jerk ? accel / jerk : sqrt (dv / jerk);
+    double hold_s = dv >= accel * accel / jerk ? dv / accel - accel / jerk : 0.0;
+    double sign = v1 >= v0 ? 1.0 : -1.0;
+
+    double times[STEPPER_SCURVE_MAX_PHASES + 1];
+    size_t points = 0;
+    for (size_t k = 0; k <= STEPPER_SCURVE_RAMP_SPLIT; ++k)
+        times[points++] = ramp_s * (double)k / STEPPER_SCURVE_RAMP_SPLIT;
+    if (hold_s > 0.0)
+        times[points++] = ramp_s + hold_s;
+    for (size_t k = 1; k <= STEPPER_SCURVE_RAMP_SPLIT; ++k)
+        times[points++] = ramp_s + hold_s + ramp_s * (double)k / STEPPER_SCURVE_RAMP_SPLIT;
+
+    double total_v, total_s;
+    stepper_scurve_state (v0, sign, jerk, ramp_s, hold_s, times[points - 1], &total_v, &total_s);
+    if (!(dv > SPEED_EPS) || !(total_s > STEPPER_EPS_MM)) {
+        phases[0] = (stepper_phase_t){
+            .distance_mm = distance_mm, .start_speed_mm_s = v0, .end_speed_mm_s = v1
+        };
+        return 1;
+    }
 
-    stepper_phase_t phases[3];
+    double scale = distance_mm / total_s;
+    double prev_v = v0;
+    double prev_s = 0.0;
+    size_t count = 0;
+    for (size_t k = 1; k < points; ++k) {
+        double v, s;
+        stepper_scurve_state (v0, sign, jerk, ramp_s, hold_s, times[k], &v, &s);
+        if (k + 1 == points)
+            v = v1;
+        if (count > 0 && phases[count - 1].distance_mm < STEPPER_SCURVE_MIN_PHASE_MM) {
+            phases[count - 1].distance_mm += (s - prev_s) * scale;
+            phases[count - 1].end_speed_mm_s = v;
+        } else {
+            phases[count++] = (stepper_phase_t){
+                .distance_mm = (s - prev_s) * scale,
+                .start_speed_mm_s = prev_v,
+                .end_speed_mm_s = v,
+            };
+        }
+        prev_v = v;
+        prev_s = s;
+    }
+    if (count > 1 && phases[count - 1].distance_mm < STEPPER_SCURVE_MIN_PHASE_MM) {
+        phases[count - 2].distance_mm += phases[count - 1].distance_mm;
+        phases[count - 2].end_speed_mm_s = phases[count - 1].end_speed_mm_s;
+        --count;
+    }
+    return count;
+}
+
+/**
+ * @brief Розкладає блок на фази розгону/круїзу/гальмування (без розподілу кроків).
+ * @details S‑подібні розгін і гальмування (`jerk_mm_s3 > 0`) діляться на кілька фаз
+ *          сталого прискорення (`stepper_scurve_phases`).
+ * @param block Блок плану.
+ * @param phases [out] Щонайменше `STEPPER_BLOCK_MAX_PHASES` фаз.
+ * @return Кількість фаз (1..`STEPPER_BLOCK_MAX_PHASES`).
+ */
+static size_t stepper_block_phases (
+    const plan_block_t *block, stepper_phase_t phases[STEPPER_BLOCK_MAX_PHASES]) {
+    bool scurve = block->jerk_mm_s3 > 0.0 && block->accel_mm_s2 > 0.0;
     size_t phase_count = 0;
 
     if (block->accel_distance_mm > STEPPER_EPS_MM) {
-        size_t idx = phase_count++;
-        phases[idx] = (stepper_phase_t){
-            .distance_mm = block->accel_distance_mm,
-            .start_speed_mm_s = block->start_speed_mm_s,
-            .end_speed_mm_s = block->cruise_speed_mm_s,
-            .block_seq = block->seq,
-            .phase_index = idx,
-        };
+        if (scurve) {
+            phase_count += stepper_scurve_phases (
+                block, block->accel_distance_mm, block->start_speed_mm_s,
+                block->cruise_speed_mm_s, &phases[phase_count]);
+        } else {
+            phases[phase_count++] = (stepper_phase_t){
+                .distance_mm = block->accel_distance_mm,
+                .start_speed_mm_s = block->start_speed_mm_s,
+                .end_speed_mm_s = block->cruise_speed_mm_s,
+            };
+        }
     }
     if (block->cruise_distance_mm > STEPPER_EPS_MM) {
-        size_t idx = phase_count++;
-        phases[idx] = (stepper_phase_t){
+        phases[phase_count++] = (stepper_phase_t){
             .distance_mm = block->cruise_distance_mm,
             .start_speed_mm_s = block->cruise_speed_mm_s,
             .end_speed_mm_s = block->cruise_speed_mm_s,
-            .block_seq = block->seq,
-            .phase_index = idx,
         };
     }
     if (block->decel_distance_mm > STEPPER_EPS_MM) {
-        size_t idx = phase_count++;
-        phases[idx] = (stepper_phase_t){
-            .distance_mm = block->decel_distance_mm,
-            .start_speed_mm_s = block->cruise_speed_mm_s,
-            .end_speed_mm_s = block->end_speed_mm_s,
-            .block_seq = block->seq,
-            .phase_index = idx,
-        };
+        if (scurve) {
+            phase_count += stepper_scurve_phases (
+                block, block->decel_distance_mm, block->cruise_speed_mm_s,
+                block->end_speed_mm_s, &phases[phase_count]);
+        } else {
+            phases[phase_count++] = (stepper_phase_t){
+                .distance_mm = block->decel_distance_mm,
+                .start_speed_mm_s = block->cruise_speed_mm_s,
+                .end_speed_mm_s = block->end_speed_mm_s,
+            };
+        }
     }
 
     if (phase_count == 0) {
@@ -192,66 +432,197 @@ bool stepper_submit_block (stepper_context_t *ctx, const plan_block_t *block, bo
             .distance_mm = block->length_mm,
             .start_speed_mm_s = block->start_speed_mm_s,
             .end_speed_mm_s = block->end_speed_mm_s,
-            .block_seq = block->seq,
-            .phase_index = 0,
         };
         phase_count = 1;
     }
 
-    for (size_t i = 0; i < phase_count; ++i)
+    for (size_t i = 0; i < phase_count; ++i) {
+        phases[i].block_seq = block->seq;
+        phases[i].phase_index = i;
         phases[i].phase_count = phase_count;
+    }
+    return phase_count;
+}
+
+/**
+ * @brief Тривалість фази з запасною швидкістю для вироджених профілів.
+ * @param block Блок, якому належить фаза.
+ * @param phase Фаза.
+ * @return Тривалість, с.
+ */
+static double stepper_phase_time_s (const plan_block_t *block, const stepper_phase_t *phase) {
+    double duration = stepper_phase_duration_s (
+        phase->distance_mm, phase->start_speed_mm_s, phase->end_speed_mm_s);
+    if (!(duration > 0.0)) {
+        double fallback = fmax (phase->start_speed_mm_s, phase->end_speed_mm_s);
+        if (!(fallback > SPEED_EPS))
+            fallback = fmax (block->cruise_speed_mm_s, block->nominal_speed_mm_s);
+        if (!(fallback > SPEED_EPS))
+            fallback = 1.0;
+        duration = phase->distance_mm / fallback;
+    }
+    return duration;
+}
+
+/**
+ * @copydoc stepper_block_duration_s
+ */
+double stepper_block_duration_s (const plan_block_t *block) {
+    if (!block || block->length_mm < STEPPER_EPS_MM)
+        return 0.0;
+    stepper_phase_t phases[STEPPER_BLOCK_MAX_PHASES];
+    size_t phase_count = stepper_block_phases (block, phases);
+    double total = 0.0;
+    for (size_t i = 0; i < phase_count; ++i)
+        total += stepper_phase_time_s (block, &phases[i]);
+    return total;
+}
+
+/**
+ * @copydoc stepper_split_block_tail
+ */
+bool stepper_split_block_tail (
+    const plan_block_t *block, double tail_s, plan_block_t *head, plan_block_t *tail) {
+    if (!block || !head || !tail || !(tail_s > 0.0) || block->length_mm < STEPPER_EPS_MM)
+        return false;
+    /* S‑подібні зміни швидкості діляться як лінійні: на тому самому шляху та сама
+       середня швидкість, а прискорення не перевищує межу блоку. */
+    plan_block_t linear = *block;
+    linear.jerk_mm_s3 = 0.0;
+    stepper_phase_t phases[STEPPER_BLOCK_MAX_PHASES];
+    size_t phase_count = stepper_block_phases (&linear, phases);
+
+    /* Швидкість у фазі лінійна в часі, тож точку поділу шукаємо з кінця по фазах. */
+    double remaining_s = tail_s;
+    double tail_mm = 0.0;
+    double split_speed = -1.0;
+    for (size_t i = phase_count; i-- > 0;) {
+        const stepper_phase_t *phase = &phases[i];
+        double duration = stepper_phase_time_s (block, phase);
+        if (remaining_s < duration) {
+            double v = phase->end_speed_mm_s
+                       + (phase->start_speed_mm_s - phase->end_speed_mm_s) * (remaining_s / duration);
+            tail_mm += remaining_s * 0.5 * (v + phase->end_speed_mm_s);
+            split_speed = v;
+            break;
+        }
+        remaining_s -= duration;
+        tail_mm += phase->distance_mm;
+    }
+    double head_mm = block->length_mm - tail_mm;
+    if (split_speed < 0.0 || !(head_mm > STEPPER_EPS_MM) || !(tail_mm > STEPPER_EPS_MM))
+        return false;
+
+    double accel_mm = block->accel_distance_mm > STEPPER_EPS_MM ? block->accel_distance_mm : 0.0;
+    double cruise_mm = block->cruise_distance_mm > STEPPER_EPS_MM ? block->cruise_distance_mm : 0.0;
+    double decel_mm = block->decel_distance_mm > STEPPER_EPS_MM ? block->decel_distance_mm : 0.0;
+    double head_accel = fmin (accel_mm, head_mm);
+    double head_cruise = fmin (cruise_mm, fmax (0.0, head_mm - accel_mm));
+    double head_decel = fmax (0.0, head_mm - accel_mm - cruise_mm);
+    double fraction = head_mm / block->length_mm;
+
+    *head = linear;
+    head->length_mm = head_mm;
+    head->delta_mm[0] = block->delta_mm[0] * fraction;
+    head->delta_mm[1] = block->delta_mm[1] * fraction;
+    head->accel_distance_mm = head_accel;
+    head->cruise_distance_mm = head_cruise;
+    head->decel_distance_mm = head_decel;
+    head->end_speed_mm_s = split_speed;
+    if (head_mm <= accel_mm)
+        head->cruise_speed_mm_s = split_speed;
+
+    *tail = linear;
+    tail->length_mm = tail_mm;
+    tail->delta_mm[0] = block->delta_mm[0] - head->delta_mm[0];
+    tail->delta_mm[1] = block->delta_mm[1] - head->delta_mm[1];
+    tail->accel_distance_mm = accel_mm - head_accel;
+    tail->cruise_distance_mm = cruise_mm - head_cruise;
+    tail->decel_distance_mm = fmax (0.0, decel_mm - head_decel);
+    tail->start_speed_mm_s = split_speed;
+    if (head_mm >= accel_mm + cruise_mm)
+        tail->cruise_speed_mm_s = split_speed;
+    return true;
+}
+
+/** \brief Тіло `stepper_submit_block` без профілю. */
+static bool
+stepper_submit_block_run (stepper_context_t *ctx, const plan_block_t *block, bool dry_run) {
+    if (!ctx || !block)
+        return true;
+    if (block->length_mm < STEPPER_EPS_MM)
+        return true;
+
+    int32_t steps_x_total = 0;
+    int32_t steps_y_total = 0;
+    stepper_mm_to_steps (ctx, block, &steps_x_total, &steps_y_total);
+    if (steps_x_total == 0 && steps_y_total == 0) {
+        ++ctx->skipped_blocks;
+        return true;
+    }
+
+    stepper_phase_t phases[STEPPER_BLOCK_MAX_PHASES];
+    size_t phase_count = stepper_block_phases (block, phases);
 
     double total_length = block->length_mm;
     double total_duration_s = 0.0;
     int64_t used_steps_x = 0;
     int64_t used_steps_y = 0;
 
+    double covered_mm = 0.0;
+
+    /* Кроки округлюються за накопиченим шляхом, щоб похибка не збиралася в останній фазі. */
     for (size_t i = 0; i < phase_count; ++i) {
         stepper_phase_t *phase = &phases[i];
-        double fraction
-            = (total_length > STEPPER_EPS_MM) ? (phase->distance_mm / total_length) : 0.0;
+        covered_mm += phase->distance_mm;
+        double fraction = (total_length > STEPPER_EPS_MM) ? (covered_mm / total_length) : 0.0;
         if (i + 1 == phase_count) {
             phase->steps_a = steps_x_total - (int32_t)used_steps_x;
             phase->steps_b = steps_y_total - (int32_t)used_steps_y;
         } else {
-            phase->steps_a = stepper_clamp_i32 ((double)steps_x_total * fraction);
-            phase->steps_b = stepper_clamp_i32 ((double)steps_y_total * fraction);
+            phase->steps_a
+                = stepper_clamp_i32 ((double)steps_x_total * fraction) - (int32_t)used_steps_x;
+            phase->steps_b
+                = stepper_clamp_i32 ((double)steps_y_total * fraction) - (int32_t)used_steps_y;
         }
         used_steps_x += phase->steps_a;
         used_steps_y += phase->steps_b;
 
-        double duration = stepper_phase_duration_s (
-            phase->distance_mm, phase->start_speed_mm_s, phase->end_speed_mm_s);
-        if (!(duration > 0.0)) {
-            double fallback = fmax (phase->start_speed_mm_s, phase->end_speed_mm_s);
-            if (!(fallback > SPEED_EPS))
-                fallback = fmax (block->cruise_speed_mm_s, block->nominal_speed_mm_s);
-            if (!(fallback > SPEED_EPS))
-                fallback = 1.0;
-            duration = phase->distance_mm / fallback;
-        }
-        phase->duration_s = duration;
-        total_duration_s += duration;
+        phase->duration_s = stepper_phase_time_s (block, phase);
+        total_duration_s += phase->duration_s;
     }
 
     uint32_t approx_duration_ms = (uint32_t)llround (total_duration_s * 1000.0);
 
-    LOGD (
-        "Крокувач: блок %lu зміщення=(%.3f,%.3f) довжина=%.3f перо=%s", block->seq,
-        block->delta_mm[0], block->delta_mm[1], block->length_mm, block->pen_down ? "так" : "ні");
-    LOGD (
-        "Крокувач: кроки X=%d Y=%d, тривалість≈%u мс", steps_x_total, steps_y_total,
-        approx_duration_ms);
-    log_print (
-        LOG_DEBUG, "крокувач: блок=%lu довжина=%.3f крейсер=%.3f кількість_фаз=%zu", block->seq,
-        block->length_mm, block->cruise_speed_mm_s, phase_count);
+    TRACE_LOG (
+        TRACE_STEP_BLOCK_DELTA, block->seq, block->delta_mm[0], block->delta_mm[1],
+        block->length_mm, block->pen_down ? "так" : "ні");
+    TRACE_LOG (TRACE_STEP_BLOCK_STEPS, steps_x_total, steps_y_total, approx_duration_ms);
+    TRACE_LOG (
+        TRACE_STEP_BLOCK, block->seq, block->length_mm, block->cruise_speed_mm_s, phase_count);
 
     bool send_cmd = (!dry_run && ctx->cfg.dev != NULL);
     for (size_t i = 0; i < phase_count; ++i) {
-        if (!stepper_emit_phase (ctx, &phases[i], send_cmd))
+        bool ok = ctx->cfg.merge_phases
+                      ? stepper_queue_phase (ctx, &phases[i], block->pen_down, send_cmd)
+                      : stepper_emit_phase (ctx, &phases[i], send_cmd);
+        if (!ok)
             return false;
+        if (!ctx->cfg.merge_phases && phases[i].distance_mm > STEPPER_EPS_MM
+            && (phases[i].steps_a != 0 || phases[i].steps_b != 0))
+            ++ctx->commands;
     }
 
     ++ctx->emitted_blocks;
     return true;
 }
+
+/**
+ * @copydoc stepper_submit_block
+ */
+bool stepper_submit_block (stepper_context_t *ctx, const plan_block_t *block, bool dry_run) {
+    uint64_t t0 = ttime_stage_begin ();
+    bool ok = stepper_submit_block_run (ctx, block, dry_run);
+    ttime_stage_end (TTIME_STAGE_STEP, t0);
+    return ok;
+}
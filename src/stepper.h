@@ -11,6 +11,7 @@
 #define CPLOT_STEPPER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "axidraw.h"
 #include "planner.h"
@@ -24,14 +25,50 @@ extern "C" {
  */
 typedef struct {
     axidraw_device_t *dev; /**< Відкритий пристрій AxiDraw або `NULL` для dry‑run. */
+    bool merge_phases;     /**< Обʼєднувати сусідні фази з однаковим прискоренням в один LM. */
 } stepper_config_t;
 
+/**
+ * @brief Фаза, що чекає на обʼєднання з наступними (режим `merge_phases`).
+ * @details LM задає для кожної осі початкову частоту і стале прискорення, тож одна
+ *          команда може виконати будь-яку неперервну за швидкістю ділянку з однаковим
+ *          прискоренням уздовж однієї прямої: круїзи однакової швидкості, розгін чи
+ *          гальмування, що тягнуться через кілька блоків.
+ */
+typedef struct {
+    bool active;             /**< Чи є відкладена фаза. */
+    bool send;               /**< Надсилати на пристрій (інакше — лише журнал). */
+    bool pen_down;           /**< Стан пера блоків фази. */
+    double distance_mm;      /**< Довжина, мм. */
+    double start_speed_mm_s; /**< Початкова швидкість, мм/с. */
+    double end_speed_mm_s;   /**< Кінцева швидкість, мм/с. */
+    double accel_mm_s2;      /**< Прискорення вздовж руху, мм/с². */
+    int32_t steps_x;         /**< Кроки X. */
+    int32_t steps_y;         /**< Кроки Y. */
+    double duration_s;       /**< Тривалість, с. */
+    unsigned long first_seq; /**< Номер першого блоку. */
+    unsigned long last_seq;  /**< Номер останнього блоку. */
+    size_t phase_index;      /**< Індекс першої фази в її блоці. */
+    size_t phase_count;      /**< Кількість фаз у блоці першої фази. */
+    size_t phases;           /**< Кількість обʼєднаних фаз. */
+} stepper_pending_phase_t;
+
 /**
  * @brief Поточний стан крокувача.
+ * @details Кроки блоку — різниця між округленою абсолютною позицією після блоку і
+ *          вже виданою позицією (як у Брезенгема, але між блоками): дробова частина
+ *          переноситься у `residual_steps`, тож похибка округлення не накопичується і
+ *          ніколи не перевищує половини кроку.
  */
 typedef struct {
-    stepper_config_t cfg;         /**< Активна конфігурація. */
-    unsigned long emitted_blocks; /**< Лічильник успішно оброблених блоків. */
+    stepper_config_t cfg;            /**< Активна конфігурація. */
+    unsigned long emitted_blocks;    /**< Лічильник успішно оброблених блоків. */
+    unsigned long skipped_blocks;    /**< Блоки, що не дали жодного кроку. */
+    int64_t position_steps[2];       /**< Видана абсолютна позиція X/Y, кроки. */
+    double residual_steps[2];        /**< Задана, але ще не видана частина кроку X/Y. */
+    unsigned long commands;          /**< Видані команди руху (фази після обʼєднання). */
+    unsigned long merged_phases;     /**< Фази, що увійшли до попередньої команди. */
+    stepper_pending_phase_t pending; /**< Фаза, що чекає на обʼєднання. */
 } stepper_context_t;
 
 /**
@@ -50,6 +87,39 @@ void stepper_init (stepper_context_t *ctx, const stepper_config_t *cfg);
  */
 bool stepper_submit_block (stepper_context_t *ctx, const plan_block_t *block, bool dry_run);
 
+/**
+ * @brief Видає фазу, відкладену для обʼєднання (`merge_phases`).
+ * @details Викликається перед будь-якою командою не руху (перо, очікування) і в кінці
+ *          плану; без `merge_phases` нічого не робить.
+ * @param ctx Контекст.
+ * @return true — успіх; false — помилка відправлення.
+ */
+bool stepper_flush (stepper_context_t *ctx);
+
+/**
+ * @brief Тривалість виконання блоку за його трапецієвидним профілем.
+ * @details Ті самі фази й запасні швидкості, що й у `stepper_submit_block`, без
+ *          розподілу кроків і журналів.
+ * @param block Блок плану.
+ * @return Тривалість, с (0 — блок коротший за поріг і не виконується).
+ */
+double stepper_block_duration_s (const plan_block_t *block);
+
+/**
+ * @brief Ділить блок на два так, щоб другий тривав `tail_s` секунд.
+ * @details Профіль швидкості зберігається: перший блок закінчується, а другий
+ *          починається зі швидкості в точці поділу, сума тривалостей не змінюється.
+ *          Застосовується, щоб вставити команду між частинами одного руху. S‑подібні
+ *          розгін і гальмування в частинах стають лінійними (`jerk_mm_s3 = 0`).
+ * @param block Блок плану.
+ * @param tail_s Тривалість другої частини, с.
+ * @param head [out] Перша частина.
+ * @param tail [out] Друга частина.
+ * @return true — поділено; false — `tail_s` не менша за тривалість блоку або не додатна.
+ */
+bool stepper_split_block_tail (
+    const plan_block_t *block, double tail_s, plan_block_t *head, plan_block_t *tail);
+
 #ifdef __cplusplus
 }
 #endif
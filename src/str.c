@@ -5,6 +5,9 @@
  * @details
  * Містить прості операції над ASCII‑рядками та мінімальний UTF‑8 декодер, що
  * перевіряє базову коректність послідовностей і запобігає надмірним формам.
+ * Декодер буфера (`str_utf8_decode_span`) перевіряє по 16 байтів за ітерацію
+ * (SSE2/NEON або слово 64 біти) і розширює ASCII‑блоки без розбору; двобайтові
+ * послідовності (латиниця з діакритикою, кирилиця) розбираються на місці.
  */
 
 #include "str.h"
@@ -14,6 +17,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STR_SIMD_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STR_SIMD_NEON 1
+#endif
+
 /**
  * @copydoc str_string_duplicate
  */
@@ -120,7 +131,7 @@ int str_utf8_decode (const char *input, uint32_t *out_cp, size_t *consumed) {
         cp = ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12)
              | ((uint32_t)(s[2] & 0x3F) << 6) | (uint32_t)(s[3] & 0x3F);
         used = 4;
-        if (cp < 0x10000)
+        if (cp < 0x10000 || cp > 0x10FFFF)
             return -1;
     } else {
         return -1;
@@ -130,3 +141,92 @@ int str_utf8_decode (const char *input, uint32_t *out_cp, size_t *consumed) {
     *out_cp = cp;
     return 0;
 }
+
+/**
+ * @brief Розширює 16 ASCII‑байтів у кодові точки, якщо всі вони < 0x80.
+ * @return true — блок ASCII і записаний; false — у блоці є не‑ASCII байт.
+ */
+static inline bool str_ascii_block16 (const unsigned char *s, uint32_t *out) {
+#if defined(STR_SIMD_SSE2)
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(const void *)s);
+    if (_mm_movemask_epi8 (v) != 0)
+        return false;
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i lo = _mm_unpacklo_epi8 (v, zero);
+    __m128i hi = _mm_unpackhi_epi8 (v, zero);
+    _mm_storeu_si128 ((__m128i *)(void *)(out + 0), _mm_unpacklo_epi16 (lo, zero));
+    _mm_storeu_si128 ((__m128i *)(void *)(out + 4), _mm_unpackhi_epi16 (lo, zero));
+    _mm_storeu_si128 ((__m128i *)(void *)(out + 8), _mm_unpacklo_epi16 (hi, zero));
+    _mm_storeu_si128 ((__m128i *)(void *)(out + 12), _mm_unpackhi_epi16 (hi, zero));
+    return true;
+#elif defined(STR_SIMD_NEON)
+    uint8x16_t v = vld1q_u8 (s);
+    if (vmaxvq_u8 (v) >= 0x80)
+        return false;
+    uint16x8_t lo = vmovl_u8 (vget_low_u8 (v));
+    uint16x8_t hi = vmovl_u8 (vget_high_u8 (v));
+    vst1q_u32 (out + 0, vmovl_u16 (vget_low_u16 (lo)));
+    vst1q_u32 (out + 4, vmovl_u16 (vget_high_u16 (lo)));
+    vst1q_u32 (out + 8, vmovl_u16 (vget_low_u16 (hi)));
+    vst1q_u32 (out + 12, vmovl_u16 (vget_high_u16 (hi)));
+    return true;
+#else
+    uint64_t w[2];
+    memcpy (w, s, sizeof (w));
+    if (((w[0] | w[1]) & 0x8080808080808080ULL) != 0)
+        return false;
+    for (size_t i = 0; i < 16; ++i)
+        out[i] = s[i];
+    return true;
+#endif
+}
+
+/**
+ * @copydoc str_utf8_decode_span
+ */
+size_t str_utf8_decode_span (const char *input, size_t len, uint32_t *out, uint32_t invalid) {
+    if (!input || !out)
+        return 0;
+    const unsigned char *s = (const unsigned char *)input;
+    size_t i = 0, n = 0;
+    while (i < len) {
+        if (len - i >= 16 && str_ascii_block16 (s + i, out + n)) {
+            i += 16;
+            n += 16;
+            continue;
+        }
+        unsigned char c = s[i];
+        if (c < 0x80) {
+            out[n++] = c;
+            ++i;
+            continue;
+        }
+        /* Двобайтові послідовності — латиниця з діакритикою, грецька, кирилиця. */
+        if (c >= 0xC2 && c <= 0xDF && i + 1 < len && (s[i + 1] & 0xC0) == 0x80) {
+            out[n++] = ((uint32_t)(c & 0x1F) << 6) | (uint32_t)(s[i + 1] & 0x3F);
+            i += 2;
+            continue;
+        }
+        size_t need = (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 2;
+        uint32_t cp = 0;
+        size_t used = 0;
+        if (need <= len - i && str_utf8_decode (input + i, &cp, &used) == 0) {
+            out[n++] = cp;
+            i += used;
+        } else {
+            out[n++] = invalid;
+            ++i;
+        }
+    }
+    return n;
+}
+
+/** @copydoc str_fnv1a */
+uint64_t str_fnv1a (uint64_t hash, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
@@ -57,9 +57,34 @@ void str_string_trim_ascii (char *s);
  * @param out_cp [out] Декодована кодова точка Unicode.
  * @param consumed [out] Кількість спожитих байтів (1..4); може бути `NULL`.
  * @return 0 — успіх; -1 — некоректна послідовність.
- * @note Виконується запобігання надмірно довгим формам, але не блокується
- *       декодування деяких не призначених до використання кодових точок.
+ * @note Відкидаються надмірно довгі форми та значення понад U+10FFFF, але не
+ *       блокується декодування деяких не призначених до використання кодових точок.
  */
 int str_utf8_decode (const char *input, uint32_t *out_cp, size_t *consumed);
 
+/**
+ * @brief Декодує UTF‑8 буфер у кодові точки з прискоренням для ASCII.
+ * @details Правила ті самі, що й у `str_utf8_decode`; послідовність, що виходить за
+ *          межу `len`, вважається некоректною. Кожен некоректний байт дає одну
+ *          кодову точку `invalid`.
+ * @param input Байти UTF‑8 (не обовʼязково завершені `\0`).
+ * @param len Кількість байтів.
+ * @param out [out] Кодові точки; місце щонайменше на `len` елементів.
+ * @param invalid Значення для некоректного байта.
+ * @return Кількість записаних кодових точок.
+ */
+size_t str_utf8_decode_span (const char *input, size_t len, uint32_t *out, uint32_t invalid);
+
+/** FNV‑1a 64‑біт: початкове значення хешу. */
+#define STR_FNV1A_OFFSET 1469598103934665603ULL
+
+/**
+ * @brief Додає байти до 64‑бітного хешу FNV‑1a.
+ * @param hash Поточне значення (для нового хешу — `STR_FNV1A_OFFSET`).
+ * @param data Байти (може бути `NULL`, якщо `len` = 0).
+ * @param len Кількість байтів.
+ * @return Оновлене значення хешу.
+ */
+uint64_t str_fnv1a (uint64_t hash, const void *data, size_t len);
+
 #endif
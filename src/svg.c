@@ -4,17 +4,27 @@
  * @ingroup svg
  * @details
  * Формує мінімальний SVG: заголовок із розмірами у мм, фон‑прямокутник та
- * послідовність `path` елементів, що зʼєднують точки поліліній. Буфер строїться
- * у динамічній памʼяті з автоматичним розширенням.
+ * послідовність `path` елементів, що зʼєднують точки поліліній. Буфер наперед
+ * оцінюється за кількістю точок (і за потреби розширюється); координати
+ * квантуються до 10⁻⁴ мм (або грубіше — за цільовою роздільністю, з проріджуванням
+ * точок, ближчих за пів пікселя) і записуються власним перетворенням цілих у текст,
+ * усі точки після першої — відносними командами `l`. Для приймача (`sink_t`)
+ * текст передається шматками по `SVG_FLUSH_BYTES`, тож у памʼяті не тримається
+ * весь документ. Розкладка з екземплярів гліфів записується як `<defs>` з однією
+ * формою на гліф і `<use>` на кожен символ.
  */
 
 #include "svg.h"
 
 #include "log.h"
 
+#include <inttypes.h>
+#include <math.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -71,12 +81,254 @@ static int svg_str_appendf (char **buf, size_t *len, size_t *cap, const char *fm
 }
 
 /**
- * @copydoc svg_render_layout
+ * @brief Додає до буфера рядок фіксованої довжини без форматування.
+ * @param buf [in,out] Буфер.
+ * @param len [in,out] Довжина корисних даних.
+ * @param cap [in,out] Ємність буфера.
+ * @param text Дані.
+ * @param n Кількість байтів.
+ * @return 0 — успіх; -1 — помилка виділення памʼяті.
  */
-int svg_render_layout (const drawing_layout_t *layout, bytes_t *out) {
+static int svg_str_append (char **buf, size_t *len, size_t *cap, const char *text, size_t n) {
+    if (svg_str_reserve (buf, len, cap, n) != 0)
+        return -1;
+    memcpy (*buf + *len, text, n);
+    *len += n;
+    (*buf)[*len] = '\0';
+    return 0;
+}
+
+/** \brief Типова кількість знаків після коми в координатах контурів. */
+#define SVG_COORD_DECIMALS 4
+/** \brief Запас на одне число з пробілом: знак, до 15 цифр цілої частини, кома, 4 знаки. */
+#define SVG_NUM_MAX 24
+
+/** \brief Точність запису координат: фіксована кома й проріджування точок. */
+typedef struct {
+    int decimals;    /**< Знаків після коми (0..`SVG_COORD_DECIMALS`). */
+    uint64_t unit;   /**< 10^`decimals`. */
+    double tol2_mm2; /**< Квадрат найменшої відстані між точками, що зберігаються (0 — всі). */
+} svg_precision_t;
+
+/**
+ * @brief Точність для цільової роздільності.
+ * @details Без `dpi` — 4 знаки й усі точки. Інакше крок квантування не перевищує
+ *          десятої частини пікселя, а точки, ближчі за пів пікселя до попередньої
+ *          збереженої, відкидаються (останню точку контуру завжди збережено).
+ */
+static svg_precision_t svg_precision_for (const preview_opts_t *opts) {
+    svg_precision_t p = { SVG_COORD_DECIMALS, 10000U, 0.0 };
+    if (!opts || !(opts->dpi > 0.0))
+        return p;
+    double px_mm = 25.4 / opts->dpi;
+    int d = (int)ceil (log10 (10.0 / px_mm));
+    if (d < 0)
+        d = 0;
+    if (d > SVG_COORD_DECIMALS)
+        d = SVG_COORD_DECIMALS;
+    p.decimals = d;
+    p.unit = 1;
+    for (int i = 0; i < d; ++i)
+        p.unit *= 10U;
+    p.tol2_mm2 = 0.25 * px_mm * px_mm;
+    return p;
+}
+
+/** \brief Переводить координату в мм у ціле число кроків `unit`. */
+static inline int64_t svg_quantize (double mm, const svg_precision_t *p) {
+    return (int64_t)llround (mm * (double)p->unit);
+}
+
+/**
+ * @brief Записує число з фіксованою комою (`v / 10^decimals`) без зайвих нулів.
+ * @details Ручне перетворення цілого в ASCII: жодного `printf` на координату.
+ * @param dst Буфер щонайменше на `SVG_NUM_MAX` байтів.
+ * @param v Значення у кроках `p->unit`.
+ * @param p Точність.
+ * @return Кількість записаних байтів.
+ */
+static size_t svg_format_fixed (char *dst, int64_t v, const svg_precision_t *p) {
+    char tmp[SVG_NUM_MAX];
+    size_t n = 0;
+    uint64_t u = v < 0 ? (uint64_t)(-(v + 1)) + 1U : (uint64_t)v;
+    uint64_t int_part = u / p->unit;
+    uint64_t frac = u % p->unit;
+    if (v < 0)
+        dst[n++] = '-';
+    size_t t = 0;
+    do {
+        tmp[t++] = (char)('0' + int_part % 10U);
+        int_part /= 10U;
+    } while (int_part);
+    while (t)
+        dst[n++] = tmp[--t];
+    if (frac) {
+        int digits = p->decimals;
+        while (frac % 10U == 0) {
+            frac /= 10U;
+            --digits;
+        }
+        dst[n++] = '.';
+        for (int k = digits - 1; k >= 0; --k) {
+            dst[n + (size_t)k] = (char)('0' + frac % 10U);
+            frac /= 10U;
+        }
+        n += (size_t)digits;
+    }
+    return n;
+}
+
+/** \brief Атрибути кожного контуру після даних `d`. */
+static const char k_svg_path_tail[]
+    = "\" fill=\"none\" stroke=\"#000\" stroke-width=\"0.3\" stroke-linecap=\"round\" "
+      "stroke-linejoin=\"round\"/>\n";
+
+/** \brief Поріг накопиченого тексту, після якого буфер передається у приймач. */
+#define SVG_FLUSH_BYTES 65536
+
+/** \brief Оцінка розміру документа: заголовок, атрибути контурів і ~2 коротких числа на точку. */
+static size_t svg_estimate_size (const canvas_layout_t *c) {
+    size_t points = 0;
+    size_t paths = c->paths_mm.len;
+    for (size_t i = 0; i < c->paths_mm.len; ++i)
+        points += c->paths_mm.items[i].len;
+    size_t uses = 0;
+    if (c->glyphs) {
+        const glyph_layout_t *gl = c->glyphs;
+        for (size_t i = 0; i < gl->shapes.len; ++i)
+            points += gl->shapes.items[i].len;
+        for (size_t i = 0; i < gl->loose.len; ++i)
+            points += gl->loose.items[i].len;
+        paths += gl->atlas_len + gl->loose.len;
+        uses = gl->item_len - gl->loose.len;
+    }
+    return 512 + paths * 160 + points * 14 + uses * 48;
+}
+
+/**
+ * @brief Записує ломану як дані `d`: абсолютне `M` і відносні `l`.
+ * @details Перша точка абсолютна, решта — відносні `l` у цілих кроках квантування,
+ *          тож похибка округлення не накопичується.
+ * @param w Місце запису (щонайменше `2 * SVG_NUM_MAX * (p->len + 1) + 4` байтів).
+ * @param p Контур (непорожній).
+ * @param prec Точність.
+ * @return Кінець записаного.
+ */
+static char *svg_put_polyline (char *w, const geom_path_t *p, const svg_precision_t *prec) {
+    *w++ = 'M';
+    *w++ = ' ';
+    int64_t px = svg_quantize (p->pts[0].x, prec);
+    int64_t py = svg_quantize (p->pts[0].y, prec);
+    w += svg_format_fixed (w, px, prec);
+    *w++ = ' ';
+    w += svg_format_fixed (w, py, prec);
+    if (p->len > 1) {
+        memcpy (w, " l", 2);
+        w += 2;
+    }
+    geom_point_t kept = p->pts[0];
+    for (size_t j = 1; j < p->len; ++j) {
+        if (prec->tol2_mm2 > 0.0 && j + 1 < p->len) {
+            double ddx = p->pts[j].x - kept.x;
+            double ddy = p->pts[j].y - kept.y;
+            if (ddx * ddx + ddy * ddy < prec->tol2_mm2)
+                continue;
+        }
+        kept = p->pts[j];
+        int64_t qx = svg_quantize (p->pts[j].x, prec);
+        int64_t qy = svg_quantize (p->pts[j].y, prec);
+        *w++ = ' ';
+        w += svg_format_fixed (w, qx - px, prec);
+        *w++ = ' ';
+        w += svg_format_fixed (w, qy - py, prec);
+        px = qx;
+        py = qy;
+    }
+    return w;
+}
+
+/**
+ * @brief Дописує `<path>` для одного контуру (порожній контур пропускається).
+ * @return 0 — успіх; -1 — помилка виділення памʼяті.
+ */
+static int svg_write_path (
+    const geom_path_t *p, const svg_precision_t *prec, char **svg, size_t *len, size_t *cap) {
+    if (!p->len || !p->pts)
+        return 0;
+    if (svg_str_reserve (
+            svg, len, cap, 16 + 2 * SVG_NUM_MAX * (p->len + 1) + sizeof (k_svg_path_tail))
+        != 0)
+        return -1;
+    char *w = *svg + *len;
+    memcpy (w, "  <path d=\"", 11);
+    w = svg_put_polyline (w + 11, p, prec);
+    *len = (size_t)(w - *svg);
+    return svg_str_append (svg, len, cap, k_svg_path_tail, sizeof (k_svg_path_tail) - 1);
+}
+
+/**
+ * @brief Дописує `<defs>` з однією `<path id="gN">` на кожну форму атласу гліфів.
+ * @return 0 — успіх; -1 — помилка виділення памʼяті.
+ */
+static int svg_write_glyph_defs (
+    const glyph_layout_t *gl, const svg_precision_t *prec, char **svg, size_t *len, size_t *cap) {
+    if (svg_str_append (svg, len, cap, "  <defs>\n", 9) != 0)
+        return -1;
+    for (size_t i = 0; i < gl->atlas_len; ++i) {
+        const glyph_layout_shape_t *s = &gl->atlas[i];
+        if (svg_str_appendf (svg, len, cap, "    <path id=\"g%zu\" d=\"", i) != 0)
+            return -1;
+        for (size_t k = s->first; k < s->first + s->count; ++k) {
+            const geom_path_t *p = &gl->shapes.items[k];
+            if (!p->len || !p->pts)
+                continue;
+            if (svg_str_reserve (svg, len, cap, 4 + 2 * SVG_NUM_MAX * (p->len + 1)) != 0)
+                return -1;
+            char *w = *svg + *len;
+            if (k != s->first)
+                *w++ = ' ';
+            w = svg_put_polyline (w, p, prec);
+            *len = (size_t)(w - *svg);
+        }
+        if (svg_str_append (svg, len, cap, k_svg_path_tail, sizeof (k_svg_path_tail) - 1) != 0)
+            return -1;
+    }
+    return svg_str_append (svg, len, cap, "  </defs>\n", 10);
+}
+
+/**
+ * @brief Дописує `<use>` для екземпляра форми атласу.
+ * @return 0 — успіх; -1 — помилка виділення памʼяті.
+ */
+static int svg_write_use (
+    const glyph_layout_item_t *it,
+    const svg_precision_t *prec,
+    char **svg,
+    size_t *len,
+    size_t *cap) {
+    if (svg_str_reserve (svg, len, cap, 64 + 2 * SVG_NUM_MAX) != 0)
+        return -1;
+    char *w = *svg + *len;
+    w += sprintf (w, "  <use xlink:href=\"#g%" PRIu32 "\" x=\"", it->shape);
+    w += svg_format_fixed (w, svg_quantize (it->x, prec), prec);
+    memcpy (w, "\" y=\"", 5);
+    w += 5;
+    w += svg_format_fixed (w, svg_quantize (it->y, prec), prec);
+    memcpy (w, "\"/>\n", 4);
+    w += 4;
+    *w = '\0';
+    *len = (size_t)(w - *svg);
+    return 0;
+}
+
+/**
+ * @copydoc svg_write_layout
+ */
+int svg_write_layout (const drawing_layout_t *layout, const preview_opts_t *opts, sink_t *out) {
     if (!layout || !out)
         return 1;
 
+    svg_precision_t prec = svg_precision_for (opts);
     const canvas_layout_t *c = &layout->layout;
     const geom_paths_t *paths = &c->paths_mm;
 
@@ -84,11 +336,18 @@ int svg_render_layout (const drawing_layout_t *layout, bytes_t *out) {
     size_t len = 0;
     size_t cap = 0;
 
+    size_t estimate = svg_estimate_size (c);
+    if (svg_str_reserve (
+            &svg, &len, &cap, estimate < SVG_FLUSH_BYTES ? estimate : 2 * SVG_FLUSH_BYTES)
+        != 0)
+        goto fail;
+
     if (svg_str_appendf (
             &svg, &len, &cap,
-            "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.2fmm\" height=\"%.2fmm\" "
+            "<svg xmlns=\"http://www.w3.org/2000/svg\"%s width=\"%.2fmm\" height=\"%.2fmm\" "
             "viewBox=\"0 0 %.4f %.4f\">\n",
-            c->paper_w_mm, c->paper_h_mm, c->paper_w_mm, c->paper_h_mm)
+            c->glyphs ? " xmlns:xlink=\"http://www.w3.org/1999/xlink\"" : "", c->paper_w_mm,
+            c->paper_h_mm, c->paper_w_mm, c->paper_h_mm)
         != 0)
         goto fail;
 
@@ -100,31 +359,42 @@ int svg_render_layout (const drawing_layout_t *layout, bytes_t *out) {
         != 0)
         goto fail;
 
-    for (size_t i = 0; i < paths->len; ++i) {
-        const geom_path_t *p = &paths->items[i];
-        if (!p->len || !p->pts)
-            continue;
-        if (svg_str_appendf (&svg, &len, &cap, "  <path d=\"") != 0)
-            goto fail;
-        if (svg_str_appendf (&svg, &len, &cap, "M %.4f %.4f", p->pts[0].x, p->pts[0].y) != 0)
+    if (c->glyphs) {
+        if (svg_write_glyph_defs (c->glyphs, &prec, &svg, &len, &cap) != 0)
             goto fail;
-        for (size_t j = 1; j < p->len; ++j) {
-            if (svg_str_appendf (&svg, &len, &cap, " L %.4f %.4f", p->pts[j].x, p->pts[j].y) != 0)
+        for (size_t i = 0; i < c->glyphs->item_len; ++i) {
+            const glyph_layout_item_t *it = &c->glyphs->items[i];
+            int rc;
+            if (it->shape == GLYPH_LAYOUT_LOOSE)
+                rc = svg_write_path (&c->glyphs->loose.items[it->index], &prec, &svg, &len, &cap);
+            else
+                rc = svg_write_use (it, &prec, &svg, &len, &cap);
+            if (rc != 0)
                 goto fail;
+            if (len >= SVG_FLUSH_BYTES) {
+                if (sink_write (out, svg, len) != 0)
+                    goto fail;
+                len = 0;
+            }
         }
-        if (svg_str_appendf (
-                &svg, &len, &cap,
-                "\" fill=\"none\" stroke=\"#000\" stroke-width=\"0.3\" stroke-linecap=\"round\" "
-                "stroke-linejoin=\"round\"/>\n")
-            != 0)
+    }
+
+    for (size_t i = 0; i < paths->len; ++i) {
+        if (svg_write_path (&paths->items[i], &prec, &svg, &len, &cap) != 0)
             goto fail;
+        if (len >= SVG_FLUSH_BYTES) {
+            if (sink_write (out, svg, len) != 0)
+                goto fail;
+            len = 0;
+        }
     }
 
-    if (svg_str_appendf (&svg, &len, &cap, "</svg>\n") != 0)
+    if (svg_str_append (&svg, &len, &cap, "</svg>\n", 7) != 0)
+        goto fail;
+    if (sink_write (out, svg, len) != 0)
         goto fail;
 
-    out->bytes = (uint8_t *)svg;
-    out->len = len;
+    free (svg);
     return 0;
 
 fail:
@@ -133,6 +403,28 @@ fail:
     return 1;
 }
 
+/**
+ * @copydoc svg_render_layout
+ */
+int svg_render_layout (const drawing_layout_t *layout, bytes_t *out) {
+    if (!layout || !out)
+        return 1;
+    sink_memory_t mem = { 0 };
+    mem.cap = svg_estimate_size (&layout->layout);
+    mem.bytes = (uint8_t *)malloc (mem.cap);
+    if (!mem.bytes)
+        mem.cap = 0;
+    sink_t sink;
+    sink_init_memory (&sink, &mem);
+    if (svg_write_layout (layout, NULL, &sink) != 0) {
+        free (mem.bytes);
+        return 1;
+    }
+    out->bytes = mem.bytes;
+    out->len = mem.len;
+    return 0;
+}
+
 #if defined(__clang__)
 #pragma clang diagnostic pop
 #endif
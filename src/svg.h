@@ -12,6 +12,7 @@
 #define CPLOT_SVG_H
 
 #include "drawing.h"
+#include "sink.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,6 +27,17 @@ extern "C" {
  */
 int svg_render_layout (const drawing_layout_t *layout, bytes_t *out);
 
+/**
+ * @brief Генерує SVG‑макет потоково у приймач.
+ * @details Якщо в `opts` задано `dpi`, точність координат підбирається під цю
+ *          роздільність, а точки, ближчі за пів пікселя, відкидаються.
+ * @param layout Вхідна розкладка сторінки і шляхів у мм.
+ * @param opts Параметри превʼю (NULL — повна точність).
+ * @param out Приймач вихідних байтів.
+ * @return 0 — успіх; 1 — помилка аргументів, виділення памʼяті або запису.
+ */
+int svg_write_layout (const drawing_layout_t *layout, const preview_opts_t *opts, sink_t *out);
+
 #ifdef __cplusplus
 }
 #endif
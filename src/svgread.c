@@ -0,0 +1,986 @@
+/**
+ * @file svgread.c
+ * @brief Реалізація потокового імпорту SVG.
+ * @ingroup svgread
+ * @details
+ * Сканер іде від `<` до `<`: коментарі, CDATA, оголошення та текстовий вміст
+ * пропускаються, атрибути тегу розбираються на місці (зрізи вхідного буфера, без
+ * копій). Кожен відкритий елемент додає кадр стеку — перетворення з його
+ * координат у мм і ознаку прихованості; закривальний тег знімає кадр. Точки
+ * підконтуру накопичуються в одному буфері, що перевикористовується, і
+ * переносяться в арену результату, коли підконтур завершено.
+ */
+
+#include "svgread.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "shape.h"
+
+/** \brief Типовий допуск апроксимації кривих, мм. */
+#define SVGREAD_FLATNESS_MM 0.05
+
+/** \brief Один піксель SVG (1/96 дюйма), мм. */
+#define SVGREAD_PX_MM (25.4 / 96.0)
+
+/** \brief Найдовше число в атрибуті, символів. */
+#define SVGREAD_NUMBER_MAX 63
+
+/**
+ * @brief Зріз вхідного буфера.
+ */
+typedef struct {
+    const char *p; /**< Початок (NULL — атрибута немає). */
+    size_t len;    /**< Довжина, байт. */
+} svgread_str_t;
+
+/**
+ * @brief Атрибути, які читає імпорт.
+ */
+typedef enum {
+    SVGREAD_ATTR_TRANSFORM = 0,
+    SVGREAD_ATTR_D,
+    SVGREAD_ATTR_POINTS,
+    SVGREAD_ATTR_X1,
+    SVGREAD_ATTR_Y1,
+    SVGREAD_ATTR_X2,
+    SVGREAD_ATTR_Y2,
+    SVGREAD_ATTR_CX,
+    SVGREAD_ATTR_CY,
+    SVGREAD_ATTR_R,
+    SVGREAD_ATTR_RX,
+    SVGREAD_ATTR_RY,
+    SVGREAD_ATTR_X,
+    SVGREAD_ATTR_Y,
+    SVGREAD_ATTR_WIDTH,
+    SVGREAD_ATTR_HEIGHT,
+    SVGREAD_ATTR_VIEWBOX,
+    SVGREAD_ATTR_DISPLAY,
+    SVGREAD_ATTR_STYLE,
+    SVGREAD_ATTR_COUNT
+} svgread_attr_t;
+
+/** \brief Імена атрибутів у порядку `svgread_attr_t`. */
+static const char *const k_svgread_attr_names[SVGREAD_ATTR_COUNT] = {
+    "transform", "d",  "points", "x1", "y1",    "x2",     "y2",      "cx",      "cy",    "r",
+    "rx",        "ry", "x",      "y",  "width", "height", "viewBox", "display", "style",
+};
+
+/** \brief Елементи, вміст яких не малюється безпосередньо. */
+static const char *const k_svgread_hidden_tags[]
+    = { "defs", "symbol", "clipPath", "mask", "marker", "pattern" };
+
+/** \brief Елементи без контурів, які імпорт пропускає з попередженням. */
+static const char *const k_svgread_skipped_tags[] = { "text", "image", "use" };
+
+/**
+ * @brief Кадр стеку відкритих елементів.
+ */
+typedef struct {
+    geom_affine_t m; /**< Координати елемента → мм. */
+    bool hidden;     /**< Вміст не малюється. */
+} svgread_frame_t;
+
+/**
+ * @brief Стан розбору.
+ */
+typedef struct {
+    geom_paths_t *out;      /**< Результат, мм. */
+    double flatness;        /**< Допуск апроксимації, мм. */
+    geom_paths_t scratch;   /**< Приймач `shape_bezier_*` для однієї кривої. */
+    geom_path_t cur;        /**< Поточний підконтур, мм. */
+    svgread_frame_t *stack; /**< Кадри відкритих елементів. */
+    size_t depth;           /**< Кількість кадрів. */
+    size_t stack_cap;       /**< Ємність стеку. */
+    bool have_root;         /**< Кореневий `<svg>` уже зустрівся. */
+    size_t skipped;         /**< Пропущено елементів без контурів. */
+} svgread_t;
+
+/**
+ * @brief Чи збігається зріз із рядком.
+ */
+static bool svgread_is (svgread_str_t s, const char *lit) {
+    size_t n = strlen (lit);
+    return s.p && s.len == n && memcmp (s.p, lit, n) == 0;
+}
+
+/**
+ * @brief Чи є імʼя в списку.
+ */
+static bool svgread_in (svgread_str_t s, const char *const *names, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        if (svgread_is (s, names[i]))
+            return true;
+    return false;
+}
+
+/**
+ * @brief Шукає підрядок у межах `[p, end)`.
+ * @return Початок входження або NULL.
+ */
+static const char *svgread_find (const char *p, const char *end, const char *needle) {
+    size_t n = strlen (needle);
+    while ((size_t)(end - p) >= n) {
+        const char *hit = (const char *)memchr (p, needle[0], (size_t)(end - p) - n + 1);
+        if (!hit)
+            return NULL;
+        if (memcmp (hit, needle, n) == 0)
+            return hit;
+        p = hit + 1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Пропускає пробіли та коми між числами.
+ */
+static const char *svgread_skip_sep (const char *p, const char *end) {
+    while (p < end && (isspace ((unsigned char)*p) || *p == ','))
+        ++p;
+    return p;
+}
+
+/**
+ * @brief Читає число за граматикою SVG (`-1-2` і `.5.5` — по два числа).
+ * @param p Поточна позиція (пробіли й коми перед числом пропускаються).
+ * @param end Кінець зрізу.
+ * @param out [out] Значення.
+ * @return Позиція після числа або NULL, якщо числа немає.
+ */
+static const char *svgread_number (const char *p, const char *end, double *out) {
+    p = svgread_skip_sep (p, end);
+    const char *q = p;
+    if (q < end && (*q == '+' || *q == '-'))
+        ++q;
+    size_t digits = 0;
+    while (q < end && isdigit ((unsigned char)*q)) {
+        ++q;
+        ++digits;
+    }
+    if (q < end && *q == '.') {
+        ++q;
+        while (q < end && isdigit ((unsigned char)*q)) {
+            ++q;
+            ++digits;
+        }
+    }
+    if (digits == 0)
+        return NULL;
+    if (q < end && (*q == 'e' || *q == 'E')) {
+        const char *e = q + 1;
+        if (e < end && (*e == '+' || *e == '-'))
+            ++e;
+        if (e < end && isdigit ((unsigned char)*e)) {
+            while (e < end && isdigit ((unsigned char)*e))
+                ++e;
+            q = e;
+        }
+    }
+    char buf[SVGREAD_NUMBER_MAX + 1];
+    size_t n = (size_t)(q - p);
+    if (n > SVGREAD_NUMBER_MAX)
+        return NULL;
+    memcpy (buf, p, n);
+    buf[n] = '\0';
+    double v = strtod (buf, NULL);
+    if (!isfinite (v))
+        return NULL;
+    *out = v;
+    return q;
+}
+
+/**
+ * @brief Читає прапорець дуги (`0` або `1`; роздільник після нього не обовʼязковий).
+ */
+static const char *svgread_flag (const char *p, const char *end, double *out) {
+    p = svgread_skip_sep (p, end);
+    if (p >= end || (*p != '0' && *p != '1'))
+        return NULL;
+    *out = (*p == '1') ? 1.0 : 0.0;
+    return p + 1;
+}
+
+/**
+ * @brief Числове значення атрибута (одиниці після числа ігноруються).
+ * @param s Зріз значення.
+ * @param def Значення за відсутності атрибута чи числа.
+ */
+static double svgread_attr_number (svgread_str_t s, double def) {
+    double v;
+    if (!s.p || !svgread_number (s.p, s.p + s.len, &v))
+        return def;
+    return v;
+}
+
+/**
+ * @brief Довжина кореневого `<svg>` у мм.
+ * @param s Зріз значення (`210mm`, `8.5in`, `600` тощо).
+ * @param out [out] Довжина, мм.
+ * @return true — задано абсолютну довжину; false — немає або відсоткова.
+ */
+static bool svgread_length_mm (svgread_str_t s, double *out) {
+    double v;
+    const char *end = s.p + s.len;
+    const char *q = s.p ? svgread_number (s.p, end, &v) : NULL;
+    if (!q || !(v > 0.0))
+        return false;
+    while (q < end && isspace ((unsigned char)*q))
+        ++q;
+    svgread_str_t unit = { q, (size_t)(end - q) };
+    while (unit.len > 0 && isspace ((unsigned char)unit.p[unit.len - 1]))
+        --unit.len;
+    double scale;
+    if (unit.len == 0 || svgread_is (unit, "px"))
+        scale = SVGREAD_PX_MM;
+    else if (svgread_is (unit, "mm"))
+        scale = 1.0;
+    else if (svgread_is (unit, "cm"))
+        scale = 10.0;
+    else if (svgread_is (unit, "in"))
+        scale = 25.4;
+    else if (svgread_is (unit, "pt"))
+        scale = 25.4 / 72.0;
+    else if (svgread_is (unit, "pc"))
+        scale = 25.4 / 6.0;
+    else
+        return false;
+    *out = v * scale;
+    return true;
+}
+
+/**
+ * @brief Застосовує перетворення до точки.
+ */
+static geom_point_t svgread_map (const geom_affine_t *m, double x, double y) {
+    return (geom_point_t){ m->a * x + m->c * y + m->e, m->b * x + m->d * y + m->f };
+}
+
+/**
+ * @brief Розбирає список перетворень атрибута `transform`.
+ * @param s Зріз значення.
+ * @param out [out] Сумарне перетворення (перше у списку застосовується останнім).
+ * @return true — успіх; false — синтаксична помилка (`out` — тотожне).
+ */
+static bool svgread_transform (svgread_str_t s, geom_affine_t *out) {
+    geom_affine_t m = { 1.0, 0.0, 0.0, 1.0, 0.0, 0.0 };
+    *out = m;
+    const char *p = s.p, *end = s.p + s.len;
+    for (;;) {
+        p = svgread_skip_sep (p, end);
+        if (p >= end)
+            break;
+        const char *name = p;
+        while (p < end && isalpha ((unsigned char)*p))
+            ++p;
+        svgread_str_t fn = { name, (size_t)(p - name) };
+        while (p < end && isspace ((unsigned char)*p))
+            ++p;
+        if (fn.len == 0 || p >= end || *p != '(')
+            return false;
+        ++p;
+        double v[6];
+        size_t n = 0;
+        const char *q;
+        while (n < 6 && (q = svgread_number (p, end, &v[n])) != NULL) {
+            p = q;
+            ++n;
+        }
+        p = svgread_skip_sep (p, end);
+        if (p >= end || *p != ')')
+            return false;
+        ++p;
+
+        geom_affine_t t;
+        if (svgread_is (fn, "matrix") && n == 6) {
+            t = (geom_affine_t){ v[0], v[1], v[2], v[3], v[4], v[5] };
+        } else if (svgread_is (fn, "translate") && (n == 1 || n == 2)) {
+            t = geom_affine_translation (v[0], n == 2 ? v[1] : 0.0);
+        } else if (svgread_is (fn, "scale") && (n == 1 || n == 2)) {
+            t = geom_affine_scaling (v[0], n == 2 ? v[1] : v[0]);
+        } else if (svgread_is (fn, "rotate") && (n == 1 || n == 3)) {
+            /* Вісь Y донизу: додатний кут SVG — за годинниковою стрілкою на екрані. */
+            t = geom_affine_rotation (v[0] * M_PI / 180.0, n == 3 ? v[1] : 0.0,
+                                      n == 3 ? v[2] : 0.0);
+        } else if (svgread_is (fn, "skewX") && n == 1) {
+            t = (geom_affine_t){ 1.0, 0.0, tan (v[0] * M_PI / 180.0), 1.0, 0.0, 0.0 };
+        } else if (svgread_is (fn, "skewY") && n == 1) {
+            t = (geom_affine_t){ 1.0, tan (v[0] * M_PI / 180.0), 0.0, 1.0, 0.0, 0.0 };
+        } else {
+            return false;
+        }
+        m = geom_affine_then (&t, &m);
+    }
+    *out = m;
+    return true;
+}
+
+/**
+ * @brief Перетворення користувацьких одиниць кореневого `<svg>` у мм.
+ * @details `viewBox` вписується в `width`×`height` зі збереженням пропорцій
+ *          (`xMinYMin meet`: зсув вирівнювання не потрібен — розкладка все одно
+ *          переносить контури в рамку). Без `viewBox` одиниця — піксель.
+ */
+static geom_affine_t svgread_viewport (const svgread_str_t *attrs) {
+    double vb[4];
+    size_t n = 0;
+    svgread_str_t s = attrs[SVGREAD_ATTR_VIEWBOX];
+    const char *p = s.p, *q;
+    while (p && n < 4 && (q = svgread_number (p, s.p + s.len, &vb[n])) != NULL) {
+        p = q;
+        ++n;
+    }
+    if (n != 4 || !(vb[2] > 0.0) || !(vb[3] > 0.0))
+        return geom_affine_scaling (SVGREAD_PX_MM, SVGREAD_PX_MM);
+
+    double w_mm = 0.0, h_mm = 0.0;
+    bool has_w = svgread_length_mm (attrs[SVGREAD_ATTR_WIDTH], &w_mm);
+    bool has_h = svgread_length_mm (attrs[SVGREAD_ATTR_HEIGHT], &h_mm);
+    double sx = has_w ? w_mm / vb[2] : 0.0;
+    double sy = has_h ? h_mm / vb[3] : 0.0;
+    double scale = SVGREAD_PX_MM;
+    if (has_w && has_h)
+        scale = fmin (sx, sy);
+    else if (has_w || has_h)
+        scale = has_w ? sx : sy;
+    return (geom_affine_t){ scale, 0.0, 0.0, scale, -vb[0] * scale, -vb[1] * scale };
+}
+
+/**
+ * @brief Чи приховує елемент `display="none"` або `style="display:none"`.
+ */
+static bool svgread_display_none (const svgread_str_t *attrs) {
+    if (svgread_is (attrs[SVGREAD_ATTR_DISPLAY], "none"))
+        return true;
+    svgread_str_t st = attrs[SVGREAD_ATTR_STYLE];
+    if (!st.p)
+        return false;
+    const char *end = st.p + st.len;
+    const char *p = svgread_find (st.p, end, "display");
+    if (!p)
+        return false;
+    p += strlen ("display");
+    while (p < end && isspace ((unsigned char)*p))
+        ++p;
+    if (p >= end || *p != ':')
+        return false;
+    ++p;
+    while (p < end && isspace ((unsigned char)*p))
+        ++p;
+    return (size_t)(end - p) >= 4 && memcmp (p, "none", 4) == 0;
+}
+
+/**
+ * @brief Завершує поточний підконтур: переносить його в результат (від двох точок).
+ */
+static int svgread_flush (svgread_t *r) {
+    int rc = 0;
+    if (r->cur.len >= 2)
+        rc = geom_paths_push_path (r->out, r->cur.pts, r->cur.len);
+    r->cur.len = 0;
+    return rc;
+}
+
+/**
+ * @brief Додає точку (мм) до поточного підконтуру.
+ */
+static int svgread_push (svgread_t *r, geom_point_t q) {
+    return geom_path_push (&r->cur, q.x, q.y);
+}
+
+/**
+ * @brief Відрізок до точки `to`; порожній підконтур починається з `from`.
+ */
+static int svgread_line (svgread_t *r, const geom_affine_t *m, geom_point_t from, geom_point_t to) {
+    if (r->cur.len == 0 && svgread_push (r, svgread_map (m, from.x, from.y)) != 0)
+        return -1;
+    return svgread_push (r, svgread_map (m, to.x, to.y));
+}
+
+/**
+ * @brief Переносить у підконтур щойно апроксимовану криву з приймача `scratch`.
+ */
+static int svgread_take_curve (svgread_t *r) {
+    const geom_path_t *seg = &r->scratch.items[r->scratch.len - 1];
+    for (size_t i = (r->cur.len > 0) ? 1 : 0; i < seg->len; ++i)
+        if (svgread_push (r, seg->pts[i]) != 0)
+            return -1;
+    /* Усі точки приймача лежать в арені — скидання зберігає ємність для наступної кривої. */
+    r->scratch.len = 0;
+    r->scratch.arena_len = 0;
+    return 0;
+}
+
+/**
+ * @brief Кубічна крива: опорні точки перетворюються в мм, тоді апроксимуються.
+ */
+static int svgread_cubic (
+    svgread_t *r,
+    const geom_affine_t *m,
+    geom_point_t p0,
+    geom_point_t p1,
+    geom_point_t p2,
+    geom_point_t p3) {
+    if (shape_bezier_cubic (
+            &r->scratch, svgread_map (m, p0.x, p0.y), svgread_map (m, p1.x, p1.y),
+            svgread_map (m, p2.x, p2.y), svgread_map (m, p3.x, p3.y), r->flatness)
+        != 0)
+        return -1;
+    return svgread_take_curve (r);
+}
+
+/**
+ * @brief Квадратична крива: опорні точки перетворюються в мм, тоді апроксимуються.
+ */
+static int svgread_quad (
+    svgread_t *r, const geom_affine_t *m, geom_point_t p0, geom_point_t p1, geom_point_t p2) {
+    if (shape_bezier_quad (
+            &r->scratch, svgread_map (m, p0.x, p0.y), svgread_map (m, p1.x, p1.y),
+            svgread_map (m, p2.x, p2.y), r->flatness)
+        != 0)
+        return -1;
+    return svgread_take_curve (r);
+}
+
+/**
+ * @brief Дуга еліпса кубічними кривими, не більш як по чверті оберту кожна.
+ * @param c Центр (координати елемента).
+ * @param rx,ry Півосі.
+ * @param phi Поворот осей, рад.
+ * @param a0 Початковий параметричний кут, рад.
+ * @param da Розмах (знак — напрям), рад.
+ */
+static int svgread_arc_cubics (
+    svgread_t *r,
+    const geom_affine_t *m,
+    geom_point_t c,
+    double rx,
+    double ry,
+    double phi,
+    double a0,
+    double da) {
+    geom_affine_t e = { cos (phi) * rx, sin (phi) * rx, -sin (phi) * ry, cos (phi) * ry, c.x, c.y };
+    int n = (int)ceil (fabs (da) / (M_PI / 2.0) - 1e-9);
+    if (n < 1)
+        n = 1;
+    double step = da / n;
+    double k = 4.0 / 3.0 * tan (step / 4.0);
+    for (int i = 0; i < n; ++i) {
+        double t0 = a0 + step * i, t1 = t0 + step;
+        double c0 = cos (t0), s0 = sin (t0), c1 = cos (t1), s1 = sin (t1);
+        geom_point_t q0 = svgread_map (&e, c0, s0);
+        geom_point_t q1 = svgread_map (&e, c0 - k * s0, s0 + k * c0);
+        geom_point_t q2 = svgread_map (&e, c1 + k * s1, s1 - k * c1);
+        geom_point_t q3 = svgread_map (&e, c1, s1);
+        if (svgread_cubic (r, m, q0, q1, q2, q3) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Команда дуги `A` шляху: перехід від кінцевих точок до центру (SVG 1.1, F.6.5).
+ */
+static int svgread_arc (
+    svgread_t *r,
+    const geom_affine_t *m,
+    geom_point_t p1,
+    double rx,
+    double ry,
+    double phi_deg,
+    bool large,
+    bool sweep,
+    geom_point_t p2) {
+    if (p1.x == p2.x && p1.y == p2.y)
+        return 0;
+    rx = fabs (rx);
+    ry = fabs (ry);
+    if (!(rx > 0.0) || !(ry > 0.0))
+        return svgread_line (r, m, p1, p2);
+    double phi = phi_deg * M_PI / 180.0;
+    double cp = cos (phi), sp = sin (phi);
+    double dx = (p1.x - p2.x) / 2.0, dy = (p1.y - p2.y) / 2.0;
+    double x1 = cp * dx + sp * dy, y1 = -sp * dx + cp * dy;
+    double lambda = (x1 * x1) / (rx * rx) + (y1 * y1) / (ry * ry);
+    if (lambda > 1.0) {
+        rx *= sqrt (lambda);
+        ry *= sqrt (lambda);
+    }
+    double num = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+    double den = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+    double coef = (den > 0.0 && num > 0.0) ? sqrt (num / den) : 0.0;
+    if (large == sweep)
+        coef = -coef;
+    double cx1 = coef * rx * y1 / ry, cy1 = -coef * ry * x1 / rx;
+    geom_point_t c = { cp * cx1 - sp * cy1 + (p1.x + p2.x) / 2.0,
+                       sp * cx1 + cp * cy1 + (p1.y + p2.y) / 2.0 };
+    double ux = (x1 - cx1) / rx, uy = (y1 - cy1) / ry;
+    double vx = (-x1 - cx1) / rx, vy = (-y1 - cy1) / ry;
+    double a0 = atan2 (uy, ux);
+    double da = atan2 (ux * vy - uy * vx, ux * vx + uy * vy);
+    if (!sweep && da > 0.0)
+        da -= 2.0 * M_PI;
+    else if (sweep && da < 0.0)
+        da += 2.0 * M_PI;
+    return svgread_arc_cubics (r, m, c, rx, ry, phi, a0, da);
+}
+
+/**
+ * @brief Кількість аргументів команди шляху (0 — невідома команда).
+ */
+static size_t svgread_path_arity (char up) {
+    switch (up) {
+    case 'M':
+    case 'L':
+    case 'T':
+        return 2;
+    case 'H':
+    case 'V':
+        return 1;
+    case 'C':
+        return 6;
+    case 'S':
+    case 'Q':
+        return 4;
+    case 'A':
+        return 7;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Розбирає дані шляху `d` і виводить підконтури.
+ * @details Помилка синтаксису зупиняє шлях, як у переглядачах: намальоване до неї
+ *          лишається.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int svgread_path (svgread_t *r, const geom_affine_t *m, svgread_str_t d) {
+    const char *p = d.p, *end = d.p + d.len;
+    char cmd = 0, prev = 0;
+    geom_point_t cur = { 0.0, 0.0 }, start = cur, ctrl = cur;
+    for (;;) {
+        p = svgread_skip_sep (p, end);
+        if (p >= end)
+            break;
+        if (isalpha ((unsigned char)*p)) {
+            cmd = *p++;
+            if (cmd == 'Z' || cmd == 'z') {
+                if (r->cur.len > 0 && svgread_line (r, m, cur, start) != 0)
+                    return -1;
+                if (svgread_flush (r) != 0)
+                    return -1;
+                cur = start;
+                prev = 'Z';
+                cmd = 0;
+                continue;
+            }
+        } else if (!cmd) {
+            break;
+        }
+        char up = (char)toupper ((unsigned char)cmd);
+        size_t arity = svgread_path_arity (up);
+        if (arity == 0)
+            break;
+        double v[7];
+        size_t got = 0;
+        for (; got < arity; ++got) {
+            bool flag = up == 'A' && (got == 3 || got == 4);
+            const char *q = flag ? svgread_flag (p, end, &v[got])
+                                 : svgread_number (p, end, &v[got]);
+            if (!q)
+                break;
+            p = q;
+        }
+        if (got < arity)
+            break;
+
+        bool rel = cmd != up;
+        double ox = rel ? cur.x : 0.0, oy = rel ? cur.y : 0.0;
+        geom_point_t to;
+        int rc = 0;
+        switch (up) {
+        case 'M':
+            rc = svgread_flush (r);
+            cur = start = (geom_point_t){ ox + v[0], oy + v[1] };
+            if (rc == 0)
+                rc = svgread_push (r, svgread_map (m, cur.x, cur.y));
+            /* Наступні пари координат — неявні відрізки. */
+            cmd = rel ? 'l' : 'L';
+            break;
+        case 'L':
+            to = (geom_point_t){ ox + v[0], oy + v[1] };
+            rc = svgread_line (r, m, cur, to);
+            cur = to;
+            break;
+        case 'H':
+            to = (geom_point_t){ ox + v[0], cur.y };
+            rc = svgread_line (r, m, cur, to);
+            cur = to;
+            break;
+        case 'V':
+            to = (geom_point_t){ cur.x, oy + v[0] };
+            rc = svgread_line (r, m, cur, to);
+            cur = to;
+            break;
+        case 'C':
+        case 'S': {
+            geom_point_t c1;
+            size_t k = 0;
+            if (up == 'C') {
+                c1 = (geom_point_t){ ox + v[0], oy + v[1] };
+                k = 2;
+            } else if (prev == 'C' || prev == 'S') {
+                c1 = (geom_point_t){ 2.0 * cur.x - ctrl.x, 2.0 * cur.y - ctrl.y };
+            } else {
+                c1 = cur;
+            }
+            geom_point_t c2 = { ox + v[k], oy + v[k + 1] };
+            to = (geom_point_t){ ox + v[k + 2], oy + v[k + 3] };
+            rc = svgread_cubic (r, m, cur, c1, c2, to);
+            ctrl = c2;
+            cur = to;
+            break;
+        }
+        case 'Q':
+        case 'T': {
+            geom_point_t c1;
+            size_t k = 0;
+            if (up == 'Q') {
+                c1 = (geom_point_t){ ox + v[0], oy + v[1] };
+                k = 2;
+            } else if (prev == 'Q' || prev == 'T') {
+                c1 = (geom_point_t){ 2.0 * cur.x - ctrl.x, 2.0 * cur.y - ctrl.y };
+            } else {
+                c1 = cur;
+            }
+            to = (geom_point_t){ ox + v[k], oy + v[k + 1] };
+            rc = svgread_quad (r, m, cur, c1, to);
+            ctrl = c1;
+            cur = to;
+            break;
+        }
+        case 'A':
+            to = (geom_point_t){ ox + v[5], oy + v[6] };
+            rc = svgread_arc (r, m, cur, v[0], v[1], v[2], v[3] != 0.0, v[4] != 0.0, to);
+            cur = to;
+            break;
+        default:
+            break;
+        }
+        if (rc != 0)
+            return -1;
+        prev = up;
+    }
+    return svgread_flush (r);
+}
+
+/**
+ * @brief Розбирає список точок `points` у підконтур.
+ */
+static int svgread_points (svgread_t *r, const geom_affine_t *m, svgread_str_t s, bool closed) {
+    const char *p = s.p, *end = s.p + s.len, *q;
+    double x, y;
+    geom_point_t first = { 0.0, 0.0 };
+    while ((q = svgread_number (p, end, &x)) != NULL && (q = svgread_number (q, end, &y)) != NULL) {
+        p = q;
+        if (r->cur.len == 0)
+            first = (geom_point_t){ x, y };
+        if (svgread_push (r, svgread_map (m, x, y)) != 0)
+            return -1;
+    }
+    if (closed && r->cur.len >= 2 && svgread_push (r, svgread_map (m, first.x, first.y)) != 0)
+        return -1;
+    return svgread_flush (r);
+}
+
+/**
+ * @brief Прямокутник, зокрема із заокругленими кутами (`rx`/`ry`).
+ */
+static int svgread_rect (svgread_t *r, const geom_affine_t *m, const svgread_str_t *attrs) {
+    double x = svgread_attr_number (attrs[SVGREAD_ATTR_X], 0.0);
+    double y = svgread_attr_number (attrs[SVGREAD_ATTR_Y], 0.0);
+    double w = svgread_attr_number (attrs[SVGREAD_ATTR_WIDTH], 0.0);
+    double h = svgread_attr_number (attrs[SVGREAD_ATTR_HEIGHT], 0.0);
+    if (!(w > 0.0) || !(h > 0.0))
+        return 0;
+    double rx = svgread_attr_number (attrs[SVGREAD_ATTR_RX], -1.0);
+    double ry = svgread_attr_number (attrs[SVGREAD_ATTR_RY], -1.0);
+    if (rx < 0.0)
+        rx = ry;
+    if (ry < 0.0)
+        ry = rx;
+    rx = fmin (fmax (rx, 0.0), w / 2.0);
+    ry = fmin (fmax (ry, 0.0), h / 2.0);
+
+    geom_point_t corners[4] = { { x + w - rx, y + ry },
+                                { x + w - rx, y + h - ry },
+                                { x + rx, y + h - ry },
+                                { x + rx, y + ry } };
+    geom_point_t at = { x + rx, y };
+    for (int i = 0; i < 4; ++i) {
+        /* Сторона до початку дуги кута, тоді чверть еліпса (-90°, 0°, 90°, 180°). */
+        double a0 = (i - 1) * M_PI / 2.0;
+        geom_point_t arc0 = { corners[i].x + rx * cos (a0), corners[i].y + ry * sin (a0) };
+        if (svgread_line (r, m, at, arc0) != 0)
+            return -1;
+        if (rx > 0.0 && ry > 0.0
+            && svgread_arc_cubics (r, m, corners[i], rx, ry, 0.0, a0, M_PI / 2.0) != 0)
+            return -1;
+        at = (geom_point_t){ corners[i].x + rx * cos (a0 + M_PI / 2.0),
+                             corners[i].y + ry * sin (a0 + M_PI / 2.0) };
+    }
+    /* Остання дуга повертається в початок з похибкою тригонометрії — замикаємо точно. */
+    r->cur.pts[r->cur.len - 1] = svgread_map (m, x + rx, y);
+    return svgread_flush (r);
+}
+
+/**
+ * @brief Виводить контур елемента з атрибутами `attrs` у координатах `m`.
+ */
+static int svgread_element (
+    svgread_t *r, svgread_str_t tag, const geom_affine_t *m, const svgread_str_t *attrs) {
+    if (svgread_is (tag, "path")) {
+        return attrs[SVGREAD_ATTR_D].p ? svgread_path (r, m, attrs[SVGREAD_ATTR_D]) : 0;
+    } else if (svgread_is (tag, "polyline") || svgread_is (tag, "polygon")) {
+        if (!attrs[SVGREAD_ATTR_POINTS].p)
+            return 0;
+        return svgread_points (r, m, attrs[SVGREAD_ATTR_POINTS], svgread_is (tag, "polygon"));
+    } else if (svgread_is (tag, "line")) {
+        geom_point_t a = { svgread_attr_number (attrs[SVGREAD_ATTR_X1], 0.0),
+                           svgread_attr_number (attrs[SVGREAD_ATTR_Y1], 0.0) };
+        geom_point_t b = { svgread_attr_number (attrs[SVGREAD_ATTR_X2], 0.0),
+                           svgread_attr_number (attrs[SVGREAD_ATTR_Y2], 0.0) };
+        if (svgread_line (r, m, a, b) != 0)
+            return -1;
+        return svgread_flush (r);
+    } else if (svgread_is (tag, "rect")) {
+        return svgread_rect (r, m, attrs);
+    } else if (svgread_is (tag, "circle") || svgread_is (tag, "ellipse")) {
+        bool circle = svgread_is (tag, "circle");
+        geom_point_t c = { svgread_attr_number (attrs[SVGREAD_ATTR_CX], 0.0),
+                           svgread_attr_number (attrs[SVGREAD_ATTR_CY], 0.0) };
+        double rx = svgread_attr_number (attrs[circle ? SVGREAD_ATTR_R : SVGREAD_ATTR_RX], 0.0);
+        double ry = circle ? rx : svgread_attr_number (attrs[SVGREAD_ATTR_RY], 0.0);
+        if (!(rx > 0.0) || !(ry > 0.0))
+            return 0;
+        if (svgread_arc_cubics (r, m, c, rx, ry, 0.0, 0.0, 2.0 * M_PI) != 0)
+            return -1;
+        return svgread_flush (r);
+    } else if (svgread_in (
+                   tag, k_svgread_skipped_tags,
+                   sizeof (k_svgread_skipped_tags) / sizeof (k_svgread_skipped_tags[0]))) {
+        r->skipped++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Додає кадр у стек відкритих елементів.
+ */
+static int svgread_push_frame (svgread_t *r, const svgread_frame_t *f) {
+    if (r->depth == r->stack_cap) {
+        size_t cap = r->stack_cap ? r->stack_cap * 2 : 16;
+        svgread_frame_t *grown = (svgread_frame_t *)realloc (r->stack, cap * sizeof (*grown));
+        if (!grown)
+            return -1;
+        r->stack = grown;
+        r->stack_cap = cap;
+    }
+    r->stack[r->depth++] = *f;
+    return 0;
+}
+
+/**
+ * @brief Обробляє відкривальний тег: атрибути, кадр стеку, контур.
+ * @param r Стан розбору.
+ * @param p Позиція одразу після `<`.
+ * @param end Кінець документа.
+ * @param out_next [out] Позиція після `>`.
+ * @return 0 — успіх; -1 — помилка памʼяті.
+ */
+static int svgread_start_tag (svgread_t *r, const char *p, const char *end, const char **out_next) {
+    const char *name = p;
+    while (p < end && !isspace ((unsigned char)*p) && *p != '>' && *p != '/')
+        ++p;
+    svgread_str_t tag = { name, (size_t)(p - name) };
+    const char *colon = memchr (tag.p, ':', tag.len);
+    if (colon) {
+        tag.len -= (size_t)(colon + 1 - tag.p);
+        tag.p = colon + 1;
+    }
+
+    svgread_str_t attrs[SVGREAD_ATTR_COUNT];
+    memset (attrs, 0, sizeof (attrs));
+    bool self_closing = false;
+    for (;;) {
+        while (p < end && isspace ((unsigned char)*p))
+            ++p;
+        if (p >= end)
+            break;
+        if (*p == '>') {
+            ++p;
+            break;
+        }
+        if (*p == '/') {
+            ++p;
+            if (p < end && *p == '>') {
+                self_closing = true;
+                ++p;
+                break;
+            }
+            continue;
+        }
+        const char *an = p;
+        while (p < end && !isspace ((unsigned char)*p) && *p != '=' && *p != '>' && *p != '/')
+            ++p;
+        svgread_str_t key = { an, (size_t)(p - an) };
+        while (p < end && isspace ((unsigned char)*p))
+            ++p;
+        svgread_str_t val = { NULL, 0 };
+        if (p < end && *p == '=') {
+            ++p;
+            while (p < end && isspace ((unsigned char)*p))
+                ++p;
+            if (p < end && (*p == '"' || *p == '\'')) {
+                const char *close = memchr (p + 1, *p, (size_t)(end - p - 1));
+                if (!close)
+                    close = end;
+                val = (svgread_str_t){ p + 1, (size_t)(close - p - 1) };
+                p = close < end ? close + 1 : end;
+            } else {
+                const char *v = p;
+                while (p < end && !isspace ((unsigned char)*p) && *p != '>')
+                    ++p;
+                val = (svgread_str_t){ v, (size_t)(p - v) };
+            }
+        }
+        if (key.len == 0) {
+            ++p;
+            continue;
+        }
+        for (size_t i = 0; i < SVGREAD_ATTR_COUNT; ++i)
+            if (svgread_is (key, k_svgread_attr_names[i])) {
+                attrs[i] = val;
+                break;
+            }
+    }
+    *out_next = p;
+
+    svgread_frame_t parent = { geom_affine_scaling (SVGREAD_PX_MM, SVGREAD_PX_MM), false };
+    if (r->depth > 0)
+        parent = r->stack[r->depth - 1];
+    svgread_frame_t frame = parent;
+    geom_affine_t local = { 1.0, 0.0, 0.0, 1.0, 0.0, 0.0 };
+    if (attrs[SVGREAD_ATTR_TRANSFORM].p
+        && !svgread_transform (attrs[SVGREAD_ATTR_TRANSFORM], &local))
+        LOGD ("svg: некоректний transform у <%.*s> — ігнорую", (int)tag.len, tag.p);
+    if (svgread_is (tag, "svg")) {
+        geom_affine_t base = parent.m;
+        if (!r->have_root) {
+            base = svgread_viewport (attrs);
+            r->have_root = true;
+        } else {
+            geom_affine_t at = geom_affine_translation (
+                svgread_attr_number (attrs[SVGREAD_ATTR_X], 0.0),
+                svgread_attr_number (attrs[SVGREAD_ATTR_Y], 0.0));
+            base = geom_affine_then (&at, &base);
+        }
+        frame.m = geom_affine_then (&local, &base);
+    } else {
+        frame.m = geom_affine_then (&local, &parent.m);
+    }
+    frame.hidden = parent.hidden || svgread_display_none (attrs)
+                   || svgread_in (
+                       tag, k_svgread_hidden_tags,
+                       sizeof (k_svgread_hidden_tags) / sizeof (k_svgread_hidden_tags[0]));
+
+    if (!frame.hidden && r->have_root && svgread_element (r, tag, &frame.m, attrs) != 0)
+        return -1;
+    if (!self_closing && svgread_push_frame (r, &frame) != 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Основний цикл: від тегу до тегу.
+ */
+static int svgread_run (svgread_t *r, const char *data, size_t len) {
+    const char *p = data, *end = data + len;
+    while (p < end) {
+        const char *lt = (const char *)memchr (p, '<', (size_t)(end - p));
+        if (!lt)
+            break;
+        p = lt + 1;
+        if (p >= end)
+            break;
+        if (*p == '!') {
+            const char *close;
+            if ((size_t)(end - p) >= 3 && memcmp (p, "!--", 3) == 0) {
+                close = svgread_find (p + 3, end, "-->");
+                p = close ? close + 3 : end;
+            } else if ((size_t)(end - p) >= 8 && memcmp (p, "![CDATA[", 8) == 0) {
+                close = svgread_find (p + 8, end, "]]>");
+                p = close ? close + 3 : end;
+            } else {
+                /* DOCTYPE: внутрішня підмножина в дужках може містити `>`. */
+                const char *gt = memchr (p, '>', (size_t)(end - p));
+                const char *br = memchr (p, '[', (size_t)(end - p));
+                if (br && (!gt || br < gt)) {
+                    close = svgread_find (br, end, "]>");
+                    p = close ? close + 2 : end;
+                } else {
+                    p = gt ? gt + 1 : end;
+                }
+            }
+        } else if (*p == '?') {
+            const char *close = svgread_find (p, end, "?>");
+            p = close ? close + 2 : end;
+        } else if (*p == '/') {
+            const char *gt = memchr (p, '>', (size_t)(end - p));
+            p = gt ? gt + 1 : end;
+            if (r->depth > 0)
+                r->depth--;
+        } else if (svgread_start_tag (r, p, end, &p) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @copydoc svgread_paths
+ */
+int svgread_paths (const char *data, size_t len, const svgread_opts_t *opts, geom_paths_t *out) {
+    if (!out || (!data && len > 0))
+        return -1;
+    if (geom_paths_init (out, GEOM_UNITS_MM) != 0)
+        return -1;
+    svgread_t r;
+    memset (&r, 0, sizeof (r));
+    r.out = out;
+    r.flatness = (opts && opts->flatness_mm > 0.0) ? opts->flatness_mm : SVGREAD_FLATNESS_MM;
+    if (geom_paths_init (&r.scratch, GEOM_UNITS_MM) != 0 || geom_path_init (&r.cur, 64) != 0) {
+        geom_paths_free (&r.scratch);
+        return -1;
+    }
+
+    int rc = svgread_run (&r, data, len);
+    if (rc == 0 && !r.have_root)
+        rc = 1;
+    free (r.cur.pts);
+    free (r.stack);
+    geom_paths_free (&r.scratch);
+    if (rc != 0) {
+        geom_paths_free (out);
+        return rc;
+    }
+    if (r.skipped > 0)
+        LOGW ("SVG: пропущено елементів без контурів (text, image, use): %zu", r.skipped);
+    LOGD ("svg: контурів %zu, точок %zu", out->len, out->arena_len);
+    return 0;
+}
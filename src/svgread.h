@@ -0,0 +1,53 @@
+/**
+ * @file svgread.h
+ * @brief Потоковий імпорт контурів із SVG.
+ * @defgroup svgread Імпорт SVG
+ * @ingroup drawing
+ * @details
+ * Документ читається одним проходом по байтах, без дерева елементів: парсер
+ * тримає лише стек перетворень відкритих елементів і поточний підконтур, тож
+ * памʼять не залежить від розміру файла (сотні мегабайт експорту з CAD
+ * відображаються у памʼять і лише переглядаються) — росте тільки результат.
+ *
+ * Малюються `<path>` (усі команди `d`, зокрема дуги), `<polyline>`, `<polygon>`,
+ * `<line>`, `<rect>`, `<circle>` та `<ellipse>`. Атрибут `transform` діє на
+ * будь-якому елементі, `viewBox`/`width`/`height` кореневого `<svg>` задають
+ * перехід у міліметри (без розмірів — 96 px на дюйм). Опорні точки кривих спершу
+ * перетворюються, а тоді апроксимуються `shape_bezier_*`, тож допуск задано в мм
+ * на папері. Вміст `<defs>`, `<symbol>`, `<clipPath>`, `<mask>`, `<marker>`,
+ * `<pattern>` і приховані (`display: none`) елементи не малюються; стилі
+ * обведення й заливки ігноруються — плотер проходить кожен контур.
+ */
+#ifndef CPLOT_SVGREAD_H
+#define CPLOT_SVGREAD_H
+
+#include <stddef.h>
+
+#include "geom.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Параметри імпорту SVG.
+ */
+typedef struct {
+    double flatness_mm; /**< Допуск апроксимації кривих, мм (<=0 — типовий). */
+} svgread_opts_t;
+
+/**
+ * @brief Розбирає SVG і складає його контури в міліметрах.
+ * @param data Байти документа (завершальний `\0` не потрібен).
+ * @param len Довжина документа, байт.
+ * @param opts Параметри (NULL — типові).
+ * @param out [out] Контури у мм (ініціалізується тут; звільнити `geom_paths_free`).
+ * @return 0 — успіх; 1 — у вході немає елемента `<svg>`; -1 — аргументи або памʼять.
+ */
+int svgread_paths (const char *data, size_t len, const svgread_opts_t *opts, geom_paths_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
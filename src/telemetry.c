@@ -0,0 +1,277 @@
+/**
+ * @file telemetry.c
+ * @brief Реалізація телеметрії обміну з контролером.
+ * @ingroup telemetry
+ */
+#include "telemetry.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "jsw.h"
+#include "log.h"
+#include "str.h"
+
+bool telemetry_enabled = false;
+
+/** Назви видів очікування у JSON (порядок — як у `telemetry_wait_t`). */
+static const char *const k_telemetry_wait_names[TELEMETRY_WAIT_COUNT] = { "fifo", "rate" };
+
+static uint64_t g_rtt_buckets[TELEMETRY_RTT_BUCKETS]; /**< Гістограма відповідей. */
+static uint64_t g_rtt_count;                          /**< Підтверджені команди. */
+static uint64_t g_rtt_total_ns;                       /**< Сумарний час відповідей, нс. */
+static uint64_t g_rtt_max_ns;                         /**< Найдовша відповідь, нс. */
+static uint64_t g_wait_ns[TELEMETRY_WAIT_COUNT];      /**< Час очікування, нс. */
+static uint64_t g_wait_count[TELEMETRY_WAIT_COUNT];   /**< Кількість очікувань. */
+static uint64_t g_idle_count;                         /**< Простої моторів. */
+static uint64_t g_idle_total_ns;                      /**< Сумарний простій, нс. */
+static uint64_t g_idle_max_ns;                        /**< Найдовший простій, нс. */
+
+static uint64_t g_start_ns;              /**< Момент увімкнення. */
+static uint64_t g_last_snapshot_ns;      /**< Момент попереднього знімка. */
+static uint64_t g_last_snapshot_cmds;    /**< Команди на момент попереднього знімка. */
+static char g_path[PATH_MAX];            /**< Файл знімків або `-`. */
+static pthread_t g_thread;               /**< Потік знімків. */
+static bool g_thread_started;            /**< Потік запущено. */
+static bool g_stop;                      /**< Запит зупинки (під `g_lock`). */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+
+/** \brief Атомарно піднімає максимум. */
+static void telemetry_store_max (uint64_t *slot, uint64_t value) {
+    uint64_t cur = __atomic_load_n (slot, __ATOMIC_RELAXED);
+    while (value > cur
+           && !__atomic_compare_exchange_n (
+               slot, &cur, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/** \brief Тривалість від `start_ns` до зараз, нс. */
+static uint64_t telemetry_elapsed (uint64_t start_ns) {
+    uint64_t now = ttime_now_ns ();
+    return now > start_ns ? now - start_ns : 0;
+}
+
+/** @copydoc telemetry_record_rtt */
+void telemetry_record_rtt (uint64_t start_ns) {
+    uint64_t ns = telemetry_elapsed (start_ns);
+    uint64_t us = ns / 1000u;
+    size_t bucket = 0;
+    while (us && bucket + 1 < TELEMETRY_RTT_BUCKETS) {
+        us >>= 1;
+        ++bucket;
+    }
+    __atomic_fetch_add (&g_rtt_buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&g_rtt_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&g_rtt_total_ns, ns, __ATOMIC_RELAXED);
+    telemetry_store_max (&g_rtt_max_ns, ns);
+}
+
+/** @copydoc telemetry_record_wait */
+void telemetry_record_wait (telemetry_wait_t kind, uint64_t start_ns) {
+    if ((unsigned)kind >= TELEMETRY_WAIT_COUNT)
+        return;
+    __atomic_fetch_add (&g_wait_ns[kind], telemetry_elapsed (start_ns), __ATOMIC_RELAXED);
+    __atomic_fetch_add (&g_wait_count[kind], 1, __ATOMIC_RELAXED);
+}
+
+/** @copydoc telemetry_record_idle */
+void telemetry_record_idle (double gap_ms) {
+    uint64_t ns = (uint64_t)(gap_ms * 1e6);
+    __atomic_fetch_add (&g_idle_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&g_idle_total_ns, ns, __ATOMIC_RELAXED);
+    telemetry_store_max (&g_idle_max_ns, ns);
+}
+
+/**
+ * @brief Оцінює перцентиль часу відповіді за гістограмою.
+ * @param buckets Знімок кошиків.
+ * @param count Кількість вимірів.
+ * @param q Частка (0..1).
+ * @param max_us Найдовша відповідь (межа останнього кошика), мкс.
+ * @return Верхня межа кошика, у який потрапляє перцентиль, мкс.
+ */
+static double telemetry_rtt_percentile (
+    const uint64_t *buckets, uint64_t count, double q, double max_us) {
+    if (count == 0)
+        return 0.0;
+    uint64_t target = (uint64_t)((double)count * q);
+    if (target == 0)
+        target = 1;
+    uint64_t seen = 0;
+    for (size_t k = 0; k + 1 < TELEMETRY_RTT_BUCKETS; ++k) {
+        seen += buckets[k];
+        if (seen >= target) {
+            double bound = (double)(1u << k);
+            return bound < max_us ? bound : max_us;
+        }
+    }
+    return max_us;
+}
+
+/** @copydoc telemetry_write_json */
+void telemetry_write_json (FILE *out) {
+    if (!out || !telemetry_enabled)
+        return;
+    uint64_t now = ttime_now_ns ();
+    uint64_t buckets[TELEMETRY_RTT_BUCKETS];
+    for (size_t k = 0; k < TELEMETRY_RTT_BUCKETS; ++k)
+        buckets[k] = __atomic_load_n (&g_rtt_buckets[k], __ATOMIC_RELAXED);
+    uint64_t cmds = __atomic_load_n (&g_rtt_count, __ATOMIC_RELAXED);
+    double total_ms = (double)__atomic_load_n (&g_rtt_total_ns, __ATOMIC_RELAXED) / 1e6;
+    double max_us = (double)__atomic_load_n (&g_rtt_max_ns, __ATOMIC_RELAXED) / 1e3;
+    double span_s = (double)(now - g_last_snapshot_ns) / 1e9;
+    double rate = span_s > 0.0 ? (double)(cmds - g_last_snapshot_cmds) / span_s : 0.0;
+    g_last_snapshot_ns = now;
+    g_last_snapshot_cmds = cmds;
+
+    json_writer_t w;
+    jsw_jsonw_init (&w, out);
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "t_ms");
+    jsw_jsonw_double (&w, (double)(now - g_start_ns) / 1e6);
+    jsw_jsonw_key (&w, "commands");
+    jsw_jsonw_int (&w, (long long)cmds);
+    jsw_jsonw_key (&w, "commands_per_s");
+    jsw_jsonw_double (&w, rate);
+
+    jsw_jsonw_key (&w, "rtt_us");
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "mean");
+    jsw_jsonw_double (&w, cmds ? total_ms * 1e3 / (double)cmds : 0.0);
+    jsw_jsonw_key (&w, "p50");
+    jsw_jsonw_double (&w, telemetry_rtt_percentile (buckets, cmds, 0.50, max_us));
+    jsw_jsonw_key (&w, "p90");
+    jsw_jsonw_double (&w, telemetry_rtt_percentile (buckets, cmds, 0.90, max_us));
+    jsw_jsonw_key (&w, "p99");
+    jsw_jsonw_double (&w, telemetry_rtt_percentile (buckets, cmds, 0.99, max_us));
+    jsw_jsonw_key (&w, "max");
+    jsw_jsonw_double (&w, max_us);
+    /* Кошик k — відповіді коротші за 2^k мкс (останній — решта). */
+    jsw_jsonw_key (&w, "buckets");
+    jsw_jsonw_begin_array (&w);
+    for (size_t k = 0; k < TELEMETRY_RTT_BUCKETS; ++k)
+        jsw_jsonw_int (&w, (long long)buckets[k]);
+    jsw_jsonw_end_array (&w);
+    jsw_jsonw_end_object (&w);
+
+    jsw_jsonw_key (&w, "wait");
+    jsw_jsonw_begin_object (&w);
+    for (int i = 0; i < TELEMETRY_WAIT_COUNT; ++i) {
+        jsw_jsonw_key (&w, k_telemetry_wait_names[i]);
+        jsw_jsonw_begin_object (&w);
+        jsw_jsonw_key (&w, "ms");
+        jsw_jsonw_double (&w, (double)__atomic_load_n (&g_wait_ns[i], __ATOMIC_RELAXED) / 1e6);
+        jsw_jsonw_key (&w, "count");
+        jsw_jsonw_int (&w, (long long)__atomic_load_n (&g_wait_count[i], __ATOMIC_RELAXED));
+        jsw_jsonw_end_object (&w);
+    }
+    jsw_jsonw_end_object (&w);
+
+    jsw_jsonw_key (&w, "idle");
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "gaps");
+    jsw_jsonw_int (&w, (long long)__atomic_load_n (&g_idle_count, __ATOMIC_RELAXED));
+    jsw_jsonw_key (&w, "ms");
+    jsw_jsonw_double (&w, (double)__atomic_load_n (&g_idle_total_ns, __ATOMIC_RELAXED) / 1e6);
+    jsw_jsonw_key (&w, "max_ms");
+    jsw_jsonw_double (&w, (double)__atomic_load_n (&g_idle_max_ns, __ATOMIC_RELAXED) / 1e6);
+    jsw_jsonw_end_object (&w);
+    jsw_jsonw_end_object (&w);
+    fputc ('\n', out);
+}
+
+/**
+ * @brief Записує знімок у файл через тимчасовий файл або рядком у stderr.
+ * @return 0 — успіх; -1 — помилка запису файлу.
+ */
+static int telemetry_snapshot (void) {
+    if (strcmp (g_path, "-") == 0) {
+        telemetry_write_json (stderr);
+        fflush (stderr);
+        return 0;
+    }
+    char tmp[PATH_MAX + 8];
+    snprintf (tmp, sizeof (tmp), "%s.tmp", g_path);
+    FILE *fp = fopen (tmp, "w");
+    if (!fp)
+        return -1;
+    telemetry_write_json (fp);
+    bool ok = !ferror (fp);
+    if (fclose (fp) != 0)
+        ok = false;
+    if (!ok || rename (tmp, g_path) != 0) {
+        remove (tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/** \brief Потік знімків: пише раз на `TELEMETRY_INTERVAL_MS` до `telemetry_stop`. */
+static void *telemetry_main (void *arg) {
+    (void)arg;
+    bool warned = false;
+    pthread_mutex_lock (&g_lock);
+    while (!g_stop) {
+        struct timespec until;
+        clock_gettime (CLOCK_REALTIME, &until);
+        until.tv_sec += TELEMETRY_INTERVAL_MS / 1000;
+        until.tv_nsec += (long)(TELEMETRY_INTERVAL_MS % 1000) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec += 1;
+            until.tv_nsec -= 1000000000L;
+        }
+        int rc = 0;
+        while (!g_stop && rc != ETIMEDOUT)
+            rc = pthread_cond_timedwait (&g_wake, &g_lock, &until);
+        if (g_stop)
+            break;
+        pthread_mutex_unlock (&g_lock);
+        if (telemetry_snapshot () != 0 && !warned) {
+            LOGW ("телеметрія: не вдалося записати %s", g_path);
+            warned = true;
+        }
+        pthread_mutex_lock (&g_lock);
+    }
+    pthread_mutex_unlock (&g_lock);
+    return NULL;
+}
+
+/** @copydoc telemetry_start */
+int telemetry_start (const char *path) {
+    if (!path || !path[0] || telemetry_enabled)
+        return 0;
+    str_string_copy (g_path, sizeof (g_path), path);
+    g_start_ns = ttime_now_ns ();
+    g_last_snapshot_ns = g_start_ns;
+    g_stop = false;
+    telemetry_enabled = true;
+    if (pthread_create (&g_thread, NULL, telemetry_main, NULL) != 0) {
+        LOGW ("телеметрія: не вдалося запустити потік знімків");
+        telemetry_enabled = false;
+        return -1;
+    }
+    g_thread_started = true;
+    LOGD ("телеметрія: знімки кожні %d мс у %s", TELEMETRY_INTERVAL_MS, g_path);
+    return 0;
+}
+
+/** @copydoc telemetry_stop */
+void telemetry_stop (void) {
+    if (!telemetry_enabled)
+        return;
+    if (g_thread_started) {
+        pthread_mutex_lock (&g_lock);
+        g_stop = true;
+        pthread_cond_signal (&g_wake);
+        pthread_mutex_unlock (&g_lock);
+        pthread_join (g_thread, NULL);
+        g_thread_started = false;
+    }
+    if (telemetry_snapshot () != 0)
+        LOGW ("телеметрія: не вдалося записати %s", g_path);
+    telemetry_enabled = false;
+}
@@ -0,0 +1,87 @@
+#ifndef CPLOT_TELEMETRY_H
+#define CPLOT_TELEMETRY_H
+/**
+ * @file telemetry.h
+ * @brief Телеметрія обміну з контролером під час друку.
+ * @defgroup telemetry Телеметрія пристрою
+ * @ingroup device
+ * @details
+ * Лічильники серійного шляху (`--telemetry PATH`): гістограма часу «команда → OK»,
+ * час, проведений в очікуванні місця у FIFO контролера, і в паузі між командами
+ * (`min_cmd_interval_ms`), кількість команд і простої моторів між блоками. Фоновий
+ * потік раз на `TELEMETRY_INTERVAL_MS` записує знімок одним рядком JSON: у файл — через
+ * тимчасовий файл і `rename`, тож його можна читати під час друку, або в stderr, якщо
+ * шлях `-`. Поки телеметрію вимкнено, кожна точка виміру — одна перевірка прапорця.
+ * Значення додаються атомарно; пристрої пакетного друку сумуються.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ttime.h"
+
+/** Період знімків телеметрії, мс. */
+#define TELEMETRY_INTERVAL_MS 1000
+
+/** Кількість кошиків гістограми: межі 2^k мкс для k = 0..TELEMETRY_RTT_BUCKETS-2. */
+#define TELEMETRY_RTT_BUCKETS 20
+
+/**
+ * @brief Вид очікування перед відправкою команди.
+ */
+typedef enum {
+    TELEMETRY_WAIT_FIFO, /**< Місце у FIFO контролера або підтвердження конвеєра. */
+    TELEMETRY_WAIT_RATE, /**< Мінімальний інтервал між командами. */
+    TELEMETRY_WAIT_COUNT
+} telemetry_wait_t;
+
+/** Прапорець телеметрії (встановлюється `telemetry_start` до запуску потоків). */
+extern bool telemetry_enabled;
+
+/**
+ * @brief Вмикає телеметрію і запускає потік знімків.
+ * @param path Файл знімків; `-` — рядки JSON у stderr; NULL або порожній — вимкнено.
+ * @return 0 — успіх або вимкнено; -1 — не вдалося запустити потік.
+ */
+int telemetry_start (const char *path);
+
+/** Зупиняє потік і записує останній знімок (без увімкненої телеметрії — no-op). */
+void telemetry_stop (void);
+
+/** Додає час відповіді на команду, нс від запису до OK. */
+void telemetry_record_rtt (uint64_t start_ns);
+
+/** Додає час очікування перед відправкою, нс від `start_ns`. */
+void telemetry_record_wait (telemetry_wait_t kind, uint64_t start_ns);
+
+/** Додає простій моторів між блоками, мс. */
+void telemetry_record_idle (double gap_ms);
+
+/** \brief Мітка часу для вимірів телеметрії або 0, коли її вимкнено. */
+static inline uint64_t telemetry_now (void) { return telemetry_enabled ? ttime_now_ns () : 0; }
+
+/** \brief Завершує вимір часу відповіді, розпочатий `telemetry_now`. */
+static inline void telemetry_rtt (uint64_t start_ns) {
+    if (telemetry_enabled && start_ns)
+        telemetry_record_rtt (start_ns);
+}
+
+/** \brief Завершує вимір очікування, розпочатий `telemetry_now`. */
+static inline void telemetry_wait (telemetry_wait_t kind, uint64_t start_ns) {
+    if (telemetry_enabled && start_ns)
+        telemetry_record_wait (kind, start_ns);
+}
+
+/** \brief Фіксує простій моторів перед новою командою руху. */
+static inline void telemetry_idle (double gap_ms) {
+    if (telemetry_enabled && gap_ms > 0.0)
+        telemetry_record_idle (gap_ms);
+}
+
+/**
+ * @brief Друкує знімок телеметрії одним рядком JSON.
+ * @param out Потік.
+ */
+void telemetry_write_json (FILE *out);
+
+#endif
@@ -13,10 +13,14 @@
 #include "font.h"
 #include "fontreg.h"
 #include "glyph.h"
+#include "glyphlayout.h"
+#include "parallel.h"
 #include "shape.h"
 #include "str.h"
+#include "ttime.h"
 
 #include <ctype.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -29,6 +33,9 @@
 #define ARRAY_LEN(arr) (sizeof (arr) / sizeof ((arr)[0]))
 #endif
 
+/** \brief Маркер недійсної UTF‑8 послідовності у декодованому рядку (поза діапазоном Unicode). */
+#define TEXT_CP_INVALID 0xFFFFFFFFu
+
 /** \brief Порівняння `uint32_t` для `qsort`. */
 static int fontreg_cmp_uint32 (const void *a, const void *b) {
     uint32_t ua = *(const uint32_t *)a;
@@ -40,33 +47,22 @@ static int fontreg_cmp_uint32 (const void *a, const void *b) {
     return 0;
 }
 
-/**
- * @brief Гарантує ємність масиву кодових точок.
- */
-static int text_ensure_codepoints_capacity (uint32_t **arr, size_t *cap, size_t needed) {
-    if (!arr || !cap)
-        return -1;
-    if (*cap >= needed)
-        return 0;
-    size_t new_cap = (*cap == 0) ? 16 : *cap;
-    while (new_cap < needed)
-        new_cap *= 2;
-    uint32_t *grown = realloc (*arr, new_cap * sizeof (*grown));
-    if (!grown)
-        return -1;
-    *arr = grown;
-    *cap = new_cap;
-    return 0;
-}
+/** \brief Байтів вводу на один виклик декодера під час збору кодових точок. */
+#define TEXT_DECODE_CHUNK 4096
 
 /**
  * @brief Декодує UTF‑8 рядок у унікальні відсортовані кодові точки.
+ * @details Покриття базової площини (U+0000…U+FFFF) збирається в бітову множину
+ *          на 8 КіБ — без сортування за розміром вводу; кодові точки поза нею
+ *          (рідкісні) сортуються окремо. Результат — обхід множини за зростанням.
+ * @param arena Арена для масиву й проміжних буферів (NULL — купа).
  * @param text Вхідний текст.
- * @param out_codes [out] Масив кодових точок (`malloc`), або `NULL` якщо порожньо.
+ * @param out_codes [out] Масив кодових точок (з `arena`), або `NULL` якщо порожньо.
  * @param out_count [out] Кількість елементів у `out_codes`.
  * @return 0 — успіх; -1 — помилка памʼяті/аргументів.
  */
-static int text_collect_codepoints (const char *text, uint32_t **out_codes, size_t *out_count) {
+static int text_collect_codepoints (
+    jobarena_t *arena, const char *text, uint32_t **out_codes, size_t *out_count) {
     if (!out_codes || !out_count)
         return -1;
     *out_codes = NULL;
@@ -74,34 +70,77 @@ static int text_collect_codepoints (const char *text, uint32_t **out_codes, size
     if (!text || !*text)
         return 0;
 
-    uint32_t *codes = NULL;
-    size_t count = 0;
-    size_t cap = 0;
-    const char *cursor = text;
-    while (*cursor) {
-        uint32_t cp = 0;
-        size_t consumed = 0;
-        if (str_utf8_decode (cursor, &cp, &consumed) != 0 || consumed == 0) {
-            ++cursor;
-            continue;
-        }
-        if (text_ensure_codepoints_capacity (&codes, &cap, count + 1) != 0) {
-            free (codes);
-            return -1;
+    uint64_t *bmp = (uint64_t *)jobarena_calloc (arena, 0x10000 / 64, sizeof (*bmp));
+    if (!bmp)
+        return -1;
+    uint32_t *astral = NULL;
+    size_t astral_len = 0, astral_cap = 0;
+    uint32_t cps[TEXT_DECODE_CHUNK];
+    size_t len = strlen (text);
+    size_t pos = 0;
+    while (pos < len) {
+        size_t end = (len - pos > TEXT_DECODE_CHUNK) ? pos + TEXT_DECODE_CHUNK : len;
+        /* Межа шматка не розрізає послідовність: відступаємо з байтів продовження. */
+        for (int back = 0; back < 3 && end < len && ((unsigned char)text[end] & 0xC0) == 0x80;
+             ++back)
+            --end;
+        size_t n = str_utf8_decode_span (text + pos, end - pos, cps, TEXT_CP_INVALID);
+        pos = end;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t cp = cps[i];
+            /* Керівні символи (перенос рядка, табуляція) не малюються й не впливають
+             * на покриття. */
+            if (cp < 0x20u || cp == 0x7Fu || cp == TEXT_CP_INVALID)
+                continue;
+            if (cp < 0x10000u) {
+                bmp[cp >> 6] |= 1ULL << (cp & 63u);
+                continue;
+            }
+            if (astral_len == astral_cap) {
+                size_t nc = astral_cap ? astral_cap * 2 : 16;
+                uint32_t *grown = jobarena_realloc (
+                    arena, astral, astral_cap * sizeof (*grown), nc * sizeof (*grown));
+                if (!grown) {
+                    jobarena_release (arena, astral);
+                    jobarena_release (arena, bmp);
+                    return -1;
+                }
+                astral = grown;
+                astral_cap = nc;
+            }
+            astral[astral_len++] = cp;
         }
-        codes[count++] = cp;
-        cursor += consumed;
     }
 
+    size_t unique = 0;
+    if (astral_len > 0) {
+        qsort (astral, astral_len, sizeof (*astral), fontreg_cmp_uint32);
+        for (size_t i = 0; i < astral_len; ++i)
+            if (i == 0 || astral[i] != astral[i - 1])
+                astral[unique++] = astral[i];
+    }
+    size_t count = unique;
+    for (size_t w = 0; w < 0x10000 / 64; ++w)
+        count += (size_t)__builtin_popcountll (bmp[w]);
+
+    uint32_t *codes = NULL;
     if (count > 0) {
-        qsort (codes, count, sizeof (*codes), fontreg_cmp_uint32);
-        size_t unique = 0;
-        for (size_t i = 0; i < count; ++i) {
-            if (i == 0 || codes[i] != codes[i - 1])
-                codes[unique++] = codes[i];
+        codes = (uint32_t *)jobarena_alloc (arena, count * sizeof (*codes));
+        if (!codes) {
+            jobarena_release (arena, astral);
+            jobarena_release (arena, bmp);
+            return -1;
+        }
+        size_t k = 0;
+        for (size_t w = 0; w < 0x10000 / 64; ++w) {
+            for (uint64_t bits = bmp[w]; bits; bits &= bits - 1)
+                codes[k++] = (uint32_t)(w * 64 + (size_t)__builtin_ctzll (bits));
         }
-        count = unique;
+        if (unique > 0)
+            memcpy (codes + k, astral, unique * sizeof (*codes));
     }
+    jobarena_release (arena, astral);
+    jobarena_release (arena, bmp);
 
     *out_codes = codes;
     *out_count = count;
@@ -188,11 +227,23 @@ static size_t text_font_usage_stats_total (const font_usage_stats_t *stats) {
     return total;
 }
 
-/** \brief Внутрішній рядок верстки. */
+/**
+ * \brief Фрагмент рядка: діапазон байтів вхідного тексту без копіювання.
+ * @details Пробіл перед фрагментом і дефіс переносу після нього не зберігаються у
+ *          вводі, тож позначаються прапорцями.
+ */
+typedef struct {
+    const char *ptr;   /**< Початок фрагмента у вхідному тексті. */
+    size_t len;        /**< Довжина, байт. */
+    bool space_before; /**< Перед фрагментом — пробіл. */
+    bool hyphen_after; /**< Після фрагмента — дефіс переносу. */
+} line_piece_t;
+
+/** \brief Внутрішній рядок верстки: діапазон фрагментів у спільному масиві. */
 typedef struct {
-    char *text;
-    size_t len;
-    size_t cap;
+    size_t first_piece; /**< Перший фрагмент. */
+    size_t piece_count; /**< Кількість фрагментів. */
+    size_t len;         /**< Довжина тексту рядка, байт (разом із пробілами й дефісом). */
     double width_units;
     bool hyphenated;
     size_t start_index;
@@ -222,23 +273,34 @@ typedef struct {
     const char *ptr;
     size_t len;
 
-    glyph_segment_t *segs;
+    glyph_segment_t *segs; /**< Сегменти слова у спільному буфері `text_shape_measure_words`. */
     size_t seg_count;
+    double *prefix_units; /**< Префіксні ширини сегментів: [0] = 0, [seg_count] = width_units. */
+    size_t ascii_from;    /**< Сегмент, з якого хвіст слова суто ASCII (для переносу). */
     double width_units;
     bool ascii_only;
 } text_token_t;
 
-/** \brief Звільняє масив токенів разом із сегментами гліфів. */
-static void text_tokens_dispose (text_token_t *toks, size_t count) {
+/**
+ * \brief Звільняє масив токенів разом із сегментами гліфів.
+ * @details Сегменти й префіксні ширини всіх слів — одне виділення, що починається
+ *          із сегментів першого слова.
+ */
+static void text_tokens_dispose (jobarena_t *arena, text_token_t *toks, size_t count) {
     if (!toks)
         return;
-    for (size_t i = 0; i < count; ++i)
-        free (toks[i].segs);
-    free (toks);
+    for (size_t i = 0; i < count; ++i) {
+        if (toks[i].type == TK_WORD) {
+            jobarena_release (arena, toks[i].segs);
+            break;
+        }
+    }
+    jobarena_release (arena, toks);
 }
 
 /** \brief Токенізує вхідний текст на слова/пропуски/переноси. */
-static int text_tokenize_text (const char *input, text_token_t **out, size_t *out_count) {
+static int
+text_tokenize_text (jobarena_t *arena, const char *input, text_token_t **out, size_t *out_count) {
     if (!out || !out_count)
         return -1;
     *out = NULL;
@@ -261,9 +323,10 @@ static int text_tokenize_text (const char *input, text_token_t **out, size_t *ou
                 have_space_run = false;
             if (count == cap) {
                 size_t nc = cap ? cap * 2 : 16;
-                text_token_t *nt = realloc (toks, nc * sizeof *nt);
+                text_token_t *nt
+                    = jobarena_realloc (arena, toks, cap * sizeof *nt, nc * sizeof *nt);
                 if (!nt) {
-                    free (toks);
+                    jobarena_release (arena, toks);
                     return -1;
                 }
                 toks = nt;
@@ -282,9 +345,10 @@ static int text_tokenize_text (const char *input, text_token_t **out, size_t *ou
         if (have_space_run) {
             if (count == cap) {
                 size_t nc = cap ? cap * 2 : 16;
-                text_token_t *nt = realloc (toks, nc * sizeof *nt);
+                text_token_t *nt
+                    = jobarena_realloc (arena, toks, cap * sizeof *nt, nc * sizeof *nt);
                 if (!nt) {
-                    free (toks);
+                    jobarena_release (arena, toks);
                     return -1;
                 }
                 toks = nt;
@@ -308,9 +372,9 @@ static int text_tokenize_text (const char *input, text_token_t **out, size_t *ou
         }
         if (count == cap) {
             size_t nc = cap ? cap * 2 : 16;
-            text_token_t *nt = realloc (toks, nc * sizeof *nt);
+            text_token_t *nt = jobarena_realloc (arena, toks, cap * sizeof *nt, nc * sizeof *nt);
             if (!nt) {
-                free (toks);
+                jobarena_release (arena, toks);
                 return -1;
             }
             toks = nt;
@@ -329,131 +393,149 @@ static int text_build_word_segments (
     const font_render_context_t *ctx,
     const char *word,
     size_t word_len,
-    glyph_segment_t **segments_out,
+    glyph_segment_t *segments,
     size_t *count_out,
     double *width_units_out,
     size_t *missing_out,
     bool *ascii_only_out);
 
-static int
-text_shape_measure_words (const font_render_context_t *ctx, text_token_t *toks, size_t count) {
+/**
+ * \brief Вимірює слова один раз: сегменти гліфів, префіксні суми ширин і межу ASCII-хвоста.
+ * @details Сегментів у слові не більше, ніж байтів, тож сегменти й префіксні ширини всіх
+ *          слів розміщуються в одному виділенні на виклик (звільняє `text_tokens_dispose`).
+ */
+static int text_shape_measure_words (
+    jobarena_t *arena, const font_render_context_t *ctx, text_token_t *toks, size_t count) {
     if (!ctx || !toks)
         return -1;
+    size_t total_bytes = 0, words = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (toks[i].type != TK_WORD)
+            continue;
+        total_bytes += toks[i].len;
+        ++words;
+    }
+    if (words == 0)
+        return 0;
+    glyph_segment_t *seg_arena = jobarena_alloc (
+        arena,
+        total_bytes * sizeof (*seg_arena) + (total_bytes + words) * sizeof (double));
+    if (!seg_arena)
+        return -1;
+    double *prefix_arena = (double *)(seg_arena + total_bytes);
+
     for (size_t i = 0; i < count; ++i) {
         if (toks[i].type != TK_WORD)
             continue;
         double width = 0.0;
         bool ascii_only = true;
-        glyph_segment_t *segs = NULL;
+        glyph_segment_t *segs = seg_arena;
         size_t seg_count = 0;
         if (text_build_word_segments (
-                ctx, toks[i].ptr, toks[i].len, &segs, &seg_count, &width, NULL, &ascii_only)
-            != 0)
+                ctx, toks[i].ptr, toks[i].len, segs, &seg_count, &width, NULL, &ascii_only)
+            != 0) {
+            /* Буфер звільняється через сегменти першого слова. */
+            toks[i].segs = segs;
             return -1;
+        }
+        seg_arena += toks[i].len;
+        double *prefix = prefix_arena;
+        prefix_arena += seg_count + 1;
+        size_t ascii_from = 0;
+        prefix[0] = 0.0;
+        for (size_t k = 0; k < seg_count; ++k) {
+            prefix[k + 1] = prefix[k] + segs[k].advance_units * ctx->scale;
+            if (segs[k].codepoint >= 128)
+                ascii_from = k + 1;
+        }
         toks[i].segs = segs;
         toks[i].seg_count = seg_count;
+        toks[i].prefix_units = prefix;
+        toks[i].ascii_from = ascii_from;
         toks[i].width_units = width;
         toks[i].ascii_only = ascii_only;
     }
     return 0;
 }
 
+/** \brief Точка розриву слова: скільки сегментів лишається в поточному рядку. */
 typedef struct {
-    char *prefix;
-    size_t prefix_len;
-    double prefix_width_units;
-    char *suffix;
-    size_t suffix_len;
-    bool inserted_hyphen;
+    size_t seg_count;          /**< Сегментів у префіксі. */
+    size_t prefix_bytes;       /**< Байтів вводу в префіксі. */
+    double prefix_width_units; /**< Ширина префікса разом із доданим дефісом. */
+    bool inserted_hyphen;      /**< Після префікса додається `-`. */
+    bool hyphenated;           /**< Позначити рядок як завершений переносом. */
 } split_result_t;
 
-static int text_build_word_segments (
-    const font_render_context_t *ctx,
-    const char *word,
-    size_t word_len,
-    glyph_segment_t **segments_out,
-    size_t *count_out,
-    double *width_units_out,
-    size_t *missing_out,
-    bool *ascii_only_out);
 static int text_split_segments (
-    const glyph_segment_t *segments,
-    size_t seg_count,
+    const text_token_t *tk,
+    size_t first,
     double available_units,
     const font_render_context_t *ctx,
-    bool ascii_only,
     bool allow_hyphenation,
     split_result_t *out);
 static int text_force_split_segments (
-    const glyph_segment_t *segments,
-    size_t seg_count,
+    const text_token_t *tk,
+    size_t first,
     double available_units,
     const font_render_context_t *ctx,
     split_result_t *out);
 
-static void text_free_lines (layout_line_t *lines, size_t count) {
-    if (!lines)
-        return;
-    for (size_t i = 0; i < count; ++i)
-        free (lines[i].text);
-    free (lines);
-}
-
-static int text_line_reserve (layout_line_t *line, size_t needed) {
-    if (!line)
-        return -1;
-    if (line->cap >= needed)
-        return 0;
-    size_t new_cap = line->cap ? line->cap : 32;
-    while (new_cap < needed)
-        new_cap *= 2;
-    char *grown = realloc (line->text, new_cap);
-    if (!grown)
-        return -1;
-    line->text = grown;
-    line->cap = new_cap;
-    return 0;
-}
-
-static int text_line_append_char (layout_line_t *line, char c) {
-    if (!line)
-        return -1;
-    if (text_line_reserve (line, line->len + 2) != 0)
-        return -1;
-    line->text[line->len++] = c;
-    line->text[line->len] = '\0';
-    return 0;
+static void text_free_lines (jobarena_t *arena, layout_line_t *lines, line_piece_t *pieces) {
+    jobarena_release (arena, lines);
+    jobarena_release (arena, pieces);
 }
 
-static int text_line_append_bytes (layout_line_t *line, const char *data, size_t len) {
-    if (!line)
-        return -1;
-    if (len == 0)
-        return 0;
-    if (text_line_reserve (line, line->len + len + 1) != 0)
-        return -1;
-    memcpy (line->text + line->len, data, len);
-    line->len += len;
-    line->text[line->len] = '\0';
-    return 0;
+/**
+ * \brief Збирає текст рядка у буфер, що повторно використовується між рядками.
+ * @param pieces Фрагменти рядка.
+ * @param count Кількість фрагментів.
+ * @param buf [in,out] Буфер (mallocʼиться/росте всередині).
+ * @param cap [in,out] Ємність буфера.
+ * @return Текст рядка із завершальним `\0` або NULL при браку памʼяті.
+ */
+static const char *
+text_line_join (const line_piece_t *pieces, size_t count, char **buf, size_t *cap) {
+    size_t need = 1;
+    for (size_t i = 0; i < count; ++i)
+        need += pieces[i].len + (pieces[i].space_before ? 1 : 0) + (pieces[i].hyphen_after ? 1 : 0);
+    if (need > *cap) {
+        char *grown = realloc (*buf, need);
+        if (!grown)
+            return NULL;
+        *buf = grown;
+        *cap = need;
+    }
+    char *w = *buf;
+    for (size_t i = 0; i < count; ++i) {
+        if (pieces[i].space_before)
+            *w++ = ' ';
+        memcpy (w, pieces[i].ptr, pieces[i].len);
+        w += pieces[i].len;
+        if (pieces[i].hyphen_after)
+            *w++ = '-';
+    }
+    *w = '\0';
+    return *buf;
 }
 
-static layout_line_t *
-text_add_new_line (layout_line_t **lines, size_t *count, size_t *cap, size_t start_index) {
+static layout_line_t *text_add_new_line (
+    jobarena_t *arena, layout_line_t **lines, size_t *count, size_t *cap, size_t start_index) {
     if (!lines || !count || !cap)
         return NULL;
     if (*cap <= *count) {
         size_t new_cap = (*cap == 0) ? 8 : (*cap * 2);
-        layout_line_t *grown = realloc (*lines, new_cap * sizeof (*grown));
+        layout_line_t *grown
+            = jobarena_realloc (arena, *lines, *cap * sizeof (*grown), new_cap * sizeof (*grown));
         if (!grown)
             return NULL;
         *lines = grown;
         *cap = new_cap;
     }
     layout_line_t *line = &(*lines)[(*count)++];
-    line->text = NULL;
+    line->first_piece = 0;
+    line->piece_count = 0;
     line->len = 0;
-    line->cap = 0;
     line->width_units = 0.0;
     line->hyphenated = false;
     line->offset_units = 0.0;
@@ -462,14 +544,6 @@ text_add_new_line (layout_line_t **lines, size_t *count, size_t *cap, size_t sta
     return line;
 }
 
-static void text_split_result_dispose (split_result_t *res) {
-    if (!res)
-        return;
-    free (res->prefix);
-    free (res->suffix);
-    memset (res, 0, sizeof (*res));
-}
-
 static void text_assign_layout_positions (
     const text_layout_opts_t *opts,
     const font_render_context_t *ctx,
@@ -494,348 +568,313 @@ static void text_assign_layout_positions (
     }
 }
 
-static int text_break_tokens_into_lines (
-    const text_layout_opts_t *opts,
-    const font_render_context_t *ctx,
-    const text_token_t *toks,
-    size_t tok_count,
-    layout_line_t **lines_out,
-    size_t *line_count_out) {
-    if (!opts || !ctx || !lines_out || !line_count_out)
-        return -1;
+/** \brief Стан розбиття токенів на рядки. */
+typedef struct {
+    const text_layout_opts_t *opts;
+    const font_render_context_t *ctx;
+    double space_units;       /**< Ширина пробілу у вихідних одиницях. */
+    layout_line_t *lines;     /**< Рядки. */
+    size_t count;             /**< Кількість рядків. */
+    size_t cap;               /**< Ємність масиву рядків. */
+    line_piece_t *pieces;     /**< Фрагменти всіх рядків поспіль. */
+    size_t piece_count;       /**< Кількість фрагментів. */
+    size_t piece_cap;         /**< Ємність масиву фрагментів. */
+    layout_line_t *current;   /**< Поточний рядок (останній у масиві). */
+    size_t consumed;          /**< Символи вводу до початку поточного рядка. */
+    size_t assigned;          /**< Символи вводу, віднесені до поточного рядка. */
+    bool pending_space;       /**< Перед наступним словом був пропуск. */
+    bool last_break_explicit; /**< Останній рядок почато явним переносом. */
+} text_breaker_t;
+
+/** \brief Ширина сегментів `[first, first + n)` слова за префіксними сумами. */
+static double text_token_span_units (const text_token_t *tk, size_t first, size_t n) {
+    return tk->prefix_units[first + n] - tk->prefix_units[first];
+}
 
-    layout_line_t *lines = NULL;
-    size_t line_count = 0, line_cap = 0;
-    size_t consumed_input_total = 0;
-    size_t assigned_input_current = 0;
-    layout_line_t *current
-        = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-    if (!current)
-        return -1;
+/** \brief Найбільша кількість сегментів від `first`, сумарна ширина яких не перевищує `limit`. */
+static size_t text_token_fit_count (const text_token_t *tk, size_t first, double limit) {
+    size_t lo = 0, hi = tk->seg_count - first;
+    if (!(limit >= 0.0))
+        return 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo + 1) / 2;
+        if (text_token_span_units (tk, first, mid) <= limit)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
 
-    const double space_width_units = ctx->space_advance_units * ctx->scale;
-    bool pending_space = false;
-    bool last_break_explicit = false;
+/** \brief Завершує поточний рядок (`consumed_delta` символів вводу) і починає новий. */
+static int text_breaker_next_line (text_breaker_t *b, size_t consumed_delta) {
+    b->consumed += consumed_delta;
+    b->assigned = 0;
+    b->current = text_add_new_line (b->opts->arena, &b->lines, &b->count, &b->cap, b->consumed);
+    b->pending_space = false;
+    b->last_break_explicit = false;
+    return b->current ? 0 : -1;
+}
 
-    for (size_t i = 0; i < tok_count; ++i) {
-        const text_token_t *tk = &toks[i];
-        if (tk->type == TK_NEWLINE) {
-            consumed_input_total += assigned_input_current + 1;
-            assigned_input_current = 0;
-            current = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-            if (!current) {
-                text_free_lines (lines, line_count);
+/** \brief Дописує до поточного рядка фрагмент слова (за потреби з пробілом і дефісом). */
+static int text_breaker_append (
+    text_breaker_t *b,
+    bool insert_space,
+    const char *ptr,
+    size_t len,
+    bool hyphen,
+    double width_units) {
+    if (b->piece_count == b->piece_cap) {
+        size_t nc = b->piece_cap ? b->piece_cap * 2 : 64;
+        line_piece_t *grown = jobarena_realloc (
+            b->opts->arena, b->pieces, b->piece_cap * sizeof (*grown), nc * sizeof (*grown));
+        if (!grown)
+            return -1;
+        b->pieces = grown;
+        b->piece_cap = nc;
+    }
+    layout_line_t *line = b->current;
+    if (line->piece_count == 0)
+        line->first_piece = b->piece_count;
+    b->pieces[b->piece_count++] = (line_piece_t){
+        .ptr = ptr,
+        .len = len,
+        .space_before = insert_space,
+        .hyphen_after = hyphen,
+    };
+    line->piece_count++;
+    if (insert_space) {
+        line->len += 1;
+        line->width_units += b->space_units;
+        b->assigned += 1;
+    }
+    line->len += len + (hyphen ? 1 : 0);
+    line->width_units += width_units;
+    b->assigned += len;
+    return 0;
+}
+
+/** \brief Жадібно розміщує слово, за потреби розриваючи його по дефісу, переносом чи примусово. */
+static int text_breaker_place_word (text_breaker_t *b, const text_token_t *tk) {
+    const text_layout_opts_t *opts = b->opts;
+    const char *word_end = tk->ptr + tk->len;
+    size_t first = 0;
+    while (first < tk->seg_count) {
+        const char *ptr = tk->segs[first].ptr;
+        size_t len = (size_t)(word_end - ptr);
+        double width = text_token_span_units (tk, first, tk->seg_count - first);
+        double available_units = opts->frame_width - b->current->width_units;
+        bool insert_space = b->pending_space && b->current->len > 0;
+        if (insert_space)
+            available_units -= b->space_units;
+
+        if (available_units < 0.0 && b->current->len > 0) {
+            if (text_breaker_next_line (b, b->assigned) != 0)
                 return -1;
-            }
-            pending_space = false;
-            last_break_explicit = true;
             continue;
         }
-        if (tk->type == TK_SPACE) {
-            pending_space = current->len > 0 || pending_space;
+
+        if (width <= available_units || b->current->len == 0)
+            return text_breaker_append (b, insert_space, ptr, len, false, width);
+
+        split_result_t split;
+        if (text_split_segments (tk, first, available_units, b->ctx, opts->hyphenate, &split)
+            || (opts->break_long_words
+                && text_force_split_segments (tk, first, available_units, b->ctx, &split))) {
+            if (text_breaker_append (
+                    b, insert_space, ptr, split.prefix_bytes, split.inserted_hyphen,
+                    split.prefix_width_units)
+                != 0)
+                return -1;
+            b->current->hyphenated = split.hyphenated;
+            if (text_breaker_next_line (b, b->assigned) != 0)
+                return -1;
+            first += split.seg_count;
             continue;
         }
 
-        const char *pending_word_ptr = tk->ptr;
-        size_t pending_word_len = tk->len;
-        glyph_segment_t *pending_segments = tk->segs;
-        size_t pending_seg_count = tk->seg_count;
-        double pending_word_width = tk->width_units;
-        bool pending_ascii_only = tk->ascii_only;
-        char *owned_ptr = NULL;
-        int segments_owned = 0;
-
-        while (pending_seg_count > 0) {
-            double available_units = opts->frame_width - current->width_units;
-            bool insert_space = pending_space && current->len > 0;
-            if (insert_space)
-                available_units -= space_width_units;
-
-            if (available_units < 0.0 && current->len > 0) {
-                consumed_input_total += assigned_input_current;
-                assigned_input_current = 0;
-                current = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-                if (!current) {
-                    if (segments_owned)
-                        free (pending_segments);
-                    free (owned_ptr);
-                    text_free_lines (lines, line_count);
-                    return -1;
-                }
-                pending_space = false;
-                last_break_explicit = false;
-                continue;
-            }
+        if (text_breaker_next_line (b, b->assigned) != 0)
+            return -1;
+    }
+    return 0;
+}
 
-            if (pending_word_width <= available_units || current->len == 0) {
-                if (insert_space) {
-                    if (text_line_append_char (current, ' ') != 0) {
-                        if (segments_owned)
-                            free (pending_segments);
-                        free (owned_ptr);
-                        text_free_lines (lines, line_count);
-                        return -1;
-                    }
-                    current->width_units += space_width_units;
-                    assigned_input_current += 1;
-                }
-                if (text_line_append_bytes (current, pending_word_ptr, pending_word_len) != 0) {
-                    if (segments_owned)
-                        free (pending_segments);
-                    free (owned_ptr);
-                    text_free_lines (lines, line_count);
-                    return -1;
-                }
-                current->width_units += pending_word_width;
-                assigned_input_current += pending_word_len;
-                if (segments_owned) {
-                    free (pending_segments);
-                    segments_owned = 0;
-                }
-                free (owned_ptr);
-                owned_ptr = NULL;
-                pending_seg_count = 0;
-                last_break_explicit = false;
+/**
+ * \brief Оптимальний перенос абзацу `[begin, end)` (Кнут–Пласс без розривів слів).
+ * @details Мінімізує суму квадратів незаповненого місця в усіх рядках, крім останнього.
+ *          Ширини слів беруться з кешу токенів, тож пошук — лише арифметика:
+ *          O(слів × слів у рядку).
+ * @return 0 — розміщено; 1 — абзац не підходить (слово ширше рамки); -1 — помилка памʼяті.
+ */
+static int
+text_breaker_place_optimal (text_breaker_t *b, const text_token_t *toks, size_t begin, size_t end) {
+    double frame = b->opts->frame_width;
+    size_t m = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (toks[i].type != TK_WORD || toks[i].seg_count == 0)
+            continue;
+        if (toks[i].width_units > frame)
+            return 1;
+        ++m;
+    }
+    if (m < 2)
+        return 1;
+
+    jobarena_t *arena = b->opts->arena;
+    const text_token_t **words = jobarena_alloc (arena, m * sizeof (*words));
+    double *cost = jobarena_alloc (arena, (m + 1) * sizeof (*cost));
+    size_t *prev = jobarena_alloc (arena, (m + 1) * sizeof (*prev));
+    size_t *starts = jobarena_alloc (arena, m * sizeof (*starts));
+    if (!words || !cost || !prev || !starts) {
+        jobarena_release (arena, words);
+        jobarena_release (arena, cost);
+        jobarena_release (arena, prev);
+        jobarena_release (arena, starts);
+        return -1;
+    }
+    for (size_t i = begin, k = 0; i < end; ++i)
+        if (toks[i].type == TK_WORD && toks[i].seg_count > 0)
+            words[k++] = &toks[i];
+
+    cost[0] = 0.0;
+    prev[0] = 0;
+    for (size_t j = 1; j <= m; ++j) {
+        cost[j] = HUGE_VAL;
+        prev[j] = j - 1;
+        double line_units = 0.0;
+        for (size_t s = j; s-- > 0;) {
+            line_units += words[s]->width_units + (s + 1 < j ? b->space_units : 0.0);
+            if (line_units > frame && s + 1 < j)
                 break;
+            double slack = frame - line_units;
+            double c = cost[s] + ((j == m) ? 0.0 : slack * slack);
+            if (c < cost[j]) {
+                cost[j] = c;
+                prev[j] = s;
             }
+        }
+    }
 
-            split_result_t split;
-            if (text_split_segments (
-                    pending_segments, pending_seg_count, available_units, ctx, pending_ascii_only,
-                    opts->hyphenate, &split)) {
-                if (insert_space) {
-                    if (text_line_append_char (current, ' ') != 0) {
-                        text_split_result_dispose (&split);
-                        if (segments_owned)
-                            free (pending_segments);
-                        free (owned_ptr);
-                        text_free_lines (lines, line_count);
-                        return -1;
-                    }
-                    current->width_units += space_width_units;
-                    assigned_input_current += 1;
-                }
-                if (text_line_append_bytes (current, split.prefix, split.prefix_len) != 0) {
-                    text_split_result_dispose (&split);
-                    if (segments_owned)
-                        free (pending_segments);
-                    free (owned_ptr);
-                    text_free_lines (lines, line_count);
-                    return -1;
-                }
-                current->width_units += split.prefix_width_units;
-                assigned_input_current += split.prefix_len;
-                current->hyphenated = true;
-
-                if (split.inserted_hyphen && assigned_input_current > 0)
-                    consumed_input_total += assigned_input_current - 1;
-                else
-                    consumed_input_total += assigned_input_current;
-                assigned_input_current = 0;
-                current = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-                if (!current) {
-                    text_split_result_dispose (&split);
-                    if (segments_owned)
-                        free (pending_segments);
-                    free (owned_ptr);
-                    text_free_lines (lines, line_count);
-                    return -1;
-                }
-                pending_space = false;
-                last_break_explicit = false;
+    /* prev[j] — перше слово рядка, що закінчується перед словом j; ланцюжок іде з кінця. */
+    size_t lines = 0;
+    for (size_t j = m; j > 0; j = prev[j])
+        starts[lines++] = prev[j];
+
+    int rc = 0;
+    for (size_t l = lines; l-- > 0 && rc == 0;) {
+        size_t s = starts[l];
+        size_t e = (l > 0) ? starts[l - 1] : m;
+        for (size_t k = s; k < e && rc == 0; ++k)
+            rc = text_breaker_append (
+                b, k > s, words[k]->ptr, words[k]->len, false, words[k]->width_units);
+        if (rc == 0 && l > 0)
+            rc = text_breaker_next_line (b, b->assigned);
+    }
+    jobarena_release (arena, words);
+    jobarena_release (arena, cost);
+    jobarena_release (arena, prev);
+    jobarena_release (arena, starts);
+    return rc;
+}
 
-                if (segments_owned) {
-                    free (pending_segments);
-                    segments_owned = 0;
-                }
-                free (owned_ptr);
-                owned_ptr = NULL;
-
-                char *next_owned = split.suffix;
-                size_t next_len = split.suffix_len;
-                split.suffix = NULL;
-                free (split.prefix);
-                split.prefix = NULL;
-                text_split_result_dispose (&split);
-                owned_ptr = next_owned;
-                pending_word_ptr = owned_ptr ? owned_ptr : "";
-                pending_word_len = next_len;
-                if (pending_word_len == 0) {
-                    pending_seg_count = 0;
-                    pending_word_width = 0.0;
-                    break;
-                }
-                if (text_build_word_segments (
-                        ctx, pending_word_ptr, pending_word_len, &pending_segments,
-                        &pending_seg_count, &pending_word_width, NULL, &pending_ascii_only)
-                    != 0) {
-                    free (owned_ptr);
-                    text_free_lines (lines, line_count);
-                    return -1;
-                }
-                segments_owned = 1;
-                continue;
-            }
+/**
+ * \brief Розбиває токени на рядки за ширинами з кешу токенів.
+ * @details Явні переноси завжди починають новий рядок. У режимі `TEXT_BREAK_OPTIMAL`
+ *          абзаци, де кожне слово вміщується в рамку, розбиваються оптимально; решта —
+ *          жадібно з розривом слів. Рядки не копіюють текст: це діапазони фрагментів
+ *          вхідного буфера, тож памʼять — два масиви на виклик незалежно від обсягу.
+ * @param pieces_out [out] Фрагменти рядків (NULL — лише рядки без тексту).
+ */
+static int text_break_tokens_into_lines (
+    const text_layout_opts_t *opts,
+    const font_render_context_t *ctx,
+    const text_token_t *toks,
+    size_t tok_count,
+    layout_line_t **lines_out,
+    size_t *line_count_out,
+    line_piece_t **pieces_out) {
+    if (!opts || !ctx || !lines_out || !line_count_out)
+        return -1;
 
-            if (opts->break_long_words) {
-                split_result_t fsplit;
-                if (text_force_split_segments (
-                        pending_segments, pending_seg_count, available_units, ctx, &fsplit)) {
-                    if (insert_space) {
-                        if (text_line_append_char (current, ' ') != 0) {
-                            text_split_result_dispose (&fsplit);
-                            if (segments_owned)
-                                free (pending_segments);
-                            free (owned_ptr);
-                            text_free_lines (lines, line_count);
-                            return -1;
-                        }
-                        current->width_units += space_width_units;
-                        assigned_input_current += 1;
-                    }
-                    if (text_line_append_bytes (current, fsplit.prefix, fsplit.prefix_len) != 0) {
-                        text_split_result_dispose (&fsplit);
-                        if (segments_owned)
-                            free (pending_segments);
-                        free (owned_ptr);
-                        text_free_lines (lines, line_count);
-                        return -1;
-                    }
-                    current->width_units += fsplit.prefix_width_units;
-                    assigned_input_current += fsplit.prefix_len - (fsplit.inserted_hyphen ? 1 : 0);
-                    current->hyphenated = fsplit.inserted_hyphen;
-
-                    consumed_input_total += assigned_input_current;
-                    assigned_input_current = 0;
-                    current
-                        = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-                    if (!current) {
-                        text_split_result_dispose (&fsplit);
-                        if (segments_owned)
-                            free (pending_segments);
-                        free (owned_ptr);
-                        text_free_lines (lines, line_count);
-                        return -1;
-                    }
-                    pending_space = false;
-                    last_break_explicit = false;
-
-                    if (segments_owned) {
-                        free (pending_segments);
-                        segments_owned = 0;
-                    }
-                    free (owned_ptr);
-                    owned_ptr = NULL;
-
-                    char *next_owned = fsplit.suffix;
-                    size_t next_len = fsplit.suffix_len;
-                    fsplit.suffix = NULL;
-                    free (fsplit.prefix);
-                    fsplit.prefix = NULL;
-                    text_split_result_dispose (&fsplit);
-                    owned_ptr = next_owned;
-                    pending_word_ptr = owned_ptr ? owned_ptr : "";
-                    pending_word_len = next_len;
-                    if (pending_word_len == 0) {
-                        pending_seg_count = 0;
-                        pending_word_width = 0.0;
-                        break;
-                    }
-                    if (text_build_word_segments (
-                            ctx, pending_word_ptr, pending_word_len, &pending_segments,
-                            &pending_seg_count, &pending_word_width, NULL, &pending_ascii_only)
-                        != 0) {
-                        free (owned_ptr);
-                        text_free_lines (lines, line_count);
-                        return -1;
-                    }
-                    segments_owned = 1;
-                    continue;
-                }
-            }
+    text_breaker_t b = {
+        .opts = opts,
+        .ctx = ctx,
+        .space_units = ctx->space_advance_units * ctx->scale,
+    };
+    b.current = text_add_new_line (opts->arena, &b.lines, &b.count, &b.cap, 0);
+    if (!b.current)
+        return -1;
 
-            if (current->len > 0) {
-                consumed_input_total += assigned_input_current;
-                assigned_input_current = 0;
-                current = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-                if (!current) {
-                    if (segments_owned)
-                        free (pending_segments);
-                    free (owned_ptr);
-                    text_free_lines (lines, line_count);
-                    return -1;
-                }
-                pending_space = false;
-                last_break_explicit = false;
+    bool paragraph_start = true;
+    for (size_t i = 0; i < tok_count; ++i) {
+        const text_token_t *tk = &toks[i];
+        if (tk->type == TK_NEWLINE) {
+            if (text_breaker_next_line (&b, b.assigned + 1) != 0)
+                goto fail;
+            b.last_break_explicit = true;
+            paragraph_start = true;
+            continue;
+        }
+        if (paragraph_start && opts->break_mode == TEXT_BREAK_OPTIMAL) {
+            paragraph_start = false;
+            size_t end = i;
+            while (end < tok_count && toks[end].type != TK_NEWLINE)
+                ++end;
+            int rc = text_breaker_place_optimal (&b, toks, i, end);
+            if (rc < 0)
+                goto fail;
+            if (rc == 0) {
+                b.pending_space = false;
+                b.last_break_explicit = false;
+                i = end - 1;
                 continue;
             }
-
-            if (text_line_append_bytes (current, pending_word_ptr, pending_word_len) != 0) {
-                if (segments_owned)
-                    free (pending_segments);
-                free (owned_ptr);
-                text_free_lines (lines, line_count);
-                return -1;
-            }
-            current->width_units += pending_word_width;
-            consumed_input_total += assigned_input_current + pending_word_len;
-            assigned_input_current = 0;
-            current = text_add_new_line (&lines, &line_count, &line_cap, consumed_input_total);
-            if (!current) {
-                if (segments_owned)
-                    free (pending_segments);
-                free (owned_ptr);
-                text_free_lines (lines, line_count);
-                return -1;
-            }
-            pending_space = false;
-            last_break_explicit = false;
-            if (segments_owned) {
-                free (pending_segments);
-                segments_owned = 0;
-            }
-            free (owned_ptr);
-            owned_ptr = NULL;
-            break;
         }
-
-        pending_space = false;
-        if (segments_owned) {
-            free (pending_segments);
-            segments_owned = 0;
+        paragraph_start = false;
+        if (tk->type == TK_SPACE) {
+            b.pending_space = b.current->len > 0 || b.pending_space;
+            continue;
         }
-        free (owned_ptr);
-        owned_ptr = NULL;
-        last_break_explicit = false;
+        if (text_breaker_place_word (&b, tk) != 0)
+            goto fail;
+        b.pending_space = false;
+        b.last_break_explicit = false;
     }
 
-    consumed_input_total += assigned_input_current;
-
-    if (line_count > 1) {
-        layout_line_t *last = &lines[line_count - 1];
-        if ((!last->text || last->len == 0) && !last_break_explicit) {
-            free (last->text);
-            line_count--;
-        }
+    if (b.count > 1) {
+        layout_line_t *last = &b.lines[b.count - 1];
+        if (last->len == 0 && !b.last_break_explicit)
+            b.count--;
     }
 
-    *lines_out = lines;
-    *line_count_out = line_count;
+    *lines_out = b.lines;
+    *line_count_out = b.count;
+    if (pieces_out)
+        *pieces_out = b.pieces;
+    else
+        jobarena_release (opts->arena, b.pieces);
     return 0;
+
+fail:
+    text_free_lines (opts->arena, b.lines, b.pieces);
+    return -1;
 }
 
+/**
+ * \brief Розбиває слово на сегменти гліфів.
+ * @param segments [out] Буфер щонайменше на `word_len` сегментів.
+ */
 static int text_build_word_segments (
     const font_render_context_t *ctx,
     const char *word,
     size_t word_len,
-    glyph_segment_t **segments_out,
+    glyph_segment_t *segments,
     size_t *count_out,
     double *width_units_out,
     size_t *missing_out,
     bool *ascii_only_out) {
-    if (!ctx || !word || !segments_out || !count_out || !width_units_out)
+    if (!ctx || !word || !segments || !count_out || !width_units_out)
         return -1;
-    *segments_out = NULL;
     *count_out = 0;
     *width_units_out = 0.0;
     if (missing_out)
@@ -846,16 +885,14 @@ static int text_build_word_segments (
     if (word_len == 0)
         return 0;
 
-    glyph_segment_t *segments = calloc (word_len, sizeof (*segments));
-    if (!segments)
-        return -1;
-
     size_t seg_count = 0;
     size_t offset = 0;
     while (offset < word_len) {
-        uint32_t cp = 0;
-        size_t consumed = 0;
-        if (str_utf8_decode (word + offset, &cp, &consumed) != 0 || consumed == 0) {
+        uint32_t cp = (unsigned char)word[offset];
+        size_t consumed = 1;
+        if (cp >= 0x80
+            && (str_utf8_decode (word + offset, &cp, &consumed) != 0 || consumed == 0
+                || consumed > word_len - offset)) {
             if (missing_out)
                 (*missing_out)++;
             cp = ' ';
@@ -891,223 +928,205 @@ static int text_build_word_segments (
         offset += consumed;
     }
 
-    *segments_out = segments;
     *count_out = seg_count;
     return 0;
 }
 
+/** \brief Заповнює точку розриву: `n` сегментів від `first` плюс, за потреби, дефіс. */
+static void text_split_fill (
+    const text_token_t *tk,
+    size_t first,
+    size_t n,
+    double width_units,
+    bool inserted_hyphen,
+    bool hyphenated,
+    split_result_t *out) {
+    const char *begin = tk->segs[first].ptr;
+    const char *end = (first + n < tk->seg_count) ? tk->segs[first + n].ptr : tk->ptr + tk->len;
+    out->seg_count = n;
+    out->prefix_bytes = (size_t)(end - begin);
+    out->prefix_width_units = width_units;
+    out->inserted_hyphen = inserted_hyphen;
+    out->hyphenated = hyphenated;
+}
+
+/**
+ * \brief Шукає розрив хвоста слова `[first, …)` по наявному дефісу або переносом ASCII-слова.
+ * @return 1 — розрив знайдено; 0 — ні.
+ */
 static int text_split_segments (
-    const glyph_segment_t *segments,
-    size_t seg_count,
+    const text_token_t *tk,
+    size_t first,
     double available_units,
     const font_render_context_t *ctx,
-    bool ascii_only,
     bool allow_hyphenation,
     split_result_t *out) {
-    if (!segments || !seg_count || !ctx || !out)
+    if (!tk || first >= tk->seg_count || !ctx || !out)
         return 0;
     memset (out, 0, sizeof (*out));
 
-    double accum_units = 0.0;
-    ptrdiff_t last_hyphen_index = -1;
-    double width_at_hyphen = 0.0;
-
-    for (size_t i = 0; i < seg_count; ++i) {
-        accum_units += segments[i].advance_units * ctx->scale;
-        if (segments[i].codepoint == '-' && accum_units <= available_units) {
-            last_hyphen_index = (ptrdiff_t)i;
-            width_at_hyphen = accum_units;
+    size_t fit = text_token_fit_count (tk, first, available_units);
+    for (size_t n = fit; n > 0; --n) {
+        if (tk->segs[first + n - 1].codepoint == '-') {
+            text_split_fill (
+                tk, first, n, text_token_span_units (tk, first, n), false, true, out);
+            return 1;
         }
     }
 
-    if (last_hyphen_index >= 0) {
-        size_t prefix_bytes = 0;
-        for (size_t i = 0; i <= (size_t)last_hyphen_index; ++i)
-            prefix_bytes += segments[i].byte_len;
-        size_t suffix_bytes = 0;
-        for (size_t i = (size_t)last_hyphen_index + 1; i < seg_count; ++i)
-            suffix_bytes += segments[i].byte_len;
-
-        out->prefix = malloc (prefix_bytes + 1);
-        out->suffix = malloc (suffix_bytes + 1);
-        if (!out->prefix || !out->suffix) {
-            text_split_result_dispose (out);
-            return 0;
-        }
-        memcpy (out->prefix, segments[0].ptr, prefix_bytes);
-        out->prefix[prefix_bytes] = '\0';
-        if (suffix_bytes > 0)
-            memcpy (out->suffix, segments[last_hyphen_index + 1].ptr, suffix_bytes);
-        out->suffix[suffix_bytes] = '\0';
-        out->prefix_len = prefix_bytes;
-        out->suffix_len = suffix_bytes;
-        out->prefix_width_units = width_at_hyphen;
-        out->inserted_hyphen = false;
-        return 1;
-    }
-
-    if (!allow_hyphenation || !ascii_only)
+    if (!allow_hyphenation || first < tk->ascii_from)
         return 0;
 
     double hyphen_units = ctx->hyphen_advance_units * ctx->scale;
-    ptrdiff_t best_index = -1;
-    double width_at_index = 0.0;
-    accum_units = 0.0;
-    for (size_t i = 0; i < seg_count; ++i) {
-        accum_units += segments[i].advance_units * ctx->scale;
-        size_t remaining = seg_count - i - 1;
-        if (remaining < 3)
-            continue;
-        if (accum_units + hyphen_units <= available_units) {
-            best_index = (ptrdiff_t)i;
-            width_at_index = accum_units + hyphen_units;
-        }
-    }
-
-    if (best_index < 0)
-        return 0;
-
-    size_t prefix_bytes = 0;
-    for (size_t i = 0; i <= (size_t)best_index; ++i)
-        prefix_bytes += segments[i].byte_len;
-    size_t suffix_bytes = 0;
-    for (size_t i = (size_t)best_index + 1; i < seg_count; ++i)
-        suffix_bytes += segments[i].byte_len;
-
-    out->prefix = malloc (prefix_bytes + 2);
-    out->suffix = malloc (suffix_bytes + 1);
-    if (!out->prefix || !out->suffix) {
-        text_split_result_dispose (out);
+    size_t n = text_token_fit_count (tk, first, available_units - hyphen_units);
+    size_t remaining = tk->seg_count - first;
+    if (n + 3 > remaining)
+        n = (remaining > 3) ? remaining - 3 : 0;
+    if (n == 0)
         return 0;
-    }
-    memcpy (out->prefix, segments[0].ptr, prefix_bytes);
-    out->prefix[prefix_bytes] = '-';
-    out->prefix[prefix_bytes + 1] = '\0';
-    if (suffix_bytes > 0)
-        memcpy (out->suffix, segments[best_index + 1].ptr, suffix_bytes);
-    out->suffix[suffix_bytes] = '\0';
-    out->prefix_len = prefix_bytes + 1;
-    out->suffix_len = suffix_bytes;
-    out->prefix_width_units = width_at_index;
-    out->inserted_hyphen = true;
+    text_split_fill (
+        tk, first, n, text_token_span_units (tk, first, n) + hyphen_units, true, true, out);
     return 1;
 }
 
+/**
+ * \brief Примусово розриває хвіст слова за максимальною кількістю сегментів у доступній ширині.
+ * @return 1 — розрив знайдено; 0 — не вміщується жоден сегмент.
+ */
 static int text_force_split_segments (
-    const glyph_segment_t *segments,
-    size_t seg_count,
+    const text_token_t *tk,
+    size_t first,
     double available_units,
     const font_render_context_t *ctx,
     split_result_t *out) {
-    if (!segments || !seg_count || !ctx || !out)
+    if (!tk || first >= tk->seg_count || !ctx || !out)
         return 0;
     memset (out, 0, sizeof (*out));
 
-    double hyphen_units = ctx->hyphen_advance_units * ctx->scale;
-    double accum = 0.0;
-    ptrdiff_t idx = -1;
-    for (size_t i = 0; i < seg_count; ++i) {
-        double adv = segments[i].advance_units * ctx->scale;
-        if (accum + adv <= available_units) {
-            accum += adv;
-            idx = (ptrdiff_t)i;
-        } else {
-            break;
-        }
-    }
-    if (idx < 0)
-        return 0;
-
-    size_t prefix_bytes = 0;
-    for (size_t i = 0; i <= (size_t)idx; ++i)
-        prefix_bytes += segments[i].byte_len;
-    size_t suffix_bytes = 0;
-    for (size_t i = (size_t)idx + 1; i < seg_count; ++i)
-        suffix_bytes += segments[i].byte_len;
-
-    int insert_hyphen = (suffix_bytes > 0) && ((accum + hyphen_units) <= available_units);
-
-    out->prefix = (char *)malloc (prefix_bytes + (insert_hyphen ? 2 : 1));
-    out->suffix = (char *)malloc (suffix_bytes + 1);
-    if (!out->prefix || !out->suffix) {
-        text_split_result_dispose (out);
+    size_t n = text_token_fit_count (tk, first, available_units);
+    if (n == 0)
         return 0;
-    }
-    memcpy (out->prefix, segments[0].ptr, prefix_bytes);
-    if (insert_hyphen)
-        out->prefix[prefix_bytes++] = '-';
-    out->prefix[prefix_bytes] = '\0';
-    if (suffix_bytes > 0)
-        memcpy (out->suffix, segments[(size_t)idx + 1].ptr, suffix_bytes);
-    out->suffix[suffix_bytes] = '\0';
-    out->prefix_len = prefix_bytes;
-    out->suffix_len = suffix_bytes;
-    out->prefix_width_units = accum + (insert_hyphen ? hyphen_units : 0.0);
-    out->inserted_hyphen = insert_hyphen;
+    double hyphen_units = ctx->hyphen_advance_units * ctx->scale;
+    double accum = text_token_span_units (tk, first, n);
+    bool has_suffix = first + n < tk->seg_count;
+    bool insert_hyphen = has_suffix && (accum + hyphen_units) <= available_units;
+    text_split_fill (
+        tk, first, n, accum + (insert_hyphen ? hyphen_units : 0.0), insert_hyphen,
+        insert_hyphen, out);
     return 1;
 }
-
+/**
+ * @brief Рендерить рядок без стилів прямо з фрагментів вхідного тексту.
+ * @param pieces Фрагменти рядка.
+ * @param piece_count Кількість фрагментів.
+ * @param byte_len Довжина тексту рядка (`layout_line_t::len`).
+ * @param out Контури; з `inst` — лише тимчасовий буфер запасних шрифтів.
+ * @param inst Розкладка екземплярів гліфів (NULL — контури копіюються в `out`).
+ */
 static int text_render_line_text (
     const font_render_context_t *ctx,
     font_fallback_t *fallbacks,
-    const char *line_text,
+    const line_piece_t *pieces,
+    size_t piece_count,
+    size_t byte_len,
     double start_x_units,
     double baseline_units,
     geom_paths_t *out,
+    glyph_layout_t *inst,
     size_t *rendered_glyphs,
     size_t *missing_glyphs) {
-    if (!ctx || !line_text || !out)
+    if (!ctx || !pieces || !out)
         return -1;
     double pen_x = start_x_units / ctx->scale;
     double baseline = baseline_units / ctx->scale;
 
-    const char *cursor = line_text;
-    while (*cursor) {
-        if (*cursor == ' ') {
+    if (byte_len == 0 || piece_count == 0)
+        return 0;
+
+    /* Спершу декодуємо весь рядок, потім розвʼязуємо гліфи одним викликом. */
+    uint32_t *cps = (uint32_t *)malloc (byte_len * sizeof (*cps));
+    const glyph_t **glyphs = (const glyph_t **)malloc (byte_len * sizeof (*glyphs));
+    if (!cps || !glyphs) {
+        free (cps);
+        free (glyphs);
+        return -1;
+    }
+    size_t cp_count = 0;
+    for (size_t k = 0; k < piece_count; ++k) {
+        const line_piece_t *piece = &pieces[k];
+        if (piece->space_before)
+            cps[cp_count++] = (uint32_t)' ';
+        cp_count += str_utf8_decode_span (piece->ptr, piece->len, cps + cp_count, TEXT_CP_INVALID);
+        if (piece->hyphen_after)
+            cps[cp_count++] = (uint32_t)'-';
+    }
+    if (font_find_glyphs (ctx->font, cps, cp_count, glyphs, NULL) != 0) {
+        free (cps);
+        free (glyphs);
+        return -1;
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < cp_count; ++i) {
+        uint32_t cp = cps[i];
+        if (cp == (uint32_t)' ') {
             pen_x += ctx->space_advance_units;
-            ++cursor;
             continue;
         }
-        uint32_t cp = 0;
-        size_t consumed = 0;
-        if (str_utf8_decode (cursor, &cp, &consumed) != 0 || consumed == 0) {
+        if (cp == TEXT_CP_INVALID) {
             pen_x += ctx->space_advance_units;
-            ++cursor;
             if (missing_glyphs)
                 (*missing_glyphs)++;
             continue;
         }
-        cursor += consumed;
 
-        double advance_units = 0.0;
-        int glyph_rc = font_emit_glyph_paths (
-            ctx->font, cp, pen_x, baseline, ctx->scale, out, &advance_units);
-        if (glyph_rc == 0) {
+        if (glyphs[i]) {
+            double advance_units = 0.0;
+            int emit_rc = inst ? glyph_layout_place (
+                                     inst, glyphs[i], pen_x, baseline, ctx->scale, &advance_units)
+                               : font_emit_glyph_outline (
+                                     glyphs[i], pen_x, baseline, ctx->scale, out, &advance_units);
+            if (emit_rc != 0) {
+                rc = -1;
+                break;
+            }
             pen_x += advance_units;
             if (rendered_glyphs)
                 (*rendered_glyphs)++;
+            ttime_count (TTIME_COUNT_GLYPHS, 1);
             continue;
         }
-        if (glyph_rc == 1) {
-            double fallback_adv = 0.0;
-            int fb_rc = font_fallback_emit (
-                fallbacks, ctx, cp, pen_x, baseline_units, out, &fallback_adv, NULL);
-            if (fb_rc == 0) {
-                pen_x += fallback_adv;
-                if (rendered_glyphs)
-                    (*rendered_glyphs)++;
-                continue;
+
+        double fallback_adv = 0.0;
+        size_t fb_first = out->len;
+        int fb_rc = font_fallback_emit (
+            fallbacks, ctx, cp, pen_x, baseline_units, out, &fallback_adv, NULL);
+        if (fb_rc == 0 && inst) {
+            /* Гліф запасного шрифту не входить до атласу — зберігається як вільні контури. */
+            if (glyph_layout_add_paths (inst, out, fb_first) != 0) {
+                rc = -1;
+                break;
             }
-            if (missing_glyphs)
-                (*missing_glyphs)++;
-            if (fb_rc < 0)
-                return -1;
-            pen_x += ctx->space_advance_units;
+            geom_paths_free (out);
+            geom_paths_init (out, inst->units);
+        }
+        if (fb_rc == 0) {
+            pen_x += fallback_adv;
+            if (rendered_glyphs)
+                (*rendered_glyphs)++;
             continue;
         }
-        return -1;
+        if (missing_glyphs)
+            (*missing_glyphs)++;
+        if (fb_rc < 0) {
+            rc = -1;
+            break;
+        }
+        pen_x += ctx->space_advance_units;
     }
-    return 0;
+    free (cps);
+    free (glyphs);
+    return rc;
 }
 
 typedef struct {
@@ -1413,7 +1432,7 @@ int text_render_hershey (
 
     uint32_t *codepoints = NULL;
     size_t codepoint_count = 0;
-    if (text_collect_codepoints (text, &codepoints, &codepoint_count) != 0) {
+    if (text_collect_codepoints (NULL, text, &codepoints, &codepoint_count) != 0) {
         geom_paths_free (out);
         return -1;
     }
@@ -1556,15 +1575,347 @@ int text_layout_render (
     return text_layout_render_spans (text, opts, NULL, 0, out, lines_out, lines_count, info);
 }
 
+/** \brief Рядків в одній порції паралельної видачі гліфів. */
+#define TEXT_EMIT_CHUNK_LINES 16
+
+/** \brief Найменше рядків, з якого видача гліфів розподіляється між потоками. */
+#define TEXT_EMIT_PARALLEL_MIN_LINES 64
+
+/** \brief Верхня межа потоків видачі гліфів. */
+#define TEXT_EMIT_MAX_THREADS 16
+
 /**
- * @copydoc text_layout_render_spans
+ * @brief Незмінний стан видачі гліфів, спільний для всіх виконавців.
+ * @details Контексти шрифтів лише читаються: гліфи спільних шрифтів завантажуються
+ *          під замком `font.c`, тож один контекст безпечно ділити між потоками.
  */
-int text_layout_render_spans (
+typedef struct {
+    const text_layout_opts_t *opts;   /**< Опції верстки. */
+    const font_render_context_t *ctx; /**< Основний контекст шрифту. */
+    const text_span_t *spans;         /**< Стильові діапазони (може бути NULL). */
+    size_t span_count;                /**< Кількість діапазонів. */
+    const layout_line_t *lines;       /**< Рядки з розставленими позиціями. */
+    const line_piece_t *pieces;       /**< Фрагменти рядків. */
+} text_emit_shared_t;
+
+/**
+ * @brief Власний стан виконавця видачі гліфів.
+ */
+typedef struct {
+    font_fallback_t *fallback; /**< Фолбек (ліниво добудовується, тож у кожного потоку свій). */
+    char *line_buf;            /**< Буфер тексту рядка зі спанами. */
+    size_t line_buf_cap;       /**< Ємність `line_buf`. */
+    size_t rendered_glyphs;    /**< Видано гліфів. */
+    size_t missing_glyphs;     /**< Гліфів, яких немає в жодному шрифті. */
+} text_emit_local_t;
+
+/**
+ * @brief Видає гліфи одного рядка.
+ * @details Залежить лише від фрагментів рядка та його позиції, тож рядки можна
+ *          видавати в будь-якому порядку й паралельно.
+ * @param sh Спільний стан.
+ * @param loc Стан виконавця.
+ * @param index Індекс рядка.
+ * @param out [out] Контури (дописуються в кінець).
+ * @param inst Розкладка екземплярів гліфів (NULL — звичайні контури).
+ * @return 0 — успіх; -1 — помилка.
+ */
+static int text_emit_line (
+    const text_emit_shared_t *sh,
+    text_emit_local_t *loc,
+    size_t index,
+    geom_paths_t *out,
+    glyph_layout_t *inst) {
+    const text_layout_opts_t *opts = sh->opts;
+    const font_render_context_t *ctx = sh->ctx;
+    const layout_line_t *line = &sh->lines[index];
+    if (line->len == 0)
+        return 0;
+
+    span_run_t *line_runs = NULL;
+    size_t line_run_count = 0;
+    if (text_slice_spans_for_line (sh->spans, sh->span_count, line, &line_runs, &line_run_count)
+        != 0)
+        return -1;
+
+    const font_render_context_t *ctx_bold = NULL, *ctx_italic = NULL, *ctx_bold_italic = NULL;
+    font_render_context_t bold_ctx, italic_ctx, bold_italic_ctx;
+    font_fallback_t fb_bold, fb_italic, fb_bold_italic;
+    int need_bold = 0, need_italic = 0;
+    for (size_t r = 0; r < line_run_count; ++r) {
+        if (line_runs[r].flags & TEXT_STYLE_BOLD)
+            need_bold = 1;
+        if (line_runs[r].flags & TEXT_STYLE_ITALIC)
+            need_italic = 1;
+    }
+    if (need_bold) {
+        char name[128];
+        snprintf (name, sizeof name, "%s Bold", ctx->face.name);
+        font_face_t f;
+        int have_bold = 0;
+        if (fontreg_resolve (name, &f) == 0) {
+
+            if (strcmp (f.id, ctx->face.id) != 0
+                && font_render_context_init (&bold_ctx, &f, opts->size_pt, opts->units) == 0) {
+                ctx_bold = &bold_ctx;
+                font_fallback_init (&fb_bold, name, opts->size_pt, opts->units);
+                have_bold = 1;
+            }
+        }
+        if (!have_bold) {
+
+            if (fontreg_resolve ("Hershey Serif Bold", &f) == 0
+                && font_render_context_init (&bold_ctx, &f, opts->size_pt, opts->units) == 0) {
+                ctx_bold = &bold_ctx;
+                font_fallback_init (&fb_bold, "Hershey Serif Bold", opts->size_pt, opts->units);
+                have_bold = 1;
+            }
+        }
+        if (!have_bold) {
+            ctx_bold = NULL;
+        }
+    }
+    if (need_italic) {
+        if (font_style_context_resolve (
+                ctx->face.name, opts->size_pt, opts->units, TEXT_STYLE_ITALIC, &italic_ctx)
+            == 0) {
+            ctx_italic = &italic_ctx;
+            font_fallback_init (&fb_italic, italic_ctx.face.name, opts->size_pt, opts->units);
+        }
+    }
+
+    if (need_bold && need_italic) {
+        if (font_style_context_resolve (
+                ctx->face.name, opts->size_pt, opts->units, TEXT_STYLE_BOLD | TEXT_STYLE_ITALIC,
+                &bold_italic_ctx)
+            == 0) {
+            ctx_bold_italic = &bold_italic_ctx;
+            font_fallback_init (
+                &fb_bold_italic, bold_italic_ctx.face.name, opts->size_pt, opts->units);
+        }
+    }
+
+    int rc_render = 0;
+    if (line_run_count == 0) {
+        rc_render = text_render_line_text (
+            ctx, loc->fallback, sh->pieces + line->first_piece, line->piece_count, line->len,
+            line->offset_units, line->baseline_units, out, inst, &loc->rendered_glyphs,
+            &loc->missing_glyphs);
+    } else {
+
+        const font_render_context_t *use_bold = ctx_bold;
+        const font_render_context_t *use_italic = ctx_italic;
+        const font_render_context_t *use_bold_italic = ctx_bold_italic;
+        font_fallback_t *fb_use_bold = need_bold ? &fb_bold : loc->fallback;
+        font_fallback_t *fb_use_italic = need_italic ? &fb_italic : loc->fallback;
+        font_fallback_t *fb_use_bold_italic
+            = (need_bold && need_italic) ? &fb_bold_italic : loc->fallback;
+
+        /* Позиції спанів — зсуви в тексті рядка, тож його збираємо в спільний буфер. */
+        const char *line_text = text_line_join (
+            sh->pieces + line->first_piece, line->piece_count, &loc->line_buf,
+            &loc->line_buf_cap);
+        if (!line_text)
+            rc_render = -1;
+        else
+            rc_render = text_render_line_text_spans (
+                ctx, use_bold, use_italic, use_bold_italic, loc->fallback, fb_use_bold,
+                fb_use_italic, fb_use_bold_italic, line_text, line_runs, line_run_count,
+                line->offset_units, line->baseline_units, out, &loc->rendered_glyphs,
+                &loc->missing_glyphs);
+        (void)use_bold_italic;
+    }
+    free (line_runs);
+    if (need_bold && ctx_bold)
+        font_render_context_dispose (&bold_ctx);
+    if (need_bold && ctx_bold)
+        font_fallback_dispose (&fb_bold);
+    if (need_italic && ctx_italic) {
+        font_render_context_dispose (&italic_ctx);
+        font_fallback_dispose (&fb_italic);
+    }
+    if (need_bold && need_italic && ctx_bold_italic) {
+        font_render_context_dispose (&bold_italic_ctx);
+        font_fallback_dispose (&fb_bold_italic);
+    }
+    return rc_render;
+}
+
+/**
+ * @brief Порція рядків паралельної видачі з власним буфером контурів.
+ */
+typedef struct {
+    geom_paths_t paths;     /**< Контури рядків порції. */
+    size_t point_count;     /**< Сумарна кількість точок `paths`. */
+    geom_path_t *dst_items; /**< Слоти порції в підсумкових контурах. */
+    geom_point_t *dst_pts;  /**< Точки порції в арені підсумкових контурів. */
+    size_t rendered_glyphs; /**< Видано гліфів. */
+    size_t missing_glyphs;  /**< Відсутніх гліфів. */
+    int rc;                 /**< 0 — успіх; -1 — помилка. */
+} text_emit_chunk_t;
+
+/**
+ * @brief Спільні дані паралельної видачі порцій.
+ */
+typedef struct {
+    const text_emit_shared_t *shared; /**< Спільний стан видачі. */
+    text_emit_chunk_t *chunks;        /**< Порції в порядку рядків. */
+    size_t line_count;                /**< Кількість рядків. */
+    text_emit_local_t *local;         /**< Стан виконавців за номером (перша фаза). */
+    font_fallback_t *fallback;        /**< Фолбеки виконавців за номером (перша фаза). */
+} text_emit_queue_t;
+
+/**
+ * @brief Перша фаза (`parallel_work_fn`): видає порцію рядків у її власний буфер.
+ * @details Фолбек виконавця створюється під час першої його порції.
+ */
+static void text_emit_chunk (void *items, size_t index, size_t worker) {
+    text_emit_queue_t *queue = (text_emit_queue_t *)items;
+    const text_layout_opts_t *opts = queue->shared->opts;
+    text_emit_local_t *loc = &queue->local[worker];
+    if (!loc->fallback) {
+        loc->fallback = &queue->fallback[worker];
+        font_fallback_init (loc->fallback, opts->family, opts->size_pt, opts->units);
+    }
+    text_emit_chunk_t *chunk = &queue->chunks[index];
+    size_t first = index * TEXT_EMIT_CHUNK_LINES;
+    size_t last = first + TEXT_EMIT_CHUNK_LINES;
+    if (last > queue->line_count)
+        last = queue->line_count;
+    loc->rendered_glyphs = 0;
+    loc->missing_glyphs = 0;
+    chunk->rc = geom_paths_init (&chunk->paths, opts->units);
+    for (size_t i = first; i < last && chunk->rc == 0; ++i)
+        chunk->rc = text_emit_line (queue->shared, loc, i, &chunk->paths, NULL);
+    for (size_t p = 0; p < chunk->paths.len; ++p)
+        chunk->point_count += chunk->paths.items[p].len;
+    chunk->rendered_glyphs = loc->rendered_glyphs;
+    chunk->missing_glyphs = loc->missing_glyphs;
+}
+
+/**
+ * @brief Друга фаза (`parallel_work_fn`): копіює порцію на її місце в підсумкових контурах.
+ */
+static void text_emit_copy_chunk (void *items, size_t index, size_t worker) {
+    (void)worker;
+    text_emit_queue_t *queue = (text_emit_queue_t *)items;
+    text_emit_chunk_t *chunk = &queue->chunks[index];
+    geom_paths_copy_to (&chunk->paths, chunk->dst_items, chunk->dst_pts);
+    geom_paths_free (&chunk->paths);
+}
+
+/**
+ * @brief Кількість потоків видачі гліфів для `line_count` рядків.
+ */
+static size_t text_emit_worker_count (const text_layout_opts_t *opts, size_t line_count) {
+    if (line_count < TEXT_EMIT_PARALLEL_MIN_LINES)
+        return 1;
+    size_t chunks = (line_count + TEXT_EMIT_CHUNK_LINES - 1) / TEXT_EMIT_CHUNK_LINES;
+    return parallel_threads (opts->threads, TEXT_EMIT_MAX_THREADS, chunks);
+}
+
+/**
+ * @brief Видає гліфи всіх рядків у контури `out`.
+ * @details Для довгого тексту рядки діляться на порції по `TEXT_EMIT_CHUNK_LINES`.
+ *          Перша фаза видає кожну порцію у власний буфер; після неї відомі розміри
+ *          порцій, тож `out` розширюється один раз, а друга фаза паралельно копіює
+ *          буфери на їхні місця в порядку рядків — результат той самий, що й при
+ *          послідовній видачі.
+ * @param sh Спільний стан.
+ * @param line_count Кількість рядків.
+ * @param fallback Фолбек викликача (для послідовної видачі).
+ * @param out [out] Контури.
+ * @param inst Розкладка екземплярів гліфів (NULL — звичайні контури; завжди послідовно).
+ * @param rendered_glyphs [out] Видано гліфів.
+ * @param missing_glyphs [out] Відсутніх гліфів.
+ * @return 0 — успіх; -1 — помилка.
+ */
+static int text_emit_lines (
+    const text_emit_shared_t *sh,
+    size_t line_count,
+    font_fallback_t *fallback,
+    geom_paths_t *out,
+    glyph_layout_t *inst,
+    size_t *rendered_glyphs,
+    size_t *missing_glyphs) {
+    size_t workers = inst ? 1 : text_emit_worker_count (sh->opts, line_count);
+    if (workers <= 1) {
+        text_emit_local_t loc = { .fallback = fallback };
+        int rc = 0;
+        for (size_t i = 0; i < line_count && rc == 0; ++i)
+            rc = text_emit_line (sh, &loc, i, out, inst);
+        free (loc.line_buf);
+        *rendered_glyphs = loc.rendered_glyphs;
+        *missing_glyphs = loc.missing_glyphs;
+        return rc;
+    }
+
+    size_t chunk_count = (line_count + TEXT_EMIT_CHUNK_LINES - 1) / TEXT_EMIT_CHUNK_LINES;
+    text_emit_chunk_t *chunks = (text_emit_chunk_t *)calloc (chunk_count, sizeof (*chunks));
+    if (!chunks)
+        return -1;
+    text_emit_local_t local[TEXT_EMIT_MAX_THREADS] = { 0 };
+    font_fallback_t worker_fallback[TEXT_EMIT_MAX_THREADS];
+    text_emit_queue_t queue = {
+        .shared = sh,
+        .chunks = chunks,
+        .line_count = line_count,
+        .local = local,
+        .fallback = worker_fallback,
+    };
+    parallel_for (text_emit_chunk, &queue, chunk_count, workers);
+    for (size_t w = 0; w < workers; ++w) {
+        if (!local[w].fallback)
+            continue;
+        free (local[w].line_buf);
+        font_fallback_dispose (local[w].fallback);
+    }
+
+    int rc = 0;
+    size_t total_paths = 0, total_points = 0;
+    *rendered_glyphs = 0;
+    *missing_glyphs = 0;
+    for (size_t c = 0; c < chunk_count; ++c) {
+        if (chunks[c].rc != 0)
+            rc = -1;
+        total_paths += chunks[c].paths.len;
+        total_points += chunks[c].point_count;
+        *rendered_glyphs += chunks[c].rendered_glyphs;
+        *missing_glyphs += chunks[c].missing_glyphs;
+    }
+    geom_path_t *items = NULL;
+    geom_point_t *points = NULL;
+    if (rc == 0 && geom_paths_extend (out, total_paths, total_points, &items, &points) != 0)
+        rc = -1;
+    if (rc == 0) {
+        for (size_t c = 0; c < chunk_count; ++c) {
+            chunks[c].dst_items = items;
+            chunks[c].dst_pts = points;
+            items += chunks[c].paths.len;
+            if (points)
+                points += chunks[c].point_count;
+        }
+        parallel_for (text_emit_copy_chunk, &queue, chunk_count, workers);
+    } else {
+        for (size_t c = 0; c < chunk_count; ++c)
+            geom_paths_free (&chunks[c].paths);
+    }
+    free (chunks);
+    return rc;
+}
+
+/**
+ * @brief Спільна реалізація `text_layout_render_spans` і `text_layout_render_glyphs`.
+ * @param out Контури (з `inst` — тимчасовий буфер, який звільняє викликач).
+ * @param inst Розкладка екземплярів гліфів (NULL — звичайні контури; лише без спанів).
+ */
+static int text_layout_render_into (
     const char *text,
     const text_layout_opts_t *opts,
     const text_span_t *spans,
     size_t span_count,
     geom_paths_t *out,
+    glyph_layout_t *inst,
     text_line_metrics_t **lines_out,
     size_t *lines_count,
     text_render_info_t *info) {
@@ -1577,12 +1928,20 @@ int text_layout_render_spans (
 
     if (geom_paths_init (out, opts->units) != 0)
         return -1;
+    if (inst && glyph_layout_init (inst, opts->units) != 0)
+        return -1;
+
+    /* Проміжні дані верстки живуть до кінця виклику: відкат до позначки на виході. */
+    jobarena_t *arena = opts->arena;
+    jobarena_mark_t mark = jobarena_mark (arena);
 
     const char *input = text ? text : "";
     uint32_t *codepoints = NULL;
     size_t codepoint_count = 0;
-    if (text_collect_codepoints (input, &codepoints, &codepoint_count) != 0) {
+    if (text_collect_codepoints (arena, input, &codepoints, &codepoint_count) != 0) {
+        jobarena_rewind (arena, mark);
         geom_paths_free (out);
+        glyph_layout_free (inst);
         return -1;
     }
 
@@ -1591,16 +1950,20 @@ int text_layout_render_spans (
             opts->family, codepoints, codepoint_count, &selected_face)
         != 0) {
         if (fontreg_resolve (opts->family, &selected_face) != 0) {
-            free (codepoints);
+            jobarena_release (arena, codepoints);
+            jobarena_rewind (arena, mark);
             geom_paths_free (out);
+            glyph_layout_free (inst);
             return -1;
         }
     }
 
     font_render_context_t ctx;
     if (font_render_context_init (&ctx, &selected_face, opts->size_pt, opts->units) != 0) {
-        free (codepoints);
+        jobarena_release (arena, codepoints);
+        jobarena_rewind (arena, mark);
         geom_paths_free (out);
+        glyph_layout_free (inst);
         return -1;
     }
     font_fallback_t fallback;
@@ -1614,12 +1977,14 @@ int text_layout_render_spans (
         font_fallback_dispose (&fallback);                                                         \
         font_render_context_dispose (&ctx);                                                        \
         geom_paths_free (out);                                                                     \
-        text_free_lines (lines, line_count);                                                       \
+        glyph_layout_free (inst);                                                                  \
+        text_free_lines (arena, lines, pieces);                                                    \
+        jobarena_rewind (arena, mark);                                                             \
         if (info)                                                                                  \
             memset (info, 0, sizeof (*info));                                                      \
         return -1;                                                                                 \
     } while (0)
-    free (codepoints);
+    jobarena_release (arena, codepoints);
 
     if (info) {
         memset (info, 0, sizeof (*info));
@@ -1628,132 +1993,42 @@ int text_layout_render_spans (
     }
 
     layout_line_t *lines = NULL;
+    line_piece_t *pieces = NULL;
     size_t line_count = 0;
 
     text_token_t *toks = NULL;
     size_t tok_count = 0;
-    if (text_tokenize_text (input, &toks, &tok_count) != 0)
+    if (text_tokenize_text (arena, input, &toks, &tok_count) != 0)
         LAYOUT_FAIL ();
 
-    if (text_shape_measure_words (&ctx, toks, tok_count) != 0) {
-        text_tokens_dispose (toks, tok_count);
+    if (text_shape_measure_words (arena, &ctx, toks, tok_count) != 0) {
+        text_tokens_dispose (arena, toks, tok_count);
         LAYOUT_FAIL ();
     }
 
-    if (text_break_tokens_into_lines (opts, &ctx, toks, tok_count, &lines, &line_count) != 0) {
-        text_tokens_dispose (toks, tok_count);
+    if (text_break_tokens_into_lines (opts, &ctx, toks, tok_count, &lines, &line_count, &pieces)
+        != 0) {
+        text_tokens_dispose (arena, toks, tok_count);
         LAYOUT_FAIL ();
     }
-    text_tokens_dispose (toks, tok_count);
+    text_tokens_dispose (arena, toks, tok_count);
 
     text_assign_layout_positions (opts, &ctx, lines, line_count);
 
+    text_emit_shared_t emit = {
+        .opts = opts,
+        .ctx = &ctx,
+        .spans = spans,
+        .span_count = span_count,
+        .lines = lines,
+        .pieces = pieces,
+    };
     size_t rendered_glyphs = 0;
     size_t missing_glyphs = 0;
-    for (size_t i = 0; i < line_count; ++i) {
-        layout_line_t *line = &lines[i];
-        if (!line->text || line->len == 0)
-            continue;
-
-        span_run_t *line_runs = NULL;
-        size_t line_run_count = 0;
-        if (text_slice_spans_for_line (spans, span_count, line, &line_runs, &line_run_count) != 0)
-            LAYOUT_FAIL ();
-
-        const font_render_context_t *ctx_bold = NULL, *ctx_italic = NULL, *ctx_bold_italic = NULL;
-        font_render_context_t bold_ctx, italic_ctx, bold_italic_ctx;
-        font_fallback_t fb_bold, fb_italic, fb_bold_italic;
-        int need_bold = 0, need_italic = 0;
-        for (size_t r = 0; r < line_run_count; ++r) {
-            if (line_runs[r].flags & TEXT_STYLE_BOLD)
-                need_bold = 1;
-            if (line_runs[r].flags & TEXT_STYLE_ITALIC)
-                need_italic = 1;
-        }
-        if (need_bold) {
-            char name[128];
-            snprintf (name, sizeof name, "%s Bold", ctx.face.name);
-            font_face_t f;
-            int have_bold = 0;
-            if (fontreg_resolve (name, &f) == 0) {
-
-                if (strcmp (f.id, ctx.face.id) != 0
-                    && font_render_context_init (&bold_ctx, &f, opts->size_pt, opts->units) == 0) {
-                    ctx_bold = &bold_ctx;
-                    font_fallback_init (&fb_bold, name, opts->size_pt, opts->units);
-                    have_bold = 1;
-                }
-            }
-            if (!have_bold) {
-
-                if (fontreg_resolve ("Hershey Serif Bold", &f) == 0
-                    && font_render_context_init (&bold_ctx, &f, opts->size_pt, opts->units) == 0) {
-                    ctx_bold = &bold_ctx;
-                    font_fallback_init (&fb_bold, "Hershey Serif Bold", opts->size_pt, opts->units);
-                    have_bold = 1;
-                }
-            }
-            if (!have_bold) {
-                ctx_bold = NULL;
-            }
-        }
-        if (need_italic) {
-            if (font_style_context_resolve (
-                    ctx.face.name, opts->size_pt, opts->units, TEXT_STYLE_ITALIC, &italic_ctx)
-                == 0) {
-                ctx_italic = &italic_ctx;
-                font_fallback_init (&fb_italic, italic_ctx.face.name, opts->size_pt, opts->units);
-            }
-        }
-
-        if (need_bold && need_italic) {
-            if (font_style_context_resolve (
-                    ctx.face.name, opts->size_pt, opts->units, TEXT_STYLE_BOLD | TEXT_STYLE_ITALIC,
-                    &bold_italic_ctx)
-                == 0) {
-                ctx_bold_italic = &bold_italic_ctx;
-                font_fallback_init (
-                    &fb_bold_italic, bold_italic_ctx.face.name, opts->size_pt, opts->units);
-            }
-        }
-
-        int rc_render = 0;
-        if (line_run_count == 0) {
-            rc_render = text_render_line_text (
-                &ctx, &fallback, line->text, line->offset_units, line->baseline_units, out,
-                &rendered_glyphs, &missing_glyphs);
-        } else {
-
-            const font_render_context_t *use_bold = ctx_bold;
-            const font_render_context_t *use_italic = ctx_italic;
-            const font_render_context_t *use_bold_italic = ctx_bold_italic;
-            font_fallback_t *fb_use_bold = need_bold ? &fb_bold : &fallback;
-            font_fallback_t *fb_use_italic = need_italic ? &fb_italic : &fallback;
-            font_fallback_t *fb_use_bold_italic
-                = (need_bold && need_italic) ? &fb_bold_italic : &fallback;
-
-            rc_render = text_render_line_text_spans (
-                &ctx, use_bold, use_italic, use_bold_italic, &fallback, fb_use_bold, fb_use_italic,
-                fb_use_bold_italic, line->text, line_runs, line_run_count, line->offset_units,
-                line->baseline_units, out, &rendered_glyphs, &missing_glyphs);
-            (void)use_bold_italic;
-        }
-        free (line_runs);
-        if (need_bold && ctx_bold)
-            font_render_context_dispose (&bold_ctx);
-        if (need_bold && ctx_bold)
-            font_fallback_dispose (&fb_bold);
-        if (need_italic && ctx_italic) {
-            font_render_context_dispose (&italic_ctx);
-            font_fallback_dispose (&fb_italic);
-        }
-        if (need_bold && need_italic && ctx_bold_italic) {
-            font_render_context_dispose (&bold_italic_ctx);
-            font_fallback_dispose (&fb_bold_italic);
-        }
-        if (rc_render != 0)
-            LAYOUT_FAIL ();
-    }
+    if (text_emit_lines (
+            &emit, line_count, &fallback, out, inst, &rendered_glyphs, &missing_glyphs)
+        != 0)
+        LAYOUT_FAIL ();
 
     if (lines_out) {
         text_line_metrics_t *metrics = calloc (line_count, sizeof (*metrics));
@@ -1791,11 +2066,175 @@ int text_layout_render_spans (
     text_font_usage_stats_dispose (&usage);
     font_fallback_dispose (&fallback);
     font_render_context_dispose (&ctx);
-    text_free_lines (lines, line_count);
+    text_free_lines (arena, lines, pieces);
+    jobarena_rewind (arena, mark);
 #undef LAYOUT_FAIL
     return 0;
 }
 
+/**
+ * @copydoc text_layout_render_spans
+ */
+int text_layout_render_spans (
+    const char *text,
+    const text_layout_opts_t *opts,
+    const text_span_t *spans,
+    size_t span_count,
+    geom_paths_t *out,
+    text_line_metrics_t **lines_out,
+    size_t *lines_count,
+    text_render_info_t *info) {
+    uint64_t t0 = ttime_stage_begin ();
+    int rc = text_layout_render_into (
+        text, opts, spans, span_count, out, NULL, lines_out, lines_count, info);
+    ttime_stage_end (TTIME_STAGE_TEXT, t0);
+    return rc;
+}
+
+/**
+ * @copydoc text_layout_render_glyphs
+ */
+int text_layout_render_glyphs (
+    const char *text,
+    const text_layout_opts_t *opts,
+    glyph_layout_t *out,
+    text_render_info_t *info) {
+    if (!out)
+        return -1;
+    geom_paths_t scratch;
+    uint64_t t0 = ttime_stage_begin ();
+    int rc = text_layout_render_into (text, opts, NULL, 0, &scratch, out, NULL, NULL, info);
+    ttime_stage_end (TTIME_STAGE_TEXT, t0);
+    if (rc == 0)
+        geom_paths_free (&scratch);
+    return rc;
+}
+
+/**
+ * \brief Габарити блоку в базовому кеглі при заданій ширині рамки (лише перенос рядків).
+ */
+static int text_measure_block (
+    const text_layout_opts_t *opts,
+    const font_render_context_t *ctx,
+    const text_token_t *toks,
+    size_t tok_count,
+    double frame_width,
+    double *out_width,
+    double *out_height) {
+    text_layout_opts_t probe = *opts;
+    probe.frame_width = frame_width;
+    layout_line_t *lines = NULL;
+    size_t line_count = 0;
+    jobarena_mark_t mark = jobarena_mark (opts->arena);
+    if (text_break_tokens_into_lines (&probe, ctx, toks, tok_count, &lines, &line_count, NULL)
+        != 0) {
+        jobarena_rewind (opts->arena, mark);
+        return -1;
+    }
+    double width = 0.0;
+    for (size_t i = 0; i < line_count; ++i)
+        if (lines[i].width_units > width)
+            width = lines[i].width_units;
+    text_free_lines (opts->arena, lines, NULL);
+    jobarena_rewind (opts->arena, mark);
+
+    double spacing = (opts->line_spacing > 0.0) ? opts->line_spacing : 1.2;
+    double line_height = ctx->line_height_units * ctx->scale;
+    double glyph_height = (ctx->metrics.ascent + fabs (ctx->metrics.descent)) * ctx->scale;
+    if (!(glyph_height > 0.0))
+        glyph_height = line_height;
+    double height = glyph_height;
+    if (line_count > 1)
+        height += (double)(line_count - 1) * line_height * spacing;
+    *out_width = width;
+    *out_height = height;
+    return 0;
+}
+
+/**
+ * @copydoc text_layout_fit_size
+ */
+int text_layout_fit_size (
+    const char *text,
+    const text_layout_opts_t *opts,
+    double max_height,
+    double min_size_pt,
+    double *out_size_pt) {
+    if (!opts || !out_size_pt || !(opts->frame_width > 0.0) || !(max_height > 0.0))
+        return -1;
+    double base_pt = (opts->size_pt > 0.0) ? opts->size_pt : 14.0;
+    *out_size_pt = base_pt;
+
+    jobarena_t *arena = opts->arena;
+    jobarena_mark_t mark = jobarena_mark (arena);
+    const char *input = text ? text : "";
+    uint32_t *codepoints = NULL;
+    size_t codepoint_count = 0;
+    if (text_collect_codepoints (arena, input, &codepoints, &codepoint_count) != 0) {
+        jobarena_rewind (arena, mark);
+        return -1;
+    }
+    font_face_t selected_face;
+    if (fontreg_select_face_for_codepoints (
+            opts->family, codepoints, codepoint_count, &selected_face)
+        != 0) {
+        if (fontreg_resolve (opts->family, &selected_face) != 0) {
+            jobarena_release (arena, codepoints);
+            jobarena_rewind (arena, mark);
+            return -1;
+        }
+    }
+    jobarena_release (arena, codepoints);
+
+    font_render_context_t ctx;
+    if (font_render_context_init (&ctx, &selected_face, base_pt, opts->units) != 0) {
+        jobarena_rewind (arena, mark);
+        return -1;
+    }
+    text_token_t *toks = NULL;
+    size_t tok_count = 0;
+    if (text_tokenize_text (arena, input, &toks, &tok_count) != 0) {
+        font_render_context_dispose (&ctx);
+        jobarena_rewind (arena, mark);
+        return -1;
+    }
+    if (text_shape_measure_words (arena, &ctx, toks, tok_count) != 0) {
+        text_tokens_dispose (arena, toks, tok_count);
+        font_render_context_dispose (&ctx);
+        jobarena_rewind (arena, mark);
+        return -1;
+    }
+
+    /*
+     * Ширини токенів лінійні за кеглем, тож верстка в кеглі base·r при рамці W
+     * збігається з версткою в базовому кеглі при рамці W/r, лише масштабованою на r.
+     * Слова вимірюються один раз, а кожна проба — це тільки перенос рядків.
+     */
+    double frame_width = opts->frame_width;
+    double w = 0.0, h = 0.0;
+    int rc = text_measure_block (opts, &ctx, toks, tok_count, frame_width, &w, &h);
+    if (rc == 0 && (h > max_height || w > frame_width)) {
+        double lo = (min_size_pt > 0.0 && min_size_pt < base_pt) ? min_size_pt / base_pt : 1.0;
+        double hi = 1.0;
+        for (int iter = 0; iter < 14 && rc == 0 && hi - lo > 1e-3; ++iter) {
+            double mid = 0.5 * (lo + hi);
+            rc = text_measure_block (opts, &ctx, toks, tok_count, frame_width / mid, &w, &h);
+            if (rc != 0)
+                break;
+            if (h * mid <= max_height && w * mid <= frame_width)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        *out_size_pt = base_pt * lo;
+    }
+
+    text_tokens_dispose (arena, toks, tok_count);
+    font_render_context_dispose (&ctx);
+    jobarena_rewind (arena, mark);
+    return rc == 0 ? 0 : -1;
+}
+
 /**
  * @copydoc text_layout_free_lines
  */
@@ -5,12 +5,16 @@
  * @details
  * Модуль забезпечує рендеринг тексту у контури Hershey та верстку багаторядкових
  * блоків у заданій рамці. Підтримуються базові стилі (напівжирний, курсив,
- * підкреслення/закреслення), вирівнювання та примітивне перенесення слів.
+ * підкреслення/закреслення), вирівнювання та перенесення слів. Ширини слів і їхні
+ * префіксні суми обчислюються один раз після токенізації, тож розбиття на рядки
+ * (жадібне або оптимальне за Кнутом–Пласом) — лише арифметика над ними.
  */
 #ifndef TEXT_H
 #define TEXT_H
 
 #include "geom.h"
+#include "glyphlayout.h"
+#include "jobarena.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -65,6 +69,14 @@ typedef enum {
     TEXT_ALIGN_RIGHT = 2,  /**< По правому краю. */
 } text_align_t;
 
+/**
+ * @brief Алгоритм розбиття абзаців на рядки.
+ */
+typedef enum {
+    TEXT_BREAK_GREEDY = 0,  /**< Жадібний: слово, що не вміщується, переходить на новий рядок. */
+    TEXT_BREAK_OPTIMAL = 1, /**< Оптимальний для абзацу (Кнут–Пласс): рівномірніший правий край. */
+} text_break_mode_t;
+
 /**
  * @brief Опції верстки текстового блоку.
  */
@@ -74,11 +86,14 @@ typedef struct {
     unsigned style_flags; /**< Базові стилі (`TEXT_STYLE_*`). */
     geom_units_t units;   /**< Одиниці вихідних контурів. */
 
-    double frame_width;   /**< Ширина рамки для переносу рядків (у відповідних одиницях). */
-    text_align_t align;   /**< Вирівнювання рядків. */
-    int hyphenate;        /**< Дозволити перенос по дефісу (1/0). */
-    double line_spacing;  /**< Множник міжрядкового інтервалу (1.0..). */
-    int break_long_words; /**< Примусово ламати надто довгі слова (1/0). */
+    double frame_width;           /**< Ширина рамки для переносу рядків (у відповідних одиницях). */
+    text_align_t align;           /**< Вирівнювання рядків. */
+    int hyphenate;                /**< Дозволити перенос по дефісу (1/0). */
+    double line_spacing;          /**< Множник міжрядкового інтервалу (1.0..). */
+    int break_long_words;         /**< Примусово ламати надто довгі слова (1/0). */
+    text_break_mode_t break_mode; /**< Алгоритм розбиття на рядки. */
+    unsigned threads;             /**< Потоки видачі гліфів: 0 — за ядрами, 1 — без потоків. */
+    jobarena_t *arena;            /**< Арена проміжних даних верстки (NULL — купа). */
 } text_layout_opts_t;
 
 /**
@@ -107,6 +122,8 @@ typedef struct text_span {
 
 /**
  * @brief Розміщує та рендерить текст у межах рамки.
+ * @details Після розбиття на рядки гліфи довгого тексту видаються в `opts->threads`
+ *          потоках порціями рядків; порядок контурів не залежить від кількості потоків.
  * @param text Вхідний текст (UTF‑8).
  * @param opts Опції верстки/рендерингу (обовʼязково `frame_width > 0`).
  * @param out [out] Контейнери контурів; ініціалізуються всередині.
@@ -145,6 +162,42 @@ int text_layout_render_spans (
     size_t *lines_count,
     text_render_info_t *info);
 
+/**
+ * @brief Розміщує та рендерить текст як екземпляри гліфів (без копій контурів).
+ * @details Верстка та сама, що й у `text_layout_render`: `glyph_layout_flatten` дає ті
+ *          самі контури в тому ж порядку. Гліфи запасних шрифтів зберігаються вільними
+ *          контурами.
+ * @param text Вхідний текст (UTF‑8).
+ * @param opts Опції верстки/рендерингу.
+ * @param out [out] Розкладка; ініціалізується всередині (звільнити `glyph_layout_free`).
+ * @param info [out] Метрики рендерингу (може бути `NULL`).
+ * @return 0 — успіх; -1 — помилка.
+ */
+int text_layout_render_glyphs (
+    const char *text,
+    const text_layout_opts_t *opts,
+    glyph_layout_t *out,
+    text_render_info_t *info);
+
+/**
+ * @brief Підбирає найбільший кегль, за якого блок тексту вміщується у висоту рамки.
+ * @details Слова вимірюються один раз у кеглі `opts->size_pt`; бінарний пошук за кеглем
+ *          повторює лише перенос рядків, без емісії контурів гліфів. Висота блоку —
+ *          базові лінії всіх рядків плюс висота гліфів (ascent + descent).
+ * @param text Вхідний текст (UTF‑8).
+ * @param opts Опції верстки (`frame_width > 0`); `size_pt` — верхня межа пошуку.
+ * @param max_height Доступна висота рамки у вихідних одиницях.
+ * @param min_size_pt Нижня межа кегля, пт (якщо й вона не вміщується — повертається вона).
+ * @param out_size_pt [out] Підібраний кегль, пт.
+ * @return 0 — успіх; -1 — помилка параметрів/виділення/шрифтів.
+ */
+int text_layout_fit_size (
+    const char *text,
+    const text_layout_opts_t *opts,
+    double max_height,
+    double min_size_pt,
+    double *out_size_pt);
+
 /**
  * @brief Вивільняє масив метрик рядків, отриманий із `text_layout_render*`.
  */
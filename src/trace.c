@@ -0,0 +1,439 @@
+/**
+ * @file trace.c
+ * @brief Реалізація кільця трасування, аварійного дампа і розшифровки.
+ * @ingroup trace
+ */
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ttime.h"
+
+bool trace_enabled = false;
+
+/** Сигнатура дампа. */
+#define TRACE_MAGIC "CPLTRACE"
+/** Версія формату дампа. */
+#define TRACE_VERSION 1u
+
+/** \brief Рядок таблиці форматів. */
+#define TRACE_EVENT_FMT(NAME, FMT) FMT,
+
+/** Формати подій (порядок — як у `trace_event_t`). */
+static const char *const k_trace_formats[TRACE_EVENT_COUNT] = { TRACE_EVENTS (TRACE_EVENT_FMT) };
+
+/**
+ * @brief Числовий аргумент події.
+ */
+typedef union {
+    int64_t i;  /**< Знакове ціле. */
+    uint64_t u; /**< Беззнакове ціле. */
+    double f;   /**< Число з рухомою комою. */
+} trace_arg_t;
+
+/**
+ * @brief Запис кільця фіксованого розміру.
+ */
+typedef struct {
+    uint64_t seq;                     /**< Номер запису + 1; 0 — слот пишеться. */
+    uint64_t ts_ns;                   /**< Час від `trace_start`, нс. */
+    uint16_t event;                   /**< `trace_event_t`. */
+    uint16_t thread;                  /**< Номер потоку (у порядку першого запису). */
+    uint32_t reserved;                /**< Вирівнювання. */
+    trace_arg_t args[TRACE_ARGS_MAX]; /**< Числові аргументи в порядку формату. */
+    char text[TRACE_TEXT_MAX];        /**< Рядкові аргументи, кожен завершений `\0`. */
+} trace_record_t;
+
+/**
+ * @brief Заголовок дампа.
+ */
+typedef struct {
+    char magic[8];         /**< `TRACE_MAGIC`. */
+    uint32_t version;      /**< `TRACE_VERSION`. */
+    uint32_t record_size;  /**< `sizeof (trace_record_t)`. */
+    uint32_t capacity;     /**< Кількість записів кільця. */
+    uint32_t format_hash;  /**< Хеш таблиці форматів: дамп іншої збірки не розшифровується. */
+    uint64_t head;         /**< Кількість зарезервованих записів. */
+} trace_header_t;
+
+static trace_record_t *g_ring;     /**< Кільце записів. */
+static uint64_t g_head;            /**< Наступний номер запису. */
+static uint64_t g_start_ns;        /**< Момент `trace_start`. */
+static uint16_t g_next_thread;     /**< Лічильник номерів потоків. */
+static int g_fd = -1;              /**< Файл дампа. */
+static __thread uint16_t t_thread; /**< Номер потоку + 1 (0 — ще не призначено). */
+
+/** Аварійні сигнали, на які скидається кільце. */
+static const int k_trace_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+/** \brief FNV-1a таблиці форматів. */
+static uint32_t trace_format_hash (void) {
+    uint32_t h = 2166136261u;
+    for (size_t e = 0; e < TRACE_EVENT_COUNT; ++e) {
+        for (const char *p = k_trace_formats[e]; *p; ++p)
+            h = (h ^ (uint8_t)*p) * 16777619u;
+        h = (h ^ 0u) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Специфікатор формату `printf`.
+ */
+typedef struct {
+    char spec[16]; /**< Прапорці, ширина і точність без модифікатора довжини. */
+    char length;   /**< 'z', 'l', 'L' (ll), 'h', 'H' (hh), 'j', 't' або 0. */
+    char conv;     /**< Перетворення ('d', 'u', 'f', 's', '%', …); 0 — кінець рядка. */
+} trace_spec_t;
+
+/**
+ * @brief Копіює в `out` текст до наступного специфікатора й розбирає його.
+ * @param p [in,out] Позиція у форматі.
+ * @param out Потік для літерального тексту (NULL — пропустити).
+ * @param spec [out] Специфікатор.
+ */
+static void trace_next_spec (const char **p, FILE *out, trace_spec_t *spec) {
+    const char *s = *p;
+    const char *pct = strchr (s, '%');
+    size_t lit = pct ? (size_t)(pct - s) : strlen (s);
+    if (out && lit)
+        fwrite (s, 1, lit, out);
+    memset (spec, 0, sizeof (*spec));
+    if (!pct) {
+        *p = s + lit;
+        return;
+    }
+    s = pct + 1;
+    size_t n = 0;
+    spec->spec[n++] = '%';
+    while (*s && strchr ("-+ #0123456789.", *s)) {
+        if (n + 1 < sizeof (spec->spec))
+            spec->spec[n++] = *s;
+        ++s;
+    }
+    if (*s == 'l' && s[1] == 'l') {
+        spec->length = 'L';
+        s += 2;
+    } else if (*s == 'h' && s[1] == 'h') {
+        spec->length = 'H';
+        s += 2;
+    } else if (*s && strchr ("lhzjt", *s)) {
+        spec->length = *s++;
+    }
+    spec->conv = *s ? *s++ : '%';
+    *p = s;
+}
+
+/** \brief Чи є перетворення знаковим цілим. */
+static bool trace_conv_signed (char conv) { return conv == 'd' || conv == 'i'; }
+
+/** \brief Чи є перетворення беззнаковим цілим. */
+static bool trace_conv_unsigned (char conv) {
+    return conv == 'u' || conv == 'x' || conv == 'X' || conv == 'o' || conv == 'c';
+}
+
+/** \brief Чи є перетворення числом з рухомою комою. */
+static bool trace_conv_float (char conv) { return conv && strchr ("fFeEgGaA", conv); }
+
+/** \brief Зчитує знакове ціле з `ap` за модифікатором довжини. */
+static int64_t trace_arg_signed (va_list *ap, char length) {
+    switch (length) {
+    case 'z':
+        return (int64_t)va_arg (*ap, size_t);
+    case 'l':
+        return (int64_t)va_arg (*ap, long);
+    case 'L':
+    case 'j':
+        return (int64_t)va_arg (*ap, long long);
+    case 't':
+        return (int64_t)va_arg (*ap, ptrdiff_t);
+    default:
+        return (int64_t)va_arg (*ap, int);
+    }
+}
+
+/** \brief Зчитує беззнакове ціле з `ap` за модифікатором довжини. */
+static uint64_t trace_arg_unsigned (va_list *ap, char length) {
+    switch (length) {
+    case 'z':
+        return (uint64_t)va_arg (*ap, size_t);
+    case 'l':
+        return (uint64_t)va_arg (*ap, unsigned long);
+    case 'L':
+    case 'j':
+        return (uint64_t)va_arg (*ap, unsigned long long);
+    case 't':
+        return (uint64_t)va_arg (*ap, ptrdiff_t);
+    default:
+        return (uint64_t)va_arg (*ap, unsigned int);
+    }
+}
+
+/**
+ * @brief Заповнює запис аргументами події за її форматом.
+ * @param rec [out] Запис.
+ * @param fmt Формат події.
+ * @param ap Аргументи.
+ */
+static void trace_capture (trace_record_t *rec, const char *fmt, va_list *ap) {
+    size_t nargs = 0;
+    size_t text_len = 0;
+    const char *p = fmt;
+    trace_spec_t spec;
+    for (trace_next_spec (&p, NULL, &spec); spec.conv; trace_next_spec (&p, NULL, &spec)) {
+        if (spec.conv == '%')
+            continue;
+        if (spec.conv == 's') {
+            const char *s = va_arg (*ap, const char *);
+            size_t len = s ? strlen (s) : 0;
+            if (text_len + len + 1 > TRACE_TEXT_MAX)
+                len = text_len + 1 < TRACE_TEXT_MAX ? TRACE_TEXT_MAX - text_len - 1 : 0;
+            if (text_len < TRACE_TEXT_MAX) {
+                memcpy (rec->text + text_len, s ? s : "", len);
+                rec->text[text_len + len] = '\0';
+                text_len += len + 1;
+            }
+            continue;
+        }
+        trace_arg_t arg = { .u = 0 };
+        if (trace_conv_signed (spec.conv))
+            arg.i = trace_arg_signed (ap, spec.length);
+        else if (trace_conv_unsigned (spec.conv))
+            arg.u = trace_arg_unsigned (ap, spec.length);
+        else if (trace_conv_float (spec.conv))
+            arg.f = va_arg (*ap, double);
+        else
+            (void)va_arg (*ap, void *);
+        if (nargs < TRACE_ARGS_MAX)
+            rec->args[nargs++] = arg;
+    }
+}
+
+/** @copydoc trace_log */
+void trace_log (trace_event_t event, ...) {
+    if ((unsigned)event >= TRACE_EVENT_COUNT)
+        return;
+    va_list ap;
+    va_start (ap, event);
+    if (!trace_enabled) {
+        log_vprint (LOG_DEBUG, k_trace_formats[event], ap);
+        va_end (ap);
+        return;
+    }
+    if (!t_thread)
+        t_thread = (uint16_t)(__atomic_add_fetch (&g_next_thread, 1, __ATOMIC_RELAXED));
+    uint64_t seq = __atomic_fetch_add (&g_head, 1, __ATOMIC_RELAXED);
+    trace_record_t *rec = &g_ring[seq & (TRACE_RING_RECORDS - 1)];
+    __atomic_store_n (&rec->seq, 0, __ATOMIC_RELEASE);
+    uint64_t now = ttime_now_ns ();
+    rec->ts_ns = now > g_start_ns ? now - g_start_ns : 0;
+    rec->event = (uint16_t)event;
+    rec->thread = (uint16_t)(t_thread - 1);
+    memset (rec->args, 0, sizeof (rec->args));
+    rec->text[0] = '\0';
+    trace_capture (rec, k_trace_formats[event], &ap);
+    va_end (ap);
+    __atomic_store_n (&rec->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/** \brief Пише буфер повністю (async-signal-safe). */
+static int trace_write_all (int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t wr = write (fd, p, len);
+        if (wr < 0 && errno == EINTR)
+            continue;
+        if (wr <= 0)
+            return -1;
+        p += wr;
+        len -= (size_t)wr;
+    }
+    return 0;
+}
+
+/** \brief Скидає заголовок і кільце у файл дампа (async-signal-safe). */
+static int trace_dump (void) {
+    if (g_fd < 0 || !g_ring)
+        return -1;
+    trace_header_t hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, TRACE_MAGIC, sizeof (hdr.magic));
+    hdr.version = TRACE_VERSION;
+    hdr.record_size = (uint32_t)sizeof (trace_record_t);
+    hdr.capacity = TRACE_RING_RECORDS;
+    hdr.format_hash = trace_format_hash ();
+    hdr.head = __atomic_load_n (&g_head, __ATOMIC_ACQUIRE);
+    if (lseek (g_fd, 0, SEEK_SET) != 0)
+        return -1;
+    if (trace_write_all (g_fd, &hdr, sizeof (hdr)) != 0
+        || trace_write_all (g_fd, g_ring, TRACE_RING_RECORDS * sizeof (trace_record_t)) != 0)
+        return -1;
+    return 0;
+}
+
+/** \brief Обробник аварійного сигналу: скидає кільце і повторює сигнал. */
+static void trace_crash_handler (int sig) {
+    (void)trace_dump ();
+    signal (sig, SIG_DFL);
+    raise (sig);
+}
+
+/** @copydoc trace_start */
+int trace_start (const char *path) {
+    if (!path || !path[0] || trace_enabled)
+        return 0;
+    g_ring = (trace_record_t *)calloc (TRACE_RING_RECORDS, sizeof (*g_ring));
+    if (!g_ring) {
+        LOGW ("трасування: недостатньо памʼяті для кільця");
+        return -1;
+    }
+    g_fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (g_fd < 0) {
+        LOGW ("трасування: не вдалося відкрити %s", path);
+        free (g_ring);
+        g_ring = NULL;
+        return -1;
+    }
+    g_head = 0;
+    g_start_ns = ttime_now_ns ();
+    struct sigaction sa;
+    memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = trace_crash_handler;
+    sigemptyset (&sa.sa_mask);
+    sa.sa_flags = SA_RESETHAND;
+    for (size_t i = 0; i < sizeof (k_trace_signals) / sizeof (k_trace_signals[0]); ++i)
+        sigaction (k_trace_signals[i], &sa, NULL);
+    trace_enabled = true;
+    LOGD ("трасування: кільце на %u записів, дамп у %s", TRACE_RING_RECORDS, path);
+    return 0;
+}
+
+/** @copydoc trace_stop */
+void trace_stop (void) {
+    if (!trace_enabled)
+        return;
+    trace_enabled = false;
+    for (size_t i = 0; i < sizeof (k_trace_signals) / sizeof (k_trace_signals[0]); ++i)
+        signal (k_trace_signals[i], SIG_DFL);
+    if (trace_dump () != 0)
+        LOGW ("трасування: не вдалося записати дамп");
+    close (g_fd);
+    g_fd = -1;
+    free (g_ring);
+    g_ring = NULL;
+}
+
+/**
+ * @brief Друкує повідомлення запису за форматом його події.
+ * @param rec Запис.
+ * @param out Потік.
+ */
+static void trace_render (const trace_record_t *rec, FILE *out) {
+    const char *p = k_trace_formats[rec->event];
+    const char *text = rec->text;
+    const char *text_end = rec->text + TRACE_TEXT_MAX;
+    size_t arg = 0;
+    char spec[24];
+    trace_spec_t sp;
+    for (trace_next_spec (&p, out, &sp); sp.conv; trace_next_spec (&p, out, &sp)) {
+        if (sp.conv == '%') {
+            fputc ('%', out);
+            continue;
+        }
+        if (sp.conv == 's') {
+            if (text < text_end) {
+                size_t len = strnlen (text, (size_t)(text_end - text));
+                fwrite (text, 1, len, out);
+                text += len + 1;
+            }
+            continue;
+        }
+        trace_arg_t a = arg < TRACE_ARGS_MAX ? rec->args[arg] : (trace_arg_t){ .u = 0 };
+        ++arg;
+        if (trace_conv_signed (sp.conv) || trace_conv_unsigned (sp.conv)) {
+            snprintf (spec, sizeof (spec), "%sll%c", sp.spec, sp.conv == 'c' ? 'u' : sp.conv);
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wformat-nonliteral"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+#endif
+            if (trace_conv_signed (sp.conv))
+                fprintf (out, spec, (long long)a.i);
+            else
+                fprintf (out, spec, (unsigned long long)a.u);
+        } else if (trace_conv_float (sp.conv)) {
+            snprintf (spec, sizeof (spec), "%s%c", sp.spec, sp.conv);
+            fprintf (out, spec, a.f);
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+        }
+    }
+}
+
+/** \brief Порівняння записів за номером для `qsort`. */
+static int trace_record_cmp (const void *a, const void *b) {
+    uint64_t sa = ((const trace_record_t *)a)->seq;
+    uint64_t sb = ((const trace_record_t *)b)->seq;
+    return (sa > sb) - (sa < sb);
+}
+
+/** @copydoc trace_decode_file */
+int trace_decode_file (const char *path, FILE *out) {
+    if (!path || !out)
+        return -1;
+    FILE *fp = fopen (path, "rb");
+    if (!fp) {
+        LOGE ("Не вдалося відкрити дамп трасування %s", path);
+        return -1;
+    }
+    trace_header_t hdr;
+    if (fread (&hdr, sizeof (hdr), 1, fp) != 1 || memcmp (hdr.magic, TRACE_MAGIC, 8) != 0
+        || hdr.version != TRACE_VERSION || hdr.record_size != sizeof (trace_record_t)
+        || hdr.capacity == 0 || hdr.capacity > (1u << 24)) {
+        LOGE ("Файл %s не є дампом трасування cplot", path);
+        fclose (fp);
+        return -1;
+    }
+    if (hdr.format_hash != trace_format_hash ()) {
+        LOGE ("Дамп %s записано іншою збіркою cplot: події не збігаються", path);
+        fclose (fp);
+        return -1;
+    }
+    trace_record_t *recs = (trace_record_t *)calloc (hdr.capacity, sizeof (*recs));
+    if (!recs) {
+        fclose (fp);
+        return -1;
+    }
+    size_t got = fread (recs, sizeof (*recs), hdr.capacity, fp);
+    fclose (fp);
+
+    /* Лишаються завершені записи в порядку номерів (слоти, що писались, мають seq 0). */
+    size_t n = 0;
+    for (size_t i = 0; i < got; ++i) {
+        if (recs[i].seq != 0 && recs[i].event < TRACE_EVENT_COUNT)
+            recs[n++] = recs[i];
+    }
+    qsort (recs, n, sizeof (*recs), trace_record_cmp);
+    if (hdr.head > n)
+        fprintf (
+            out, "# записів %llu, збережено останні %zu\n", (unsigned long long)hdr.head, n);
+    for (size_t i = 0; i < n; ++i) {
+        fprintf (out, "%12.6f мс [%u] ", (double)recs[i].ts_ns / 1e6, (unsigned)recs[i].thread);
+        trace_render (&recs[i], out);
+        fputc ('\n', out);
+    }
+    free (recs);
+    return 0;
+}
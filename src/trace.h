@@ -0,0 +1,111 @@
+#ifndef CPLOT_TRACE_H
+#define CPLOT_TRACE_H
+/**
+ * @file trace.h
+ * @brief Бінарний журнал подій гарячих шляхів (кільце в памʼяті).
+ * @defgroup trace Трасування
+ * @ingroup log
+ * @details
+ * Налагоджувальні повідомлення крокувача, черги AxiDraw і обміну з EBB записуються
+ * через `TRACE_LOG`. Без `--trace` подія друкується як звичайний рядок `LOGD` (лише з
+ * `--verbose`/`CPLOT_LOG=debug`). З `--trace PATH` подія не форматується: у кільце
+ * записується запис фіксованого розміру — час, потік, номер події, числові аргументи
+ * і короткі рядки. Запис резервує слот атомарним інкрементом без блокувань; коли
+ * кільце заповнене, найстаріші записи перезаписуються. Кільце скидається у `PATH`
+ * після виконання команди і з обробника аварійних сигналів (SIGSEGV, SIGABRT, …);
+ * `cplot trace PATH` відтворює з нього ті самі рядки, що надрукував би `LOGD`.
+ *
+ * Формат повідомлення задається таблицею `TRACE_EVENTS`: аргументи `TRACE_LOG`
+ * мають точно відповідати типам специфікаторів (`%zu` — `size_t`, `%u` — `unsigned`).
+ * Номери подій залежать від збірки — розшифровувати тим самим `cplot`.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "log.h"
+
+/** Кількість записів кільця (степінь двійки). */
+#define TRACE_RING_RECORDS 16384u
+/** Найбільша кількість числових аргументів події. */
+#define TRACE_ARGS_MAX 10
+/** Місце під рядкові аргументи (розділені `\0`), байт. */
+#define TRACE_TEXT_MAX 48
+
+/**
+ * @brief Події трасування: назва і формат повідомлення (як у `LOGD`).
+ */
+#define TRACE_EVENTS(X)                                                                        \
+    X (EBB_SEND, "контролер → %s")                                                             \
+    X (EBB_RECV, "контролер ← %s")                                                             \
+    X (EBB_DATA, "дані контролера: %s")                                                        \
+    X (EBB_PIPE_SEND, "контролер ⇒ %s (блок №%lu, у конвеєрі %zu)")                            \
+    X (QUEUE_STATUS, "черга: активні=%zu у_черзі=%zu (разом %zu)")                             \
+    X (QUEUE_PREDICT, "черга: прогноз звільнення через %.2f мс")                               \
+    X (QUEUE_WAIT, "черга: очікування місця (%zu/%zu)")                                        \
+    X (QUEUE_BUSY, "черга: ще зайнято (%zu/%zu)")                                              \
+    X (QUEUE_SLOT, "черга: місце отримано (%zu/%zu)")                                          \
+    X (QUEUE_DISPATCHED, "черга: відправлено, у черзі %zu")                                    \
+    X (RATE_WAIT, "частота: очікування %.2f мс")                                               \
+    X (SLOT_READY, "axidraw: слот доступний для наступної команди")                            \
+    X (AXI_LM, "axidraw LM: rate1=%u steps1=%d accel1=%d rate2=%u steps2=%d accel2=%d "       \
+               "flags=%d")                                                                     \
+    X (AXI_LM_OK, "axidraw LM: команда успішна")                                               \
+    X (AXI_LT, "axidraw LT: intervals=%u rate1=%d accel1=%d rate2=%d accel2=%d flags=%d")      \
+    X (AXI_LT_OK, "axidraw LT: команда успішна")                                               \
+    X (STEP_BLOCK, "крокувач: блок=%lu довжина=%.3f крейсер=%.3f кількість_фаз=%zu")           \
+    X (STEP_BLOCK_DELTA, "Крокувач: блок %lu зміщення=(%.3f,%.3f) довжина=%.3f перо=%s")       \
+    X (STEP_BLOCK_STEPS, "Крокувач: кроки X=%d Y=%d, тривалість≈%u мс")                        \
+    X (STEP_MERGED, "крокувач: обʼєднано фаз=%zu блоки №%lu–%lu")                              \
+    X (STEP_PHASE, "крокувач.фаза: блок №%lu фаза %zu/%zu режим=%s відстань=%.4f "            \
+                   "початок=%.3f кінець=%.3f крокиA=%d крокиB=%d тривалість=%.4f")
+
+/** \brief Елемент переліку подій. */
+#define TRACE_EVENT_ENUM(NAME, FMT) TRACE_##NAME,
+
+/**
+ * @brief Номер події трасування.
+ */
+typedef enum { TRACE_EVENTS (TRACE_EVENT_ENUM) TRACE_EVENT_COUNT } trace_event_t;
+
+/** Прапорець запису в кільце (встановлюється `trace_start` до запуску потоків). */
+extern bool trace_enabled;
+
+/**
+ * @brief Вмикає запис у кільце і обробники аварійних сигналів.
+ * @param path Файл дампа (NULL або порожній — трасування вимкнено).
+ * @return 0 — успіх або вимкнено; -1 — не вдалося відкрити файл чи виділити кільце.
+ */
+int trace_start (const char *path);
+
+/** Скидає кільце у файл і вимикає запис (без увімкненого трасування — no-op). */
+void trace_stop (void);
+
+/**
+ * @brief Записує подію в кільце або друкує її рядком `LOGD`.
+ * @param event Подія.
+ * @param ... Аргументи формату події.
+ */
+void trace_log (trace_event_t event, ...);
+
+/** \brief Чи потрібна подія: запис у кільце або налагоджувальний журнал. */
+static inline bool trace_active (void) {
+    return trace_enabled || log_get_config ()->level >= LOG_DEBUG;
+}
+
+/** \brief Подія гарячого шляху: `TRACE_LOG (TRACE_EBB_SEND, cmd)`. */
+#define TRACE_LOG(...)                                                                         \
+    do {                                                                                       \
+        if (trace_active ())                                                                   \
+            trace_log (__VA_ARGS__);                                                           \
+    } while (0)
+
+/**
+ * @brief Розшифровує дамп кільця у рядки журналу (від найстарішого запису).
+ * @param path Файл дампа.
+ * @param out Потік виводу.
+ * @return 0 — успіх; -1 — файл не відкрито або він не є дампом цієї збірки.
+ */
+int trace_decode_file (const char *path, FILE *out);
+
+#endif
@@ -4,6 +4,24 @@
  * @brief Реалізація вимірювання часу.
  * @ingroup ttime
  */
+#include "jsw.h"
+
+bool ttime_profiling = false;
+
+/** Назви етапів у JSON (порядок — як у `ttime_stage_t`). */
+static const char *const k_ttime_stage_names[TTIME_STAGE_COUNT]
+    = { "text", "markdown", "canvas", "paths", "plan", "step", "serial", "preview" };
+
+/** Назви лічильників у JSON (порядок — як у `ttime_counter_t`). */
+static const char *const k_ttime_counter_names[TTIME_COUNTER_COUNT]
+    = { "glyphs",       "paths",        "blocks",          "ebb_commands",
+        "serial_bytes", "arena_allocs", "arena_peak_bytes" };
+
+static uint64_t g_stage_ns[TTIME_STAGE_COUNT];    /**< Сумарний час етапів, нс. */
+static uint64_t g_stage_calls[TTIME_STAGE_COUNT]; /**< Кількість входів в етап. */
+static uint64_t g_counters[TTIME_COUNTER_COUNT];  /**< Лічильники. */
+static uint64_t g_profile_start_ns;               /**< Момент увімкнення профілю. */
+
 double time_diff_ms (const struct timespec *now, const struct timespec *prev) {
     if (!now || !prev)
         return 0.0;
@@ -11,3 +29,78 @@ double time_diff_ms (const struct timespec *now, const struct timespec *prev) {
     diff += (double)(now->tv_nsec - prev->tv_nsec) / 1e6;
     return diff;
 }
+
+/** @copydoc ttime_now_ns */
+uint64_t ttime_now_ns (void) {
+    struct timespec ts;
+    if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/** @copydoc ttime_profile_enable */
+void ttime_profile_enable (void) {
+    g_profile_start_ns = ttime_now_ns ();
+    ttime_profiling = true;
+}
+
+/** @copydoc ttime_stage_add */
+void ttime_stage_add (ttime_stage_t stage, uint64_t start_ns) {
+    if ((unsigned)stage >= TTIME_STAGE_COUNT)
+        return;
+    uint64_t now = ttime_now_ns ();
+    __atomic_fetch_add (&g_stage_ns[stage], now > start_ns ? now - start_ns : 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&g_stage_calls[stage], 1, __ATOMIC_RELAXED);
+}
+
+/** @copydoc ttime_counter_add */
+void ttime_counter_add (ttime_counter_t counter, uint64_t n) {
+    if ((unsigned)counter < TTIME_COUNTER_COUNT)
+        __atomic_fetch_add (&g_counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/** @copydoc ttime_counter_max */
+void ttime_counter_max (ttime_counter_t counter, uint64_t n) {
+    if ((unsigned)counter >= TTIME_COUNTER_COUNT)
+        return;
+    uint64_t cur = __atomic_load_n (&g_counters[counter], __ATOMIC_RELAXED);
+    while (cur < n
+           && !__atomic_compare_exchange_n (
+               &g_counters[counter], &cur, n, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/** @copydoc ttime_profile_write_json */
+void ttime_profile_write_json (FILE *out) {
+    if (!out || !ttime_profiling)
+        return;
+    json_writer_t w;
+    jsw_jsonw_init (&w, out);
+    jsw_jsonw_begin_object (&w);
+    jsw_jsonw_key (&w, "total_ms");
+    jsw_jsonw_double (&w, (double)(ttime_now_ns () - g_profile_start_ns) / 1e6);
+    jsw_jsonw_key (&w, "stages");
+    jsw_jsonw_begin_object (&w);
+    for (int i = 0; i < TTIME_STAGE_COUNT; ++i) {
+        uint64_t calls = __atomic_load_n (&g_stage_calls[i], __ATOMIC_RELAXED);
+        if (calls == 0)
+            continue;
+        jsw_jsonw_key (&w, k_ttime_stage_names[i]);
+        jsw_jsonw_begin_object (&w);
+        jsw_jsonw_key (&w, "ms");
+        jsw_jsonw_double (&w, (double)__atomic_load_n (&g_stage_ns[i], __ATOMIC_RELAXED) / 1e6);
+        jsw_jsonw_key (&w, "calls");
+        jsw_jsonw_int (&w, (long long)calls);
+        jsw_jsonw_end_object (&w);
+    }
+    jsw_jsonw_end_object (&w);
+    jsw_jsonw_key (&w, "counters");
+    jsw_jsonw_begin_object (&w);
+    for (int i = 0; i < TTIME_COUNTER_COUNT; ++i) {
+        jsw_jsonw_key (&w, k_ttime_counter_names[i]);
+        jsw_jsonw_int (&w, (long long)__atomic_load_n (&g_counters[i], __ATOMIC_RELAXED));
+    }
+    jsw_jsonw_end_object (&w);
+    jsw_jsonw_end_object (&w);
+    fputc ('\n', out);
+}
@@ -5,7 +5,17 @@
  * @brief Допоміжні таймінги/мікросекунди для профілювання.
  * @defgroup ttime Час
  * @ingroup util
+ * @details
+ * Профіль етапів (`--profile`): етап конвеєра обгортається парою
+ * `ttime_stage_begin`/`ttime_stage_end`, гарячі цикли додають лічильники
+ * `ttime_count`. Поки профіль вимкнено, кожен виклик — одна перевірка прапорця без
+ * читання годинника. Час і лічильники додаються атомарно, тож етапи з кількох потоків
+ * (верстка Markdown, потік планування) сумуються; етапи можуть вкладатися (текст — у
+ * Markdown, обмін із портом — у крокувач).
  */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
 /**
@@ -16,4 +26,73 @@
  */
 double time_diff_ms (const struct timespec *now, const struct timespec *prev);
 
+/**
+ * @brief Етап конвеєра для профілю.
+ */
+typedef enum {
+    TTIME_STAGE_TEXT,     /**< Розкладка тексту: формування рядків і гліфів. */
+    TTIME_STAGE_MARKDOWN, /**< Верстка Markdown (включає розкладку тексту блоків). */
+    TTIME_STAGE_CANVAS,   /**< Розміщення на сторінці (`canvas_layout_document`). */
+    TTIME_STAGE_PATHS,    /**< Спрощення і впорядкування контурів. */
+    TTIME_STAGE_PLAN,     /**< Планування руху. */
+    TTIME_STAGE_STEP,     /**< Крокувач: кроки і команди EBB (включає обмін із портом). */
+    TTIME_STAGE_SERIAL,   /**< Обмін із серійним портом (запис, очікування відповіді). */
+    TTIME_STAGE_PREVIEW,  /**< Рендер превʼю SVG/PNG. */
+    TTIME_STAGE_COUNT
+} ttime_stage_t;
+
+/**
+ * @brief Лічильник гарячих циклів для профілю.
+ */
+typedef enum {
+    TTIME_COUNT_GLYPHS,       /**< Виведені гліфи. */
+    TTIME_COUNT_PATHS,        /**< Контури розкладки на сторінці. */
+    TTIME_COUNT_BLOCKS,       /**< Блоки плану. */
+    TTIME_COUNT_EBB_COMMANDS, /**< Команди EBB, поставлені в порт. */
+    TTIME_COUNT_SERIAL_BYTES, /**< Байти, записані в порт. */
+    TTIME_COUNT_ARENA_ALLOCS, /**< Виділення з арен завдань (`jobarena.h`). */
+    TTIME_COUNT_ARENA_PEAK,   /**< Найбільший обсяг арени завдання, байт (максимум, не сума). */
+    TTIME_COUNTER_COUNT
+} ttime_counter_t;
+
+/** Прапорець профілю (встановлюється `ttime_profile_enable` до запуску потоків). */
+extern bool ttime_profiling;
+
+/** Вмикає профіль і запамʼятовує момент початку. */
+void ttime_profile_enable (void);
+
+/** Монотонний час, нс. */
+uint64_t ttime_now_ns (void);
+
+/** Додає тривалість до етапу (лише з увімкненим профілем). */
+void ttime_stage_add (ttime_stage_t stage, uint64_t start_ns);
+
+/** Додає значення до лічильника (лише з увімкненим профілем). */
+void ttime_counter_add (ttime_counter_t counter, uint64_t n);
+
+/** Піднімає лічильник до `n`, якщо він менший (лише з увімкненим профілем). */
+void ttime_counter_max (ttime_counter_t counter, uint64_t n);
+
+/** \brief Початок етапу: мітка часу або 0 з вимкненим профілем. */
+static inline uint64_t ttime_stage_begin (void) { return ttime_profiling ? ttime_now_ns () : 0; }
+
+/** \brief Кінець етапу, розпочатого `ttime_stage_begin`. */
+static inline void ttime_stage_end (ttime_stage_t stage, uint64_t start_ns) {
+    if (ttime_profiling)
+        ttime_stage_add (stage, start_ns);
+}
+
+/** \brief Збільшує лічильник профілю. */
+static inline void ttime_count (ttime_counter_t counter, uint64_t n) {
+    if (ttime_profiling)
+        ttime_counter_add (counter, n);
+}
+
+/**
+ * @brief Друкує профіль одним JSON‑обʼєктом: загальний час, етапи (мс і кількість
+ *        входів) і лічильники.
+ * @param out Потік (зазвичай stderr, щоб не змішувати з превʼю у stdout).
+ */
+void ttime_profile_write_json (FILE *out);
+
 #endif